@@ -11,6 +11,9 @@ option(BUILD_WITH_STATIC_ANALYSIS
 option(DISABLE_STACK_PROTECTION
   "Disable stack smashing protection (-fno-stack-protector)."
   OFF)
+option(BUILD_POSIX_SIM
+  "Build the POSIX host simulation of a Bristlemouth node (native builds only)."
+  OFF)
 set(USE_SANITIZER
     "" CACHE STRING
     "Compile with a sanitizer. Options are: Address, Memory, Leak, Undefined, Thread, 'Address;Undefined'"
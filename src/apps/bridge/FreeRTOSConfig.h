@@ -193,6 +193,17 @@ placed into the low power state respectively. */
 // Useful for debugging, takes up an additional 4 bytes per task
 #define configRECORD_STACK_HIGH_ADDRESS 1
 
+// Per-task cpu time, see perf_runtime_u5.c
+#define configGENERATE_RUN_TIME_STATS 1
+#define configRUN_TIME_COUNTER_TYPE uint64_t
+#define configRUN_TIME_COUNTS_PER_TICK (configCPU_CLOCK_HZ / configTICK_RATE_HZ)
+#define portCONFIGURE_TIMER_FOR_RUN_TIME_STATS() perfRunTimeCounterInit()
+#define portGET_RUN_TIME_COUNTER_VALUE() perfRunTimeCounterGet()
+#if defined(__ICCARM__) || defined(__CC_ARM) || defined(__GNUC__)
+void perfRunTimeCounterInit(void);
+uint64_t perfRunTimeCounterGet(void);
+#endif
+
 // Code is responsible for checking for malloc failures
 #define configUSE_MALLOC_FAILED_HOOK 0
 
@@ -27,8 +27,10 @@
 #define MIDDLEWARE_NET_TASK_PRIORITY 4
 
 #define USB_TASK_PRIORITY 3
+#define BM_STORE_FORWARD_TASK_PRIORITY 3
 
 #define SERIAL_TX_TASK_PRIORITY 2
+#define PCAP_TASK_PRIORITY 2
 #define CONSOLE_RX_TASK_PRIORITY 2
 #define DEBUG_UART_RX_TASK_PRIORITY 2
 
@@ -28,8 +28,12 @@
 #include "gpioISR.h"
 #include "memfault_platform_core.h"
 #include "mic.h"
+#include "mic_codec.h"
+#include "mic_dsp.h"
+#include "mic_kernels.h"
 #include "pcap.h"
 #include "pca9535.h"
+#include "perf_counters.h"
 #include "printf.h"
 #include "serial.h"
 #include "serial_console.h"
@@ -293,6 +297,9 @@ const char buttonTopic[] = "button";
 const char hydroDbTopic[] = "hydrophone/db";
 const char hydroStreamTopic[] = "hydrophone/stream";
 const char hydroStreamEnableTopic[] = "hydrophone/stream/enable";
+const char hydroStreamCodecTopic[] = "hydrophone/stream/codec";
+const char hydroFeaturesTopic[] = "hydrophone/features";
+const char hydroFeaturesPeriodTopic[] = "hydrophone/features/period";
 const char alarmDurationTopic[] = "alarm/duration";
 const char alarmThresholdTopic[] = "alarm/threshold";
 const char alarmTriggerTopic[] = "alarm/trigger";
@@ -302,53 +309,78 @@ volatile static uint32_t alarmDurationS;
 
 bool streamEnabled = false;
 
-#define AUDIO_MAGIC 0xAD10B055
+#define MIC_SAMPLE_RATE (50000)
 
-// buffer for resized mic samples (int16_t)
-#define MIC_SAMPLES_PER_PACKET (512)
-typedef struct {
-  uint32_t magic;
-  uint32_t sampleRate;
-  uint16_t numSamples;
-  uint8_t sampleSize;
-  uint8_t flags;
-  int16_t samples[0];
-} __attribute__((__packed__)) hydrophoneStreamDataHeader_t;
+// Buffers with a sample this close to full scale are counted as clipped
+#define MIC_CLIP_LEVEL (MIC_KERNEL_FULL_SCALE - 256)
 
-typedef struct {
-  hydrophoneStreamDataHeader_t header;
-  int16_t samples[MIC_SAMPLES_PER_PACKET];
-} __attribute__((__packed__)) hydrophoneStreamData_t;
+// Default feature frame period (rounded to whole FFT blocks)
+#define FEATURES_PERIOD_MS (1000)
+#define FEATURES_PERIOD_MAX_MS (60 * 1000)
 
-static hydrophoneStreamData_t streamData;
+// Peaks must be this far above the average spectrum level
+#define FEATURES_PEAK_THRESHOLD_DB (10.0)
+
+static perfCounter_t dspCycles;
+static perfCounter_t dspCyclesMax;
+static perfCounter_t clippedBuffers;
+
+// Default stream codec (lossless, same resolution as the old int16 stream)
+#define STREAM_CODEC MIC_CODEC_RICE
+#define STREAM_SAMPLE_BITS (16)
+
+static micCodec_t streamCodec;
+// Codec changes are applied by the hydrophone task between packets
+static micCodec_t pendingStreamCodec;
+static volatile bool streamCodecChanged;
+static uint8_t streamPacket[MIC_CODEC_MAX_PACKET_LEN];
+static perfCounter_t codecCycles;
 
 static bool processMicSamples(const uint32_t *samples, uint32_t numSamples, void *args) {
   (void)args;
-  (void)samples;
-  (void)numSamples;
-  float dbLevel = micGetDB(samples, numSamples);
+  micKernelStats_t stats;
+
+  // Level and peak in one pass over the DMA buffer
+  micKernelStatsInit(&stats);
+  micKernelProcess(samples, numSamples, NULL, &stats);
+  if(micKernelPeak(&stats) >= MIC_CLIP_LEVEL) {
+    perfCounterInc(&clippedBuffers);
+  }
+
+  float dbLevel = micKernelDb(&stats, MIC_AOP_DB);
 
   bm_pub(hydroDbTopic, &dbLevel, sizeof(float));
 
-  if(streamEnabled) {
-    for(uint32_t idx = 0; idx < MIN(numSamples, MIC_SAMPLES_PER_PACKET); idx++) {
-      streamData.samples[idx] = (int16_t)(samples[idx] >> 8);
+  uint64_t startCycles = portGET_RUN_TIME_COUNTER_VALUE();
+  bool frameReady = micDspProcess(samples, numSamples);
+  uint32_t cycles = (uint32_t)(portGET_RUN_TIME_COUNTER_VALUE() - startCycles);
+  perfCounterSet(&dspCycles, cycles);
+  perfCounterMax(&dspCyclesMax, cycles);
+
+  if(frameReady) {
+    micDspFeatures_t features;
+    if(micDspGetFeatures(&features)) {
+      bm_pub(hydroFeaturesTopic, &features, sizeof(features));
     }
-    streamData.header.numSamples = MIN(numSamples, MIC_SAMPLES_PER_PACKET);
+  }
 
-    bm_pub(hydroStreamTopic,
-              &streamData.header,
-              (sizeof(hydrophoneStreamDataHeader_t) + sizeof(int16_t) * streamData.header.numSamples));
+  if(streamCodecChanged) {
+    taskENTER_CRITICAL();
+    memcpy(&streamCodec, &pendingStreamCodec, sizeof(streamCodec));
+    streamCodecChanged = false;
+    taskEXIT_CRITICAL();
+  }
 
-    if(numSamples > MIC_SAMPLES_PER_PACKET) {
-      for(uint32_t idx = MIC_SAMPLES_PER_PACKET; idx < numSamples; idx++) {
-        streamData.samples[idx - MIC_SAMPLES_PER_PACKET] = (int16_t)(samples[idx] >> 8);
+  if(streamEnabled) {
+    startCycles = portGET_RUN_TIME_COUNTER_VALUE();
+    for(uint32_t offset = 0; offset < numSamples; offset += MIC_CODEC_MAX_SAMPLES) {
+      uint32_t count = MIN(numSamples - offset, MIC_CODEC_MAX_SAMPLES);
+      size_t len = micCodecEncode(&streamCodec, &samples[offset], count, streamPacket, sizeof(streamPacket));
+      if(len) {
+        bm_pub(hydroStreamTopic, streamPacket, len);
       }
-      streamData.header.numSamples = (numSamples - MIC_SAMPLES_PER_PACKET);
-      bm_pub(hydroStreamTopic,
-              &streamData.header,
-              (sizeof(hydrophoneStreamDataHeader_t) + sizeof(int16_t) * streamData.header.numSamples));
     }
+    perfCounterSet(&codecCycles, (uint32_t)(portGET_RUN_TIME_COUNTER_VALUE() - startCycles));
   }
 
   return true;
@@ -390,6 +422,53 @@ void streamEnable(uint64_t node_id, const char* topic, uint16_t topic_len, const
   }
 }
 
+// Select stream codec ("raw", "rice", "rice24" or "adpcm")
+void streamCodecCb(uint64_t node_id, const char* topic, uint16_t topic_len, const uint8_t* data, uint16_t data_len) {
+  (void)node_id;
+  (void)topic;
+  (void)topic_len;
+
+  const char *codec = reinterpret_cast<const char *>(data);
+  micCodec_e type;
+  uint8_t sampleBits = STREAM_SAMPLE_BITS;
+  if(data_len == 3 && memcmp("raw", codec, 3) == 0) {
+    type = MIC_CODEC_RAW;
+  } else if(data_len == 4 && memcmp("rice", codec, 4) == 0) {
+    type = MIC_CODEC_RICE;
+  } else if(data_len == 6 && memcmp("rice24", codec, 6) == 0) {
+    type = MIC_CODEC_RICE;
+    sampleBits = 24;
+  } else if(data_len == 5 && memcmp("adpcm", codec, 5) == 0) {
+    type = MIC_CODEC_ADPCM;
+  } else {
+    printf("Invalid stream codec\n");
+    return;
+  }
+
+  taskENTER_CRITICAL();
+  micCodecInit(&pendingStreamCodec, type, sampleBits, MIC_SAMPLE_RATE);
+  streamCodecChanged = true;
+  taskEXIT_CRITICAL();
+
+  printf("Stream codec %.*s\n", data_len, codec);
+}
+
+// Update feature frame period (in ms) from data
+void updateFeaturesPeriodCb(uint64_t node_id, const char* topic, uint16_t topic_len, const uint8_t* data, uint16_t data_len) {
+  (void)node_id;
+  (void)topic;
+  (void)topic_len;
+
+  if(data && data_len > 0) {
+    uint32_t periodMs = strtoul(reinterpret_cast<const char *>(data), 0, 10);
+    if(periodMs > 0 && periodMs <= FEATURES_PERIOD_MAX_MS) {
+      uint32_t blocks = (periodMs * (MIC_SAMPLE_RATE / 1000)) / MIC_DSP_FFT_LEN;
+      micDspSetBlocksPerFrame(blocks);
+      printf("Updating feature period to %" PRIu32 "ms (%" PRIu32 " blocks)\n", periodMs, micDspGetBlocksPerFrame());
+    }
+  }
+}
+
 // Manually trigger alarm
 void alarmTriggerCb(uint64_t node_id, const char* topic, uint16_t topic_len, const uint8_t* data, uint16_t data_len) {
   (void)node_id;
@@ -464,15 +543,29 @@ static void hydrophoneTask( void *parameters ) {
   alarmDurationS = 1;
 
   // These won't change
-  streamData.header.magic = AUDIO_MAGIC;
-  streamData.header.sampleRate = 50000;
-  streamData.header.sampleSize = 2;
+  micCodecInit(&streamCodec, STREAM_CODEC, STREAM_SAMPLE_BITS, MIC_SAMPLE_RATE);
 
   if(micInit(&hsai_BlockA1, NULL)) {
+    micDspConfig_t dspConfig = {
+      .sampleRate = MIC_SAMPLE_RATE,
+      .blocksPerFrame = (FEATURES_PERIOD_MS * (MIC_SAMPLE_RATE / 1000)) / MIC_DSP_FFT_LEN,
+      .peakThresholdDb = FEATURES_PEAK_THRESHOLD_DB,
+      .dbOffset = MIC_AOP_DB,
+    };
+    micDspInit(&dspConfig);
+    perfCounterRegister(&dspCycles, "hydrophone", "dsp_cycles", PERF_COUNTER_TYPE_GAUGE);
+    perfCounterRegister(&dspCyclesMax, "hydrophone", "dsp_cycles_max", PERF_COUNTER_TYPE_MAX);
+    perfCounterRegister(&codecCycles, "hydrophone", "codec_cycles", PERF_COUNTER_TYPE_GAUGE);
+    perfCounterRegister(&clippedBuffers, "hydrophone", "clipped", PERF_COUNTER_TYPE_COUNT);
+
+    // The audio stream is bulk data, it shouldn't crowd out control topics
+    bm_pubsub_set_topic_priority(hydroStreamTopic, BM_PUBSUB_PRIO_LOW);
 
     // Hydrophone audio stream enable/disable
 
-    bm_sub(hydroStreamEnableTopic, streamEnable);
+    bm_sub_prio(hydroStreamEnableTopic, streamEnable, BM_PUBSUB_PRIO_HIGH);
+    bm_sub(hydroStreamCodecTopic, streamCodecCb);
+    bm_sub(hydroFeaturesPeriodTopic, updateFeaturesPeriodCb);
     bm_sub(buttonTopic, buttonTopicSubscription);
 
     while(1) {
@@ -501,7 +594,7 @@ static void hydrophoneTask( void *parameters ) {
     bm_sub(alarmDurationTopic, updateDurationCb);
 
     // alarm duration in seconds
-    bm_sub(alarmTriggerTopic, alarmTriggerCb);
+    bm_sub_prio(alarmTriggerTopic, alarmTriggerCb, BM_PUBSUB_PRIO_HIGH);
 
     bm_sub(buttonTopic, buttonTopicSubscription);
 
@@ -540,20 +633,20 @@ void usb_line_state_change(uint8_t itf, uint8_t dtr, bool rts) {
         // Enable audio streaming
 
         // Hydrophone audio stream!
-        bm_sub(hydroStreamTopic, streamAudioData);
+        bm_sub_prio(hydroStreamTopic, streamAudioData, BM_PUBSUB_PRIO_LOW);
 
         serialEnable(&usbPcap);
         xStreamBufferReset(usbPcap.txStreamBuffer);
         xStreamBufferReset(usbPcap.rxStreamBuffer);
 
-        bm_pub(hydroStreamEnableTopic, "1", 1);
+        bm_pub_prio(hydroStreamEnableTopic, "1", 1, BM_PUBSUB_PRIO_HIGH);
         printf("bm pub %s 1\n", hydroStreamEnableTopic);
       } else {
         // Disable audio streaming
         bm_unsub(hydroStreamTopic, streamAudioData);
         serialDisable(&usbPcap);
 
-        bm_pub(hydroStreamEnableTopic, "0", 1);
+        bm_pub_prio(hydroStreamEnableTopic, "0", 1, BM_PUBSUB_PRIO_HIGH);
         printf("bm pub %s 0\n", hydroStreamEnableTopic);
       }
       break;
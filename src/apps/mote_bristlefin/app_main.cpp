@@ -46,6 +46,7 @@
 #include "w25.h"
 #include "debug_w25.h"
 #include "nvmPartition.h"
+#include "bm_store_forward.h"
 #include "external_flash_partitions.h"
 #include "debug_nvm_cli.h"
 #include "debug_dfu.h"
@@ -221,6 +222,14 @@ void handle_sensor_subscriptions(uint64_t node_id, const char* topic, uint16_t t
     }
 }
 
+// Sensor topics that get stored in flash when there's no route
+static const char *sfTopics[] = {
+  "pressure",
+  "humidity",
+  "temperature",
+  "power",
+};
+
 // TODO - move this to some debug file?
 static const DebugGpio_t debugGpioPins[] = {
   {"adin_cs", &ADIN_CS, GPIO_OUT},
@@ -310,6 +319,13 @@ static void defaultTask( void *parameters ) {
     debugDfuInit(&dfu_partition);
     bcl_init(&dfu_partition, &debug_configuration_user, &debug_configuration_system);
 
+    // Keep sensor data around while there's no one to send it to
+    NvmPartition sf_log_partition(debugW25, sf_log_configuration);
+    bm_store_forward_init(sf_log_partition);
+    for(size_t idx = 0; idx < sizeof(sfTopics)/sizeof(sfTopics[0]); idx++) {
+        bm_store_forward_enable(sfTopics[idx], strlen(sfTopics[idx]));
+    }
+
     sensorsInit();
     // TODO - get this from the nvm cfg's!
     sensorConfig_t sensorConfig = { .sensorCheckIntervalS=10 };
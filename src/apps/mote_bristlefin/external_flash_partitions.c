@@ -31,6 +31,12 @@ _Static_assert((CLI_CONFIG_FLASH_OFFSET_BYTES % SECTOR_BUFFER_BYTES == 0), "inva
 _Static_assert((DFU_CONFIG_FLASH_OFFSET_BYTES >= CLI_CONFIG_FLASH_END_BYTES), "Invalid flash range");
 _Static_assert((DFU_CONFIG_FLASH_OFFSET_BYTES % SECTOR_BUFFER_BYTES == 0), "invalid alignment");
 
+#define SF_LOG_FLASH_OFFSET_BYTES             (DFU_CONFIG_FLASH_END_BYTES + (DFU_CONFIG_FLASH_END_BYTES % SECTOR_BUFFER_BYTES))
+#define SF_LOG_FLASH_SIZE_BYTES               (256 * 1024)
+#define SF_LOG_FLASH_END_BYTES                (SF_LOG_FLASH_OFFSET_BYTES + SF_LOG_FLASH_SIZE_BYTES)
+_Static_assert((SF_LOG_FLASH_OFFSET_BYTES >= DFU_CONFIG_FLASH_END_BYTES), "Invalid flash range");
+_Static_assert((SF_LOG_FLASH_OFFSET_BYTES % SECTOR_BUFFER_BYTES == 0), "invalid alignment");
+
 const ext_flash_partition_t hardware_configuration = {
     .fa_off = HARDWARE_CONFIG_FLASH_OFFSET_BYTES,
     .fa_size = HARDWARE_CONFIG_FLASH_SIZE_BYTES,
@@ -55,3 +61,8 @@ const ext_flash_partition_t dfu_configuration = {
     .fa_off = DFU_CONFIG_FLASH_OFFSET_BYTES,
     .fa_size = DFU_CONFIG_FLASH_SIZE_BYTES,
 };
+
+const ext_flash_partition_t sf_log_configuration = {
+    .fa_off = SF_LOG_FLASH_OFFSET_BYTES,
+    .fa_size = SF_LOG_FLASH_SIZE_BYTES,
+};
@@ -26,6 +26,7 @@ extern const ext_flash_partition_t system_configuration;
 extern const ext_flash_partition_t user_configuration;
 extern const ext_flash_partition_t cli_configuration;
 extern const ext_flash_partition_t dfu_configuration;
+extern const ext_flash_partition_t sf_log_configuration;
 #define DFU_HEADER_OFFSET_BYTES (0)
 #define DFU_IMG_START_OFFSET_BYTES (sizeof(bm_dfu_img_info_t))
 _Static_assert(DFU_IMG_START_OFFSET_BYTES > DFU_HEADER_OFFSET_BYTES, "Invalid DFU image offset");
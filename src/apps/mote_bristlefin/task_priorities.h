@@ -25,8 +25,10 @@
 
 #define SENSOR_SAMPLER_TASK_PRIORITY 3
 #define USB_TASK_PRIORITY 3
+#define BM_STORE_FORWARD_TASK_PRIORITY 3
 
 #define SERIAL_TX_TASK_PRIORITY 2
+#define PCAP_TASK_PRIORITY 2
 #define CONSOLE_RX_TASK_PRIORITY 2
 
 #define CLI_TASK_PRIORITY 1
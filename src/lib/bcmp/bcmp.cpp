@@ -21,6 +21,11 @@
 #include "bcmp_time.h"
 #include "bcmp_topology.h"
 #include "bcmp_resource_discovery.h"
+#include "bcmp_netstat.h"
+#include "bcmp_transactions.h"
+#include "mem_pool.h"
+#include "perf_counters.h"
+#include "trace.h"
 
 #include "bm_dfu.h"
 
@@ -36,12 +41,15 @@ typedef struct {
   struct netif* netif;
   struct raw_pcb *pcb;
   QueueHandle_t rx_queue;
+  perfQueue_t rx_queue_perf;
   TimerHandle_t heartbeat_timer;
+  uint32_t heartbeat_count;
 } bcmpContext_t;
 
 typedef enum {
     BCMP_EVT_RX,
     BCMP_EVT_HEARTBEAT,
+    BCMP_EVT_TXN_TIMEOUT,
 } bcmp_queue_type_e;
 
 typedef struct {
@@ -58,6 +66,32 @@ typedef struct {
 
 static bcmpContext_t _ctx;
 
+// Scratch buffers for building/printing small BCMP messages (ping, config).
+// Anything that doesn't fit in a block comes from the heap.
+#define BCMP_MSG_POOL_SIZE      (4)
+#define BCMP_MSG_POOL_BLOCK_LEN (128)
+MEM_POOL_DEFINE(bcmp_msgs, BCMP_MSG_POOL_BLOCK_LEN, BCMP_MSG_POOL_SIZE, true);
+
+/*!
+  Allocate a message buffer. Free with bcmp_msg_free
+
+  \param len - bytes needed
+  \return pointer to buffer, NULL if out of memory
+*/
+void *bcmp_msg_alloc(size_t len) {
+  return memPoolAllocSize(&bcmp_msgs, len);
+}
+
+/*!
+  Free a buffer from bcmp_msg_alloc
+
+  \param *buf - buffer to free (NULL is ignored)
+  \return none
+*/
+void bcmp_msg_free(void *buf) {
+  memPoolFree(&bcmp_msgs, buf);
+}
+
 /*!
   BCMP link change event callback
 
@@ -83,7 +117,7 @@ void bcmp_link_change(uint8_t port, bool state) {
 static void dfu_copy_and_process_message(struct pbuf *pbuf) {
   configASSERT(pbuf);
   bcmp_header_t *header = static_cast<bcmp_header_t *>(pbuf->payload);
-  uint8_t* buf = static_cast<uint8_t *>(pvPortMalloc((pbuf->len) - sizeof(bcmp_header_t)));
+  uint8_t* buf = bm_dfu_alloc_message((pbuf->len) - sizeof(bcmp_header_t));
   configASSERT(buf);
   memcpy(buf, header->payload, (pbuf->len) - sizeof(bcmp_header_t));
   bm_dfu_process_message(buf, (pbuf->len) - sizeof(bcmp_header_t));
@@ -143,7 +177,7 @@ int32_t bmcp_process_packet(struct pbuf *pbuf, ip_addr_t *src, ip_addr_t *dst) {
       }
 
       case BCMP_DEVICE_INFO_REPLY: {
-        bcmp_process_info_reply(reinterpret_cast<bcmp_device_info_reply_t *>(header->payload));
+        bcmp_process_info_reply(reinterpret_cast<bcmp_device_info_reply_t *>(header->payload), pbuf->len - sizeof(bcmp_header_t));
         break;
       }
 
@@ -153,7 +187,7 @@ int32_t bmcp_process_packet(struct pbuf *pbuf, ip_addr_t *src, ip_addr_t *dst) {
       }
 
       case BCMP_ECHO_REPLY: {
-        bcmp_process_ping_reply(reinterpret_cast<bcmp_echo_reply_t *>(header->payload));
+        bcmp_process_ping_reply(reinterpret_cast<bcmp_echo_reply_t *>(header->payload), pbuf->len - sizeof(bcmp_header_t));
         break;
       }
 
@@ -163,14 +197,14 @@ int32_t bmcp_process_packet(struct pbuf *pbuf, ip_addr_t *src, ip_addr_t *dst) {
       }
 
       case BCMP_RESOURCE_TABLE_REPLY: {
-        bcmp_resource_discovery::bcmp_process_resource_discovery_reply(reinterpret_cast<bcmp_resource_table_reply_t*>(header->payload), ip_to_nodeid(src));
+        bcmp_resource_discovery::bcmp_process_resource_discovery_reply(reinterpret_cast<bcmp_resource_table_reply_t*>(header->payload), pbuf->len - sizeof(bcmp_header_t), ip_to_nodeid(src));
         break;
       }
 
       case BCMP_SYSTEM_TIME_REQUEST:
       case BCMP_SYSTEM_TIME_RESPONSE:
       case BCMP_SYSTEM_TIME_SET: {
-        bcmp_time_process_time_message(static_cast<bcmp_message_type_t>(header->type), header->payload);
+        bcmp_time_process_time_message(static_cast<bcmp_message_type_t>(header->type), header->payload, pbuf->len - sizeof(bcmp_header_t));
         break;
       }
 
@@ -182,7 +216,7 @@ int32_t bmcp_process_packet(struct pbuf *pbuf, ip_addr_t *src, ip_addr_t *dst) {
       case BCMP_CONFIG_STATUS_RESPONSE:
       case BCMP_CONFIG_DELETE_REQUEST:
       case BCMP_CONFIG_DELETE_RESPONSE: {
-        bcmp_process_config_message(static_cast<bcmp_message_type_t>(header->type), header->payload);
+        bcmp_process_config_message(static_cast<bcmp_message_type_t>(header->type), header->payload, pbuf->len - sizeof(bcmp_header_t));
         break;
       }
 
@@ -207,7 +241,17 @@ int32_t bmcp_process_packet(struct pbuf *pbuf, ip_addr_t *src, ip_addr_t *dst) {
       }
 
       case BCMP_NEIGHBOR_TABLE_REPLY: {
-        bcmp_process_neighbor_table_reply(reinterpret_cast<bcmp_neighbor_table_reply_t *>(header->payload));
+        bcmp_process_neighbor_table_reply(reinterpret_cast<bcmp_neighbor_table_reply_t *>(header->payload), pbuf->len - sizeof(bcmp_header_t));
+        break;
+      }
+
+      case BCMP_NET_STAT_REQUEST: {
+        bcmp_process_netstat_request(reinterpret_cast<bcmp_netstat_request_t *>(header->payload), dst);
+        break;
+      }
+
+      case BCMP_NET_STAT_REPLY: {
+        bcmp_process_netstat_reply(reinterpret_cast<bcmp_netstat_reply_t *>(header->payload), pbuf->len - sizeof(bcmp_header_t));
         break;
       }
 
@@ -239,6 +283,18 @@ static void heartbeat_timer_handler(TimerHandle_t tmr){
   configASSERT(xQueueSend(_ctx.rx_queue, &item, 0) == pdTRUE);
 }
 
+/*!
+  Called (from the timer task) when a transaction is due to time out. No work
+  is done here, but instead an event is queued up to be handled in the BCMP task.
+
+  \return none
+*/
+static void transaction_timeout_evt(void) {
+  bcmp_queue_item_t item = {BCMP_EVT_TXN_TIMEOUT, NULL, {{0,0,0,0}, 0}, {{0,0,0,0}, 0}, NULL};
+
+  configASSERT(xQueueSend(_ctx.rx_queue, &item, 0) == pdTRUE);
+}
+
 /*!
   lwip raw recv callback for BCMP packets. Called from lwip task.
   Packet is added to main BCMP queue for processing
@@ -279,9 +335,13 @@ static uint8_t bcmp_recv(void *arg, struct raw_pcb *pcb, struct pbuf *pbuf, cons
     // Copy the destination into the queue item
     memcpy(item.dst.addr, ip6_hdr->dest.addr, sizeof(item.dst.addr));
 
+    tracePacket(kTraceEventPktBcmpEnqueue, pbuf);
     if(xQueueSend(_ctx.rx_queue, &item, 0) != pdTRUE) {
+      perfQueueDropped(&_ctx.rx_queue_perf);
       printf("Error sending to Queue\n");
       pbuf_free(pbuf);
+    } else {
+      perfQueueSent(&_ctx.rx_queue_perf);
     }
 
     // eat the packet
@@ -319,6 +379,7 @@ static void bcmp_thread(void *parameters) {
 
     switch(item.type) {
       case BCMP_EVT_RX: {
+        tracePacket(kTraceEventPktBcmpDequeue, item.pbuf);
         bmcp_process_packet(item.pbuf, &item.src, &item.dst);
         break;
       }
@@ -330,6 +391,21 @@ static void bcmp_thread(void *parameters) {
 
         // Send out heartbeats
         bcmp_send_heartbeat(BCMP_HEARTBEAT_S);
+
+        // Learn everyone's resource tables once we're up, then keep ours
+        // fresh in everyone else's (they expire)
+        if(_ctx.heartbeat_count == 0) {
+          bcmp_resource_discovery::bcmp_resource_discovery_request_all();
+        }
+        if((_ctx.heartbeat_count % BCMP_RESOURCE_ANNOUNCE_HEARTBEATS) == 0) {
+          bcmp_resource_discovery::bcmp_resource_discovery_announce();
+        }
+        _ctx.heartbeat_count++;
+        break;
+      }
+
+      case BCMP_EVT_TXN_TIMEOUT: {
+        bcmp_transaction_check_timeouts();
         break;
       }
 
@@ -429,7 +505,9 @@ void bcmp_init(struct netif* netif, NvmPartition * dfu_partition, Configuration*
   /* Create threads and Queues */
   _ctx.rx_queue = xQueueCreate(BCMP_EVT_QUEUE_LEN, sizeof(bcmp_queue_item_t));
   configASSERT(_ctx.rx_queue);
+  perfQueueRegister(&_ctx.rx_queue_perf, "bcmp_rx_q", _ctx.rx_queue);
 
+  bcmp_transaction_init(transaction_timeout_evt);
   bm_dfu_init(bcmp_dfu_tx, dfu_partition);
   bcmp_config_init(user_cfg, sys_cfg);
   bcmp_resource_discovery::bcmp_resource_discovery_init();
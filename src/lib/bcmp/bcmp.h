@@ -23,3 +23,5 @@ using namespace cfg;
 void bcmp_init(struct netif* netif, NvmPartition * dfu_partition, Configuration* user_cfg, Configuration* sys_cfg);
 err_t bcmp_tx(const ip_addr_t *dst, bcmp_message_type_t type, uint8_t *buff, uint16_t len);
 void bcmp_link_change(uint8_t port, bool state);
+void *bcmp_msg_alloc(size_t len);
+void bcmp_msg_free(void *buf);
@@ -17,6 +17,7 @@
 #include "bcmp_time.h"
 #include "bcmp_topology.h"
 #include "bcmp_resource_discovery.h"
+#include "bcmp_netstat.h"
 
 #include "debug.h"
 
@@ -29,6 +30,7 @@ static const CLI_Command_Definition_t cmd_bcmp = {
   // Help string
   "bcmp neighbors\n"
   "bcmp info <node_id>\n"
+  "bcmp netstat <node_id>\n"
   "bcmp ping <node_id>\n"
   "bcmp cfg get <node_id> <partition(u/s)> <key>\n"
   "bcmp cfg set <node_id> <partition(u/s)> <type(u/i/f/s/b)> <key> <value>\n"
@@ -88,14 +90,28 @@ static BaseType_t cmd_bcmp_fn(char *writeBuffer,
           bcmp_print_neighbor_info(neighbor);
         } else {
           printf("Device not in neighbor table. Sending global request.\n");
-          bcmp_expect_info_from_node_id(node_id);
-          if(bcmp_request_info(node_id, &multicast_global_addr) != ERR_OK) {
+          if(bcmp_request_info(node_id, &multicast_global_addr, bcmp_info_print_cb) != ERR_OK) {
             printf("Error sending request\n");
           }
         }
       } else {
         printf("Invalid arguments\n");
       }
+    } else if (strncmp("netstat", command, command_str_len) == 0){
+      const char *node_id_str;
+      BaseType_t node_id_str_len = 0;
+      node_id_str = FreeRTOS_CLIGetParameter(
+                      commandString,
+                      2,
+                      &node_id_str_len);
+      if(node_id_str_len > 0) {
+        uint64_t node_id = strtoull(node_id_str, NULL, 16);
+        if(bcmp_request_netstat(node_id, &multicast_global_addr) != ERR_OK) {
+          printf("Error sending request\n");
+        }
+      } else {
+        printf("Invalid node_id\n");
+      }
     } else if (strncmp("ping", command, command_str_len) == 0){
       const char *node_id_str;
       BaseType_t node_id_str_len = 0;
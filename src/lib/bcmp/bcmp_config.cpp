@@ -2,16 +2,44 @@
 #include "FreeRTOS.h"
 #include "device_info.h"
 #include "bcmp.h"
+#include "bcmp_transactions.h"
 
 static Configuration* _usr_cfg;
 static Configuration* _sys_cfg;
 
-bool bcmp_config_get(uint64_t target_node_id, bcmp_config_partition_e partition, size_t key_len, const char* key, err_t &err) {
+/*!
+  Send a config request, waiting for the reply if asked to
+
+  \param type - request message type
+  \param reply_type - reply message type
+  \param target_node_id - node the request is for
+  \param *msg - request message
+  \param len - request message length
+  \param cb - called with the reply (optional, the reply is printed otherwise)
+  \param arg - passed to cb
+  \return ERR_OK if sent
+*/
+static err_t bcmp_config_tx(bcmp_message_type_t type, bcmp_message_type_t reply_type, uint64_t target_node_id, void *msg, size_t len, bcmp_txn_cb_t cb, void *arg) {
+    uint32_t txn_id = 0;
+    if(cb) {
+        txn_id = bcmp_transaction_start(reply_type, target_node_id, cb, arg);
+        if(!txn_id) {
+            return ERR_MEM;
+        }
+    }
+    err_t err = bcmp_tx(&multicast_ll_addr, type, reinterpret_cast<uint8_t *>(msg), len);
+    if((err != ERR_OK) && txn_id) {
+        bcmp_transaction_cancel(txn_id);
+    }
+    return err;
+}
+
+bool bcmp_config_get(uint64_t target_node_id, bcmp_config_partition_e partition, size_t key_len, const char* key, err_t &err, bcmp_txn_cb_t cb, void *arg) {
     configASSERT(key);
     bool rval = false;
     err = ERR_VAL;
     size_t msg_size = sizeof(bcmp_config_get_t) + key_len;
-    bcmp_config_get_t * get_msg = (bcmp_config_get_t * )pvPortMalloc(msg_size);
+    bcmp_config_get_t * get_msg = (bcmp_config_get_t * )bcmp_msg_alloc(msg_size);
     configASSERT(get_msg);
     do {
         get_msg->header.target_node_id = target_node_id;
@@ -22,22 +50,22 @@ bool bcmp_config_get(uint64_t target_node_id, bcmp_config_partition_e partition,
         }
         get_msg->key_length = key_len;
         memcpy(get_msg->key, key, key_len);
-        err = bcmp_tx(&multicast_ll_addr, BCMP_CONFIG_GET, (uint8_t *)get_msg, msg_size);
+        err = bcmp_config_tx(BCMP_CONFIG_GET, BCMP_CONFIG_VALUE, target_node_id, get_msg, msg_size, cb, arg);
         if(err == ERR_OK) {
             rval = true;
         }
     } while(0);
-    vPortFree(get_msg);
+    bcmp_msg_free(get_msg);
     return rval;
 }
 
 bool bcmp_config_set(uint64_t target_node_id, bcmp_config_partition_e partition,
-    size_t key_len, const char* key, size_t value_size, void * val, err_t &err) {
+    size_t key_len, const char* key, size_t value_size, void * val, err_t &err, bcmp_txn_cb_t cb, void *arg) {
     configASSERT(key);
     bool rval = false;
     err = ERR_VAL;
     size_t msg_len = sizeof(bcmp_config_set_t) + key_len + value_size;
-    bcmp_config_set_t * set_msg = (bcmp_config_set_t *)pvPortMalloc(msg_len);
+    bcmp_config_set_t * set_msg = (bcmp_config_set_t *)bcmp_msg_alloc(msg_len);
     configASSERT(set_msg);
     do {
         set_msg->header.target_node_id = target_node_id;
@@ -50,19 +78,19 @@ bool bcmp_config_set(uint64_t target_node_id, bcmp_config_partition_e partition,
         memcpy(set_msg->keyAndData, key, key_len);
         set_msg->data_length = value_size;
         memcpy(&set_msg->keyAndData[key_len], val, value_size);
-        err = bcmp_tx(&multicast_ll_addr, BCMP_CONFIG_SET, (uint8_t *)set_msg, msg_len);
+        err = bcmp_config_tx(BCMP_CONFIG_SET, BCMP_CONFIG_VALUE, target_node_id, set_msg, msg_len, cb, arg);
         if(err == ERR_OK) {
             rval = true;
         }
     } while(0);
-    vPortFree(set_msg);
+    bcmp_msg_free(set_msg);
     return rval;
 }
 
 bool bcmp_config_commit(uint64_t target_node_id, bcmp_config_partition_e partition, err_t &err) {
     bool rval = false;
     err = ERR_VAL;
-    bcmp_config_commit_t *commit_msg = (bcmp_config_commit_t *)pvPortMalloc(sizeof(bcmp_config_commit_t));
+    bcmp_config_commit_t *commit_msg = (bcmp_config_commit_t *)bcmp_msg_alloc(sizeof(bcmp_config_commit_t));
     configASSERT(commit_msg);
     commit_msg->header.target_node_id = target_node_id;
     commit_msg->header.source_node_id = getNodeId();
@@ -71,23 +99,23 @@ bool bcmp_config_commit(uint64_t target_node_id, bcmp_config_partition_e partiti
     if(err == ERR_OK) {
         rval = true;
     }
-    vPortFree(commit_msg);
+    bcmp_msg_free(commit_msg);
     return rval;
 }
 
-bool bcmp_config_status_request(uint64_t target_node_id, bcmp_config_partition_e partition, err_t &err) {
+bool bcmp_config_status_request(uint64_t target_node_id, bcmp_config_partition_e partition, err_t &err, bcmp_txn_cb_t cb, void *arg) {
     bool rval = false;
     err = ERR_VAL;
-    bcmp_config_status_request_t *status_req_msg = (bcmp_config_status_request_t *)pvPortMalloc(sizeof(bcmp_config_status_request_t));
+    bcmp_config_status_request_t *status_req_msg = (bcmp_config_status_request_t *)bcmp_msg_alloc(sizeof(bcmp_config_status_request_t));
     configASSERT(status_req_msg);
     status_req_msg->header.target_node_id = target_node_id;
     status_req_msg->header.source_node_id = getNodeId();
     status_req_msg->partition = partition;
-    err = bcmp_tx(&multicast_ll_addr, BCMP_CONFIG_STATUS_REQUEST, (uint8_t *)status_req_msg, sizeof(bcmp_config_status_request_t));
+    err = bcmp_config_tx(BCMP_CONFIG_STATUS_REQUEST, BCMP_CONFIG_STATUS_RESPONSE, target_node_id, status_req_msg, sizeof(bcmp_config_status_request_t), cb, arg);
     if(err == ERR_OK) {
         rval = true;
     }
-    vPortFree(status_req_msg);
+    bcmp_msg_free(status_req_msg);
     return rval;
 }
 
@@ -102,7 +130,7 @@ bool bcmp_config_status_response(uint64_t target_node_id, bcmp_config_partition_
     if(msg_size > BCMP_MAX_PAYLOAD_SIZE_BYTES) {
         return false;
     }
-    bcmp_config_status_response_t *status_resp_msg = (bcmp_config_status_response_t *)pvPortMalloc(msg_size);
+    bcmp_config_status_response_t *status_resp_msg = (bcmp_config_status_response_t *)bcmp_msg_alloc(msg_size);
     configASSERT(status_resp_msg);
     do {
         status_resp_msg->header.target_node_id = target_node_id;
@@ -122,7 +150,7 @@ bool bcmp_config_status_response(uint64_t target_node_id, bcmp_config_partition_
             rval = true;
         }
     } while(0);
-    vPortFree(status_resp_msg);
+    bcmp_msg_free(status_resp_msg);
     return rval;
 }
 
@@ -169,7 +197,7 @@ static bool bcmp_config_send_value(uint64_t target_node_id, bcmp_config_partitio
     bool rval = false;
     err = ERR_VAL;
     size_t msg_len = data_length + sizeof(bcmp_config_value_t);
-    bcmp_config_value_t * value_msg = (bcmp_config_value_t * )pvPortMalloc(msg_len);
+    bcmp_config_value_t * value_msg = (bcmp_config_value_t * )bcmp_msg_alloc(msg_len);
     configASSERT(value_msg);
     do {
         value_msg->header.target_node_id = target_node_id;
@@ -182,7 +210,7 @@ static bool bcmp_config_send_value(uint64_t target_node_id, bcmp_config_partitio
             rval = true;
         }
     } while(0);
-    vPortFree(value_msg);
+    bcmp_msg_free(value_msg);
     return rval;
 }
 
@@ -198,13 +226,13 @@ static void bcmp_config_process_config_get_msg(bcmp_config_get_t *msg){
             break;
         }
         size_t buffer_len = cfg::MAX_STR_LEN_BYTES;
-        uint8_t * buffer = (uint8_t *) pvPortMalloc(buffer_len);
+        uint8_t * buffer = (uint8_t *) bcmp_msg_alloc(buffer_len);
         configASSERT(buffer);
         if(cfg->getConfigCbor(msg->key,msg->key_length, buffer, buffer_len)){
             err_t err;
             bcmp_config_send_value(msg->header.source_node_id,msg->partition, buffer_len, buffer, err);
         }
-        vPortFree(buffer);
+        bcmp_msg_free(buffer);
     } while(0);
 }
 
@@ -249,7 +277,7 @@ static void bcmp_process_value_message(bcmp_config_value_t * msg) {
                 if(cbor_value_get_uint64(&it,&temp) != CborNoError){
                     break;
                 }   
-                printf("Node Id: %" PRIx64 " Value:%" PRIu32 "\n", msg->header.source_node_id, temp);
+                printf("Node Id: %" PRIx64 " Value:%" PRIu64 "\n", msg->header.source_node_id, temp);
                 break;
             }
             case cfg::ConfigDataTypes_e::INT32 : {
@@ -270,7 +298,7 @@ static void bcmp_process_value_message(bcmp_config_value_t * msg) {
             }
             case cfg::ConfigDataTypes_e::STR : {
                 size_t buffer_len = cfg::MAX_STR_LEN_BYTES;
-                char * buffer = (char *) pvPortMalloc(buffer_len);
+                char * buffer = (char *) bcmp_msg_alloc(buffer_len);
                 configASSERT(buffer);
                 do {
                     if(cbor_value_copy_text_string(&it,buffer, &buffer_len, NULL) != CborNoError){
@@ -282,12 +310,12 @@ static void bcmp_process_value_message(bcmp_config_value_t * msg) {
                     buffer[buffer_len] = '\0';
                     printf("Node Id: %" PRIx64 " Value:%s\n", msg->header.source_node_id, buffer);
                 } while(0);
-                vPortFree(buffer);
+                bcmp_msg_free(buffer);
                 break;
             }
             case cfg::ConfigDataTypes_e::BYTES: {
                 size_t buffer_len = cfg::MAX_STR_LEN_BYTES;
-                uint8_t * buffer = (uint8_t *) pvPortMalloc(buffer_len);
+                uint8_t * buffer = (uint8_t *) bcmp_msg_alloc(buffer_len);
                 configASSERT(buffer);
                 do {
                     if(cbor_value_copy_byte_string(&it,buffer, &buffer_len, NULL) != CborNoError){
@@ -302,28 +330,28 @@ static void bcmp_process_value_message(bcmp_config_value_t * msg) {
                     }
                     printf("\n");
                 } while(0);
-                vPortFree(buffer);
+                bcmp_msg_free(buffer);
                 break;
             }
         }
     } while(0);
 }
 
-bool bcmp_config_del_key(uint64_t target_node_id, bcmp_config_partition_e partition, size_t key_len, const char * key) {
+bool bcmp_config_del_key(uint64_t target_node_id, bcmp_config_partition_e partition, size_t key_len, const char * key, bcmp_txn_cb_t cb, void *arg) {
     configASSERT(key);
     bool rval = false;
     size_t msg_size = sizeof(bcmp_config_delete_key_request_t) + key_len;
-    bcmp_config_delete_key_request_t * del_msg = (bcmp_config_delete_key_request_t * )pvPortMalloc(msg_size);
+    bcmp_config_delete_key_request_t * del_msg = (bcmp_config_delete_key_request_t * )bcmp_msg_alloc(msg_size);
     configASSERT(del_msg);
     del_msg->header.target_node_id = target_node_id;
     del_msg->header.source_node_id = getNodeId();
     del_msg->partition = partition;
     del_msg->key_length = key_len;
     memcpy(del_msg->key, key, key_len);
-    if(bcmp_tx(&multicast_ll_addr, BCMP_CONFIG_DELETE_REQUEST, reinterpret_cast<uint8_t*>(del_msg), msg_size) == ERR_OK) {
+    if(bcmp_config_tx(BCMP_CONFIG_DELETE_REQUEST, BCMP_CONFIG_DELETE_RESPONSE, target_node_id, del_msg, msg_size, cb, arg) == ERR_OK) {
         rval = true;
     }
-    vPortFree(del_msg);
+    bcmp_msg_free(del_msg);
     return rval;
 }
 
@@ -331,7 +359,7 @@ static bool bcmp_config_send_del_key_response(uint64_t target_node_id, bcmp_conf
     configASSERT(key);
     bool rval = false;
     size_t msg_size = sizeof(bcmp_config_delete_key_response_t) + key_len;
-    bcmp_config_delete_key_response_t * del_resp = (bcmp_config_delete_key_response_t * )pvPortMalloc(msg_size);
+    bcmp_config_delete_key_response_t * del_resp = (bcmp_config_delete_key_response_t * )bcmp_msg_alloc(msg_size);
     configASSERT(del_resp);
     del_resp->header.target_node_id = target_node_id;
     del_resp->header.source_node_id = getNodeId();
@@ -342,7 +370,7 @@ static bool bcmp_config_send_del_key_response(uint64_t target_node_id, bcmp_conf
     if(bcmp_tx(&multicast_ll_addr, BCMP_CONFIG_DELETE_RESPONSE, reinterpret_cast<uint8_t*>(del_resp), msg_size) == ERR_OK) {
         rval = true;
     }
-    vPortFree(del_resp);
+    bcmp_msg_free(del_resp);
     return rval;
 }
 
@@ -366,20 +394,30 @@ static void bcmp_process_del_request_message(bcmp_config_delete_key_request_t *
 
 static void bcmp_process_del_response_message(bcmp_config_delete_key_response_t * msg) {
     configASSERT(msg);
-    char * keyprintbuf = (char * )pvPortMalloc(msg->key_length + 1); 
+    char * keyprintbuf = (char * )bcmp_msg_alloc(msg->key_length + 1); 
     memcpy(keyprintbuf, msg->key, msg->key_length);
     keyprintbuf[msg->key_length] = '\0';
     printf("Node Id:%" PRIx64 " Key Delete Response - Key: %s, Partition: %d, Success %d\n", msg->header.source_node_id,
             keyprintbuf, msg->partition, msg->success);
-    vPortFree(keyprintbuf);
+    bcmp_msg_free(keyprintbuf);
 }
 
-void bcmp_process_config_message(bcmp_message_type_t bcmp_msg_type, uint8_t* payload) {
+void bcmp_process_config_message(bcmp_message_type_t bcmp_msg_type, uint8_t* payload, uint16_t len) {
     do {
+        if(len < sizeof(bcmp_config_header_t)) {
+            break;
+        }
         bcmp_config_header_t * msg_header = reinterpret_cast<bcmp_config_header_t *>(payload);
         if(msg_header->target_node_id != getNodeId()){
             break;
         }
+        // Replies someone is waiting for go to them instead of being printed
+        if(((bcmp_msg_type == BCMP_CONFIG_VALUE) ||
+            (bcmp_msg_type == BCMP_CONFIG_STATUS_RESPONSE) ||
+            (bcmp_msg_type == BCMP_CONFIG_DELETE_RESPONSE)) &&
+           bcmp_transaction_process_reply(bcmp_msg_type, msg_header->source_node_id, 0, payload, len)) {
+            break;
+        }
         switch(bcmp_msg_type){
             case BCMP_CONFIG_GET: {
                 bcmp_config_process_config_get_msg(reinterpret_cast<bcmp_config_get_t *>(payload));
@@ -404,13 +442,13 @@ void bcmp_process_config_message(bcmp_message_type_t bcmp_msg_type, uint8_t* pay
                 printf("Num Keys: %d\n",msg->num_keys);
                 bcmp_config_status_key_data_t * key = reinterpret_cast<bcmp_config_status_key_data_t*>(msg->keyData);
                 for(int i = 0; i < msg->num_keys; i++){
-                    char * keybuf = (char *) pvPortMalloc(key->key_length + 1);
+                    char * keybuf = (char *) bcmp_msg_alloc(key->key_length + 1);
                     configASSERT(keybuf);
                     memcpy(keybuf, key->key, key->key_length);
                     keybuf[key->key_length] = '\0';
                     printf("%s\n", keybuf);
                     key += key->key_length + sizeof(bcmp_config_status_key_data_t);
-                    vPortFree(keybuf);
+                    bcmp_msg_free(keybuf);
                 }
                 break;
             }
@@ -44,6 +44,9 @@ err_t bcmp_process_heartbeat(bcmp_heartbeat_t *heartbeat, const ip_addr_t *src,
       bcmp_request_info(neighbor->info.node_id, &multicast_ll_addr);
     }
 
+    // Ports already cleared, so this is the neighbor's plain link-local address
+    neighbor->addr = *src;
+
     // Update times
     neighbor->last_time_since_boot_us = heartbeat->time_since_boot_us;
     neighbor->heartbeat_period_s = heartbeat->liveliness_lease_dur_s;
@@ -4,35 +4,64 @@
 
 #include "bcmp.h"
 #include "bcmp_neighbors.h"
+#include "bcmp_transactions.h"
 #include "device_info.h"
 
-static uint64_t _info_expect_node_id;
-
-/*!
-  Set node id to expect information from. Will print out the information
-  when it is received.
-
-  \param node_id node id to expect device information from
-  \return none
-*/
-void bcmp_expect_info_from_node_id(uint64_t node_id) {
-  // TODO - add expiration and/or callback?
-  _info_expect_node_id = node_id;
-}
+static bool _populate_neighbor_info(bm_neighbor_t *neighbor, const bcmp_device_info_reply_t *dev_info);
 
 /*!
   Send a request for device information.
 
   \param target_node_id - node id of the target we want the information from (0 for all targets)
   \param *addr - ip address to send request to
+  \param cb - called with the reply(ies) (optional). Neighbors' info is
+               updated either way.
+  \param arg - passed to cb
   \return ERR_OK if successful
 */
-err_t bcmp_request_info(uint64_t target_node_id, const ip_addr_t *addr) {
+err_t bcmp_request_info(uint64_t target_node_id, const ip_addr_t *addr, bcmp_txn_cb_t cb, void *arg) {
   bcmp_device_info_request_t info_req = {
     .target_node_id=target_node_id
   };
 
-  return bcmp_tx(addr, BCMP_DEVICE_INFO_REQUEST, (uint8_t *)&info_req, sizeof(info_req));
+  uint32_t txn_id = 0;
+  if(cb) {
+    txn_id = bcmp_transaction_start(BCMP_DEVICE_INFO_REPLY, target_node_id, cb, arg);
+    if(!txn_id) {
+      return ERR_MEM;
+    }
+  }
+
+  err_t rval = bcmp_tx(addr, BCMP_DEVICE_INFO_REQUEST, (uint8_t *)&info_req, sizeof(info_req));
+  if((rval != ERR_OK) && txn_id) {
+    bcmp_transaction_cancel(txn_id);
+  }
+
+  return rval;
+}
+
+/*!
+  Transaction callback that prints device information replies
+
+  \param *result - transaction result
+  \return none
+*/
+void bcmp_info_print_cb(const bcmp_txn_result_t *result) {
+  configASSERT(result);
+
+  if(result->status == BCMP_TXN_REPLY) {
+    // Create temporary neighbor struct that is used by the print function
+    bm_neighbor_t *tmp_neighbor = bcmp_alloc_neighbor();
+    configASSERT(tmp_neighbor);
+
+    _populate_neighbor_info(tmp_neighbor, reinterpret_cast<const bcmp_device_info_reply_t *>(result->reply));
+    bcmp_print_neighbor_info(tmp_neighbor);
+
+    // Clean up
+    configASSERT(bcmp_free_neighbor(tmp_neighbor));
+  } else if((result->status == BCMP_TXN_TIMEOUT) && !result->num_replies) {
+    printf("No device information received\n");
+  }
 }
 
 #define VER_STR_MAX_LEN (255)
@@ -119,7 +148,7 @@ err_t bcmp_process_info_request(bcmp_device_info_request_t *info_req, const ip_a
   \param *dev_info - device info to populate with
   \return true if successful, false otherwise
 */
-static bool _populate_neighbor_info(bm_neighbor_t *neighbor, bcmp_device_info_reply_t *dev_info){
+static bool _populate_neighbor_info(bm_neighbor_t *neighbor, const bcmp_device_info_reply_t *dev_info){
   bool rval = false;
   if(neighbor) {
     memcpy(&neighbor->info, &dev_info->info, sizeof(bcmp_device_info_t));
@@ -157,11 +186,17 @@ static bool _populate_neighbor_info(bm_neighbor_t *neighbor, bcmp_device_info_re
   Process device information reply
 
   \param *dev_info - device information data
+  \param len - message length
   \return ERR_OK
 */
-err_t bcmp_process_info_reply(bcmp_device_info_reply_t *dev_info) {
+err_t bcmp_process_info_reply(bcmp_device_info_reply_t *dev_info, uint16_t len) {
   configASSERT(dev_info);
 
+  if((len < sizeof(bcmp_device_info_reply_t)) ||
+     (len < sizeof(bcmp_device_info_reply_t) + dev_info->ver_str_len + dev_info->dev_name_len)) {
+    return ERR_VAL;
+  }
+
   //
   // Find neighbor and add info to table if present
   // Only add neighbor info when received to link local multicast address
@@ -170,19 +205,9 @@ err_t bcmp_process_info_reply(bcmp_device_info_reply_t *dev_info) {
   if(neighbor) {
     // Update neighbor info
     _populate_neighbor_info(neighbor, dev_info);
-  } else if (_info_expect_node_id && (dev_info->info.node_id == _info_expect_node_id)) {
-    _info_expect_node_id = 0;
-
-    // Create temporary neighbor struct that is used by the print function
-    bm_neighbor_t *tmp_neighbor = (bm_neighbor_t *)pvPortMalloc(sizeof(bm_neighbor_t));
-    memset(tmp_neighbor, 0, sizeof(bm_neighbor_t));
-
-    _populate_neighbor_info(tmp_neighbor, dev_info);
-    bcmp_print_neighbor_info(tmp_neighbor);
-
-    // Clean up
-    configASSERT(bcmp_free_neighbor(tmp_neighbor));
   }
 
+  bcmp_transaction_process_reply(BCMP_DEVICE_INFO_REPLY, dev_info->info.node_id, 0, reinterpret_cast<uint8_t *>(dev_info), len);
+
   return ERR_OK;
 }
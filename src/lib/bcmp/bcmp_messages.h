@@ -259,11 +259,26 @@ typedef struct {
   uint64_t target_node_id;
 } __attribute__((packed)) bcmp_netstat_request_t;
 
+typedef struct {
+  // Counter value
+  uint32_t value;
+
+  // Length of counter name (without terminator)
+  uint8_t name_len;
+
+  // Counter name ("group.name")
+  char name[0];
+} __attribute__((packed)) bcmp_netstat_counter_t;
+
 typedef struct {
   // Node ID of the responding node
   uint64_t node_id;
 
-  // TODO - add node info here
+  // Number of bcmp_netstat_counter_t entries in counters
+  uint8_t num_counters;
+
+  // Variable length counters (bcmp_netstat_counter_t)
+  uint8_t counters[0];
 } __attribute__((packed)) bcmp_netstat_reply_t;
 
 typedef struct {
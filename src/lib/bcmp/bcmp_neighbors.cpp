@@ -6,12 +6,17 @@
 #include "bcmp_info.h"
 #include "bcmp_neighbors.h"
 #include "device_info.h"
+#include "mem_pool.h"
 #include "util.h"
 
 // Pointer to neighbor linked-list
 static bm_neighbor_t *_neighbors;
 static uint8_t _num_neighbors = 0;
 
+// One neighbor per port, plus room for temporary entries (bcmp_info)
+#define NEIGHBOR_POOL_SIZE  (4)
+MEM_POOL_DEFINE(bcmp_neighbors, sizeof(bm_neighbor_t), NEIGHBOR_POOL_SIZE, true);
+
 /*
   Accessor to latest the neighbor linked-list and nieghbor count
 
@@ -84,6 +89,20 @@ void bcmp_check_neighbors() {
   bcmp_neighbor_foreach(_neighbor_check);
 }
 
+/*!
+  Allocate a zeroed neighbor entry. Free with bcmp_free_neighbor()
+
+  \return pointer to neighbor, NULL if out of memory
+*/
+bm_neighbor_t *bcmp_alloc_neighbor() {
+  bm_neighbor_t *neighbor = static_cast<bm_neighbor_t *>(memPoolAlloc(&bcmp_neighbors));
+  if(neighbor) {
+    memset(neighbor, 0, sizeof(bm_neighbor_t));
+  }
+
+  return neighbor;
+}
+
 /*!
   Add neighbor to neigbhor table
 
@@ -92,11 +111,9 @@ void bcmp_check_neighbors() {
   \return pointer to neighbor if successful, NULL otherwise (if neighbor is already present, for example)
 */
 static bm_neighbor_t *bcmp_add_neighbor(uint64_t node_id, uint8_t port) {
-  bm_neighbor_t *new_neighbor = static_cast<bm_neighbor_t *>(pvPortMalloc(sizeof(bm_neighbor_t)));
+  bm_neighbor_t *new_neighbor = bcmp_alloc_neighbor();
   configASSERT(new_neighbor);
 
-  memset(new_neighbor, 0, sizeof(bm_neighbor_t));
-
   new_neighbor->node_id = node_id;
   new_neighbor->port = port;
 
@@ -121,7 +138,7 @@ static bm_neighbor_t *bcmp_add_neighbor(uint64_t node_id, uint8_t port) {
     if(neighbor != NULL) {
       neighbor->next = new_neighbor;
     } else {
-      vPortFree(new_neighbor);
+      memPoolFree(&bcmp_neighbors, new_neighbor);
       new_neighbor = NULL;
     }
   }
@@ -167,7 +184,7 @@ bool bcmp_free_neighbor(bm_neighbor_t *neighbor) {
       vPortFree(neighbor->device_name);
     }
 
-    vPortFree(neighbor);
+    memPoolFree(&bcmp_neighbors, neighbor);
     rval = true;
   }
 
@@ -9,7 +9,7 @@ typedef struct bm_neighbor_s {
   // Pointer to next neighbor
   struct bm_neighbor_s *next;
 
-  // Neighbor link-local address (do we need this?)
+  // Neighbor link-local address (from its heartbeats)
   ip_addr_t addr;
 
   uint64_t node_id;
@@ -45,6 +45,7 @@ bm_neighbor_t* bcmp_get_neighbors(uint8_t &num_neighbors);
 void bcmp_check_neighbors();
 void bcmp_print_neighbor_info(bm_neighbor_t *neighbor);
 bool bcmp_remove_neighbor_from_table(bm_neighbor_t *neighbor);
+bm_neighbor_t *bcmp_alloc_neighbor();
 bool bcmp_free_neighbor(bm_neighbor_t *neighbor);
 bm_neighbor_t *bcmp_find_neighbor(uint64_t node_id);
 bm_neighbor_t *bcmp_update_neighbor(uint64_t node_id, uint8_t port);
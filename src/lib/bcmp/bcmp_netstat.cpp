@@ -0,0 +1,127 @@
+#include <inttypes.h>
+#include <string.h>
+#include "FreeRTOS.h"
+
+#include "bcmp.h"
+#include "bcmp_netstat.h"
+#include "device_info.h"
+#include "perf_counters.h"
+#include "util.h"
+
+// Keep replies to a single frame
+#define NETSTAT_REPLY_MAX_LEN (1024)
+#define NETSTAT_NAME_MAX_LEN (48)
+
+/*!
+  Request performance counters from a node
+
+  \param target_node_id - node id to request counters from (0 for all nodes)
+  \param *addr - ip address to send the request to
+  \return ERR_OK if successful
+*/
+err_t bcmp_request_netstat(uint64_t target_node_id, const ip_addr_t *addr) {
+  bcmp_netstat_request_t netstat_req = {
+    .target_node_id = target_node_id
+  };
+
+  return bcmp_tx(addr, BCMP_NET_STAT_REQUEST, reinterpret_cast<uint8_t *>(&netstat_req), sizeof(netstat_req));
+}
+
+/*!
+  Send all registered performance counters. If they don't all fit in one
+  reply, the ones that don't fit are left out.
+
+  \param *dst - ip address to send the reply to
+  \return ERR_OK if successful
+*/
+static err_t bcmp_send_netstat(const ip_addr_t *dst) {
+  uint8_t *reply_buff = static_cast<uint8_t *>(pvPortMalloc(NETSTAT_REPLY_MAX_LEN));
+  configASSERT(reply_buff);
+
+  bcmp_netstat_reply_t *reply = reinterpret_cast<bcmp_netstat_reply_t *>(reply_buff);
+  reply->node_id = getNodeId();
+  reply->num_counters = 0;
+
+  perfCountersSample();
+
+  uint16_t offset = sizeof(bcmp_netstat_reply_t);
+  for(perfCounter_t *counter = perfCountersFirst(); counter && (reply->num_counters < UINT8_MAX); counter = counter->next) {
+    char name[NETSTAT_NAME_MAX_LEN];
+    int name_len = snprintf(name, sizeof(name), "%s.%s", counter->group, counter->name);
+    if(name_len <= 0) {
+      continue;
+    }
+    name_len = MIN(name_len, static_cast<int>(sizeof(name) - 1));
+
+    if((offset + sizeof(bcmp_netstat_counter_t) + name_len) > NETSTAT_REPLY_MAX_LEN) {
+      break;
+    }
+
+    bcmp_netstat_counter_t *entry = reinterpret_cast<bcmp_netstat_counter_t *>(&reply_buff[offset]);
+    entry->value = counter->value;
+    entry->name_len = static_cast<uint8_t>(name_len);
+    memcpy(entry->name, name, name_len);
+
+    offset += sizeof(bcmp_netstat_counter_t) + name_len;
+    reply->num_counters++;
+  }
+
+  err_t rval = bcmp_tx(dst, BCMP_NET_STAT_REPLY, reply_buff, offset);
+
+  vPortFree(reply_buff);
+
+  return rval;
+}
+
+/*!
+  Process performance counter request
+
+  \param *netstat_req - request
+  \param *dst - destination address the request was sent to (reply is sent there too)
+  \return ERR_OK if successful
+*/
+err_t bcmp_process_netstat_request(bcmp_netstat_request_t *netstat_req, const ip_addr_t *dst) {
+  configASSERT(netstat_req);
+
+  err_t rval = ERR_OK;
+  if((netstat_req->target_node_id == 0) || (getNodeId() == netstat_req->target_node_id)) {
+    rval = bcmp_send_netstat(dst);
+  }
+
+  return rval;
+}
+
+/*!
+  Process (print) performance counter reply
+
+  \param *netstat_reply - reply
+  \param len - reply length
+  \return ERR_OK if successful, ERR_VAL if the reply is malformed
+*/
+err_t bcmp_process_netstat_reply(bcmp_netstat_reply_t *netstat_reply, uint16_t len) {
+  configASSERT(netstat_reply);
+
+  if(len < sizeof(bcmp_netstat_reply_t)) {
+    return ERR_VAL;
+  }
+
+  printf("Performance counters from %016" PRIx64 ":\n", netstat_reply->node_id);
+
+  uint16_t offset = sizeof(bcmp_netstat_reply_t);
+  const uint8_t *reply_buff = reinterpret_cast<const uint8_t *>(netstat_reply);
+  for(uint8_t idx = 0; idx < netstat_reply->num_counters; idx++) {
+    if((offset + sizeof(bcmp_netstat_counter_t)) > len) {
+      return ERR_VAL;
+    }
+
+    const bcmp_netstat_counter_t *entry = reinterpret_cast<const bcmp_netstat_counter_t *>(&reply_buff[offset]);
+    if((offset + sizeof(bcmp_netstat_counter_t) + entry->name_len) > len) {
+      return ERR_VAL;
+    }
+
+    printf("  %.*s: %" PRIu32 "\n", entry->name_len, entry->name, entry->value);
+    offset += sizeof(bcmp_netstat_counter_t) + entry->name_len;
+  }
+
+  return ERR_OK;
+}
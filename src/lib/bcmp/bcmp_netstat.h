@@ -0,0 +1,9 @@
+#pragma once
+
+#include <stdint.h>
+#include "lwip/ip_addr.h"
+#include "bcmp_messages.h"
+
+err_t bcmp_request_netstat(uint64_t target_node_id, const ip_addr_t *addr);
+err_t bcmp_process_netstat_request(bcmp_netstat_request_t *netstat_req, const ip_addr_t *dst);
+err_t bcmp_process_netstat_reply(bcmp_netstat_reply_t *netstat_reply, uint16_t len);
@@ -5,13 +5,42 @@
 #include "bcmp.h"
 #include "bcmp_neighbors.h"
 #include "bcmp_ping.h"
+#include "bcmp_transactions.h"
 #include "device_info.h"
-#include "uptime.h"
 
-static uint64_t _ping_request_time;
-static uint32_t _bcmp_seq;
-static uint8_t* _expected_payload = NULL;
-static uint16_t _expected_payload_len = 0;
+// Payload the reply(ies) to a ping request must echo back
+typedef struct {
+  uint16_t len;
+  uint8_t payload[0];
+} bcmp_ping_expected_t;
+
+static uint16_t _bcmp_seq;
+
+/*!
+  Check ping replies and print them
+
+  \param *result - transaction result (arg is the expected payload)
+  \return none
+*/
+static void _ping_reply_cb(const bcmp_txn_result_t *result) {
+  bcmp_ping_expected_t *expected = static_cast<bcmp_ping_expected_t *>(result->arg);
+
+  if(result->status == BCMP_TXN_REPLY) {
+    const bcmp_echo_reply_t *echo_reply = reinterpret_cast<const bcmp_echo_reply_t *>(result->reply);
+    if((echo_reply->payload_len != expected->len) ||
+       (memcmp(expected->payload, echo_reply->payload, expected->len) != 0)) {
+      printf("Bad ping payload from %" PRIx64 "\n", echo_reply->node_id);
+    } else {
+      printf("🏓 %" PRIu16 " bytes from %" PRIx64 " bcmp_seq=%" PRIu16 " time=%" PRIu32 " ms\n", echo_reply->payload_len, echo_reply->node_id, echo_reply->seq_num, result->elapsed_ms);
+    }
+  } else if((result->status == BCMP_TXN_TIMEOUT) && !result->num_replies) {
+    printf("Ping timed out\n");
+  }
+
+  if(result->done) {
+    vPortFree(expected);
+  }
+}
 
 /*!
   Send ping to node(s)
@@ -28,9 +57,13 @@ err_t bcmp_send_ping_request(uint64_t node_id, const ip_addr_t *addr, const uint
     payload_len = 0;
   }
 
+  bcmp_ping_expected_t *expected = static_cast<bcmp_ping_expected_t *>(pvPortMalloc(sizeof(bcmp_ping_expected_t) + payload_len));
+  configASSERT(expected);
+  expected->len = payload_len;
+
   uint16_t echo_len = sizeof(bcmp_echo_request_t) + payload_len;
 
-  uint8_t *echo_req_buff = static_cast<uint8_t *>(pvPortMalloc(echo_len));
+  uint8_t *echo_req_buff = static_cast<uint8_t *>(bcmp_msg_alloc(echo_len));
   configASSERT(echo_req_buff);
 
   memset(echo_req_buff, 0, echo_len);
@@ -42,28 +75,29 @@ err_t bcmp_send_ping_request(uint64_t node_id, const ip_addr_t *addr, const uint
   echo_req->seq_num = _bcmp_seq++;
   echo_req->payload_len = payload_len;
 
-  // clear the expected payload
-  if (_expected_payload != NULL) {
-      vPortFree(_expected_payload);
-      _expected_payload = NULL;
-      _expected_payload_len = 0;
-  }
-
   // Lets only copy the paylaod if it isn't NULL just in case
   if (payload != NULL && payload_len > 0) {
     memcpy(&echo_req->payload[0], payload, payload_len);
-    _expected_payload = static_cast<uint8_t*>(pvPortMalloc(payload_len));
-    memcpy(_expected_payload, payload, payload_len);
-    _expected_payload_len = payload_len;
+    memcpy(expected->payload, payload, payload_len);
   }
 
   printf("PING (%" PRIx64 "): %" PRIu16 " data bytes\n", echo_req->target_node_id, echo_req->payload_len);
 
-  err_t rval = bcmp_tx(addr, BCMP_ECHO_REQUEST, reinterpret_cast<uint8_t*>(echo_req), echo_len);
-
-  _ping_request_time = uptimeGetMicroSeconds();
+  // Replies are matched by id/seq, so any number of pings can be in flight
+  err_t rval = ERR_MEM;
+  uint32_t txn_id = bcmp_transaction_start_keyed(BCMP_ECHO_REPLY, node_id,
+                                                 ((uint32_t)echo_req->id << 16) | echo_req->seq_num,
+                                                 _ping_reply_cb, expected);
+  if(txn_id) {
+    rval = bcmp_tx(addr, BCMP_ECHO_REQUEST, reinterpret_cast<uint8_t*>(echo_req), echo_len);
+    if(rval != ERR_OK) {
+      bcmp_transaction_cancel(txn_id);
+    }
+  } else {
+    vPortFree(expected);
+  }
 
-  vPortFree(echo_req_buff);
+  bcmp_msg_free(echo_req_buff);
 
   return rval;
 }
@@ -103,17 +137,16 @@ err_t bcmp_process_ping_request(bcmp_echo_request_t *echo_req, const ip_addr_t *
   Handle Ping replies
 
   \param *echo_reply - echo reply message to process
-  \param *src - source ip of requester
-  \param *dst - destination ip of request (used for responding to the correct multicast address)
-  \
+  \param len - message length
+  \return ERR_OK if the reply was for one of our requests
   */
-err_t bcmp_process_ping_reply(bcmp_echo_reply_t *echo_reply){
+err_t bcmp_process_ping_reply(bcmp_echo_reply_t *echo_reply, uint16_t len){
   configASSERT(echo_reply);
 
   err_t rval = ERR_VAL;
 
   do {
-    if (_expected_payload_len != echo_reply->payload_len) {
+    if ((len < sizeof(bcmp_echo_reply_t)) || (len < sizeof(bcmp_echo_reply_t) + echo_reply->payload_len)) {
       break;
     }
 
@@ -122,14 +155,12 @@ err_t bcmp_process_ping_reply(bcmp_echo_reply_t *echo_reply){
       break;
     }
 
-    if (_expected_payload != NULL) {
-      if (memcmp(_expected_payload, echo_reply->payload, echo_reply->payload_len) != 0){
-        break;
-      }
+    if (!bcmp_transaction_process_reply(BCMP_ECHO_REPLY, echo_reply->node_id,
+                                        ((uint32_t)echo_reply->id << 16) | echo_reply->seq_num,
+                                        reinterpret_cast<uint8_t *>(echo_reply), len)) {
+      break;
     }
 
-    uint64_t diff = uptimeGetMicroSeconds() - _ping_request_time;
-    printf("🏓 %" PRIu16 " bytes from %" PRIx64 " bcmp_seq=%" PRIu32 " time=%" PRIu64 " ms\n", echo_reply->payload_len, echo_reply->node_id, echo_reply->seq_num, diff/1000);
     rval = ERR_OK;
 
   } while (0);
@@ -5,6 +5,7 @@
 #include <stdlib.h>
 #include "device_info.h"
 #include "bcmp.h"
+#include "bcmp_transactions.h"
 
 using namespace bcmp_resource_discovery;
 
@@ -23,6 +24,9 @@ typedef struct bcmp_resource_list_t {
 static bcmp_resource_list_t _pub_list;
 static bcmp_resource_list_t _sub_list;
 
+// Called with every resource table we receive (solicited or not)
+static bcmp_resource_table_cb_t _table_cb;
+
 static bool _bcmp_resource_discovery_find_resource(const char * resource, const uint16_t resource_len, resource_type_e type);
 static bool _bcmp_resource_compute_list_size(resource_type_e type, size_t &msg_len);
 static bool _bcmp_resource_populate_msg_data(resource_type_e type, bcmp_resource_table_reply_t * repl, uint32_t &data_offset);
@@ -70,17 +74,14 @@ static bool _bcmp_resource_populate_msg_data(resource_type_e type, bcmp_resource
 
 
 /*!
-  Process the resource discovery request message.
+  Send our resource table.
 
-  \param in *req - request 
-  \param in *dst - destination IP to reply to. 
-  \return - None
+  \param in *dst - destination IP
+  \return - true on success, false otherwise
 */
-void bcmp_resource_discovery::bcmp_process_resource_discovery_request(bcmp_resource_table_request_t *req, const ip_addr_t *dst) {
+static bool _bcmp_resource_send_table(const ip_addr_t *dst) {
+    bool rval = false;
     do {
-        if(req->target_node_id != getNodeId()){
-            break;
-        }
         size_t msg_len = sizeof(bcmp_resource_table_reply_t);
         if(!_bcmp_resource_compute_list_size(PUB, msg_len)) {
             printf("Failed to get publishers list\n.");
@@ -107,42 +108,100 @@ void bcmp_resource_discovery::bcmp_process_resource_discovery_request(bcmp_resou
             }
             if(bcmp_tx(dst, BCMP_RESOURCE_TABLE_REPLY, reply_buf, msg_len) != ERR_OK){
                 printf("Failed to send bcmp resource table reply\n");
+                break;
             }
+            rval = true;
         } while(0);
         vPortFree(reply_buf);
     } while(0);
+    return rval;
 }
 
 /*!
-  Process the resource discovery reply message.
+  Process the resource discovery request message.
 
-  \param in *repl - reply 
-  \param in src_node_id - node ID of the source. 
+  \param in *req - request 
+  \param in *dst - destination IP to reply to. 
   \return - None
 */
-void bcmp_resource_discovery::bcmp_process_resource_discovery_reply(bcmp_resource_table_reply_t *repl, uint64_t src_node_id) {
+void bcmp_resource_discovery::bcmp_process_resource_discovery_request(bcmp_resource_table_request_t *req, const ip_addr_t *dst) {
     do {
-        if(repl->node_id != src_node_id){
+        // Zeroed target means all nodes
+        if(req->target_node_id && (req->target_node_id != getNodeId())){
+            break;
+        }
+        _bcmp_resource_send_table(dst);
+    } while(0);
+}
+
+/*!
+  Transaction callback that prints the resource tables we asked for.
+
+  \param in *result - transaction result
+  \return - None
+*/
+static void _bcmp_resource_print_cb(const bcmp_txn_result_t *result) {
+    do {
+        if(result->status != BCMP_TXN_REPLY) {
+            if((result->status == BCMP_TXN_TIMEOUT) && !result->num_replies) {
+                printf("No resource table received\n");
+            }
+            break;
+        }
+        if(result->reply_len < sizeof(bcmp_resource_table_reply_t)) {
             break;
         }
-        printf("Node Id %" PRIx64 " resource table:\n", src_node_id);
-        uint16_t num_pubs = repl->num_pubs;
+        const bcmp_resource_table_reply_t *repl = reinterpret_cast<const bcmp_resource_table_reply_t *>(result->reply);
+        size_t list_len = result->reply_len - sizeof(bcmp_resource_table_reply_t);
+        uint32_t num_resources = (uint32_t)repl->num_pubs + repl->num_subs;
         size_t offset = 0;
+        printf("Node Id %" PRIx64 " resource table:\n", result->node_id);
         printf("\tPublishers:\n");
-        while(num_pubs){
-            bcmp_resource_t * cur_resource = reinterpret_cast<bcmp_resource_t *>(&repl->resource_list[offset]);
+        for(uint32_t idx = 0; idx < num_resources; idx++) {
+            if(idx == repl->num_pubs) {
+                printf("\tSubscribers:\n");
+            }
+            // Every entry has to fit in the reply
+            if((offset + sizeof(bcmp_resource_t)) > list_len) {
+                printf("\t(truncated)\n");
+                break;
+            }
+            const bcmp_resource_t * cur_resource = reinterpret_cast<const bcmp_resource_t *>(&repl->resource_list[offset]);
+            if((offset + sizeof(bcmp_resource_t) + cur_resource->resource_len) > list_len) {
+                printf("\t(truncated)\n");
+                break;
+            }
             printf("\t* %.*s\n",cur_resource->resource_len, cur_resource->resource);
             offset += (sizeof(bcmp_resource_t) + cur_resource->resource_len);
-            num_pubs--;
         }
-        uint16_t num_subs = repl->num_subs;
-        printf("\tSubscribers:\n");
-        while(num_subs){
-            bcmp_resource_t * cur_resource = reinterpret_cast<bcmp_resource_t *>(&repl->resource_list[offset]);
-            printf("\t* %.*s\n",cur_resource->resource_len, cur_resource->resource);
-            offset += (sizeof(bcmp_resource_t) + cur_resource->resource_len);
-            num_subs--;
+        if(!repl->num_subs) {
+            printf("\tSubscribers:\n");
+        }
+    } while(0);
+}
+
+/*!
+  Process the resource discovery reply message.
+
+  \param in *repl - reply 
+  \param in len - reply length
+  \param in src_node_id - node ID of the source. 
+  \return - None
+*/
+void bcmp_resource_discovery::bcmp_process_resource_discovery_reply(bcmp_resource_table_reply_t *repl, uint16_t len, uint64_t src_node_id) {
+    do {
+        if(len < sizeof(bcmp_resource_table_reply_t)) {
+            break;
+        }
+        if(repl->node_id != src_node_id){
+            break;
+        }
+        if(_table_cb) {
+            _table_cb(repl, len);
         }
+        // Tables are also announced to everyone periodically, only the ones
+        // we asked for go to a transaction
+        bcmp_transaction_process_reply(BCMP_RESOURCE_TABLE_REPLY, src_node_id, 0, reinterpret_cast<uint8_t *>(repl), len);
     } while(0);
 }
 
@@ -209,6 +268,10 @@ bool bcmp_resource_discovery::bcmp_resource_discovery_add_resource(const char *
         } while(0);
         xSemaphoreGive(res_list->lock);
     }
+    if(rval && (type == SUB)) {
+        // Let publishers know right away instead of at the next announcement
+        bcmp_resource_discovery_announce();
+    }
     return rval;
 }
 
@@ -256,17 +319,45 @@ bool bcmp_resource_discovery::bcmp_resource_discovery_find_resource(const char *
 /*!
   Send a bcmp resource discovery request to a node.
 
-  \param in target_node_id - requested node id
+  \param in target_node_id - requested node id (0 for all nodes)
+  \param in cb - called with the reply(ies), NULL to print them
+  \param in arg - passed to cb
   \return - true on success, false otherwise
 */
-bool bcmp_resource_discovery::bcmp_resource_discovery_send_request(uint64_t target_node_id) {
+bool bcmp_resource_discovery::bcmp_resource_discovery_send_request(uint64_t target_node_id, bcmp_txn_cb_t cb, void *arg) {
     bool rval = false;
     do {
         bcmp_resource_table_request_t req = {
             .target_node_id = target_node_id,
         };
+        uint32_t txn_id = bcmp_transaction_start(BCMP_RESOURCE_TABLE_REPLY, target_node_id, cb ? cb : _bcmp_resource_print_cb, arg);
+        if(!txn_id) {
+            break;
+        }
         if(bcmp_tx(&multicast_ll_addr, BCMP_RESOURCE_TABLE_REQUEST, reinterpret_cast<uint8_t *>(&req), sizeof(req)) != ERR_OK){
             printf("Failed to send bcmp resource table reply\n");
+            bcmp_transaction_cancel(txn_id);
+            break;
+        }
+        rval = true;
+    } while(0);
+    return rval;
+}
+
+/*!
+  Ask every node in the network for its resource table. Replies go to the
+  table callback (and aren't printed).
+
+  \return - true on success, false otherwise
+*/
+bool bcmp_resource_discovery::bcmp_resource_discovery_request_all(void) {
+    bool rval = false;
+    do {
+        bcmp_resource_table_request_t req = {
+            .target_node_id = 0,
+        };
+        if(bcmp_tx(&multicast_global_addr, BCMP_RESOURCE_TABLE_REQUEST, reinterpret_cast<uint8_t *>(&req), sizeof(req)) != ERR_OK){
+            printf("Failed to send bcmp resource table request\n");
             break;
         }
         rval = true;
@@ -274,6 +365,27 @@ bool bcmp_resource_discovery::bcmp_resource_discovery_send_request(uint64_t targ
     return rval;
 }
 
+/*!
+  Send our resource table to every node in the network (unsolicited reply),
+  so publishers know who subscribes to what.
+
+  \return - true on success, false otherwise
+*/
+bool bcmp_resource_discovery::bcmp_resource_discovery_announce(void) {
+    return _bcmp_resource_send_table(&multicast_global_addr);
+}
+
+/*!
+  Set the function called with every resource table received. The table is
+  only checked for its header, the callback must bound the resource list by len.
+
+  \param in cb - callback, NULL to remove
+  \return - None
+*/
+void bcmp_resource_discovery::bcmp_resource_discovery_set_table_cb(bcmp_resource_table_cb_t cb) {
+    _table_cb = cb;
+}
+
 /*!
   Print the resources in the table.
 
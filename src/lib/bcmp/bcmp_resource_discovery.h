@@ -1,5 +1,7 @@
 #pragma once
 #include "bcmp_messages.h"
+#include "bcmp_txn_table.h"
+#include <stddef.h>
 #include <stdint.h>
 #include "lwip/ip_addr.h"
 
@@ -7,18 +9,26 @@ namespace bcmp_resource_discovery {
 
 #define DEFAULT_RESOURCE_ADD_TIMEOUT_MS (100)
 
+// Announce our resource table every this many heartbeats
+#define BCMP_RESOURCE_ANNOUNCE_HEARTBEATS (6)
+
 typedef enum {
     PUB,
     SUB
 } resource_type_e;
 
+typedef void (*bcmp_resource_table_cb_t)(const bcmp_resource_table_reply_t *repl, uint16_t len);
+
 void bcmp_process_resource_discovery_request(bcmp_resource_table_request_t *req, const ip_addr_t *dst);
-void bcmp_process_resource_discovery_reply(bcmp_resource_table_reply_t *repl,  uint64_t source_id);
+void bcmp_process_resource_discovery_reply(bcmp_resource_table_reply_t *repl, uint16_t len, uint64_t source_id);
 void bcmp_resource_discovery_init(void);
 bool bcmp_resource_discovery_add_resource(const char * res, const uint16_t resource_len, resource_type_e type, uint32_t timeoutMs=DEFAULT_RESOURCE_ADD_TIMEOUT_MS);
 bool bcmp_resource_discovery_get_num_resources(uint16_t& num_resources, resource_type_e type, uint32_t timeoutMs);
 bool bcmp_resource_discovery_find_resource(const char * res, const uint16_t resource_len, bool &found, resource_type_e type, uint32_t timeoutMs);
-bool bcmp_resource_discovery_send_request(uint64_t target_node_id);
+bool bcmp_resource_discovery_send_request(uint64_t target_node_id, bcmp_txn_cb_t cb=NULL, void *arg=NULL);
+bool bcmp_resource_discovery_request_all(void);
+bool bcmp_resource_discovery_announce(void);
+void bcmp_resource_discovery_set_table_cb(bcmp_resource_table_cb_t cb);
 void bcmp_resource_discovery_print_resources(void);
 
 }
@@ -1,34 +1,58 @@
 #include "bcmp_time.h"
 #include "bcmp.h"
+#include "bcmp_transactions.h"
 #include "device_info.h"
 #include "stm32_rtc.h"
 #include "util.h"
 
-bool bcmp_time_set_time(uint64_t target_node_id, uint64_t utc_us) {
+/*!
+  Send a time message, waiting for the response if asked to
+
+  \param type - message type
+  \param *msg - message
+  \param len - message length
+  \param target_node_id - node the message is for
+  \param cb - called with the response (optional, the response is printed otherwise)
+  \param arg - passed to cb
+  \return true if sent
+*/
+static bool bcmp_time_send_request(bcmp_message_type_t type, void *msg, uint16_t len, uint64_t target_node_id, bcmp_txn_cb_t cb, void *arg) {
     bool ret = true;
+    uint32_t txn_id = 0;
+    do {
+        if(cb) {
+            txn_id = bcmp_transaction_start(BCMP_SYSTEM_TIME_RESPONSE, target_node_id, cb, arg);
+            if(!txn_id) {
+                ret = false;
+                break;
+            }
+        }
+        if(bcmp_tx(&multicast_ll_addr, type, reinterpret_cast<uint8_t *>(msg), len) != ERR_OK){
+            printf("Failed to send system time request\n");
+            if(txn_id) {
+                bcmp_transaction_cancel(txn_id);
+            }
+            ret = false;
+        }
+    } while(0);
+    return ret;
+}
+
+bool bcmp_time_set_time(uint64_t target_node_id, uint64_t utc_us, bcmp_txn_cb_t cb, void *arg) {
     uint64_t source_node_id = getNodeId();
     bcmp_system_time_set_t set_msg;
     set_msg.header.target_node_id = target_node_id;
     set_msg.header.source_node_id = source_node_id;
     set_msg.utc_time_us = utc_us;
-    if(bcmp_tx(&multicast_ll_addr, BCMP_SYSTEM_TIME_SET, reinterpret_cast<uint8_t *>(&set_msg), sizeof(set_msg)) != ERR_OK){
-        printf("Failed to send system time response\n");
-        ret = false;
-    }
-    return ret;
+    return bcmp_time_send_request(BCMP_SYSTEM_TIME_SET, &set_msg, sizeof(set_msg), target_node_id, cb, arg);
 }
 
-bool bcmp_time_get_time(uint64_t target_node_id) {
-    bool ret = true;
+bool bcmp_time_get_time(uint64_t target_node_id, bcmp_txn_cb_t cb, void *arg) {
     uint64_t source_node_id = getNodeId();
     bcmp_system_time_request_t get_msg;
     get_msg.header.target_node_id = target_node_id;
     get_msg.header.source_node_id = source_node_id;
-    if(bcmp_tx(&multicast_ll_addr, BCMP_SYSTEM_TIME_REQUEST, reinterpret_cast<uint8_t *>(&get_msg), sizeof(get_msg)) != ERR_OK){
-        printf("Failed to send system time response\n");
-        ret = false;
-    }
-    return ret;
+    return bcmp_time_send_request(BCMP_SYSTEM_TIME_REQUEST, &get_msg, sizeof(get_msg), target_node_id, cb, arg);
 }
 
 static void bcmp_time_send_response(uint64_t target_node_id, uint64_t utc_us) {
@@ -65,7 +89,7 @@ static void bcmp_time_process_time_set_msg(const bcmp_system_time_set_t *msg) {
         .hour = datetime.hour,
         .minute = datetime.min,
         .second = datetime.sec,
-        .ms = (datetime.usec / 1000)
+        .ms = static_cast<uint16_t>(datetime.usec / 1000)
     };
     if(rtcSet(&time) == pdPASS) {
         bcmp_time_send_response(msg->header.source_node_id, msg->utc_time_us);
@@ -74,8 +98,11 @@ static void bcmp_time_process_time_set_msg(const bcmp_system_time_set_t *msg) {
     }
 }
 
-void bcmp_time_process_time_message(bcmp_message_type_t bcmp_msg_type, uint8_t* payload) {
+void bcmp_time_process_time_message(bcmp_message_type_t bcmp_msg_type, uint8_t* payload, uint16_t len) {
     do {
+        if(len < sizeof(bcmp_system_time_header_t)) {
+            break;
+        }
         bcmp_system_time_header_t * msg_header = reinterpret_cast<bcmp_system_time_header_t *>(payload);
         if(msg_header->target_node_id != getNodeId() && msg_header->target_node_id != 0 ){
             break;
@@ -89,7 +116,10 @@ void bcmp_time_process_time_message(bcmp_message_type_t bcmp_msg_type, uint8_t*
                 break;
             }
             case BCMP_SYSTEM_TIME_RESPONSE: {
-                if(msg_header->target_node_id != getNodeId()){
+                if(msg_header->target_node_id != getNodeId() || len < sizeof(bcmp_system_time_response_t)){
+                    break;
+                }
+                if(bcmp_transaction_process_reply(BCMP_SYSTEM_TIME_RESPONSE, msg_header->source_node_id, 0, payload, len)) {
                     break;
                 }
                 bcmp_system_time_response_t * resp = reinterpret_cast<bcmp_system_time_response_t *>(payload);
@@ -1,10 +1,12 @@
 #pragma once
+#include <stddef.h>
 #include <stdint.h>
 
 #include "bcmp_messages.h"
+#include "bcmp_txn_table.h"
 
-bool bcmp_time_set_time(uint64_t target_node_id, uint64_t utc_us);
-bool bcmp_time_get_time(uint64_t target_node_id);
+bool bcmp_time_set_time(uint64_t target_node_id, uint64_t utc_us, bcmp_txn_cb_t cb=NULL, void *arg=NULL);
+bool bcmp_time_get_time(uint64_t target_node_id, bcmp_txn_cb_t cb=NULL, void *arg=NULL);
 
-void bcmp_time_process_time_message(bcmp_message_type_t bcmp_msg_type, uint8_t* payload);
+void bcmp_time_process_time_message(bcmp_message_type_t bcmp_msg_type, uint8_t* payload, uint16_t len);
 
@@ -2,7 +2,6 @@
 #include "FreeRTOS.h"
 #include "task.h"
 #include "queue.h"
-#include "timers.h"
 #include "task_priorities.h"
 
 #include "bm_l2.h"
@@ -11,12 +10,13 @@
 #include "bcmp_messages.h"
 #include "bcmp_neighbors.h"
 #include "bcmp_topology.h"
+#include "bcmp_transactions.h"
 #include "bm_util.h"
 #include "device_info.h"
 #include "util.h"
 
 #define BCMP_TOPO_EVT_QUEUE_LEN 32
-// Timer to stop waiting for a nodes neighbor table
+// Stop waiting for a nodes neighbor table after this long
 #define BCMP_TOPO_TIMEOUT_S 1
 #define BCMP_TABLE_MAX_LEN 1024
 
@@ -60,15 +60,12 @@ typedef struct {
 
 typedef struct {
   QueueHandle_t evt_queue;
-  TimerHandle_t topo_timer;
   networkTopology_t* networkTopology;
 } bcmpTopoContext_t;
 
 static bcmpTopoContext_t _ctx;
 static TaskHandle_t bcmpTopologyTask = NULL;
 
-static uint64_t _target_node_id = 0;
-static bool _sent_request = false;
 static bool _insert_before = false;
 
 static void bcmp_topology_thread(void *paramters);
@@ -187,10 +184,50 @@ static void process_check_node_event(void) {
 }
 
 
+/*!
+  Neighbor table transaction callback. Hands the table (or the timeout) to
+  the topology task.
+
+  \param *result - transaction result
+  \return none
+*/
+static void _neighbor_table_cb(const bcmp_txn_result_t *result) {
+  if(result->status == BCMP_TXN_REPLY) {
+    const bcmp_neighbor_table_reply_t *neighbor_table_reply = reinterpret_cast<const bcmp_neighbor_table_reply_t *>(result->reply);
+
+    // here we will assemble the entry for the SM
+    // malloc the buffer then memcpy it over
+    uint8_t *neighbor_entry_buff = static_cast<uint8_t *>(pvPortMalloc(sizeof(neighborTableEntry_t)));
+    configASSERT(neighbor_entry_buff);
+
+    memset(neighbor_entry_buff, 0, sizeof(neighborTableEntry_t));
+    neighborTableEntry_t *neighbor_entry = reinterpret_cast<neighborTableEntry_t *>(neighbor_entry_buff);
+
+    uint16_t neighbor_table_len = sizeof(bcmp_neighbor_table_reply_t) +
+                                  sizeof(bcmp_port_info_t) * neighbor_table_reply->port_len +
+                                  sizeof(bcmp_neighbor_info_t) * neighbor_table_reply->neighbor_len;
+    neighbor_entry->neighbor_table_reply = static_cast<bcmp_neighbor_table_reply_t *>(pvPortMalloc(neighbor_table_len));
+    configASSERT(neighbor_entry->neighbor_table_reply);
+
+    memcpy(neighbor_entry->neighbor_table_reply, neighbor_table_reply, neighbor_table_len);
+
+    bcmp_topo_queue_item_t item = {
+      .type = BCMP_TOPO_EVT_ADD_NODE,
+      .neighborEntry = neighbor_entry
+    };
+
+    configASSERT(xQueueSend(_ctx.evt_queue, &item, 0) == pdTRUE);
+  } else {
+    bcmp_topo_queue_item_t item = {BCMP_TOPO_EVT_TIMEOUT, NULL};
+
+    configASSERT(xQueueSend(_ctx.evt_queue, &item, 0) == pdTRUE);
+  }
+}
+
 /*!
   Send neighbor table request to node(s)
 
-  \param target_node_id - target node id to send request to (0 for all nodes)
+  \param target_node_id - target node id to send request to
   \param *addr - ip address to send to send request to
   \ret ERR_OK if successful
 */
@@ -198,9 +235,19 @@ err_t bcmp_request_neighbor_table(uint64_t target_node_id, const ip_addr_t *addr
   bcmp_neighbor_table_request_t neighbor_table_req = {
     .target_node_id=target_node_id
   };
-  _target_node_id = target_node_id;
-  configASSERT(xTimerStart(_ctx.topo_timer, 10));
-  return bcmp_tx(addr, BCMP_NEIGHBOR_TABLE_REQUEST, (uint8_t *)&neighbor_table_req, sizeof(neighbor_table_req));
+  uint32_t txn_id = bcmp_transaction_start(BCMP_NEIGHBOR_TABLE_REPLY, target_node_id, _neighbor_table_cb, NULL, BCMP_TOPO_TIMEOUT_S * 1000);
+  if(!txn_id) {
+    // No free transactions. Also treated like a timeout.
+    bcmp_topo_queue_item_t item = {BCMP_TOPO_EVT_TIMEOUT, NULL};
+    configASSERT(xQueueSend(_ctx.evt_queue, &item, 0) == pdTRUE);
+    return ERR_MEM;
+  }
+  err_t rval = bcmp_tx(addr, BCMP_NEIGHBOR_TABLE_REQUEST, (uint8_t *)&neighbor_table_req, sizeof(neighbor_table_req));
+  if(rval != ERR_OK) {
+    // Treated like a timeout, so the search moves on
+    bcmp_transaction_cancel(txn_id);
+  }
+  return rval;
 }
 
 /*!
@@ -275,57 +322,27 @@ err_t bcmp_process_neighbor_table_request(bcmp_neighbor_table_request_t *neighbo
   Handle neighbor table replies
 
   \param *neighbor_table_reply - reply message to process
-  \param *src - source ip of requester
-  \param *dst - destination ip of request (used for responding to the correct multicast address)
-  \
+  \param len - message length
+  \ret ERR_OK if the reply was one we asked for
 */
-err_t bcmp_process_neighbor_table_reply(bcmp_neighbor_table_reply_t *neighbor_table_reply) {
+err_t bcmp_process_neighbor_table_reply(bcmp_neighbor_table_reply_t *neighbor_table_reply, uint16_t len) {
   configASSERT(neighbor_table_reply);
-  if (_target_node_id == neighbor_table_reply->node_id && _sent_request) {
-
-    configASSERT(xTimerStop(_ctx.topo_timer, 10));
-    // here we will assemble the entry for the SM
-    // malloc the buffer then memcpy it over
-    uint8_t *neighbor_entry_buff = static_cast<uint8_t *>(pvPortMalloc(sizeof(neighborTableEntry_t)));
-    configASSERT(neighbor_entry_buff);
-
-    memset(neighbor_entry_buff, 0, sizeof(neighborTableEntry_t));
-    neighborTableEntry_t *neighbor_entry = reinterpret_cast<neighborTableEntry_t *>(neighbor_entry_buff);
-
-    uint16_t neighbor_table_len = sizeof(bcmp_neighbor_table_reply_t) +
-                                  sizeof(bcmp_port_info_t) * neighbor_table_reply->port_len +
-                                  sizeof(bcmp_neighbor_info_t) * neighbor_table_reply->neighbor_len;
-    neighbor_entry->neighbor_table_reply = static_cast<bcmp_neighbor_table_reply_t *>(pvPortMalloc(neighbor_table_len));
-
-    memcpy(neighbor_entry->neighbor_table_reply, neighbor_table_reply, neighbor_table_len);
 
-    bcmp_topo_queue_item_t item = {
-      .type = BCMP_TOPO_EVT_ADD_NODE,
-      .neighborEntry = neighbor_entry
-    };
+  if((len < sizeof(bcmp_neighbor_table_reply_t)) ||
+     (len < sizeof(bcmp_neighbor_table_reply_t) +
+            sizeof(bcmp_port_info_t) * neighbor_table_reply->port_len +
+            sizeof(bcmp_neighbor_info_t) * neighbor_table_reply->neighbor_len)) {
+    return ERR_VAL;
+  }
 
-    configASSERT(xQueueSend(_ctx.evt_queue, &item, 0) == pdTRUE);
+  if(!bcmp_transaction_process_reply(BCMP_NEIGHBOR_TABLE_REPLY, neighbor_table_reply->node_id, 0,
+                                     reinterpret_cast<uint8_t *>(neighbor_table_reply), len)) {
+    return ERR_VAL;
   }
 
   return ERR_OK;
 }
 
-
-/*
-  FreeRTOS timer handler for timeouts while waiting for neigbor tables. No work is done in the timer
-  handler, but instead an event is queued up to be handled in the BCMP task.
-
-  \param tmr unused
-  \return none
-*/
-static void topology_timer_handler(TimerHandle_t tmr){
-  (void) tmr;
-
-  bcmp_topo_queue_item_t item = {BCMP_TOPO_EVT_TIMEOUT, NULL};
-
-  configASSERT(xQueueSend(_ctx.evt_queue, &item, 0) == pdTRUE);
-}
-
 /*
   BCMP Topology Task. Handles stepping through the network to request node's neighbor
   tables. Callback can be assigned/called to do something with the assembled network
@@ -337,10 +354,6 @@ static void topology_timer_handler(TimerHandle_t tmr){
 static void bcmp_topology_thread(void *parameters) {
   (void) parameters;
 
-  _ctx.topo_timer = xTimerCreate("topology_timer", pdMS_TO_TICKS(BCMP_TOPO_TIMEOUT_S * 1000),
-                                 pdFALSE, NULL, topology_timer_handler);
-  configASSERT(_ctx.topo_timer);
-
   for (;;) {
     bcmp_topo_queue_item_t item;
 
@@ -382,7 +395,6 @@ static void bcmp_topology_thread(void *parameters) {
         // then free it!
         freeNetworkTopology(&_ctx.networkTopology);
         _insert_before = false;
-        _sent_request = false;
         break;
       }
 
@@ -435,7 +447,6 @@ void bcmp_topology_start(void) {
     bcmp_topo_queue_item_t item = {BCMP_TOPO_EVT_RESTART, NULL};
     configASSERT(xQueueSend(_ctx.evt_queue, &item, 0) == pdTRUE);
   }
-  _sent_request = true;
 }
 
 // free a neighbor table entry that is within the network topology
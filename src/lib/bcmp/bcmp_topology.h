@@ -7,7 +7,7 @@
 err_t bcmp_request_neighbor_table(uint64_t target_node_id, const ip_addr_t *addr);
 err_t bcmp_send_neighbor_table(const ip_addr_t *addr);
 err_t bcmp_process_neighbor_table_request(bcmp_neighbor_table_request_t *neighbor_table_req, const ip_addr_t *src, const ip_addr_t *dst);
-err_t bcmp_process_neighbor_table_reply(bcmp_neighbor_table_reply_t *neighbor_table_reply);
+err_t bcmp_process_neighbor_table_reply(bcmp_neighbor_table_reply_t *neighbor_table_reply, uint16_t len);
 
 // Topology task defines
 void bcmp_topology_start(void);
@@ -0,0 +1,225 @@
+#include <string.h>
+#include "FreeRTOS.h"
+#include "task.h"
+#include "semphr.h"
+#include "timers.h"
+
+#include "bcmp_transactions.h"
+
+//
+// BCMP request/response transactions
+//
+// Modules start a transaction when they send a request and hand every reply
+// they receive to bcmp_transaction_process_reply(). Replies that belong to
+// a transaction go to its callback (in the BCMP task). A single timer is
+// kept armed for the transaction that times out first.
+//
+
+typedef struct {
+  SemaphoreHandle_t lock;
+  TimerHandle_t timer;
+  bcmp_txn_timeout_evt_cb_t timeout_evt_cb;
+  bcmp_txn_table_t table;
+} bcmpTxnContext_t;
+
+static bcmpTxnContext_t _ctx;
+
+/*!
+  Get the current time for the transaction table
+
+  \return current time in ms
+*/
+static uint32_t _now_ms(void) {
+  return pdTICKS_TO_MS(xTaskGetTickCount());
+}
+
+/*!
+  Arm the timer for the next transaction to time out. Must hold the lock.
+
+  \param now_ms - current time
+  \return none
+*/
+static void _rearm_timer(uint32_t now_ms) {
+  uint32_t next_ms = bcmp_txn_table_next_timeout(&_ctx.table, now_ms);
+  if(next_ms == BCMP_TXN_NO_TIMEOUT) {
+    configASSERT(xTimerStop(_ctx.timer, 10) == pdPASS);
+  } else {
+    TickType_t ticks = pdMS_TO_TICKS(next_ms);
+    configASSERT(xTimerChangePeriod(_ctx.timer, ticks ? ticks : 1, 10) == pdPASS);
+  }
+}
+
+/*!
+  FreeRTOS timer handler for transaction timeouts. No work is done in the
+  timer handler, the owner is told to call bcmp_transaction_check_timeouts.
+
+  \param tmr unused
+  \return none
+*/
+static void _timer_handler(TimerHandle_t tmr) {
+  (void) tmr;
+  _ctx.timeout_evt_cb();
+}
+
+/*!
+  Initialize the transaction layer
+
+  \param timeout_evt_cb - called when transactions are due to time out
+  \return none
+*/
+void bcmp_transaction_init(bcmp_txn_timeout_evt_cb_t timeout_evt_cb) {
+  configASSERT(timeout_evt_cb);
+
+  bcmp_txn_table_init(&_ctx.table);
+  _ctx.timeout_evt_cb = timeout_evt_cb;
+
+  _ctx.lock = xSemaphoreCreateMutex();
+  configASSERT(_ctx.lock);
+
+  // Period is set every time the timer is (re)armed
+  _ctx.timer = xTimerCreate("bcmp_txn", 1, pdFALSE, NULL, _timer_handler);
+  configASSERT(_ctx.timer);
+}
+
+/*!
+  Start a transaction. Call right before sending the request.
+
+  \param reply_type - reply message type
+  \param target_node_id - node expected to reply (0 for all nodes)
+  \param has_key - whether the reply must echo back key
+  \param key - key to match
+  \param cb - called with each reply, and on timeout/cancel (in the BCMP task)
+  \param arg - passed to cb
+  \param timeout_ms - how long to wait for replies
+  \return transaction id, 0 if too many are outstanding
+*/
+static uint32_t _start(bcmp_message_type_t reply_type, uint64_t target_node_id, bool has_key, uint32_t key, bcmp_txn_cb_t cb, void *arg, uint32_t timeout_ms) {
+  configASSERT(cb);
+
+  bcmp_txn_params_t params = {
+    .reply_type = (uint16_t)reply_type,
+    .target_node_id = target_node_id,
+    .has_key = has_key,
+    .key = key,
+    .timeout_ms = timeout_ms,
+    .cb = cb,
+    .arg = arg,
+  };
+
+  configASSERT(xSemaphoreTake(_ctx.lock, portMAX_DELAY) == pdTRUE);
+  uint32_t now_ms = _now_ms();
+  uint32_t id = bcmp_txn_table_add(&_ctx.table, &params, now_ms);
+  if(id) {
+    _rearm_timer(now_ms);
+  }
+  xSemaphoreGive(_ctx.lock);
+
+  if(!id) {
+    printf("Too many outstanding BCMP requests\n");
+  }
+
+  return id;
+}
+
+/*!
+  Start a transaction. Call right before sending the request.
+
+  \param reply_type - reply message type
+  \param target_node_id - node expected to reply (0 for all nodes)
+  \param cb - called with each reply, and on timeout/cancel (in the BCMP task)
+  \param arg - passed to cb
+  \param timeout_ms - how long to wait for replies
+  \return transaction id, 0 if too many are outstanding
+*/
+uint32_t bcmp_transaction_start(bcmp_message_type_t reply_type, uint64_t target_node_id, bcmp_txn_cb_t cb, void *arg, uint32_t timeout_ms) {
+  return _start(reply_type, target_node_id, false, 0, cb, arg, timeout_ms);
+}
+
+/*!
+  Start a transaction for a reply that echoes back a key (ping id/seq)
+
+  \param reply_type - reply message type
+  \param target_node_id - node expected to reply (0 for all nodes)
+  \param key - key the reply must echo back
+  \param cb - called with each reply, and on timeout/cancel (in the BCMP task)
+  \param arg - passed to cb
+  \param timeout_ms - how long to wait for replies
+  \return transaction id, 0 if too many are outstanding
+*/
+uint32_t bcmp_transaction_start_keyed(bcmp_message_type_t reply_type, uint64_t target_node_id, uint32_t key, bcmp_txn_cb_t cb, void *arg, uint32_t timeout_ms) {
+  return _start(reply_type, target_node_id, true, key, cb, arg, timeout_ms);
+}
+
+/*!
+  Cancel a transaction (if the request couldn't be sent, for example).
+  The callback is called with BCMP_TXN_CANCELLED from the caller's task.
+
+  \param id - transaction id
+  \return true if the transaction was outstanding
+*/
+bool bcmp_transaction_cancel(uint32_t id) {
+  bcmp_txn_result_t result;
+
+  configASSERT(xSemaphoreTake(_ctx.lock, portMAX_DELAY) == pdTRUE);
+  bool rval = bcmp_txn_table_remove(&_ctx.table, id, _now_ms(), &result);
+  xSemaphoreGive(_ctx.lock);
+
+  if(rval) {
+    result.cb(&result);
+  }
+
+  return rval;
+}
+
+/*!
+  Pass a received reply to the transaction waiting for it (if any)
+
+  \param reply_type - reply message type
+  \param node_id - responding node
+  \param key - key echoed back in the reply (0 if the message has none)
+  \param *reply - reply message
+  \param reply_len - reply message length
+  \return true if the reply belonged to a transaction
+*/
+bool bcmp_transaction_process_reply(bcmp_message_type_t reply_type, uint64_t node_id, uint32_t key, const uint8_t *reply, uint16_t reply_len) {
+  bcmp_txn_result_t result;
+
+  configASSERT(xSemaphoreTake(_ctx.lock, portMAX_DELAY) == pdTRUE);
+  bool rval = bcmp_txn_table_match(&_ctx.table, (uint16_t)reply_type, node_id, key, _now_ms(), &result);
+  xSemaphoreGive(_ctx.lock);
+
+  // Callbacks are called without the lock so they can start new transactions
+  if(rval) {
+    result.reply = reply;
+    result.reply_len = reply_len;
+    result.cb(&result);
+  }
+
+  return rval;
+}
+
+/*!
+  Complete transactions that timed out. Called from the BCMP task after
+  the timeout event.
+
+  \return none
+*/
+void bcmp_transaction_check_timeouts(void) {
+  for(;;) {
+    bcmp_txn_result_t result;
+
+    configASSERT(xSemaphoreTake(_ctx.lock, portMAX_DELAY) == pdTRUE);
+    uint32_t now_ms = _now_ms();
+    bool expired = bcmp_txn_table_expire(&_ctx.table, now_ms, &result);
+    if(!expired) {
+      _rearm_timer(now_ms);
+    }
+    xSemaphoreGive(_ctx.lock);
+
+    if(!expired) {
+      break;
+    }
+
+    result.cb(&result);
+  }
+}
@@ -0,0 +1,22 @@
+#pragma once
+
+#include <stdint.h>
+#include "FreeRTOS.h"
+
+#include "bcmp_messages.h"
+#include "bcmp_txn_table.h"
+
+// How long requests wait for replies unless told otherwise
+#define BCMP_TXN_DEFAULT_TIMEOUT_MS (1000)
+
+// Called (from the timer task) when a transaction is due to time out.
+// bcmp_transaction_check_timeouts() should be called soon after.
+typedef void (*bcmp_txn_timeout_evt_cb_t)(void);
+
+void bcmp_transaction_init(bcmp_txn_timeout_evt_cb_t timeout_evt_cb);
+uint32_t bcmp_transaction_start(bcmp_message_type_t reply_type, uint64_t target_node_id, bcmp_txn_cb_t cb, void *arg, uint32_t timeout_ms=BCMP_TXN_DEFAULT_TIMEOUT_MS);
+uint32_t bcmp_transaction_start_keyed(bcmp_message_type_t reply_type, uint64_t target_node_id, uint32_t key, bcmp_txn_cb_t cb, void *arg, uint32_t timeout_ms=BCMP_TXN_DEFAULT_TIMEOUT_MS);
+bool bcmp_transaction_cancel(uint32_t id);
+bool bcmp_transaction_process_reply(bcmp_message_type_t reply_type, uint64_t node_id, uint32_t key, const uint8_t *reply, uint16_t reply_len);
+void bcmp_transaction_check_timeouts(void);
+
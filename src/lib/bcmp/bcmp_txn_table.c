@@ -0,0 +1,221 @@
+#include <string.h>
+#include "FreeRTOS.h"
+#include "bcmp_txn_table.h"
+
+/*!
+  Check whether a deadline has passed (handles ms counter wrap)
+
+  \param[in] now_ms - current time
+  \param[in] deadline_ms - deadline
+  \return true if deadline is now or in the past
+*/
+static inline bool _deadline_passed(uint32_t now_ms, uint32_t deadline_ms) {
+  return (int32_t)(now_ms - deadline_ms) >= 0;
+}
+
+/*!
+  Fill out a result for a transaction
+
+  \param[in] *txn - transaction
+  \param[in] status - why the callback is being called
+  \param[in] now_ms - current time
+  \param[in] done - true if the transaction is complete
+  \param[out] *result - result
+  \return none
+*/
+static void _fill_result(const bcmp_txn_t *txn, bcmp_txn_status_e status, uint32_t now_ms, bool done, bcmp_txn_result_t *result) {
+  memset(result, 0, sizeof(*result));
+  result->status = status;
+  result->id = txn->id;
+  result->elapsed_ms = now_ms - txn->start_ms;
+  result->num_replies = txn->num_replies;
+  result->done = done;
+  result->cb = txn->params.cb;
+  result->arg = txn->params.arg;
+}
+
+/*!
+  Initialize transaction table
+
+  \param[in] *table - transaction table
+  \return none
+*/
+void bcmp_txn_table_init(bcmp_txn_table_t *table) {
+  configASSERT(table);
+
+  memset(table, 0, sizeof(*table));
+  table->next_id = 1;
+}
+
+/*!
+  Add a transaction
+
+  \param[in] *table - transaction table
+  \param[in] *params - what reply to wait for, for how long, and who to tell
+  \param[in] now_ms - current time
+  \return transaction id, 0 if there are too many outstanding
+*/
+uint32_t bcmp_txn_table_add(bcmp_txn_table_t *table, const bcmp_txn_params_t *params, uint32_t now_ms) {
+  configASSERT(table);
+  configASSERT(params);
+  configASSERT(params->timeout_ms);
+
+  for(uint32_t idx = 0; idx < BCMP_TXN_MAX_OUTSTANDING; idx++) {
+    bcmp_txn_t *txn = &table->txns[idx];
+    if(txn->id) {
+      continue;
+    }
+
+    txn->id = table->next_id++;
+    if(!table->next_id) {
+      table->next_id = 1;
+    }
+    txn->params = *params;
+    txn->start_ms = now_ms;
+    txn->deadline_ms = now_ms + params->timeout_ms;
+    txn->num_replies = 0;
+
+    return txn->id;
+  }
+
+  return 0;
+}
+
+/*!
+  Match a reply to the oldest transaction waiting for it
+
+  \param[in] *table - transaction table
+  \param[in] reply_type - reply message type
+  \param[in] node_id - responding node
+  \param[in] key - key echoed back in the reply (ignored by transactions without one)
+  \param[in] now_ms - current time
+  \param[out] *result - result to pass to the transaction's callback. The
+              caller fills out the reply.
+  \return true if the reply belongs to a transaction
+*/
+bool bcmp_txn_table_match(bcmp_txn_table_t *table, uint16_t reply_type, uint64_t node_id, uint32_t key, uint32_t now_ms, bcmp_txn_result_t *result) {
+  configASSERT(table);
+  configASSERT(result);
+
+  bcmp_txn_t *match = NULL;
+  for(uint32_t idx = 0; idx < BCMP_TXN_MAX_OUTSTANDING; idx++) {
+    bcmp_txn_t *txn = &table->txns[idx];
+    if(!txn->id || (txn->params.reply_type != reply_type) || _deadline_passed(now_ms, txn->deadline_ms)) {
+      continue;
+    }
+
+    if(txn->params.target_node_id && (txn->params.target_node_id != node_id)) {
+      continue;
+    }
+
+    if(txn->params.has_key && (txn->params.key != key)) {
+      continue;
+    }
+
+    // ids only go up (until they wrap), so the smallest one is the oldest
+    if(!match || ((int32_t)(txn->id - match->id) < 0)) {
+      match = txn;
+    }
+  }
+
+  if(!match) {
+    return false;
+  }
+
+  match->num_replies++;
+
+  // Requests to all nodes keep collecting replies until they time out
+  bool done = (match->params.target_node_id != 0);
+  _fill_result(match, BCMP_TXN_REPLY, now_ms, done, result);
+  result->node_id = node_id;
+
+  if(done) {
+    match->id = 0;
+  }
+
+  return true;
+}
+
+/*!
+  Remove a transaction before it completes
+
+  \param[in] *table - transaction table
+  \param[in] id - transaction id
+  \param[in] now_ms - current time
+  \param[out] *result - result to pass to the transaction's callback
+  \return true if the transaction was outstanding
+*/
+bool bcmp_txn_table_remove(bcmp_txn_table_t *table, uint32_t id, uint32_t now_ms, bcmp_txn_result_t *result) {
+  configASSERT(table);
+  configASSERT(result);
+
+  if(!id) {
+    return false;
+  }
+
+  for(uint32_t idx = 0; idx < BCMP_TXN_MAX_OUTSTANDING; idx++) {
+    bcmp_txn_t *txn = &table->txns[idx];
+    if(txn->id == id) {
+      _fill_result(txn, BCMP_TXN_CANCELLED, now_ms, true, result);
+      txn->id = 0;
+      return true;
+    }
+  }
+
+  return false;
+}
+
+/*!
+  Remove a transaction whose time is up. Call until it returns false.
+
+  \param[in] *table - transaction table
+  \param[in] now_ms - current time
+  \param[out] *result - result to pass to the transaction's callback
+  \return true if a transaction expired
+*/
+bool bcmp_txn_table_expire(bcmp_txn_table_t *table, uint32_t now_ms, bcmp_txn_result_t *result) {
+  configASSERT(table);
+  configASSERT(result);
+
+  for(uint32_t idx = 0; idx < BCMP_TXN_MAX_OUTSTANDING; idx++) {
+    bcmp_txn_t *txn = &table->txns[idx];
+    if(txn->id && _deadline_passed(now_ms, txn->deadline_ms)) {
+      _fill_result(txn, BCMP_TXN_TIMEOUT, now_ms, true, result);
+      txn->id = 0;
+      return true;
+    }
+  }
+
+  return false;
+}
+
+/*!
+  Time until the next transaction times out
+
+  \param[in] *table - transaction table
+  \param[in] now_ms - current time
+  \return ms until the next timeout (0 if one is due), BCMP_TXN_NO_TIMEOUT if
+          nothing is outstanding
+*/
+uint32_t bcmp_txn_table_next_timeout(const bcmp_txn_table_t *table, uint32_t now_ms) {
+  configASSERT(table);
+
+  uint32_t next_ms = BCMP_TXN_NO_TIMEOUT;
+  for(uint32_t idx = 0; idx < BCMP_TXN_MAX_OUTSTANDING; idx++) {
+    const bcmp_txn_t *txn = &table->txns[idx];
+    if(!txn->id) {
+      continue;
+    }
+
+    if(_deadline_passed(now_ms, txn->deadline_ms)) {
+      return 0;
+    }
+
+    uint32_t remaining_ms = txn->deadline_ms - now_ms;
+    if(remaining_ms < next_ms) {
+      next_ms = remaining_ms;
+    }
+  }
+
+  return next_ms;
+}
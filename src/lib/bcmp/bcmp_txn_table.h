@@ -0,0 +1,86 @@
+#pragma once
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+//
+// Table of outstanding BCMP requests (transactions)
+//
+// Replies are matched to requests by reply message type and responder node
+// id, plus an optional key for messages that echo one back (ping id/seq).
+// A request to one node completes with its first matching reply. A request
+// to all nodes (target 0) gets a callback for every reply and completes when
+// its timeout runs out.
+//
+// No locking or timers in here; the caller serializes access, provides the
+// time, and calls the callbacks (see bcmp_transactions.h).
+//
+
+#define BCMP_TXN_MAX_OUTSTANDING (16)
+#define BCMP_TXN_NO_TIMEOUT      (UINT32_MAX)
+
+typedef enum {
+  BCMP_TXN_REPLY,
+  BCMP_TXN_TIMEOUT,
+  BCMP_TXN_CANCELLED,
+} bcmp_txn_status_e;
+
+typedef struct bcmp_txn_result_s bcmp_txn_result_t;
+typedef void (*bcmp_txn_cb_t)(const bcmp_txn_result_t *result);
+
+struct bcmp_txn_result_s {
+  bcmp_txn_status_e status;
+  uint32_t id;
+  // Responding node (replies only)
+  uint64_t node_id;
+  // Reply message, only valid during the callback
+  const uint8_t *reply;
+  uint16_t reply_len;
+  uint32_t elapsed_ms;
+  // Replies received so far (including this one)
+  uint16_t num_replies;
+  // Last callback for this transaction, its arg can be released
+  bool done;
+  bcmp_txn_cb_t cb;
+  void *arg;
+};
+
+typedef struct {
+  uint16_t reply_type;
+  // Node expected to reply (0 for all nodes)
+  uint64_t target_node_id;
+  bool has_key;
+  uint32_t key;
+  uint32_t timeout_ms;
+  bcmp_txn_cb_t cb;
+  void *arg;
+} bcmp_txn_params_t;
+
+typedef struct {
+  // 0 when the entry is free
+  uint32_t id;
+  bcmp_txn_params_t params;
+  uint32_t start_ms;
+  uint32_t deadline_ms;
+  uint16_t num_replies;
+} bcmp_txn_t;
+
+typedef struct {
+  bcmp_txn_t txns[BCMP_TXN_MAX_OUTSTANDING];
+  uint32_t next_id;
+} bcmp_txn_table_t;
+
+void bcmp_txn_table_init(bcmp_txn_table_t *table);
+uint32_t bcmp_txn_table_add(bcmp_txn_table_t *table, const bcmp_txn_params_t *params, uint32_t now_ms);
+bool bcmp_txn_table_match(bcmp_txn_table_t *table, uint16_t reply_type, uint64_t node_id, uint32_t key, uint32_t now_ms, bcmp_txn_result_t *result);
+bool bcmp_txn_table_remove(bcmp_txn_table_t *table, uint32_t id, uint32_t now_ms, bcmp_txn_result_t *result);
+bool bcmp_txn_table_expire(bcmp_txn_table_t *table, uint32_t now_ms, bcmp_txn_result_t *result);
+uint32_t bcmp_txn_table_next_timeout(const bcmp_txn_table_t *table, uint32_t now_ms);
+
+#ifdef __cplusplus
+}
+#endif
@@ -12,6 +12,7 @@ extern "C" {
 typedef enum {
     BM_NETDEV_TYPE_NONE,
     BM_NETDEV_TYPE_ADIN2111,
+    BM_NETDEV_TYPE_SIM,
     BM_NETDEV_TYPE_MAX
 } bm_netdev_type_t;
 
@@ -5,7 +5,12 @@
 #include "lwip/ethip6.h"
 #include "lwip/prot/ethernet.h"
 #include "lwip/snmp.h"
+#include "perf_counters.h"
 #include "task_priorities.h"
+#include "trace.h"
+#ifdef SIM_NETDEV_ENABLE
+#include "sim_netdev.h"
+#endif
 
 #define IFNAME0                     'b'
 #define IFNAME1                     'm'
@@ -45,9 +50,9 @@ typedef struct {
     struct netif* net_if;
     bm_netdev_ctx_t devices[BM_NETDEV_COUNT];
 
-    /* TODO: We are only supporting the ADIN2111 net device. Currently assuming we have up to BM_NETDEV_TYPE_MAX ADIN2111s.
+    /* TODO: We are only supporting the ADIN2111 net device. Currently assuming we have up to BM_NETDEV_COUNT ADIN2111s.
        We want to eventually support new net devices and pre-allocate here before giving to init function */
-    adin2111_DeviceStruct_t adin_devices[BM_NETDEV_TYPE_MAX];
+    adin2111_DeviceStruct_t adin_devices[BM_NETDEV_COUNT];
 
     bm_l2_link_change_cb_t link_change_cb;
 
@@ -56,6 +61,8 @@ typedef struct {
     uint8_t available_port_mask_idx;
     uint8_t enabled_port_mask;
     QueueHandle_t evt_queue;
+    perfQueue_t evt_queue_perf;
+    perfCounter_t rx_no_mem;
 } bm_l2_ctx_t;
 
 static bm_l2_ctx_t bm_l2_ctx;
@@ -65,7 +72,7 @@ static bm_l2_ctx_t bm_l2_ctx;
 static int32_t bm_l2_get_device_index(const void* device_handle) {
     int32_t rval = -1;
 
-    for (int32_t idx=0; idx<BM_NETDEV_TYPE_MAX; idx++) {
+    for (int32_t idx=0; idx<BM_NETDEV_COUNT; idx++) {
         if (device_handle == ((adin2111_DeviceHandle_t) bm_l2_ctx.devices[idx].device_handle)){
             rval = idx;
         }
@@ -84,10 +91,11 @@ static int32_t bm_l2_get_device_index(const void* device_handle) {
 */
 static void bm_l2_process_tx_evt(l2_queue_element_t *tx_evt) {
     configASSERT(tx_evt);
+    tracePacket(kTraceEventPktL2TxDequeue, tx_evt->pbuf);
 
     uint8_t mask_idx = 0;
 
-    for (uint32_t idx=0; idx < BM_NETDEV_TYPE_MAX; idx++) {
+    for (uint32_t idx=0; idx < BM_NETDEV_COUNT; idx++) {
         switch (bm_l2_ctx.devices[idx].type) {
             case BM_NETDEV_TYPE_ADIN2111: {
                 err_t retv = adin2111_tx((adin2111_DeviceHandle_t) bm_l2_ctx.devices[idx].device_handle, static_cast<uint8_t *>(tx_evt->pbuf->payload), tx_evt->pbuf->len,
@@ -98,6 +106,17 @@ static void bm_l2_process_tx_evt(l2_queue_element_t *tx_evt) {
                 }
                 break;
             }
+#ifdef SIM_NETDEV_ENABLE
+            case BM_NETDEV_TYPE_SIM: {
+                err_t retv = sim_netdev_tx((sim_netdev_t *) bm_l2_ctx.devices[idx].device_handle, static_cast<uint8_t *>(tx_evt->pbuf->payload), tx_evt->pbuf->len,
+                                   (tx_evt->port_mask >> mask_idx) & SIM_NETDEV_PORT_MASK, bm_l2_ctx.devices[idx].start_port_idx);
+                mask_idx += bm_l2_ctx.devices[idx].num_ports;
+                if (retv != ERR_OK) {
+                    printf("Failed to submit TX buffer to sim netdev\n");
+                }
+                break;
+            }
+#endif
             case BM_NETDEV_TYPE_NONE: {
                 /* No device */
                 break;
@@ -122,6 +141,7 @@ static void bm_l2_process_tx_evt(l2_queue_element_t *tx_evt) {
 */
 static void bm_l2_process_rx_evt(l2_queue_element_t *rx_evt) {
     configASSERT(rx_evt);
+    tracePacket(kTraceEventPktL2RxDequeue, rx_evt->pbuf);
 
     uint8_t rx_port_mask = 0;
     uint8_t device_idx = bm_l2_get_device_index(rx_evt->device_handle);
@@ -129,6 +149,11 @@ static void bm_l2_process_rx_evt(l2_queue_element_t *rx_evt) {
         case BM_NETDEV_TYPE_ADIN2111:
             rx_port_mask = ((rx_evt->port_mask & ADIN2111_PORT_MASK) << bm_l2_ctx.devices[device_idx].start_port_idx);
             break;
+#ifdef SIM_NETDEV_ENABLE
+        case BM_NETDEV_TYPE_SIM:
+            rx_port_mask = ((rx_evt->port_mask & SIM_NETDEV_PORT_MASK) << bm_l2_ctx.devices[device_idx].start_port_idx);
+            break;
+#endif
         case BM_NETDEV_TYPE_NONE:
         default:
             /* No device or not supported. How did we get here? */
@@ -265,12 +290,16 @@ err_t bm_l2_tx(struct pbuf *pbuf, uint8_t port_mask) {
 
     // device_handle not needed for tx
     // Don't send to ports that are offline
-    l2_queue_element_t tx_evt = {NULL, port_mask & bm_l2_ctx.enabled_port_mask, pbuf, BM_L2_TX};
+    l2_queue_element_t tx_evt = {NULL, static_cast<uint8_t>(port_mask & bm_l2_ctx.enabled_port_mask), pbuf, BM_L2_TX};
 
     pbuf_ref(pbuf);
+    tracePacket(kTraceEventPktL2Tx, pbuf);
     if(xQueueSend(bm_l2_ctx.evt_queue, &tx_evt, 10) != pdTRUE) {
+        perfQueueDropped(&bm_l2_ctx.evt_queue_perf);
         pbuf_free(pbuf);
         retv = ERR_MEM;
+    } else {
+        perfQueueSent(&bm_l2_ctx.evt_queue_perf);
     }
 
     return retv;
@@ -293,6 +322,7 @@ err_t bm_l2_rx(void* device_handle, uint8_t* payload, uint16_t payload_len, uint
     do {
         tx_evt.pbuf = pbuf_alloc(PBUF_RAW, payload_len, PBUF_RAM);
         if (tx_evt.pbuf == NULL) {
+            perfCounterInc(&bm_l2_ctx.rx_no_mem);
             printf("No mem for pbuf in RX pathway\n");
             retv = ERR_MEM;
             break;
@@ -300,11 +330,15 @@ err_t bm_l2_rx(void* device_handle, uint8_t* payload, uint16_t payload_len, uint
         tx_evt.pbuf->len = payload_len;
         memcpy(tx_evt.pbuf->payload, payload, payload_len);
 
+        tracePacket(kTraceEventPktL2Rx, tx_evt.pbuf);
+
         if(xQueueSend(bm_l2_ctx.evt_queue, (void *) &tx_evt, 0) != pdTRUE) {
+            perfQueueDropped(&bm_l2_ctx.evt_queue_perf);
             pbuf_free(tx_evt.pbuf);
             retv = ERR_MEM;
             break;
         }
+        perfQueueSent(&bm_l2_ctx.evt_queue_perf);
     } while (0);
     return retv;
 }
@@ -366,6 +400,21 @@ err_t bm_l2_init(bm_l2_link_change_cb_t link_change_cb) {
                     printf("Failed to init ADIN2111");
                 }
                 break;
+#ifdef SIM_NETDEV_ENABLE
+            case BM_NETDEV_TYPE_SIM: {
+                sim_netdev_t *sim_dev = sim_netdev_init(bm_l2_rx, _link_change_cb);
+                if (sim_dev) {
+                    bm_l2_ctx.devices[idx].device_handle = sim_dev;
+                    bm_l2_ctx.devices[idx].num_ports = SIM_NETDEV_PORT_NUM;
+                    bm_l2_ctx.devices[idx].start_port_idx = bm_l2_ctx.available_port_mask_idx;
+                    bm_l2_ctx.available_ports_mask |= (SIM_NETDEV_PORT_MASK << bm_l2_ctx.available_port_mask_idx);
+                    bm_l2_ctx.available_port_mask_idx += SIM_NETDEV_PORT_NUM;
+                } else {
+                    printf("Failed to init sim netdev");
+                }
+                break;
+            }
+#endif
             case BM_NETDEV_TYPE_NONE:
             default:
                 /* No device or not supported */
@@ -376,6 +425,9 @@ err_t bm_l2_init(bm_l2_link_change_cb_t link_change_cb) {
     }
 
     bm_l2_ctx.evt_queue = xQueueCreate( EVT_QUEUE_LEN, sizeof(l2_queue_element_t));
+    configASSERT(bm_l2_ctx.evt_queue);
+    perfQueueRegister(&bm_l2_ctx.evt_queue_perf, "l2_evt_q", bm_l2_ctx.evt_queue);
+    perfCounterRegister(&bm_l2_ctx.rx_no_mem, "l2", "rx_no_mem", PERF_COUNTER_TYPE_COUNT);
 
     BaseType_t rval = xTaskCreate(bm_l2_thread,
                        "L2 TX Thread",
@@ -429,3 +481,22 @@ bool bm_l2_get_device_handle(uint8_t dev_idx, void **device_handle, bm_netdev_ty
 bool bm_l2_get_port_state(uint8_t port) {
     return (bool)(bm_l2_ctx.enabled_port_mask & (1 << port));
 }
+
+/*!
+  Get the free space in the L2 event queue (shared by TX and RX), so
+  publishers can back off before it fills up
+
+  \param *queue_len - pointer to variable to store the queue length in
+  \return number of free spaces
+*/
+uint32_t bm_l2_get_queue_space(uint32_t *queue_len) {
+    configASSERT(queue_len);
+    *queue_len = EVT_QUEUE_LEN;
+
+    // Not initialized yet, nothing queued
+    if(!bm_l2_ctx.evt_queue) {
+        return EVT_QUEUE_LEN;
+    }
+
+    return uxQueueSpacesAvailable(bm_l2_ctx.evt_queue);
+}
@@ -34,6 +34,7 @@ err_t bm_l2_init(bm_l2_link_change_cb_t link_change_cb);
 bool bm_l2_get_device_handle(uint8_t dev_idx, void **device_handle, bm_netdev_type_t *type, uint32_t *start_port_idx);
 uint8_t bm_l2_get_num_ports();
 bool bm_l2_get_port_state(uint8_t port);
+uint32_t bm_l2_get_queue_space(uint32_t *queue_len);
 
 #ifdef __cplusplus
 }
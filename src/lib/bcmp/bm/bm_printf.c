@@ -6,7 +6,9 @@
 #include "bm_printf.h"
 
 #define MAX_FILE_NAME_LEN 64
-#define MAX_STR_LEN(fname_len) (int32_t)(1500 - sizeof(struct ip6_hdr) - sizeof(bm_print_publication_t) - fname_len)
+// Publications larger than a frame are fragmented, so the limit is the largest
+// publication subscribers can reassemble (on the longer of the two topics)
+#define MAX_STR_LEN(fname_len) (int32_t)(BM_PUB_MAX_DATA_LEN(sizeof("fprintf") - 1) - sizeof(bm_print_publication_t) - fname_len - 1)
 
 /*!
   Bristlemouth generic fprintf function, will publish the data to end in a file or
@@ -47,7 +49,10 @@ bm_printf_err_t bm_fprintf(uint64_t target_node_id, const char* file_name, const
     data_len += 1; // add one for the null terminator before we malloc a buffer
     size_t printf_pub_len = sizeof(bm_print_publication_t) + data_len + fname_len;
     printf_pub = (bm_print_publication_t* )pvPortMalloc(printf_pub_len);
-    configASSERT(printf_pub);
+    if (!printf_pub) {
+      rval = BM_PRINTF_OUT_OF_MEMORY;
+      break;
+    }
 
     memset(printf_pub, 0, printf_pub_len);
     printf_pub->target_node_id = target_node_id;
@@ -99,10 +104,15 @@ bm_printf_err_t bm_file_append(uint64_t target_node_id, const char* file_name, c
   bm_printf_err_t rval = BM_PRINTF_OK;
 
   int32_t fname_len = strnlen(file_name, MAX_FILE_NAME_LEN);
+  if (len > MAX_STR_LEN(fname_len)) {
+    return BM_PRINTF_STR_MAX_LEN;
+  }
 
   size_t file_append_pub_len = sizeof(bm_print_publication_t) + len + fname_len;
   bm_print_publication_t* file_append_pub = (bm_print_publication_t *)pvPortMalloc(file_append_pub_len);
-  configASSERT(file_append_pub);
+  if (!file_append_pub) {
+    return BM_PRINTF_OUT_OF_MEMORY;
+  }
 
   file_append_pub->target_node_id = target_node_id;
   file_append_pub->fname_len = fname_len;
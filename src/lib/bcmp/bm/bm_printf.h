@@ -20,6 +20,7 @@ typedef enum {
   BM_PRINTF_FNAME_MAX_LEN,
   BM_PRINTF_MISC_ERR,
   BM_PRINTF_TX_ERR,
+  BM_PRINTF_OUT_OF_MEMORY,
 } bm_printf_err_t;
 
 bm_printf_err_t bm_fprintf(uint64_t target_node_id, const char* file_name, const char* format, ...);
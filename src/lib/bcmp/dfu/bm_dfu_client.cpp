@@ -15,7 +15,7 @@
 #include "flash_map_backend/flash_map_backend.h"
 #include "stm32_flash.h"
 #include "sysflash/sysflash.h"
-#include "crc.h"
+#include "image_digest.h"
 #include "reset_reason.h"
 #include "device_info.h"
 
@@ -25,7 +25,8 @@ typedef struct dfu_client_ctx_t {
     uint32_t image_size;
     uint16_t num_chunks;
     uint16_t crc16;
-    uint16_t running_crc16;
+    /* CRC16 and SHA-256 of the image, updated as pages are written */
+    imageDigest_t digest;
     /* Variables from DFU Payload */
     uint16_t chunk_length;
     /* Flash Mem variables */
@@ -114,6 +115,29 @@ static void chunk_timer_handler(TimerHandle_t tmr) {
     }
 }
 
+/**
+ * @brief Write the page buffer to flash
+ *
+ * @note The image digest is updated with each page as it's written, so the image can be
+ *       validated without reading it back.
+ *
+ * @param len    Number of bytes in the page buffer
+ * @return int32_t 0 on success, non-0 on error
+ */
+static int32_t bm_dfu_write_page(uint16_t len)
+{
+    /* Perform page write and increment flash byte counter */
+    int32_t retval = flash_area_write(client_ctx.fa, client_ctx.img_flash_offset, client_ctx.img_page_buf, len);
+    if (retval) {
+        printf("Unable to write DFU frame to Flash\n");
+    } else {
+        imageDigestUpdate(&client_ctx.digest, client_ctx.img_page_buf, len);
+        client_ctx.img_flash_offset += len;
+    }
+
+    return retval;
+}
+
 /**
  * @brief Write received chunks to flash
  *
@@ -138,13 +162,9 @@ static int32_t bm_dfu_process_payload(uint16_t len, uint8_t * buf)
             if (client_ctx.img_page_byte_counter == BM_IMG_PAGE_LENGTH) {
                 client_ctx.img_page_byte_counter = 0;
 
-                /* Perform page write and increment flash byte counter */
-                retval = flash_area_write(client_ctx.fa, client_ctx.img_flash_offset, client_ctx.img_page_buf, BM_IMG_PAGE_LENGTH);
+                retval = bm_dfu_write_page(BM_IMG_PAGE_LENGTH);
                 if (retval) {
-                    printf("Unable to write DFU frame to Flash");
                     break;
-                } else {
-                    client_ctx.img_flash_offset += BM_IMG_PAGE_LENGTH;
                 }
             }
         } else {
@@ -155,13 +175,9 @@ static int32_t bm_dfu_process_payload(uint16_t len, uint8_t * buf)
             if (client_ctx.img_page_byte_counter == BM_IMG_PAGE_LENGTH) {
                 client_ctx.img_page_byte_counter = 0;
 
-                /* Perform page write and increment flash byte counter */
-                retval = flash_area_write(client_ctx.fa, client_ctx.img_flash_offset, client_ctx.img_page_buf, BM_IMG_PAGE_LENGTH);
+                retval = bm_dfu_write_page(BM_IMG_PAGE_LENGTH);
                 if (retval) {
-                    printf("Unable to write DFU frame to Flash");
                     break;
-                } else {
-                    client_ctx.img_flash_offset += BM_IMG_PAGE_LENGTH;
                 }
             }
 
@@ -186,13 +202,7 @@ static int32_t bm_dfu_process_end(void) {
 
     /* If there are any dirty bytes, write to flash */
     if (client_ctx.img_page_byte_counter != 0) {
-        /* Perform page write and increment flash byte counter */
-        retval = flash_area_write(client_ctx.fa, client_ctx.img_flash_offset, client_ctx.img_page_buf, (client_ctx.img_page_byte_counter));
-        if (retval) {
-            printf("Unable to write DFU frame to Flash\n");
-        } else {
-            client_ctx.img_flash_offset += client_ctx.img_page_byte_counter;
-        }
+        retval = bm_dfu_write_page(client_ctx.img_page_byte_counter);
     }
 
     flash_area_close(client_ctx.fa);
@@ -305,7 +315,7 @@ void s_client_receiving_entry(void) {
     client_ctx.chunk_retry_num = 0;
     client_ctx.img_page_byte_counter = 0;
     client_ctx.img_flash_offset = 0;
-    client_ctx.running_crc16 = 0;
+    imageDigestInit(&client_ctx.digest);
 
     /* Request Next Chunk */
     bm_dfu_req_next_chunk(client_ctx.host_node_id, client_ctx.current_chunk);
@@ -335,9 +345,6 @@ void s_client_receiving_run(void) {
         /* Get Chunk Length and Chunk */
         client_ctx.chunk_length = image_chunk_evt->payload_length;
 
-        /* Calculate Running CRC */
-        client_ctx.running_crc16 = crc16_ccitt(client_ctx.running_crc16, image_chunk_evt->payload_buf, client_ctx.chunk_length);
-
         /* Process the frame */
         if (bm_dfu_process_payload(client_ctx.chunk_length, image_chunk_evt->payload_buf)) {
             bm_dfu_client_transition_to_error(BM_DFU_ERR_BM_FRAME);
@@ -376,7 +383,7 @@ void s_client_receiving_run(void) {
         client_ctx.chunk_retry_num = 0;
         client_ctx.img_page_byte_counter = 0;
         client_ctx.img_flash_offset = 0;
-        client_ctx.running_crc16 = 0;
+        imageDigestInit(&client_ctx.digest);
         vTaskDelay(100); // Allow host to process ACK and Get ready to send chunk.
         bm_dfu_req_next_chunk(client_ctx.host_node_id, client_ctx.current_chunk);
         configASSERT(xTimerStart(client_ctx.chunk_timer, 10));
@@ -404,13 +411,18 @@ void s_client_validating_entry(void)
         bm_dfu_client_transition_to_error(BM_DFU_ERR_MISMATCH_LEN);
 
     } else {
-        /* Verify CRC. If ok, then move to Activating state */
-        if (client_ctx.crc16 == client_ctx.running_crc16) {
-            bm_dfu_set_pending_state_change(BM_DFU_STATE_CLIENT_REBOOT_REQ);
-        } else {
-            printf("Expected Image CRC: %d | Calculated Image CRC: %d\n", client_ctx.crc16, client_ctx.running_crc16);
+        /* Verify CRC (and the SHA-256 if the image has one). If ok, then move to Activating state */
+        imageDigestResult_t digest_result = imageDigestFinish(&client_ctx.digest);
+        if (client_ctx.crc16 != client_ctx.digest.crc16) {
+            printf("Expected Image CRC: %d | Calculated Image CRC: %d\n", client_ctx.crc16, client_ctx.digest.crc16);
+            bm_dfu_update_end(client_ctx.host_node_id, 0, BM_DFU_ERR_BAD_CRC);
+            bm_dfu_client_transition_to_error(BM_DFU_ERR_BAD_CRC);
+        } else if (digest_result == IMAGE_DIGEST_MISMATCH) {
+            printf("Image SHA-256 doesn't match image TLV\n");
             bm_dfu_update_end(client_ctx.host_node_id, 0, BM_DFU_ERR_BAD_CRC);
             bm_dfu_client_transition_to_error(BM_DFU_ERR_BAD_CRC);
+        } else {
+            bm_dfu_set_pending_state_change(BM_DFU_STATE_CLIENT_REBOOT_REQ);
         }
     }
 }
@@ -9,6 +9,7 @@
 #include "bm_dfu_host.h"
 #include "task_priorities.h"
 #include "device_info.h"
+#include "mem_pool.h"
 
 typedef struct dfu_core_ctx_t {
     libSmContext_t sm_ctx;
@@ -33,6 +34,13 @@ static dfu_core_ctx_t dfu_ctx;
 
 static QueueHandle_t dfu_event_queue;
 
+// Incoming DFU messages are copied out of their pbufs and live until the event
+// thread is done with them. Enough blocks for the message being handled plus a
+// couple queued behind it; bursts past that come from the heap.
+#define DFU_MSG_POOL_SIZE       (3)
+#define DFU_MSG_MAX_LEN         (sizeof(bcmp_dfu_payload_t) + BM_DFU_MAX_CHUNK_SIZE)
+MEM_POOL_DEFINE(dfu_msgs, DFU_MSG_MAX_LEN, DFU_MSG_POOL_SIZE, true);
+
 static void bm_dfu_send_nop_event(void);
 static const libSmState_t* bm_dfu_check_transitions(uint8_t current_state);
 
@@ -217,6 +225,28 @@ static void s_error_entry(void) {
 }
 
 
+/*!
+  Allocate a buffer for a DFU message/event. Ownership passes to
+  bm_dfu_process_message (or the event queue), which frees it with
+  bm_dfu_free_message
+
+  \param len - message length
+  \return pointer to buffer, NULL if out of memory
+*/
+uint8_t *bm_dfu_alloc_message(size_t len) {
+    return static_cast<uint8_t *>(memPoolAllocSize(&dfu_msgs, len));
+}
+
+/*!
+  Free a DFU message/event buffer
+
+  \param buf - buffer to free
+  \return none
+*/
+void bm_dfu_free_message(uint8_t *buf) {
+    memPoolFree(&dfu_msgs, buf);
+}
+
 /* Consumes any incoming packets from the BCMP service. The payload types are translated
    into events that are placed into the subystem queue and are consumed by the DFU event thread. */
 void bm_dfu_process_message(uint8_t *buf, size_t len) {
@@ -226,7 +256,7 @@ void bm_dfu_process_message(uint8_t *buf, size_t len) {
 
     /* If this node is not the intended destination, then discard and continue to wait on queue */
     if (dfu_ctx.self_node_id != (reinterpret_cast<bm_dfu_event_address_t *>(frame->payload))->dst_node_id) {
-        vPortFree(buf);
+        bm_dfu_free_message(buf);
         return;
     }
 
@@ -259,7 +289,7 @@ void bm_dfu_process_message(uint8_t *buf, size_t len) {
     }
 
     if(!valid_packet) {
-        vPortFree(buf);
+        bm_dfu_free_message(buf);
         return;
     }
 
@@ -271,7 +301,7 @@ void bm_dfu_process_message(uint8_t *buf, size_t len) {
             evt.type = DFU_EVENT_RECEIVED_UPDATE_REQUEST;
             printf("Received update request\n");
             if(xQueueSend(dfu_event_queue, &evt, 0) != pdTRUE) {
-                vPortFree(buf);
+                bm_dfu_free_message(buf);
                 printf("Message could not be added to Queue\n");
             }
             break;
@@ -279,7 +309,7 @@ void bm_dfu_process_message(uint8_t *buf, size_t len) {
             evt.type = DFU_EVENT_IMAGE_CHUNK;
             printf("Received Payload\n");
             if(xQueueSend(dfu_event_queue, &evt, 0) != pdTRUE) {
-                vPortFree(buf);
+                bm_dfu_free_message(buf);
                 printf("Message could not be added to Queue\n");
             }
             break;
@@ -287,7 +317,7 @@ void bm_dfu_process_message(uint8_t *buf, size_t len) {
             evt.type = DFU_EVENT_UPDATE_END;
             printf("Received DFU End\n");
             if(xQueueSend(dfu_event_queue, &evt, 0) != pdTRUE) {
-                vPortFree(buf);
+                bm_dfu_free_message(buf);
                 printf("Message could not be added to Queue\n");
             }
             break;
@@ -295,7 +325,7 @@ void bm_dfu_process_message(uint8_t *buf, size_t len) {
             evt.type = DFU_EVENT_ACK_RECEIVED;
             printf("Received ACK\n");
             if(xQueueSend(dfu_event_queue, &evt, 0) != pdTRUE) {
-                vPortFree(buf);
+                bm_dfu_free_message(buf);
                 printf("Message could not be added to Queue\n");
             }
             break;
@@ -303,7 +333,7 @@ void bm_dfu_process_message(uint8_t *buf, size_t len) {
             evt.type = DFU_EVENT_ABORT;
             printf("Received Abort\n");
             if(xQueueSend(dfu_event_queue, &evt, 0) != pdTRUE) {
-                vPortFree(buf);
+                bm_dfu_free_message(buf);
                 printf("Message could not be added to Queue\n");
             }
             break;
@@ -311,35 +341,35 @@ void bm_dfu_process_message(uint8_t *buf, size_t len) {
             evt.type = DFU_EVENT_HEARTBEAT;
             printf("Received DFU Heartbeat\n");
             if(xQueueSend(dfu_event_queue, &evt, 0) != pdTRUE) {
-                vPortFree(buf);
+                bm_dfu_free_message(buf);
                 printf("Message could not be added to Queue\n");
             }
             break;
         case BCMP_DFU_PAYLOAD_REQ:
             evt.type = DFU_EVENT_CHUNK_REQUEST;
             if(xQueueSend(dfu_event_queue, &evt, 0) != pdTRUE) {
-                vPortFree(buf);
+                bm_dfu_free_message(buf);
                 printf("Message could not be added to Queue\n");
             }
             break;
         case BCMP_DFU_REBOOT_REQ:
             evt.type = DFU_EVENT_REBOOT_REQUEST;
             if(xQueueSend(dfu_event_queue, &evt, 0) != pdTRUE) {
-                vPortFree(buf);
+                bm_dfu_free_message(buf);
                 printf("Message could not be added to Queue\n");
             }
             break;
         case BCMP_DFU_REBOOT:
             evt.type = DFU_EVENT_REBOOT;
             if(xQueueSend(dfu_event_queue, &evt, 0) != pdTRUE) {
-                vPortFree(buf);
+                bm_dfu_free_message(buf);
                 printf("Message could not be added to Queue\n");
             }
             break;
         case BCMP_DFU_BOOT_COMPLETE:
             evt.type = DFU_EVENT_BOOT_COMPLETE;
             if(xQueueSend(dfu_event_queue, &evt, 0) != pdTRUE) {
-                vPortFree(buf);
+                bm_dfu_free_message(buf);
                 printf("Message could not be added to Queue\n");
             }
             break;
@@ -498,7 +528,7 @@ static void bm_dfu_event_thread(void*) {
             libSmRun(dfu_ctx.sm_ctx);
         }
         if (dfu_ctx.current_event.buf) {
-            vPortFree(dfu_ctx.current_event.buf);
+            bm_dfu_free_message(dfu_ctx.current_event.buf);
         }
     }
 }
@@ -564,7 +594,7 @@ bool bm_dfu_initiate_update(bm_dfu_img_info_t info, uint64_t dest_node_id, updat
         bm_dfu_event_t evt;
         size_t size = sizeof(dfu_host_start_event_t);
         evt.type = DFU_EVENT_BEGIN_HOST;
-        uint8_t *buf = static_cast<uint8_t*>(pvPortMalloc(size));
+        uint8_t *buf = bm_dfu_alloc_message(size);
         configASSERT(buf);
 
         dfu_host_start_event_t *start_event = reinterpret_cast<dfu_host_start_event_t*>(buf);
@@ -577,7 +607,7 @@ bool bm_dfu_initiate_update(bm_dfu_img_info_t info, uint64_t dest_node_id, updat
         evt.buf = buf;
         evt.len = size;
         if(xQueueSend(dfu_event_queue, &evt, 0) != pdTRUE) {
-            vPortFree(buf);
+            bm_dfu_free_message(buf);
             if(update_finish_callback) {
                 update_finish_callback(false, BM_DFU_ERR_IN_PROGRESS, dest_node_id);
             }
@@ -4,6 +4,7 @@
 #include "bm_dfu.h"
 #include "bm_serial.h"
 #include "device_info.h"
+#include "image_digest.h"
 #include "bootutil/bootutil_public.h"
 #include "bootutil/image.h"
 #include "flash_map_backend/flash_map_backend.h"
@@ -32,6 +33,8 @@ typedef struct {
     BridgePowerController * power_controller;
     bool power_controller_was_enabled;
     const struct flash_area * fa;
+    // Digest of the chunks written so far (as long as they arrive in order)
+    imageDigest_t digest;
 } ncp_dfu_ctx_t;
 
 static ncp_dfu_ctx_t _ctx;
@@ -112,7 +115,17 @@ bool ncp_dfu_start_cb(bm_serial_dfu_start_t *dfu_start) {
     bool rval = false;
     do {
         uint16_t computed_crc16;
-        if(!_ctx.dfu_cli_partition->crc16(DFU_IMG_START_OFFSET_BYTES, dfu_start->image_size, computed_crc16, IMG_CRC_TIMEOUT_MS)){
+        if(_ctx.digest.len == dfu_start->image_size) {
+            // Every chunk went through the digest, no need to read the image back
+            computed_crc16 = _ctx.digest.crc16;
+            imageDigestResult_t digest_result = imageDigestFinish(&_ctx.digest);
+            // Only good for one check, a retried start reads the image back
+            imageDigestInit(&_ctx.digest);
+            if(digest_result == IMAGE_DIGEST_MISMATCH) {
+                printf("Image SHA-256 doesn't match image TLV\n");
+                break;
+            }
+        } else if(!_ctx.dfu_cli_partition->crc16(DFU_IMG_START_OFFSET_BYTES, dfu_start->image_size, computed_crc16, IMG_CRC_TIMEOUT_MS)){
             break;
         }
         if(computed_crc16 != dfu_start->crc16) {
@@ -147,7 +160,14 @@ bool ncp_dfu_start_cb(bm_serial_dfu_start_t *dfu_start) {
  
 bool ncp_dfu_chunk_cb(uint32_t offset, size_t length, uint8_t * data) {
     bool rval = false;
+    if(offset == 0) {
+        imageDigestInit(&_ctx.digest);
+    }
     if(_ctx.dfu_cli_partition->write(DFU_IMG_START_OFFSET_BYTES + offset, data,length, FLASH_WRITE_READ_TIMEOUT_MS)){
+        // Out of order chunks fall back to reading the image back in ncp_dfu_start_cb
+        if(offset == _ctx.digest.len) {
+            imageDigestUpdate(&_ctx.digest, data, length);
+        }
         if (bm_serial_dfu_send_chunk(offset, 0, NULL) == BM_SERIAL_OK) {
             rval = true;
         }
@@ -163,6 +183,7 @@ void ncp_dfu_init(NvmPartition *dfu_cli_partition, BridgePowerController *power_
     _ctx.dfu_cli_partition = dfu_cli_partition;
     _ctx.power_controller = power_controller;
     _ctx.power_controller_was_enabled = false;
+    imageDigestInit(&_ctx.digest);
 }
 
 void ncp_dfu_check_for_update(void) {
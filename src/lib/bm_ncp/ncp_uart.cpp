@@ -2,6 +2,8 @@
 #include "FreeRTOS.h"
 #include "task.h"
 #include "queue.h"
+#include "semphr.h"
+#include "timers.h"
 
 #include "bm_pubsub.h"
 #include "bm_serial.h"
@@ -10,23 +12,58 @@
 #include "crc.h"
 #include "debug.h"
 #include "device_info.h"
+#include "frame_queue.h"
 #include "ncp_uart.h"
+#include "perf_counters.h"
 #include "stm32_rtc.h"
+#include "stm32u5xx_ll_dma.h"
 #include "stm32u5xx_ll_usart.h"
 #include "task_priorities.h"
+#include "tx_batch.h"
 #include "ncp_dfu.h"
-
-#define NCP_NOTIFY_BUFF_MASK ( 1 << 0)
-#define NCP_NOTIFY (1 << 1)
-
-
-static uint32_t ncpRXBuffIdx = 0;
-static uint8_t ncpRXCurrBuff = 0;
-static uint8_t ncpRXBuff[2][NCP_BUFF_LEN];
-static uint32_t ncpRXBuffLen[2];
-static uint8_t ncpRXBuffDecoded[NCP_BUFF_LEN];
-
-static uint8_t ncp_tx_buff[NCP_BUFF_LEN];
+#include "bm_usart.h"
+
+// Received frames waiting for the NCP task
+#define NCP_RX_FRAMES 4
+
+// The rx DMA writes into a ring buffer that is emptied into the frame queue
+// on idle line and on half/full transfer, so it only needs to hold the
+// bytes received between two of those
+#define NCP_RX_DMA_BUFF_LEN 512
+#define NCP_RX_DMA GPDMA1
+#define NCP_RX_DMA_CHANNEL LL_DMA_CHANNEL_0
+#define NCP_RX_DMA_IRQn GPDMA1_Channel0_IRQn
+#define NCP_RX_DMA_REQUEST LL_GPDMA1_REQUEST_USART3_RX
+// Same priority as the usart interrupt, so the two never preempt each other
+#define NCP_RX_IRQ_PRIORITY 6
+
+static uint8_t ncpRXFrameBuffs[NCP_RX_FRAMES][NCP_BUFF_LEN];
+static size_t ncpRXFrameLens[NCP_RX_FRAMES];
+static frameQueue_t ncpRXFrames;
+
+static uint8_t ncpRXDmaBuff[NCP_RX_DMA_BUFF_LEN];
+static uint32_t ncpRXDmaIdx;
+
+// Linked list item that reloads the block size and destination (and links
+// back to itself) at the end of every block, so the DMA runs as a circular
+// buffer. Layout is fixed by the update flags: CBR1, CDAR, CLLR.
+#define NCP_RX_DMA_NODE_UPDATE (LL_DMA_UPDATE_CBR1 | LL_DMA_UPDATE_CDAR | LL_DMA_UPDATE_CLLR)
+static uint32_t ncpRXDmaNode[3] __attribute__((aligned(4)));
+
+// Frames sent within NCP_TX_BATCH_DEADLINE_MS of each other go out in one
+// serial write. A batch is sent early once it reaches the threshold.
+#define NCP_TX_BATCH_LEN (NCP_BUFF_LEN * 2)
+#define NCP_TX_BATCH_THRESHOLD NCP_BUFF_LEN
+#define NCP_TX_BATCH_DEADLINE_MS 2
+#define NCP_TX_RATE_PERIOD_MS 1000
+
+// Worst case COBS encoded length (one overhead byte every 254) plus the delimiter
+#define NCP_COBS_MAX_LEN(len) ((len) + ((len) / 254) + 1 + 1)
+
+static txBatch_t ncpTXBatch;
+static SemaphoreHandle_t ncpTXMutex;
+static TimerHandle_t ncpTXDeadlineTimer;
+static TimerHandle_t ncpTXRateTimer;
 
 // static const NCPConfig_t *_config;
 
@@ -36,25 +73,79 @@ static SerialHandle_t *ncpSerialHandle = NULL;
 
 static void ncpRXTask(void *parameters);
 static BaseType_t ncpRXBytesFromISR(SerialHandle_t *handle, uint8_t *buffer, size_t len);
+static void ncpRXDmaStart(USART_TypeDef *usart);
+
+static bool ncpTXBatchFlush(uint8_t *buff, size_t len, void *ctx) {
+  (void)ctx;
+  // The serial tx task frees buff (or serialWriteNocopy does, if it fails)
+  return serialWriteNocopy(ncpSerialHandle, buff, len);
+}
+
+// The timers only flag the work and wake up the NCP task, since flushing
+// can block on the tx mutex and the serial tx queue (which would hold up
+// every other timer)
+static volatile bool ncpTXFlushPending;
+static volatile bool ncpTXRatePending;
+
+// Deadline for frames waiting in a batch
+static void ncpTXDeadlineTimerCb(TimerHandle_t timer) {
+  (void)timer;
+  ncpTXFlushPending = true;
+  xTaskNotifyGive(ncpRXTaskHandle);
+}
+
+static void ncpTXRateTimerCb(TimerHandle_t timer) {
+  (void)timer;
+  ncpTXRatePending = true;
+  xTaskNotifyGive(ncpRXTaskHandle);
+}
+
+// Timer work, done from the NCP task
+static void ncpTXTimerWork() {
+  if(ncpTXFlushPending) {
+    ncpTXFlushPending = false;
+    xSemaphoreTake(ncpTXMutex, portMAX_DELAY);
+    txBatchFlush(&ncpTXBatch);
+    xSemaphoreGive(ncpTXMutex);
+  }
+
+  if(ncpTXRatePending) {
+    ncpTXRatePending = false;
+    xSemaphoreTake(ncpTXMutex, portMAX_DELAY);
+    txBatchUpdateRates(&ncpTXBatch, NCP_TX_RATE_PERIOD_MS);
+    xSemaphoreGive(ncpTXMutex);
+  }
+}
 
 // Send out cobs encoded message over serial port
+// The message is encoded straight into the current tx batch
 static bool cobs_tx(const uint8_t *buff, size_t len) {
   bool rval = false;
   configASSERT(buff);
   configASSERT(len);
 
-  // reset the whole buff to zero
-  memset(&ncp_tx_buff, 0, NCP_BUFF_LEN);
+  xSemaphoreTake(ncpTXMutex, portMAX_DELAY);
 
-  // we then need to convert the whole thing to cobs!
-  cobs_encode_result cobs_result = cobs_encode(&ncp_tx_buff, NCP_BUFF_LEN - 1, buff, len);
+  size_t maxLen = NCP_COBS_MAX_LEN(len);
+  uint8_t *frame = txBatchReserve(&ncpTXBatch, maxLen);
+  if(frame != NULL) {
+    cobs_encode_result cobs_result = cobs_encode(frame, maxLen - 1, buff, len);
 
-  if(cobs_result.status == COBS_ENCODE_OK) {
-    // then we send the buffer out!
-    serialWrite(ncpSerialHandle, ncp_tx_buff, cobs_result.out_len + 1);
-    rval = true;
+    if(cobs_result.status == COBS_ENCODE_OK) {
+      // Frame delimiter
+      frame[cobs_result.out_len] = 0;
+
+      bool firstFrame = (txBatchPendingFrames(&ncpTXBatch) == 0);
+      if(!txBatchCommit(&ncpTXBatch, cobs_result.out_len + 1) && firstFrame) {
+        // Start the deadline for this batch
+        xTimerReset(ncpTXDeadlineTimer, 0);
+      }
+      rval = true;
+    }
   }
 
+  xSemaphoreGive(ncpTXMutex);
+
   return rval;
 }
 
@@ -147,6 +238,30 @@ void ncpInit(SerialHandle_t *ncpUartHandle, NvmPartition *dfu_partition, BridgeP
   // Set the rxBytesFromISR to the custom NCP one
   ncpSerialHandle->rxBytesFromISR = ncpRXBytesFromISR;
 
+  frameQueueInit(&ncpRXFrames, &ncpRXFrameBuffs[0][0], ncpRXFrameLens, NCP_BUFF_LEN, NCP_RX_FRAMES);
+  perfCounterRegister(&ncpRXFrames.frames, "ncp", "rx_frames", PERF_COUNTER_TYPE_COUNT);
+  perfCounterRegister(&ncpRXFrames.overruns, "ncp", "rx_overruns", PERF_COUNTER_TYPE_COUNT);
+  perfCounterRegister(&ncpRXFrames.oversize, "ncp", "rx_oversize", PERF_COUNTER_TYPE_COUNT);
+  perfCounterRegister(&ncpRXFrames.highWater, "ncp", "rx_queue_max", PERF_COUNTER_TYPE_MAX);
+
+  ncpTXMutex = xSemaphoreCreateMutex();
+  configASSERT(ncpTXMutex != NULL);
+
+  txBatchInit(&ncpTXBatch, NCP_TX_BATCH_LEN, NCP_TX_BATCH_THRESHOLD, ncpTXBatchFlush, NULL);
+  perfCounterRegister(&ncpTXBatch.frames, "ncp", "tx_frames", PERF_COUNTER_TYPE_COUNT);
+  perfCounterRegister(&ncpTXBatch.batches, "ncp", "tx_batches", PERF_COUNTER_TYPE_COUNT);
+  perfCounterRegister(&ncpTXBatch.bytes, "ncp", "tx_bytes", PERF_COUNTER_TYPE_COUNT);
+  perfCounterRegister(&ncpTXBatch.drops, "ncp", "tx_drops", PERF_COUNTER_TYPE_COUNT);
+  perfCounterRegister(&ncpTXBatch.framesPerBatchMax, "ncp", "tx_batch_max", PERF_COUNTER_TYPE_MAX);
+  perfCounterRegister(&ncpTXBatch.frameRate, "ncp", "tx_frames_per_s", PERF_COUNTER_TYPE_GAUGE);
+  perfCounterRegister(&ncpTXBatch.byteRate, "ncp", "tx_bytes_per_s", PERF_COUNTER_TYPE_GAUGE);
+
+  ncpTXDeadlineTimer = xTimerCreate("ncp_tx", pdMS_TO_TICKS(NCP_TX_BATCH_DEADLINE_MS), pdFALSE, NULL, ncpTXDeadlineTimerCb);
+  configASSERT(ncpTXDeadlineTimer != NULL);
+
+  ncpTXRateTimer = xTimerCreate("ncp_tx_rate", pdMS_TO_TICKS(NCP_TX_RATE_PERIOD_MS), pdTRUE, NULL, ncpTXRateTimerCb);
+  configASSERT(ncpTXRateTimer != NULL);
+
   configASSERT(dfu_partition);
   configASSERT(power_controller);
   ncp_dfu_init(dfu_partition, power_controller);
@@ -161,6 +276,10 @@ void ncpInit(SerialHandle_t *ncpUartHandle, NvmPartition *dfu_partition, BridgeP
               &ncpRXTaskHandle);
   configASSERT(rval == pdTRUE);
 
+  // The timers wake up the NCP task, so only start them once it exists
+  BaseType_t timerStarted = xTimerStart(ncpTXRateTimer, 10);
+  configASSERT(timerStarted == pdPASS);
+
   bm_serial_callbacks.tx_fn = cobs_tx;
   bm_serial_callbacks.pub_fn = bm_serial_pub_cb;
   bm_serial_callbacks.sub_fn = bm_serial_sub_cb;
@@ -175,6 +294,7 @@ void ncpInit(SerialHandle_t *ncpUartHandle, NvmPartition *dfu_partition, BridgeP
   bm_serial_set_callbacks(&bm_serial_callbacks);
 
   serialEnable(ncpSerialHandle);
+  ncpRXDmaStart((USART_TypeDef *)ncpSerialHandle->device);
   ncp_dfu_check_for_update();
 }
 
@@ -182,24 +302,114 @@ void ncpRXTask( void *parameters) {
   ( void ) parameters;
 
   for (;;) {
-    uint32_t taskNotifyValue = 0;
-    BaseType_t res = xTaskNotifyWait(pdFALSE, UINT32_MAX, &taskNotifyValue, portMAX_DELAY);
-
-    if (res != pdTRUE) {
-      printf("Error waiting for ncp task notification\n");
-      continue;
+    ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
+
+    ncpTXTimerWork();
+
+    uint8_t *frame;
+    size_t frameLen;
+    while((frame = frameQueuePeek(&ncpRXFrames, &frameLen)) != NULL) {
+      if(frameLen >= sizeof(bm_serial_packet_t)) {
+        // Decode the COBS in place (decoded data is never longer than the encoded data)
+        cobs_decode_result cobs_result = cobs_decode(frame, NCP_BUFF_LEN, frame, frameLen);
+        if(cobs_result.status == COBS_DECODE_OK) {
+          bm_serial_packet_t *packet = reinterpret_cast<bm_serial_packet_t *>(frame);
+          bm_serial_process_packet(packet, cobs_result.out_len);
+        }
+      }
+
+      frameQueuePop(&ncpRXFrames);
     }
+  }
+}
 
-    // this is used to determine which static buffer to read from
-    uint8_t bufferIdx = taskNotifyValue & NCP_NOTIFY_BUFF_MASK;
+/*!
+  Start the rx DMA. Received bytes go into a circular buffer and are
+  handed to the frame queue from the idle line and DMA interrupts, instead
+  of taking one interrupt per byte.
+
+  \param[in] *usart - NCP usart
+  \return none
+*/
+static void ncpRXDmaStart(USART_TypeDef *usart) {
+  // Byte interrupts aren't needed anymore (serialEnable turns them on)
+  usart_DisableIT_RXNE(usart);
+
+  ncpRXDmaIdx = 0;
+
+  LL_DMA_DisableChannel(NCP_RX_DMA, NCP_RX_DMA_CHANNEL);
+  LL_DMA_ConfigTransfer(NCP_RX_DMA, NCP_RX_DMA_CHANNEL,
+                        LL_DMA_SRC_FIXED | LL_DMA_SRC_DATAWIDTH_BYTE |
+                        LL_DMA_DEST_INCREMENT | LL_DMA_DEST_DATAWIDTH_BYTE);
+  LL_DMA_ConfigChannelTransfer(NCP_RX_DMA, NCP_RX_DMA_CHANNEL,
+                               LL_DMA_TCEM_BLK_TRANSFER | LL_DMA_HWREQUEST_SINGLEBURST |
+                               LL_DMA_DIRECTION_PERIPH_TO_MEMORY);
+  LL_DMA_SetPeriphRequest(NCP_RX_DMA, NCP_RX_DMA_CHANNEL, NCP_RX_DMA_REQUEST);
+  LL_DMA_SetSrcAddress(NCP_RX_DMA, NCP_RX_DMA_CHANNEL,
+                       LL_USART_DMA_GetRegAddr(usart, LL_USART_DMA_REG_DATA_RECEIVE));
+  LL_DMA_SetDestAddress(NCP_RX_DMA, NCP_RX_DMA_CHANNEL, (uint32_t)ncpRXDmaBuff);
+  LL_DMA_SetBlkDataLength(NCP_RX_DMA, NCP_RX_DMA_CHANNEL, sizeof(ncpRXDmaBuff));
+
+  ncpRXDmaNode[0] = sizeof(ncpRXDmaBuff);
+  ncpRXDmaNode[1] = (uint32_t)ncpRXDmaBuff;
+  ncpRXDmaNode[2] = NCP_RX_DMA_NODE_UPDATE | ((uint32_t)ncpRXDmaNode & DMA_CLLR_LA);
+  LL_DMA_SetLinkedListBaseAddr(NCP_RX_DMA, NCP_RX_DMA_CHANNEL, (uint32_t)ncpRXDmaNode);
+  LL_DMA_ConfigLinkUpdate(NCP_RX_DMA, NCP_RX_DMA_CHANNEL, NCP_RX_DMA_NODE_UPDATE,
+                          (uint32_t)ncpRXDmaNode);
+  LL_DMA_SetLinkStepMode(NCP_RX_DMA, NCP_RX_DMA_CHANNEL, LL_DMA_LSM_FULL_EXECUTION);
+
+  LL_DMA_ClearFlag_HT(NCP_RX_DMA, NCP_RX_DMA_CHANNEL);
+  LL_DMA_ClearFlag_TC(NCP_RX_DMA, NCP_RX_DMA_CHANNEL);
+  LL_DMA_EnableIT_HT(NCP_RX_DMA, NCP_RX_DMA_CHANNEL);
+  LL_DMA_EnableIT_TC(NCP_RX_DMA, NCP_RX_DMA_CHANNEL);
+  NVIC_SetPriority(NCP_RX_DMA_IRQn, NVIC_EncodePriority(NVIC_GetPriorityGrouping(), NCP_RX_IRQ_PRIORITY, 0));
+  NVIC_EnableIRQ(NCP_RX_DMA_IRQn);
+
+  LL_DMA_EnableChannel(NCP_RX_DMA, NCP_RX_DMA_CHANNEL);
+
+  LL_USART_ClearFlag_IDLE(usart);
+  LL_USART_EnableIT_IDLE(usart);
+  LL_USART_EnableDMAReq_RX(usart);
+}
 
+/*!
+  Move everything the DMA wrote since the last call into the frame queue
+  and wake up the NCP task if there are new frames.
 
-    // Decode the COBS
-    cobs_decode_result cobs_result = cobs_decode(ncpRXBuffDecoded, NCP_BUFF_LEN, ncpRXBuff[bufferIdx], ncpRXBuffLen[bufferIdx]);
-    bm_serial_packet_t *packet = reinterpret_cast<bm_serial_packet_t *>(ncpRXBuffDecoded);
+  \return higherPriorityTaskWoken
+*/
+static BaseType_t ncpRXDmaProcessFromISR() {
+  BaseType_t higherPriorityTaskWoken = pdFALSE;
 
-    bm_serial_process_packet(packet, cobs_result.out_len);
+  uint32_t dmaIdx = sizeof(ncpRXDmaBuff) - LL_DMA_GetBlkDataLength(NCP_RX_DMA, NCP_RX_DMA_CHANNEL);
+  if(dmaIdx >= sizeof(ncpRXDmaBuff)) {
+    dmaIdx = 0;
   }
+
+  uint32_t frames = 0;
+  if(dmaIdx < ncpRXDmaIdx) {
+    // Wrapped around
+    frames += frameQueuePut(&ncpRXFrames, &ncpRXDmaBuff[ncpRXDmaIdx], sizeof(ncpRXDmaBuff) - ncpRXDmaIdx);
+    ncpRXDmaIdx = 0;
+  }
+
+  if(dmaIdx > ncpRXDmaIdx) {
+    frames += frameQueuePut(&ncpRXFrames, &ncpRXDmaBuff[ncpRXDmaIdx], dmaIdx - ncpRXDmaIdx);
+    ncpRXDmaIdx = dmaIdx;
+  }
+
+  if(frames > 0) {
+    vTaskNotifyGiveFromISR(ncpRXTaskHandle, &higherPriorityTaskWoken);
+  }
+
+  return higherPriorityTaskWoken;
+}
+
+// NCP rx DMA half/full transfer
+extern "C" void GPDMA1_Channel0_IRQHandler(void) {
+  LL_DMA_ClearFlag_HT(NCP_RX_DMA, NCP_RX_DMA_CHANNEL);
+  LL_DMA_ClearFlag_TC(NCP_RX_DMA, NCP_RX_DMA_CHANNEL);
+  portYIELD_FROM_ISR(ncpRXDmaProcessFromISR());
 }
 
 // NCP USART rx irq
@@ -207,62 +417,28 @@ void ncpRXTask( void *parameters) {
 #ifndef DEBUG_USE_USART3
 extern "C" void USART3_IRQHandler(void) {
     configASSERT(ncpSerialHandle);
+
+    // Idle line, the other end is done sending for now
+    if(LL_USART_IsActiveFlag_IDLE(USART3) && LL_USART_IsEnabledIT_IDLE(USART3)) {
+      LL_USART_ClearFlag_IDLE(USART3);
+      portYIELD_FROM_ISR(ncpRXDmaProcessFromISR());
+    }
+
     serialGenericUartIRQHandler(ncpSerialHandle);
 }
 #endif
 
+// Bytes only come from the DMA now, but keep the byte path working in case
+// something feeds the handle directly
 // cppcheck-suppress constParameter
 static BaseType_t ncpRXBytesFromISR(SerialHandle_t *handle, uint8_t *buffer, size_t len) {
   ( void ) handle;
-
-  // Here we will just fill up the buffers until we receive a 0x00 char and then notify the task.
-  BaseType_t higherPriorityTaskWoken = pdFALSE;
-
-  uint8_t byte = buffer[0];
-
   configASSERT(buffer != NULL);
 
-  configASSERT(len == 1);
-
-  // but the byte into the current buffer
-  ncpRXBuff[ncpRXCurrBuff][ncpRXBuffIdx++] = byte;
-
-  do {
-    if(ncpRXBuffIdx >= NCP_BUFF_LEN) {
-      // too much data so lets reset the current buffer
-      ncpRXBuffIdx = 0;
-      break;
-    }
-
-    if(byte != 0) {
-      // Keep receiving data
-      break;
-    }
-
-    if(ncpRXBuffIdx <= sizeof(bm_serial_packet_t)) {
-      // Empty packet, reset current buffer
-      ncpRXBuffIdx = 0;
-      break;
-    }
-
-    // set the length of the current buff to the idx - 1 since we don't need the 0x00
-    ncpRXBuffLen[ncpRXCurrBuff] = ncpRXBuffIdx - 1;
-
-    ncpRXBuffIdx = 0;
-
-    BaseType_t rval = xTaskNotifyFromISR( ncpRXTaskHandle,
-                                          (ncpRXCurrBuff | NCP_NOTIFY),
-                                          eSetValueWithoutOverwrite,
-                                          &higherPriorityTaskWoken);
-    if (rval == pdFALSE) {
-      // previous packet still pending, 😬
-      // TODO - track dropped packets?
-      configASSERT(0);
-    } else {
-      // switch ncp buffers
-      ncpRXCurrBuff ^= 1;
-    }
-  } while(0);
+  BaseType_t higherPriorityTaskWoken = pdFALSE;
+  if(frameQueuePut(&ncpRXFrames, buffer, len) > 0) {
+    vTaskNotifyGiveFromISR(ncpRXTaskHandle, &higherPriorityTaskWoken);
+  }
 
   return higherPriorityTaskWoken;
 }
@@ -0,0 +1,111 @@
+#include <string.h>
+#include "FreeRTOS.h"
+#include "flash_read_cache.h"
+
+/*!
+  Initialize flash read cache
+
+  \param[out] *cache - cache to initialize
+  \param[in] *lines - line storage
+  \param[in] numLines - number of lines
+  \return none
+*/
+void flashReadCacheInit(flashReadCache_t *cache, flashReadCacheLine_t *lines, uint32_t numLines) {
+  configASSERT(cache != NULL);
+  configASSERT(lines != NULL);
+  configASSERT(numLines > 0);
+
+  memset(cache, 0, sizeof(flashReadCache_t));
+  cache->lines = lines;
+  cache->numLines = numLines;
+
+  for(uint32_t line = 0; line < numLines; line++) {
+    lines[line].valid = false;
+  }
+}
+
+/*!
+  Read from the cache
+
+  \param[in] *cache - flash read cache
+  \param[in] addr - flash address
+  \param[out] *buffer - buffer to read into
+  \param[in] len - number of bytes to read
+  \return true if all the data was in the cache, false otherwise (buffer
+          is untouched and the data has to be read from flash)
+*/
+bool flashReadCacheRead(flashReadCache_t *cache, uint32_t addr, uint8_t *buffer, size_t len) {
+  configASSERT(cache != NULL);
+  configASSERT(buffer != NULL);
+
+  if(!flashReadCacheable(addr, len)) {
+    return false;
+  }
+
+  uint32_t lineAddr = addr & ~FLASH_READ_CACHE_LINE_MASK;
+  for(uint32_t idx = 0; idx < cache->numLines; idx++) {
+    flashReadCacheLine_t *line = &cache->lines[idx];
+    if(line->valid && line->addr == lineAddr) {
+      memcpy(buffer, &line->data[addr - lineAddr], len);
+      line->lastUse = ++cache->useCount;
+      perfCounterInc(&cache->hits);
+      return true;
+    }
+  }
+
+  perfCounterInc(&cache->misses);
+  return false;
+}
+
+/*!
+  Get a line to fill with flash contents (the least recently used one).
+  The line is returned invalid. Read the whole line from flash into
+  line->data, then set line->valid if the read succeeded.
+
+  \param[in] *cache - flash read cache
+  \param[in] addr - any address in the line
+  \return line to fill
+*/
+flashReadCacheLine_t *flashReadCacheAlloc(flashReadCache_t *cache, uint32_t addr) {
+  configASSERT(cache != NULL);
+
+  flashReadCacheLine_t *victim = &cache->lines[0];
+  for(uint32_t idx = 0; idx < cache->numLines; idx++) {
+    flashReadCacheLine_t *line = &cache->lines[idx];
+    if(!line->valid) {
+      victim = line;
+      break;
+    }
+
+    if(line->lastUse < victim->lastUse) {
+      victim = line;
+    }
+  }
+
+  victim->valid = false;
+  victim->addr = addr & ~FLASH_READ_CACHE_LINE_MASK;
+  victim->lastUse = ++cache->useCount;
+
+  return victim;
+}
+
+/*!
+  Drop cached lines that overlap a flash range (after it's written/erased)
+
+  \param[in] *cache - flash read cache
+  \param[in] addr - start of range
+  \param[in] len - range length
+  \return none
+*/
+void flashReadCacheInvalidate(flashReadCache_t *cache, uint32_t addr, size_t len) {
+  configASSERT(cache != NULL);
+
+  for(uint32_t idx = 0; idx < cache->numLines; idx++) {
+    flashReadCacheLine_t *line = &cache->lines[idx];
+    if(line->valid &&
+       (line->addr < (addr + len)) &&
+       (addr < (line->addr + FLASH_READ_CACHE_LINE_SIZE))) {
+      line->valid = false;
+    }
+  }
+}
@@ -0,0 +1,58 @@
+#pragma once
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include "perf_counters.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+//
+// Small read cache for external flash.
+//
+// Keeps a few aligned lines of flash contents so repeated small reads
+// (configuration, DFU headers, ...) don't go out to the device every time.
+// Lines are replaced least recently used first. The owner is responsible
+// for invalidating anything it writes or erases, and for locking.
+//
+#define FLASH_READ_CACHE_LINE_SIZE (256)
+#define FLASH_READ_CACHE_LINE_MASK (FLASH_READ_CACHE_LINE_SIZE - 1)
+
+typedef struct {
+  uint32_t addr;
+  uint32_t lastUse;
+  bool valid;
+  uint8_t data[FLASH_READ_CACHE_LINE_SIZE];
+} flashReadCacheLine_t;
+
+typedef struct {
+  flashReadCacheLine_t *lines;
+  uint32_t numLines;
+  uint32_t useCount;
+
+  // Counters (registration is up to the owner)
+  perfCounter_t hits;
+  perfCounter_t misses;
+} flashReadCache_t;
+
+void flashReadCacheInit(flashReadCache_t *cache, flashReadCacheLine_t *lines, uint32_t numLines);
+bool flashReadCacheRead(flashReadCache_t *cache, uint32_t addr, uint8_t *buffer, size_t len);
+flashReadCacheLine_t *flashReadCacheAlloc(flashReadCache_t *cache, uint32_t addr);
+void flashReadCacheInvalidate(flashReadCache_t *cache, uint32_t addr, size_t len);
+
+/*!
+  Check if a read can be cached (fits in a single line)
+
+  \param[in] addr - flash address
+  \param[in] len - read length
+  \return true if the read is within one line
+*/
+static inline bool flashReadCacheable(uint32_t addr, size_t len) {
+  return (len > 0) && (((addr & FLASH_READ_CACHE_LINE_MASK) + len) <= FLASH_READ_CACHE_LINE_SIZE);
+}
+
+#ifdef __cplusplus
+}
+#endif
@@ -0,0 +1,136 @@
+#include <string.h>
+#include "FreeRTOS.h"
+#include "frame_queue.h"
+
+static inline uint8_t *frameBuffer(frameQueue_t *queue, uint32_t frame) {
+  return &queue->buffers[(frame % queue->numFrames) * queue->frameSize];
+}
+
+/*!
+  Initialize frame queue
+
+  \param[out] *queue - queue to initialize
+  \param[in] *buffers - frame storage (numFrames * frameSize bytes)
+  \param[in] *lengths - frame length storage (numFrames entries)
+  \param[in] frameSize - largest frame (not including delimiter)
+  \param[in] numFrames - number of frame slots
+  \return none
+*/
+void frameQueueInit(frameQueue_t *queue, uint8_t *buffers, size_t *lengths, size_t frameSize, uint32_t numFrames) {
+  configASSERT(queue != NULL);
+  configASSERT(buffers != NULL);
+  configASSERT(lengths != NULL);
+  configASSERT(frameSize > 0);
+  configASSERT(numFrames > 0);
+
+  memset(queue, 0, sizeof(frameQueue_t));
+  queue->buffers = buffers;
+  queue->lengths = lengths;
+  queue->frameSize = frameSize;
+  queue->numFrames = numFrames;
+}
+
+/*!
+  Add received bytes. Safe to call from an ISR.
+
+  \param[in] *queue - frame queue
+  \param[in] *data - received bytes
+  \param[in] len - number of bytes
+  \return number of frames completed
+*/
+uint32_t frameQueuePut(frameQueue_t *queue, const uint8_t *data, size_t len) {
+  configASSERT(queue != NULL);
+  configASSERT(data != NULL || len == 0);
+
+  uint32_t completed = 0;
+
+  while(len > 0) {
+    const uint8_t *delimiter = (const uint8_t *)memchr(data, FRAME_QUEUE_DELIMITER, len);
+    size_t segmentLen = (delimiter != NULL) ? (size_t)(delimiter - data) : len;
+
+    uint32_t head = queue->head;
+    uint32_t tail = __atomic_load_n(&queue->tail, __ATOMIC_ACQUIRE);
+
+    if(!queue->discard && segmentLen > 0) {
+      if((head - tail) >= queue->numFrames) {
+        // No free slot for this frame
+        queue->discard = true;
+        perfCounterInc(&queue->overruns);
+      } else if((queue->idx + segmentLen) > queue->frameSize) {
+        queue->discard = true;
+        perfCounterInc(&queue->oversize);
+      } else {
+        memcpy(&frameBuffer(queue, head)[queue->idx], data, segmentLen);
+        queue->idx += segmentLen;
+      }
+    }
+
+    if(delimiter == NULL) {
+      break;
+    }
+
+    // End of frame
+    if(!queue->discard && queue->idx > 0) {
+      queue->lengths[head % queue->numFrames] = queue->idx;
+      __atomic_store_n(&queue->head, head + 1, __ATOMIC_RELEASE);
+      perfCounterInc(&queue->frames);
+      perfCounterMax(&queue->highWater, head + 1 - tail);
+      completed++;
+    }
+    queue->idx = 0;
+    queue->discard = false;
+
+    data += segmentLen + 1;
+    len -= segmentLen + 1;
+  }
+
+  return completed;
+}
+
+/*!
+  Get the oldest complete frame. The frame stays in the queue (and its
+  buffer can be modified in place) until frameQueuePop() is called.
+
+  \param[in] *queue - frame queue
+  \param[out] *len - frame length
+  \return pointer to frame, NULL if the queue is empty
+*/
+uint8_t *frameQueuePeek(frameQueue_t *queue, size_t *len) {
+  configASSERT(queue != NULL);
+  configASSERT(len != NULL);
+
+  uint32_t tail = queue->tail;
+  if(__atomic_load_n(&queue->head, __ATOMIC_ACQUIRE) == tail) {
+    return NULL;
+  }
+
+  *len = queue->lengths[tail % queue->numFrames];
+  return frameBuffer(queue, tail);
+}
+
+/*!
+  Release the oldest frame (after it's been processed)
+
+  \param[in] *queue - frame queue
+  \return none
+*/
+void frameQueuePop(frameQueue_t *queue) {
+  configASSERT(queue != NULL);
+
+  uint32_t tail = queue->tail;
+  if(__atomic_load_n(&queue->head, __ATOMIC_ACQUIRE) != tail) {
+    __atomic_store_n(&queue->tail, tail + 1, __ATOMIC_RELEASE);
+  }
+}
+
+/*!
+  Get number of complete frames waiting to be consumed
+
+  \param[in] *queue - frame queue
+  \return number of frames
+*/
+uint32_t frameQueueCount(const frameQueue_t *queue) {
+  configASSERT(queue != NULL);
+
+  return __atomic_load_n(&queue->head, __ATOMIC_ACQUIRE) - __atomic_load_n(&queue->tail, __ATOMIC_ACQUIRE);
+}
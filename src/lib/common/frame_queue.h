@@ -0,0 +1,58 @@
+#pragma once
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include "perf_counters.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+//
+// Delimited frame queue.
+//
+// Splits a received byte stream into frames on FRAME_QUEUE_DELIMITER (the
+// COBS frame delimiter) and stores them in a ring of fixed size frame slots.
+// Bytes are put in from one ISR (or task) and frames are taken out by one
+// consumer task, so no locking is needed.
+//
+// When every slot is full, or a frame doesn't fit in a slot, the frame is
+// dropped (and counted) instead of overwriting frames not consumed yet.
+//
+#define FRAME_QUEUE_DELIMITER (0x00)
+
+typedef struct {
+  /// numFrames * frameSize bytes
+  uint8_t *buffers;
+  /// numFrames lengths
+  size_t *lengths;
+  size_t frameSize;
+  uint32_t numFrames;
+
+  /// Frames completed (written by producer)
+  volatile uint32_t head;
+  /// Frames consumed (written by consumer)
+  volatile uint32_t tail;
+
+  /// Bytes in the frame being received
+  size_t idx;
+  /// Dropping bytes until the next delimiter
+  bool discard;
+
+  // Counters (registration is up to the owner)
+  perfCounter_t frames;
+  perfCounter_t overruns;
+  perfCounter_t oversize;
+  perfCounter_t highWater;
+} frameQueue_t;
+
+void frameQueueInit(frameQueue_t *queue, uint8_t *buffers, size_t *lengths, size_t frameSize, uint32_t numFrames);
+uint32_t frameQueuePut(frameQueue_t *queue, const uint8_t *data, size_t len);
+uint8_t *frameQueuePeek(frameQueue_t *queue, size_t *len);
+void frameQueuePop(frameQueue_t *queue);
+uint32_t frameQueueCount(const frameQueue_t *queue);
+
+#ifdef __cplusplus
+}
+#endif
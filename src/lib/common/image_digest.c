@@ -0,0 +1,133 @@
+#include <string.h>
+#include "FreeRTOS.h"
+#include "crc.h"
+#include "image_digest.h"
+
+// From mcuboot's bootutil/image.h
+#define IMAGE_MAGIC             (0x96f3b83d)
+#define IMAGE_TLV_INFO_MAGIC    (0x6907)
+#define IMAGE_TLV_SHA256        (0x10)
+#define IMAGE_TLV_INFO_LEN      (4)
+#define IMAGE_TLV_LEN           (4)
+
+static inline uint16_t get16(const uint8_t *buff) {
+  return (uint16_t)(buff[0] | (buff[1] << 8));
+}
+
+static inline uint32_t get32(const uint8_t *buff) {
+  return (uint32_t)buff[0] | ((uint32_t)buff[1] << 8) | ((uint32_t)buff[2] << 16) | ((uint32_t)buff[3] << 24);
+}
+
+/*!
+  Figure out how much of the image the SHA-256 covers from the mcuboot header
+
+  \param[in,out] *digest - image digest (with the full header received)
+  \return none
+*/
+static void parseHeader(imageDigest_t *digest) {
+  if(get32(&digest->header[0]) == IMAGE_MAGIC) {
+    uint16_t hdrSize = get16(&digest->header[8]);
+    uint16_t protectTlvSize = get16(&digest->header[10]);
+    uint32_t imgSize = get32(&digest->header[12]);
+
+    digest->mcuboot = true;
+    digest->hashLen = hdrSize + imgSize + protectTlvSize;
+  }
+}
+
+/*!
+  Start a new image digest
+
+  \param[out] *digest - image digest to initialize
+  \return none
+*/
+void imageDigestInit(imageDigest_t *digest) {
+  configASSERT(digest != NULL);
+
+  memset(digest, 0, sizeof(imageDigest_t));
+  sha256Init(&digest->sha);
+  digest->hashLen = UINT32_MAX;
+}
+
+/*!
+  Add the next part of the image
+
+  \param[in,out] *digest - image digest
+  \param[in] *data - image data
+  \param[in] len - number of bytes
+  \return none
+*/
+void imageDigestUpdate(imageDigest_t *digest, const uint8_t *data, size_t len) {
+  configASSERT(digest != NULL);
+  configASSERT(data != NULL || len == 0);
+
+  digest->crc16 = crc16_ccitt(digest->crc16, data, len);
+
+  // Keep the header around until there's enough of it to parse
+  if(digest->len < IMAGE_DIGEST_HEADER_LEN) {
+    size_t headerBytes = IMAGE_DIGEST_HEADER_LEN - digest->len;
+    if(headerBytes > len) {
+      headerBytes = len;
+    }
+    memcpy(&digest->header[digest->len], data, headerBytes);
+    if((digest->len + headerBytes) == IMAGE_DIGEST_HEADER_LEN) {
+      parseHeader(digest);
+    }
+  }
+
+  // Split into the hashed part and the TLV area after it
+  size_t hashBytes = 0;
+  if(digest->len < digest->hashLen) {
+    hashBytes = digest->hashLen - digest->len;
+    if(hashBytes > len) {
+      hashBytes = len;
+    }
+    sha256Update(&digest->sha, data, hashBytes);
+  }
+
+  if(digest->mcuboot && (hashBytes < len) && (digest->tlvLen < IMAGE_DIGEST_TLV_BUFF_LEN)) {
+    size_t tlvBytes = len - hashBytes;
+    if(tlvBytes > (IMAGE_DIGEST_TLV_BUFF_LEN - digest->tlvLen)) {
+      tlvBytes = IMAGE_DIGEST_TLV_BUFF_LEN - digest->tlvLen;
+    }
+    memcpy(&digest->tlv[digest->tlvLen], &data[hashBytes], tlvBytes);
+    digest->tlvLen += tlvBytes;
+  }
+
+  digest->len += len;
+}
+
+/*!
+  Finish the SHA-256 (in digest->sha256) and compare it against the image's
+  SHA-256 TLV, if it has one
+
+  \param[in,out] *digest - image digest
+  \return comparison result
+*/
+imageDigestResult_t imageDigestFinish(imageDigest_t *digest) {
+  configASSERT(digest != NULL);
+
+  sha256Final(&digest->sha, digest->sha256);
+
+  imageDigestResult_t result = IMAGE_DIGEST_NO_TLV;
+  if(digest->mcuboot && (digest->tlvLen >= IMAGE_TLV_INFO_LEN) &&
+     (get16(&digest->tlv[0]) == IMAGE_TLV_INFO_MAGIC)) {
+    uint32_t offset = IMAGE_TLV_INFO_LEN;
+    while((offset + IMAGE_TLV_LEN) <= digest->tlvLen) {
+      uint16_t type = get16(&digest->tlv[offset]);
+      uint16_t len = get16(&digest->tlv[offset + 2]);
+      offset += IMAGE_TLV_LEN;
+
+      if(type == IMAGE_TLV_SHA256) {
+        if((len == SHA256_DIGEST_LEN) && ((offset + len) <= digest->tlvLen)) {
+          result = (memcmp(&digest->tlv[offset], digest->sha256, SHA256_DIGEST_LEN) == 0) ?
+                   IMAGE_DIGEST_MATCH : IMAGE_DIGEST_MISMATCH;
+        }
+        break;
+      }
+      offset += len;
+    }
+  }
+
+  return result;
+}
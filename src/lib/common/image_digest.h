@@ -0,0 +1,57 @@
+#pragma once
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include "sha256.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+//
+// Streaming firmware image digest.
+//
+// Keeps a CRC16 (CCITT, same as the DFU messages carry) over the whole image
+// and a SHA-256 as it's received, so checking the image once the last byte
+// arrives doesn't need another pass over flash.
+//
+// For mcuboot images, the SHA-256 covers what mcuboot hashes (header, body
+// and protected TLVs) and the start of the TLV area after it is kept, so the
+// digest can be compared against the image's SHA-256 TLV. Other images are
+// hashed whole.
+//
+#define IMAGE_DIGEST_TLV_BUFF_LEN   (128)
+#define IMAGE_DIGEST_HEADER_LEN     (32)
+
+typedef enum {
+  // Not an mcuboot image, or no SHA-256 TLV near the start of the TLV area
+  IMAGE_DIGEST_NO_TLV,
+  IMAGE_DIGEST_MATCH,
+  IMAGE_DIGEST_MISMATCH,
+} imageDigestResult_t;
+
+typedef struct {
+  sha256Ctx_t sha;
+  uint16_t crc16;
+  /// Bytes received so far
+  uint32_t len;
+  /// Bytes covered by the SHA-256 (UINT32_MAX until the header says otherwise)
+  uint32_t hashLen;
+  bool mcuboot;
+
+  uint8_t header[IMAGE_DIGEST_HEADER_LEN];
+  uint8_t tlv[IMAGE_DIGEST_TLV_BUFF_LEN];
+  uint32_t tlvLen;
+
+  /// Valid after imageDigestFinish()
+  uint8_t sha256[SHA256_DIGEST_LEN];
+} imageDigest_t;
+
+void imageDigestInit(imageDigest_t *digest);
+void imageDigestUpdate(imageDigest_t *digest, const uint8_t *data, size_t len);
+imageDigestResult_t imageDigestFinish(imageDigest_t *digest);
+
+#ifdef __cplusplus
+}
+#endif
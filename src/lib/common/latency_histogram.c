@@ -0,0 +1,134 @@
+#include <string.h>
+#include "latency_histogram.h"
+
+/*!
+  Get bucket index for a value
+
+  \param[in] value - value to find bucket for
+  \return bucket index
+*/
+static uint32_t bucketIndex(uint32_t value) {
+  uint32_t idx;
+  if(value < LATENCY_HISTOGRAM_SUB_BUCKETS) {
+    idx = value;
+  } else {
+    uint32_t msb = 31 - __builtin_clz(value);
+    uint32_t shift = msb - LATENCY_HISTOGRAM_SUB_BUCKET_BITS;
+    idx = ((shift + 1) << LATENCY_HISTOGRAM_SUB_BUCKET_BITS) +
+          ((value >> shift) & (LATENCY_HISTOGRAM_SUB_BUCKETS - 1));
+  }
+  return idx;
+}
+
+/*!
+  Get the largest value that falls in a bucket
+
+  \param[in] idx - bucket index
+  \return largest value in bucket
+*/
+static uint32_t bucketUpperBound(uint32_t idx) {
+  uint32_t upper;
+  if(idx < LATENCY_HISTOGRAM_SUB_BUCKETS) {
+    upper = idx;
+  } else {
+    uint32_t shift = (idx >> LATENCY_HISTOGRAM_SUB_BUCKET_BITS) - 1;
+    uint32_t sub = idx & (LATENCY_HISTOGRAM_SUB_BUCKETS - 1);
+    uint64_t lower = (uint64_t)(LATENCY_HISTOGRAM_SUB_BUCKETS + sub) << shift;
+    upper = (uint32_t)(lower + (1ULL << shift) - 1);
+  }
+  return upper;
+}
+
+/*!
+  Clear all recorded values
+
+  \param[in] *hist - histogram
+  \return none
+*/
+void latencyHistogramReset(latencyHistogram_t *hist) {
+  memset(hist, 0, sizeof(latencyHistogram_t));
+  hist->min = UINT32_MAX;
+}
+
+/*!
+  Record a value
+
+  \param[in] *hist - histogram
+  \param[in] value - value to record
+  \return none
+*/
+void latencyHistogramAdd(latencyHistogram_t *hist, uint32_t value) {
+  hist->buckets[bucketIndex(value)]++;
+  hist->count++;
+  hist->sum += value;
+  if(value < hist->min) {
+    hist->min = value;
+  }
+  if(value > hist->max) {
+    hist->max = value;
+  }
+}
+
+/*!
+  Get value at a given percentile. Result is the upper bound of the bucket
+  the percentile falls in (but never more than the maximum recorded value).
+
+  \param[in] *hist - histogram
+  \param[in] percentile - percentile (0-100)
+  \return value at percentile, 0 if histogram is empty
+*/
+uint32_t latencyHistogramPercentile(const latencyHistogram_t *hist, float percentile) {
+  uint32_t rval = 0;
+
+  do {
+    if(hist->count == 0) {
+      break;
+    }
+
+    if(percentile < 0) {
+      percentile = 0;
+    } else if(percentile > 100) {
+      percentile = 100;
+    }
+
+    // Rank of the sample we're looking for, starting at 1
+    uint32_t rank = (uint32_t)((percentile * hist->count) / 100.0f + 0.999f);
+    if(rank == 0) {
+      rank = 1;
+    } else if(rank > hist->count) {
+      rank = hist->count;
+    }
+
+    uint32_t seen = 0;
+    for(uint32_t idx = 0; idx < LATENCY_HISTOGRAM_NUM_BUCKETS; idx++) {
+      seen += hist->buckets[idx];
+      if(seen >= rank) {
+        rval = bucketUpperBound(idx);
+        break;
+      }
+    }
+
+    if(rval > hist->max) {
+      rval = hist->max;
+    }
+    if(rval < hist->min) {
+      rval = hist->min;
+    }
+  } while(0);
+
+  return rval;
+}
+
+/*!
+  Get mean of all recorded values
+
+  \param[in] *hist - histogram
+  \return mean value, 0 if histogram is empty
+*/
+uint32_t latencyHistogramMean(const latencyHistogram_t *hist) {
+  uint32_t rval = 0;
+  if(hist->count) {
+    rval = (uint32_t)(hist->sum / hist->count);
+  }
+  return rval;
+}
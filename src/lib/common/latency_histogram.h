@@ -0,0 +1,35 @@
+#pragma once
+
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+//
+// Fixed size log-linear histogram for latency measurements.
+//
+// Each power of two range is split into 8 linear sub-buckets, so any value
+// can be recorded with at most 12.5% error without storing samples. Covers
+// the whole uint32_t range (1us to ~71 minutes when recording microseconds).
+//
+#define LATENCY_HISTOGRAM_SUB_BUCKET_BITS   (3)
+#define LATENCY_HISTOGRAM_SUB_BUCKETS       (1 << LATENCY_HISTOGRAM_SUB_BUCKET_BITS)
+#define LATENCY_HISTOGRAM_NUM_BUCKETS       ((32 - LATENCY_HISTOGRAM_SUB_BUCKET_BITS + 1) * LATENCY_HISTOGRAM_SUB_BUCKETS)
+
+typedef struct {
+  uint32_t count;
+  uint32_t min;
+  uint32_t max;
+  uint64_t sum;
+  uint32_t buckets[LATENCY_HISTOGRAM_NUM_BUCKETS];
+} latencyHistogram_t;
+
+void latencyHistogramReset(latencyHistogram_t *hist);
+void latencyHistogramAdd(latencyHistogram_t *hist, uint32_t value);
+uint32_t latencyHistogramPercentile(const latencyHistogram_t *hist, float percentile);
+uint32_t latencyHistogramMean(const latencyHistogram_t *hist);
+
+#ifdef __cplusplus
+}
+#endif
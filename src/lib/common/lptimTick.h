@@ -0,0 +1,46 @@
+#pragma once
+
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+//
+// Monotonic clock from the LPTIM that drives the OS tick.
+//
+// The LPTIM counter free runs (16 bits) through tickless idle and stop
+// modes, and the tick interrupt always fires before it wraps, so extending
+// it to 64 bits in the interrupt and on every read gives a clock that never
+// goes backwards or loses time while the scheduler sleeps. Resolution is
+// one LPTIM count (~30.5us with a 32768Hz LSE).
+//
+uint64_t lptimGetMicroSeconds(void);
+
+/*!
+  Extend a free running 16 bit count to 64 bits. The count has to be
+  sampled at least once per wrap.
+
+  \param[in] lastCount - previous extended count
+  \param[in] count - current 16 bit count
+  \return extended count
+*/
+static inline uint64_t lptimExtendCount(uint64_t lastCount, uint16_t count) {
+  return lastCount + (uint16_t)(count - (uint16_t)lastCount);
+}
+
+/*!
+  Convert timer counts to microseconds without overflowing the intermediate
+  product
+
+  \param[in] counts - timer counts
+  \param[in] clockHz - timer clock frequency
+  \return microseconds
+*/
+static inline uint64_t lptimCountsToMicroSeconds(uint64_t counts, uint32_t clockHz) {
+  return ((counts / clockHz) * 1000000ULL) + (((counts % clockHz) * 1000000ULL) / clockHz);
+}
+
+#ifdef __cplusplus
+}
+#endif
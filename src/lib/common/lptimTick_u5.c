@@ -30,6 +30,7 @@
 #include "FreeRTOS.h"
 #include "task.h"
 #include "stm32u5xx.h"
+#include "lptimTick.h"
 
 //      This FreeRTOS port "extension" for STM32 uses LPTIM to generate the OS tick instead of the systick
 // timer.  The benefit of the LPTIM is that it continues running in "stop" mode as long as its clock source
@@ -220,6 +221,10 @@ static volatile uint8_t isCmpWriteInProgress;   //   This field helps us remembe
 static volatile uint8_t isTickNowSuppressed;    //   This field helps the tick ISR determine whether
                                                 // usIdealCmp is in the past or the future.
 
+static volatile uint64_t ullExtendedCount;      //   LPTIM->CNT extended to 64 bits.  Updated by the tick ISR,
+                                                // which runs at least once per counter wrap even during
+                                                // tickless idle, and by lptimGetMicroSeconds().
+
 
 // LPTIM Instance Selection
 //
@@ -237,6 +242,29 @@ static volatile uint8_t isTickNowSuppressed;    //   This field helps the tick I
 #define LPTIM_IRQHandler   LPTIM1_IRQHandler
 #endif
 
+//============================================================================================================
+// prvReadExtendedCount()
+//
+//      Get a coherent copy of the current count value in the timer and fold it into ullExtendedCount.  The
+// CNT register is clocked asynchronously, so we keep reading it until we get the same value during a
+// verification read.  Interrupts are masked (up to the max syscall priority) for the read and the update
+// together; otherwise an interrupt could store a newer count between the two and our older count would look
+// like a counter wrap.  The low 16 bits of the return value are the CNT value.
+//
+static uint64_t prvReadExtendedCount( void )
+{
+   UBaseType_t uxSavedInterruptStatus = portSET_INTERRUPT_MASK_FROM_ISR();
+
+   uint32_t ulCountValue;
+   do ulCountValue = LPTIM->CNT; while (ulCountValue != LPTIM->CNT);
+   uint64_t ullCount = lptimExtendCount( ullExtendedCount, (uint16_t)ulCountValue );
+   ullExtendedCount = ullCount;
+
+   portCLEAR_INTERRUPT_MASK_FROM_ISR( uxSavedInterruptStatus );
+
+   return ullCount;
+}
+
 //============================================================================================================
 // vPortSetupTimerInterrupt()
 //
@@ -649,8 +677,7 @@ void LPTIM_IRQHandler( void )
    // determination because it reliably reflects the match time we want right now, regardless of the sync
    // mechanism for CCR1.
    //
-   uint32_t ulCountValue;
-   do ulCountValue = LPTIM->CNT; while (ulCountValue != LPTIM->CNT);
+   uint32_t ulCountValue = (uint16_t)prvReadExtendedCount();
    uint32_t ulCountsLate = (uint16_t)(ulCountValue - usIdealCmp);
 
    //      If we're more than one full tick late, then the application masked interrupts for too long.  That
@@ -763,4 +790,16 @@ void LPTIM_IRQHandler( void )
    }
 }
 
+//============================================================================================================
+// lptimGetMicroSeconds()
+//
+//      Monotonic microseconds since the LPTIM started, with one timer count of resolution.  Safe to call from
+// tasks and from ISRs at or below configMAX_SYSCALL_INTERRUPT_PRIORITY, and keeps counting through tickless
+// idle and stop modes.
+//
+uint64_t lptimGetMicroSeconds( void )
+{
+   return lptimCountsToMicroSeconds( prvReadExtendedCount(), LPTIM_CLOCK_HZ );
+}
+
 #endif  // configUSE_TICKLESS_IDLE == 2
\ No newline at end of file
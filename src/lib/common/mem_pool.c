@@ -0,0 +1,250 @@
+#include <inttypes.h>
+#include <stdio.h>
+#include <string.h>
+#include "FreeRTOS.h"
+#include "mem_pool.h"
+
+#define INDEX_MASK  (0xFFFFUL)
+#define TAG_INC     (0x10000UL)
+
+// Registry of pools that have been used (only ever pushed to)
+static memPool_t *_pools;
+
+static inline uint8_t *blockAt(memPool_t *pool, uint32_t index) {
+  return &pool->storage[index * pool->blockSize];
+}
+
+/*!
+  Add pool to the registry the first time it's used. Lock-free, so it's
+  fine from an ISR.
+
+  \param[in] *pool - pool to register
+  \return none
+*/
+static void registerPool(memPool_t *pool) {
+  if(__atomic_load_n(&pool->registered, __ATOMIC_ACQUIRE) ||
+     __atomic_exchange_n(&pool->registered, 1, __ATOMIC_ACQ_REL)) {
+    return;
+  }
+
+  memPool_t *head = __atomic_load_n(&_pools, __ATOMIC_RELAXED);
+  do {
+    pool->next = head;
+  } while(!__atomic_compare_exchange_n(&_pools, &head, pool, true, __ATOMIC_RELEASE, __ATOMIC_RELAXED));
+}
+
+/*!
+  Take a block from the pool (free list first, then blocks never used yet)
+
+  \param[in] *pool - pool to take from
+  \return block, NULL if the pool is empty
+*/
+static void *takeBlock(memPool_t *pool) {
+  uint32_t head = __atomic_load_n(&pool->freeHead, __ATOMIC_ACQUIRE);
+  while(head & INDEX_MASK) {
+    uint8_t *block = blockAt(pool, (head & INDEX_MASK) - 1);
+    // If someone else takes this block before our CAS, the tag won't match
+    // and whatever we read here gets thrown away
+    uint16_t next;
+    memcpy(&next, block, sizeof(next));
+    uint32_t newHead = ((head + TAG_INC) & ~INDEX_MASK) | next;
+    if(__atomic_compare_exchange_n(&pool->freeHead, &head, newHead, true, __ATOMIC_ACQUIRE, __ATOMIC_ACQUIRE)) {
+      return block;
+    }
+  }
+
+  uint32_t touched = __atomic_load_n(&pool->numTouched, __ATOMIC_RELAXED);
+  while(touched < pool->numBlocks) {
+    if(__atomic_compare_exchange_n(&pool->numTouched, &touched, touched + 1, true, __ATOMIC_RELAXED, __ATOMIC_RELAXED)) {
+      return blockAt(pool, touched);
+    }
+  }
+
+  return NULL;
+}
+
+/*!
+  Return a block to the pool's free list
+
+  \param[in] *pool - pool the block came from
+  \param[in] *block - block to return
+  \return none
+*/
+static void giveBlock(memPool_t *pool, uint8_t *block) {
+  uint32_t index = (uint32_t)(block - pool->storage) / pool->blockSize;
+  configASSERT(blockAt(pool, index) == block);
+
+  uint32_t head = __atomic_load_n(&pool->freeHead, __ATOMIC_RELAXED);
+  uint32_t newHead;
+  do {
+    uint16_t next = (uint16_t)(head & INDEX_MASK);
+    memcpy(block, &next, sizeof(next));
+    newHead = ((head + TAG_INC) & ~INDEX_MASK) | (index + 1);
+  } while(!__atomic_compare_exchange_n(&pool->freeHead, &head, newHead, true, __ATOMIC_RELEASE, __ATOMIC_RELAXED));
+}
+
+/*!
+  Allocate one object from the pool
+
+  \param[in] *pool - pool to allocate from
+  \return pointer to object (MEM_POOL_ALIGNMENT aligned), NULL if the pool
+          is empty and there's no heap fallback (or the heap is full too)
+*/
+void *memPoolAlloc(memPool_t *pool) {
+  configASSERT(pool);
+  configASSERT(pool->numBlocks <= MEM_POOL_MAX_BLOCKS);
+
+  registerPool(pool);
+
+  void *ptr = takeBlock(pool);
+  if(ptr) {
+    uint32_t inUse = __atomic_add_fetch(&pool->inUse, 1, __ATOMIC_RELAXED);
+    uint32_t highWater = __atomic_load_n(&pool->highWater, __ATOMIC_RELAXED);
+    while((inUse > highWater) &&
+          !__atomic_compare_exchange_n(&pool->highWater, &highWater, inUse, true, __ATOMIC_RELAXED, __ATOMIC_RELAXED)) {
+      // highWater is reloaded by compare_exchange on failure
+    }
+  } else {
+    __atomic_fetch_add(&pool->exhausted, 1, __ATOMIC_RELAXED);
+    if(pool->heapFallback) {
+      ptr = pvPortMalloc(pool->blockSize);
+      if(ptr) {
+        __atomic_fetch_add(&pool->heapAllocs, 1, __ATOMIC_RELAXED);
+      }
+    }
+  }
+
+  return ptr;
+}
+
+/*!
+  Allocate a variable size buffer, from the pool if it fits in a block
+
+  \param[in] *pool - pool to allocate from
+  \param[in] size - bytes needed
+  \return pointer to buffer, NULL if it can't be allocated
+*/
+void *memPoolAllocSize(memPool_t *pool, size_t size) {
+  configASSERT(pool);
+
+  void *ptr = NULL;
+  if(size <= pool->blockSize) {
+    ptr = memPoolAlloc(pool);
+  } else if(pool->heapFallback) {
+    registerPool(pool);
+    ptr = pvPortMalloc(size);
+    if(ptr) {
+      __atomic_fetch_add(&pool->heapAllocs, 1, __ATOMIC_RELAXED);
+    }
+  }
+
+  return ptr;
+}
+
+/*!
+  Free an object from memPoolAlloc/memPoolAllocSize
+
+  \param[in] *pool - pool it was allocated from
+  \param[in] *ptr - object to free (NULL is ignored)
+  \return none
+*/
+void memPoolFree(memPool_t *pool, void *ptr) {
+  configASSERT(pool);
+
+  if(ptr == NULL) {
+    return;
+  }
+
+  if(memPoolOwns(pool, ptr)) {
+    giveBlock(pool, (uint8_t *)ptr);
+    __atomic_fetch_sub(&pool->inUse, 1, __ATOMIC_RELAXED);
+  } else {
+    configASSERT(pool->heapFallback);
+    vPortFree(ptr);
+  }
+}
+
+/*!
+  Check whether a pointer is one of the pool's blocks
+
+  \param[in] *pool - pool
+  \param[in] *ptr - pointer to check
+  \return true if ptr is in the pool's storage
+*/
+bool memPoolOwns(const memPool_t *pool, const void *ptr) {
+  configASSERT(pool);
+
+  const uint8_t *bytes = (const uint8_t *)ptr;
+  return (bytes >= pool->storage) && (bytes < &pool->storage[pool->blockSize * pool->numBlocks]);
+}
+
+/*!
+  Get pool usage
+
+  \param[in] *pool - pool
+  \param[out] *stats - usage
+  \return none
+*/
+void memPoolGetStats(const memPool_t *pool, memPoolStats_t *stats) {
+  configASSERT(pool);
+  configASSERT(stats);
+
+  stats->blockSize = pool->blockSize;
+  stats->numBlocks = pool->numBlocks;
+  stats->inUse = __atomic_load_n(&pool->inUse, __ATOMIC_RELAXED);
+  stats->highWater = __atomic_load_n(&pool->highWater, __ATOMIC_RELAXED);
+  stats->exhausted = __atomic_load_n(&pool->exhausted, __ATOMIC_RELAXED);
+  stats->heapAllocs = __atomic_load_n(&pool->heapAllocs, __ATOMIC_RELAXED);
+}
+
+/*!
+  Get first registered pool. Use pool->next to iterate.
+  Pools are never removed, so iterating doesn't require locking.
+
+  \return pointer to first pool, NULL if none have been used
+*/
+memPool_t *memPoolsFirst(void) {
+  return __atomic_load_n(&_pools, __ATOMIC_ACQUIRE);
+}
+
+/*!
+  Summarize how fragmented the remaining heap is
+
+  \param[out] *report - heap report
+  \return none
+*/
+void memPoolHeapReport(memPoolHeapReport_t *report) {
+  configASSERT(report);
+
+  HeapStats_t heapStats;
+  vPortGetHeapStats(&heapStats);
+  report->freeBytes = heapStats.xAvailableHeapSpaceInBytes;
+  report->largestFreeBlock = heapStats.xSizeOfLargestFreeBlockInBytes;
+  report->numFreeBlocks = heapStats.xNumberOfFreeBlocks;
+  report->minEverFreeBytes = heapStats.xMinimumEverFreeBytesRemaining;
+  report->fragmentationPctX100 = 0;
+  if(report->freeBytes) {
+    report->fragmentationPctX100 = 10000 - (uint32_t)(((uint64_t)report->largestFreeBlock * 10000) / report->freeBytes);
+  }
+}
+
+/*!
+  Print usage of every pool and the heap fragmentation report
+
+  \return none
+*/
+void memPoolsPrint(void) {
+  for(memPool_t *pool = memPoolsFirst(); pool; pool = pool->next) {
+    memPoolStats_t stats;
+    memPoolGetStats(pool, &stats);
+    printf("%s: %" PRIu32 "x%" PRIu32 "B in_use %" PRIu32 " hwm %" PRIu32 " exhausted %" PRIu32 " heap %" PRIu32 "\n",
+           pool->name, stats.numBlocks, stats.blockSize, stats.inUse, stats.highWater,
+           stats.exhausted, stats.heapAllocs);
+  }
+
+  memPoolHeapReport_t report;
+  memPoolHeapReport(&report);
+  printf("heap: free %" PRIu32 " largest %" PRIu32 " free_blocks %" PRIu32 " min_free %" PRIu32 " frag %" PRIu32 ".%02" PRIu32 "%%\n",
+         report.freeBytes, report.largestFreeBlock, report.numFreeBlocks, report.minEverFreeBytes,
+         report.fragmentationPctX100 / 100, report.fragmentationPctX100 % 100);
+}
@@ -0,0 +1,87 @@
+#pragma once
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+//
+// Fixed size block pools with O(1), lock-free alloc and free.
+//
+
+#define MEM_POOL_ALIGNMENT    (8)
+#define MEM_POOL_MAX_BLOCKS   (UINT16_MAX)
+
+#define MEM_POOL_BLOCK_SIZE(size) ((((size) + MEM_POOL_ALIGNMENT - 1) / MEM_POOL_ALIGNMENT) * MEM_POOL_ALIGNMENT)
+
+typedef struct memPool_s {
+  const char *name;
+  uint32_t blockSize;
+  uint32_t numBlocks;
+  uint8_t *storage;
+  bool heapFallback;
+
+  // (tag << 16) | (block index + 1), 0 index when empty. The tag changes on
+  // every update so a stale compare-and-swap can't succeed (ABA).
+  volatile uint32_t freeHead;
+  // Blocks past this index have never been handed out
+  volatile uint32_t numTouched;
+
+  volatile uint32_t inUse;
+  volatile uint32_t highWater;
+  // Allocations that found the pool empty
+  volatile uint32_t exhausted;
+  // Allocations that went to the heap instead (exhausted or too large)
+  volatile uint32_t heapAllocs;
+
+  volatile uint32_t registered;
+  struct memPool_s *next;
+} memPool_t;
+
+typedef struct {
+  uint32_t blockSize;
+  uint32_t numBlocks;
+  uint32_t inUse;
+  uint32_t highWater;
+  uint32_t exhausted;
+  uint32_t heapAllocs;
+} memPoolStats_t;
+
+typedef struct {
+  uint32_t freeBytes;
+  uint32_t largestFreeBlock;
+  uint32_t numFreeBlocks;
+  uint32_t minEverFreeBytes;
+  // 0 when all free memory is one block, approaching 10000 as it's split up
+  uint32_t fragmentationPctX100;
+} memPoolHeapReport_t;
+
+/*!
+  Define a statically allocated pool
+
+  \param var - pool variable name (also used as the pool name)
+  \param size - size of each object
+  \param count - number of objects
+  \param fallback - use the heap when the pool is empty or a memPoolAllocSize
+                   request doesn't fit in a block (task context only; without
+                   it, allocation returns NULL)
+*/
+#define MEM_POOL_DEFINE(var, size, count, fallback) \
+  static uint8_t var##_storage[MEM_POOL_BLOCK_SIZE(size) * (count)] __attribute__((aligned(MEM_POOL_ALIGNMENT))); \
+  static memPool_t var = {#var, MEM_POOL_BLOCK_SIZE(size), (count), var##_storage, (fallback), 0, 0, 0, 0, 0, 0, 0, NULL}
+
+void *memPoolAlloc(memPool_t *pool);
+void *memPoolAllocSize(memPool_t *pool, size_t size);
+void memPoolFree(memPool_t *pool, void *ptr);
+bool memPoolOwns(const memPool_t *pool, const void *ptr);
+void memPoolGetStats(const memPool_t *pool, memPoolStats_t *stats);
+memPool_t *memPoolsFirst(void);
+void memPoolHeapReport(memPoolHeapReport_t *report);
+void memPoolsPrint(void);
+
+#ifdef __cplusplus
+}
+#endif
@@ -9,12 +9,12 @@ NvmPartition::NvmPartition(AbstractStorageDriver& storage_driver, const ext_flas
 }
 
 bool NvmPartition::read(uint32_t offset, uint8_t *buffer, size_t len, uint32_t timeoutMs) {
-    configASSERT(offset + len < _partition.fa_size);
+    configASSERT(offset + len <= _partition.fa_size);
     return _storage_driver.read(_partition.fa_off + offset, buffer, len, timeoutMs);
 }
 
 bool NvmPartition::write(uint32_t offset, uint8_t *buffer, size_t len, uint32_t timeoutMs) {
-    configASSERT(offset + len < _partition.fa_size);
+    configASSERT(offset + len <= _partition.fa_size);
     return _storage_driver.write(_partition.fa_off+offset, buffer, len, timeoutMs);
 }
 
@@ -23,7 +23,7 @@ uint32_t NvmPartition::size(void) {
 }
 
 bool NvmPartition::erase(uint32_t offset, size_t len, uint32_t timeoutMs) {
-    configASSERT(offset + len + (len % _storage_driver.getAlignmentBytes()) < _partition.fa_size);
+    configASSERT(offset + len + (len % _storage_driver.getAlignmentBytes()) <= _partition.fa_size);
     return _storage_driver.erase(_partition.fa_off + offset, len, timeoutMs);
 }
 
@@ -32,6 +32,6 @@ uint32_t NvmPartition::alignment(void) {
 }
 
 bool NvmPartition::crc16(uint32_t offset, size_t len, uint16_t &crc, uint32_t timeoutMs) {
-    configASSERT(offset + len + (len % _storage_driver.getAlignmentBytes()) < _partition.fa_size);
+    configASSERT(offset + len + (len % _storage_driver.getAlignmentBytes()) <= _partition.fa_size);
     return _storage_driver.crc16(_partition.fa_off + offset, len, crc, timeoutMs);
 }
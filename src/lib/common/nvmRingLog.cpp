@@ -0,0 +1,443 @@
+#include "nvmRingLog.h"
+#include "FreeRTOS.h"
+#include "crc.h"
+#include <stdio.h>
+#include <string.h>
+
+NvmRingLog::NvmRingLog(NvmPartition &partition):
+        _partition(partition), _sectorSize(0), _numSectors(0), _stage(NULL), _seq(0),
+        _writeSector(0), _writeOffset(0), _flushedOffset(0), _readSector(0), _readOffset(0),
+        _initialized(false) {
+    memset(&_stats, 0, sizeof(_stats));
+}
+
+NvmRingLog::~NvmRingLog() {
+    if(_stage) {
+        vPortFree(_stage);
+    }
+}
+
+/*!
+  Scan the partition and recover read/write positions from the sector headers.
+  Starts a new log if no valid sectors are found.
+
+  \param[in] timeoutMs - flash operation timeout
+  \return true if the log is ready to use, false otherwise
+*/
+bool NvmRingLog::init(uint32_t timeoutMs) {
+    bool rval = false;
+    do {
+        _sectorSize = _partition.alignment();
+        _numSectors = _partition.size() / _sectorSize;
+        configASSERT(_numSectors >= 2);
+
+        if(!_stage) {
+            _stage = static_cast<uint8_t *>(pvPortMalloc(_sectorSize));
+            configASSERT(_stage);
+        }
+
+        bool found = false;
+        uint32_t oldestSector = 0;
+        uint32_t oldestSeq = 0;
+        uint32_t newestSector = 0;
+        uint32_t newestSeq = 0;
+        bool readError = false;
+        for(uint32_t sector = 0; sector < _numSectors; sector++) {
+            NvmRingLogSectorHeader_t header;
+            if(!readSectorHeader(sector, header, timeoutMs)) {
+                readError = true;
+                break;
+            }
+            if(header.magic != MAGIC) {
+                continue;
+            }
+            if(!found) {
+                found = true;
+                oldestSector = newestSector = sector;
+                oldestSeq = newestSeq = header.seq;
+            } else {
+                // Signed difference so sequence number wrap-around is handled
+                if(static_cast<int32_t>(header.seq - oldestSeq) < 0) {
+                    oldestSector = sector;
+                    oldestSeq = header.seq;
+                }
+                if(static_cast<int32_t>(header.seq - newestSeq) > 0) {
+                    newestSector = sector;
+                    newestSeq = header.seq;
+                }
+            }
+        }
+        if(readError) {
+            break;
+        }
+
+        if(!found) {
+            // Fresh log. Open sector 0 as the first write sector and start
+            // reading from it (once it's open, so it isn't taken for a full log).
+            _seq = 0;
+            _writeSector = _numSectors - 1;
+            _readSector = _writeSector;
+            if(!openNextSector(timeoutMs)) {
+                break;
+            }
+            _readSector = _writeSector;
+            _readOffset = sizeof(NvmRingLogSectorHeader_t);
+            _initialized = true;
+            rval = true;
+            break;
+        }
+
+        _seq = newestSeq;
+        _writeSector = newestSector;
+        _readSector = oldestSector;
+        _readOffset = sizeof(NvmRingLogSectorHeader_t);
+
+        // Load the newest sector into the stage buffer and find the end of its data
+        if(!_partition.read(_writeSector * _sectorSize, _stage, _sectorSize, timeoutMs)) {
+            break;
+        }
+        uint32_t offset = sizeof(NvmRingLogSectorHeader_t);
+        while((offset + sizeof(NvmRingLogRecordHeader_t)) <= _sectorSize) {
+            NvmRingLogRecordHeader_t record;
+            memcpy(&record, &_stage[offset], sizeof(record));
+            if((record.len == END_OF_SECTOR) ||
+               (record.len > (_sectorSize - offset - sizeof(record))) ||
+               (crc16_ccitt(0, &_stage[offset + sizeof(record)], record.len) != record.crc16)) {
+                break;
+            }
+            offset += sizeof(record) + record.len;
+        }
+        _writeOffset = offset;
+        _flushedOffset = offset;
+
+        // Anything past the last valid record must still be erased, otherwise
+        // we can't program new records on top of it.
+        bool tailErased = true;
+        for(uint32_t idx = offset; idx < _sectorSize; idx++) {
+            if(_stage[idx] != 0xFF) {
+                tailErased = false;
+                break;
+            }
+        }
+        if(!tailErased) {
+            printf("Ring log sector %" PRIu32 " has a corrupt tail\n", _writeSector);
+            _stats.corrupt++;
+            if(!openNextSector(timeoutMs)) {
+                break;
+            }
+        }
+
+        _initialized = true;
+        rval = true;
+    } while(0);
+
+    return rval;
+}
+
+/*!
+  Append a record to the log. Data is staged in RAM until flush() is called
+  or the current sector fills up.
+
+  \param[in] *data - record data
+  \param[in] len - record length (must be <= maxRecordLen())
+  \param[in] timeoutMs - flash operation timeout
+  \return true if the record was added, false otherwise
+*/
+bool NvmRingLog::append(const uint8_t *data, uint16_t len, uint32_t timeoutMs) {
+    bool rval = false;
+    do {
+        if(!_initialized || !data || !len || (len > maxRecordLen())) {
+            break;
+        }
+
+        uint32_t recordLen = sizeof(NvmRingLogRecordHeader_t) + len;
+        if((_writeOffset + recordLen) > _sectorSize) {
+            if(!flush(timeoutMs)) {
+                break;
+            }
+            if(!openNextSector(timeoutMs)) {
+                break;
+            }
+        }
+
+        NvmRingLogRecordHeader_t record = {
+            .len = len,
+            .crc16 = crc16_ccitt(0, data, len),
+        };
+        memcpy(&_stage[_writeOffset], &record, sizeof(record));
+        memcpy(&_stage[_writeOffset + sizeof(record)], data, len);
+        _writeOffset += recordLen;
+        _stats.appended++;
+        rval = true;
+    } while(0);
+
+    return rval;
+}
+
+/*!
+  Read the oldest record in the log without removing it.
+  Records that fail their CRC check are skipped.
+
+  \param[out] *buffer - buffer to read record into
+  \param[in] bufferLen - size of buffer (should be at least maxRecordLen())
+  \param[out] &len - length of record read
+  \param[in] timeoutMs - flash operation timeout
+  \return true if a record was read, false if the log is empty or on error
+*/
+bool NvmRingLog::peek(uint8_t *buffer, uint16_t bufferLen, uint16_t &len, uint32_t timeoutMs) {
+    bool rval = false;
+    NvmRingLogRecordHeader_t record;
+
+    while(_initialized && buffer && nextRecord(record, timeoutMs)) {
+        if(record.len > bufferLen) {
+            break;
+        }
+        if(!readData(_readOffset + sizeof(record), buffer, record.len, timeoutMs)) {
+            break;
+        }
+        if(crc16_ccitt(0, buffer, record.len) != record.crc16) {
+            _stats.corrupt++;
+            _readOffset += sizeof(record) + record.len;
+            continue;
+        }
+        len = record.len;
+        rval = true;
+        break;
+    }
+
+    return rval;
+}
+
+/*!
+  Remove the oldest record from the log
+
+  \param[in] timeoutMs - flash operation timeout
+  \return true if a record was removed, false if the log is empty or on error
+*/
+bool NvmRingLog::pop(uint32_t timeoutMs) {
+    bool rval = false;
+    NvmRingLogRecordHeader_t record;
+    if(_initialized && nextRecord(record, timeoutMs)) {
+        _readOffset += sizeof(record) + record.len;
+        _stats.popped++;
+        rval = true;
+    }
+    return rval;
+}
+
+/*!
+  Write any staged records to flash
+
+  \param[in] timeoutMs - flash operation timeout
+  \return true if successful (or nothing to flush), false otherwise
+*/
+bool NvmRingLog::flush(uint32_t timeoutMs) {
+    bool rval = true;
+    if(_initialized && needsFlush()) {
+        rval = _partition.write(_writeSector * _sectorSize + _flushedOffset,
+                                &_stage[_flushedOffset],
+                                _writeOffset - _flushedOffset, timeoutMs);
+        if(rval) {
+            _flushedOffset = _writeOffset;
+            _stats.flashWrites++;
+        }
+    }
+    return rval;
+}
+
+/*!
+  Erase the whole log
+
+  \param[in] timeoutMs - flash operation timeout
+  \return true if successful, false otherwise
+*/
+bool NvmRingLog::clear(uint32_t timeoutMs) {
+    bool rval = false;
+    do {
+        if(!_initialized) {
+            break;
+        }
+        uint32_t sector;
+        for(sector = 0; sector < _numSectors; sector++) {
+            if(!_partition.erase(sector * _sectorSize, _sectorSize, timeoutMs)) {
+                break;
+            }
+            _stats.flashErases++;
+        }
+        if(sector != _numSectors) {
+            break;
+        }
+        _initialized = false;
+        rval = init(timeoutMs);
+    } while(0);
+    return rval;
+}
+
+/*!
+  \return true if there are no more records to read
+*/
+bool NvmRingLog::isEmpty(void) {
+    NvmRingLogRecordHeader_t record;
+    return !_initialized || !nextRecord(record, DEFAULT_TIMEOUT_MS);
+}
+
+/*!
+  \return true if there are staged records that have not been written to flash yet
+*/
+bool NvmRingLog::needsFlush(void) {
+    // A new sector with only a header doesn't need to be written yet
+    return (_flushedOffset < _writeOffset) && (_writeOffset > sizeof(NvmRingLogSectorHeader_t));
+}
+
+/*!
+  \return largest record that fits in a single sector
+*/
+uint16_t NvmRingLog::maxRecordLen(void) {
+    uint32_t maxLen = _sectorSize - sizeof(NvmRingLogSectorHeader_t) - sizeof(NvmRingLogRecordHeader_t);
+    return (maxLen < END_OF_SECTOR) ? maxLen : (END_OF_SECTOR - 1);
+}
+
+uint32_t NvmRingLog::numSectors(void) {
+    return _numSectors;
+}
+
+const NvmRingLogStats_t& NvmRingLog::getStats(void) {
+    return _stats;
+}
+
+uint32_t NvmRingLog::nextSector(uint32_t sector) {
+    return (sector + 1) % _numSectors;
+}
+
+bool NvmRingLog::readSectorHeader(uint32_t sector, NvmRingLogSectorHeader_t &header, uint32_t timeoutMs) {
+    return _partition.read(sector * _sectorSize, reinterpret_cast<uint8_t *>(&header), sizeof(header), timeoutMs);
+}
+
+/*!
+  Erase the current write sector and start a new one. Drops the oldest sector
+  if the log is full.
+
+  \param[in] timeoutMs - flash operation timeout
+  \return true if successful, false otherwise
+*/
+bool NvmRingLog::openNextSector(uint32_t timeoutMs) {
+    bool rval = false;
+    do {
+        uint32_t sector = nextSector(_writeSector);
+        if(!_partition.erase(sector * _sectorSize, _sectorSize, timeoutMs)) {
+            break;
+        }
+        _stats.flashErases++;
+
+        if(sector == _readSector) {
+            // Log is full, drop the oldest sector
+            _stats.droppedSectors++;
+            _readSector = nextSector(sector);
+            _readOffset = sizeof(NvmRingLogSectorHeader_t);
+        }
+
+        _seq++;
+        NvmRingLogSectorHeader_t header = {
+            .magic = MAGIC,
+            .seq = _seq,
+        };
+        memset(_stage, 0xFF, _sectorSize);
+        memcpy(_stage, &header, sizeof(header));
+        _writeSector = sector;
+        _writeOffset = sizeof(header);
+        _flushedOffset = 0;
+        rval = true;
+    } while(0);
+    return rval;
+}
+
+/*!
+  Done with the current read sector. Erase it so it isn't replayed after a reset
+  and move on to the next sector with valid data.
+
+  \param[in] timeoutMs - flash operation timeout
+  \return true if successful, false otherwise
+*/
+bool NvmRingLog::advanceReadSector(uint32_t timeoutMs) {
+    bool rval = false;
+    do {
+        if(!_partition.erase(_readSector * _sectorSize, _sectorSize, timeoutMs)) {
+            break;
+        }
+        _stats.flashErases++;
+
+        rval = true;
+        do {
+            _readSector = nextSector(_readSector);
+            _readOffset = sizeof(NvmRingLogSectorHeader_t);
+            if(_readSector == _writeSector) {
+                break;
+            }
+            NvmRingLogSectorHeader_t header;
+            if(!readSectorHeader(_readSector, header, timeoutMs)) {
+                rval = false;
+                break;
+            }
+            if(header.magic == MAGIC) {
+                break;
+            }
+        } while(1);
+    } while(0);
+    return rval;
+}
+
+/*!
+  Move the read position to the next record header, skipping over finished or
+  corrupt sectors.
+
+  \param[out] &record - record header at the current read position
+  \param[in] timeoutMs - flash operation timeout
+  \return true if there is a record available, false otherwise
+*/
+bool NvmRingLog::nextRecord(NvmRingLogRecordHeader_t &record, uint32_t timeoutMs) {
+    bool rval = false;
+    while(1) {
+        if(_readSector == _writeSector) {
+            if((_readOffset + sizeof(record)) <= _writeOffset) {
+                memcpy(&record, &_stage[_readOffset], sizeof(record));
+                rval = true;
+            }
+            break;
+        }
+
+        bool endOfSector = true;
+        if((_readOffset + sizeof(record)) <= _sectorSize) {
+            if(!_partition.read(_readSector * _sectorSize + _readOffset,
+                                reinterpret_cast<uint8_t *>(&record), sizeof(record), timeoutMs)) {
+                break;
+            }
+            if(record.len == END_OF_SECTOR) {
+                // Normal end of sector
+            } else if(record.len > (_sectorSize - _readOffset - sizeof(record))) {
+                _stats.corrupt++;
+            } else {
+                endOfSector = false;
+            }
+        }
+
+        if(!endOfSector) {
+            rval = true;
+            break;
+        }
+
+        if(!advanceReadSector(timeoutMs)) {
+            break;
+        }
+    }
+    return rval;
+}
+
+bool NvmRingLog::readData(uint32_t offset, uint8_t *buffer, uint16_t len, uint32_t timeoutMs) {
+    bool rval = true;
+    if(_readSector == _writeSector) {
+        memcpy(buffer, &_stage[offset], len);
+    } else {
+        rval = _partition.read(_readSector * _sectorSize + offset, buffer, len, timeoutMs);
+    }
+    return rval;
+}
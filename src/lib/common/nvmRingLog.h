@@ -0,0 +1,78 @@
+#pragma once
+#include "nvmPartition.h"
+
+//
+// Sector based ring log on top of an NvmPartition.
+//
+// Each erase sector starts with a NvmRingLogSectorHeader_t, followed by
+// back-to-back records (NvmRingLogRecordHeader_t + data). Unwritten flash reads
+// back as 0xFF, so a record length of 0xFFFF marks the end of a sector.
+//
+// Appends are staged in a sector sized RAM buffer and only written to flash
+// on flush() or when the sector fills up. This keeps the number of erase/program
+// cycles down, since some drivers (W25) rewrite the whole sector on every write.
+//
+// When the log is full, the oldest sector is dropped to make room for new data.
+// Read position is not persisted until a sector is fully drained, so records
+// can be delivered more than once across a reset (at-least-once).
+//
+
+typedef struct NvmRingLogSectorHeader {
+    uint32_t magic;
+    uint32_t seq;
+} __attribute__((packed, aligned(1))) NvmRingLogSectorHeader_t;
+
+typedef struct NvmRingLogRecordHeader {
+    uint16_t len;
+    uint16_t crc16;
+} __attribute__((packed, aligned(1))) NvmRingLogRecordHeader_t;
+
+typedef struct NvmRingLogStats {
+    uint32_t appended;
+    uint32_t popped;
+    uint32_t droppedSectors;
+    uint32_t corrupt;
+    uint32_t flashWrites;
+    uint32_t flashErases;
+} NvmRingLogStats_t;
+
+class NvmRingLog {
+public:
+    NvmRingLog(NvmPartition &partition);
+    ~NvmRingLog();
+    bool init(uint32_t timeoutMs=DEFAULT_TIMEOUT_MS);
+    bool append(const uint8_t *data, uint16_t len, uint32_t timeoutMs=DEFAULT_TIMEOUT_MS);
+    bool peek(uint8_t *buffer, uint16_t bufferLen, uint16_t &len, uint32_t timeoutMs=DEFAULT_TIMEOUT_MS);
+    bool pop(uint32_t timeoutMs=DEFAULT_TIMEOUT_MS);
+    bool flush(uint32_t timeoutMs=DEFAULT_TIMEOUT_MS);
+    bool clear(uint32_t timeoutMs=DEFAULT_TIMEOUT_MS);
+    bool isEmpty(void);
+    bool needsFlush(void);
+    uint16_t maxRecordLen(void);
+    uint32_t numSectors(void);
+    const NvmRingLogStats_t& getStats(void);
+public:
+    static constexpr uint32_t MAGIC = 0x474c5253; // "SRLG"
+    static constexpr uint32_t DEFAULT_TIMEOUT_MS = 5000;
+    static constexpr uint16_t END_OF_SECTOR = 0xFFFF;
+private:
+    bool openNextSector(uint32_t timeoutMs);
+    bool readSectorHeader(uint32_t sector, NvmRingLogSectorHeader_t &header, uint32_t timeoutMs);
+    bool advanceReadSector(uint32_t timeoutMs);
+    bool nextRecord(NvmRingLogRecordHeader_t &record, uint32_t timeoutMs);
+    bool readData(uint32_t offset, uint8_t *buffer, uint16_t len, uint32_t timeoutMs);
+    uint32_t nextSector(uint32_t sector);
+private:
+    NvmPartition &_partition;
+    uint32_t _sectorSize;
+    uint32_t _numSectors;
+    uint8_t *_stage;
+    uint32_t _seq;
+    uint32_t _writeSector;
+    uint32_t _writeOffset;
+    uint32_t _flushedOffset;
+    uint32_t _readSector;
+    uint32_t _readOffset;
+    bool _initialized;
+    NvmRingLogStats_t _stats;
+};
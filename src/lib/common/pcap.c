@@ -1,4 +1,7 @@
+#include <inttypes.h>
 #include <stdbool.h>
+#include <stdlib.h>
+#include <string.h>
 #include "FreeRTOS.h"
 #include "queue.h"
 #include "serial.h"
@@ -6,37 +9,489 @@
 #include "task.h"
 #include <stdio.h>
 
-static SerialHandle_t *pcapSerialHandle;
-static volatile bool firstMessage = false;
+// FreeRTOS+CLI includes.
+#include "FreeRTOS_CLI.h"
+
+#include "bm_ports.h"
+#include "pcap.h"
+#include "perf_counters.h"
+#include "task_priorities.h"
+#include "util.h"
+
+//
+// Packet capture. Packets are buffered and sent to USB by the pcap task.
+//
+// See https://www.ietf.org/archive/id/draft-tuexen-opsawg-pcapng-05.html
+//
+
+// NOTE: MUST be a power of 2
+#define PCAP_RING_SIZE (16 * 1024)
+#define PCAP_RING_MASK (PCAP_RING_SIZE - 1)
+
+// Largest single USB write
+#define PCAP_WRITE_MAX_LEN (4096)
+
+// Drain the ring at least this often
+#define PCAP_FLUSH_MS (20)
+
+// Wake the pcap task early once the ring is this full
+#define PCAP_FLUSH_THRESHOLD (PCAP_RING_SIZE / 4)
+
+// Send interface statistics this often
+#define PCAP_STATS_INTERVAL_MS (1000)
+
+// Each ring record starts with a word containing the record length (including
+// the word). Zero means the record hasn't been committed yet.
+#define PCAP_REC_PAD_FLAG (1UL << 31)
+#define PCAP_REC_LEN_MASK (~PCAP_REC_PAD_FLAG)
+
+#if PCAP_RING_SIZE & (PCAP_RING_SIZE - 1)
+#error PCAP_RING_SIZE MUST be a power of 2!!!
+#endif
+
+// pcapng block types
+#define PCAPNG_SHB_TYPE (0x0A0D0D0A)
+#define PCAPNG_IDB_TYPE (0x00000001)
+#define PCAPNG_ISB_TYPE (0x00000005)
+#define PCAPNG_EPB_TYPE (0x00000006)
+#define PCAPNG_BYTE_ORDER_MAGIC (0x1A2B3C4D)
+#define PCAPNG_LINKTYPE_ETHERNET (1)
+
+// pcapng option codes
+#define PCAPNG_OPT_ENDOFOPT (0)
+#define PCAPNG_OPT_IF_TSRESOL (9)
+#define PCAPNG_OPT_EPB_FLAGS (2)
+#define PCAPNG_OPT_ISB_IFRECV (4)
+#define PCAPNG_OPT_ISB_IFDROP (5)
+#define PCAPNG_OPT_ISB_FILTERACCEPT (6)
+#define PCAPNG_OPT_ISB_OSDROP (7)
+
+#define PCAPNG_EPB_FLAGS_INBOUND (1)
+#define PCAPNG_EPB_FLAGS_OUTBOUND (2)
+
+// Frame offsets used by filters (ethernet + ipv6 only)
+#define ETH_TYPE_OFFSET (12)
+#define ETH_TYPE_IPV6 (0x86DD)
+#define IP6_NEXTH_OFFSET (14 + 6)
+#define IP6_PAYLOAD_OFFSET (14 + 40)
+#define IP_PROTO_UDP (17)
+#define IP_PROTO_BCMP (0xBC)
+#define UDP_PAYLOAD_OFFSET (IP6_PAYLOAD_OFFSET + 8)
+// See bm_pubsub_header_t (type, flags, topic_len, topic)
+#define PUBSUB_TOPIC_LEN_OFFSET (UDP_PAYLOAD_OFFSET + 2)
+#define PUBSUB_TOPIC_OFFSET (UDP_PAYLOAD_OFFSET + 3)
+
+#define PCAPNG_PAD4(x) (((x) + 3) & ~3UL)
 
-// See link for header/struct definitions: https://wiki.wireshark.org/Development/LibpcapFileFormat
 typedef struct {
-  uint32_t magic_number;
-  uint16_t version_major;
-  uint16_t version_minor;
-  int32_t thiszone;
-  uint32_t sigfigs;
+  uint32_t type;
+  uint32_t len;
+} __attribute__((packed)) PcapngBlockHeader_t;
+
+typedef struct {
+  PcapngBlockHeader_t header;
+  uint32_t byteOrderMagic;
+  uint16_t versionMajor;
+  uint16_t versionMinor;
+  int64_t sectionLen;
+  uint32_t trailerLen;
+} __attribute__((packed)) PcapngSHB_t;
+
+typedef struct {
+  PcapngBlockHeader_t header;
+  uint16_t linkType;
+  uint16_t reserved;
   uint32_t snaplen;
-  uint32_t network;
-} PcapHeader_t;
+  // if_tsresol option (microseconds)
+  uint16_t tsresolCode;
+  uint16_t tsresolLen;
+  uint8_t tsresol;
+  uint8_t tsresolPad[3];
+  uint32_t endOfOpt;
+  uint32_t trailerLen;
+} __attribute__((packed)) PcapngIDB_t;
+
+typedef struct {
+  PcapngBlockHeader_t header;
+  uint32_t interfaceId;
+  uint32_t tsHigh;
+  uint32_t tsLow;
+  uint32_t capturedLen;
+  uint32_t originalLen;
+  uint8_t data[0];
+} __attribute__((packed)) PcapngEPB_t;
+
+// Options + trailer that follow the (padded) packet data in an EPB
+typedef struct {
+  uint16_t flagsCode;
+  uint16_t flagsLen;
+  uint32_t flags;
+  uint32_t endOfOpt;
+  uint32_t trailerLen;
+} __attribute__((packed)) PcapngEPBTrailer_t;
 
 typedef struct {
-  uint32_t ts_sec;
-  uint32_t ts_usec;
-  uint32_t incl_len;
-  uint32_t orig_len;
-} PcapRecordHeader_t;
-
-static const PcapHeader_t pcapHeader = {
-    .magic_number=0xA1B2C3D4,
-    .version_major=2,
-    .version_minor=4,
-    .thiszone=0,
-    .sigfigs=0,
-    .snaplen=65535,
-    .network=1,
+  uint16_t code;
+  uint16_t len;
+  uint64_t value;
+} __attribute__((packed)) PcapngOptU64_t;
+
+typedef struct {
+  PcapngBlockHeader_t header;
+  uint32_t interfaceId;
+  uint32_t tsHigh;
+  uint32_t tsLow;
+  PcapngOptU64_t ifRecv;
+  PcapngOptU64_t ifDrop;
+  PcapngOptU64_t filterAccept;
+  PcapngOptU64_t osDrop;
+  uint32_t endOfOpt;
+  uint32_t trailerLen;
+} __attribute__((packed)) PcapngISB_t;
+
+typedef struct {
+  uint8_t buff[PCAP_RING_SIZE] __attribute__((aligned(4)));
+  // Producers reserve space by advancing head
+  volatile uint32_t head;
+  // Only the pcap task advances tail
+  volatile uint32_t tail;
+} PcapRing_t;
+
+static SerialHandle_t *pcapSerialHandle;
+static TaskHandle_t pcapTask;
+static PcapRing_t pcapRing;
+static volatile bool resetPending;
+
+// Filters/snaplen are read without locking. A capture racing a CLI change
+// may use a mix of old and new settings, which is fine.
+static pcapFilter_t pcapFilter = {
+  .directions = PCAP_DIR_ANY,
+  .bcmpType = -1,
+  .udpPort = 0,
+  .topicPrefix = "",
+};
+static volatile uint16_t pcapSnaplen = PCAP_SNAPLEN_MAX;
+// Snaplen of the current session (the one in its interface description
+// block). Latched by the pcap task when a session starts, so packets never
+// exceed what the header promised.
+static volatile uint16_t pcapSessionSnaplen = PCAP_SNAPLEN_MAX;
+
+static perfCounter_t pcapReceived;
+static perfCounter_t pcapFiltered;
+static perfCounter_t pcapDropped;
+static perfCounter_t pcapUsbDropped;
+
+static BaseType_t cmd_pcap_fn(char *writeBuffer, size_t writeBufferLen, const char *commandString);
+
+static const CLI_Command_Definition_t cmd_pcap = {
+  // Command string
+  "pcap",
+  // Help string
+  "pcap status\n"
+  "pcap snaplen <bytes>\n"
+  "pcap filter dir <rx|tx|any>\n"
+  "pcap filter bcmp <type|any>\n"
+  "pcap filter port <udp port|any>\n"
+  "pcap filter topic <prefix|any>\n"
+  "pcap filter clear\n",
+  // Command function
+  cmd_pcap_fn,
+  // Number of parameters
+  -1
 };
 
+/*!
+  Get capture timestamp
+
+  \return microseconds since boot
+*/
+static uint64_t pcapTimestampUs(void) {
+#if configGENERATE_RUN_TIME_STATS == 1
+  // The run time (cycle) counter keeps running while USB is connected
+  // since USB keeps us out of STOP mode
+  return portGET_RUN_TIME_COUNTER_VALUE() / (configCPU_CLOCK_HZ / 1000000);
+#else
+  return ((uint64_t)xTaskGetTickCount() * 1000000) / configTICK_RATE_HZ;
+#endif
+}
+
+/*!
+  Check if a frame matches the current filter
+
+  \param[in] *buff - ethernet frame
+  \param[in] len - frame length
+  \param[in] direction - capture direction
+  \return true if the frame should be captured
+*/
+static bool pcapFilterMatch(const uint8_t *buff, size_t len, pcapDirection_e direction) {
+  if(!(pcapFilter.directions & direction)) {
+    return false;
+  }
+
+  bool needsBcmp = (pcapFilter.bcmpType >= 0);
+  bool needsUdp = (pcapFilter.udpPort != 0) || (pcapFilter.topicPrefix[0] != 0);
+  if(!needsBcmp && !needsUdp) {
+    return true;
+  }
+
+  if((len < IP6_PAYLOAD_OFFSET) ||
+     ((((uint16_t)buff[ETH_TYPE_OFFSET] << 8) | buff[ETH_TYPE_OFFSET + 1]) != ETH_TYPE_IPV6)) {
+    return false;
+  }
+
+  uint8_t nextHeader = buff[IP6_NEXTH_OFFSET];
+  if(needsBcmp) {
+    // BCMP type is a little endian uint16_t at the start of the bcmp header
+    if((nextHeader != IP_PROTO_BCMP) || (len < (IP6_PAYLOAD_OFFSET + 2))) {
+      return false;
+    }
+    uint16_t bcmpType = buff[IP6_PAYLOAD_OFFSET] | ((uint16_t)buff[IP6_PAYLOAD_OFFSET + 1] << 8);
+    if(bcmpType != (uint16_t)pcapFilter.bcmpType) {
+      return false;
+    }
+  }
+
+  if(needsUdp) {
+    if((nextHeader != IP_PROTO_UDP) || (len < UDP_PAYLOAD_OFFSET)) {
+      return false;
+    }
+    uint16_t srcPort = ((uint16_t)buff[IP6_PAYLOAD_OFFSET] << 8) | buff[IP6_PAYLOAD_OFFSET + 1];
+    uint16_t dstPort = ((uint16_t)buff[IP6_PAYLOAD_OFFSET + 2] << 8) | buff[IP6_PAYLOAD_OFFSET + 3];
+    if(pcapFilter.udpPort && (srcPort != pcapFilter.udpPort) && (dstPort != pcapFilter.udpPort)) {
+      return false;
+    }
+
+    if(pcapFilter.topicPrefix[0]) {
+      size_t prefixLen = strnlen(pcapFilter.topicPrefix, PCAP_TOPIC_PREFIX_MAX_LEN);
+      if((dstPort != BM_MIDDLEWARE_PORT) || (len < PUBSUB_TOPIC_OFFSET) ||
+         (buff[PUBSUB_TOPIC_LEN_OFFSET] < prefixLen) ||
+         (len < (PUBSUB_TOPIC_OFFSET + prefixLen)) ||
+         (memcmp(&buff[PUBSUB_TOPIC_OFFSET], pcapFilter.topicPrefix, prefixLen) != 0)) {
+        return false;
+      }
+    }
+  }
+
+  return true;
+}
+
+/*!
+  Reserve space in the capture ring. Lock-free, so it is safe to call from
+  any task (or ISR) at the same time.
+
+  \param[in] len - number of bytes to reserve (multiple of 4)
+  \return pointer to the record word (data follows it), NULL if the ring is full
+*/
+static uint32_t *pcapRingReserve(uint32_t len) {
+  uint32_t total = len + sizeof(uint32_t);
+  uint32_t head;
+  uint32_t pad;
+
+  do {
+    head = __atomic_load_n(&pcapRing.head, __ATOMIC_RELAXED);
+    uint32_t tail = __atomic_load_n(&pcapRing.tail, __ATOMIC_ACQUIRE);
+    uint32_t offset = head & PCAP_RING_MASK;
+
+    // Records don't wrap around the end of the ring
+    pad = ((offset + total) > PCAP_RING_SIZE) ? (PCAP_RING_SIZE - offset) : 0;
+    if(((head - tail) + pad + total) > PCAP_RING_SIZE) {
+      return NULL;
+    }
+  } while(!__atomic_compare_exchange_n(&pcapRing.head, &head, head + pad + total, true,
+                                       __ATOMIC_ACQUIRE, __ATOMIC_RELAXED));
+
+  if(pad) {
+    uint32_t *padWord = (uint32_t *)&pcapRing.buff[head & PCAP_RING_MASK];
+    __atomic_store_n(padWord, pad | PCAP_REC_PAD_FLAG, __ATOMIC_RELEASE);
+    head += pad;
+  }
+
+  return (uint32_t *)&pcapRing.buff[head & PCAP_RING_MASK];
+}
+
+/*!
+  Make a reserved record visible to the pcap task
+
+  \param[in] *record - record word returned by pcapRingReserve
+  \param[in] len - length passed to pcapRingReserve
+  \return none
+*/
+static void pcapRingCommit(uint32_t *record, uint32_t len) {
+  __atomic_store_n(record, len + sizeof(uint32_t), __ATOMIC_RELEASE);
+}
+
+/*!
+  Copy committed records out of the capture ring (pcap task only)
+
+  \param[out] *buff - destination buffer
+  \param[in] maxLen - buffer size
+  \param[out] *numPackets - number of records copied
+  \return number of bytes copied
+*/
+static size_t pcapRingRead(uint8_t *buff, size_t maxLen, uint32_t *numPackets) {
+  size_t bytesRead = 0;
+  uint32_t tail = pcapRing.tail;
+  uint32_t head = __atomic_load_n(&pcapRing.head, __ATOMIC_ACQUIRE);
+
+  while(tail != head) {
+    uint32_t *record = (uint32_t *)&pcapRing.buff[tail & PCAP_RING_MASK];
+    uint32_t word = __atomic_load_n(record, __ATOMIC_ACQUIRE);
+    if(word == 0) {
+      // Producer is still writing this one
+      break;
+    }
+
+    uint32_t recordLen = word & PCAP_REC_LEN_MASK;
+    if(!(word & PCAP_REC_PAD_FLAG)) {
+      uint32_t dataLen = recordLen - sizeof(uint32_t);
+      if(buff) {
+        if((bytesRead + dataLen) > maxLen) {
+          break;
+        }
+        memcpy(&buff[bytesRead], &record[1], dataLen);
+        bytesRead += dataLen;
+      }
+      (*numPackets)++;
+    }
+
+    // Producers rely on unused space being zero (a zero record word means
+    // the record hasn't been committed yet)
+    memset(record, 0, recordLen);
+    tail += recordLen;
+    __atomic_store_n(&pcapRing.tail, tail, __ATOMIC_RELEASE);
+  }
+
+  return bytesRead;
+}
+
+/*!
+  Send buffer over pcap usb port. Buffer is freed once sent.
+
+  \param[in] *buff - malloc'd buffer
+  \param[in] len - number of bytes to send
+  \param[in] numPackets - number of packets in buffer (for drop counts)
+  \return none
+*/
+static void pcapWrite(uint8_t *buff, size_t len, uint32_t numPackets) {
+  SerialMessage_t message = {
+    .buff = buff,
+    .len = len,
+    .destination = pcapSerialHandle
+  };
+
+  if(serialTxQueueSend(&message, pdMS_TO_TICKS(PCAP_FLUSH_MS)) != pdTRUE) {
+    perfCounterAdd(&pcapUsbDropped, numPackets);
+    vPortFree(buff);
+  }
+}
+
+static size_t pcapAddSectionHeader(uint8_t *buff) {
+  PcapngSHB_t *shb = (PcapngSHB_t *)buff;
+  shb->header.type = PCAPNG_SHB_TYPE;
+  shb->header.len = sizeof(PcapngSHB_t);
+  shb->byteOrderMagic = PCAPNG_BYTE_ORDER_MAGIC;
+  shb->versionMajor = 1;
+  shb->versionMinor = 0;
+  shb->sectionLen = -1;
+  shb->trailerLen = sizeof(PcapngSHB_t);
+
+  PcapngIDB_t *idb = (PcapngIDB_t *)&buff[sizeof(PcapngSHB_t)];
+  memset(idb, 0, sizeof(PcapngIDB_t));
+  idb->header.type = PCAPNG_IDB_TYPE;
+  idb->header.len = sizeof(PcapngIDB_t);
+  idb->linkType = PCAPNG_LINKTYPE_ETHERNET;
+  idb->snaplen = pcapSessionSnaplen;
+  idb->tsresolCode = PCAPNG_OPT_IF_TSRESOL;
+  idb->tsresolLen = 1;
+  idb->tsresol = 6; // 10^-6 s
+  idb->endOfOpt = PCAPNG_OPT_ENDOFOPT;
+  idb->trailerLen = sizeof(PcapngIDB_t);
+
+  return sizeof(PcapngSHB_t) + sizeof(PcapngIDB_t);
+}
+
+static size_t pcapAddStats(uint8_t *buff) {
+  PcapngISB_t *isb = (PcapngISB_t *)buff;
+  uint64_t timestamp = pcapTimestampUs();
+
+  isb->header.type = PCAPNG_ISB_TYPE;
+  isb->header.len = sizeof(PcapngISB_t);
+  isb->interfaceId = 0;
+  isb->tsHigh = (uint32_t)(timestamp >> 32);
+  isb->tsLow = (uint32_t)timestamp;
+  isb->ifRecv = (PcapngOptU64_t){PCAPNG_OPT_ISB_IFRECV, sizeof(uint64_t), pcapReceived.value};
+  // Packets that matched the filter but never made it to the host
+  isb->ifDrop = (PcapngOptU64_t){PCAPNG_OPT_ISB_IFDROP, sizeof(uint64_t), pcapUsbDropped.value};
+  isb->filterAccept = (PcapngOptU64_t){PCAPNG_OPT_ISB_FILTERACCEPT, sizeof(uint64_t),
+                                       pcapReceived.value - pcapFiltered.value};
+  isb->osDrop = (PcapngOptU64_t){PCAPNG_OPT_ISB_OSDROP, sizeof(uint64_t), pcapDropped.value};
+  isb->endOfOpt = PCAPNG_OPT_ENDOFOPT;
+  isb->trailerLen = sizeof(PcapngISB_t);
+
+  return sizeof(PcapngISB_t);
+}
+
+static void pcapThread(void *parameters) {
+  (void)parameters;
+
+  bool headerSent = false;
+  TickType_t lastStatsTicks = 0;
+
+  for(;;) {
+    ulTaskNotifyTake(pdTRUE, pdMS_TO_TICKS(PCAP_FLUSH_MS));
+
+    if(resetPending) {
+      // Discard anything captured during the previous session
+      uint32_t numPackets = 0;
+      pcapRingRead(NULL, 0, &numPackets);
+      // Captures are off until resetPending is cleared, so they all see this
+      pcapSessionSnaplen = pcapSnaplen;
+      resetPending = false;
+      headerSent = false;
+    }
+
+    if(!pcapSerialHandle->enabled) {
+      continue;
+    }
+
+    bool sendStats = (xTaskGetTickCount() - lastStatsTicks) >= pdMS_TO_TICKS(PCAP_STATS_INTERVAL_MS);
+    bool ringEmpty = (pcapRing.head == pcapRing.tail);
+    if(headerSent && ringEmpty && !sendStats) {
+      continue;
+    }
+
+    do {
+      uint8_t *buff = (uint8_t *)pvPortMalloc(PCAP_WRITE_MAX_LEN);
+      if(!buff) {
+        break;
+      }
+
+      size_t len = 0;
+      if(!headerSent) {
+        len += pcapAddSectionHeader(&buff[len]);
+        headerSent = true;
+      }
+
+      uint32_t numPackets = 0;
+      len += pcapRingRead(&buff[len], PCAP_WRITE_MAX_LEN - len - sizeof(PcapngISB_t), &numPackets);
+      ringEmpty = (pcapRing.head == pcapRing.tail);
+
+      // Stats go at the end of the last write
+      if(ringEmpty && sendStats) {
+        len += pcapAddStats(&buff[len]);
+        lastStatsTicks = xTaskGetTickCount();
+        sendStats = false;
+      }
+
+      if(len) {
+        pcapWrite(buff, len, numPackets);
+      } else {
+        vPortFree(buff);
+      }
+    } while(!ringEmpty);
+  }
+}
+
 /*!
   Initialize pcap stream variables
 
@@ -56,33 +511,75 @@ void pcapInit(SerialHandle_t *handle) {
   pcapSerialHandle->rxStreamBuffer = xStreamBufferCreate(pcapSerialHandle->rxBufferSize, 1);
   configASSERT(pcapSerialHandle->rxStreamBuffer != NULL);
 
+  perfCounterRegister(&pcapReceived, "pcap", "received", PERF_COUNTER_TYPE_COUNT);
+  perfCounterRegister(&pcapFiltered, "pcap", "filtered", PERF_COUNTER_TYPE_COUNT);
+  perfCounterRegister(&pcapDropped, "pcap", "dropped", PERF_COUNTER_TYPE_COUNT);
+  perfCounterRegister(&pcapUsbDropped, "pcap", "usb_dropped", PERF_COUNTER_TYPE_COUNT);
+
+  FreeRTOS_CLIRegisterCommand(&cmd_pcap);
+
+  BaseType_t rval = xTaskCreate(pcapThread,
+                                "pcap",
+                                configMINIMAL_STACK_SIZE * 2,
+                                NULL,
+                                PCAP_TASK_PRIORITY,
+                                &pcapTask);
+  configASSERT(rval == pdTRUE);
 }
 
 /*!
-  Send packet over pcap usb port
+  Capture packet (if pcap stream is enabled and the packet matches the filter)
 
   \param[in] buff pointer to packet
-  \param[in] len Number of bytes to transmit
+  \param[in] len packet length
+  \param[in] direction whether the packet was received or transmitted
   \return none
 */
-void pcapTxPacket(const uint8_t *buff, size_t len) {
-  if(pcapSerialHandle && pcapSerialHandle->enabled) {
-    PcapRecordHeader_t header;
-
-    header.ts_sec = xTaskGetTickCount()/1000;
-    header.ts_usec = (xTaskGetTickCount() - (header.ts_sec * 1000)) * 1000;
-    header.incl_len = len;
-    header.orig_len = len;
-
-    if(!firstMessage) {
-      // Tx pcap header
-      firstMessage = true;
-      serialWrite(pcapSerialHandle, (uint8_t *)&pcapHeader, sizeof(pcapHeader));
-    }
+void pcapCapture(const uint8_t *buff, size_t len, pcapDirection_e direction) {
+  if(!pcapSerialHandle || !pcapSerialHandle->enabled || resetPending) {
+    return;
+  }
 
-    serialWrite(pcapSerialHandle, (uint8_t *)&header, sizeof(header));
+  perfCounterInc(&pcapReceived);
 
-    serialWrite(pcapSerialHandle, (uint8_t *)buff, len);
+  if(!pcapFilterMatch(buff, len, direction)) {
+    perfCounterInc(&pcapFiltered);
+    return;
+  }
+
+  uint64_t timestamp = pcapTimestampUs();
+  uint32_t capturedLen = MIN(len, pcapSessionSnaplen);
+  uint32_t blockLen = sizeof(PcapngEPB_t) + PCAPNG_PAD4(capturedLen) + sizeof(PcapngEPBTrailer_t);
+
+  uint32_t *record = pcapRingReserve(blockLen);
+  if(!record) {
+    perfCounterInc(&pcapDropped);
+    xTaskNotifyGive(pcapTask);
+    return;
+  }
+
+  PcapngEPB_t *epb = (PcapngEPB_t *)&record[1];
+  epb->header.type = PCAPNG_EPB_TYPE;
+  epb->header.len = blockLen;
+  epb->interfaceId = 0;
+  epb->tsHigh = (uint32_t)(timestamp >> 32);
+  epb->tsLow = (uint32_t)timestamp;
+  epb->capturedLen = capturedLen;
+  epb->originalLen = len;
+  memcpy(epb->data, buff, capturedLen);
+  memset(&epb->data[capturedLen], 0, PCAPNG_PAD4(capturedLen) - capturedLen);
+
+  PcapngEPBTrailer_t *trailer = (PcapngEPBTrailer_t *)&epb->data[PCAPNG_PAD4(capturedLen)];
+  trailer->flagsCode = PCAPNG_OPT_EPB_FLAGS;
+  trailer->flagsLen = sizeof(uint32_t);
+  trailer->flags = (direction == PCAP_DIR_RX) ? PCAPNG_EPB_FLAGS_INBOUND : PCAPNG_EPB_FLAGS_OUTBOUND;
+  trailer->endOfOpt = PCAPNG_OPT_ENDOFOPT;
+  trailer->trailerLen = blockLen;
+
+  pcapRingCommit(record, blockLen);
+
+  if((pcapRing.head - pcapRing.tail) > PCAP_FLUSH_THRESHOLD) {
+    xTaskNotifyGive(pcapTask);
   }
 }
 
@@ -91,11 +588,16 @@ void pcapTxPacket(const uint8_t *buff, size_t len) {
 */
 void pcapEnable() {
   if(pcapSerialHandle) {
+    resetPending = true;
+    perfCounterSet(&pcapReceived, 0);
+    perfCounterSet(&pcapFiltered, 0);
+    perfCounterSet(&pcapDropped, 0);
+    perfCounterSet(&pcapUsbDropped, 0);
     pcapSerialHandle->enabled = true;
     xStreamBufferReset(pcapSerialHandle->rxStreamBuffer);
     xStreamBufferReset(pcapSerialHandle->txStreamBuffer);
     printf("PCAP Stream enabled!\n");
-    firstMessage = false;
+    xTaskNotifyGive(pcapTask);
   }
 }
 
@@ -108,3 +610,169 @@ void pcapDisable() {
     printf("PCAP Stream disabled!\n");
   }
 }
+
+/*!
+  Set maximum number of bytes captured per packet. Takes effect on the next
+  capture session (the interface description block has the snaplen).
+
+  \param[in] snaplen - bytes per packet (clamped to PCAP_SNAPLEN_MIN-PCAP_SNAPLEN_MAX)
+  \return none
+*/
+void pcapSetSnaplen(uint16_t snaplen) {
+  pcapSnaplen = MAX(PCAP_SNAPLEN_MIN, MIN(snaplen, PCAP_SNAPLEN_MAX));
+}
+
+uint16_t pcapGetSnaplen(void) {
+  return pcapSnaplen;
+}
+
+/*!
+  Set capture filter
+
+  \param[in] *filter - new filter
+  \return none
+*/
+void pcapSetFilter(const pcapFilter_t *filter) {
+  configASSERT(filter);
+  taskENTER_CRITICAL();
+  memcpy(&pcapFilter, filter, sizeof(pcapFilter));
+  pcapFilter.topicPrefix[PCAP_TOPIC_PREFIX_MAX_LEN] = 0;
+  taskEXIT_CRITICAL();
+}
+
+void pcapGetFilter(pcapFilter_t *filter) {
+  configASSERT(filter);
+  taskENTER_CRITICAL();
+  memcpy(filter, &pcapFilter, sizeof(pcapFilter));
+  taskEXIT_CRITICAL();
+}
+
+/*!
+  Capture everything
+
+  \return none
+*/
+void pcapClearFilter(void) {
+  pcapFilter_t filter = {
+    .directions = PCAP_DIR_ANY,
+    .bcmpType = -1,
+    .udpPort = 0,
+    .topicPrefix = "",
+  };
+  pcapSetFilter(&filter);
+}
+
+void pcapGetStats(pcapStats_t *stats) {
+  configASSERT(stats);
+  stats->received = pcapReceived.value;
+  stats->filtered = pcapFiltered.value;
+  stats->dropped = pcapDropped.value;
+  stats->usbDropped = pcapUsbDropped.value;
+}
+
+static void pcapPrintStatus(void) {
+  pcapFilter_t filter;
+  pcapStats_t stats;
+  pcapGetFilter(&filter);
+  pcapGetStats(&stats);
+
+  printf("pcap: %s, snaplen %u\n", (pcapSerialHandle && pcapSerialHandle->enabled) ? "enabled" : "disabled",
+         pcapSnaplen);
+  printf("filter: dir %s%s", (filter.directions & PCAP_DIR_RX) ? "rx" : "",
+         (filter.directions & PCAP_DIR_TX) ? "tx" : "");
+  if(filter.bcmpType >= 0) {
+    printf(" bcmp 0x%02" PRIx32, filter.bcmpType);
+  }
+  if(filter.udpPort) {
+    printf(" port %u", filter.udpPort);
+  }
+  if(filter.topicPrefix[0]) {
+    printf(" topic %s*", filter.topicPrefix);
+  }
+  printf("\nreceived %" PRIu32 " filtered %" PRIu32 " dropped %" PRIu32 " usb_dropped %" PRIu32 "\n",
+         stats.received, stats.filtered, stats.dropped, stats.usbDropped);
+}
+
+static bool cmd_pcap_filter(const char *commandString) {
+  BaseType_t typeLen = 0;
+  BaseType_t valueLen = 0;
+  const char *type = FreeRTOS_CLIGetParameter(commandString, 2, &typeLen);
+  const char *value = FreeRTOS_CLIGetParameter(commandString, 3, &valueLen);
+
+  if(!type) {
+    return false;
+  }
+
+  pcapFilter_t filter;
+  pcapGetFilter(&filter);
+
+  bool any = value && (strncmp("any", value, valueLen) == 0);
+  if(strncmp("clear", type, typeLen) == 0) {
+    pcapClearFilter();
+    return true;
+  } else if(!value) {
+    return false;
+  } else if(strncmp("dir", type, typeLen) == 0) {
+    if(strncmp("rx", value, valueLen) == 0) {
+      filter.directions = PCAP_DIR_RX;
+    } else if(strncmp("tx", value, valueLen) == 0) {
+      filter.directions = PCAP_DIR_TX;
+    } else if(any) {
+      filter.directions = PCAP_DIR_ANY;
+    } else {
+      return false;
+    }
+  } else if(strncmp("bcmp", type, typeLen) == 0) {
+    filter.bcmpType = any ? -1 : (int32_t)(strtoul(value, NULL, 0) & 0xFFFF);
+  } else if(strncmp("port", type, typeLen) == 0) {
+    filter.udpPort = any ? 0 : (uint16_t)strtoul(value, NULL, 0);
+  } else if(strncmp("topic", type, typeLen) == 0) {
+    if(any) {
+      filter.topicPrefix[0] = 0;
+    } else {
+      size_t len = MIN((size_t)valueLen, PCAP_TOPIC_PREFIX_MAX_LEN);
+      memcpy(filter.topicPrefix, value, len);
+      filter.topicPrefix[len] = 0;
+    }
+  } else {
+    return false;
+  }
+
+  pcapSetFilter(&filter);
+  return true;
+}
+
+static BaseType_t cmd_pcap_fn(char *writeBuffer,
+                              size_t writeBufferLen,
+                              const char *commandString) {
+  (void) writeBuffer;
+  (void) writeBufferLen;
+
+  BaseType_t commandLen = 0;
+  const char *command = FreeRTOS_CLIGetParameter(commandString, 1, &commandLen);
+
+  if(!command) {
+    printf("Invalid arguments\n");
+  } else if(strncmp("status", command, commandLen) == 0) {
+    pcapPrintStatus();
+  } else if(strncmp("snaplen", command, commandLen) == 0) {
+    BaseType_t snaplenLen = 0;
+    const char *snaplen = FreeRTOS_CLIGetParameter(commandString, 2, &snaplenLen);
+    if(snaplen) {
+      pcapSetSnaplen(strtoul(snaplen, NULL, 10));
+      printf("snaplen %u (reconnect to apply)\n", pcapGetSnaplen());
+    } else {
+      printf("Invalid arguments\n");
+    }
+  } else if(strncmp("filter", command, commandLen) == 0) {
+    if(cmd_pcap_filter(commandString)) {
+      pcapPrintStatus();
+    } else {
+      printf("Invalid arguments\n");
+    }
+  } else {
+    printf("Invalid arguments\n");
+  }
+
+  return pdFALSE;
+}
@@ -1,14 +1,58 @@
+#pragma once
+
+#include <stdbool.h>
 #include <stdint.h>
 #include "serial.h"
 #ifdef __cplusplus
 extern "C" {
 #endif
 
+// Largest frame we'll capture (ethernet MTU + header, rounded up)
+#define PCAP_SNAPLEN_MAX (1536)
+#define PCAP_SNAPLEN_MIN (64)
+#define PCAP_TOPIC_PREFIX_MAX_LEN (32)
+
+typedef enum {
+  PCAP_DIR_RX = (1 << 0),
+  PCAP_DIR_TX = (1 << 1),
+  PCAP_DIR_ANY = (PCAP_DIR_RX | PCAP_DIR_TX),
+} pcapDirection_e;
+
+// All filter fields must match for a packet to be captured
+typedef struct {
+  // Mask of pcapDirection_e
+  uint8_t directions;
+  // Only capture BCMP packets of this type (-1 for any)
+  int32_t bcmpType;
+  // Only capture UDP packets to/from this port (0 for any)
+  uint16_t udpPort;
+  // Only capture middleware publishes with topics starting with this (empty for any)
+  char topicPrefix[PCAP_TOPIC_PREFIX_MAX_LEN + 1];
+} pcapFilter_t;
+
+typedef struct {
+  // Packets seen while capture was enabled
+  uint32_t received;
+  // Packets that didn't match the filter
+  uint32_t filtered;
+  // Packets dropped because the capture ring was full
+  uint32_t dropped;
+  // Packets dropped because the USB serial queue was full
+  uint32_t usbDropped;
+} pcapStats_t;
+
 void pcapInit(SerialHandle_t *handle);
-void pcapTxPacket(const uint8_t *buff, size_t len);
+void pcapCapture(const uint8_t *buff, size_t len, pcapDirection_e direction);
 void pcapEnable();
 void pcapDisable();
 
+void pcapSetSnaplen(uint16_t snaplen);
+uint16_t pcapGetSnaplen(void);
+void pcapSetFilter(const pcapFilter_t *filter);
+void pcapGetFilter(pcapFilter_t *filter);
+void pcapClearFilter(void);
+void pcapGetStats(pcapStats_t *stats);
+
 #ifdef __cplusplus
 }
 #endif
@@ -0,0 +1,302 @@
+#include <inttypes.h>
+#include <stdio.h>
+#include <string.h>
+#include "FreeRTOS.h"
+#include "task.h"
+#include "perf_counters.h"
+
+static perfCounter_t *_head;
+static perfCounter_t *_tail;
+
+static perfCounter_t _heapFree;
+static perfCounter_t _heapMinFree;
+static perfCounter_t _heapLargestFree;
+
+#if configGENERATE_RUN_TIME_STATS == 1
+static perfCounter_t _cpuLoad;
+static configRUN_TIME_COUNTER_TYPE _lastTotalRunTime;
+static configRUN_TIME_COUNTER_TYPE _lastIdleRunTime;
+#ifdef configRUN_TIME_COUNTS_PER_TICK
+static TickType_t _lastTicks;
+#endif
+#endif
+
+/*!
+  Register built-in (heap/cpu) counters. Safe to call more than once.
+
+  \return none
+*/
+void perfCountersInit(void) {
+  if(_heapFree.group) {
+    return;
+  }
+
+  perfCounterRegister(&_heapFree, "heap", "free", PERF_COUNTER_TYPE_GAUGE);
+  perfCounterRegister(&_heapMinFree, "heap", "min_free", PERF_COUNTER_TYPE_GAUGE);
+  perfCounterRegister(&_heapLargestFree, "heap", "largest_free", PERF_COUNTER_TYPE_GAUGE);
+#if configGENERATE_RUN_TIME_STATS == 1
+  perfCounterRegister(&_cpuLoad, "cpu", "load_pct_x100", PERF_COUNTER_TYPE_GAUGE);
+#endif
+}
+
+/*!
+  Add counter to the registry. Counter memory must remain valid forever.
+
+  \param[in] *counter - counter to register
+  \param[in] *group - counter group (module/queue name)
+  \param[in] *name - counter name
+  \param[in] type - counter type
+  \return none
+*/
+void perfCounterRegister(perfCounter_t *counter, const char *group, const char *name, perfCounterType_e type) {
+  configASSERT(counter);
+  configASSERT(group);
+  configASSERT(name);
+
+  counter->group = group;
+  counter->name = name;
+  counter->type = type;
+  counter->value = 0;
+  counter->next = NULL;
+
+  taskENTER_CRITICAL();
+  if(_tail) {
+    _tail->next = counter;
+  } else {
+    _head = counter;
+  }
+  _tail = counter;
+  taskEXIT_CRITICAL();
+}
+
+/*!
+  Find counter by group and name
+
+  \param[in] *group - counter group
+  \param[in] *name - counter name
+  \return pointer to counter, NULL if not found
+*/
+perfCounter_t *perfCounterFind(const char *group, const char *name) {
+  for(perfCounter_t *counter = _head; counter; counter = counter->next) {
+    if((strcmp(counter->group, group) == 0) && (strcmp(counter->name, name) == 0)) {
+      return counter;
+    }
+  }
+
+  return NULL;
+}
+
+/*!
+  Get counter value by group and name
+
+  \param[in] *group - counter group
+  \param[in] *name - counter name
+  \return counter value, 0 if not found
+*/
+uint32_t perfCounterGet(const char *group, const char *name) {
+  perfCounter_t *counter = perfCounterFind(group, name);
+  return counter ? counter->value : 0;
+}
+
+/*!
+  Get first registered counter. Use counter->next to iterate.
+  Counters are never removed, so iterating doesn't require locking.
+
+  \return pointer to first counter, NULL if none are registered
+*/
+perfCounter_t *perfCountersFirst(void) {
+  return _head;
+}
+
+/*!
+  Clear event counts and high water marks. Gauges are left alone.
+
+  \return none
+*/
+void perfCountersReset(void) {
+  for(perfCounter_t *counter = _head; counter; counter = counter->next) {
+    if(counter->type != PERF_COUNTER_TYPE_GAUGE) {
+      perfCounterSet(counter, 0);
+    }
+  }
+}
+
+/*!
+  Update gauges (heap and cpu load). Cpu load is computed since the
+  previous call, so call this periodically (or right before reading).
+
+  \return none
+*/
+void perfCountersSample(void) {
+  perfCountersInit();
+
+  HeapStats_t heapStats;
+  vPortGetHeapStats(&heapStats);
+  perfCounterSet(&_heapFree, heapStats.xAvailableHeapSpaceInBytes);
+  perfCounterSet(&_heapMinFree, heapStats.xMinimumEverFreeBytesRemaining);
+  perfCounterSet(&_heapLargestFree, heapStats.xSizeOfLargestFreeBlockInBytes);
+
+#if configGENERATE_RUN_TIME_STATS == 1
+  configRUN_TIME_COUNTER_TYPE totalRunTime = portGET_RUN_TIME_COUNTER_VALUE();
+  configRUN_TIME_COUNTER_TYPE idleRunTime = ulTaskGetIdleRunTimeCounter();
+  configRUN_TIME_COUNTER_TYPE totalDelta = totalRunTime - _lastTotalRunTime;
+  configRUN_TIME_COUNTER_TYPE idleDelta = idleRunTime - _lastIdleRunTime;
+#ifdef configRUN_TIME_COUNTS_PER_TICK
+  // The run time counter stops while sleeping, so use ticks (which keep
+  // counting in tickless idle) for elapsed time. Time asleep counts as idle.
+  TickType_t ticks = xTaskGetTickCount();
+  configRUN_TIME_COUNTER_TYPE elapsed = (configRUN_TIME_COUNTER_TYPE)(TickType_t)(ticks - _lastTicks) * configRUN_TIME_COUNTS_PER_TICK;
+  _lastTicks = ticks;
+  if(elapsed > totalDelta) {
+    idleDelta += elapsed - totalDelta;
+    totalDelta = elapsed;
+  }
+#endif
+  if(totalDelta && (idleDelta <= totalDelta)) {
+    perfCounterSet(&_cpuLoad, (uint32_t)(((totalDelta - idleDelta) * 10000) / totalDelta));
+  }
+  _lastTotalRunTime = totalRunTime;
+  _lastIdleRunTime = idleRunTime;
+#endif
+}
+
+/*!
+  Print all registered counters
+
+  \return none
+*/
+void perfCountersPrint(void) {
+  perfCountersSample();
+
+  for(perfCounter_t *counter = _head; counter; counter = counter->next) {
+    printf("%s.%s: %" PRIu32 "\n", counter->group, counter->name, counter->value);
+  }
+}
+
+/*!
+  Register counters for a queue (sent, dropped, high water mark, capacity).
+  Call right after the queue is created, while it's still empty.
+
+  \param[in] *perfQueue - queue counters to register
+  \param[in] *name - queue name, used as the counter group
+  \param[in] queue - queue handle
+  \return none
+*/
+void perfQueueRegister(perfQueue_t *perfQueue, const char *name, QueueHandle_t queue) {
+  configASSERT(perfQueue);
+  configASSERT(queue);
+
+  perfQueue->queue = queue;
+  perfCounterRegister(&perfQueue->sent, name, "sent", PERF_COUNTER_TYPE_COUNT);
+  perfCounterRegister(&perfQueue->dropped, name, "dropped", PERF_COUNTER_TYPE_COUNT);
+  perfCounterRegister(&perfQueue->highWater, name, "hwm", PERF_COUNTER_TYPE_MAX);
+  perfCounterRegister(&perfQueue->capacity, name, "capacity", PERF_COUNTER_TYPE_GAUGE);
+  perfCounterSet(&perfQueue->capacity, uxQueueSpacesAvailable(queue) + uxQueueMessagesWaiting(queue));
+}
+
+/*!
+  Record successful queue send. Call after xQueueSend returns pdTRUE.
+
+  \param[in] *perfQueue - queue counters
+  \return none
+*/
+void perfQueueSent(perfQueue_t *perfQueue) {
+  configASSERT(perfQueue);
+  perfCounterInc(&perfQueue->sent);
+  perfCounterMax(&perfQueue->highWater, uxQueueMessagesWaiting(perfQueue->queue));
+}
+
+/*!
+  Record successful queue send from an ISR. Call after xQueueSendFromISR returns pdTRUE.
+
+  \param[in] *perfQueue - queue counters
+  \return none
+*/
+void perfQueueSentFromISR(perfQueue_t *perfQueue) {
+  configASSERT(perfQueue);
+  perfCounterInc(&perfQueue->sent);
+  perfCounterMax(&perfQueue->highWater, uxQueueMessagesWaitingFromISR(perfQueue->queue));
+}
+
+/*!
+  Record failed queue send (item dropped). Safe to call from any context.
+
+  \param[in] *perfQueue - queue counters
+  \return none
+*/
+void perfQueueDropped(perfQueue_t *perfQueue) {
+  configASSERT(perfQueue);
+  perfCounterInc(&perfQueue->dropped);
+  // If we're dropping, the queue was full
+  perfCounterSet(&perfQueue->highWater, perfQueue->capacity.value);
+}
+
+#if configUSE_TRACE_FACILITY == 1
+/*!
+  Get per-task statistics
+
+  \param[out] *stats - array to store task stats in
+  \param[in] maxTasks - number of entries in stats
+  \return number of tasks stored in stats
+*/
+uint32_t perfTasksSample(perfTaskStats_t *stats, uint32_t maxTasks) {
+  configASSERT(stats);
+  uint32_t numTasks = 0;
+
+  UBaseType_t numberOfTasks = uxTaskGetNumberOfTasks();
+  TaskStatus_t *taskStatusArray = (TaskStatus_t *)pvPortMalloc(numberOfTasks * sizeof(TaskStatus_t));
+  if(taskStatusArray) {
+    configRUN_TIME_COUNTER_TYPE totalRunTime = 0;
+    numberOfTasks = uxTaskGetSystemState(taskStatusArray, numberOfTasks, &totalRunTime);
+
+    for(UBaseType_t taskIdx = 0; (taskIdx < numberOfTasks) && (numTasks < maxTasks); taskIdx++) {
+      perfTaskStats_t *taskStats = &stats[numTasks++];
+      strncpy(taskStats->name, taskStatusArray[taskIdx].pcTaskName, sizeof(taskStats->name) - 1);
+      taskStats->name[sizeof(taskStats->name) - 1] = 0;
+      taskStats->runTime = taskStatusArray[taskIdx].ulRunTimeCounter;
+      taskStats->cpuPctX100 = totalRunTime ? (uint32_t)((taskStats->runTime * 10000) / totalRunTime) : 0;
+      taskStats->stackHighWaterMark = taskStatusArray[taskIdx].usStackHighWaterMark;
+    }
+
+    vPortFree(taskStatusArray);
+  }
+
+  return numTasks;
+}
+
+/*!
+  Print per-task cpu usage and stack high water marks
+
+  \return none
+*/
+void perfTasksPrint(void) {
+  UBaseType_t maxTasks = uxTaskGetNumberOfTasks();
+  perfTaskStats_t *stats = (perfTaskStats_t *)pvPortMalloc(maxTasks * sizeof(perfTaskStats_t));
+  if(!stats) {
+    printf("Unable to allocate task stats\n");
+    return;
+  }
+
+  uint32_t numTasks = perfTasksSample(stats, maxTasks);
+  printf("%-15s | cpu %%   | StackHighWaterMark\n", "Task Name");
+  for(uint32_t taskIdx = 0; taskIdx < numTasks; taskIdx++) {
+    printf("%-15s | %3" PRIu32 ".%02" PRIu32 " | %" PRIu32 "\n",
+           stats[taskIdx].name,
+           stats[taskIdx].cpuPctX100 / 100,
+           stats[taskIdx].cpuPctX100 % 100,
+           stats[taskIdx].stackHighWaterMark);
+  }
+
+  vPortFree(stats);
+}
+#else
+uint32_t perfTasksSample(perfTaskStats_t *stats, uint32_t maxTasks) {
+  (void)stats;
+  (void)maxTasks;
+  return 0;
+}
+
+void perfTasksPrint(void) {
+  printf("Task stats not available (configUSE_TRACE_FACILITY disabled)\n");
+}
+#endif
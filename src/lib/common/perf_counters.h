@@ -0,0 +1,110 @@
+#pragma once
+
+#include <stdbool.h>
+#include <stdint.h>
+#include "FreeRTOS.h"
+#include "queue.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+//
+// Runtime performance counters. Each update is a single atomic operation.
+//
+
+typedef enum {
+  // Monotonically increasing event count (drops, sends, errors...)
+  PERF_COUNTER_TYPE_COUNT = 0,
+  // Largest value ever seen (queue depth high water marks...)
+  PERF_COUNTER_TYPE_MAX,
+  // Last sampled value (free heap, cpu load...)
+  PERF_COUNTER_TYPE_GAUGE,
+} perfCounterType_e;
+
+typedef struct perfCounter_s {
+  // Group and name must be string literals (or otherwise outlive the counter)
+  const char *group;
+  const char *name;
+  perfCounterType_e type;
+  volatile uint32_t value;
+  struct perfCounter_s *next;
+} perfCounter_t;
+
+// Counters for one FreeRTOS queue in the data path
+typedef struct {
+  QueueHandle_t queue;
+  perfCounter_t sent;
+  perfCounter_t dropped;
+  perfCounter_t highWater;
+  perfCounter_t capacity;
+} perfQueue_t;
+
+typedef struct {
+  char name[configMAX_TASK_NAME_LEN];
+  // Percent of cpu time since boot (x100)
+  uint32_t cpuPctX100;
+  configRUN_TIME_COUNTER_TYPE runTime;
+  uint32_t stackHighWaterMark;
+} perfTaskStats_t;
+
+void perfCountersInit(void);
+void perfCounterRegister(perfCounter_t *counter, const char *group, const char *name, perfCounterType_e type);
+perfCounter_t *perfCounterFind(const char *group, const char *name);
+uint32_t perfCounterGet(const char *group, const char *name);
+perfCounter_t *perfCountersFirst(void);
+void perfCountersReset(void);
+void perfCountersSample(void);
+void perfCountersPrint(void);
+
+void perfQueueRegister(perfQueue_t *perfQueue, const char *name, QueueHandle_t queue);
+void perfQueueSent(perfQueue_t *perfQueue);
+void perfQueueSentFromISR(perfQueue_t *perfQueue);
+void perfQueueDropped(perfQueue_t *perfQueue);
+
+uint32_t perfTasksSample(perfTaskStats_t *stats, uint32_t maxTasks);
+void perfTasksPrint(void);
+
+/*!
+  Increment counter. Safe to call from any context.
+
+  \param[in] *counter - counter to increment (NULL is ignored)
+  \param[in] count - amount to add
+  \return none
+*/
+static inline void perfCounterAdd(perfCounter_t *counter, uint32_t count) {
+  if(counter) {
+    __atomic_fetch_add(&counter->value, count, __ATOMIC_RELAXED);
+  }
+}
+
+static inline void perfCounterInc(perfCounter_t *counter) {
+  perfCounterAdd(counter, 1);
+}
+
+/*!
+  Update high water mark if value is larger. Safe to call from any context.
+
+  \param[in] *counter - counter to update (NULL is ignored)
+  \param[in] value - new value
+  \return none
+*/
+static inline void perfCounterMax(perfCounter_t *counter, uint32_t value) {
+  if(counter) {
+    uint32_t current = __atomic_load_n(&counter->value, __ATOMIC_RELAXED);
+    while((value > current) &&
+          !__atomic_compare_exchange_n(&counter->value, &current, value, true, __ATOMIC_RELAXED, __ATOMIC_RELAXED)) {
+      // current is reloaded by compare_exchange on failure
+    }
+  }
+}
+
+static inline void perfCounterSet(perfCounter_t *counter, uint32_t value) {
+  if(counter) {
+    __atomic_store_n(&counter->value, value, __ATOMIC_RELAXED);
+  }
+}
+
+#ifdef __cplusplus
+}
+#endif
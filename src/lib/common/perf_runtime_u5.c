@@ -0,0 +1,55 @@
+//
+// FreeRTOS run time stats clock (per-task cpu time)
+//
+// Uses the Cortex-M33 cycle counter (DWT->CYCCNT), extended to 64 bits in
+// software. The cycle counter stops while in STOP mode, so run times only
+// include time spent awake. perfCountersSample() uses ticks for elapsed time
+// when computing cpu load (see configRUN_TIME_COUNTS_PER_TICK).
+//
+// NOTE: The extension relies on the counter being read at least once per
+// wrap (2^32 cycles, ~27s at 160MHz), which the scheduler does on every
+// context switch.
+//
+
+#include <stdint.h>
+#include "stm32u5xx.h"
+#include "FreeRTOS.h"
+#include "task.h"
+
+static uint32_t _lastCycles;
+static uint64_t _cycleCounterHigh;
+
+/*!
+  Start the cycle counter. Called by the scheduler before it starts
+  (portCONFIGURE_TIMER_FOR_RUN_TIME_STATS)
+
+  \return none
+*/
+void perfRunTimeCounterInit(void) {
+  CoreDebug->DEMCR |= CoreDebug_DEMCR_TRCENA_Msk;
+  DWT->CYCCNT = 0;
+  DWT->CTRL |= DWT_CTRL_CYCCNTENA_Msk;
+  _lastCycles = 0;
+  _cycleCounterHigh = 0;
+}
+
+/*!
+  Get 64-bit cycle count. Safe to call from tasks and ISRs.
+  (portGET_RUN_TIME_COUNTER_VALUE)
+
+  \return number of cpu cycles spent awake since perfRunTimeCounterInit()
+*/
+uint64_t perfRunTimeCounterGet(void) {
+  UBaseType_t mask = portSET_INTERRUPT_MASK_FROM_ISR();
+
+  uint32_t cycles = DWT->CYCCNT;
+  if(cycles < _lastCycles) {
+    _cycleCounterHigh += (1ULL << 32);
+  }
+  _lastCycles = cycles;
+  uint64_t rval = _cycleCounterHigh | cycles;
+
+  portCLEAR_INTERRUPT_MASK_FROM_ISR(mask);
+
+  return rval;
+}
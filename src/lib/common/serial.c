@@ -9,6 +9,7 @@
 
 // #include "log.h"
 #include "bm_usart.h"
+#include "perf_counters.h"
 #include "serial.h"
 #include "stm32_io.h"
 #include "task_priorities.h"
@@ -29,13 +30,35 @@
 //
 #define MAX_TX_TIME_MS (5000)
 
+// Largest block of bytes taken from the rx stream buffer at once
+#define SERIAL_RX_BLOCK_LEN (64)
+
 // Queue for all serial outputs
 static xQueueHandle serialTxQueue = NULL;
+static perfQueue_t serialTxQueuePerf;
 
 xQueueHandle serialGetTxQueue() {
   return serialTxQueue;
 }
 
+/*!
+  Queue message for transmission by the serial tx task. Caller is responsible
+  for freeing message->buff if this fails.
+
+  \param[in] *message - message to send
+  \param[in] ticksToWait - how long to wait for space in the queue
+  \return pdTRUE if queued, pdFALSE otherwise
+*/
+BaseType_t serialTxQueueSend(const SerialMessage_t *message, TickType_t ticksToWait) {
+  BaseType_t rval = xQueueSend(serialTxQueue, message, ticksToWait);
+  if(rval == pdTRUE) {
+    perfQueueSent(&serialTxQueuePerf);
+  } else {
+    perfQueueDropped(&serialTxQueuePerf);
+  }
+  return rval;
+}
+
 void startSerial() {
   BaseType_t rval;
 
@@ -45,6 +68,7 @@ void startSerial() {
 
   serialTxQueue = xQueueCreate(SERIAL_TX_QUEUE_SIZE, sizeof(SerialMessage_t));
   configASSERT(serialTxQueue != NULL);
+  perfQueueRegister(&serialTxQueuePerf, "serial_tx_q", serialTxQueue);
 
   rval = xTaskCreate(
               serialTxTask,
@@ -140,15 +164,20 @@ void serialGenericRxTask( void *parameters ) {
   // Make sure we have a strem buffer to receive data from
   configASSERT(handle->rxStreamBuffer != NULL);
 
+  // One extra byte so processBytes can zero terminate in place
+  uint8_t rxBuff[SERIAL_RX_BLOCK_LEN + 1];
+
   for(;;) {
-    uint8_t byte;
+    // Returns as soon as there are any bytes, with as many as are available
     size_t rxLen = xStreamBufferReceive( handle->rxStreamBuffer,      // Stream buffer
-                                          &byte,                      // Where to put the data
-                                          sizeof(byte),               // Size of transfer
+                                          rxBuff,                     // Where to put the data
+                                          SERIAL_RX_BLOCK_LEN,        // Size of transfer
                                           portMAX_DELAY);             // Timeout (forever)
 
 #ifdef TRACE_SERIAL
-  traceAddSerial(handle, byte, false, false);
+  for(uint32_t byte=0; byte < rxLen; byte++) {
+    traceAddSerial(handle, rxBuff[byte], false, false);
+  }
 #endif
 
     if(handle->flags & SERIAL_FLAG_RXDROP) {
@@ -156,9 +185,21 @@ void serialGenericRxTask( void *parameters ) {
       // logPrint(SerialLog, LOG_LEVEL_ERROR, "RX Overflow [%s]\n", handle->name);
     }
 
+    if(rxLen == 0) {
+      continue;
+    }
+
     // Do something with received bytes if needed
-    if(rxLen != 0 && handle->processByte != NULL) {
-      handle->processByte(handle, byte);
+    if(handle->processBytes != NULL) {
+      handle->processBytes(handle, rxBuff, rxLen);
+    } else {
+      for(size_t idx = 0; idx < rxLen; idx++) {
+        // Handler can be swapped out while processing (the REPL does this)
+        void (*processByte)(void *serialHandle, uint8_t byte) = handle->processByte;
+        if(processByte != NULL) {
+          processByte(handle, rxBuff[idx]);
+        }
+      }
     }
   }
 }
@@ -267,7 +308,7 @@ void serialGenericUartIRQHandler(SerialHandle_t *handle) {
 extern xQueueHandle serialTxQueue; // TODO - don't extern this, put in handle or store otherwise
 void serialPutcharUnbuffered(SerialHandle_t *handle, char character) {
   SerialMessage_t singleCharMessage = {NULL, 0xFF00 | (uint16_t)character, handle};
-  xQueueSend( serialTxQueue, &singleCharMessage, 10 );
+  serialTxQueueSend(&singleCharMessage, 10);
 }
 
 static void serialGenericTx(SerialHandle_t *handle, uint8_t *data, size_t len) {
@@ -378,11 +419,12 @@ void serialWrite(SerialHandle_t *handle, const uint8_t *buff, size_t len) {
   \param *handle destination serial device handle
   \param *buff buffer of data to write (must be malloc'd)
   \param len buffer length
+  \return true if the buffer was queued, false if it was dropped
 
   Sending task will free buff, therefore caller should not free buffer
   or use data from stack (or static)
 */
-void serialWriteNocopy(SerialHandle_t *handle, uint8_t *buff, size_t len) {
+bool serialWriteNocopy(SerialHandle_t *handle, uint8_t *buff, size_t len) {
   configASSERT(handle != NULL);
   configASSERT(buff != NULL);
 
@@ -393,8 +435,11 @@ void serialWriteNocopy(SerialHandle_t *handle, uint8_t *buff, size_t len) {
   };
 
   // Send buffer to serial output queue
-  if(xQueueSend(serialGetTxQueue(), &serialWriteMessage, 100) != pdTRUE) {
+  if(serialTxQueueSend(&serialWriteMessage, 100) != pdTRUE) {
     // If we couldn't send the buffer, make sure to free buff
     vPortFree(buff);
+    return false;
   }
+
+  return true;
 }
@@ -5,6 +5,7 @@
 #include "FreeRTOS.h"
 #include "io.h"
 #include "queue.h"
+#include "serial_line_buffer.h"
 #include "stream_buffer.h"
 #include "trace.h"
 
@@ -12,13 +13,6 @@
 extern "C" {
 #endif
 
-typedef struct {
-  uint8_t *buffer;
-  size_t idx;
-  size_t len;
-  void (*lineCallback)(void *serialHandle, uint8_t *line, size_t len);
-} SerialLineBuffer_t;
-
 typedef struct SerialHandle {
   // Pointer to hardware struct
   void * device;
@@ -53,9 +47,13 @@ typedef struct SerialHandle {
   // ISR tx byte processing function
   size_t (*getTxBytesFromISR)(struct SerialHandle *handle, uint8_t *buffer, size_t len);
 
-  // Function to process received bytes
+  // Function to process received bytes (one at a time)
   void (*processByte)(void *serialHandle, uint8_t byte);
 
+  // Function to process blocks of received bytes. Used instead of
+  // processByte when set. buffer has room for one more byte after len.
+  void (*processBytes)(void *serialHandle, uint8_t *buffer, size_t len);
+
   // Pointer for additonal arguments/data to link to this handle
   void *data;
 
@@ -100,9 +98,10 @@ void serialTxTask(void *parameters);
 void startSerial();
 
 void serialWrite(SerialHandle_t *handle, const uint8_t *buff, size_t len);
-void serialWriteNocopy(SerialHandle_t *handle, uint8_t *buff, size_t len);
+bool serialWriteNocopy(SerialHandle_t *handle, uint8_t *buff, size_t len);
 
 xQueueHandle serialGetTxQueue();
+BaseType_t serialTxQueueSend(const SerialMessage_t *message, TickType_t ticksToWait);
 
 #ifdef TRACE_SERIAL
 inline void traceAddSerial(SerialHandle_t *handle, uint8_t byte, bool tx, bool isr) {
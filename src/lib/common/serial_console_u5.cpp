@@ -79,7 +79,7 @@ void serialConsolePutchar(char character, void* arg) {
     // If message buffer is full (or we see a newline), send buffer
     if (xConsoleOutputMessage.len >= CONSOLE_OUTPUT_SIZE || character == '\n') {
       xConsoleOutputMessage.destination = serialConsoleHandle;
-      if(xQueueSend(serialGetTxQueue(), &xConsoleOutputMessage, 10) != pdTRUE) {
+      if(serialTxQueueSend(&xConsoleOutputMessage, 10) != pdTRUE) {
         // Free buffer if unable to send
         vPortFree(xConsoleOutputMessage.buff);
       }
@@ -0,0 +1,66 @@
+#include <string.h>
+#include "FreeRTOS.h"
+#include "serial_line_buffer.h"
+
+/*!
+  Split received bytes into '\n' terminated lines and call the line callback
+  for each one. The line passed to the callback includes the '\n' (not
+  counted in len) and is zero terminated.
+
+  Lines received completely in one block are passed straight from the
+  receive buffer without being copied, so buffer must have room for one
+  more byte after len (for the zero terminator). Only lines split across
+  blocks are copied into lineBuffer->buffer. Lines too long for it are
+  dropped.
+
+  \param[in] *serialHandle - serial handle (passed to the line callback)
+  \param[in] *lineBuffer - line buffer
+  \param[in] *buffer - received bytes (len + 1 bytes long)
+  \param[in] len - number of received bytes
+  \return none
+*/
+void serialLineBufferProcess(void *serialHandle, SerialLineBuffer_t *lineBuffer, uint8_t *buffer, size_t len) {
+  configASSERT(lineBuffer != NULL);
+  configASSERT(lineBuffer->buffer != NULL);
+  configASSERT(buffer != NULL || len == 0);
+
+  while(len > 0) {
+    uint8_t *newline = (uint8_t *)memchr(buffer, '\n', len);
+    // Segment includes the newline
+    size_t segmentLen = (newline != NULL) ? (size_t)(newline - buffer) + 1 : len;
+
+    if(newline != NULL && lineBuffer->idx == 0 && !lineBuffer->discard) {
+      // Whole line is in the receive buffer, no need to copy it
+      uint8_t nextByte = buffer[segmentLen];
+      buffer[segmentLen] = 0;
+      if(lineBuffer->lineCallback != NULL) {
+        lineBuffer->lineCallback(serialHandle, buffer, segmentLen - 1);
+      }
+      buffer[segmentLen] = nextByte;
+    } else if(!lineBuffer->discard) {
+      // Keep the partial line until the rest of it arrives
+      // (leaving room for the zero terminator)
+      if((lineBuffer->idx + segmentLen + 1) > lineBuffer->len) {
+        lineBuffer->idx = 0;
+        lineBuffer->discard = (newline == NULL);
+      } else {
+        memcpy(&lineBuffer->buffer[lineBuffer->idx], buffer, segmentLen);
+        lineBuffer->idx += segmentLen;
+
+        if(newline != NULL) {
+          lineBuffer->buffer[lineBuffer->idx] = 0;
+          if(lineBuffer->lineCallback != NULL) {
+            lineBuffer->lineCallback(serialHandle, lineBuffer->buffer, lineBuffer->idx - 1);
+          }
+          lineBuffer->idx = 0;
+        }
+      }
+    } else if(newline != NULL) {
+      // End of the line that was too long
+      lineBuffer->discard = false;
+    }
+
+    buffer += segmentLen;
+    len -= segmentLen;
+  }
+}
@@ -0,0 +1,24 @@
+#pragma once
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef struct {
+  uint8_t *buffer;
+  size_t idx;
+  size_t len;
+  void (*lineCallback)(void *serialHandle, uint8_t *line, size_t len);
+  // Line didn't fit in buffer, dropping bytes until the next newline
+  bool discard;
+} SerialLineBuffer_t;
+
+void serialLineBufferProcess(void *serialHandle, SerialLineBuffer_t *lineBuffer, uint8_t *buffer, size_t len);
+
+#ifdef __cplusplus
+}
+#endif
@@ -0,0 +1,163 @@
+#include <string.h>
+#include "sha256.h"
+
+static const uint32_t k[64] = {
+  0x428a2f98, 0x71374491, 0xb5c0fbcf, 0xe9b5dba5, 0x3956c25b, 0x59f111f1, 0x923f82a4, 0xab1c5ed5,
+  0xd807aa98, 0x12835b01, 0x243185be, 0x550c7dc3, 0x72be5d74, 0x80deb1fe, 0x9bdc06a7, 0xc19bf174,
+  0xe49b69c1, 0xefbe4786, 0x0fc19dc6, 0x240ca1cc, 0x2de92c6f, 0x4a7484aa, 0x5cb0a9dc, 0x76f988da,
+  0x983e5152, 0xa831c66d, 0xb00327c8, 0xbf597fc7, 0xc6e00bf3, 0xd5a79147, 0x06ca6351, 0x14292967,
+  0x27b70a85, 0x2e1b2138, 0x4d2c6dfc, 0x53380d13, 0x650a7354, 0x766a0abb, 0x81c2c92e, 0x92722c85,
+  0xa2bfe8a1, 0xa81a664b, 0xc24b8b70, 0xc76c51a3, 0xd192e819, 0xd6990624, 0xf40e3585, 0x106aa070,
+  0x19a4c116, 0x1e376c08, 0x2748774c, 0x34b0bcb5, 0x391c0cb3, 0x4ed8aa4a, 0x5b9cca4f, 0x682e6ff3,
+  0x748f82ee, 0x78a5636f, 0x84c87814, 0x8cc70208, 0x90befffa, 0xa4506ceb, 0xbef9a3f7, 0xc67178f2,
+};
+
+static inline uint32_t ror(uint32_t value, uint32_t bits) {
+  return (value >> bits) | (value << (32 - bits));
+}
+
+/*!
+  Run the compression function over one 64 byte block
+
+  \param[in,out] *state - hash state
+  \param[in] *block - 64 bytes of message
+  \return none
+*/
+static void sha256Block(uint32_t state[8], const uint8_t *block) {
+  uint32_t w[64];
+
+  for(uint32_t idx = 0; idx < 16; idx++) {
+    w[idx] = ((uint32_t)block[idx * 4] << 24) | ((uint32_t)block[idx * 4 + 1] << 16) |
+             ((uint32_t)block[idx * 4 + 2] << 8) | (uint32_t)block[idx * 4 + 3];
+  }
+  for(uint32_t idx = 16; idx < 64; idx++) {
+    uint32_t s0 = ror(w[idx - 15], 7) ^ ror(w[idx - 15], 18) ^ (w[idx - 15] >> 3);
+    uint32_t s1 = ror(w[idx - 2], 17) ^ ror(w[idx - 2], 19) ^ (w[idx - 2] >> 10);
+    w[idx] = w[idx - 16] + s0 + w[idx - 7] + s1;
+  }
+
+  uint32_t a = state[0];
+  uint32_t b = state[1];
+  uint32_t c = state[2];
+  uint32_t d = state[3];
+  uint32_t e = state[4];
+  uint32_t f = state[5];
+  uint32_t g = state[6];
+  uint32_t h = state[7];
+
+  for(uint32_t idx = 0; idx < 64; idx++) {
+    uint32_t s1 = ror(e, 6) ^ ror(e, 11) ^ ror(e, 25);
+    uint32_t ch = (e & f) ^ (~e & g);
+    uint32_t t1 = h + s1 + ch + k[idx] + w[idx];
+    uint32_t s0 = ror(a, 2) ^ ror(a, 13) ^ ror(a, 22);
+    uint32_t maj = (a & b) ^ (a & c) ^ (b & c);
+    uint32_t t2 = s0 + maj;
+
+    h = g;
+    g = f;
+    f = e;
+    e = d + t1;
+    d = c;
+    c = b;
+    b = a;
+    a = t1 + t2;
+  }
+
+  state[0] += a;
+  state[1] += b;
+  state[2] += c;
+  state[3] += d;
+  state[4] += e;
+  state[5] += f;
+  state[6] += g;
+  state[7] += h;
+}
+
+/*!
+  Start a new digest
+
+  \param[out] *ctx - context to initialize
+  \return none
+*/
+void sha256Init(sha256Ctx_t *ctx) {
+  static const uint32_t initialState[8] = {
+    0x6a09e667, 0xbb67ae85, 0x3c6ef372, 0xa54ff53a, 0x510e527f, 0x9b05688c, 0x1f83d9ab, 0x5be0cd19,
+  };
+
+  memcpy(ctx->state, initialState, sizeof(initialState));
+  ctx->len = 0;
+  ctx->blockLen = 0;
+}
+
+/*!
+  Add data to the digest
+
+  \param[in,out] *ctx - digest context
+  \param[in] *data - data to add
+  \param[in] len - number of bytes
+  \return none
+*/
+void sha256Update(sha256Ctx_t *ctx, const uint8_t *data, size_t len) {
+  ctx->len += len;
+
+  // Finish a partial block first
+  if(ctx->blockLen) {
+    size_t fill = SHA256_BLOCK_LEN - ctx->blockLen;
+    if(fill > len) {
+      fill = len;
+    }
+    memcpy(&ctx->block[ctx->blockLen], data, fill);
+    ctx->blockLen += fill;
+    data += fill;
+    len -= fill;
+
+    if(ctx->blockLen < SHA256_BLOCK_LEN) {
+      return;
+    }
+    sha256Block(ctx->state, ctx->block);
+    ctx->blockLen = 0;
+  }
+
+  // Whole blocks straight from the caller's buffer
+  while(len >= SHA256_BLOCK_LEN) {
+    sha256Block(ctx->state, data);
+    data += SHA256_BLOCK_LEN;
+    len -= SHA256_BLOCK_LEN;
+  }
+
+  if(len) {
+    memcpy(ctx->block, data, len);
+    ctx->blockLen = len;
+  }
+}
+
+/*!
+  Finish the digest. The context has to be initialized again before reuse.
+
+  \param[in,out] *ctx - digest context
+  \param[out] digest - SHA-256 digest
+  \return none
+*/
+void sha256Final(sha256Ctx_t *ctx, uint8_t digest[SHA256_DIGEST_LEN]) {
+  uint64_t bits = ctx->len * 8;
+
+  // Pad with 0x80, zeros and the message length in bits (big endian)
+  ctx->block[ctx->blockLen++] = 0x80;
+  if(ctx->blockLen > (SHA256_BLOCK_LEN - 8)) {
+    memset(&ctx->block[ctx->blockLen], 0, SHA256_BLOCK_LEN - ctx->blockLen);
+    sha256Block(ctx->state, ctx->block);
+    ctx->blockLen = 0;
+  }
+  memset(&ctx->block[ctx->blockLen], 0, (SHA256_BLOCK_LEN - 8) - ctx->blockLen);
+  for(uint32_t idx = 0; idx < 8; idx++) {
+    ctx->block[SHA256_BLOCK_LEN - 1 - idx] = (uint8_t)(bits >> (idx * 8));
+  }
+  sha256Block(ctx->state, ctx->block);
+
+  for(uint32_t idx = 0; idx < 8; idx++) {
+    digest[idx * 4] = (uint8_t)(ctx->state[idx] >> 24);
+    digest[idx * 4 + 1] = (uint8_t)(ctx->state[idx] >> 16);
+    digest[idx * 4 + 2] = (uint8_t)(ctx->state[idx] >> 8);
+    digest[idx * 4 + 3] = (uint8_t)(ctx->state[idx]);
+  }
+}
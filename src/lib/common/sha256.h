@@ -0,0 +1,32 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+//
+// Streaming SHA-256 (FIPS 180-4).
+//
+// Data can be fed in pieces of any size, so a digest can be built up as an
+// image is received instead of reading it all back from flash afterwards.
+//
+#define SHA256_BLOCK_LEN    (64)
+#define SHA256_DIGEST_LEN   (32)
+
+typedef struct {
+  uint32_t state[8];
+  uint64_t len;
+  uint8_t block[SHA256_BLOCK_LEN];
+  uint32_t blockLen;
+} sha256Ctx_t;
+
+void sha256Init(sha256Ctx_t *ctx);
+void sha256Update(sha256Ctx_t *ctx, const uint8_t *data, size_t len);
+void sha256Final(sha256Ctx_t *ctx, uint8_t digest[SHA256_DIGEST_LEN]);
+
+#ifdef __cplusplus
+}
+#endif
@@ -1,3 +1,5 @@
+#include <inttypes.h>
+#include <stdlib.h>
 #include <string.h>
 #include "FreeRTOS.h"
 #include "task.h"
@@ -17,6 +19,12 @@
 #include "bm_util.h"
 #include "eth_adin2111.h"
 #include "bm_l2.h"
+#include "bm_pubsub.h"
+#include "device_info.h"
+#include "latency_histogram.h"
+#include "semphr.h"
+#include "stm32_rtc.h"
+#include "uptime.h"
 
 #include "stress.h"
 
@@ -29,6 +37,80 @@
 
 #define STRESS_QUEUE_LEN 32
 
+//
+// Pub/sub benchmark
+//
+#define BENCH_MAGIC           (0x48434E42) // "BNCH"
+#define BENCH_TOPIC_FMT       "bench/%u"
+#define BENCH_CTL_TOPIC       "bench/ctl"
+#define BENCH_TOPIC_MAX_LEN   (16)
+#define BENCH_MAX_TOPICS      (32)
+#define BENCH_MAX_SOURCES     (8)
+#define BENCH_MAX_RATE_HZ     (5000)
+#define BENCH_MAX_PAYLOAD     (1024)
+// Don't hog the stress task if we fall behind
+#define BENCH_MAX_BURST       (16)
+#define BENCH_TX_TIMER_MS     (1)
+// End of run message is sent a few times in case one gets lost
+#define BENCH_END_REPEAT      (3)
+
+// tx_time_us is from the RTC, which is synchronized across the network
+// (bcmp time), so the receiver can compute one-way latency
+#define BENCH_FLAG_RTC_TIME   (1 << 0)
+
+typedef struct {
+  uint32_t magic;
+  uint32_t run_id;
+  uint32_t seq;
+  uint64_t tx_time_us;
+  uint8_t flags;
+  uint8_t topic_idx;
+  uint16_t payload_len;
+} __attribute__((packed)) stress_bench_hdr_t;
+
+typedef struct {
+  uint32_t magic;
+  uint32_t run_id;
+  uint32_t sent;
+  uint32_t duration_ms;
+} __attribute__((packed)) stress_bench_end_t;
+
+typedef struct {
+  bool running;
+  stress_bench_pub_cfg_t cfg;
+  uint32_t run_id;
+  uint32_t attempted;
+  uint32_t sent;
+  uint32_t failed;
+  uint64_t bytes;
+  TickType_t start_ticks;
+  uint8_t *buf;
+  TimerHandle_t timer;
+} stress_bench_pub_t;
+
+typedef struct {
+  uint64_t node_id;
+  uint32_t run_id;
+  uint16_t payload_len;
+  bool done;
+  uint32_t received;
+  uint32_t out_of_order;
+  uint32_t next_seq;
+  // Number of messages the publisher says it sent, 0 until the run ends
+  uint32_t expected;
+  uint64_t bytes;
+  uint64_t first_rx_us;
+  uint64_t last_rx_us;
+  latencyHistogram_t latency;
+} stress_bench_source_t;
+
+typedef struct {
+  bool running;
+  uint16_t num_topics;
+  SemaphoreHandle_t lock;
+  stress_bench_source_t *sources[BENCH_MAX_SOURCES];
+} stress_bench_sub_t;
+
 typedef struct {
     struct netif* netif;
     struct udp_pcb* pcb;
@@ -50,6 +132,10 @@ typedef enum {
   STRESS_EVT_TX,
   // Print out stress stats
   STRESS_EVT_STATS,
+  // Publish benchmark messages
+  STRESS_EVT_BENCH_TX,
+  // Stop the benchmark publisher
+  STRESS_EVT_BENCH_STOP,
 } stress_evt_type_e;
 
 typedef struct {
@@ -58,19 +144,26 @@ typedef struct {
 } stress_test_queue_item_t;
 
 static stress_test_ctx_t _ctx;
+static stress_bench_pub_t _bench_pub;
+static stress_bench_sub_t _bench_sub;
 static void stress_test_task( void *parameters );
 static void stress_test_rx_cb(void *arg, struct udp_pcb *upcb, struct pbuf *buf, const ip_addr_t *addr, u16_t port);
 
 static BaseType_t cmd_stress_fn( char *writeBuffer,
                                   size_t writeBufferLen,
                                   const char *commandString);
+static void cmd_stress_bench(const char *commandString);
 
 static const CLI_Command_Definition_t cmd_stress = {
   // Command string
   "stress",
   // Help string
   "stress start <speed in Mbps (1-8)>\n"
-  "stress stop\n",
+  "stress stop\n"
+  "stress bench pub <payload bytes> <rate Hz> <topics> <duration s>\n"
+  "stress bench sub <topics>\n"
+  "stress bench report\n"
+  "stress bench stop\n",
   // Command function
   cmd_stress_fn,
   // Number of parameters
@@ -78,6 +171,55 @@ static const CLI_Command_Definition_t cmd_stress = {
 };
 
 
+// Get numeric CLI parameter, returns false if missing
+static bool cmd_get_uint(const char *commandString, UBaseType_t idx, uint32_t *value) {
+  BaseType_t len = 0;
+  const char *str = FreeRTOS_CLIGetParameter(commandString, idx, &len);
+  if(!str || !len) {
+    return false;
+  }
+  *value = strtoul(str, NULL, 10);
+  return true;
+}
+
+static void cmd_stress_bench(const char *commandString) {
+  BaseType_t len = 0;
+  const char *command = FreeRTOS_CLIGetParameter(commandString, 2, &len);
+
+  if(!command) {
+    printf("Invalid arguments\n");
+  } else if(strncmp("pub", command, len) == 0) {
+    uint32_t payload_len, rate_hz, num_topics, duration_s;
+    if(cmd_get_uint(commandString, 3, &payload_len) &&
+       cmd_get_uint(commandString, 4, &rate_hz) &&
+       cmd_get_uint(commandString, 5, &num_topics) &&
+       cmd_get_uint(commandString, 6, &duration_s)) {
+      stress_bench_pub_cfg_t cfg = {
+        .payload_len = payload_len,
+        .rate_hz = rate_hz,
+        .num_topics = num_topics,
+        .duration_s = duration_s,
+      };
+      if(!stress_bench_pub_start(&cfg)) {
+        printf("Unable to start benchmark\n");
+      }
+    } else {
+      printf("Invalid arguments\n");
+    }
+  } else if(strncmp("sub", command, len) == 0) {
+    uint32_t num_topics;
+    if(!cmd_get_uint(commandString, 3, &num_topics) || !stress_bench_sub_start(num_topics)) {
+      printf("Unable to start benchmark subscriber\n");
+    }
+  } else if(strncmp("report", command, len) == 0) {
+    stress_bench_report();
+  } else if(strncmp("stop", command, len) == 0) {
+    stress_bench_stop();
+  } else {
+    printf("Invalid arguments\n");
+  }
+}
+
 static BaseType_t cmd_stress_fn(char *writeBuffer,
                             size_t writeBufferLen,
                             const char *commandString) {
@@ -112,6 +254,8 @@ static BaseType_t cmd_stress_fn(char *writeBuffer,
       stress_start_tx((mbps * 1024)/8);
     } else if(strncmp("stop", command, command_str_len) == 0) {
       stress_stop_tx();
+    } else if(strncmp("bench", command, command_str_len) == 0) {
+      cmd_stress_bench(commandString);
     } else {
       printf("Invalid arguments\n");
     }
@@ -140,6 +284,9 @@ void stress_test_init(struct netif* netif, uint16_t port) {
   _ctx.evt_queue = xQueueCreate(STRESS_QUEUE_LEN, sizeof(stress_test_queue_item_t));
   configASSERT(_ctx.evt_queue);
 
+  _bench_sub.lock = xSemaphoreCreateMutex();
+  configASSERT(_bench_sub.lock);
+
   FreeRTOS_CLIRegisterCommand( &cmd_stress );
 
   rval = xTaskCreate(
@@ -231,7 +378,7 @@ void _print_adin_port_stats(adin2111_DeviceHandle_t device_handle, adin2111_Port
   configASSERT(stats);
 
   // Get the overall system port as an argument, since port is just the adin port
-  uint32_t sys_port = (uint32_t)args;
+  uint32_t sys_port = (uint32_t)(uintptr_t)args;
   (void)port;
   printf("PORT %"PRIu32"\n", sys_port);
   printf("MSE_VAL:            %u\n", stats->mse_link_quality.mseVal);
@@ -286,10 +433,10 @@ void stress_print_stats() {
     // Request both ports (if they're enabled)
     // The info will be printed on the callback funcion (if it is called)
     if(bm_l2_get_port_state(start_port_idx)) {
-      adin2111_get_port_stats(adin_handle, ADIN2111_PORT_1, _print_adin_port_stats, (void *)(start_port_idx));
+      adin2111_get_port_stats(adin_handle, ADIN2111_PORT_1, _print_adin_port_stats, (void *)(uintptr_t)(start_port_idx));
     }
     if(bm_l2_get_port_state(start_port_idx + 1)) {
-      adin2111_get_port_stats(adin_handle, ADIN2111_PORT_2, _print_adin_port_stats, (void *)(start_port_idx + 1));
+      adin2111_get_port_stats(adin_handle, ADIN2111_PORT_2, _print_adin_port_stats, (void *)(uintptr_t)(start_port_idx + 1));
     }
   }
 }
@@ -326,7 +473,12 @@ static void stress_timer_handler(TimerHandle_t tmr){
 
   stress_test_queue_item_t item = {evt_type, NULL};
 
-  configASSERT(xQueueSend(_ctx.evt_queue, &item, 0) == pdTRUE);
+  if(evt_type == STRESS_EVT_BENCH_TX) {
+    // Fine to skip a tick if we're behind, the next one catches up
+    xQueueSend(_ctx.evt_queue, &item, 0);
+  } else {
+    configASSERT(xQueueSend(_ctx.evt_queue, &item, 0) == pdTRUE);
+  }
 }
 
 // Start stress test with buffer size tx_len
@@ -346,6 +498,431 @@ void stress_stop_tx() {
   configASSERT(xTimerStop(_ctx.stats_timer, 10));
 }
 
+/*!
+  Benchmark clock. Uses the RTC when it's set, since that's synchronized
+  across the network and lets receivers compute one-way latency.
+
+  \param[out] *is_rtc - true if time came from the RTC
+  \return time in microseconds
+*/
+static uint64_t stress_bench_time_us(bool *is_rtc) {
+  RTCTimeAndDate_t time_and_date;
+  if(isRTCSet() && (rtcGet(&time_and_date) == pdPASS)) {
+    *is_rtc = true;
+    return rtcGetMicroSeconds(&time_and_date);
+  }
+
+  *is_rtc = false;
+  return uptimeGetMicroSeconds();
+}
+
+/*!
+  Print machine readable benchmark record for a publisher run
+
+  \return none
+*/
+static void stress_bench_print_pub(void) {
+  uint32_t duration_ms = pdTICKS_TO_MS(xTaskGetTickCount() - _bench_pub.start_ticks);
+  uint64_t throughput_bps = duration_ms ? (_bench_pub.bytes * 8 * 1000) / duration_ms : 0;
+  printf("BENCH {\"role\":\"pub\",\"node\":\"%016" PRIx64 "\",\"run\":%" PRIu32
+         ",\"payload\":%u,\"topics\":%u,\"rate_hz\":%" PRIu32 ",\"duration_ms\":%" PRIu32
+         ",\"attempted\":%" PRIu32 ",\"sent\":%" PRIu32 ",\"failed\":%" PRIu32
+         ",\"throughput_bps\":%" PRIu64 "}\n",
+         getNodeId(), _bench_pub.run_id,
+         _bench_pub.cfg.payload_len, _bench_pub.cfg.num_topics, _bench_pub.cfg.rate_hz, duration_ms,
+         _bench_pub.attempted, _bench_pub.sent, _bench_pub.failed,
+         throughput_bps);
+}
+
+/*!
+  Print machine readable benchmark record for messages received from one publisher
+
+  \param[in] *src - source to print
+  \return none
+*/
+static void stress_bench_print_source(const stress_bench_source_t *src) {
+  uint64_t duration_us = src->last_rx_us - src->first_rx_us;
+  uint64_t throughput_bps = duration_us ? (src->bytes * 8 * 1000000) / duration_us : 0;
+
+  // Use the publisher's count if we have it, otherwise assume everything up
+  // to the last sequence number we saw was sent
+  uint32_t expected = src->expected ? src->expected : src->next_seq;
+  uint32_t dropped = (expected > src->received) ? (expected - src->received) : 0;
+
+  printf("BENCH {\"role\":\"sub\",\"node\":\"%016" PRIx64 "\",\"src\":\"%016" PRIx64 "\",\"run\":%" PRIu32
+         ",\"payload\":%u,\"complete\":%s,\"expected\":%" PRIu32 ",\"received\":%" PRIu32
+         ",\"dropped\":%" PRIu32 ",\"out_of_order\":%" PRIu32 ",\"duration_ms\":%" PRIu32
+         ",\"throughput_bps\":%" PRIu64 ",\"latency_us\":{\"samples\":%" PRIu32 ",\"p50\":%" PRIu32
+         ",\"p99\":%" PRIu32 ",\"max\":%" PRIu32 ",\"mean\":%" PRIu32 "}}\n",
+         getNodeId(), src->node_id, src->run_id,
+         src->payload_len, src->done ? "true" : "false", expected, src->received,
+         dropped, src->out_of_order, (uint32_t)(duration_us / 1000),
+         throughput_bps, src->latency.count,
+         latencyHistogramPercentile(&src->latency, 50),
+         latencyHistogramPercentile(&src->latency, 99),
+         src->latency.max,
+         latencyHistogramMean(&src->latency));
+}
+
+/*!
+  Find (or allocate) benchmark source. Must be called with _bench_sub.lock held
+
+  \param[in] node_id - publisher node id
+  \param[in] run_id - publisher run id
+  \return pointer to source, NULL if we're out of sources
+*/
+static stress_bench_source_t *stress_bench_get_source(uint64_t node_id, uint32_t run_id) {
+  int16_t free_idx = -1;
+
+  for(uint8_t idx = 0; idx < BENCH_MAX_SOURCES; idx++) {
+    stress_bench_source_t *src = _bench_sub.sources[idx];
+    if(!src) {
+      if(free_idx < 0) {
+        free_idx = idx;
+      }
+      continue;
+    }
+
+    if(src->node_id == node_id) {
+      if(src->run_id == run_id) {
+        return src;
+      }
+
+      // New run from the same publisher, report the old one and start over
+      if(!src->done) {
+        stress_bench_print_source(src);
+      }
+      memset(src, 0, sizeof(stress_bench_source_t));
+      src->node_id = node_id;
+      src->run_id = run_id;
+      latencyHistogramReset(&src->latency);
+      return src;
+    }
+  }
+
+  if(free_idx < 0) {
+    return NULL;
+  }
+
+  stress_bench_source_t *src = (stress_bench_source_t *)pvPortMalloc(sizeof(stress_bench_source_t));
+  if(src) {
+    memset(src, 0, sizeof(stress_bench_source_t));
+    src->node_id = node_id;
+    src->run_id = run_id;
+    latencyHistogramReset(&src->latency);
+    _bench_sub.sources[free_idx] = src;
+  }
+
+  return src;
+}
+
+/*!
+  Benchmark subscription callback (runs in middleware task)
+*/
+static void stress_bench_sub_cb(uint64_t node_id, const char* topic, uint16_t topic_len, const uint8_t* data, uint16_t data_len) {
+  bool rx_is_rtc;
+  uint64_t rx_time_us = stress_bench_time_us(&rx_is_rtc);
+  uint64_t rx_uptime_us = uptimeGetMicroSeconds();
+
+  configASSERT(xSemaphoreTake(_bench_sub.lock, portMAX_DELAY) == pdTRUE);
+
+  do {
+    if(!_bench_sub.running) {
+      break;
+    }
+
+    if((topic_len == strlen(BENCH_CTL_TOPIC)) && (strncmp(topic, BENCH_CTL_TOPIC, topic_len) == 0)) {
+      stress_bench_end_t end;
+      if(data_len < sizeof(end)) {
+        break;
+      }
+      memcpy(&end, data, sizeof(end));
+      if(end.magic != BENCH_MAGIC) {
+        break;
+      }
+
+      stress_bench_source_t *src = stress_bench_get_source(node_id, end.run_id);
+      if(src && !src->done) {
+        src->expected = end.sent;
+        src->done = true;
+        stress_bench_print_source(src);
+      }
+      break;
+    }
+
+    stress_bench_hdr_t hdr;
+    if(data_len < sizeof(hdr)) {
+      break;
+    }
+    memcpy(&hdr, data, sizeof(hdr));
+    if(hdr.magic != BENCH_MAGIC) {
+      break;
+    }
+
+    stress_bench_source_t *src = stress_bench_get_source(node_id, hdr.run_id);
+    if(!src || src->done) {
+      break;
+    }
+
+    if(src->received == 0) {
+      src->first_rx_us = rx_uptime_us;
+      src->payload_len = hdr.payload_len;
+    }
+    src->last_rx_us = rx_uptime_us;
+    src->received++;
+    src->bytes += data_len;
+
+    if(hdr.seq < src->next_seq) {
+      src->out_of_order++;
+    } else {
+      src->next_seq = hdr.seq + 1;
+    }
+
+    // Only meaningful if both ends share a clock
+    if(rx_is_rtc && (hdr.flags & BENCH_FLAG_RTC_TIME)) {
+      uint64_t latency_us = (rx_time_us > hdr.tx_time_us) ? (rx_time_us - hdr.tx_time_us) : 0;
+      latencyHistogramAdd(&src->latency, (latency_us > UINT32_MAX) ? UINT32_MAX : (uint32_t)latency_us);
+    }
+  } while(0);
+
+  xSemaphoreGive(_bench_sub.lock);
+}
+
+/*!
+  Start benchmark subscriber. Subscribes to bench/0 through bench/<num_topics - 1>
+  and reports a BENCH record for each publisher run it receives.
+
+  \param[in] num_topics - number of topics to subscribe to
+  \return true if successful, false otherwise
+*/
+bool stress_bench_sub_start(uint16_t num_topics) {
+  bool rval = false;
+
+  do {
+    if(!num_topics || (num_topics > BENCH_MAX_TOPICS) || _bench_sub.running) {
+      break;
+    }
+
+    char topic[BENCH_TOPIC_MAX_LEN];
+    for(uint16_t idx = 0; idx < num_topics; idx++) {
+      snprintf(topic, sizeof(topic), BENCH_TOPIC_FMT, idx);
+      configASSERT(bm_sub(topic, stress_bench_sub_cb));
+    }
+    configASSERT(bm_sub(BENCH_CTL_TOPIC, stress_bench_sub_cb));
+
+    configASSERT(xSemaphoreTake(_bench_sub.lock, portMAX_DELAY) == pdTRUE);
+    _bench_sub.num_topics = num_topics;
+    _bench_sub.running = true;
+    xSemaphoreGive(_bench_sub.lock);
+
+    printf("Benchmark subscriber started (%u topics)\n", num_topics);
+    rval = true;
+  } while(0);
+
+  return rval;
+}
+
+/*!
+  Start benchmark publisher. Publishes cfg->rate_hz messages per second,
+  round robin across topics, for cfg->duration_s seconds.
+
+  \param[in] *cfg - benchmark configuration
+  \return true if successful, false otherwise
+*/
+bool stress_bench_pub_start(const stress_bench_pub_cfg_t *cfg) {
+  configASSERT(cfg);
+  bool rval = false;
+
+  do {
+    if(_bench_pub.running) {
+      printf("Benchmark already running\n");
+      break;
+    }
+
+    if((cfg->payload_len < sizeof(stress_bench_hdr_t)) || (cfg->payload_len > BENCH_MAX_PAYLOAD)) {
+      printf("Payload must be between %u and %u bytes\n", (unsigned)sizeof(stress_bench_hdr_t), BENCH_MAX_PAYLOAD);
+      break;
+    }
+
+    if(!cfg->rate_hz || (cfg->rate_hz > BENCH_MAX_RATE_HZ) ||
+       !cfg->num_topics || (cfg->num_topics > BENCH_MAX_TOPICS) || !cfg->duration_s) {
+      printf("Invalid benchmark configuration\n");
+      break;
+    }
+
+    _bench_pub.buf = (uint8_t *)pvPortMalloc(cfg->payload_len);
+    if(!_bench_pub.buf) {
+      break;
+    }
+    // Filler so payloads aren't all zeros
+    for(uint16_t idx = 0; idx < cfg->payload_len; idx++) {
+      _bench_pub.buf[idx] = (uint8_t)idx;
+    }
+
+    memcpy(&_bench_pub.cfg, cfg, sizeof(stress_bench_pub_cfg_t));
+    _bench_pub.run_id = (uint32_t)(uptimeGetMicroSeconds() ^ getNodeId());
+    _bench_pub.attempted = 0;
+    _bench_pub.sent = 0;
+    _bench_pub.failed = 0;
+    _bench_pub.bytes = 0;
+    _bench_pub.start_ticks = xTaskGetTickCount();
+    _bench_pub.running = true;
+
+    configASSERT(xTimerStart(_bench_pub.timer, 10));
+    printf("Benchmark publisher started (run %" PRIu32 ")\n", _bench_pub.run_id);
+    rval = true;
+  } while(0);
+
+  return rval;
+}
+
+/*!
+  End the current publisher run. Lets subscribers know how many messages
+  were sent so they can compute drops.
+
+  \return none
+*/
+static void stress_bench_pub_end(void) {
+  configASSERT(xTimerStop(_bench_pub.timer, 10));
+
+  stress_bench_end_t end = {
+    .magic = BENCH_MAGIC,
+    .run_id = _bench_pub.run_id,
+    .sent = _bench_pub.sent,
+    .duration_ms = pdTICKS_TO_MS(xTaskGetTickCount() - _bench_pub.start_ticks),
+  };
+
+  // Give the last messages a chance to make it out before the end marker
+  vTaskDelay(pdMS_TO_TICKS(100));
+  for(uint8_t idx = 0; idx < BENCH_END_REPEAT; idx++) {
+    bm_pub(BENCH_CTL_TOPIC, &end, sizeof(end));
+  }
+
+  stress_bench_print_pub();
+
+  vPortFree(_bench_pub.buf);
+  _bench_pub.buf = NULL;
+  _bench_pub.running = false;
+}
+
+/*!
+  Stop the current publisher run early, without an end marker (runs in
+  stress task, so it can't free the buffer while a publish is using it)
+
+  \return none
+*/
+static void stress_bench_pub_stop(void) {
+  if(!_bench_pub.running) {
+    return;
+  }
+
+  configASSERT(xTimerStop(_bench_pub.timer, 10));
+  stress_bench_print_pub();
+  vPortFree(_bench_pub.buf);
+  _bench_pub.buf = NULL;
+  _bench_pub.running = false;
+}
+
+/*!
+  Publish however many benchmark messages are due (runs in stress task)
+
+  \return none
+*/
+static void stress_bench_tx(void) {
+  if(!_bench_pub.running) {
+    return;
+  }
+
+  uint32_t elapsed_ms = pdTICKS_TO_MS(xTaskGetTickCount() - _bench_pub.start_ticks);
+  if(elapsed_ms >= (_bench_pub.cfg.duration_s * 1000)) {
+    stress_bench_pub_end();
+    return;
+  }
+
+  uint32_t due = (uint32_t)(((uint64_t)_bench_pub.cfg.rate_hz * elapsed_ms) / 1000) + 1;
+  uint32_t burst = 0;
+  while((_bench_pub.attempted < due) && (burst++ < BENCH_MAX_BURST)) {
+    char topic[BENCH_TOPIC_MAX_LEN];
+    uint8_t topic_idx = _bench_pub.attempted % _bench_pub.cfg.num_topics;
+    snprintf(topic, sizeof(topic), BENCH_TOPIC_FMT, topic_idx);
+
+    bool is_rtc;
+    stress_bench_hdr_t hdr = {
+      .magic = BENCH_MAGIC,
+      .run_id = _bench_pub.run_id,
+      .seq = _bench_pub.attempted,
+      .tx_time_us = stress_bench_time_us(&is_rtc),
+      .flags = 0,
+      .topic_idx = topic_idx,
+      .payload_len = _bench_pub.cfg.payload_len,
+    };
+    if(is_rtc) {
+      hdr.flags |= BENCH_FLAG_RTC_TIME;
+    }
+    memcpy(_bench_pub.buf, &hdr, sizeof(hdr));
+
+    _bench_pub.attempted++;
+    if(bm_pub(topic, _bench_pub.buf, _bench_pub.cfg.payload_len)) {
+      _bench_pub.sent++;
+      _bench_pub.bytes += _bench_pub.cfg.payload_len;
+    } else {
+      _bench_pub.failed++;
+    }
+  }
+}
+
+/*!
+  Print BENCH records for all publishers we've received from so far
+
+  \return none
+*/
+void stress_bench_report(void) {
+  configASSERT(xSemaphoreTake(_bench_sub.lock, portMAX_DELAY) == pdTRUE);
+  for(uint8_t idx = 0; idx < BENCH_MAX_SOURCES; idx++) {
+    if(_bench_sub.sources[idx]) {
+      stress_bench_print_source(_bench_sub.sources[idx]);
+    }
+  }
+  xSemaphoreGive(_bench_sub.lock);
+
+  if(_bench_pub.running) {
+    stress_bench_print_pub();
+  }
+}
+
+/*!
+  Stop benchmark publisher/subscriber and clear results
+
+  \return none
+*/
+void stress_bench_stop(void) {
+  if(_bench_pub.running) {
+    // The stress task owns the publisher, let it stop. Any BENCH_TX events
+    // queued behind this one find it stopped.
+    stress_test_queue_item_t item = {STRESS_EVT_BENCH_STOP, NULL};
+    configASSERT(xQueueSend(_ctx.evt_queue, &item, portMAX_DELAY) == pdTRUE);
+  }
+
+  if(_bench_sub.running) {
+    char topic[BENCH_TOPIC_MAX_LEN];
+    for(uint16_t idx = 0; idx < _bench_sub.num_topics; idx++) {
+      snprintf(topic, sizeof(topic), BENCH_TOPIC_FMT, idx);
+      bm_unsub(topic, stress_bench_sub_cb);
+    }
+    bm_unsub(BENCH_CTL_TOPIC, stress_bench_sub_cb);
+
+    configASSERT(xSemaphoreTake(_bench_sub.lock, portMAX_DELAY) == pdTRUE);
+    _bench_sub.running = false;
+    for(uint8_t idx = 0; idx < BENCH_MAX_SOURCES; idx++) {
+      if(_bench_sub.sources[idx]) {
+        vPortFree(_bench_sub.sources[idx]);
+        _bench_sub.sources[idx] = NULL;
+      }
+    }
+    xSemaphoreGive(_bench_sub.lock);
+  }
+}
+
 /*!
   Stress test task. Will receive stress test packets in queue from
   stress_test_rx_cb and process them. Will also handle tx events, stats
@@ -367,6 +944,9 @@ static void stress_test_task( void *parameters ) {
   _ctx.stats_timer = xTimerCreate("stats_timer", pdMS_TO_TICKS(STATS_TIMER_S * 1000), pdTRUE, (void *)STRESS_EVT_STATS, stress_timer_handler);
   configASSERT(_ctx.stats_timer);
 
+  _bench_pub.timer = xTimerCreate("bench_timer", pdMS_TO_TICKS(BENCH_TX_TIMER_MS), pdTRUE, (void *)STRESS_EVT_BENCH_TX, stress_timer_handler);
+  configASSERT(_bench_pub.timer);
+
   for(;;) {
     stress_test_queue_item_t item;
 
@@ -389,6 +969,15 @@ static void stress_test_task( void *parameters ) {
         stress_print_stats();
         break;
       }
+
+      case STRESS_EVT_BENCH_TX: {
+        stress_bench_tx();
+        break;
+      }
+      case STRESS_EVT_BENCH_STOP: {
+        stress_bench_pub_stop();
+        break;
+      }
       default: {
         configASSERT(0);
       }
@@ -1,5 +1,6 @@
 #pragma once
 
+#include <stdbool.h>
 #include <stdint.h>
 #include "lwip/netif.h"
 
@@ -11,6 +12,21 @@ void stress_test_init(struct netif* netif, uint16_t port);
 void stress_start_tx(uint32_t tx_len);
 void stress_stop_tx();
 
+typedef struct {
+  // Total message size, including benchmark header
+  uint16_t payload_len;
+  // Messages per second (across all topics)
+  uint32_t rate_hz;
+  // Messages are published round robin on bench/0..bench/<num_topics - 1>
+  uint16_t num_topics;
+  uint32_t duration_s;
+} stress_bench_pub_cfg_t;
+
+bool stress_bench_pub_start(const stress_bench_pub_cfg_t *cfg);
+bool stress_bench_sub_start(uint16_t num_topics);
+void stress_bench_report(void);
+void stress_bench_stop(void);
+
 #ifdef __cplusplus
 }
 #endif
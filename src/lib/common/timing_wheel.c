@@ -0,0 +1,185 @@
+#include <stddef.h>
+#include <string.h>
+#include "timing_wheel.h"
+
+/// a is before b (handles tick counter wrap around)
+#define TIME_BEFORE(a, b) ((int32_t)((uint32_t)(a) - (uint32_t)(b)) < 0)
+
+static inline uint32_t slotIndex(const timingWheel_t *wheel, uint32_t time) {
+  return (time / wheel->resolution) & (TIMING_WHEEL_SLOTS - 1);
+}
+
+/*!
+  Initialize timing wheel
+
+  \param[out] *wheel - wheel to initialize
+  \param[in] resolution - ticks per slot
+  \param[in] now - current time (ticks)
+  \return none
+*/
+void timingWheelInit(timingWheel_t *wheel, uint32_t resolution, uint32_t now) {
+  memset(wheel, 0, sizeof(timingWheel_t));
+  wheel->resolution = (resolution > 0) ? resolution : 1;
+  wheel->time = now;
+}
+
+/*!
+  Schedule an entry. Entries already scheduled are moved.
+
+  \param[in] *wheel - timing wheel
+  \param[in] *entry - entry to schedule (entry->jitter must be set)
+  \param[in] due - absolute due time (ticks)
+  \return none
+*/
+void timingWheelInsert(timingWheel_t *wheel, timingWheelEntry_t *entry, uint32_t due) {
+  if(entry->scheduled) {
+    timingWheelRemove(wheel, entry);
+  }
+
+  entry->due = due;
+  entry->scheduled = true;
+
+  if(entry->jitter > wheel->maxJitter) {
+    wheel->maxJitter = entry->jitter;
+  }
+
+  // Overdue entries go in the current slot so the next expire finds them
+  uint32_t slot = slotIndex(wheel, TIME_BEFORE(due, wheel->time) ? wheel->time : due);
+  entry->next = wheel->slots[slot];
+  wheel->slots[slot] = entry;
+}
+
+/*!
+  Remove an entry from the wheel (if scheduled)
+
+  \param[in] *wheel - timing wheel
+  \param[in] *entry - entry to remove
+  \return none
+*/
+void timingWheelRemove(timingWheel_t *wheel, timingWheelEntry_t *entry) {
+  if(!entry->scheduled) {
+    return;
+  }
+
+  // Entry could be in its due slot or in the slot that was current when
+  // it was inserted (if it was overdue), so check them all
+  for(uint32_t slot = 0; slot < TIMING_WHEEL_SLOTS; slot++) {
+    for(timingWheelEntry_t **item = &wheel->slots[slot]; *item != NULL; item = &(*item)->next) {
+      if(*item == entry) {
+        *item = entry->next;
+        entry->next = NULL;
+        entry->scheduled = false;
+        return;
+      }
+    }
+  }
+}
+
+/*!
+  Remove and return all entries that are due (or within their jitter
+  budget of being due).
+
+  \param[in] *wheel - timing wheel
+  \param[in] now - current time (ticks)
+  \return list of expired entries (linked with ->next), NULL if none
+*/
+timingWheelEntry_t *timingWheelExpire(timingWheel_t *wheel, uint32_t now) {
+  timingWheelEntry_t *expired = NULL;
+
+  // Only the slots between the last expire and now (plus the largest
+  // jitter budget) can have entries that are ready
+  uint32_t numSlots = TIMING_WHEEL_SLOTS;
+  if(!TIME_BEFORE(now, wheel->time)) {
+    uint32_t span = (now - wheel->time) + wheel->maxJitter;
+    if(span / wheel->resolution + 2 < TIMING_WHEEL_SLOTS) {
+      numSlots = span / wheel->resolution + 2;
+    }
+  }
+
+  uint32_t slot = slotIndex(wheel, wheel->time);
+  for(uint32_t count = 0; count < numSlots; count++) {
+    timingWheelEntry_t **item = &wheel->slots[slot];
+    while(*item != NULL) {
+      timingWheelEntry_t *entry = *item;
+      if(!TIME_BEFORE(now, entry->due - entry->jitter)) {
+        *item = entry->next;
+        entry->scheduled = false;
+        entry->next = expired;
+        expired = entry;
+      } else {
+        item = &entry->next;
+      }
+    }
+    slot = (slot + 1) & (TIMING_WHEEL_SLOTS - 1);
+  }
+
+  wheel->time = now;
+
+  return expired;
+}
+
+/*!
+  Get the earliest due time of all scheduled entries
+
+  \param[in] *wheel - timing wheel
+  \param[out] *due - earliest due time
+  \return true if there are any entries scheduled, false otherwise
+*/
+bool timingWheelNext(const timingWheel_t *wheel, uint32_t *due) {
+  bool found = false;
+  uint32_t earliest = 0;
+
+  // Walk the slots in time order. The first slot with an entry due in
+  // this revolution has the earliest entry.
+  uint32_t slot = slotIndex(wheel, wheel->time);
+  uint32_t slotEnd = wheel->time - (wheel->time % wheel->resolution) + wheel->resolution;
+  for(uint32_t count = 0; count < TIMING_WHEEL_SLOTS; count++) {
+    for(const timingWheelEntry_t *entry = wheel->slots[slot]; entry != NULL; entry = entry->next) {
+      if(TIME_BEFORE(entry->due, slotEnd) && (!found || TIME_BEFORE(entry->due, earliest))) {
+        earliest = entry->due;
+        found = true;
+      }
+    }
+
+    if(found) {
+      *due = earliest;
+      return true;
+    }
+
+    slot = (slot + 1) & (TIMING_WHEEL_SLOTS - 1);
+    slotEnd += wheel->resolution;
+  }
+
+  // Nothing due within a revolution, check everything
+  for(slot = 0; slot < TIMING_WHEEL_SLOTS; slot++) {
+    for(const timingWheelEntry_t *entry = wheel->slots[slot]; entry != NULL; entry = entry->next) {
+      if(!found || TIME_BEFORE(entry->due, earliest)) {
+        earliest = entry->due;
+        found = true;
+      }
+    }
+  }
+
+  if(found) {
+    *due = earliest;
+  }
+
+  return found;
+}
+
+/*!
+  Get the next multiple of period after now. Scheduling periodic entries
+  on multiples of their period lines up entries with the same (or
+  harmonic) periods so they expire together.
+
+  \param[in] now - current time (ticks)
+  \param[in] period - period (ticks)
+  \return aligned due time
+*/
+uint32_t timingWheelAlign(uint32_t now, uint32_t period) {
+  if(period == 0) {
+    return now;
+  }
+
+  return now - (now % period) + period;
+}
@@ -0,0 +1,57 @@
+#pragma once
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+//
+// Hashed timing wheel.
+//
+// Entries are hashed into TIMING_WHEEL_SLOTS buckets by their due time
+// (in ticks, each slot covers `resolution` ticks), so expiring entries only
+// looks at the slots that elapsed instead of at every entry. Times wrap
+// around with the tick counter and are always compared with signed
+// differences.
+//
+// Each entry has a jitter budget: it may expire up to that many ticks
+// early, so entries with nearby due times are handed out together (and
+// the caller only has to wake up once).
+//
+// Entries are owned by the caller. Not thread safe.
+//
+#define TIMING_WHEEL_SLOTS (64)
+
+typedef struct timingWheelEntry {
+  struct timingWheelEntry *next;
+  /// Absolute due time (ticks)
+  uint32_t due;
+  /// Entry may expire this many ticks before it is due
+  uint32_t jitter;
+  /// Owner data
+  void *context;
+  bool scheduled;
+} timingWheelEntry_t;
+
+typedef struct {
+  timingWheelEntry_t *slots[TIMING_WHEEL_SLOTS];
+  /// Ticks per slot
+  uint32_t resolution;
+  /// Last time entries were expired
+  uint32_t time;
+  /// Largest jitter of any entry ever inserted
+  uint32_t maxJitter;
+} timingWheel_t;
+
+void timingWheelInit(timingWheel_t *wheel, uint32_t resolution, uint32_t now);
+void timingWheelInsert(timingWheel_t *wheel, timingWheelEntry_t *entry, uint32_t due);
+void timingWheelRemove(timingWheel_t *wheel, timingWheelEntry_t *entry);
+timingWheelEntry_t *timingWheelExpire(timingWheel_t *wheel, uint32_t now);
+bool timingWheelNext(const timingWheel_t *wheel, uint32_t *due);
+uint32_t timingWheelAlign(uint32_t now, uint32_t period);
+
+#ifdef __cplusplus
+}
+#endif
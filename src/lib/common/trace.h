@@ -10,7 +10,7 @@
 
 #ifdef TRACE_USE_COREDEBUG
 // TODO - figure out how to make processor independent
-#include "stm32l496xx.h"
+#include "stm32u5xx.h"
 #endif
 
 // TODO - allow overriding by application
@@ -35,6 +35,26 @@ typedef enum traceEventType {
   kTraceEventSDReadStop,
   kTraceEventSDReadErr,
   kTraceEventSerialByte,
+  // Packet path events (see tracePacket below). arg is the packet id
+  // RX path
+  kTraceEventPktAdinRxDone,       // ADIN SPI rx chunk done, id is the adin rx buffer
+  kTraceEventPktAdinRxDequeue,    // ADIN thread picked up rx buffer
+  kTraceEventPktL2Rx,             // bm_l2_rx copied frame into pbuf, id is the pbuf from here on
+  kTraceEventPktL2RxDequeue,      // L2 thread picked up rx pbuf
+  kTraceEventPktLwipInput,        // lwIP ip6_input
+  kTraceEventPktBcmpEnqueue,      // BCMP rx queue send
+  kTraceEventPktBcmpDequeue,      // BCMP thread picked up packet
+  kTraceEventPktMwEnqueue,        // Middleware net queue send
+  kTraceEventPktMwDequeue,        // Middleware thread picked up packet
+  kTraceEventPktSubCbStart,       // Subscriber callback start
+  kTraceEventPktSubCbEnd,         // Subscriber callback end
+  // TX path
+  kTraceEventPktMwTx,             // Middleware publish, id is the pbuf
+  kTraceEventPktL2Tx,             // L2 tx queue send
+  kTraceEventPktL2TxDequeue,      // L2 thread picked up tx pbuf
+  kTraceEventPktAdinTxEnqueue,    // ADIN tx queue send, id is the adin tx buffer from here on
+  kTraceEventPktAdinTxSubmit,     // ADIN thread submitted tx buffer
+  kTraceEventPktAdinTxDone,       // ADIN SPI tx done
   kTraceEventMax
 } traceEventType_t;
 
@@ -53,7 +73,7 @@ extern uint32_t traceEventIdx;
 
 #ifdef TRACE_USE_COREDEBUG
 // Switch between arm trace counter and tickCount if needed!
-inline uint32_t traceGetCount() {
+__STATIC_FORCEINLINE uint32_t traceGetCount() {
   return DWT->CYCCNT;
 }
 #else
@@ -119,3 +139,16 @@ void NAME##_trace() { \
 #endif
 
 #endif // TRACE_ENABLE
+
+//
+// Packet path tracing
+// Build with TRACE_ENABLE, TRACE_PACKETS and TRACE_USE_COREDEBUG (and a larger
+// TRACE_BUFF_LEN) to record every hop a packet takes between the ADIN and the
+// subscriber callbacks. The packet id is the buffer pointer at each layer.
+// Decode with tools/scripts/misc/pkt_trace.py
+//
+#if defined(TRACE_ENABLE) && defined(TRACE_PACKETS)
+#define tracePacket(EVENT, ID) traceAdd(EVENT, (void *)(ID))
+#else
+#define tracePacket(EVENT, ID) do { (void)(ID); } while(0)
+#endif
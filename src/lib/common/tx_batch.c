@@ -0,0 +1,148 @@
+#include <string.h>
+#include "FreeRTOS.h"
+#include "tx_batch.h"
+
+/*!
+  Initialize transmit batcher
+
+  \param[out] *batch - batcher to initialize
+  \param[in] capacity - largest batch (bytes)
+  \param[in] threshold - flush as soon as the batch is this large (bytes)
+  \param[in] flushFn - function that sends a batch (takes ownership of the buffer)
+  \param[in] *ctx - flushFn context
+  \return none
+*/
+void txBatchInit(txBatch_t *batch, size_t capacity, size_t threshold, txBatchFlushFn_t flushFn, void *ctx) {
+  configASSERT(batch != NULL);
+  configASSERT(capacity > 0);
+  configASSERT(threshold > 0 && threshold <= capacity);
+  configASSERT(flushFn != NULL);
+
+  memset(batch, 0, sizeof(txBatch_t));
+  batch->capacity = capacity;
+  batch->threshold = threshold;
+  batch->flushFn = flushFn;
+  batch->ctx = ctx;
+}
+
+/*!
+  Get space for the next frame. If the frame doesn't fit after the frames
+  already in the batch, they are flushed first.
+
+  \param[in] *batch - transmit batcher
+  \param[in] len - largest number of bytes the frame can take
+  \return pointer to write the frame to, NULL if len is larger than a batch
+          or the buffer can't be allocated
+*/
+uint8_t *txBatchReserve(txBatch_t *batch, size_t len) {
+  configASSERT(batch != NULL);
+
+  if(len > batch->capacity) {
+    perfCounterInc(&batch->drops);
+    return NULL;
+  }
+
+  if((batch->len + len) > batch->capacity) {
+    txBatchFlush(batch);
+  }
+
+  if(batch->buff == NULL) {
+    batch->buff = (uint8_t *)pvPortMalloc(batch->capacity);
+    if(batch->buff == NULL) {
+      perfCounterInc(&batch->drops);
+      return NULL;
+    }
+  }
+
+  return &batch->buff[batch->len];
+}
+
+/*!
+  Add the frame written to the space from txBatchReserve() to the batch.
+
+  \param[in] *batch - transmit batcher
+  \param[in] len - bytes actually used by the frame
+  \return true if the batch reached the threshold and was flushed
+*/
+bool txBatchCommit(txBatch_t *batch, size_t len) {
+  configASSERT(batch != NULL);
+  configASSERT(batch->buff != NULL);
+  configASSERT((batch->len + len) <= batch->capacity);
+
+  batch->len += len;
+  batch->pendingFrames++;
+  perfCounterInc(&batch->frames);
+
+  if(batch->len >= batch->threshold) {
+    txBatchFlush(batch);
+    return true;
+  }
+
+  return false;
+}
+
+/*!
+  Send all frames in the batch now
+
+  \param[in] *batch - transmit batcher
+  \return false if the batch couldn't be sent, true otherwise (including
+          when there was nothing to send)
+*/
+bool txBatchFlush(txBatch_t *batch) {
+  configASSERT(batch != NULL);
+
+  bool rval = true;
+
+  if(batch->len > 0) {
+    perfCounterInc(&batch->batches);
+    perfCounterAdd(&batch->bytes, batch->len);
+    perfCounterMax(&batch->framesPerBatchMax, batch->pendingFrames);
+
+    rval = batch->flushFn(batch->buff, batch->len, batch->ctx);
+    if(!rval) {
+      perfCounterAdd(&batch->drops, batch->pendingFrames);
+    }
+
+    // The flush function owns the buffer now
+    batch->buff = NULL;
+    batch->len = 0;
+    batch->pendingFrames = 0;
+  }
+
+  return rval;
+}
+
+/*!
+  Get number of frames waiting in the current batch
+
+  \param[in] *batch - transmit batcher
+  \return number of frames
+*/
+uint32_t txBatchPendingFrames(const txBatch_t *batch) {
+  configASSERT(batch != NULL);
+
+  return batch->pendingFrames;
+}
+
+/*!
+  Update the frame and byte rate gauges (per second) from the totals since
+  the last call. Call it periodically.
+
+  \param[in] *batch - transmit batcher
+  \param[in] elapsedMs - time since the last call
+  \return none
+*/
+void txBatchUpdateRates(txBatch_t *batch, uint32_t elapsedMs) {
+  configASSERT(batch != NULL);
+
+  uint32_t frames = batch->frames.value;
+  uint32_t bytes = batch->bytes.value;
+
+  if(elapsedMs > 0) {
+    perfCounterSet(&batch->frameRate, (uint32_t)(((uint64_t)(frames - batch->lastFrames) * 1000) / elapsedMs));
+    perfCounterSet(&batch->byteRate, (uint32_t)(((uint64_t)(bytes - batch->lastBytes) * 1000) / elapsedMs));
+  }
+
+  batch->lastFrames = frames;
+  batch->lastBytes = bytes;
+}
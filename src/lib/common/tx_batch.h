@@ -0,0 +1,63 @@
+#pragma once
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include "perf_counters.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+//
+// Transmit batcher.
+//
+// Collects several encoded frames into one heap buffer so they go out as a
+// single serial write (one queue message, one malloc and one stream buffer
+// send) instead of one per frame. Frames are encoded directly into the batch
+// buffer: reserve space, encode into it, then commit the bytes used.
+//
+// The batch is handed to the flush function (which takes ownership of the
+// buffer) when the next frame doesn't fit, when the batch reaches the
+// threshold, or when the owner calls txBatchFlush() (on its deadline timer).
+//
+// Not thread safe, the owner must serialize access.
+//
+
+// Takes ownership of buff (must vPortFree it, even on failure)
+typedef bool (*txBatchFlushFn_t)(uint8_t *buff, size_t len, void *ctx);
+
+typedef struct {
+  uint8_t *buff;
+  size_t len;
+  size_t capacity;
+  size_t threshold;
+  uint32_t pendingFrames;
+
+  txBatchFlushFn_t flushFn;
+  void *ctx;
+
+  // Totals used to compute the rates
+  uint32_t lastFrames;
+  uint32_t lastBytes;
+
+  // Counters (registration is up to the owner)
+  perfCounter_t batches;
+  perfCounter_t frames;
+  perfCounter_t bytes;
+  perfCounter_t drops;
+  perfCounter_t framesPerBatchMax;
+  perfCounter_t frameRate;
+  perfCounter_t byteRate;
+} txBatch_t;
+
+void txBatchInit(txBatch_t *batch, size_t capacity, size_t threshold, txBatchFlushFn_t flushFn, void *ctx);
+uint8_t *txBatchReserve(txBatch_t *batch, size_t len);
+bool txBatchCommit(txBatch_t *batch, size_t len);
+bool txBatchFlush(txBatch_t *batch);
+uint32_t txBatchPendingFrames(const txBatch_t *batch);
+void txBatchUpdateRates(txBatch_t *batch, uint32_t elapsedMs);
+
+#ifdef __cplusplus
+}
+#endif
@@ -5,32 +5,21 @@
 #include "task.h"
 #include "util.h"
 #include "stm32_rtc.h"
+#include "lptimTick.h"
 
-static bool _uptimeFromRTC;
+// UTC (from the RTC) when the monotonic clock was zero, or 0 if the RTC wasn't set
 static uint64_t _startTime;
 
 /*!
   Get system uptime in microseconds
 
+  Comes from the LPTIM monotonic clock, so it never jumps when the RTC is set
+  and doesn't need to read and convert the RTC calendar every call.
+
   \return return number of microseconds system has been running
 */
 uint64_t uptimeGetMicroSeconds() {
-  uint64_t uptimeMicroSeconds;
-
-  // Compute epoch from RTC or ticks
-  if (_uptimeFromRTC) {
-    configASSERT(isRTCSet());
-
-    RTCTimeAndDate_t timeAndDate;
-    rtcGet(&timeAndDate);
-    uint64_t epoch = rtcGetMicroSeconds(&timeAndDate);
-    uptimeMicroSeconds = epoch - _startTime;
-  } else {
-    // microseconds since powerup
-    uptimeMicroSeconds = pdTICKS_TO_MS(xTaskGetTickCount())*1000;
-  }
-
-  return uptimeMicroSeconds;
+  return lptimGetMicroSeconds();
 }
 
 /*!
@@ -47,33 +36,30 @@ uint64_t uptimeGetStartTime() {
   Initialize system uptime
 */
 void uptimeInit() {
-  // If the RTC is already set, set the uptime
+  // If the RTC is already set, set the start time
   if (isRTCSet()) {
     RTCTimeAndDate_t timeAndDate;
     rtcGet(&timeAndDate);
-    _startTime = rtcGetMicroSeconds(&timeAndDate);
-    _uptimeFromRTC = true;
+    _startTime = rtcGetMicroSeconds(&timeAndDate) - lptimGetMicroSeconds();
   } else {
-    // Going to use ticks for the start time, since we don't have GPS time
+    // Don't have GPS time yet
     _startTime = 0;
   }
 }
 
 /*!
-  Initialize system uptime.
+  Update system start time.
   MUST be called after RTC is set
 
-  This assumes RTC is set before ms ticks rolls over
+  \param[in] prevUptimeUS - uptime when the RTC was set
 */
 void uptimeUpdate(uint64_t prevUptimeUS) {
   configASSERT(isRTCSet());
 
-
   RTCTimeAndDate_t timeAndDate;
   rtcGet(&timeAndDate);
   uint64_t currentTime = rtcGetMicroSeconds(&timeAndDate);
 
   // Account for time before getting RTC.
   _startTime = currentTime - prevUptimeUS;
-  _uptimeFromRTC = true;
 }
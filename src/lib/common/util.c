@@ -131,16 +131,59 @@ bool bStrtod(char *numStr, double *dVal) {
 
   return bRval;
 }
-// leap year calulator expects year argument as years offset from 1970
-#define LEAP_YEAR(Y)     ( ((1970+Y)>0) && !((1970+Y)%4) && ( ((1970+Y)%100) || !((1970+Y)%400) ) )
-
 #define SECS_PER_MIN  (60UL)
 #define SECS_PER_HOUR (3600UL)
 #define SECS_PER_DAY  (SECS_PER_HOUR * 24UL)
 #define MICROSECONDS_PER_SECOND (1000000)
 
-static const uint8_t monthDays[]={31,28,31,30,31,30,31,31,30,31,30,31}; // API starts months from 1, this array starts from 0
-static const uint8_t monthDaysLeapYear[]={31,29,31,30,31,30,31,31,30,31,30,31}; // API starts months from 1, this array starts from 0
+// Days in a 400 year era, and from 0000-03-01 to 1970-01-01
+#define DAYS_PER_ERA          (146097)
+#define DAYS_TO_UNIX_EPOCH    (719468)
+
+/*!
+  Number of days since Jan 1st 1970 for a (proleptic Gregorian) date, without
+  looping over years or months. Years are counted from March so the leap day is
+  the last day of the year. (Howard Hinnant's days_from_civil)
+
+  \param[in] year - Full year (2022, for example)
+  \param[in] month - Month starting at 1
+  \param[in] day - Day starting at 1
+  \return days since Jan 1st 1970 (negative before then)
+*/
+int32_t daysFromCivil(int32_t year, uint32_t month, uint32_t day) {
+  year -= (month <= 2);
+  const int32_t era = ((year >= 0) ? year : (year - 399)) / 400;
+  const uint32_t yearOfEra = (uint32_t)(year - (era * 400));
+  const uint32_t dayOfYear = ((153 * ((month > 2) ? (month - 3) : (month + 9))) + 2) / 5 + day - 1;
+  const uint32_t dayOfEra = (yearOfEra * 365) + (yearOfEra / 4) - (yearOfEra / 100) + dayOfYear;
+  return (era * DAYS_PER_ERA) + (int32_t)dayOfEra - DAYS_TO_UNIX_EPOCH;
+}
+
+/*!
+  Inverse of daysFromCivil (Howard Hinnant's civil_from_days)
+
+  \param[in] days - days since Jan 1st 1970
+  \param[out] *year - Full year
+  \param[out] *month - Month starting at 1
+  \param[out] *day - Day starting at 1
+  \return None
+*/
+void civilFromDays(int32_t days, int32_t *year, uint32_t *month, uint32_t *day) {
+  configASSERT(year);
+  configASSERT(month);
+  configASSERT(day);
+
+  days += DAYS_TO_UNIX_EPOCH;
+  const int32_t era = ((days >= 0) ? days : (days - (DAYS_PER_ERA - 1))) / DAYS_PER_ERA;
+  const uint32_t dayOfEra = (uint32_t)(days - (era * DAYS_PER_ERA));
+  const uint32_t yearOfEra = (dayOfEra - (dayOfEra / 1460) + (dayOfEra / 36524) - (dayOfEra / 146096)) / 365;
+  const uint32_t dayOfYear = dayOfEra - ((365 * yearOfEra) + (yearOfEra / 4) - (yearOfEra / 100));
+  const uint32_t monthFromMarch = ((5 * dayOfYear) + 2) / 153;
+
+  *day = dayOfYear - (((153 * monthFromMarch) + 2) / 5) + 1;
+  *month = (monthFromMarch < 10) ? (monthFromMarch + 3) : (monthFromMarch - 9);
+  *year = (int32_t)yearOfEra + (era * 400) + (*month <= 2);
+}
 
 /*!
   Convert date (YYYYMMDDhhmmss) into unix timestamp(UTC)
@@ -154,43 +197,13 @@ static const uint8_t monthDaysLeapYear[]={31,29,31,30,31,30,31,31,30,31,30,31};
   \return UTC seconds since Jan 1st 1970 00:00:00
 */
 uint32_t utcFromDateTime(uint16_t year, uint8_t month, uint8_t day, uint8_t hour, uint8_t minute, uint8_t second) {
-  int i;
-  uint32_t seconds;
-
-  // seconds from 1970 till 1 jan 00:00:00 of the given year
-  seconds = (year - 1970) * (SECS_PER_DAY * 365);
-  for (i = 1970; i < year; i++) {
-    if (LEAP_YEAR(i - 1970)) {
-      seconds +=  SECS_PER_DAY;   // add extra days for leap years
-    }
-  }
-
-  // add days for this year, months start from 1
-  for (i = 1; i < month; i++) {
-    if ( (i == 2) && LEAP_YEAR(year - 1970)) {
-      seconds += SECS_PER_DAY * 29;
-    } else {
-      seconds += SECS_PER_DAY * monthDays[i-1];  //monthDay array starts from 0
-    }
-  }
-  seconds+= (day-1) * SECS_PER_DAY;
-  seconds+= hour * SECS_PER_HOUR;
-  seconds+= minute * SECS_PER_MIN;
-  seconds+= second;
+  uint32_t seconds = (uint32_t)daysFromCivil(year, month, day) * SECS_PER_DAY;
+  seconds += hour * SECS_PER_HOUR;
+  seconds += minute * SECS_PER_MIN;
+  seconds += second;
   return seconds;
 }
 
-#define DAYS_PER_YEAR (365)
-#define DAYS_PER_LEAP_YEAR (DAYS_PER_YEAR + 1)
-
-static uint32_t getDaysForYear(uint32_t year) {
-  return LEAP_YEAR(year - 1970) ? DAYS_PER_LEAP_YEAR : DAYS_PER_YEAR;
-}
-
-static const uint8_t * getDaysPerMonth(uint32_t year) {
-  return LEAP_YEAR(year - 1970) ? monthDaysLeapYear : monthDays;
-}
-
 /*!
   Convert unix timestamp(UTC) in microseconds to date (YYYYMMDDhhmmss)
 
@@ -200,27 +213,18 @@ static const uint8_t * getDaysPerMonth(uint32_t year) {
 */
 void dateTimeFromUtc(uint64_t utc_us, utcDateTime_t *dateTime) {
   configASSERT(dateTime);
-  
-  // year
-  uint64_t days = (utc_us / MICROSECONDS_PER_SECOND) / SECS_PER_DAY;
-  dateTime->year = 1970;
-  while( days >= getDaysForYear(dateTime->year) ) {
-    days -= getDaysForYear(dateTime->year);
-    dateTime->year++;
-  }
 
-  // months
-  const uint8_t * monthDays = getDaysPerMonth(dateTime->year);
-  dateTime->month = 1;
-  while(days >= monthDays[dateTime->month-1]){
-    days -= monthDays[dateTime->month-1];
-    dateTime->month++;
-  }
+  uint64_t seconds = utc_us / MICROSECONDS_PER_SECOND;
 
-  // days
-  dateTime->day = days + 1;
+  int32_t year;
+  uint32_t month;
+  uint32_t day;
+  civilFromDays((int32_t)(seconds / SECS_PER_DAY), &year, &month, &day);
+  dateTime->year = year;
+  dateTime->month = month;
+  dateTime->day = day;
 
-  uint64_t secondsRemaining = (utc_us / MICROSECONDS_PER_SECOND) % SECS_PER_DAY;
+  uint64_t secondsRemaining = seconds % SECS_PER_DAY;
   // hours
   dateTime->hour = secondsRemaining / SECS_PER_HOUR;
 
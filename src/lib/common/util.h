@@ -22,6 +22,8 @@ bool bStrtof(char *numStr, float *fVal);
 bool bStrtod(char *numStr, double *dVal);
 uint32_t utcFromDateTime(uint16_t year, uint8_t month, uint8_t day, uint8_t hour, uint8_t minute, uint8_t second);
 void dateTimeFromUtc(uint64_t utc_us, utcDateTime_t *dateTime);
+int32_t daysFromCivil(int32_t year, uint32_t month, uint32_t day);
+void civilFromDays(int32_t days, int32_t *year, uint32_t *month, uint32_t *day);
 uint32_t timeRemainingGeneric(uint32_t startTime, uint32_t currentTime, uint32_t timeout);
 
 char *duplicateStr(const char *inStr);
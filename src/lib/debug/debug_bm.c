@@ -6,6 +6,7 @@
 #include "FreeRTOS_CLI.h"
 
 #include <string.h>
+#include <stdlib.h>
 #include <inttypes.h>
 #include "bsp.h"
 #include "debug.h"
@@ -53,6 +54,12 @@ static const CLI_Command_Definition_t cmdGpio = {
   " * bm sub <topic>\n"
   " * bm unsub <topic>\n"
   " * bm pub <topic> <data>\n"
+  " * bm pubr <topic> <data> - publish and wait for a subscriber ack\n"
+  " * bm qos - show reliable publishing stats\n"
+  " * bm directed <on|off> - publish directly to known subscribers (default off)\n"
+  " * bm limit <topic> <low|normal|high> [rate_bps] [burst] - set topic priority/rate limit\n"
+  " * bm limits - show per-topic counters and limits\n"
+  " * bm publimit <rate_bps> [burst] - limit each publisher (0 for no limit)\n"
   " * bm printf <string>\n"
   " * bm fprintf <file_name> <string>\n"
   " * bm print\n",
@@ -209,7 +216,9 @@ static BaseType_t neighborsCommand( char *writeBuffer,
             bm_unsub(topic, print_subscriptions);
             vPortFree(topic);
 
-        } else if (strncmp("pub", parameter,parameterStringLength) == 0) {
+        } else if ((strncmp("pub", parameter,parameterStringLength) == 0) ||
+                   (strncmp("pubr", parameter,parameterStringLength) == 0)) {
+            bool reliable = (parameter[parameterStringLength - 1] == 'r');
             const char *topicStr = FreeRTOS_CLIGetParameter(
                             commandString,
                             2,
@@ -240,9 +249,102 @@ static BaseType_t neighborsCommand( char *writeBuffer,
             memcpy(data, dataStr, parameterStringLength);
             data[parameterStringLength] = 0;
 
-            bm_pub(topic, data, parameterStringLength);
+            if(reliable) {
+                bm_pub_reliable(topic, data, parameterStringLength);
+            } else {
+                bm_pub(topic, data, parameterStringLength);
+            }
             vPortFree(topic);
             vPortFree(data);
+        } else if (strncmp("qos", parameter,parameterStringLength) == 0) {
+            bm_pub_print_qos_stats();
+        } else if (strncmp("directed", parameter,parameterStringLength) == 0) {
+            const char *enableStr = FreeRTOS_CLIGetParameter(
+                            commandString,
+                            2,
+                            &parameterStringLength);
+
+            if(parameterStringLength == 0) {
+                printf("ERR on/off required\n");
+                break;
+            }
+            if(strncmp("on", enableStr, parameterStringLength) == 0) {
+                bm_pub_set_directed(true);
+            } else if(strncmp("off", enableStr, parameterStringLength) == 0) {
+                bm_pub_set_directed(false);
+            } else {
+                printf("ERR on/off required\n");
+            }
+        } else if (strncmp("limit", parameter,parameterStringLength) == 0) {
+            const char *topicStr = FreeRTOS_CLIGetParameter(
+                            commandString,
+                            2,
+                            &parameterStringLength);
+
+            if(parameterStringLength == 0) {
+                printf("ERR topic required\n");
+                break;
+            }
+
+            char *topic = pvPortMalloc(parameterStringLength+1);
+            configASSERT(topic);
+            memcpy(topic, topicStr, parameterStringLength);
+            topic[parameterStringLength] = 0;
+
+            const char *prioStr = FreeRTOS_CLIGetParameter(
+                            commandString,
+                            3,
+                            &parameterStringLength);
+
+            bm_pubsub_priority_e prio;
+            if((parameterStringLength > 0) && (strncmp("low", prioStr, parameterStringLength) == 0)) {
+                prio = BM_PUBSUB_PRIO_LOW;
+            } else if((parameterStringLength > 0) && (strncmp("normal", prioStr, parameterStringLength) == 0)) {
+                prio = BM_PUBSUB_PRIO_NORMAL;
+            } else if((parameterStringLength > 0) && (strncmp("high", prioStr, parameterStringLength) == 0)) {
+                prio = BM_PUBSUB_PRIO_HIGH;
+            } else {
+                printf("ERR low/normal/high required\n");
+                vPortFree(topic);
+                break;
+            }
+
+            // Optional
+            const char *rateStr = FreeRTOS_CLIGetParameter(
+                            commandString,
+                            4,
+                            &parameterStringLength);
+            uint32_t rateBps = rateStr ? strtoul(rateStr, NULL, 10) : 0;
+
+            const char *burstStr = FreeRTOS_CLIGetParameter(
+                            commandString,
+                            5,
+                            &parameterStringLength);
+            uint32_t burstBytes = burstStr ? strtoul(burstStr, NULL, 10) : 0;
+
+            bm_pubsub_set_topic_limit(topic, prio, rateBps, burstBytes);
+            vPortFree(topic);
+        } else if (strncmp("limits", parameter,parameterStringLength) == 0) {
+            bm_pubsub_print_limits();
+        } else if (strncmp("publimit", parameter,parameterStringLength) == 0) {
+            const char *rateStr = FreeRTOS_CLIGetParameter(
+                            commandString,
+                            2,
+                            &parameterStringLength);
+
+            if(parameterStringLength == 0) {
+                printf("ERR rate required\n");
+                break;
+            }
+            uint32_t rateBps = strtoul(rateStr, NULL, 10);
+
+            const char *burstStr = FreeRTOS_CLIGetParameter(
+                            commandString,
+                            3,
+                            &parameterStringLength);
+            uint32_t burstBytes = burstStr ? strtoul(burstStr, NULL, 10) : 0;
+
+            bm_pubsub_set_publisher_limit(rateBps, burstBytes);
         } else if (strncmp("print", parameter,parameterStringLength) == 0) {
             bm_print_subs();
         } else if (strncmp("printf", parameter,parameterStringLength) == 0) {
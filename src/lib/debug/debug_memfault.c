@@ -92,7 +92,7 @@ static void print_coredump() {
       b64Data[olen] = '\n';
 
       SerialMessage_t encodedMessage = {b64Data, olen + 1, _serialConsoleHandle};
-      if(xQueueSend(serialGetTxQueue(), &encodedMessage, 100) != pdTRUE) {
+      if(serialTxQueueSend(&encodedMessage, 100) != pdTRUE) {
         // Free buffer if unable to send
         vPortFree(encodedMessage.buff);
       }
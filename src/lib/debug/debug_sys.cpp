@@ -12,6 +12,8 @@
 #include "debug.h"
 #include "device_info.h"
 #include "reset_reason.h"
+#include "mem_pool.h"
+#include "perf_counters.h"
 #include "bootloader_helper.h"
 #include "bsp.h"
 #ifndef NO_NETWORK
@@ -58,6 +60,9 @@ static const CLI_Command_Definition_t cmdDebug = {
   " * reset - Reset device\n"
   " * mem - Get some memory statistics\n"
   " * tasks - Print task statistics\n"
+  " * cpu - Print per-task cpu usage\n"
+  " * perf - Print performance counters (queues, drops, heap, cpu)\n"
+  " * perf-reset - Clear performance counters\n"
 #if BUILD_DEBUG
   " * crash - Generate crash\n"
   " * hardfault - Generate hardfault\n"
@@ -240,6 +245,9 @@ static BaseType_t getHeapStats() {
   printf("Alloc/Free delta:     %zu\n",
     heapStats.xNumberOfSuccessfulAllocations - heapStats.xNumberOfSuccessfulFrees);
 
+  printf("********* POOL STATS *********\n");
+  memPoolsPrint();
+
   return pdFALSE;
 }
 
@@ -326,6 +334,12 @@ static BaseType_t debugCommand(char *writeBuffer,
   } else if (strncmp("tasks", parameter, parameterStringLength) == 0) {
     getSysStats();
 #endif // configUSE_TRACE_FACILITY
+  } else if (strncmp("cpu", parameter, parameterStringLength) == 0) {
+    perfTasksPrint();
+  } else if ((parameterStringLength == 4) && (strncmp("perf", parameter, parameterStringLength) == 0)) {
+    perfCountersPrint();
+  } else if (strncmp("perf-reset", parameter, parameterStringLength) == 0) {
+    perfCountersReset();
   } else if (strncmp("bootloader", parameter, parameterStringLength) == 0) {
     rebootIntoROMBootloader();
   } else {
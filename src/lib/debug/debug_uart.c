@@ -20,7 +20,7 @@
 #include "task_priorities.h"
 // #include "log.h"
 
-static void processLineBufferedRxByte(void *serialHandle, uint8_t byte);
+static void processLineBufferedRxBytes(void *serialHandle, uint8_t *buffer, size_t len);
 static void printLine(void *serialHandle, uint8_t *line, size_t len);
 
 // Log_t *UARTLog;
@@ -32,7 +32,8 @@ SerialLineBuffer_t lpUART1LineBuffer = {
   lpUart1Buffer,
   0,
   sizeof(lpUart1Buffer),
-  printLine
+  printLine,
+  false
 };
 SerialHandle_t lpuart1  = {
   .device = LPUART1,
@@ -45,7 +46,8 @@ SerialHandle_t lpuart1  = {
   .rxBufferSize = 64,
   .rxBytesFromISR = serialGenericRxBytesFromISR,
   .getTxBytesFromISR = serialGenericGetTxBytesFromISR,
-  .processByte = processLineBufferedRxByte,
+  .processByte = NULL,
+  .processBytes = processLineBufferedRxBytes,
   .data = &lpUART1LineBuffer,
   .enabled = false,
   .flags = 0,
@@ -59,7 +61,8 @@ SerialLineBuffer_t usart1LineBuffer = {
   usart1Buffer,
   0,
   sizeof(usart1Buffer),
-  printLine
+  printLine,
+  false
 };
 SerialHandle_t usart1   = {
   .device = USART1,
@@ -72,7 +75,8 @@ SerialHandle_t usart1   = {
   .rxBufferSize = 128,
   .rxBytesFromISR = serialGenericRxBytesFromISR,
   .getTxBytesFromISR = serialGenericGetTxBytesFromISR,
-  .processByte = processLineBufferedRxByte,
+  .processByte = NULL,
+  .processBytes = processLineBufferedRxBytes,
   .data = &usart1LineBuffer,
   .enabled = false,
   .flags = 0,
@@ -86,7 +90,8 @@ SerialLineBuffer_t usart2LineBuffer = {
   usart2Buffer,
   0,
   sizeof(usart2Buffer),
-  printLine
+  printLine,
+  false
 };
 SerialHandle_t usart2   = {
   .device = USART2,
@@ -99,7 +104,8 @@ SerialHandle_t usart2   = {
   .rxBufferSize = 128,
   .rxBytesFromISR = serialGenericRxBytesFromISR,
   .getTxBytesFromISR = serialGenericGetTxBytesFromISR,
-  .processByte = processLineBufferedRxByte,
+  .processByte = NULL,
+  .processBytes = processLineBufferedRxBytes,
   .data = &usart2LineBuffer,
   .enabled = false,
   .flags = 0,
@@ -113,7 +119,8 @@ SerialLineBuffer_t usart3LineBuffer = {
   usart3Buffer,
   0,
   sizeof(usart3Buffer),
-  printLine
+  printLine,
+  false
 };
 SerialHandle_t usart3   = {
   .device = USART3,
@@ -126,7 +133,8 @@ SerialHandle_t usart3   = {
   .rxBufferSize = 64,
   .rxBytesFromISR = serialGenericRxBytesFromISR,
   .getTxBytesFromISR = serialGenericGetTxBytesFromISR,
-  .processByte = processLineBufferedRxByte,
+  .processByte = NULL,
+  .processBytes = processLineBufferedRxBytes,
   .data = &usart3LineBuffer,
   .enabled = false,
   .flags = 0,
@@ -265,7 +273,7 @@ static BaseType_t debugSerialCommand(char *writeBuffer,
       debugUartMessage.buff[debugUartMessage.len - 2] = '\r';
       debugUartMessage.buff[debugUartMessage.len - 1] = '\n';
 
-      if(xQueueSend(serialGetTxQueue(), &debugUartMessage, 10 ) != pdTRUE) {
+      if(serialTxQueueSend(&debugUartMessage, 10) != pdTRUE) {
         // Free buffer if we were unable to send it
         vPortFree(debugUartMessage.buff);
       }
@@ -366,42 +374,14 @@ void startDebugUart() {
 
 }
 
-static void processLineBufferedRxByte(void *serialHandle, uint8_t byte) {
+static void processLineBufferedRxBytes(void *serialHandle, uint8_t *buffer, size_t len) {
   configASSERT(serialHandle != NULL);
   SerialHandle_t *handle = (SerialHandle_t *)serialHandle;
 
   // This function requires data to be a pointer to a SerialLineBuffer_t
   configASSERT(handle->data != NULL);
 
-  SerialLineBuffer_t *lineBuffer = (SerialLineBuffer_t *)handle->data;
-
-  // We need a buffer to use!
-  configASSERT(lineBuffer->buffer != NULL);
-
-  lineBuffer->buffer[lineBuffer->idx] = byte;
-
-  if(lineBuffer->buffer[lineBuffer->idx] == '\n'){
-
-    // Zero terminate the line
-    if ((lineBuffer->idx + 1) < lineBuffer->len) {
-      lineBuffer->buffer[lineBuffer->idx + 1] = 0;
-    }
-
-    if(lineBuffer->lineCallback != NULL) {
-      lineBuffer->lineCallback(handle, lineBuffer->buffer, lineBuffer->idx);
-    }
-
-    // Reset buffer index
-    lineBuffer->idx = 0;
-  } else {
-
-    lineBuffer->idx++;
-
-    // Heavy handed way of dealing with overflow for now
-    // Later we can just purge the buffer
-    // TODO - log error and clear buffer instead
-    configASSERT((lineBuffer->idx + 1) < lineBuffer->len);
-  }
+  serialLineBufferProcess(handle, (SerialLineBuffer_t *)handle->data, buffer, len);
 }
 
 static void printLine(void *serialHandle, uint8_t *line, size_t len) {
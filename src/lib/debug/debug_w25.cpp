@@ -1,12 +1,14 @@
 #include "debug_w25.h"
 #include "FreeRTOS.h"
 #include "FreeRTOS_CLI.h"
+#include <inttypes.h>
 #include <string.h>
 #include <stdlib.h>
 #include "debug.h"
 #include "cli.h"
 #include <stdlib.h>
 #include "crc.h"
+#include "perf_counters.h"
 
 #define BITMASK24BIT (0x00ffffff)
 #define MAX_READ_LEN_BYTES (2048)
@@ -18,6 +20,7 @@ static W25* _w25_instance = NULL;
 static BaseType_t w25Command( char *writeBuffer,
                                   size_t writeBufferLen,
                                   const char *commandString);
+static void printLatency(const char *name, const latencyHistogram_t *hist);
 
 static const CLI_Command_Definition_t cmdW25 = {
   // Command string
@@ -29,7 +32,8 @@ static const CLI_Command_Definition_t cmdW25 = {
   " * w25 es <addr>\n"
   " * w25 ec\n"
   " * w25 bw <addr> <len>\n"
-  " * w25 test <addr> <len>\n",
+  " * w25 test <addr> <len>\n"
+  " * w25 stats [reset]\n",
   // Command function
   w25Command,
   // Number of parameters (variable)
@@ -259,10 +263,39 @@ static BaseType_t w25Command( char *writeBuffer,
                 printf("flash test failed, crc_w:%lu, crc_r:%lu\n", crc32_write, crc32_read);
             }
             vPortFree(wr_buf);
+        } else if (strncmp("stats", parameter, parameterStringLength) == 0) {
+            const char *reset = FreeRTOS_CLIGetParameter(
+                            commandString,
+                            2,
+                            &parameterStringLength);
+            if(reset != NULL && strncmp("reset", reset, parameterStringLength) == 0) {
+                _w25_instance->resetStats();
+                printf("OK\n");
+                break;
+            }
+            const W25Stats_t *stats = _w25_instance->getStats();
+            printf("         count    p50(us)    p99(us)    max(us)   mean(us)\n");
+            printLatency("erase", &stats->erase);
+            printLatency("program", &stats->program);
+            printLatency("read", &stats->read);
+            printf("cache hits: %" PRIu32 " misses: %" PRIu32 " erase suspends: %" PRIu32 "\n",
+                   perfCounterGet("w25", "cache_hits"),
+                   perfCounterGet("w25", "cache_misses"),
+                   perfCounterGet("w25", "erase_suspends"));
         } else {
             printf("ERR Invalid paramters\n");
             break;
         }
     } while(0);
     return pdFALSE;
+}
+
+static void printLatency(const char *name, const latencyHistogram_t *hist) {
+    printf("%-8s %6" PRIu32 " %10" PRIu32 " %10" PRIu32 " %10" PRIu32 " %10" PRIu32 "\n",
+           name,
+           hist->count,
+           latencyHistogramPercentile(hist, 50),
+           latencyHistogramPercentile(hist, 99),
+           hist->max,
+           latencyHistogramMean(hist));
 } 
\ No newline at end of file
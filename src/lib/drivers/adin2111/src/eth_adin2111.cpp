@@ -23,9 +23,12 @@
 #include "bm_l2.h"
 #include "bsp.h"
 #include "eth_adin2111.h"
+#include "mem_pool.h"
 #include "task_priorities.h"
 
 #include "pcap.h"
+#include "perf_counters.h"
+#include "trace.h"
 
 
 /* Extra 4 bytes for FCS and 2 bytes for the frame header */
@@ -101,6 +104,14 @@ typedef struct {
 
 // Queue used to handle all tx/rx/irq events
 static QueueHandle_t    _eth_evt_queue;
+static perfQueue_t      _eth_evt_queue_perf;
+
+// Event structs come from pools so the data path doesn't churn the heap.
+// Rx requests are allocated once at init and recycled by the driver.
+MEM_POOL_DEFINE(eth_rx_msgs, sizeof(rxMsgEvt_t), RX_QUEUE_NUM_ENTRIES, false);
+MEM_POOL_DEFINE(eth_tx_msgs, sizeof(txMsgEvt_t), ETH_EVT_QUEUE_LEN, true);
+MEM_POOL_DEFINE(eth_link_evts, sizeof(linkChangeEvt_t), 4, true);
+MEM_POOL_DEFINE(eth_stats_reqs, sizeof(portStatsReqEvt_t), 4, true);
 
 static void free_tx_msg_req(txMsgEvt_t *txMsg);
 static rxMsgEvt_t *createRxMsgReq(adin2111_DeviceHandle_t hDevice, uint16_t buf_len);
@@ -119,8 +130,10 @@ static void adin2111_rx_cb(void *pCBParam, uint32_t Event, void *pArg) {
     (void)pCBParam;
 
     // pArg points to rxMsgEvt_t
+    tracePacket(kTraceEventPktAdinRxDone, static_cast<rxMsgEvt_t *>(pArg)->bufDesc.pBuf);
     ethEvt_t event = {.type=EVT_ETH_RX, .data=pArg};
     configASSERT(xQueueSend(_eth_evt_queue, &event, 10));
+    perfQueueSent(&_eth_evt_queue_perf);
 }
 
 /*!
@@ -137,6 +150,7 @@ static void adin2111_tx_cb(void *pCBParam, uint32_t Event, void *pArg) {
 
     txMsgEvt_t *txMsg = static_cast<txMsgEvt_t *>(pArg);
     if(txMsg) {
+        tracePacket(kTraceEventPktAdinTxDone, txMsg->bufDesc.pBuf);
         free_tx_msg_req(txMsg);
     } else {
         // Callback with empty arg! Uh oh
@@ -158,7 +172,7 @@ static void adin2111_link_change_cb(void *pCBParam, uint32_t Event, void *pArg)
     // Letting callback handle checking the port state for each port
     adi_mac_StatusRegisters_t *statusRegisters = static_cast<adi_mac_StatusRegisters_t *>(pArg);
 
-    linkChangeEvt_t *linkChangeEvt = static_cast<linkChangeEvt_t *>(pvPortMalloc(sizeof(linkChangeEvt_t)));
+    linkChangeEvt_t *linkChangeEvt = static_cast<linkChangeEvt_t *>(memPoolAlloc(&eth_link_evts));
     configASSERT(linkChangeEvt);
 
     linkChangeEvt->handle = (adin2111_DeviceHandle_t)pCBParam;
@@ -169,13 +183,14 @@ static void adin2111_link_change_cb(void *pCBParam, uint32_t Event, void *pArg)
         linkChangeEvt->port = ADIN2111_PORT_2;
     } else {
         printf("Unknown link change event\n");
-        vPortFree(linkChangeEvt);
+        memPoolFree(&eth_link_evts, linkChangeEvt);
         linkChangeEvt = NULL;
     }
 
     if(linkChangeEvt) {
         ethEvt_t event = {.type=EVT_LINK_CHANGE, .data=linkChangeEvt};
         configASSERT(xQueueSend(_eth_evt_queue, &event, 10));
+        perfQueueSent(&_eth_evt_queue_perf);
     }
 }
 
@@ -263,6 +278,7 @@ static void adin2111_thread(void *parameters) {
                     break;
                 }
 
+                tracePacket(kTraceEventPktAdinTxSubmit, txMsg->bufDesc.pBuf);
                 adi_eth_Result_e result = adin2111_SubmitTxBuffer(txMsg->dev, (adin2111_TxPort_e)txMsg->port, &txMsg->bufDesc);
                 if (result != ADI_ETH_SUCCESS) {
                     // Free all the buffers!
@@ -280,8 +296,9 @@ static void adin2111_thread(void *parameters) {
 
             case EVT_ETH_RX: {
                 rxMsgEvt_t *rxMsg = static_cast<rxMsgEvt_t *>(event.data);
+                tracePacket(kTraceEventPktAdinRxDequeue, rxMsg->bufDesc.pBuf);
 
-                pcapTxPacket(rxMsg->bufDesc.pBuf, rxMsg->bufDesc.trxSize);
+                pcapCapture(rxMsg->bufDesc.pBuf, rxMsg->bufDesc.trxSize, PCAP_DIR_RX);
 
                 uint8_t rx_port_mask = (1 << rxMsg->bufDesc.port);
                 err_t retv =  _rx_callback(rxMsg->dev, rxMsg->bufDesc.pBuf, rxMsg->bufDesc.trxSize, rx_port_mask);
@@ -308,7 +325,7 @@ static void adin2111_thread(void *parameters) {
                 configASSERT(event.data);
                 linkChangeEvt_t *linkChangeEvt = static_cast<linkChangeEvt_t *>(event.data);
                 _link_change(linkChangeEvt);
-                vPortFree(linkChangeEvt);
+                memPoolFree(&eth_link_evts, linkChangeEvt);
                 break;
             }
 
@@ -316,7 +333,7 @@ static void adin2111_thread(void *parameters) {
                 configASSERT(event.data);
                 portStatsReqEvt_t *portStatsReqEvt = static_cast<portStatsReqEvt_t *>(event.data);
                 _get_port_stats(portStatsReqEvt);
-                vPortFree(portStatsReqEvt);
+                memPoolFree(&eth_stats_reqs, portStatsReqEvt);
                 break;
             }
 
@@ -370,6 +387,7 @@ adi_eth_Result_e adin2111_hw_init(adin2111_DeviceHandle_t hDevice, adin_rx_callb
 
         _eth_evt_queue = xQueueCreate(ETH_EVT_QUEUE_LEN, sizeof(ethEvt_t));
         configASSERT(_eth_evt_queue);
+        perfQueueRegister(&_eth_evt_queue_perf, "eth_evt_q", _eth_evt_queue);
 
         adi_bsp_register_irq_evt (_irq_evt_cb_from_isr);
 
@@ -479,7 +497,7 @@ static void add_egress_port(uint8_t *buff, uint8_t port) {
   \return pointer to allocated message request
 */
 static rxMsgEvt_t *createRxMsgReq(adin2111_DeviceHandle_t hDevice, uint16_t buf_len) {
-    rxMsgEvt_t *rxMsg = static_cast<rxMsgEvt_t *>(pvPortMalloc(sizeof(rxMsgEvt_t)));
+    rxMsgEvt_t *rxMsg = static_cast<rxMsgEvt_t *>(memPoolAlloc(&eth_rx_msgs));
     if(rxMsg) {
         memset(rxMsg, 0x00, sizeof(rxMsgEvt_t));
         rxMsg->dev = hDevice;
@@ -493,7 +511,7 @@ static rxMsgEvt_t *createRxMsgReq(adin2111_DeviceHandle_t hDevice, uint16_t buf_
             // TODO - use pbuf instead of malloc/copying
             memset(rxMsg->bufDesc.pBuf, 0x00, buf_len);
         } else {
-            vPortFree(rxMsg);
+            memPoolFree(&eth_rx_msgs, rxMsg);
             rxMsg = NULL;
         }
     }
@@ -515,7 +533,7 @@ static rxMsgEvt_t *createRxMsgReq(adin2111_DeviceHandle_t hDevice, uint16_t buf_
 static txMsgEvt_t *createTxMsgReq(adin2111_DeviceHandle_t hDevice, uint8_t* buf, uint16_t buf_len, adin2111_Port_e port) {
     configASSERT(buf);
 
-    txMsgEvt_t *txMsg = static_cast<txMsgEvt_t *>(pvPortMalloc(sizeof(txMsgEvt_t)));
+    txMsgEvt_t *txMsg = static_cast<txMsgEvt_t *>(memPoolAlloc(&eth_tx_msgs));
     if(txMsg) {
         memset(txMsg, 0x00, sizeof(txMsgEvt_t));
         txMsg->dev = hDevice;
@@ -530,7 +548,7 @@ static txMsgEvt_t *createTxMsgReq(adin2111_DeviceHandle_t hDevice, uint8_t* buf,
             // TODO - use pbuf instead of malloc/copying
             memcpy(txMsg->bufDesc.pBuf, buf, buf_len);
         } else {
-            vPortFree(txMsg);
+            memPoolFree(&eth_tx_msgs, txMsg);
             txMsg = NULL;
         }
     }
@@ -549,7 +567,7 @@ static void free_tx_msg_req(txMsgEvt_t *txMsg) {
         if(txMsg->bufDesc.pBuf){
             aligned_free(txMsg->bufDesc.pBuf);
         }
-        vPortFree(txMsg);
+        memPoolFree(&eth_tx_msgs, txMsg);
     }
 }
 
@@ -586,14 +604,17 @@ err_t adin2111_tx(adin2111_DeviceHandle_t hDevice, uint8_t* buf, uint16_t buf_le
                     uint8_t bm_egress_port = (0x01 << port) << port_offset;
                     add_egress_port(txMsg->bufDesc.pBuf, bm_egress_port);
 
-                    pcapTxPacket(buf, buf_len);
+                    pcapCapture(buf, buf_len, PCAP_DIR_TX);
 
                     ethEvt_t event = {.type=EVT_ETH_TX, .data=txMsg};
+                    tracePacket(kTraceEventPktAdinTxEnqueue, txMsg->bufDesc.pBuf);
                     if(xQueueSend(_eth_evt_queue, &event, 100) == pdFALSE) {
+                        perfQueueDropped(&_eth_evt_queue_perf);
                         free_tx_msg_req(txMsg);
                         retv = ERR_MEM;
                         break;
                     }
+                    perfQueueSent(&_eth_evt_queue_perf);
 
                 } else {
                     retv = ERR_MEM;
@@ -644,7 +665,7 @@ bool adin2111_get_port_stats(adin2111_DeviceHandle_t dev, adin2111_Port_e port,
     configASSERT(callback);
     configASSERT(port < ADIN2111_PORT_NUM);
 
-    portStatsReqEvt_t *portStatsReqEvt = static_cast<portStatsReqEvt_t *>(pvPortMalloc(sizeof(portStatsReqEvt_t)));
+    portStatsReqEvt_t *portStatsReqEvt = static_cast<portStatsReqEvt_t *>(memPoolAlloc(&eth_stats_reqs));
     configASSERT(portStatsReqEvt);
     portStatsReqEvt->handle = dev;
     portStatsReqEvt->port = port;
@@ -655,10 +676,12 @@ bool adin2111_get_port_stats(adin2111_DeviceHandle_t dev, adin2111_Port_e port,
     bool rval = false;
 
     if(xQueueSend(_eth_evt_queue, &event, 10) == pdTRUE) {
+        perfQueueSent(&_eth_evt_queue_perf);
         rval = true;
     } else {
+        perfQueueDropped(&_eth_evt_queue_perf);
         // Free port stats request event since we were unable to queue the request
-        vPortFree(portStatsReqEvt);
+        memPoolFree(&eth_stats_reqs, portStatsReqEvt);
     }
 
     return rval;
@@ -266,24 +266,48 @@ bool INA232::waitForReadyFlag() {
   return rval;
 }
 
+/*!
+  Check the conversion ready flag without waiting. Note that reading the
+  flag clears it.
+
+  \param[out] ready true if a new conversion is ready
+  \return true if successfull false otherwise
+*/
+bool INA232::conversionReady(bool &ready) {
+  uint16_t regVal = 0;
+  bool rval = readReg(REG_MASK_EN, &regVal);
+
+  ready = rval && (regVal & INA_CVRF);
+
+  return rval;
+}
+
 /*!
   Get voltage/current measurements from all channels. To be later read with getChPower
 
   \return true if successfull false otherwise
 */
 bool INA232::measurePower() {
+  if(!waitForReadyFlag()) {
+    printf("Timed out waiting for ready flag!\n");
+    return false;
+  }
+
+  return readPower();
+}
+
+/*!
+  Read voltage/current measurements without waiting for a conversion (use
+  conversionReady() first). To be later read with getPower
+
+  \return true if successfull false otherwise
+*/
+bool INA232::readPower() {
   bool rval = true;
   uint16_t regVal;
   float shuntV, busV;
 
   do {
-
-    if(!waitForReadyFlag()) {
-      printf("Timed out waiting for ready flag!\n");
-      rval = false;
-      break;
-    }
-
     // Read shunt voltage
     uint8_t reg =  static_cast<uint8_t>(REG_SHUNT_V);
     if(!readReg((Reg_t)reg, &regVal)) {
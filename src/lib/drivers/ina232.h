@@ -50,6 +50,8 @@ public:
   bool setBusConvTime(ConvTime_t convTime);
   bool setShuntConvTime(ConvTime_t convTime);
   bool measurePower();
+  bool conversionReady(bool &ready);
+  bool readPower();
   void getPower(float &voltage, float &current);
   uint32_t getTotalConversionTimeMs();
   uint16_t getAddr();
@@ -3,6 +3,7 @@
 #include "FreeRTOS.h"
 #include "lpm.h"
 #include "mic.h"
+#include "mic_kernels.h"
 #include "sai.h"
 #include "task.h"
 
@@ -187,10 +188,6 @@ bool micSample(uint32_t durationSec, micCallbackFn callback, void *args) {
   return rval;
 }
 
-// Acoustic Overload Point for ICS-43434
-// See https://invensense.tdk.com/wp-content/uploads/2016/02/DS-000069-ICS-43434-v1.2.pdf
-#define MIC_AOP_DB (120)
-
 // TODO - add calibration?
 /*!
   Compute dB level from sample buffer
@@ -200,23 +197,12 @@ bool micSample(uint32_t durationSec, micCallbackFn callback, void *args) {
   \return sound level in dB
 */
 float micGetDB(const uint32_t *samples, uint32_t numSamples) {
-  float accumulator = 0;
-
-  // Compute RMS value
-  for (uint32_t index=0; index < numSamples; index++) {
-    // Need to left shift then back right to extend the sign bit of
-    // the 24-bit sample
-    float sample = ((int32_t)samples[index] << 8) >> 8;
-
-    accumulator += sample * sample;
-  }
-
-  accumulator = sqrtf(accumulator/numSamples);
+  micKernelStats_t stats;
 
-  // Compute DB value
-  float db = MIC_AOP_DB + 20.0 * log10f(accumulator/(1<<24));
+  micKernelStatsInit(&stats);
+  micKernelProcess(samples, numSamples, NULL, &stats);
 
-  return db;
+  return micKernelDb(&stats, MIC_AOP_DB);
 }
 
 //
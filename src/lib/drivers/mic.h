@@ -21,6 +21,10 @@ float micGetDB(const uint32_t *samples, uint32_t numSamples);
 /// This task notification index is used exclusively for I2S microphone events
 #define MIC_I2S_NOTIFY_INDEX 1
 
+/// Acoustic Overload Point for ICS-43434
+/// See https://invensense.tdk.com/wp-content/uploads/2016/02/DS-000069-ICS-43434-v1.2.pdf
+#define MIC_AOP_DB (120)
+
 #ifdef __cplusplus
 }
 #endif
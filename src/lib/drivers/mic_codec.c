@@ -0,0 +1,542 @@
+//
+// Hydrophone audio stream codec
+//
+// MIC_CODEC_RICE works like a FLAC "fixed" subframe: every packet picks the
+// polynomial predictor (order 0-4) with the smallest residuals, writes the
+// first <order> samples verbatim, then rice codes the residuals in
+// partitions of MIC_CODEC_PARTITION_LEN samples, each with its own rice
+// parameter. Fixed predictors don't need any coefficient math, so encoding
+// cost is a few operations per sample.
+//
+// Packets never depend on earlier packets (ADPCM packets carry the decoder
+// state they start from).
+//
+
+#include <string.h>
+#include "FreeRTOS.h"
+#include "mic_codec.h"
+#include "util.h"
+
+#define MIC_CODEC_MAX_ORDER (4)
+#define MIC_CODEC_PARTITION_LEN (64)
+#define MIC_CODEC_RICE_PARAM_BITS (5)
+#define MIC_CODEC_RICE_MAX_PARAM (29)
+
+// Residuals with a quotient this large are written as MIC_CODEC_RICE_ESCAPE
+// zeros followed by the raw (zigzag) value
+#define MIC_CODEC_RICE_ESCAPE (24)
+#define MIC_CODEC_RICE_ESCAPE_BITS (30)
+
+#define MIC_CODEC_ADPCM_BITS (16)
+
+typedef struct {
+  uint8_t *buff;
+  size_t len;
+  size_t offset;
+  uint64_t acc;
+  uint32_t numBits;
+  bool overflow;
+} bitWriter_t;
+
+typedef struct {
+  const uint8_t *buff;
+  size_t len;
+  size_t offset;
+  uint64_t acc;
+  uint32_t numBits;
+  bool underflow;
+} bitReader_t;
+
+// Payload that follows the header in ADPCM packets
+typedef struct {
+  int16_t predictor;
+  uint8_t stepIndex;
+  uint8_t reserved;
+  uint8_t data[0];
+} __attribute__((packed)) adpcmPayload_t;
+
+static const int8_t adpcmIndexTable[16] = {
+  -1, -1, -1, -1, 2, 4, 6, 8,
+  -1, -1, -1, -1, 2, 4, 6, 8,
+};
+
+static const int16_t adpcmStepTable[89] = {
+  7, 8, 9, 10, 11, 12, 13, 14, 16, 17, 19, 21, 23, 25, 28, 31, 34, 37, 41, 45,
+  50, 55, 60, 66, 73, 80, 88, 97, 107, 118, 130, 143, 157, 173, 190, 209, 230,
+  253, 279, 307, 337, 371, 408, 449, 494, 544, 598, 658, 724, 796, 876, 963,
+  1060, 1166, 1282, 1411, 1552, 1707, 1878, 2066, 2272, 2499, 2749, 3024, 3327,
+  3660, 4026, 4428, 4871, 5358, 5894, 6484, 7132, 7845, 8630, 9493, 10442,
+  11487, 12635, 13899, 15289, 16818, 18500, 20350, 22385, 24623, 27086, 29794,
+  32767
+};
+
+static void bitWrite(bitWriter_t *writer, uint32_t value, uint32_t numBits) {
+  writer->acc = (writer->acc << numBits) | (value & ((numBits < 32) ? ((1UL << numBits) - 1) : UINT32_MAX));
+  writer->numBits += numBits;
+
+  while(writer->numBits >= 8) {
+    writer->numBits -= 8;
+    if(writer->offset < writer->len) {
+      writer->buff[writer->offset++] = (uint8_t)(writer->acc >> writer->numBits);
+    } else {
+      writer->overflow = true;
+    }
+  }
+}
+
+/*!
+  Pad to a whole byte
+
+  \param[in] *writer - bit writer
+  \return number of bytes written
+*/
+static size_t bitFlush(bitWriter_t *writer) {
+  if(writer->numBits) {
+    bitWrite(writer, 0, 8 - writer->numBits);
+  }
+  return writer->offset;
+}
+
+static uint32_t bitRead(bitReader_t *reader, uint32_t numBits) {
+  while(reader->numBits < numBits) {
+    uint8_t byte = 0;
+    if(reader->offset < reader->len) {
+      byte = reader->buff[reader->offset++];
+    } else {
+      reader->underflow = true;
+    }
+    reader->acc = (reader->acc << 8) | byte;
+    reader->numBits += 8;
+  }
+
+  reader->numBits -= numBits;
+  return (uint32_t)(reader->acc >> reader->numBits) & ((numBits < 32) ? ((1UL << numBits) - 1) : UINT32_MAX);
+}
+
+static int32_t signExtend(uint32_t value, uint32_t numBits) {
+  return (int32_t)(value << (32 - numBits)) >> (32 - numBits);
+}
+
+/*!
+  24-bit sample (in a 32-bit word) truncated to codec sample width
+*/
+static inline int32_t sampleAt(const uint32_t *samples, uint32_t idx, uint8_t sampleBits) {
+  return ((int32_t)(samples[idx] << 8)) >> (32 - sampleBits);
+}
+
+/*!
+  Fixed polynomial predictor residual
+
+  \param[in] *samples - raw samples
+  \param[in] idx - sample index (must be >= order)
+  \param[in] order - predictor order
+  \param[in] sampleBits - sample width
+  \return residual
+*/
+static int32_t residualAt(const uint32_t *samples, uint32_t idx, uint8_t order, uint8_t sampleBits) {
+  int32_t x0 = sampleAt(samples, idx, sampleBits);
+  switch(order) {
+    case 0:
+      return x0;
+    case 1:
+      return x0 - sampleAt(samples, idx - 1, sampleBits);
+    case 2:
+      return x0 - 2 * sampleAt(samples, idx - 1, sampleBits) + sampleAt(samples, idx - 2, sampleBits);
+    case 3:
+      return x0 - 3 * sampleAt(samples, idx - 1, sampleBits) + 3 * sampleAt(samples, idx - 2, sampleBits)
+             - sampleAt(samples, idx - 3, sampleBits);
+    default:
+      return x0 - 4 * sampleAt(samples, idx - 1, sampleBits) + 6 * sampleAt(samples, idx - 2, sampleBits)
+             - 4 * sampleAt(samples, idx - 3, sampleBits) + sampleAt(samples, idx - 4, sampleBits);
+  }
+}
+
+static inline uint32_t zigzag(int32_t value) {
+  return ((uint32_t)value << 1) ^ (uint32_t)(value >> 31);
+}
+
+static inline int32_t unzigzag(uint32_t value) {
+  return (int32_t)(value >> 1) ^ -(int32_t)(value & 1);
+}
+
+/*!
+  Pick predictor order with the smallest total residual
+
+  \return predictor order
+*/
+static uint8_t riceBestOrder(const uint32_t *samples, uint32_t numSamples, uint8_t sampleBits) {
+  if(numSamples <= MIC_CODEC_MAX_ORDER) {
+    return 0;
+  }
+
+  // Each order's residual is the difference of the previous order's residuals
+  uint64_t total[MIC_CODEC_MAX_ORDER + 1] = {0};
+  int32_t last[MIC_CODEC_MAX_ORDER] = {0};
+  for(uint32_t idx = 0; idx < numSamples; idx++) {
+    int32_t residual = sampleAt(samples, idx, sampleBits);
+    for(uint8_t order = 0; order <= MIC_CODEC_MAX_ORDER; order++) {
+      if(idx >= MIC_CODEC_MAX_ORDER) {
+        total[order] += (residual < 0) ? -(int64_t)residual : residual;
+      }
+      if(order < MIC_CODEC_MAX_ORDER) {
+        int32_t next = residual - last[order];
+        last[order] = residual;
+        residual = next;
+      }
+    }
+  }
+
+  uint8_t bestOrder = 0;
+  for(uint8_t order = 1; order <= MIC_CODEC_MAX_ORDER; order++) {
+    if(total[order] < total[bestOrder]) {
+      bestOrder = order;
+    }
+  }
+
+  return bestOrder;
+}
+
+static size_t encodeRaw(const micCodec_t *codec, const uint32_t *samples, uint32_t numSamples, uint8_t *payload, size_t payloadLen) {
+  bitWriter_t writer = {.buff = payload, .len = payloadLen};
+  for(uint32_t idx = 0; idx < numSamples; idx++) {
+    bitWrite(&writer, (uint32_t)sampleAt(samples, idx, codec->sampleBits), codec->sampleBits);
+  }
+
+  size_t len = bitFlush(&writer);
+  return writer.overflow ? 0 : len;
+}
+
+static size_t encodeRice(const micCodec_t *codec, const uint32_t *samples, uint32_t numSamples, uint8_t *payload, size_t payloadLen) {
+  bitWriter_t writer = {.buff = payload, .len = payloadLen};
+
+  uint8_t order = riceBestOrder(samples, numSamples, codec->sampleBits);
+  bitWrite(&writer, order, 8);
+
+  // Warm up samples
+  for(uint32_t idx = 0; idx < MIN(order, numSamples); idx++) {
+    bitWrite(&writer, (uint32_t)sampleAt(samples, idx, codec->sampleBits), codec->sampleBits);
+  }
+
+  for(uint32_t start = 0; start < numSamples; start += MIC_CODEC_PARTITION_LEN) {
+    uint32_t first = MAX(start, order);
+    uint32_t end = MIN(start + MIC_CODEC_PARTITION_LEN, numSamples);
+    if(first >= end) {
+      continue;
+    }
+
+    uint64_t sum = 0;
+    for(uint32_t idx = first; idx < end; idx++) {
+      sum += zigzag(residualAt(samples, idx, order, codec->sampleBits));
+    }
+
+    // 2^param ~= mean residual
+    uint32_t param = 0;
+    while((param < MIC_CODEC_RICE_MAX_PARAM) && (((uint64_t)(end - first) << (param + 1)) <= sum)) {
+      param++;
+    }
+    bitWrite(&writer, param, MIC_CODEC_RICE_PARAM_BITS);
+
+    for(uint32_t idx = first; idx < end; idx++) {
+      uint32_t value = zigzag(residualAt(samples, idx, order, codec->sampleBits));
+      uint32_t quotient = value >> param;
+      if(quotient < MIC_CODEC_RICE_ESCAPE) {
+        // unary quotient, then remainder
+        bitWrite(&writer, 1, quotient + 1);
+        bitWrite(&writer, value, param);
+      } else {
+        bitWrite(&writer, 0, MIC_CODEC_RICE_ESCAPE);
+        bitWrite(&writer, value, MIC_CODEC_RICE_ESCAPE_BITS);
+      }
+    }
+
+    if(writer.overflow) {
+      return 0;
+    }
+  }
+
+  size_t len = bitFlush(&writer);
+  return writer.overflow ? 0 : len;
+}
+
+static uint8_t adpcmEncodeSample(int16_t *predictor, uint8_t *stepIndex, int16_t sample) {
+  int32_t step = adpcmStepTable[*stepIndex];
+  int32_t diff = sample - *predictor;
+  uint8_t nibble = 0;
+
+  if(diff < 0) {
+    nibble = 8;
+    diff = -diff;
+  }
+
+  // Quantize the same way the decoder reconstructs
+  int32_t delta = step >> 3;
+  if(diff >= step) {
+    nibble |= 4;
+    diff -= step;
+    delta += step;
+  }
+  step >>= 1;
+  if(diff >= step) {
+    nibble |= 2;
+    diff -= step;
+    delta += step;
+  }
+  step >>= 1;
+  if(diff >= step) {
+    nibble |= 1;
+    delta += step;
+  }
+
+  int32_t next = (nibble & 8) ? (*predictor - delta) : (*predictor + delta);
+  *predictor = (int16_t)MAX(MIN(next, INT16_MAX), INT16_MIN);
+  *stepIndex = (uint8_t)MAX(MIN((int32_t)*stepIndex + adpcmIndexTable[nibble], 88), 0);
+
+  return nibble;
+}
+
+static int16_t adpcmDecodeSample(int16_t *predictor, uint8_t *stepIndex, uint8_t nibble) {
+  int32_t step = adpcmStepTable[*stepIndex];
+  int32_t delta = step >> 3;
+  if(nibble & 4) {
+    delta += step;
+  }
+  if(nibble & 2) {
+    delta += step >> 1;
+  }
+  if(nibble & 1) {
+    delta += step >> 2;
+  }
+
+  int32_t next = (nibble & 8) ? (*predictor - delta) : (*predictor + delta);
+  *predictor = (int16_t)MAX(MIN(next, INT16_MAX), INT16_MIN);
+  *stepIndex = (uint8_t)MAX(MIN((int32_t)*stepIndex + adpcmIndexTable[nibble], 88), 0);
+
+  return *predictor;
+}
+
+static size_t encodeAdpcm(micCodec_t *codec, const uint32_t *samples, uint32_t numSamples, uint8_t *payload, size_t payloadLen) {
+  size_t len = sizeof(adpcmPayload_t) + (numSamples + 1) / 2;
+  if(len > payloadLen) {
+    return 0;
+  }
+
+  adpcmPayload_t *adpcm = (adpcmPayload_t *)payload;
+  adpcm->predictor = codec->adpcmPredictor;
+  adpcm->stepIndex = codec->adpcmStepIndex;
+  adpcm->reserved = 0;
+
+  // Two samples per byte, low nibble first
+  for(uint32_t idx = 0; idx < numSamples; idx++) {
+    uint8_t nibble = adpcmEncodeSample(&codec->adpcmPredictor, &codec->adpcmStepIndex,
+                                       (int16_t)sampleAt(samples, idx, MIC_CODEC_ADPCM_BITS));
+    if(idx & 1) {
+      adpcm->data[idx / 2] |= (uint8_t)(nibble << 4);
+    } else {
+      adpcm->data[idx / 2] = nibble;
+    }
+  }
+
+  return len;
+}
+
+/*!
+  Initialize encoder
+
+  \param[out] *codec - encoder
+  \param[in] type - codec to use
+  \param[in] sampleBits - bits per sample to keep (1-24, ignored for ADPCM)
+  \param[in] sampleRate - sample rate (Hz)
+  \return none
+*/
+void micCodecInit(micCodec_t *codec, micCodec_e type, uint8_t sampleBits, uint32_t sampleRate) {
+  configASSERT(codec);
+  configASSERT((sampleBits > 0) && (sampleBits <= 24));
+
+  memset(codec, 0, sizeof(micCodec_t));
+  codec->codec = type;
+  codec->sampleBits = (type == MIC_CODEC_ADPCM) ? MIC_CODEC_ADPCM_BITS : sampleBits;
+  codec->sampleRate = sampleRate;
+}
+
+/*!
+  Encode samples into a self contained packet
+
+  \param[in,out] *codec - encoder
+  \param[in] *samples - raw 24-bit samples (in 32-bit words)
+  \param[in] numSamples - number of samples (up to MIC_CODEC_MAX_SAMPLES)
+  \param[out] *packet - packet buffer
+  \param[in] packetLen - packet buffer size (MIC_CODEC_MAX_PACKET_LEN always fits)
+  \return packet length, 0 if it didn't fit
+*/
+size_t micCodecEncode(micCodec_t *codec, const uint32_t *samples, uint32_t numSamples, uint8_t *packet, size_t packetLen) {
+  configASSERT(codec);
+  configASSERT(samples);
+  configASSERT(packet);
+  configASSERT(numSamples <= MIC_CODEC_MAX_SAMPLES);
+
+  if(packetLen < sizeof(micCodecHeader_t)) {
+    return 0;
+  }
+
+  micCodecHeader_t *header = (micCodecHeader_t *)packet;
+  uint8_t *payload = &packet[sizeof(micCodecHeader_t)];
+  size_t payloadLen = MIN(packetLen - sizeof(micCodecHeader_t), UINT16_MAX);
+
+  micCodec_e type = codec->codec;
+  size_t len = 0;
+  if(type == MIC_CODEC_ADPCM) {
+    len = encodeAdpcm(codec, samples, numSamples, payload, payloadLen);
+  } else {
+    // Rice coding can't do better than raw on noise (or a signal that doesn't fit the predictor)
+    size_t rawLen = (numSamples * codec->sampleBits + 7) / 8;
+    if(type == MIC_CODEC_RICE) {
+      len = encodeRice(codec, samples, numSamples, payload, MIN(payloadLen, rawLen));
+    }
+
+    if(len == 0) {
+      type = MIC_CODEC_RAW;
+      len = encodeRaw(codec, samples, numSamples, payload, payloadLen);
+    }
+  }
+
+  if((len == 0) && (numSamples > 0)) {
+    return 0;
+  }
+
+  header->magic = MIC_CODEC_MAGIC;
+  header->sampleRate = codec->sampleRate;
+  header->sequence = codec->sequence++;
+  header->sampleOffset = codec->sampleOffset;
+  header->numSamples = (uint16_t)numSamples;
+  header->payloadLen = (uint16_t)len;
+  header->codec = (uint8_t)type;
+  header->sampleBits = codec->sampleBits;
+  header->reserved = 0;
+
+  codec->sampleOffset += numSamples;
+
+  return sizeof(micCodecHeader_t) + len;
+}
+
+/*!
+  Decode packet
+
+  \param[in] *packet - packet
+  \param[in] packetLen - packet length
+  \param[out] *samples - decoded samples (sign extended, header.sampleBits wide)
+  \param[in] maxSamples - size of samples buffer
+  \return number of samples decoded, -1 if the packet is invalid
+*/
+int32_t micCodecDecode(const uint8_t *packet, size_t packetLen, int32_t *samples, uint32_t maxSamples) {
+  configASSERT(packet);
+  configASSERT(samples);
+
+  if(packetLen < sizeof(micCodecHeader_t)) {
+    return -1;
+  }
+
+  micCodecHeader_t header;
+  memcpy(&header, packet, sizeof(header));
+  if((header.magic != MIC_CODEC_MAGIC) || (header.numSamples > maxSamples) ||
+     (header.sampleBits == 0) || (header.sampleBits > 24) ||
+     ((sizeof(micCodecHeader_t) + header.payloadLen) > packetLen)) {
+    return -1;
+  }
+
+  const uint8_t *payload = &packet[sizeof(micCodecHeader_t)];
+  bitReader_t reader = {.buff = payload, .len = header.payloadLen};
+
+  switch(header.codec) {
+    case MIC_CODEC_RAW: {
+      for(uint32_t idx = 0; idx < header.numSamples; idx++) {
+        samples[idx] = signExtend(bitRead(&reader, header.sampleBits), header.sampleBits);
+      }
+      break;
+    }
+
+    case MIC_CODEC_RICE: {
+      uint32_t order = bitRead(&reader, 8);
+      if(order > MIC_CODEC_MAX_ORDER) {
+        return -1;
+      }
+
+      for(uint32_t idx = 0; idx < MIN(order, header.numSamples); idx++) {
+        samples[idx] = signExtend(bitRead(&reader, header.sampleBits), header.sampleBits);
+      }
+
+      for(uint32_t start = 0; start < header.numSamples; start += MIC_CODEC_PARTITION_LEN) {
+        uint32_t first = MAX(start, order);
+        uint32_t end = MIN(start + MIC_CODEC_PARTITION_LEN, header.numSamples);
+        if(first >= end) {
+          continue;
+        }
+
+        uint32_t param = bitRead(&reader, MIC_CODEC_RICE_PARAM_BITS);
+        for(uint32_t idx = first; (idx < end) && !reader.underflow; idx++) {
+          uint32_t quotient = 0;
+          while((quotient < MIC_CODEC_RICE_ESCAPE) && !bitRead(&reader, 1) && !reader.underflow) {
+            quotient++;
+          }
+
+          uint32_t value;
+          if(quotient == MIC_CODEC_RICE_ESCAPE) {
+            value = bitRead(&reader, MIC_CODEC_RICE_ESCAPE_BITS);
+          } else {
+            value = (quotient << param) | bitRead(&reader, param);
+          }
+
+          int32_t residual = unzigzag(value);
+          switch(order) {
+            case 0:
+              samples[idx] = residual;
+              break;
+            case 1:
+              samples[idx] = residual + samples[idx - 1];
+              break;
+            case 2:
+              samples[idx] = residual + 2 * samples[idx - 1] - samples[idx - 2];
+              break;
+            case 3:
+              samples[idx] = residual + 3 * samples[idx - 1] - 3 * samples[idx - 2] + samples[idx - 3];
+              break;
+            default:
+              samples[idx] = residual + 4 * samples[idx - 1] - 6 * samples[idx - 2] + 4 * samples[idx - 3]
+                             - samples[idx - 4];
+              break;
+          }
+        }
+      }
+      break;
+    }
+
+    case MIC_CODEC_ADPCM: {
+      if(header.payloadLen < (sizeof(adpcmPayload_t) + (header.numSamples + 1) / 2)) {
+        return -1;
+      }
+
+      adpcmPayload_t adpcm;
+      memcpy(&adpcm, payload, sizeof(adpcm));
+      if(adpcm.stepIndex > 88) {
+        return -1;
+      }
+
+      int16_t predictor = adpcm.predictor;
+      uint8_t stepIndex = adpcm.stepIndex;
+      const uint8_t *data = &payload[sizeof(adpcmPayload_t)];
+      for(uint32_t idx = 0; idx < header.numSamples; idx++) {
+        uint8_t nibble = (idx & 1) ? (data[idx / 2] >> 4) : (data[idx / 2] & 0xF);
+        samples[idx] = adpcmDecodeSample(&predictor, &stepIndex, nibble);
+      }
+      break;
+    }
+
+    default:
+      return -1;
+  }
+
+  if(reader.underflow) {
+    return -1;
+  }
+
+  return header.numSamples;
+}
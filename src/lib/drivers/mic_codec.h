@@ -0,0 +1,70 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdbool.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/// Audio packets start with this
+#define MIC_CODEC_MAGIC 0xAD10C0DE
+
+/// Maximum number of samples per packet
+#define MIC_CODEC_MAX_SAMPLES (512)
+
+/// Largest possible packet (verbatim 24-bit samples)
+#define MIC_CODEC_MAX_PACKET_LEN (sizeof(micCodecHeader_t) + MIC_CODEC_MAX_SAMPLES * 3)
+
+typedef enum {
+  // Bit packed samples (sampleBits each)
+  MIC_CODEC_RAW = 0,
+  // Lossless. Fixed polynomial predictor (order 0-4) + partitioned rice coded residuals
+  MIC_CODEC_RICE = 1,
+  // Lossy. IMA-ADPCM, 4 bits per (16-bit) sample
+  MIC_CODEC_ADPCM = 2,
+} micCodec_e;
+
+//
+// Every packet can be decoded on its own, so losing a packet only loses
+// those samples.
+//
+typedef struct {
+  uint32_t magic;
+  uint32_t sampleRate;
+  // Increments every packet (gaps mean lost packets)
+  uint32_t sequence;
+  // Index of the first sample in the packet since sampling started
+  uint32_t sampleOffset;
+  uint16_t numSamples;
+  // Number of bytes after the header
+  uint16_t payloadLen;
+  // micCodec_e
+  uint8_t codec;
+  // Decoded sample width (24-bit samples are truncated to this)
+  uint8_t sampleBits;
+  uint16_t reserved;
+} __attribute__((packed)) micCodecHeader_t;
+
+typedef struct {
+  // Requested codec (MIC_CODEC_RICE falls back to MIC_CODEC_RAW when it doesn't help)
+  micCodec_e codec;
+  // 1-24 bits per sample (ADPCM always uses 16)
+  uint8_t sampleBits;
+  uint32_t sampleRate;
+
+  // Encoder state (zeroed by micCodecInit)
+  uint32_t sequence;
+  uint32_t sampleOffset;
+  int16_t adpcmPredictor;
+  uint8_t adpcmStepIndex;
+} micCodec_t;
+
+void micCodecInit(micCodec_t *codec, micCodec_e type, uint8_t sampleBits, uint32_t sampleRate);
+size_t micCodecEncode(micCodec_t *codec, const uint32_t *samples, uint32_t numSamples, uint8_t *packet, size_t packetLen);
+int32_t micCodecDecode(const uint8_t *packet, size_t packetLen, int32_t *samples, uint32_t maxSamples);
+
+#ifdef __cplusplus
+}
+#endif
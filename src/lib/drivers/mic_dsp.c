@@ -0,0 +1,467 @@
+//
+// Hydrophone spectral feature extraction
+//
+// Samples are gathered into MIC_DSP_FFT_LEN blocks, block normalized (so
+// quiet signals keep their resolution), Hann windowed and transformed with
+// a fixed-point (q31) real FFT. Bin powers are averaged over a frame of
+// blocks, from which the broadband level, third octave band levels and
+// the strongest spectral peaks are computed.
+//
+// All levels use the same reference as micGetDB (dB re 2^24 counts RMS),
+// plus the configured offset.
+//
+// NOTE: Not thread safe. Only one task should feed samples.
+//
+
+#include <math.h>
+#include <string.h>
+#include "FreeRTOS.h"
+#include "mic_dsp.h"
+#include "util.h"
+
+#define MIC_DSP_HALF_LEN (MIC_DSP_FFT_LEN / 2)
+
+// Sign extend 24-bit sample and scale to q31 with one bit of headroom
+// (the complex FFT of a real block can grow by sqrt(2))
+#define MIC_DSP_Q31_SHIFT (7)
+
+// 10*log10(2^48), reference level for 24-bit samples (matches micGetDB)
+#define MIC_DSP_REF_DB (144.4944f)
+
+// Power considered silence (avoids log of zero)
+#define MIC_DSP_MIN_POWER (1e-12f)
+
+#if (MIC_DSP_FFT_LEN & (MIC_DSP_FFT_LEN - 1))
+#error MIC_DSP_FFT_LEN MUST be a power of 2!!!
+#endif
+
+static micDspConfig_t _config;
+static float _binHz;
+static uint8_t _numBands;
+
+// N / sum(window^2), converts bin power to mean square
+static float _powerScale;
+
+static int16_t _window[MIC_DSP_FFT_LEN];
+static int32_t _cos[MIC_DSP_HALF_LEN];
+static int32_t _sin[MIC_DSP_HALF_LEN];
+static uint16_t _bandStartBin[MIC_DSP_NUM_BANDS + 1];
+
+static int32_t _block[MIC_DSP_FFT_LEN];
+static uint32_t _blockFill;
+
+static float _psd[MIC_DSP_NUM_BINS];
+static uint32_t _numBlocks;
+
+static int32_t q31FromDouble(double value) {
+  double scaled = value * 2147483648.0;
+  if(scaled >= 2147483647.0) {
+    return INT32_MAX;
+  } else if(scaled <= -2147483648.0) {
+    return INT32_MIN;
+  }
+  return (int32_t)lround(scaled);
+}
+
+/*!
+  Band edge frequency (lower edge of band)
+
+  \param[in] band band index (can be MIC_DSP_NUM_BANDS for the last upper edge)
+  \return edge frequency in Hz
+*/
+static float bandEdgeHz(uint8_t band) {
+  return 1000.0f * powf(10.0f, ((float)(band + MIC_DSP_FIRST_BAND) - 0.5f) / 10.0f);
+}
+
+/*!
+  Initialize feature extraction (window, twiddle tables, band edges)
+
+  \param[in] *config - configuration
+  \return none
+*/
+void micDspInit(const micDspConfig_t *config) {
+  configASSERT(config);
+  configASSERT(config->sampleRate > 0);
+
+  memcpy(&_config, config, sizeof(_config));
+  if(_config.blocksPerFrame == 0) {
+    _config.blocksPerFrame = 1;
+  }
+
+  _binHz = (float)_config.sampleRate / MIC_DSP_FFT_LEN;
+
+  // Periodic Hann window
+  double windowPowerSum = 0;
+  for(uint32_t idx = 0; idx < MIC_DSP_FFT_LEN; idx++) {
+    double window = 0.5 * (1.0 - cos(2.0 * M_PI * idx / MIC_DSP_FFT_LEN));
+    _window[idx] = (int16_t)MIN(lround(window * 32768.0), INT16_MAX);
+    windowPowerSum += ((double)_window[idx] / 32768.0) * ((double)_window[idx] / 32768.0);
+  }
+  _powerScale = (float)(MIC_DSP_FFT_LEN / windowPowerSum);
+
+  for(uint32_t idx = 0; idx < MIC_DSP_HALF_LEN; idx++) {
+    _cos[idx] = q31FromDouble(cos(2.0 * M_PI * idx / MIC_DSP_FFT_LEN));
+    _sin[idx] = q31FromDouble(sin(2.0 * M_PI * idx / MIC_DSP_FFT_LEN));
+  }
+
+  // Bins whose center frequency is within [lower edge, upper edge) belong to the band
+  _numBands = 0;
+  for(uint8_t band = 0; band <= MIC_DSP_NUM_BANDS; band++) {
+    float edge = bandEdgeHz(band);
+    _bandStartBin[band] = (uint16_t)MIN(ceilf(edge / _binHz), MIC_DSP_NUM_BINS);
+    if((band > 0) && (edge <= (_config.sampleRate / 2.0f))) {
+      _numBands = band;
+    }
+  }
+
+  memset(_psd, 0, sizeof(_psd));
+  _numBlocks = 0;
+  _blockFill = 0;
+}
+
+/*!
+  Change number of FFT blocks averaged into each feature frame
+
+  \param[in] blocksPerFrame - number of blocks (minimum 1)
+  \return none
+*/
+void micDspSetBlocksPerFrame(uint32_t blocksPerFrame) {
+  _config.blocksPerFrame = MAX(blocksPerFrame, 1);
+}
+
+uint32_t micDspGetBlocksPerFrame(void) {
+  return _config.blocksPerFrame;
+}
+
+/*!
+  Center frequency of third octave band
+
+  \param[in] band band index
+  \return center frequency in Hz
+*/
+float micDspCenterHz(uint8_t band) {
+  return 1000.0f * powf(10.0f, (float)(band + MIC_DSP_FIRST_BAND) / 10.0f);
+}
+
+/*!
+  Convert 24-bit samples to block normalized, windowed q31 values. Can be
+  done in place (samples == buff).
+
+  \param[in] *samples - MIC_DSP_FFT_LEN raw 24-bit samples (in 32-bit words)
+  \param[out] *buff - MIC_DSP_FFT_LEN q31 values
+  \return normalization shift (extra left shift applied to every sample)
+*/
+int32_t micDspLoadBlock(const uint32_t *samples, int32_t *buff) {
+  uint32_t maxAbs = 0;
+  for(uint32_t idx = 0; idx < MIC_DSP_FFT_LEN; idx++) {
+    int32_t sample = ((int32_t)(samples[idx] << 8)) >> 8;
+    uint32_t absSample = (sample < 0) ? (uint32_t)(-sample) : (uint32_t)sample;
+    maxAbs = MAX(maxAbs, absSample);
+  }
+
+  // Scale the largest sample up to (but not past) 24-bit full scale
+  int32_t shift = 0;
+  if(maxAbs) {
+    shift = MAX(__builtin_clz(maxAbs) - 9, 0);
+  }
+
+  for(uint32_t idx = 0; idx < MIC_DSP_FFT_LEN; idx++) {
+    int32_t sample = (int32_t)(samples[idx] << 8) >> 8;
+    int32_t value = (int32_t)((uint32_t)sample << (MIC_DSP_Q31_SHIFT + shift));
+    buff[idx] = (int32_t)(((int64_t)value * _window[idx]) >> 15);
+  }
+
+  return shift;
+}
+
+/*!
+  In place, scaled (by 1/N) fixed-point real FFT. Done as a N/2 complex FFT
+  of the even/odd samples followed by a split step.
+
+  \param[in,out] *buff - MIC_DSP_FFT_LEN q31 values in, MIC_DSP_FFT_LEN/2
+                         complex q31 (re, im) bins out. buff[0] is DC and
+                         buff[1] is nyquist (both real).
+  \return none
+*/
+void micDspRealFft(int32_t *buff) {
+  const uint32_t len = MIC_DSP_HALF_LEN;
+
+  // Bit reversal permutation (complex pairs)
+  for(uint32_t idx = 1, rev = 0; idx < len; idx++) {
+    uint32_t bit = len >> 1;
+    for(; rev & bit; bit >>= 1) {
+      rev ^= bit;
+    }
+    rev ^= bit;
+
+    if(idx < rev) {
+      int32_t re = buff[2 * idx];
+      int32_t im = buff[2 * idx + 1];
+      buff[2 * idx] = buff[2 * rev];
+      buff[2 * idx + 1] = buff[2 * rev + 1];
+      buff[2 * rev] = re;
+      buff[2 * rev + 1] = im;
+    }
+  }
+
+  // Radix-2 butterflies, scaled by 1/2 every stage
+  for(uint32_t span = 2; span <= len; span <<= 1) {
+    uint32_t half = span >> 1;
+    uint32_t twiddleStep = MIC_DSP_FFT_LEN / span;
+
+    for(uint32_t offset = 0; offset < half; offset++) {
+      int64_t wr = _cos[offset * twiddleStep];
+      int64_t ws = _sin[offset * twiddleStep];
+
+      for(uint32_t start = offset; start < len; start += span) {
+        int32_t *a = &buff[2 * start];
+        int32_t *b = &buff[2 * (start + half)];
+
+        // t = b * e^(-j*theta)
+        int64_t tr = ((int64_t)b[0] * wr + (int64_t)b[1] * ws) >> 31;
+        int64_t ti = ((int64_t)b[1] * wr - (int64_t)b[0] * ws) >> 31;
+
+        int64_t ar = a[0];
+        int64_t ai = a[1];
+        a[0] = (int32_t)((ar + tr) >> 1);
+        a[1] = (int32_t)((ai + ti) >> 1);
+        b[0] = (int32_t)((ar - tr) >> 1);
+        b[1] = (int32_t)((ai - ti) >> 1);
+      }
+    }
+  }
+
+  // Split the N/2 point complex FFT into the N point real FFT
+  int64_t dc = buff[0];
+  int64_t ny = buff[1];
+  buff[0] = (int32_t)((dc + ny) >> 1);
+  buff[1] = (int32_t)((dc - ny) >> 1);
+
+  for(uint32_t k = 1; k <= (len / 2); k++) {
+    int32_t *zk = &buff[2 * k];
+    int32_t *zmk = &buff[2 * (len - k)];
+
+    // Even samples spectrum
+    int64_t er = ((int64_t)zk[0] + zmk[0]) >> 1;
+    int64_t ei = ((int64_t)zk[1] - zmk[1]) >> 1;
+
+    // Odd samples spectrum (-j * (Z[k] - conj(Z[N/2 - k])) / 2)
+    int64_t odr = ((int64_t)zk[1] + zmk[1]) >> 1;
+    int64_t odi = -(((int64_t)zk[0] - zmk[0]) >> 1);
+
+    // t = odd * e^(-j*2*pi*k/N)
+    int64_t tr = (odr * _cos[k] + odi * _sin[k]) >> 31;
+    int64_t ti = (odi * _cos[k] - odr * _sin[k]) >> 31;
+
+    zk[0] = (int32_t)((er + tr) >> 1);
+    zk[1] = (int32_t)((ei + ti) >> 1);
+    zmk[0] = (int32_t)((er - tr) >> 1);
+    zmk[1] = (int32_t)(-((ei - ti) >> 1));
+  }
+}
+
+/*!
+  Add block power spectrum to accumulator. Bin powers are scaled so they sum
+  to the block's mean square value (in 24-bit sample counts^2).
+
+  \param[in] *fft - micDspRealFft output
+  \param[in] shift - micDspLoadBlock normalization shift
+  \param[in,out] *psd - MIC_DSP_NUM_BINS accumulator
+  \return none
+*/
+void micDspAccumulatePower(const int32_t *fft, int32_t shift, float *psd) {
+  float scale = ldexpf(_powerScale, -2 * (MIC_DSP_Q31_SHIFT + shift));
+
+  float dc = (float)fft[0];
+  float ny = (float)fft[1];
+  psd[0] += dc * dc * scale;
+  psd[MIC_DSP_HALF_LEN] += ny * ny * scale;
+
+  // Fold negative frequencies in
+  scale *= 2.0f;
+  for(uint32_t k = 1; k < MIC_DSP_HALF_LEN; k++) {
+    float re = (float)fft[2 * k];
+    float im = (float)fft[2 * k + 1];
+    psd[k] += (re * re + im * im) * scale;
+  }
+}
+
+/*!
+  Total power in third octave band. Bands narrower than a bin use the bin
+  containing the band center, scaled by the band's share of it.
+
+  \param[in] *psd - averaged power spectrum
+  \param[in] band - band index
+  \return band power (mean square, counts^2), 0 if band is above nyquist
+*/
+float micDspBandPower(const float *psd, uint8_t band) {
+  configASSERT(psd);
+  if(band >= _numBands) {
+    return 0;
+  }
+
+  float power = 0;
+  uint16_t start = _bandStartBin[band];
+  uint16_t end = _bandStartBin[band + 1];
+  if(end > start) {
+    for(uint16_t bin = start; bin < end; bin++) {
+      power += psd[bin];
+    }
+  } else {
+    uint32_t bin = (uint32_t)lroundf(micDspCenterHz(band) / _binHz);
+    power = psd[MIN(bin, MIC_DSP_NUM_BINS - 1)] * (bandEdgeHz(band + 1) - bandEdgeHz(band)) / _binHz;
+  }
+
+  return power;
+}
+
+/*!
+  Find the strongest spectral peaks
+
+  \param[in] *psd - averaged power spectrum
+  \param[in] thresholdDb - minimum peak height above the log-average bin power
+  \param[out] *peaks - peaks found, strongest first
+  \param[in] maxPeaks - maximum number of peaks to return
+  \return number of peaks found
+*/
+uint32_t micDspFindPeaks(const float *psd, float thresholdDb, micDspPeak_t *peaks, uint32_t maxPeaks) {
+  configASSERT(psd);
+  configASSERT(peaks);
+  configASSERT(maxPeaks <= MIC_DSP_MAX_PEAKS);
+
+  // Log-average (geometric mean) spectrum level, so a few strong tones
+  // don't raise the threshold for the others
+  float meanDb = 0;
+  for(uint32_t bin = 1; bin < MIC_DSP_HALF_LEN; bin++) {
+    meanDb += log10f(psd[bin] + MIC_DSP_MIN_POWER);
+  }
+  meanDb /= (MIC_DSP_HALF_LEN - 1);
+  float threshold = powf(10.0f, meanDb + thresholdDb / 10.0f);
+
+  float peakPower[MIC_DSP_MAX_PEAKS];
+  uint32_t numPeaks = 0;
+
+  for(uint32_t bin = 1; bin < MIC_DSP_HALF_LEN; bin++) {
+    if((psd[bin] <= threshold) || (psd[bin] <= psd[bin - 1]) || (psd[bin] < psd[bin + 1])) {
+      continue;
+    }
+
+    // The window spreads a tone over a few bins, add them all up
+    float power = 0;
+    for(uint32_t idx = MAX(bin, 3) - 2; idx <= MIN(bin + 2, MIC_DSP_HALF_LEN); idx++) {
+      power += psd[idx];
+    }
+
+    // Find where this goes, strongest first
+    uint32_t pos = numPeaks;
+    while((pos > 0) && (peakPower[pos - 1] < power)) {
+      pos--;
+    }
+    if(pos >= maxPeaks) {
+      continue;
+    }
+    numPeaks = MIN(numPeaks + 1, maxPeaks);
+    for(uint32_t idx = numPeaks - 1; idx > pos; idx--) {
+      peakPower[idx] = peakPower[idx - 1];
+      peaks[idx] = peaks[idx - 1];
+    }
+
+    // Parabolic interpolation (on dB values) for the peak frequency
+    float left = 10.0f * log10f(psd[bin - 1] + MIC_DSP_MIN_POWER);
+    float center = 10.0f * log10f(psd[bin] + MIC_DSP_MIN_POWER);
+    float right = 10.0f * log10f(psd[bin + 1] + MIC_DSP_MIN_POWER);
+    float denominator = left - 2.0f * center + right;
+    float delta = (denominator < 0) ? (0.5f * (left - right) / denominator) : 0;
+
+    peakPower[pos] = power;
+    peaks[pos].freqHz = (uint16_t)MIN(lroundf(((float)bin + delta) * _binHz), UINT16_MAX);
+    peaks[pos].level = micDspPowerToLevel(power);
+  }
+
+  return numPeaks;
+}
+
+/*!
+  Convert power (mean square, counts^2) to level
+
+  \param[in] power - mean square value
+  \return level in dB * 100
+*/
+int16_t micDspPowerToLevel(float power) {
+  float db = _config.dbOffset + 10.0f * log10f(MAX(power, MIC_DSP_MIN_POWER)) - MIC_DSP_REF_DB;
+  long level = lroundf(db * 100.0f);
+  return (int16_t)MAX(MIN(level, INT16_MAX), INT16_MIN + 1);
+}
+
+/*!
+  Feed samples into feature extraction. Samples don't need to line up with
+  FFT blocks.
+
+  \param[in] *samples - raw 24-bit samples (in 32-bit words)
+  \param[in] numSamples - number of samples
+  \return true if a feature frame is ready (see micDspGetFeatures)
+*/
+bool micDspProcess(const uint32_t *samples, uint32_t numSamples) {
+  configASSERT(samples || (numSamples == 0));
+
+  while(numSamples) {
+    uint32_t count = MIN(numSamples, MIC_DSP_FFT_LEN - _blockFill);
+    memcpy(&_block[_blockFill], samples, count * sizeof(uint32_t));
+    _blockFill += count;
+    samples += count;
+    numSamples -= count;
+
+    if(_blockFill == MIC_DSP_FFT_LEN) {
+      int32_t shift = micDspLoadBlock((const uint32_t *)_block, _block);
+      micDspRealFft(_block);
+      micDspAccumulatePower(_block, shift, _psd);
+      _numBlocks++;
+      _blockFill = 0;
+    }
+  }
+
+  return (_numBlocks >= _config.blocksPerFrame);
+}
+
+/*!
+  Compute features from the blocks processed since the last frame, then
+  start a new frame
+
+  \param[out] *features - feature frame
+  \return false if no blocks have been processed
+*/
+bool micDspGetFeatures(micDspFeatures_t *features) {
+  configASSERT(features);
+
+  if(_numBlocks == 0) {
+    return false;
+  }
+
+  memset(features, 0, sizeof(micDspFeatures_t));
+
+  float broadband = 0;
+  for(uint32_t bin = 0; bin < MIC_DSP_NUM_BINS; bin++) {
+    _psd[bin] /= _numBlocks;
+    // Leave DC out
+    if(bin > 0) {
+      broadband += _psd[bin];
+    }
+  }
+
+  features->sampleRate = _config.sampleRate;
+  features->numBlocks = (uint16_t)MIN(_numBlocks, UINT16_MAX);
+  features->broadbandLevel = micDspPowerToLevel(broadband);
+
+  features->numBands = _numBands;
+  for(uint8_t band = 0; band < MIC_DSP_NUM_BANDS; band++) {
+    features->bandLevel[band] = (band < _numBands) ? micDspPowerToLevel(micDspBandPower(_psd, band))
+                                                   : MIC_DSP_NO_LEVEL;
+  }
+
+  features->numPeaks = (uint8_t)micDspFindPeaks(_psd, _config.peakThresholdDb, features->peaks, MIC_DSP_MAX_PEAKS);
+
+  memset(_psd, 0, sizeof(_psd));
+  _numBlocks = 0;
+
+  return true;
+}
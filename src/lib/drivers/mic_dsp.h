@@ -0,0 +1,77 @@
+#pragma once
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/// FFT length (samples per block). Matches the mic DMA half buffer
+#define MIC_DSP_FFT_LEN (1024)
+
+/// Number of power spectrum bins (DC to nyquist)
+#define MIC_DSP_NUM_BINS (MIC_DSP_FFT_LEN / 2 + 1)
+
+/// Third octave bands from 200Hz to 20kHz (base 10 center frequencies)
+#define MIC_DSP_NUM_BANDS (21)
+#define MIC_DSP_FIRST_BAND (-7)
+
+/// Maximum number of spectral peaks per feature frame
+#define MIC_DSP_MAX_PEAKS (4)
+
+/// Level reported for bands with no data (above nyquist)
+#define MIC_DSP_NO_LEVEL (INT16_MIN)
+
+typedef struct {
+  // Sample rate in Hz
+  uint32_t sampleRate;
+  // Number of FFT blocks averaged into each feature frame
+  uint32_t blocksPerFrame;
+  // Peaks must be at least this far above the average spectrum level
+  float peakThresholdDb;
+  // Added to every level (use MIC_AOP_DB for levels comparable to micGetDB)
+  float dbOffset;
+} micDspConfig_t;
+
+typedef struct {
+  // Peak frequency in Hz (interpolated between bins)
+  uint16_t freqHz;
+  // Peak level in dB * 100
+  int16_t level;
+} __attribute__((packed)) micDspPeak_t;
+
+//
+// Compact feature frame. All levels in dB * 100
+//
+typedef struct {
+  uint32_t sampleRate;
+  // Number of FFT blocks averaged into this frame
+  uint16_t numBlocks;
+  int16_t broadbandLevel;
+  uint8_t numBands;
+  uint8_t numPeaks;
+  // Third octave band levels, starting at micDspCenterHz(0)
+  int16_t bandLevel[MIC_DSP_NUM_BANDS];
+  // Strongest peaks first
+  micDspPeak_t peaks[MIC_DSP_MAX_PEAKS];
+} __attribute__((packed)) micDspFeatures_t;
+
+void micDspInit(const micDspConfig_t *config);
+bool micDspProcess(const uint32_t *samples, uint32_t numSamples);
+bool micDspGetFeatures(micDspFeatures_t *features);
+void micDspSetBlocksPerFrame(uint32_t blocksPerFrame);
+uint32_t micDspGetBlocksPerFrame(void);
+
+// DSP kernels (used by micDspProcess, exposed for testing)
+int32_t micDspLoadBlock(const uint32_t *samples, int32_t *buff);
+void micDspRealFft(int32_t *buff);
+void micDspAccumulatePower(const int32_t *fft, int32_t shift, float *psd);
+float micDspBandPower(const float *psd, uint8_t band);
+uint32_t micDspFindPeaks(const float *psd, float thresholdDb, micDspPeak_t *peaks, uint32_t maxPeaks);
+float micDspCenterHz(uint8_t band);
+int16_t micDspPowerToLevel(float power);
+
+#ifdef __cplusplus
+}
+#endif
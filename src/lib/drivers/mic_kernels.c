@@ -0,0 +1,142 @@
+//
+// Hydrophone sample kernels
+//
+// The SAI DMA buffer holds one 24-bit sample per 32-bit word. Everything
+// that needs to look at every sample (level, peak, int16 conversion) is
+// done in a single pass here instead of one loop per consumer.
+//
+// On cores with the DSP extension (Cortex-M33) two int16 samples are
+// packed into a word with PKHTB and stored together. The statistics are
+// computed on the full 24-bit samples in both paths, so the results are
+// identical on host and target.
+//
+
+#include <math.h>
+#include <string.h>
+#include "mic_kernels.h"
+
+#if defined(__ARM_FEATURE_DSP) && (__ARM_FEATURE_DSP == 1)
+#include "cmsis_compiler.h"
+#define MIC_KERNEL_DSP
+#endif
+
+/*!
+  Reset running sample statistics
+
+  \param[out] *stats - statistics to reset
+  \return none
+*/
+void micKernelStatsInit(micKernelStats_t *stats) {
+  stats->sumSquares = 0;
+  stats->min = INT32_MAX;
+  stats->max = INT32_MIN;
+  stats->numSamples = 0;
+}
+
+// Split out so the compiler generates a separate loop with and without
+// the int16 output
+static inline __attribute__((always_inline)) void process(const uint32_t *samples, uint32_t numSamples, int16_t *out, micKernelStats_t *stats, bool pack) {
+  uint64_t sumSquares = stats->sumSquares;
+  int32_t min = stats->min;
+  int32_t max = stats->max;
+  uint32_t idx = 0;
+
+#ifdef MIC_KERNEL_DSP
+  for(; idx + 2 <= numSamples; idx += 2) {
+    // Shift the 24-bit samples to the top of the word, which puts the
+    // int16 values in the top halfwords
+    int32_t hi0 = (int32_t)(samples[idx] << 8);
+    int32_t hi1 = (int32_t)(samples[idx + 1] << 8);
+
+    if(pack) {
+      uint32_t packed = __PKHTB(hi1, hi0, 16);
+      memcpy(&out[idx], &packed, sizeof(packed));
+    }
+
+    int32_t s0 = hi0 >> 8;
+    int32_t s1 = hi1 >> 8;
+    sumSquares += (uint64_t)((int64_t)s0 * s0);
+    sumSquares += (uint64_t)((int64_t)s1 * s1);
+    min = (s0 < min) ? s0 : min;
+    max = (s0 > max) ? s0 : max;
+    min = (s1 < min) ? s1 : min;
+    max = (s1 > max) ? s1 : max;
+  }
+#endif
+
+  for(; idx < numSamples; idx++) {
+    int32_t sample = ((int32_t)(samples[idx] << 8)) >> 8;
+    if(pack) {
+      out[idx] = (int16_t)(sample >> 8);
+    }
+
+    sumSquares += (uint64_t)((int64_t)sample * sample);
+    min = (sample < min) ? sample : min;
+    max = (sample > max) ? sample : max;
+  }
+
+  stats->sumSquares = sumSquares;
+  stats->min = min;
+  stats->max = max;
+  stats->numSamples += numSamples;
+}
+
+/*!
+  Single pass over a buffer of 24-bit samples. Sign extends, optionally
+  converts to int16 (top 16 bits) and accumulates sum of squares and
+  min/max.
+
+  \param[in] *samples - 24-bit samples (in 32-bit words)
+  \param[in] numSamples - number of samples
+  \param[out] *out - int16 samples (numSamples long). NULL to skip conversion
+  \param[in,out] *stats - running statistics (see micKernelStatsInit)
+  \return none
+*/
+void micKernelProcess(const uint32_t *samples, uint32_t numSamples, int16_t *out, micKernelStats_t *stats) {
+  if(out) {
+    process(samples, numSamples, out, stats, true);
+  } else {
+    process(samples, numSamples, NULL, stats, false);
+  }
+}
+
+/*!
+  Largest sample magnitude
+
+  \param[in] *stats - sample statistics
+  \return peak magnitude (0 - MIC_KERNEL_FULL_SCALE)
+*/
+uint32_t micKernelPeak(const micKernelStats_t *stats) {
+  if(!stats->numSamples) {
+    return 0;
+  }
+
+  uint32_t peakPos = (stats->max > 0) ? (uint32_t)stats->max : 0;
+  uint32_t peakNeg = (stats->min < 0) ? (uint32_t)(-stats->min) : 0;
+  return (peakPos > peakNeg) ? peakPos : peakNeg;
+}
+
+/*!
+  RMS sample value
+
+  \param[in] *stats - sample statistics
+  \return RMS in 24-bit counts
+*/
+float micKernelRms(const micKernelStats_t *stats) {
+  if(!stats->numSamples) {
+    return 0;
+  }
+
+  return sqrtf((float)stats->sumSquares / (float)stats->numSamples);
+}
+
+/*!
+  Sound level (same reference as micGetDB)
+
+  \param[in] *stats - sample statistics
+  \param[in] aopDb - microphone acoustic overload point
+  \return sound level in dB
+*/
+float micKernelDb(const micKernelStats_t *stats, float aopDb) {
+  return aopDb + 20.0f * log10f(micKernelRms(stats)/(1<<24));
+}
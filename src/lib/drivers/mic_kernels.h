@@ -0,0 +1,33 @@
+#pragma once
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/// Largest magnitude of a (sign extended) 24-bit sample
+#define MIC_KERNEL_FULL_SCALE (1 << 23)
+
+//
+// Running statistics for 24-bit samples. Can be accumulated over several
+// buffers (up to 2^17 samples before sumSquares can overflow).
+//
+typedef struct {
+  // Sum of squares of the sign extended 24-bit samples (exact)
+  uint64_t sumSquares;
+  int32_t min;
+  int32_t max;
+  uint32_t numSamples;
+} micKernelStats_t;
+
+void micKernelStatsInit(micKernelStats_t *stats);
+void micKernelProcess(const uint32_t *samples, uint32_t numSamples, int16_t *out, micKernelStats_t *stats);
+uint32_t micKernelPeak(const micKernelStats_t *stats);
+float micKernelRms(const micKernelStats_t *stats);
+float micKernelDb(const micKernelStats_t *stats, float aopDb);
+
+#ifdef __cplusplus
+}
+#endif
@@ -48,18 +48,35 @@ bool MS5803::readPTRaw(float &pressure, float &temperature) {
     uint32_t rawTemperature = 0;
     uint32_t rawPressure = 0;
 
-    // 10ms conversion delay for 4096
-    rval = getRawValue(CMD_CONV_D2_4096, &rawTemperature, 10, 10);
+    rval = getRawValue(CMD_CONV_D2_4096, &rawTemperature, 10, MS5803_CONVERSION_TIME_MS);
     if (!rval) {
       break;
     }
 
-    // 10ms conversion delay for 4096
-    rval = getRawValue(CMD_CONV_D1_4096, &rawPressure, 10, 10);
+    rval = getRawValue(CMD_CONV_D1_4096, &rawPressure, 10, MS5803_CONVERSION_TIME_MS);
     if (!rval) {
       break;
     }
 
+    rval = compensate(rawPressure, rawTemperature, pressure, temperature);
+  } while (0);
+
+  return rval;
+}
+
+/*!
+  Compute compensated pressure and temperature from raw conversion values
+
+  \param[in] rawPressure raw pressure (D1) conversion
+  \param[in] rawTemperature raw temperature (D2) conversion
+  \param[out] pressure variable in which to store pressure in mbar
+  \param[out] temperature variable in which to store temperature in C
+  \return true if values are in range false otherwise
+*/
+bool MS5803::compensate(uint32_t rawPressure, uint32_t rawTemperature, float &pressure, float &temperature) {
+  bool rval = true;
+
+  do {
     int32_t dT = rawTemperature - _PROM.T_REF * (1UL << 8);
     int64_t off = (int64_t)_PROM.OFF * (1UL << 17) + ((int64_t)dT * (int64_t)_PROM.TCO)/(1UL << 6);
     int64_t sens = (int64_t)_PROM.SENS * (1UL << 16) + ((int64_t)dT * (int64_t)_PROM.TCS)/(1UL << 7);
@@ -129,14 +146,37 @@ bool MS5803::getRawValue(MS5803Cmd_t command, uint32_t *value, uint32_t timeoutM
 
     vTaskDelay(pdMS_TO_TICKS(delayMs)); // 10ms delay for conversion
 
-    uint8_t adc[3] = {0,0,0};
-    rval = readData(CMD_ADC_READ, adc, sizeof(adc));
-    if(!rval) {
-      break;
-    }
+    rval = readConversion(value);
+  } while (0);
+
+  return rval;
+}
 
+/*!
+  Start a pressure (D1) or temperature (D2) conversion. The result can be
+  read with readConversion() after MS5803_CONVERSION_TIME_MS.
+
+  \param[in] command Command to start measurement (for D1 or D2)
+  \return true if successfull false otherwise
+*/
+bool MS5803::startConversion(MS5803Cmd_t command) {
+  return sendCommand(command, 10);
+}
+
+/*!
+  Read result of a previously started conversion
+
+  \param[out] *value pointer to variable in which to store raw value
+  \return true if successfull false otherwise
+*/
+bool MS5803::readConversion(uint32_t *value) {
+  configASSERT(value != NULL);
+
+  uint8_t adc[3] = {0,0,0};
+  bool rval = readData(CMD_ADC_READ, adc, sizeof(adc));
+  if(rval) {
     *value = ((uint32_t)adc[0] << 16) + ((uint32_t)adc[1] << 8) + (uint32_t)adc[2];
-  } while (0);
+  }
 
   return rval;
 }
@@ -6,6 +6,9 @@
 
 // Using the MS5803_02BA
 
+/// Conversion time for OSR 4096 (9.04ms max)
+#define MS5803_CONVERSION_TIME_MS (10)
+
 typedef enum {
   CMD_RESET         = 0x1E,
   CMD_CONV_D1_256   = 0x40,
@@ -60,6 +63,12 @@ public:
   bool checkPROM();
   uint32_t signature();
 
+  // Non-blocking sampling. Start a conversion, wait (at least)
+  // MS5803_CONVERSION_TIME_MS, then read it.
+  bool startConversion(MS5803Cmd_t command);
+  bool readConversion(uint32_t *value);
+  bool compensate(uint32_t rawPressure, uint32_t rawTemperature, float &pressure, float &temperature);
+
 private:
   bool readPROM();
   bool sendCommand(MS5803Cmd_t command, uint32_t timeoutMs);
@@ -0,0 +1,451 @@
+#include <string.h>
+#include "FreeRTOS.h"
+#include "task.h"
+#include "stm32u5xx_hal.h"
+#include "i2c_engine.h"
+#include "lpm.h"
+
+// List of registered engines, so HAL callbacks can find theirs
+static i2cEngine_t *_engines;
+
+static void engineStartNext(i2cEngine_t *engine, bool fromISR);
+
+// Translate HAL i2c error codes to ours
+static I2CResponse_t halErrToI2CResponse(uint32_t errorCode) {
+  I2CResponse_t rval = I2C_ERR; // Generic error
+
+  if(errorCode & HAL_I2C_ERROR_AF) {
+    rval = I2C_NACK;
+  } else if(errorCode & HAL_I2C_ERROR_TIMEOUT) {
+    rval = I2C_TIMEOUT;
+  } else if(errorCode == 0) {
+    rval = I2C_OK;
+  }
+
+  return rval;
+}
+
+/*!
+  Get the HAL sequential transfer frame option for an operation.
+  A frame starts (with a start condition) on the first op or when the address
+  changes and ends (with a stop condition) on the last op or before the
+  address changes. The HAL generates a repeated start when the direction
+  changes within a frame.
+
+  \param[in] *transaction - transaction
+  \param[in] idx - operation index
+  \return HAL frame option
+*/
+static uint32_t frameOption(const i2cTransaction_t *transaction, int16_t idx) {
+  const i2cOp_t *ops = transaction->ops;
+  bool first = (idx == 0) || (ops[idx - 1].address != ops[idx].address);
+  bool last = (idx == transaction->numOps - 1) || (ops[idx + 1].address != ops[idx].address);
+
+  if(first && last) {
+    return I2C_FIRST_AND_LAST_FRAME;
+  } else if(first) {
+    return I2C_FIRST_FRAME;
+  } else if(last) {
+    return I2C_LAST_FRAME;
+  } else {
+    return I2C_NEXT_FRAME;
+  }
+}
+
+/*!
+  Start the current operation of the active transaction
+
+  \param[in] *engine - i2c engine
+  \return HAL status
+*/
+static HAL_StatusTypeDef engineStartOp(i2cEngine_t *engine) {
+  i2cTransaction_t *transaction = engine->head;
+
+  if(transaction->opIdx < 0) {
+    // Select mux channel first
+    engine->muxBuff = transaction->muxChannel;
+    return HAL_I2C_Master_Seq_Transmit_IT(engine->handle, transaction->mux->address << 1,
+                                          &engine->muxBuff, sizeof(engine->muxBuff),
+                                          I2C_FIRST_AND_LAST_FRAME);
+  }
+
+  const i2cOp_t *op = &transaction->ops[transaction->opIdx];
+  uint32_t option = frameOption(transaction, transaction->opIdx);
+  if(op->type == I2C_OP_READ) {
+    return HAL_I2C_Master_Seq_Receive_IT(engine->handle, op->address << 1, op->buff, op->len, option);
+  } else {
+    return HAL_I2C_Master_Seq_Transmit_IT(engine->handle, op->address << 1, op->buff, op->len, option);
+  }
+}
+
+/*!
+  Remove the active transaction from the queue, mark it as done and start
+  the next one.
+
+  \param[in] *engine - i2c engine
+  \param[in] result - transaction result
+  \param[in] fromISR - called from interrupt context
+  \return none
+*/
+static void engineComplete(i2cEngine_t *engine, I2CResponse_t result, bool fromISR) {
+  i2cTransaction_t *transaction = engine->head;
+
+  engine->head = transaction->next;
+  if(engine->head == NULL) {
+    engine->tail = NULL;
+  }
+  engine->queueLen--;
+  transaction->next = NULL;
+
+  engine->stats.transactions++;
+  if(result != I2C_OK) {
+    engine->stats.errors++;
+    // Bus state is unknown after an error, so select the mux channel again
+    if(transaction->mux != NULL) {
+      transaction->mux->channel = (uint8_t)~transaction->muxChannel;
+    }
+  }
+
+  transaction->result = result;
+  transaction->done = true;
+  if(transaction->callback != NULL) {
+    transaction->callback(transaction);
+  }
+
+  engineStartNext(engine, fromISR);
+}
+
+/*!
+  Start the transaction at the head of the queue (if any). Goes idle when the
+  queue is empty (or the engine is held).
+
+  \param[in] *engine - i2c engine
+  \param[in] fromISR - called from interrupt context
+  \return none
+*/
+static void engineStartNext(i2cEngine_t *engine, bool fromISR) {
+  if(engine->head != NULL && !engine->held) {
+    i2cTransaction_t *transaction = engine->head;
+
+    if(!engine->busy) {
+      engine->busy = true;
+      engine->busyStart = I2C_ENGINE_TIME();
+      if(engine->lpmMask) {
+        if(fromISR) {
+          lpmPeripheralActiveFromISR(engine->lpmMask);
+        } else {
+          lpmPeripheralActive(engine->lpmMask);
+        }
+      }
+    }
+
+    // Skip the mux select if the channel is already selected
+    if(transaction->mux != NULL && transaction->mux->channel != transaction->muxChannel) {
+      transaction->opIdx = -1;
+    } else {
+      transaction->opIdx = 0;
+    }
+
+    if(engineStartOp(engine) == HAL_OK) {
+      return;
+    }
+
+    // Couldn't start, complete with error (which starts the next one)
+    engineComplete(engine, halErrToI2CResponse(HAL_I2C_GetError(engine->handle)), fromISR);
+    return;
+  }
+
+  if(engine->busy) {
+    engine->busy = false;
+    engine->stats.busyTime += (uint32_t)(I2C_ENGINE_TIME() - engine->busyStart);
+    if(engine->lpmMask) {
+      if(fromISR) {
+        lpmPeripheralInactiveFromISR(engine->lpmMask);
+      } else {
+        lpmPeripheralInactive(engine->lpmMask);
+      }
+    }
+  }
+}
+
+/*!
+  Current operation finished (called from HAL callbacks)
+
+  \param[in] *engine - i2c engine
+  \param[in] errorCode - HAL error code (0 if successful)
+  \return none
+*/
+static void engineOpDone(i2cEngine_t *engine, uint32_t errorCode) {
+  i2cTransaction_t *transaction = engine->head;
+
+  // Spurious callback (transaction was cancelled)
+  if(!engine->busy || transaction == NULL) {
+    return;
+  }
+
+  if(errorCode != 0) {
+    engineComplete(engine, halErrToI2CResponse(errorCode), true);
+    return;
+  }
+
+  if(transaction->opIdx < 0) {
+    transaction->mux->channel = transaction->muxChannel;
+    engine->stats.bytes += sizeof(engine->muxBuff);
+  } else {
+    engine->stats.bytes += transaction->ops[transaction->opIdx].len;
+  }
+
+  transaction->opIdx++;
+  if(transaction->opIdx >= transaction->numOps) {
+    engineComplete(engine, I2C_OK, true);
+    return;
+  }
+
+  if(engineStartOp(engine) != HAL_OK) {
+    engineComplete(engine, halErrToI2CResponse(HAL_I2C_GetError(engine->handle)), true);
+  }
+}
+
+/*!
+  Initialize an i2c engine. The HAL handle must already be initialized and
+  its interrupts enabled.
+
+  \param[out] *engine - engine to initialize
+  \param[in] *handle - HAL i2c handle
+  \param[in] initFn - function to (re)initialize the bus
+  \param[in] lpmMask - low power mode peripheral mask (0 if unused)
+  \return none
+*/
+void i2cEngineInit(i2cEngine_t *engine, I2C_HandleTypeDef *handle, void (*initFn)(), uint32_t lpmMask) {
+  configASSERT(engine != NULL);
+  configASSERT(handle != NULL);
+
+  taskENTER_CRITICAL();
+  bool registered = false;
+  for(i2cEngine_t *item = _engines; item != NULL; item = item->nextEngine) {
+    if(item == engine) {
+      registered = true;
+      break;
+    }
+  }
+
+  // Re-initializing keeps the engine in the list
+  i2cEngine_t *nextEngine = registered ? engine->nextEngine : _engines;
+  memset(engine, 0, sizeof(i2cEngine_t));
+  engine->handle = handle;
+  engine->initFn = initFn;
+  engine->lpmMask = lpmMask;
+  engine->nextEngine = nextEngine;
+  if(!registered) {
+    _engines = engine;
+  }
+  taskEXIT_CRITICAL();
+}
+
+/*!
+  Queue a transaction. It will start right away if the bus is idle.
+
+  \param[in] *engine - i2c engine
+  \param[in] *transaction - transaction to queue
+  \return true if the transaction was queued, false otherwise
+*/
+bool i2cEngineSubmit(i2cEngine_t *engine, i2cTransaction_t *transaction) {
+  configASSERT(engine != NULL);
+  configASSERT(transaction != NULL);
+
+  if(transaction->numOps == 0 || transaction->ops == NULL) {
+    return false;
+  }
+
+  configASSERT(transaction->mux == NULL || transaction->mux->address != 0);
+
+  transaction->next = NULL;
+  transaction->done = false;
+  transaction->result = I2C_ERR;
+
+  taskENTER_CRITICAL();
+  if(engine->tail != NULL) {
+    engine->tail->next = transaction;
+  } else {
+    engine->head = transaction;
+  }
+  engine->tail = transaction;
+  engine->queueLen++;
+  if(engine->queueLen > engine->stats.queueMax) {
+    engine->stats.queueMax = engine->queueLen;
+  }
+
+  if(!engine->busy) {
+    engineStartNext(engine, false);
+  }
+  taskEXIT_CRITICAL();
+
+  return true;
+}
+
+/*!
+  Cancel a queued transaction. If the transaction is in progress, the bus is
+  re-initialized. Cancelled transactions don't get a callback.
+
+  \param[in] *engine - i2c engine
+  \param[in] *transaction - transaction to cancel
+  \return true if the transaction was cancelled, false if it had already completed
+*/
+bool i2cEngineCancel(i2cEngine_t *engine, i2cTransaction_t *transaction) {
+  configASSERT(engine != NULL);
+  configASSERT(transaction != NULL);
+
+  bool cancelled = false;
+
+  taskENTER_CRITICAL();
+  do {
+    if(transaction->done) {
+      break;
+    }
+
+    i2cTransaction_t *prev = NULL;
+    i2cTransaction_t *item = engine->head;
+    while(item != NULL && item != transaction) {
+      prev = item;
+      item = item->next;
+    }
+
+    if(item == NULL) {
+      break;
+    }
+
+    bool active = (prev == NULL) && engine->busy;
+    if(prev != NULL) {
+      prev->next = transaction->next;
+    } else {
+      engine->head = transaction->next;
+    }
+    if(engine->tail == transaction) {
+      engine->tail = prev;
+    }
+    engine->queueLen--;
+    transaction->next = NULL;
+    transaction->result = I2C_TIMEOUT;
+    transaction->done = true;
+    engine->stats.transactions++;
+    engine->stats.errors++;
+    cancelled = true;
+
+    if(active) {
+      // Abort whatever the peripheral was doing
+      if(engine->initFn != NULL) {
+        engine->initFn();
+      }
+      if(transaction->mux != NULL) {
+        transaction->mux->channel = (uint8_t)~transaction->muxChannel;
+      }
+      engineStartNext(engine, false);
+    }
+  } while(0);
+  taskEXIT_CRITICAL();
+
+  return cancelled;
+}
+
+/*!
+  Stop the engine from starting new transactions and wait for the bus to be
+  idle, so it can be used directly (blocking HAL calls, re-initialization).
+  Must be followed by i2cEngineRelease().
+
+  \param[in] *engine - i2c engine
+  \param[in] timeoutMs - how long to wait for the active transaction
+  \return true if the bus is idle, false otherwise (engine is not held)
+*/
+bool i2cEngineHold(i2cEngine_t *engine, uint32_t timeoutMs) {
+  configASSERT(engine != NULL);
+
+  engine->held = true;
+
+  TickType_t start = xTaskGetTickCount();
+  while(engine->busy) {
+    if((xTaskGetTickCount() - start) >= pdMS_TO_TICKS(timeoutMs)) {
+      i2cEngineRelease(engine);
+      return false;
+    }
+    vTaskDelay(1);
+  }
+
+  return true;
+}
+
+/*!
+  Let the engine run queued transactions again
+
+  \param[in] *engine - i2c engine
+  \return none
+*/
+void i2cEngineRelease(i2cEngine_t *engine) {
+  configASSERT(engine != NULL);
+
+  taskENTER_CRITICAL();
+  engine->held = false;
+  if(!engine->busy) {
+    engineStartNext(engine, false);
+  }
+  taskEXIT_CRITICAL();
+}
+
+/*!
+  Find the engine for a HAL handle
+
+  \param[in] *handle - HAL i2c handle
+  \return engine, NULL if there isn't one
+*/
+i2cEngine_t *i2cEngineFind(I2C_HandleTypeDef *handle) {
+  for(i2cEngine_t *engine = _engines; engine != NULL; engine = engine->nextEngine) {
+    if(engine->handle == handle) {
+      return engine;
+    }
+  }
+
+  return NULL;
+}
+
+/*!
+  Get a copy of the engine statistics
+
+  \param[in] *engine - i2c engine
+  \param[out] *stats - statistics
+  \return none
+*/
+void i2cEngineGetStats(i2cEngine_t *engine, i2cEngineStats_t *stats) {
+  configASSERT(engine != NULL);
+  configASSERT(stats != NULL);
+
+  taskENTER_CRITICAL();
+  memcpy(stats, &engine->stats, sizeof(i2cEngineStats_t));
+  if(engine->busy) {
+    stats->busyTime += (uint32_t)(I2C_ENGINE_TIME() - engine->busyStart);
+  }
+  taskEXIT_CRITICAL();
+}
+
+//
+// HAL callbacks (override the weak HAL definitions)
+//
+void HAL_I2C_MasterTxCpltCallback(I2C_HandleTypeDef *hi2c) {
+  i2cEngine_t *engine = i2cEngineFind(hi2c);
+  if(engine != NULL) {
+    engineOpDone(engine, 0);
+  }
+}
+
+void HAL_I2C_MasterRxCpltCallback(I2C_HandleTypeDef *hi2c) {
+  i2cEngine_t *engine = i2cEngineFind(hi2c);
+  if(engine != NULL) {
+    engineOpDone(engine, 0);
+  }
+}
+
+void HAL_I2C_ErrorCallback(I2C_HandleTypeDef *hi2c) {
+  i2cEngine_t *engine = i2cEngineFind(hi2c);
+  if(engine != NULL) {
+    uint32_t errorCode = HAL_I2C_GetError(hi2c);
+    engineOpDone(engine, (errorCode != 0) ? errorCode : HAL_I2C_ERROR_TIMEOUT);
+  }
+}
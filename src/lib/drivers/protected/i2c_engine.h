@@ -0,0 +1,126 @@
+#pragma once
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+
+#include "protected_i2c.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+//
+// Queued I2C transaction engine.
+//
+// A transaction is a list of read/write operations. Consecutive operations
+// to the same address are done back to back without a stop condition
+// (with a repeated start when the direction changes), so a register write
+// followed by a read is a single bus transaction.
+//
+// Transactions are queued per bus and run from the I2C interrupt, one after
+// the other. When a transaction completes, its result/done fields are set
+// and its callback (if any) is called. Callbacks run in interrupt context
+// (or in the calling task if the bus fails to start in i2cEngineSubmit or
+// i2cEngineCancel) so they must only use FromISR APIs.
+//
+// Transactions (and their ops and buffers) are owned by the caller and must
+// stay valid until they complete or are cancelled.
+//
+
+// Time source used for bus utilization (defaults to the run time counter)
+#ifndef I2C_ENGINE_TIME
+#define I2C_ENGINE_TIME() ((uint32_t)portGET_RUN_TIME_COUNTER_VALUE())
+#endif
+
+typedef enum {
+  I2C_OP_WRITE = 0,
+  I2C_OP_READ,
+} i2cOpType_t;
+
+typedef struct {
+  i2cOpType_t type;
+  /// 7-bit device address
+  uint8_t address;
+  uint16_t len;
+  uint8_t *buff;
+} i2cOp_t;
+
+//
+// I2C mux (TCA9546A style, single control register) channel cache.
+// Transactions behind a mux set mux/muxChannel and the engine only selects
+// the channel when it is not already selected.
+//
+typedef struct {
+  /// 7-bit mux address
+  uint8_t address;
+  /// Currently selected channel(s)
+  volatile uint8_t channel;
+} i2cMux_t;
+
+struct i2cTransaction;
+typedef void (*i2cTransactionCb_t)(struct i2cTransaction *transaction);
+
+typedef struct i2cTransaction {
+  const i2cOp_t *ops;
+  uint8_t numOps;
+
+  /// Optional mux to select before running the ops (NULL if none)
+  i2cMux_t *mux;
+  uint8_t muxChannel;
+
+  /// Optional completion callback (see note above about context)
+  i2cTransactionCb_t callback;
+  void *context;
+
+  volatile I2CResponse_t result;
+  volatile bool done;
+
+  // Engine use only
+  struct i2cTransaction *next;
+  int16_t opIdx;
+} i2cTransaction_t;
+
+typedef struct {
+  uint32_t transactions;
+  uint32_t errors;
+  uint32_t bytes;
+  uint32_t queueMax;
+  /// Time the bus was busy (I2C_ENGINE_TIME units)
+  uint64_t busyTime;
+} i2cEngineStats_t;
+
+typedef struct i2cEngine {
+  I2C_HandleTypeDef *handle;
+  void (*initFn)();
+  uint32_t lpmMask;
+
+  /// Queue of pending transactions. head is the active one while busy.
+  i2cTransaction_t *head;
+  i2cTransaction_t *tail;
+  uint32_t queueLen;
+
+  volatile bool busy;
+  /// Don't start any new transactions (bus is being used directly)
+  volatile bool held;
+  uint32_t busyStart;
+
+  uint8_t muxBuff;
+
+  i2cEngineStats_t stats;
+
+  /// Registered engines (used to find the engine from HAL callbacks)
+  struct i2cEngine *nextEngine;
+} i2cEngine_t;
+
+void i2cEngineInit(i2cEngine_t *engine, I2C_HandleTypeDef *handle, void (*initFn)(), uint32_t lpmMask);
+bool i2cEngineSubmit(i2cEngine_t *engine, i2cTransaction_t *transaction);
+bool i2cEngineCancel(i2cEngine_t *engine, i2cTransaction_t *transaction);
+bool i2cEngineHold(i2cEngine_t *engine, uint32_t timeoutMs);
+void i2cEngineRelease(i2cEngine_t *engine);
+i2cEngine_t *i2cEngineFind(I2C_HandleTypeDef *handle);
+void i2cEngineGetStats(i2cEngine_t *engine, i2cEngineStats_t *stats);
+
+#ifdef __cplusplus
+}
+#endif
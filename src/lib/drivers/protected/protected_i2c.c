@@ -1,5 +1,10 @@
 #include <stdio.h>
 #include "protected_i2c.h"
+#include "i2c_engine.h"
+
+#define I2C_IRQ_PRIORITY 6
+// How long to wait for the bus to be idle before re-initializing it
+#define I2C_HOLD_TIMEOUT_MS 100
 
 // Translate HAL i2c error codes to ours
 static I2CResponse_t _halI2cErrToI2CResponse(uint32_t errorCode) {
@@ -23,11 +28,48 @@ static I2CResponse_t _halI2cErrToI2CResponse(uint32_t errorCode) {
 static void i2cWorkaround(I2CInterface_t *interface, I2CResponse_t rval) {
   if(rval == I2C_TIMEOUT || rval == I2C_ERR) {
     printf("(Workaround) Re-initializing interface [%s]\n", interface->name);
-    interface->initFn();
+    // Don't re-initialize in the middle of someone else's transaction
+    if(i2cEngineHold(interface->engine, I2C_HOLD_TIMEOUT_MS)) {
+      interface->initFn();
+      i2cEngineRelease(interface->engine);
+    }
   }
 }
 #endif
 
+// CubeMX doesn't enable the i2c interrupts, but the engine needs them
+// Only I2C1 is used by the current bsps
+static I2C_HandleTypeDef *_i2c1Handle;
+
+static void i2cEnableIRQs(I2C_HandleTypeDef *handle) {
+  if(handle->Instance == I2C1) {
+    _i2c1Handle = handle;
+    HAL_NVIC_SetPriority(I2C1_EV_IRQn, I2C_IRQ_PRIORITY, 0);
+    HAL_NVIC_EnableIRQ(I2C1_EV_IRQn);
+    HAL_NVIC_SetPriority(I2C1_ER_IRQn, I2C_IRQ_PRIORITY, 0);
+    HAL_NVIC_EnableIRQ(I2C1_ER_IRQn);
+  } else {
+    // Add IRQ handlers below when using other instances
+    configASSERT(0);
+  }
+}
+
+void I2C1_EV_IRQHandler(void) {
+  HAL_I2C_EV_IRQHandler(_i2c1Handle);
+}
+
+void I2C1_ER_IRQHandler(void) {
+  HAL_I2C_ER_IRQHandler(_i2c1Handle);
+}
+
+// Blocking transaction completion (called from interrupt context)
+static void i2cBlockingDone(i2cTransaction_t *transaction) {
+  I2CInterface_t *interface = (I2CInterface_t *)transaction->context;
+  BaseType_t higherPriorityTaskWoken = pdFALSE;
+  xSemaphoreGiveFromISR(interface->done, &higherPriorityTaskWoken);
+  portYIELD_FROM_ISR(higherPriorityTaskWoken);
+}
+
 /*!
   i2cInit(I2CInterface_t *interface)
   \brief Initialize an i2c interface
@@ -44,12 +86,38 @@ bool i2cInit(I2CInterface_t *interface) {
   interface->mutex = xSemaphoreCreateMutex();
   configASSERT(interface->mutex != NULL);
 
+  interface->done = xSemaphoreCreateBinary();
+  configASSERT(interface->done != NULL);
+
+  interface->engine = (i2cEngine_t *)pvPortMalloc(sizeof(i2cEngine_t));
+  configASSERT(interface->engine != NULL);
+  i2cEngineInit(interface->engine, interface->handle, interface->initFn, interface->lpm_mask);
+
+  i2cEnableIRQs(interface->handle);
+
   return rval;
 }
 
+/*!
+  bool i2cSubmit(I2CInterface_t *interface, i2cTransaction_t *transaction)
+  \brief Queue an asynchronous transaction (see i2c_engine.h)
+  \param interface Handle to i2c interface
+  \param transaction transaction to queue
+  \return true if queued, false otherwise
+*/
+bool i2cSubmit(I2CInterface_t *interface, i2cTransaction_t *transaction) {
+  configASSERT(interface != NULL);
+
+  // Make sure interface has been initialized!
+  configASSERT(interface->engine != NULL);
+
+  return i2cEngineSubmit(interface->engine, transaction);
+}
+
 /*!
   I2CResponse_t i2cTxRx(I2CInterface_t *interface, uint8_t address, uint8_t *txBuff, size_t txLen, uint8_t *rxBuff, size_t rxLen, uint32_t timeoutMs)
-  \brief Write and/or read data from i2c device
+  \brief Write and/or read data from i2c device. When doing both, the read
+         follows the write with a repeated start.
   \param interface Handle to i2c interface
   \param address i2c device address
   \param txBuff tx buffer, set to NULL if unused
@@ -66,12 +134,10 @@ I2CResponse_t i2cTxRx(I2CInterface_t *interface, uint8_t address, uint8_t *txBuf
   // Make sure interface has been initialized!
   configASSERT(interface->mutex != NULL);
 
+  // The mutex is only needed to share the done semaphore, the engine
+  // takes care of ordering transactions on the bus
   if(xSemaphoreTake(interface->mutex, pdMS_TO_TICKS(timeoutMs)) == pdTRUE) {
 
-    if(interface->lpm_mask) {
-      lpmPeripheralActive(interface->lpm_mask);
-    }
-
 #ifdef I2C_DEBUG
     printf("%s [%s] ", __func__, interface->name);
     if(txLen) {
@@ -82,45 +148,46 @@ I2CResponse_t i2cTxRx(I2CInterface_t *interface, uint8_t address, uint8_t *txBuf
     }
 #endif
 
-    HAL_StatusTypeDef hal_rval;
-    do {
-      if(txBuff != NULL && txLen > 0) {
-        hal_rval = HAL_I2C_Master_Transmit(interface->handle, address << 1, txBuff, txLen, timeoutMs);
-        if(hal_rval != HAL_OK) {
-          rval = _halI2cErrToI2CResponse(((I2C_HandleTypeDef *)interface->handle)->ErrorCode);
+    i2cOp_t ops[2];
+    uint8_t numOps = 0;
+    if(txBuff != NULL && txLen > 0) {
+      ops[numOps++] = (i2cOp_t){I2C_OP_WRITE, address, (uint16_t)txLen, txBuff};
+    }
+    if(rxBuff != NULL && rxLen > 0) {
+      ops[numOps++] = (i2cOp_t){I2C_OP_READ, address, (uint16_t)rxLen, rxBuff};
+    }
 
-#ifdef I2C_DEBUG
-          printf("\n");
-          printf("%s Error [%s] - %d\n", __func__, interface->name, rval);
-#endif
+    i2cTransaction_t transaction = {0};
+    transaction.ops = ops;
+    transaction.numOps = numOps;
+    transaction.callback = i2cBlockingDone;
+    transaction.context = interface;
 
-#if I2C_WORKAROUND == 1
-          i2cWorkaround(interface, rval);
-#endif
-          break;
-        } else {
-          rval = I2C_OK;
-        }
+    do {
+      if(!i2cEngineSubmit(interface->engine, &transaction)) {
+        break;
       }
 
-      // TODO - change this to allow for an i2c repeated start
-      if(rxBuff != NULL && rxLen > 0) {
-        hal_rval = HAL_I2C_Master_Receive(interface->handle, address << 1, rxBuff, rxLen, timeoutMs);
-        if(hal_rval != HAL_OK) {
-          rval = _halI2cErrToI2CResponse(((I2C_HandleTypeDef *)interface->handle)->ErrorCode);
+      if(xSemaphoreTake(interface->done, pdMS_TO_TICKS(timeoutMs)) == pdTRUE) {
+        rval = transaction.result;
+      } else if(i2cEngineCancel(interface->engine, &transaction)) {
+        rval = I2C_TIMEOUT;
+      } else {
+        // Completed right as we timed out, consume the semaphore
+        xSemaphoreTake(interface->done, 0);
+        rval = transaction.result;
+      }
 
+      if(rval != I2C_OK) {
 #ifdef I2C_DEBUG
-          printf("\n");
-          printf("%s Error [%s] - %d\n", __func__, interface->name, rval);
+        printf("\n");
+        printf("%s Error [%s] - %d\n", __func__, interface->name, rval);
 #endif
 
 #if I2C_WORKAROUND == 1
-          i2cWorkaround(interface, rval);
+        i2cWorkaround(interface, rval);
 #endif
-          break;
-        } else {
-          rval = I2C_OK;
-        }
+        break;
       }
 
 #ifdef I2C_DEBUG
@@ -135,10 +202,6 @@ I2CResponse_t i2cTxRx(I2CInterface_t *interface, uint8_t address, uint8_t *txBuf
 
     } while (0);
 
-    if(interface->lpm_mask) {
-      lpmPeripheralInactive(interface->lpm_mask);
-    }
-
     xSemaphoreGive(interface->mutex);
   } else {
 #ifdef I2C_DEBUG
@@ -167,6 +230,12 @@ I2CResponse_t i2cProbe(I2CInterface_t *interface, uint8_t address, uint32_t time
   I2CResponse_t rval = I2C_OK;
   if(xSemaphoreTake(interface->mutex, pdMS_TO_TICKS(timeoutMs)) == pdTRUE) {
 
+    // The HAL doesn't have a non-blocking probe, so keep the engine off the bus
+    if(!i2cEngineHold(interface->engine, timeoutMs)) {
+      xSemaphoreGive(interface->mutex);
+      return I2C_TIMEOUT;
+    }
+
     if(interface->lpm_mask) {
       lpmPeripheralActive(interface->lpm_mask);
     }
@@ -174,7 +243,7 @@ I2CResponse_t i2cProbe(I2CInterface_t *interface, uint8_t address, uint32_t time
     HAL_StatusTypeDef hal_rval;
     hal_rval = HAL_I2C_IsDeviceReady(interface->handle, address << 1, 1, timeoutMs);
     if(hal_rval != HAL_OK) {
-      rval = _halI2cErrToI2CResponse(((I2C_HandleTypeDef *)interface->handle)->ErrorCode);
+      rval = _halI2cErrToI2CResponse(HAL_I2C_GetError(interface->handle));
 
       // Ignore expected errors during a probe
       if ((rval != I2C_NACK) && (rval != I2C_TIMEOUT)) {
@@ -182,7 +251,8 @@ I2CResponse_t i2cProbe(I2CInterface_t *interface, uint8_t address, uint32_t time
         printf("%s Error [%s] - %d\n", __func__, interface->name, rval);
 #endif
 #if I2C_WORKAROUND == 1
-        i2cWorkaround(interface, rval);
+        printf("(Workaround) Re-initializing interface [%s]\n", interface->name);
+        interface->initFn();
 #endif
       }
     }
@@ -191,6 +261,8 @@ I2CResponse_t i2cProbe(I2CInterface_t *interface, uint8_t address, uint32_t time
       lpmPeripheralInactive(interface->lpm_mask);
     }
 
+    i2cEngineRelease(interface->engine);
+
     xSemaphoreGive(interface->mutex);
   } else {
 #ifdef I2C_DEBUG
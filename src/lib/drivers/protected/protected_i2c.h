@@ -21,12 +21,18 @@ typedef enum {
   I2C_ERR
 } I2CResponse_t;
 
+struct i2cEngine;
+struct i2cTransaction;
+
 typedef struct {
   const char *name;
   I2C_HandleTypeDef *handle;
   void (*initFn)();
   SemaphoreHandle_t mutex;
   uint32_t lpm_mask;
+  // Set up by i2cInit
+  struct i2cEngine *engine;
+  SemaphoreHandle_t done;
 } I2CInterface_t;
 
 bool i2cInit(I2CInterface_t *interface);
@@ -34,6 +40,7 @@ I2CResponse_t i2cTxRx(I2CInterface_t *interface, uint8_t address, uint8_t *txBuf
 #define i2cTx(interface, address, buff, len, timeout) i2cTxRx(interface, address, buff, len, NULL, 0, timeout);
 #define i2cRx(interface, address, buff, len, timeout) i2cTxRx(interface, address, NULL, 0, buff, len, timeout);
 I2CResponse_t i2cProbe(I2CInterface_t *interface, uint8_t address, uint32_t timeoutMs);
+bool i2cSubmit(I2CInterface_t *interface, struct i2cTransaction *transaction);
 void i2cLoadLogCfg();
 
 #ifdef __cplusplus
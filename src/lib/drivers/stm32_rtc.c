@@ -5,7 +5,6 @@
 // Magic number to write into backup register 0 to indicate that the rtc is set
 #define RTC_SET_MAGIC 0x836A20DD
 
-static const uint8_t monthDays[]={31,28,31,30,31,30,31,31,30,31,30,31}; // API starts months from 1, this array starts from 0
 
 BaseType_t rtcInit() {
   BaseType_t rval = pdPASS;
@@ -140,30 +139,14 @@ BaseType_t rtcSet(const RTCTimeAndDate_t *timeAndDate) {
 }
 
 uint64_t rtcGetMicroSeconds(RTCTimeAndDate_t *timeAndDate){
-  int i;
   uint64_t microseconds;
 
-  // microseconds from 1970 till 1 jan 00:00:00 of the given year
-  microseconds = (timeAndDate->year - 1970) * (SECS_PER_DAY * 365);
-  for (i = 1970; i < timeAndDate->year; i++) {
-    if (LEAP_YEAR(i - 1970)) {
-      microseconds +=  SECS_PER_DAY;   // add extra days for leap years
-    }
-  }
-
-  // add days for this year, months start from 1
-  for (i = 1; i < timeAndDate->month; i++) {
-    if ( (i == 2) && LEAP_YEAR(timeAndDate->year - 1970)) {
-      microseconds += SECS_PER_DAY * 29;
-    } else {
-      microseconds += SECS_PER_DAY * monthDays[i-1];  //monthDay array starts from 0
-    }
-  }
-  microseconds += (timeAndDate->day-1) * SECS_PER_DAY;
+  // seconds from 1970 till the given day
+  microseconds = (uint64_t)daysFromCivil(timeAndDate->year, timeAndDate->month, timeAndDate->day) * SECS_PER_DAY;
   microseconds += timeAndDate->hour * SECS_PER_HOUR;
   microseconds += timeAndDate->minute * SECS_PER_MIN;
   microseconds += timeAndDate->second;
-  microseconds *= 1e6;
+  microseconds *= 1000000;
   microseconds += (uint64_t)timeAndDate->ms * 1000;
   return microseconds;
 }
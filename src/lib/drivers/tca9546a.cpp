@@ -11,7 +11,8 @@ TCA9546A::TCA9546A(I2CInterface_t* interface, uint8_t address, IOPinHandle_t *re
   _resetPin = resetPin;
 
   // A Power on Reset will reset the channel to CH_NONE
-  _channel = CH_NONE;
+  _mux.address = _addr;
+  _mux.channel = CH_NONE;
 }
 
 /*!
@@ -28,7 +29,7 @@ bool TCA9546A::init() {
   while(!rval && retriesRemaining--){
     Channel_t chnl;
     getChannel(&chnl);
-    if(chnl != _channel){
+    if(chnl != _mux.channel){
       printf("Invalid channel");
       continue;
     } else {
@@ -47,11 +48,15 @@ bool TCA9546A::init() {
  \return true if successfull, false otherwise
 */
 bool TCA9546A::setChannel(Channel_t channel) {
-  if(channel != _channel){
-    return (writeBytes((uint8_t*)&channel, sizeof(uint8_t)) == I2C_OK);
-  } else {
-    return true;
+  bool rval = true;
+  if(channel != _mux.channel){
+    rval = (writeBytes((uint8_t*)&channel, sizeof(uint8_t)) == I2C_OK);
+    if(rval) {
+      _mux.channel = channel;
+    }
   }
+
+  return rval;
 }
 
 /*!
@@ -61,8 +66,10 @@ bool TCA9546A::setChannel(Channel_t channel) {
 */
 bool TCA9546A::getChannel(Channel_t *channel){
   bool rval = false;
-  if (readBytes((uint8_t*)channel, sizeof(uint8_t), 100) == I2C_OK){
-    _channel = *channel;
+  uint8_t value = 0;
+  if (readBytes(&value, sizeof(value), 100) == I2C_OK){
+    *channel = static_cast<Channel_t>(value);
+    _mux.channel = value;
     rval = true;
   }
 
@@ -77,4 +84,15 @@ void TCA9546A::hwReset(){
   vTaskDelay(pdMS_TO_TICKS(50));
   IOWrite(_resetPin, 1);
   vTaskDelay(pdMS_TO_TICKS(10));
+  _mux.channel = CH_NONE;
+}
+
+/*!
+  Get the channel cache for this mux. Pass it (with the channel) in i2c
+  engine transactions to select the channel as part of the transaction.
+
+  \return mux channel cache
+*/
+i2cMux_t *TCA9546A::mux() {
+  return &_mux;
 }
\ No newline at end of file
@@ -1,6 +1,7 @@
 #pragma once
 
 #include "abstract/abstract_i2c.h"
+#include "i2c_engine.h"
 #include "io.h"
 
 namespace TCA {
@@ -21,9 +22,12 @@ public:
   bool setChannel(Channel_t channel);
   bool getChannel(Channel_t *channel);
   void hwReset();
+  i2cMux_t *mux();
 
 private:
-  Channel_t _channel;
+  // Channel cache, shared with the i2c engine so transactions can select
+  // the channel themselves
+  i2cMux_t _mux;
   IOPinHandle_t *_resetPin;
 };
 
@@ -4,6 +4,8 @@
 #include <cstdio>
 #include "watchdog.h"
 #include "crc.h"
+#include "task.h"
+#include "uptime.h"
 
 namespace spiflash {
 // STATUS REGISTER BITS
@@ -15,6 +17,7 @@ namespace spiflash {
 #define W25_SR1_TB                          (1 << 5)
 #define W25_SR1_SEC                         (1 << 6)
 #define W25_SR1_SRP0                        (1 << 7)
+#define W25_SR2_SUS                         (1 << 7)
 
 #define W25_RW_HEADER_LEN                   (4) // 1 byte for command and 3 bytes for address
 #define W25_MANUFACTURER_ID                 0xEF
@@ -30,6 +33,18 @@ namespace spiflash {
 #define W25_SECTOR_ERASE_TIMEOUT_MS         (400)
 #define W25_MAX_ADDRESS                     (0x7FFFFF)
 
+// Status polling interval while waiting (sleeping in between)
+#define W25_PROGRAM_POLL_MS                 (1)
+#define W25_ERASE_POLL_MS                   (5)
+#define W25_CHIP_ERASE_POLL_MS              (100)
+// Erase stops within 20us of a suspend
+#define W25_SUSPEND_TIMEOUT_MS              (2)
+// Let a resumed erase run at least this long before suspending it again,
+// so back to back reads can't stall it forever
+#define W25_MIN_ERASE_RUN_US                (1000)
+#define W25_CACHE_LINES                     (4)
+#define W25_CHECKSUM_BLOCK_LEN              (1024)
+
 #define W25X40CL_DEVICE_ID                  0x12
 #define W25X40CL_MEMORY_TYPE                0x30
 #define W25X40CL_CAPACITY_ID                0x13
@@ -72,34 +87,62 @@ typedef enum {
     BLOCK_ERASE_64              = 0xD8,
 } W25_Reg_t;
 
+typedef struct {
+    uint32_t crc;
+    bool first;
+} W25Crc32State_t;
+
+static void crc32Block(const uint8_t *data, size_t len, void *ctx) {
+    W25Crc32State_t *state = static_cast<W25Crc32State_t *>(ctx);
+    if(state->first) {
+        state->crc = crc32_ieee(data, len);
+        state->first = false;
+    } else {
+        state->crc = crc32_ieee_update(state->crc, data, len);
+    }
+}
+
+static void crc16Block(const uint8_t *data, size_t len, void *ctx) {
+    uint16_t *crc = static_cast<uint16_t *>(ctx);
+    *crc = crc16_ccitt(*crc, data, len);
+}
+
 W25::W25(SPIInterface_t *interface, IOPinHandle_t *csPin) : AbstractSPI(interface, csPin){
     configASSERT(_interface);
     _mutex = xSemaphoreCreateMutex();
     configASSERT(_mutex != NULL);
+    _busMutex = xSemaphoreCreateMutex();
+    configASSERT(_busMutex != NULL);
+
+    _opActive = false;
+    _opAddr = 0;
+    _opLen = 0;
+    _eraseInProgress = false;
+    _lastResumeUs = 0;
+
+    flashReadCacheLine_t *cacheLines = static_cast<flashReadCacheLine_t *>(pvPortMalloc(sizeof(flashReadCacheLine_t) * W25_CACHE_LINES));
+    configASSERT(cacheLines != NULL);
+    flashReadCacheInit(&_cache, cacheLines, W25_CACHE_LINES);
+
+    _stats = static_cast<W25Stats_t *>(pvPortMalloc(sizeof(W25Stats_t)));
+    configASSERT(_stats != NULL);
+    resetStats();
+
+    perfCounterRegister(&_cache.hits, "w25", "cache_hits", PERF_COUNTER_TYPE_COUNT);
+    perfCounterRegister(&_cache.misses, "w25", "cache_misses", PERF_COUNTER_TYPE_COUNT);
+    perfCounterRegister(&_suspends, "w25", "erase_suspends", PERF_COUNTER_TYPE_COUNT);
 }
+
 /*!
  * Erase flash chip
  * \return true if success, false if fail.
 */
 bool W25::eraseChip(uint32_t timeoutMs) {
     bool retv = false;
-    if(xSemaphoreTake(_mutex, pdMS_TO_TICKS(timeoutMs)) == pdTRUE) {
+    if(lockOp(0, W25_MAX_ADDRESS + 1, timeoutMs)) {
         uint8_t txBuff = 0;
-        /* Make sure the previous write finished */
         do {
-            if(!readyToWrite(W25_WRITE_TIMEOUT_MS)) {
-                printf("Timeout waiting for write to complete\n");
-                break;
-            }
-            /* Enable writes */
-            txBuff = WRITE_ENABLE;
-            if(writeBytes(&txBuff, sizeof(txBuff), 10,true) != SPI_OK) {
-                printf("Error sending WREN command\n");
-                break;
-            }
-
-            if(!checkWEL(W25_WRITE_TIMEOUT_MS, true)) {
-                printf("Timeout waiting for write to complete\n");
+            if(!writeEnable()) {
                 break;
             }
 
@@ -110,15 +153,15 @@ bool W25::eraseChip(uint32_t timeoutMs) {
                 break;
             }
 
-            /* Ensure WEL is reset */
-            if(!checkWEL(W25_CHIP_ERASE_TIMEOUT_MS, false, true)) {
+            /* Chip erase can't be suspended, so reads wait for this one */
+            if(!waitWhileBusy(W25_CHIP_ERASE_TIMEOUT_MS, W25_CHIP_ERASE_POLL_MS, true)) {
                 printf("Timeout waiting for write to complete\n");
                 break;
             }
             retv = true;
             printf("Successfully erased chip\n");
         } while (!retv);
-        xSemaphoreGive(_mutex);
+        unlockOp();
     } else {
         printf("Failed to acquir W25 mutex.\n");
     }
@@ -126,7 +169,8 @@ bool W25::eraseChip(uint32_t timeoutMs) {
 }
 
 /*!
- * Read from flash
+ * Read from flash. Reads don't wait for writes/erases elsewhere in flash
+ * (sector erases are suspended for them). Small reads go through the read cache.
  * \param[in] addr - address of flash
  * \param[out] buffer - pointer to buffer to write into.
  * \param[in] len - length of data
@@ -134,12 +178,36 @@ bool W25::eraseChip(uint32_t timeoutMs) {
 */
 bool W25::read(uint32_t addr, uint8_t *buffer, size_t len, uint32_t timeoutMs) {
     bool rval = false;
-    if(xSemaphoreTake(_mutex, pdMS_TO_TICKS(timeoutMs)) == pdTRUE) {
-        rval = _read(addr, buffer, len);
+    bool opLocked = false;
+
+    do {
+        if(xSemaphoreTake(_busMutex, pdMS_TO_TICKS(timeoutMs)) != pdTRUE) {
+            printf("Failed to acquire W25 mutex.\n");
+            break;
+        }
+
+        if(_opActive && opOverlaps(addr, len)) {
+            /* This data is being modified, wait until it's done */
+            xSemaphoreGive(_busMutex);
+            if(xSemaphoreTake(_mutex, pdMS_TO_TICKS(timeoutMs)) != pdTRUE) {
+                printf("Failed to acquire W25 mutex.\n");
+                break;
+            }
+            opLocked = true;
+            if(xSemaphoreTake(_busMutex, pdMS_TO_TICKS(timeoutMs)) != pdTRUE) {
+                printf("Failed to acquire W25 mutex.\n");
+                break;
+            }
+        }
+
+        rval = _readCached(addr, buffer, len);
+        xSemaphoreGive(_busMutex);
+    } while(0);
+
+    if(opLocked) {
         xSemaphoreGive(_mutex);
-    } else {
-        printf("Failed to acquire W25 mutex.\n");
     }
+
     return rval;
 }
 
@@ -152,26 +220,47 @@ bool W25::read(uint32_t addr, uint8_t *buffer, size_t len, uint32_t timeoutMs) {
 */
 bool W25::write(uint32_t addr, uint8_t *buffer, size_t len, uint32_t timeoutMs) {
     bool rval = false;
-    if(xSemaphoreTake(_mutex, pdMS_TO_TICKS(timeoutMs)) == pdTRUE) {
+    /* Whole sectors are rewritten */
+    uint32_t startSectorAddr = addr & ~W25_SECTOR_MASK;
+    uint32_t endSectorAddr = (addr + len + W25_SECTOR_MASK) & ~W25_SECTOR_MASK;
+    if(lockOp(startSectorAddr, endSectorAddr - startSectorAddr, timeoutMs)) {
         rval = _write(addr, buffer, len);
-        xSemaphoreGive(_mutex);
+        unlockOp();
     } else {
         printf("Failed to acquire W25 mutex.\n");
     }
     return rval;
 }
 
-bool W25::readyToWrite(uint32_t timeoutMs) {
+/*!
+ * Wait for the current program/erase to finish. Sleeps between status
+ * reads instead of spinning on the bus.
+ * \param[in] timeoutMs - how long to wait
+ * \param[in] pollMs - time between status reads
+ * \param[in] feedWDT - feed the watchdog while waiting
+ * \return true if the flash is ready, false if it timed out
+*/
+bool W25::waitWhileBusy(uint32_t timeoutMs, uint32_t pollMs, bool feedWDT) {
     uint32_t startTime = xTaskGetTickCount();
     bool rval = false;
 
-    do {
+    for(;;) {
+        if(feedWDT){
+            watchdogFeed();
+        }
         uint8_t status;
         if(!readStatus(status)) {
             break;
         }
-        rval = !(status & W25_SR1_BUSY);
-    } while((rval == false) && timeRemainingTicks(startTime, pdMS_TO_TICKS(timeoutMs)));
+        if(!(status & W25_SR1_BUSY)) {
+            rval = true;
+            break;
+        }
+        if(!timeRemainingTicks(startTime, pdMS_TO_TICKS(timeoutMs))) {
+            break;
+        }
+        vTaskDelay(pdMS_TO_TICKS(pollMs));
+    }
     return rval;
 }
 
@@ -185,14 +274,21 @@ bool W25::readStatus(uint8_t &status) {
     return rval;
 }
 
-bool W25::checkWEL(uint32_t timeoutMs, bool set, bool feedWDT) {
+bool W25::readStatus2(uint8_t &status) {
+    uint8_t txBuff[2];
+    uint8_t rxBuff[2];
+
+    txBuff[0] = READ_STATUS_2;
+    bool rval = (writeReadBytes(rxBuff, sizeof(txBuff),txBuff,10,true) == SPI_OK);
+    status = rxBuff[1];
+    return rval;
+}
+
+bool W25::checkWEL(uint32_t timeoutMs, bool set) {
     uint32_t startTime = xTaskGetTickCount();
     bool rval = false;
 
     do {
-        if(feedWDT){
-            watchdogFeed();
-        }
         uint8_t status;
         if(!readStatus(status)) {
             break;
@@ -207,6 +303,120 @@ bool W25::checkWEL(uint32_t timeoutMs, bool set, bool feedWDT) {
   return rval;
 }
 
+/*!
+ * Wait for the previous program/erase and set the write enable latch
+ * \return true if success, false if fail.
+*/
+bool W25::writeEnable() {
+    bool rval = false;
+    do {
+        /* Make sure the previous write finished */
+        if(!waitWhileBusy(W25_WRITE_TIMEOUT_MS, W25_PROGRAM_POLL_MS)) {
+            printf("Timeout waiting for write to complete\n");
+            break;
+        }
+
+        /* Enable writes */
+        uint8_t txBuff = WRITE_ENABLE;
+        if(writeBytes(&txBuff, sizeof(txBuff), 10, true) != SPI_OK) {
+            printf("Error sending WREN command\n");
+            break;
+        }
+
+        /* check if WEL is set */
+        if(!checkWEL(W25_WRITE_TIMEOUT_MS, true)) {
+            printf("Timeout waiting for write to complete\n");
+            break;
+        }
+        rval = true;
+    } while(0);
+    return rval;
+}
+
+/*!
+ * Suspend the sector erase in progress (so the flash can be read)
+ * \param[out] suspended - true if the erase was suspended and has to be
+ *                         resumed, false if it had already finished
+ * \return true if success, false if fail.
+*/
+bool W25::suspendErase(bool &suspended) {
+    suspended = false;
+
+    /* Don't suspend a resumed erase again before it's made some progress */
+    uint64_t sinceResumeUs = uptimeGetMicroSeconds() - _lastResumeUs;
+    if(sinceResumeUs < W25_MIN_ERASE_RUN_US) {
+        vTaskDelay(pdMS_TO_TICKS((W25_MIN_ERASE_RUN_US - sinceResumeUs + 999) / 1000));
+    }
+
+    uint8_t txBuff = ERASE_PROGRAM_SUSPEND;
+    if(writeBytes(&txBuff, sizeof(txBuff), 10, true) != SPI_OK) {
+        printf("Error sending suspend command\n");
+        return false;
+    }
+
+    /* Short enough to poll without sleeping */
+    uint32_t startTime = xTaskGetTickCount();
+    do {
+        uint8_t status;
+        uint8_t status2;
+        if(!readStatus(status) || !readStatus2(status2)) {
+            break;
+        }
+        if(!(status & W25_SR1_BUSY)) {
+            /* SUS stays clear if the erase finished before the suspend */
+            suspended = (status2 & W25_SR2_SUS);
+            if(suspended) {
+                perfCounterInc(&_suspends);
+            }
+            return true;
+        }
+    } while(timeRemainingTicks(startTime, pdMS_TO_TICKS(W25_SUSPEND_TIMEOUT_MS)));
+
+    return false;
+}
+
+bool W25::resumeErase() {
+    uint8_t txBuff = ERASE_PROGRAM_RESUME;
+    bool rval = (writeBytes(&txBuff, sizeof(txBuff), 10, true) == SPI_OK);
+    _lastResumeUs = uptimeGetMicroSeconds();
+    return rval;
+}
+
+/*!
+ * Start a write/erase. Reads of the range wait until unlockOp().
+ * \param[in] addr - start of the range being modified
+ * \param[in] len - length of the range being modified
+ * \param[in] timeoutMs - how long to wait for the mutexes
+ * \return true if locked, false otherwise
+*/
+bool W25::lockOp(uint32_t addr, size_t len, uint32_t timeoutMs) {
+    if(xSemaphoreTake(_mutex, pdMS_TO_TICKS(timeoutMs)) != pdTRUE) {
+        return false;
+    }
+
+    if(xSemaphoreTake(_busMutex, pdMS_TO_TICKS(timeoutMs)) != pdTRUE) {
+        xSemaphoreGive(_mutex);
+        return false;
+    }
+
+    _opAddr = addr;
+    _opLen = len;
+    _opActive = true;
+    flashReadCacheInvalidate(&_cache, addr, len);
+
+    return true;
+}
+
+void W25::unlockOp() {
+    _opActive = false;
+    xSemaphoreGive(_busMutex);
+    xSemaphoreGive(_mutex);
+}
+
+bool W25::opOverlaps(uint32_t addr, size_t len) {
+    return (addr < (_opAddr + _opLen)) && (_opAddr < (addr + len));
+}
+
 /*!
  * Erase a sector in flash.
  * \param[in] addr - address of flash
@@ -214,9 +424,9 @@ bool W25::checkWEL(uint32_t timeoutMs, bool set, bool feedWDT) {
 */
 bool W25::eraseSector(uint32_t addr, uint32_t timeoutMs) {
     bool rval = false;
-    if(xSemaphoreTake(_mutex, pdMS_TO_TICKS(timeoutMs)) == pdTRUE) {
+    if(lockOp(addr, W25_SECTOR_SIZE, timeoutMs)) {
         rval = _eraseSector(addr);
-        xSemaphoreGive(_mutex);
+        unlockOp();
     } else {
         printf("Failed to acquire W25 mutex.\n");
     }
@@ -224,41 +434,43 @@ bool W25::eraseSector(uint32_t addr, uint32_t timeoutMs) {
 }
 
 /*!
- * Compute the crc32 checksum for segment of flash
+ * Read a range of flash in blocks (holding off writes, but not reads)
  * \param[in] addr - address of flash
- * \param[in] len - length of flash to compute checksum for
- * \param[out] crc32 - resulting crc32 (valid if return is true)
+ * \param[in] len - length to read
+ * \param[in] timeoutMs - how long to wait for the mutexes
+ * \param[in] blockFn - called with each block read
+ * \param[in] ctx - blockFn context
  * \return true if success, false if fail.
 */
-bool W25::crc32Checksum(uint32_t addr, size_t len, uint32_t &crc32, uint32_t timeoutMs) {
+bool W25::readBlocks(uint32_t addr, size_t len, uint32_t timeoutMs, void (*blockFn)(const uint8_t *data, size_t len, void *ctx), void *ctx) {
     configASSERT((addr + len) < W25_MAX_ADDRESS);
-    crc32 = 0;
+    configASSERT(blockFn);
     bool retval = true;
     if(xSemaphoreTake(_mutex, pdMS_TO_TICKS(timeoutMs)) == pdTRUE) {
-        bool first_read = true;
         uint32_t readlen = len;
         uint32_t offset = 0;
-        uint32_t blocklen = (readlen < W25_SECTOR_SIZE) ? readlen : W25_SECTOR_SIZE;
-        uint8_t* read_buf = (uint8_t *)pvPortMalloc(blocklen);
-        configASSERT(read_buf);
+        uint32_t blocklen = (readlen < W25_CHECKSUM_BLOCK_LEN) ? readlen : W25_CHECKSUM_BLOCK_LEN;
+        uint8_t* cmdBuff = (uint8_t *)pvPortMalloc(W25_RW_HEADER_LEN + blocklen);
+        configASSERT(cmdBuff);
         while(readlen){
-            printf("Reading addr %lu, size %lu \n", (addr + offset), blocklen);
-            if(!_read(addr + offset, read_buf, blocklen)){
-                printf("Write failed\n");
+            if(xSemaphoreTake(_busMutex, pdMS_TO_TICKS(timeoutMs)) != pdTRUE) {
+                printf("Failed to acquire W25 mutex.\n");
                 retval = false;
                 break;
             }
-            if(first_read){
-                crc32 = crc32_ieee(read_buf, blocklen);
-                first_read = false;
-            } else {
-                crc32 = crc32_ieee_update(crc32, read_buf, blocklen);
+            bool readOk = _readInPlace(addr + offset, cmdBuff, blocklen);
+            xSemaphoreGive(_busMutex);
+            if(!readOk){
+                printf("Read failed\n");
+                retval = false;
+                break;
             }
+            blockFn(&cmdBuff[W25_RW_HEADER_LEN], blocklen, ctx);
             offset += blocklen;
             readlen -= blocklen;
-            blocklen = (readlen < W25_SECTOR_SIZE) ? readlen : W25_SECTOR_SIZE;
+            blocklen = (readlen < W25_CHECKSUM_BLOCK_LEN) ? readlen : W25_CHECKSUM_BLOCK_LEN;
         }
-        vPortFree(read_buf);
+        vPortFree(cmdBuff);
         xSemaphoreGive(_mutex);
     } else {
         retval = false;
@@ -267,38 +479,109 @@ bool W25::crc32Checksum(uint32_t addr, size_t len, uint32_t &crc32, uint32_t tim
     return retval;
 }
 
+/*!
+ * Compute the crc32 checksum for segment of flash
+ * \param[in] addr - address of flash
+ * \param[in] len - length of flash to compute checksum for
+ * \param[out] crc32 - resulting crc32 (valid if return is true)
+ * \return true if success, false if fail.
+*/
+bool W25::crc32Checksum(uint32_t addr, size_t len, uint32_t &crc32, uint32_t timeoutMs) {
+    W25Crc32State_t state = {0, true};
+    bool retval = readBlocks(addr, len, timeoutMs, crc32Block, &state);
+    crc32 = state.crc;
+    return retval;
+}
+
+/*!
+ * Read from the read cache if possible (filling it on misses)
+ * \param[in] addr - address of flash
+ * \param[out] buffer - pointer to buffer to write into.
+ * \param[in] len - length of data
+ * \return true if success, false if fail.
+*/
+bool W25::_readCached(uint32_t addr, uint8_t *buffer, size_t len) {
+    if(flashReadCacheRead(&_cache, addr, buffer, len)) {
+        return true;
+    }
+
+    uint32_t lineAddr = addr & ~FLASH_READ_CACHE_LINE_MASK;
+    if(!flashReadCacheable(addr, len) || ((lineAddr + FLASH_READ_CACHE_LINE_SIZE) >= W25_MAX_ADDRESS)) {
+        return _read(addr, buffer, len);
+    }
+
+    flashReadCacheLine_t *line = flashReadCacheAlloc(&_cache, addr);
+    bool rval = _read(line->addr, line->data, FLASH_READ_CACHE_LINE_SIZE);
+    if(rval) {
+        line->valid = true;
+        memcpy(buffer, &line->data[addr - line->addr], len);
+    }
+    return rval;
+}
+
 bool W25::_read(uint32_t addr, uint8_t *buffer, size_t len) {
     configASSERT(buffer);
-    configASSERT(((addr + len) < W25_MAX_ADDRESS));
     bool rval = false;
-    const size_t buffLen = len + W25_RW_HEADER_LEN;
 
-    uint8_t *txBuff = (uint8_t *)pvPortMalloc(buffLen);
-    configASSERT(txBuff != NULL);
+    uint8_t *cmdBuff = (uint8_t *)pvPortMalloc(len + W25_RW_HEADER_LEN);
+    configASSERT(cmdBuff != NULL);
 
-    uint8_t *rxBuff = (uint8_t *)pvPortMalloc(buffLen);
-    configASSERT(rxBuff != NULL);
+    if(_readInPlace(addr, cmdBuff, len)) {
+        memcpy(buffer, &cmdBuff[W25_RW_HEADER_LEN], len);
+        rval = true;
+    }
 
-    /* Clear tx buff */
-    memset(txBuff, 0, buffLen);
+    vPortFree(cmdBuff);
 
-    txBuff[0] = READ_DATA;
-    txBuff[1] = (addr >> 16) & 0xFF;
-    txBuff[2] = (addr >> 8) & 0xFF;
-    txBuff[3] = addr & 0xFF;
+    return rval;
+}
 
-    /* Make sure there's no write in progress! */
-    if(readyToWrite(W25_WRITE_TIMEOUT_MS)) {
-        if(writeReadBytes(rxBuff, buffLen, txBuff, 100, true) == SPI_OK){
-            memcpy(buffer, &rxBuff[W25_RW_HEADER_LEN], len);
-            rval = true;
+/*!
+ * Read from flash into a command buffer. The data ends up right after the
+ * command header, at cmdBuff[W25_RW_HEADER_LEN]. Must hold _busMutex.
+ * \param[in] addr - address of flash
+ * \param[in] cmdBuff - buffer of W25_RW_HEADER_LEN + len bytes
+ * \param[in] len - length of data
+ * \return true if success, false if fail.
+*/
+bool W25::_readInPlace(uint32_t addr, uint8_t *cmdBuff, size_t len) {
+    configASSERT(cmdBuff);
+    configASSERT(((addr + len) < W25_MAX_ADDRESS));
+    bool rval = false;
+    bool suspended = false;
+    uint64_t startUs = uptimeGetMicroSeconds();
+
+    do {
+        if(_eraseInProgress) {
+            /* Don't wait for the erase, suspend it while reading */
+            if(!suspendErase(suspended)) {
+                printf("Unable to suspend erase\n");
+                break;
+            }
+        } else if(!waitWhileBusy(W25_WRITE_TIMEOUT_MS, W25_PROGRAM_POLL_MS)) {
+            /* Make sure there's no write in progress! */
+            printf("Timeout waiting for write to complete\n");
+            break;
         }
-    } else {
-        printf("Timeout waiting for write to complete\n");
+
+        cmdBuff[0] = READ_DATA;
+        cmdBuff[1] = (addr >> 16) & 0xFF;
+        cmdBuff[2] = (addr >> 8) & 0xFF;
+        cmdBuff[3] = addr & 0xFF;
+
+        /* Same buffer for tx and rx. Every byte goes out before the byte
+         * replacing it comes in, and the flash ignores what's sent after
+         * the header. */
+        rval = (writeReadBytes(cmdBuff, len + W25_RW_HEADER_LEN, cmdBuff, 100, true) == SPI_OK);
+    } while(0);
+
+    if(suspended && !resumeErase()) {
+        printf("Unable to resume erase\n");
     }
 
-    vPortFree(txBuff);
-    vPortFree(rxBuff);
+    if(rval) {
+        latencyHistogramAdd(&_stats->read, (uint32_t)(uptimeGetMicroSeconds() - startUs));
+    }
 
     return rval;
 }
@@ -307,13 +590,12 @@ bool W25::_write(uint32_t addr, uint8_t *buffer, size_t len) {
     configASSERT(buffer);
     configASSERT(((addr + len) < W25_MAX_ADDRESS));
     bool rval = true;
-    /* Allocate mem for a page request to Flash */
-    uint8_t *pageReqBuff = (uint8_t *)pvPortMalloc(W25_PAGE_SIZE + W25_RW_HEADER_LEN);
-    configASSERT(pageReqBuff != NULL);
 
-    /* Allocate mem to read out sector at a time */
-    uint8_t *sectorBuff = (uint8_t*)pvPortMalloc(W25_SECTOR_SIZE);
-    configASSERT(sectorBuff != NULL);
+    /* Allocate mem to read out sector at a time, with room for a command
+     * header in front so it can be read and programmed without copies */
+    uint8_t *sectorCmdBuff = (uint8_t*)pvPortMalloc(W25_RW_HEADER_LEN + W25_SECTOR_SIZE);
+    configASSERT(sectorCmdBuff != NULL);
+    uint8_t *sectorBuff = &sectorCmdBuff[W25_RW_HEADER_LEN];
 
     /* Flash operation variables */
     size_t totalBytesRemaining = len;
@@ -347,9 +629,6 @@ bool W25::_write(uint32_t addr, uint8_t *buffer, size_t len) {
     wrAddr = startSectorAddr;
 
     for (int i=0; i < numSectors; i++) {
-        /* Reset sectorBuffer */
-        memset(sectorBuff,0xFF, W25_SECTOR_SIZE);
-
         /* Set current Address (based on current sector and start offset) */
         currSectorAddr = startSectorAddr + (W25_SECTOR_SIZE * i);
         configASSERT(currSectorAddr == wrAddr);
@@ -371,7 +650,7 @@ bool W25::_write(uint32_t addr, uint8_t *buffer, size_t len) {
             }
         }
 
-        if(!_read(currSectorAddr, sectorBuff, W25_SECTOR_SIZE)) {
+        if(!_readInPlace(currSectorAddr, sectorCmdBuff, W25_SECTOR_SIZE)) {
             printf("Unable to read sector.\n");
             rval = false;
             break;
@@ -398,50 +677,50 @@ bool W25::_write(uint32_t addr, uint8_t *buffer, size_t len) {
 
         /* Iterate through pages in sector to re-write to flash */
         for (int j=0; j < W25_NUM_PAGES_IN_SECTOR; j++) {
-            /* Reset pageReq Buffer */
-            memset(pageReqBuff, 0xFF, (W25_PAGE_SIZE + W25_RW_HEADER_LEN));
-
-            /* Make sure the previous write finished */
-            if(!readyToWrite(W25_WRITE_TIMEOUT_MS)) {
-                printf("Timeout waiting for write to complete\n");
-                sectorWriteSuccess = false;
-                break;
+            uint8_t *page = &sectorBuff[wrAddr - currSectorAddr];
+
+            /* Erased pages don't need programming */
+            bool erased = true;
+            for(uint32_t byte = 0; byte < W25_PAGE_SIZE; byte++) {
+                if(page[byte] != 0xFF) {
+                    erased = false;
+                    break;
+                }
             }
-
-            /* Enable writes */
-            uint8_t writeEnReq = WRITE_ENABLE;
-            if(writeBytes(&writeEnReq, sizeof(writeEnReq), 10,true) != SPI_OK) {
-                printf("Error sending WREN command\n");
-                sectorWriteSuccess = false;
-                break;
+            if(erased) {
+                wrAddr += W25_PAGE_SIZE;
+                continue;
             }
 
-            /* Ensure WEL is set */
-            if(!checkWEL(W25_WRITE_TIMEOUT_MS, true)) {
-                printf("Timeout waiting for write to complete\n");
+            if(!writeEnable()) {
                 sectorWriteSuccess = false;
                 break;
             }
 
+            /* The command header goes in the 4 bytes before the page, which
+             * are either the header space or the end of the previous page
+             * (already programmed), so the DMA sends straight from the
+             * sector buffer */
+            uint8_t *pageReqBuff = page - W25_RW_HEADER_LEN;
             pageReqBuff[0] = PAGE_PROGRAM;
             pageReqBuff[1] = (wrAddr >> 16) & 0xFF;
             pageReqBuff[2] = (wrAddr >> 8) & 0xFF;
             pageReqBuff[3] = wrAddr & 0xFF;
 
-            memcpy(&pageReqBuff[W25_RW_HEADER_LEN], &sectorBuff[wrAddr - currSectorAddr], W25_PAGE_SIZE);
-
+            uint64_t startUs = uptimeGetMicroSeconds();
             if(writeBytes(pageReqBuff, W25_RW_HEADER_LEN + W25_PAGE_SIZE, 10, true) != SPI_OK) {
                 printf("Error writing bytes\n");
                 sectorWriteSuccess = false;
                 break;
             }
 
-            /* Ensure WEL is reset */
-            if(!checkWEL(W25_WRITE_TIMEOUT_MS, false)) {
+            /* Wait for the program to finish */
+            if(!waitWhileBusy(W25_WRITE_TIMEOUT_MS, W25_PROGRAM_POLL_MS)) {
                 printf("Timeout waiting for write to complete\n");
                 sectorWriteSuccess = false;
                 break;
             }
+            latencyHistogramAdd(&_stats->program, (uint32_t)(uptimeGetMicroSeconds() - startUs));
 
             /* Update Flash Write address */
             wrAddr += W25_PAGE_SIZE;
@@ -455,13 +734,18 @@ bool W25::_write(uint32_t addr, uint8_t *buffer, size_t len) {
         }
     };
 
-    vPortFree(pageReqBuff);
-    vPortFree(sectorBuff);
+    vPortFree(sectorCmdBuff);
 
     return rval;
 
 }
 
+/*!
+ * Erase a sector. Must hold _busMutex, which is released while waiting for
+ * the erase to finish so reads can suspend it.
+ * \param[in] addr - sector address
+ * \return true if success, false if fail.
+*/
 bool W25::_eraseSector(uint32_t addr) {
     /* Ensure that address/offset is Sector Aligned */
     configASSERT((addr & W25_SECTOR_MASK) == 0);
@@ -469,23 +753,8 @@ bool W25::_eraseSector(uint32_t addr) {
     bool retv = false;
     uint8_t txBuff[4] = {0};
 
-    /* Make sure the previous write finished */
     do {
-        if(!readyToWrite(W25_WRITE_TIMEOUT_MS)) {
-            printf("Timeout waiting for write to complete\n");
-            break;
-        }
-
-        /* Enable writes */
-        txBuff[0] = WRITE_ENABLE;
-        if(writeBytes(txBuff, 1, 10,true) != SPI_OK) {
-            printf("Error sending WREN command\n");
-            break;
-        }
-
-        /* check if WEL is set */
-        if(!checkWEL(W25_WRITE_TIMEOUT_MS, true)) {
-            printf("Timeout waiting for write to complete\n");
+        if(!writeEnable()) {
             break;
         }
 
@@ -494,19 +763,48 @@ bool W25::_eraseSector(uint32_t addr) {
         txBuff[1] = (addr >> 16) & 0xFF;
         txBuff[2] = (addr >> 8) & 0xFF;
         txBuff[3] = addr & 0xFF;
+        uint64_t startUs = uptimeGetMicroSeconds();
         if(writeBytes(txBuff, sizeof(txBuff), 10,true) != SPI_OK) {
             printf("Error sending Erase Chip command\n");
             break;
         }
 
-        if(!checkWEL(W25_SECTOR_ERASE_TIMEOUT_MS, false, true)) {
+        _eraseInProgress = true;
+        uint32_t startTime = xTaskGetTickCount();
+        bool timedOut = false;
+        do {
+            /* Let other tasks read while the erase runs */
+            xSemaphoreGive(_busMutex);
+            watchdogFeed();
+            vTaskDelay(pdMS_TO_TICKS(W25_ERASE_POLL_MS));
+            xSemaphoreTake(_busMutex, portMAX_DELAY);
+
+            uint8_t status;
+            if(!readStatus(status)) {
+                break;
+            }
+            if(!(status & W25_SR1_BUSY)) {
+                uint8_t status2;
+                if(!readStatus2(status2)) {
+                    break;
+                }
+                if(!(status2 & W25_SR2_SUS)) {
+                    retv = true;
+                } else if(!resumeErase()) {
+                    /* A reader failed to resume it */
+                    break;
+                }
+            }
+            timedOut = !timeRemainingTicks(startTime, pdMS_TO_TICKS(W25_SECTOR_ERASE_TIMEOUT_MS));
+        } while(!retv && !timedOut);
+        _eraseInProgress = false;
+
+        if(!retv) {
             printf("Timeout waiting for write to complete\n");
             break;
         }
-
-        retv = true;
-        printf("Successfully erased sector\n");
-    } while (!retv);
+        latencyHistogramAdd(&_stats->erase, (uint32_t)(uptimeGetMicroSeconds() - startUs));
+    } while (0);
 
     return retv;
 }
@@ -519,6 +817,20 @@ uint32_t W25::getStorageSizeBytes(void) {
     return W25Q64JVXGIQ_CAPCITY_BYTES;
 }
 
+/*!
+ * Get erase/program/read latency histograms
+ * \return stats
+*/
+const W25Stats_t *W25::getStats(void) {
+    return _stats;
+}
+
+void W25::resetStats(void) {
+    latencyHistogramReset(&_stats->erase);
+    latencyHistogramReset(&_stats->program);
+    latencyHistogramReset(&_stats->read);
+}
+
 /*!
  * Erase flash. Note that we can only erase in minimum sizes of 4096 byte sectors, and aligned on a sector.
  * \param[in] addr - address of flash, aligned to 4096 bytes
@@ -533,7 +845,7 @@ bool W25::erase(uint32_t addr, size_t len, uint32_t timeoutMs) {
     }    
     configASSERT(erase_start_addr + len + (len % W25_SECTOR_SIZE) < W25_MAX_ADDRESS);
     bool rval = false;
-    if(xSemaphoreTake(_mutex, pdMS_TO_TICKS(timeoutMs)) == pdTRUE) {
+    if(lockOp(erase_start_addr, (len + W25_SECTOR_MASK) & ~W25_SECTOR_MASK, timeoutMs)) {
         uint32_t current_addr = erase_start_addr;
         while(current_addr < (erase_start_addr + len)){
             if(!_eraseSector(current_addr)){
@@ -544,7 +856,7 @@ bool W25::erase(uint32_t addr, size_t len, uint32_t timeoutMs) {
         if(current_addr >= (erase_start_addr + len)){
             rval = true;
         }
-        xSemaphoreGive(_mutex);
+        unlockOp();
     } else {
         printf("Failed to acquire W25 mutex.\n");
     }
@@ -552,34 +864,8 @@ bool W25::erase(uint32_t addr, size_t len, uint32_t timeoutMs) {
 }
 
 bool W25::crc16(uint32_t addr, size_t len, uint16_t &crc, uint32_t timeoutMs) {
-    configASSERT((addr + len) < W25_MAX_ADDRESS);
     crc = 0;
-    bool retval = true;
-    if(xSemaphoreTake(_mutex, pdMS_TO_TICKS(timeoutMs)) == pdTRUE) {
-        uint32_t readlen = len;
-        uint32_t offset = 0;
-        uint32_t blocklen = (readlen < W25_SECTOR_SIZE) ? readlen : W25_SECTOR_SIZE;
-        uint8_t* read_buf = (uint8_t *)pvPortMalloc(blocklen);
-        configASSERT(read_buf);
-        while(readlen){
-            printf("Reading addr %lu, size %lu \n", (addr + offset), blocklen);
-            if(!_read(addr + offset, read_buf, blocklen)){
-                printf("Write failed\n");
-                retval = false;
-                break;
-            }
-            crc = crc16_ccitt(crc, read_buf, blocklen);
-            offset += blocklen;
-            readlen -= blocklen;
-            blocklen = (readlen < W25_SECTOR_SIZE) ? readlen : W25_SECTOR_SIZE;
-        }
-        vPortFree(read_buf);
-        xSemaphoreGive(_mutex);
-    } else {
-        retval = false;
-        printf("Failed to acquire W25 mutex.\n");
-    }
-    return retval;
+    return readBlocks(addr, len, timeoutMs, crc16Block, &crc);
 }
 
 } // namespace spiflash
@@ -4,9 +4,19 @@
 #include "FreeRTOS.h"
 #include "semphr.h"
 #include "abstract_storage_driver.h"
+#include "flash_read_cache.h"
+#include "latency_histogram.h"
+#include "perf_counters.h"
 
 namespace spiflash {
 
+// Operation latencies (microseconds)
+typedef struct {
+    latencyHistogram_t erase;
+    latencyHistogram_t program;
+    latencyHistogram_t read;
+} W25Stats_t;
+
 class W25 : public AbstractSPI, public AbstractStorageDriver {
 public:
     W25(SPIInterface_t *interface, IOPinHandle_t *csPin);
@@ -19,15 +29,42 @@ public:
     bool crc32Checksum(uint32_t addr, size_t len, uint32_t &crc32, uint32_t timeoutMs=100);
     uint32_t getAlignmentBytes(void);
     uint32_t getStorageSizeBytes(void);
+    const W25Stats_t *getStats(void);
+    void resetStats(void);
 private:
-    bool readyToWrite(uint32_t timeoutMs);
+    bool waitWhileBusy(uint32_t timeoutMs, uint32_t pollMs, bool feedWDT=false);
     bool readStatus(uint8_t &status);
-    bool checkWEL(uint32_t timeoutMs, bool set, bool feedWDT=false);
+    bool readStatus2(uint8_t &status);
+    bool checkWEL(uint32_t timeoutMs, bool set);
+    bool writeEnable();
+    bool suspendErase(bool &suspended);
+    bool resumeErase();
+    bool lockOp(uint32_t addr, size_t len, uint32_t timeoutMs);
+    void unlockOp();
+    bool opOverlaps(uint32_t addr, size_t len);
+    bool readBlocks(uint32_t addr, size_t len, uint32_t timeoutMs, void (*blockFn)(const uint8_t *data, size_t len, void *ctx), void *ctx);
+    bool _readCached(uint32_t addr, uint8_t *buffer, size_t len);
     bool _read(uint32_t addr, uint8_t *buffer, size_t len);
+    bool _readInPlace(uint32_t addr, uint8_t *cmdBuff, size_t len);
     bool _write(uint32_t addr, uint8_t *buffer, size_t len);
     bool _eraseSector(uint32_t addr);
 private:
+    // Held for a whole write/erase (and checksums)
     SemaphoreHandle_t _mutex;
+    // Held for flash commands. Released while waiting for sector erases,
+    // so reads elsewhere in flash can suspend them.
+    SemaphoreHandle_t _busMutex;
+
+    // Range being written/erased (valid while _opActive)
+    bool _opActive;
+    uint32_t _opAddr;
+    size_t _opLen;
+    volatile bool _eraseInProgress;
+    uint64_t _lastResumeUs;
+
+    flashReadCache_t _cache;
+    W25Stats_t *_stats;
+    perfCounter_t _suspends;
 };
 
-} // namespace spiflash
\ No newline at end of file
+} // namespace spiflash
@@ -27,6 +27,12 @@
 #define TCPIP_MBOX_SIZE                   16
 #define TCPIP_THREAD_STACKSIZE            8192
 
+#if defined(TRACE_ENABLE) && defined(TRACE_PACKETS)
+// Record when the tcpip thread starts processing each packet (never consumes it)
+#include "trace.h"
+#define LWIP_HOOK_IP6_INPUT(pbuf, input_netif) (tracePacket(kTraceEventPktLwipInput, (pbuf)), 0)
+#endif
+
 // Needed for multicast
 #define LWIP_IPV6_MLD                     (LWIP_IPV6)
 #define LWIP_MULTICAST_TX_OPTIONS         1
@@ -18,6 +18,7 @@
 #include "memfault/panics/platform/coredump.h"
 #include "memfault/ports/freertos.h"
 #include "memfault/ports/reboot_reason.h"
+#include "perf_counters.h"
 #include "reset_reason.h"
 #include "version.h"
 #include "FreeRTOS.h"
@@ -353,3 +354,31 @@ bool memfault_platform_coredump_save_begin(void) {
   watchdogFeed();
   return true;
 }
+
+/*!
+  Get number of drops on a queue since the previous heartbeat
+
+  \param[in] *queueName - queue counter group (see perfQueueRegister)
+  \param[in,out] *last - drop count at the previous heartbeat
+  \return number of drops since the previous heartbeat
+*/
+static uint32_t heartbeatQueueDrops(const char *queueName, uint32_t *last) {
+  uint32_t dropped = perfCounterGet(queueName, "dropped");
+  uint32_t delta = dropped - *last;
+  *last = dropped;
+  return delta;
+}
+
+void memfault_metrics_heartbeat_collect_data(void) {
+  static uint32_t netQueueDrops, bcmpRxQueueDrops, l2EvtQueueDrops, ethEvtQueueDrops, serialTxQueueDrops;
+
+  perfCountersSample();
+
+  memfault_metrics_heartbeat_set_unsigned(MEMFAULT_METRICS_KEY(netQueueDrops), heartbeatQueueDrops("mw_net_q", &netQueueDrops));
+  memfault_metrics_heartbeat_set_unsigned(MEMFAULT_METRICS_KEY(bcmpRxQueueDrops), heartbeatQueueDrops("bcmp_rx_q", &bcmpRxQueueDrops));
+  memfault_metrics_heartbeat_set_unsigned(MEMFAULT_METRICS_KEY(l2EvtQueueDrops), heartbeatQueueDrops("l2_evt_q", &l2EvtQueueDrops));
+  memfault_metrics_heartbeat_set_unsigned(MEMFAULT_METRICS_KEY(ethEvtQueueDrops), heartbeatQueueDrops("eth_evt_q", &ethEvtQueueDrops));
+  memfault_metrics_heartbeat_set_unsigned(MEMFAULT_METRICS_KEY(serialTxQueueDrops), heartbeatQueueDrops("serial_tx_q", &serialTxQueueDrops));
+  memfault_metrics_heartbeat_set_unsigned(MEMFAULT_METRICS_KEY(heapMinFreeBytes), perfCounterGet("heap", "min_free"));
+  memfault_metrics_heartbeat_set_unsigned(MEMFAULT_METRICS_KEY(cpuLoadPctX100), perfCounterGet("cpu", "load_pct_x100"));
+}
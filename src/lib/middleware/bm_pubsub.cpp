@@ -1,11 +1,53 @@
+#include <inttypes.h>
 #include <string.h>
 #include "FreeRTOS.h"
+#include "semphr.h"
+#include "task.h"
 #include "lwip/ip_addr.h"
 #include "lwip/inet.h"
 #include "bm_pubsub.h"
 #include "middleware.h"
 #include "bm_util.h"
+#include "bm_l2.h"
+#include "bcmp_neighbors.h"
 #include "bcmp_resource_discovery.h"
+#include "bm_store_forward.h"
+#include "device_info.h"
+#include "mem_pool.h"
+#include "perf_counters.h"
+#include "pubsub_frag.h"
+#include "pubsub_limits.h"
+#include "pubsub_qos.h"
+#include "pubsub_routes.h"
+#include "trace.h"
+#include "uptime.h"
+
+#define BM_PUBSUB_TYPE_PUB  (0)
+#define BM_PUBSUB_TYPE_ACK  (1)
+#define BM_PUBSUB_TYPE_FRAG (2)
+
+// Reliable (QoS 1) publication. A 16 bit sequence number follows the topic
+// and subscribers ack it. There's no room in the header for it, so it's only
+// there when this flag is set.
+#define BM_PUBSUB_FLAG_RELIABLE (1 << 0)
+
+#define QOS_INITIAL_TIMEOUT_MS  (250)
+#define QOS_MAX_TIMEOUT_MS      (4000)
+#define QOS_MAX_RETRIES         (5)
+
+// Publish straight to subscribers when there are only a few of them and
+// they're all direct neighbors (unicast isn't forwarded past them).
+// Everything else is multicast.
+#define BM_PUB_MAX_UNICAST_DESTS  (2)
+
+// Drop a partially received message if no fragment arrives for this long
+#define FRAG_RX_TIMEOUT_MS      (1000)
+// Give the receivers' (short) rx queues a chance to drain every few fragments
+#define FRAG_TX_BURST           (8)
+#define FRAG_TX_BURST_DELAY_MS  (10)
+// Forget a subscription if its node misses a few resource table announcements
+// (BCMP heartbeats are 10s apart)
+#define ROUTES_TTL_MS (3 * BCMP_RESOURCE_ANNOUNCE_HEARTBEATS * 10 * 1000)
 
 typedef struct {
   uint8_t type;
@@ -14,6 +56,34 @@ typedef struct {
   const char topic[0];
 } __attribute__((packed)) bm_pubsub_header_t;
 
+// Follows a BM_PUBSUB_TYPE_ACK header (with no topic, so nodes that don't
+// know about acks never match it to a subscription)
+typedef struct {
+  uint64_t publisher_node_id;
+  uint16_t seq;
+} __attribute__((packed)) bm_pubsub_ack_t;
+
+// A BM_PUBSUB_TYPE_FRAG header (also with no topic) is followed by a
+// pubsubFragHeader_t and the fragment data. Reassembled, the fragments are
+// a regular message (header, topic and data). The fragment header has the
+// topic's hash, so nodes that aren't subscribed don't reassemble it.
+#define BM_PUBSUB_FRAG_HDR_LEN  (sizeof(bm_pubsub_header_t) + sizeof(pubsubFragHeader_t))
+static_assert(BM_PUBSUB_FRAG_HDR_LEN + PUBSUB_FRAG_DATA_LEN <= MIDDLEWARE_MAX_PAYLOAD_LEN, "Fragments don't fit in a frame");
+
+static_assert((int)BM_PUBSUB_PRIO_LOW == (int)PUBSUB_PRIO_LOW, "Priority classes don't match");
+static_assert((int)BM_PUBSUB_PRIO_NORMAL == (int)PUBSUB_PRIO_NORMAL, "Priority classes don't match");
+static_assert((int)BM_PUBSUB_PRIO_HIGH == (int)PUBSUB_PRIO_HIGH, "Priority classes don't match");
+
+typedef struct {
+  perfCounter_t sent;
+  perfCounter_t acked;
+  perfCounter_t retries;
+  perfCounter_t give_ups;
+  perfCounter_t window_full;
+  perfCounter_t acks_sent;
+  perfCounter_t rx_duplicates;
+} bm_pub_qos_counters_t;
+
 // Used for callback linked-list
 typedef struct bm_cb_node_s {
   struct bm_cb_node_s *next;
@@ -23,6 +93,8 @@ typedef struct bm_cb_node_s {
 typedef struct {
     char *topic;
     uint16_t topic_len;
+    // pubsubRoutesHash of topic (to match fragments)
+    uint32_t topic_hash;
     bm_cb_node_t *callbacks;
 } bm_sub_t;
 
@@ -33,13 +105,65 @@ typedef struct bm_sub_node_s {
 
 typedef struct {
   bm_sub_node_t subscription_list;
+
+  // Reliable publishing. tx is shared with publishing tasks, rx is only used
+  // by the middleware task.
+  SemaphoreHandle_t qos_lock;
+  pubsubQosTx_t qos_tx;
+  pubsubQosRx_t qos_rx;
+  bm_pub_qos_counters_t qos_counters;
+
+  // Who subscribes to what (learned from resource table announcements)
+  SemaphoreHandle_t routes_lock;
+  pubsubRoutes_t routes;
+  bool directed;
+  perfCounter_t tx_unicast;
+  perfCounter_t tx_multicast;
+
+  // Fragmentation. rx is only used by the middleware task.
+  uint16_t frag_msg_id;
+  pubsubFragRx_t frag_rx;
+  perfCounter_t frag_tx;
+  perfCounter_t frag_rx_complete;
+  perfCounter_t frag_rx_dropped;
+  perfCounter_t frag_rx_timeouts;
+
+  // Rate limits and priority classes. Used by publishing tasks, the lwip task
+  // (received messages) and the middleware task.
+  SemaphoreHandle_t limits_lock;
+  pubsubLimits_t limits;
+  perfCounter_t tx_limited;
+  perfCounter_t tx_shed;
+  perfCounter_t rx_limited;
+  // Received messages that skipped the limits (or priority lookup) because
+  // the lock was busy
+  perfCounter_t limits_busy;
 } pubsubContext_t;
 
 static bm_sub_node_t* delete_sub(const char* topic, uint16_t topic_len);
 static bm_sub_node_t* get_sub(const char* topic, uint16_t topic_len);
+static bool has_sub_hash(uint32_t topic_hash);
 static bm_sub_node_t* get_last_sub(void);
+static bool qos_send_copy(struct pbuf *msg);
+static int32_t pubsub_net_tx(struct pbuf *pbuf, const char *topic, uint16_t topic_len, bm_pubsub_priority_e prio);
+static int32_t pubsub_send(struct pbuf *pbuf, const char *topic, uint16_t topic_len);
+static void *frag_alloc_cb(uint16_t len, uint8_t **data);
+static void frag_free_cb(void *msg);
+static void handle_pub(uint64_t node_id, const bm_pubsub_header_t *header, uint16_t len, struct pbuf *pbuf);
+static void routes_table_cb(const bcmp_resource_table_reply_t *repl, uint16_t len);
+static bool limits_tx(const char *topic, uint16_t topic_len, uint32_t bytes);
+static bm_pubsub_priority_e topic_priority(const char *topic, uint16_t topic_len, TickType_t wait);
 static pubsubContext_t _ctx;
 
+// Subscriptions come and go at runtime, so keep their list nodes off the heap
+#define SUB_NODE_POOL_SIZE  (16)
+#define CB_NODE_POOL_SIZE   (24)
+MEM_POOL_DEFINE(pubsub_sub_nodes, sizeof(bm_sub_node_t), SUB_NODE_POOL_SIZE, true);
+MEM_POOL_DEFINE(pubsub_cb_nodes, sizeof(bm_cb_node_t), CB_NODE_POOL_SIZE, true);
+// Fragmented messages are reassembled here and never on the lwIP heap, so
+// they can't starve the network stack
+MEM_POOL_DEFINE(pubsub_frag_bufs, PUBSUB_FRAG_RX_MAX_LEN, PUBSUB_FRAG_RX_SLOTS, false);
+
 /*!
   Subscribe to a specific string topic with callback
 
@@ -59,6 +183,21 @@ bool bm_sub(const char *topic, const bm_cb_t callback) {
   return retv;
 }
 
+/*!
+  Subscribe to a specific string topic with callback, and set the topic's
+  priority class (see bm_pubsub_set_topic_priority)
+
+  \param[in] *topic topic string to subscribe to
+  \param[in] callback callback function to call when data is received on this topic
+  \param[in] prio topic priority class
+  \return True if we've successfully subscribed
+*/
+bool bm_sub_prio(const char *topic, const bm_cb_t callback, bm_pubsub_priority_e prio) {
+  // Still subscribe if there's no room for the priority, just at normal priority
+  bm_pubsub_set_topic_priority(topic, prio);
+  return bm_sub(topic, callback);
+}
+
 /*!
   Subscribe to a specific string topic with callback (while providing topic_len)
 
@@ -102,7 +241,7 @@ bool bm_sub_wl(const char *topic, uint16_t topic_len, const bm_cb_t callback) {
       }
 
       // Add new callback item to linked-list
-      bm_cb_node_t *cb_node = static_cast<bm_cb_node_t *>(pvPortMalloc(sizeof(bm_cb_node_t)));
+      bm_cb_node_t *cb_node = static_cast<bm_cb_node_t *>(memPoolAlloc(&pubsub_cb_nodes));
       configASSERT(cb_node);
 
       cb_node->next = NULL;
@@ -120,7 +259,7 @@ bool bm_sub_wl(const char *topic, uint16_t topic_len, const bm_cb_t callback) {
         ptr = &_ctx.subscription_list;
       }
 
-      ptr->next = static_cast<bm_sub_node_t *>(pvPortMalloc(sizeof(bm_sub_node_t)));
+      ptr->next = static_cast<bm_sub_node_t *>(memPoolAlloc(&pubsub_sub_nodes));
       if(!ptr->next){
         break;
       }
@@ -128,15 +267,17 @@ bool bm_sub_wl(const char *topic, uint16_t topic_len, const bm_cb_t callback) {
       memset(ptr->next, 0x00, sizeof(bm_sub_node_t));
       ptr->next->sub.topic = static_cast<char *>(pvPortMalloc(topic_len + 1));
       if(!ptr->next->sub.topic){
-        vPortFree(ptr->next);
+        memPoolFree(&pubsub_sub_nodes, ptr->next);
+        ptr->next = NULL;
         break;
       }
       memcpy(ptr->next->sub.topic, topic, topic_len);
       ptr->next->sub.topic[topic_len] = 0;
       ptr->next->sub.topic_len = topic_len;
+      ptr->next->sub.topic_hash = pubsubRoutesHash(topic, topic_len);
 
       // Add first callback item to linked-list
-      bm_cb_node_t *cb_node = static_cast<bm_cb_node_t *>(pvPortMalloc(sizeof(bm_cb_node_t)));
+      bm_cb_node_t *cb_node = static_cast<bm_cb_node_t *>(memPoolAlloc(&pubsub_cb_nodes));
       configASSERT(cb_node);
 
       cb_node->next = NULL;
@@ -223,7 +364,7 @@ bool bm_unsub_wl(const char *topic, uint16_t topic_len, const bm_cb_t callback)
       }
 
       // Free deleted node
-      vPortFree(cb_node);
+      memPoolFree(&pubsub_cb_nodes, cb_node);
 
       // If there are no more callbacks, delete the sub entirely
       if(ptr->sub.callbacks == NULL) {
@@ -265,7 +406,25 @@ bool bm_pub(const char *topic, const void *data, uint16_t len) {
 }
 
 /*!
-  Publish data to specific string topic (while providing topic len)
+  Publish data to specific string topic, and set the topic's priority class
+  (see bm_pubsub_set_topic_priority)
+
+  \param[in] *topic topic string to publish to
+  \param[in] *data pointer to data to publish
+  \param[in] length of data to publish
+  \param[in] prio topic priority class
+  \return True if data has been queued to be publish (does not guarantee that it will be published though!)
+*/
+bool bm_pub_prio(const char *topic, const void *data, uint16_t len, bm_pubsub_priority_e prio) {
+  // Still publish if there's no room for the priority, just at normal priority
+  bm_pubsub_set_topic_priority(topic, prio);
+  return bm_pub(topic, data, len);
+}
+
+/*!
+  Publish data to specific string topic (while providing topic len). Data
+  that doesn't fit in one frame is sent in fragments and reassembled by
+  subscribers (up to BM_PUB_MAX_DATA_LEN bytes).
 
   \param[in] *topic topic string to unsubscribe from
   \param[in] topic_len length of topic string
@@ -276,8 +435,24 @@ bool bm_pub(const char *topic, const void *data, uint16_t len) {
 bool bm_pub_wl(const char *topic, uint16_t topic_len, const void *data, uint16_t len) {
   bool retv = true;
 
+  // Subscribers couldn't reassemble it
+  if(len > BM_PUB_MAX_DATA_LEN(topic_len)) {
+    return false;
+  }
+
+  // Over the topic's rate limit. Counted (see bm_pubsub_print_limits), but
+  // not printed, since it happens all the time to publishers that are too fast.
+  if(!limits_tx(topic, topic_len, sizeof(bm_pubsub_header_t) + topic_len + len)) {
+    return false;
+  }
+
   do {
 
+    // No route right now, keep it around and publish it later
+    if(bm_store_forward_store(topic, topic_len, data, len)) {
+      break;
+    }
+
     uint16_t message_size = sizeof(bm_pubsub_header_t) + topic_len + len;
     struct pbuf *pbuf = pbuf_alloc(PBUF_TRANSPORT, message_size, PBUF_RAM);
     if(!pbuf) {
@@ -304,7 +479,7 @@ bool bm_pub_wl(const char *topic, uint16_t topic_len, const void *data, uint16_t
       bm_middleware_local_pub(pbuf);
     }
 
-    if (middleware_net_tx(pbuf)) {
+    if (pubsub_send(pbuf, topic, topic_len)) {
       retv = false;
     }
     pbuf_free(pbuf);
@@ -321,6 +496,880 @@ bool bm_pub_wl(const char *topic, uint16_t topic_len, const void *data, uint16_t
   return retv;
 }
 
+/*!
+  Initialize pub/sub (reliable publishing state)
+
+  \return None
+*/
+void bm_pubsub_init(void) {
+  configASSERT(_ctx.qos_lock == NULL);
+
+  _ctx.qos_lock = xSemaphoreCreateMutex();
+  configASSERT(_ctx.qos_lock);
+
+  // Start somewhere different every boot so subscribers don't mistake our
+  // first messages for retransmissions from before the reset
+  uint16_t first_seq = (uint16_t)(uptimeGetStartTime() ^ uptimeGetMicroSeconds() ^ getNodeId());
+  pubsubQosTxInit(&_ctx.qos_tx, first_seq, QOS_INITIAL_TIMEOUT_MS, QOS_MAX_TIMEOUT_MS, QOS_MAX_RETRIES);
+  pubsubQosRxInit(&_ctx.qos_rx);
+
+  perfCounterRegister(&_ctx.qos_counters.sent, "pubsub", "qos_sent", PERF_COUNTER_TYPE_COUNT);
+  perfCounterRegister(&_ctx.qos_counters.acked, "pubsub", "qos_acked", PERF_COUNTER_TYPE_COUNT);
+  perfCounterRegister(&_ctx.qos_counters.retries, "pubsub", "qos_retries", PERF_COUNTER_TYPE_COUNT);
+  perfCounterRegister(&_ctx.qos_counters.give_ups, "pubsub", "qos_give_ups", PERF_COUNTER_TYPE_COUNT);
+  perfCounterRegister(&_ctx.qos_counters.window_full, "pubsub", "qos_window_full", PERF_COUNTER_TYPE_COUNT);
+  perfCounterRegister(&_ctx.qos_counters.acks_sent, "pubsub", "qos_acks_sent", PERF_COUNTER_TYPE_COUNT);
+  perfCounterRegister(&_ctx.qos_counters.rx_duplicates, "pubsub", "qos_rx_dups", PERF_COUNTER_TYPE_COUNT);
+
+  _ctx.routes_lock = xSemaphoreCreateMutex();
+  configASSERT(_ctx.routes_lock);
+  pubsubRoutesInit(&_ctx.routes, ROUTES_TTL_MS);
+  // Opt-in, see bm_pub_set_directed
+  _ctx.directed = false;
+  perfCounterRegister(&_ctx.tx_unicast, "pubsub", "tx_unicast", PERF_COUNTER_TYPE_COUNT);
+  perfCounterRegister(&_ctx.tx_multicast, "pubsub", "tx_multicast", PERF_COUNTER_TYPE_COUNT);
+  bcmp_resource_discovery::bcmp_resource_discovery_set_table_cb(routes_table_cb);
+
+  pubsubFragRxInit(&_ctx.frag_rx, FRAG_RX_TIMEOUT_MS, frag_alloc_cb, frag_free_cb);
+  perfCounterRegister(&_ctx.frag_tx, "pubsub", "frag_tx", PERF_COUNTER_TYPE_COUNT);
+  perfCounterRegister(&_ctx.frag_rx_complete, "pubsub", "frag_rx", PERF_COUNTER_TYPE_COUNT);
+  perfCounterRegister(&_ctx.frag_rx_dropped, "pubsub", "frag_rx_dropped", PERF_COUNTER_TYPE_COUNT);
+  perfCounterRegister(&_ctx.frag_rx_timeouts, "pubsub", "frag_rx_timeouts", PERF_COUNTER_TYPE_COUNT);
+
+  _ctx.limits_lock = xSemaphoreCreateMutex();
+  configASSERT(_ctx.limits_lock);
+  pubsubLimitsInit(&_ctx.limits);
+  perfCounterRegister(&_ctx.tx_limited, "pubsub", "tx_limited", PERF_COUNTER_TYPE_COUNT);
+  perfCounterRegister(&_ctx.tx_shed, "pubsub", "tx_shed", PERF_COUNTER_TYPE_COUNT);
+  perfCounterRegister(&_ctx.rx_limited, "pubsub", "rx_limited", PERF_COUNTER_TYPE_COUNT);
+  perfCounterRegister(&_ctx.limits_busy, "pubsub", "limits_busy", PERF_COUNTER_TYPE_COUNT);
+}
+
+/*!
+  Update the subscriber routes from a node's resource table. Called from the
+  BCMP task.
+
+  \param[in] *repl - resource table
+  \param[in] len - length of the resource table message
+  \return None
+*/
+static void routes_table_cb(const bcmp_resource_table_reply_t *repl, uint16_t len) {
+  if(repl->node_id == getNodeId()) {
+    return;
+  }
+
+  // Ignore tables whose resources don't fit in the message
+  uint32_t num_resources = (uint32_t)repl->num_pubs + repl->num_subs;
+  size_t list_len = len - sizeof(bcmp_resource_table_reply_t);
+  size_t offset = 0;
+  uint32_t idx;
+  for(idx = 0; idx < num_resources; idx++) {
+    if((offset + sizeof(bcmp_resource_t)) > list_len) {
+      break;
+    }
+    const bcmp_resource_t *resource = reinterpret_cast<const bcmp_resource_t *>(&repl->resource_list[offset]);
+    if((offset + sizeof(bcmp_resource_t) + resource->resource_len) > list_len) {
+      break;
+    }
+    offset += sizeof(bcmp_resource_t) + resource->resource_len;
+  }
+  if(idx != num_resources) {
+    return;
+  }
+
+  uint32_t now_ms = pdTICKS_TO_MS(xTaskGetTickCount());
+  configASSERT(xSemaphoreTake(_ctx.routes_lock, portMAX_DELAY) == pdTRUE);
+
+  // The table is complete, so anything not in it was unsubscribed
+  pubsubRoutesClearNode(&_ctx.routes, repl->node_id);
+
+  offset = 0;
+  for(idx = 0; idx < num_resources; idx++) {
+    const bcmp_resource_t *resource = reinterpret_cast<const bcmp_resource_t *>(&repl->resource_list[offset]);
+    if(idx >= repl->num_pubs) {
+      pubsubRoutesAdd(&_ctx.routes, repl->node_id, pubsubRoutesHash(resource->resource, resource->resource_len), now_ms);
+    }
+    offset += sizeof(bcmp_resource_t) + resource->resource_len;
+  }
+
+  xSemaphoreGive(_ctx.routes_lock);
+}
+
+/*!
+  Enable/disable publishing directly to subscribers. With it disabled (the
+  default), every publication is multicast to the whole network. Only enable
+  it when every node runs firmware that announces its resource table, since
+  subscribers that don't announce would stop getting publications.
+
+  \param[in] enable - true to publish directly when possible
+  \return None
+*/
+void bm_pub_set_directed(bool enable) {
+  _ctx.directed = enable;
+}
+
+/*!
+  Check a publication against its topic's rate limit (and count it)
+
+  \param[in] *topic - message topic
+  \param[in] topic_len - topic length
+  \param[in] bytes - message size
+  \return true if it can be published, false if the topic is over its limit
+*/
+static bool limits_tx(const char *topic, uint16_t topic_len, uint32_t bytes) {
+  if(!_ctx.limits_lock) {
+    return true;
+  }
+
+  uint32_t topic_hash = pubsubRoutesHash(topic, topic_len);
+  configASSERT(xSemaphoreTake(_ctx.limits_lock, portMAX_DELAY) == pdTRUE);
+  bool rval = pubsubLimitsTx(&_ctx.limits, topic_hash, topic, topic_len, bytes, pdTICKS_TO_MS(xTaskGetTickCount()));
+  xSemaphoreGive(_ctx.limits_lock);
+
+  if(!rval) {
+    perfCounterInc(&_ctx.tx_limited);
+  }
+
+  return rval;
+}
+
+/*!
+  Get a topic's priority class
+
+  \param[in] *topic - topic
+  \param[in] topic_len - topic length
+  \param[in] wait - how long to wait for the limits lock
+  \return priority class (normal if the lock couldn't be taken in time)
+*/
+static bm_pubsub_priority_e topic_priority(const char *topic, uint16_t topic_len, TickType_t wait) {
+  if(!_ctx.limits_lock) {
+    return BM_PUBSUB_PRIO_NORMAL;
+  }
+
+  uint32_t topic_hash = pubsubRoutesHash(topic, topic_len);
+  if(xSemaphoreTake(_ctx.limits_lock, wait) != pdTRUE) {
+    perfCounterInc(&_ctx.limits_busy);
+    return BM_PUBSUB_PRIO_NORMAL;
+  }
+  pubsubPrio_e prio = pubsubLimitsPriority(&_ctx.limits, topic_hash);
+  xSemaphoreGive(_ctx.limits_lock);
+
+  return static_cast<bm_pubsub_priority_e>(prio);
+}
+
+/*!
+  Set a topic's priority class and rate limit. The limit applies to what we
+  publish on the topic and (separately) to what we receive on it.
+
+  \param[in] *topic - topic
+  \param[in] prio - priority class
+  \param[in] rate_bps - bytes per second (including headers), 0 for no limit
+  \param[in] burst_bytes - most bytes that can go at once, 0 for one second's worth
+  \return true if successful, false if the topic is invalid or too many topics
+          have limits
+*/
+bool bm_pubsub_set_topic_limit(const char *topic, bm_pubsub_priority_e prio, uint32_t rate_bps, uint32_t burst_bytes) {
+  configASSERT(_ctx.limits_lock);
+  configASSERT(topic);
+
+  uint16_t topic_len = strnlen(topic, BM_TOPIC_MAX_LEN);
+  if(!topic_len || (topic_len >= BM_TOPIC_MAX_LEN) || (prio > BM_PUBSUB_PRIO_HIGH)) {
+    return false;
+  }
+
+  uint32_t topic_hash = pubsubRoutesHash(topic, topic_len);
+  configASSERT(xSemaphoreTake(_ctx.limits_lock, portMAX_DELAY) == pdTRUE);
+  bool rval = pubsubLimitsSetTopic(&_ctx.limits, topic_hash, topic, topic_len, static_cast<pubsubPrio_e>(prio),
+                                   rate_bps, burst_bytes, pdTICKS_TO_MS(xTaskGetTickCount()));
+  xSemaphoreGive(_ctx.limits_lock);
+
+  if(!rval) {
+    printf("Too many topics with limits\n");
+  }
+
+  return rval;
+}
+
+/*!
+  Set a topic's priority class (keeping its rate limit, if it has one).
+  Topics are normal priority unless set.
+
+  \param[in] *topic - topic
+  \param[in] prio - priority class
+  \return true if successful, false if the topic is invalid or too many topics
+          have limits
+*/
+bool bm_pubsub_set_topic_priority(const char *topic, bm_pubsub_priority_e prio) {
+  configASSERT(_ctx.limits_lock);
+  configASSERT(topic);
+
+  uint16_t topic_len = strnlen(topic, BM_TOPIC_MAX_LEN);
+  if(!topic_len || (topic_len >= BM_TOPIC_MAX_LEN) || (prio > BM_PUBSUB_PRIO_HIGH)) {
+    return false;
+  }
+
+  uint32_t topic_hash = pubsubRoutesHash(topic, topic_len);
+  configASSERT(xSemaphoreTake(_ctx.limits_lock, portMAX_DELAY) == pdTRUE);
+  bool rval = pubsubLimitsSetPriority(&_ctx.limits, topic_hash, topic, topic_len, static_cast<pubsubPrio_e>(prio),
+                                      pdTICKS_TO_MS(xTaskGetTickCount()));
+  xSemaphoreGive(_ctx.limits_lock);
+
+  if(!rval) {
+    printf("Too many topics with limits\n");
+  }
+
+  return rval;
+}
+
+/*!
+  Limit how fast each node can send us publications (all topics together)
+
+  \param[in] rate_bps - bytes per second (including headers), 0 for no limit
+  \param[in] burst_bytes - most bytes that can go at once, 0 for one second's worth
+  \return None
+*/
+void bm_pubsub_set_publisher_limit(uint32_t rate_bps, uint32_t burst_bytes) {
+  configASSERT(_ctx.limits_lock);
+
+  configASSERT(xSemaphoreTake(_ctx.limits_lock, portMAX_DELAY) == pdTRUE);
+  pubsubLimitsSetPublisher(&_ctx.limits, rate_bps, burst_bytes, pdTICKS_TO_MS(xTaskGetTickCount()));
+  xSemaphoreGive(_ctx.limits_lock);
+}
+
+/*!
+  Get the priority class of a message, so the middleware can decide whether
+  it still has room for it. Acks are always high priority (they stop
+  retransmissions), fragments low (a partial message isn't useful yet).
+
+  \param[in] *pbuf - message
+  \return priority class
+*/
+bm_pubsub_priority_e bm_pubsub_msg_priority(struct pbuf *pbuf) {
+  configASSERT(pbuf);
+
+  if(pbuf->len < sizeof(bm_pubsub_header_t)) {
+    return BM_PUBSUB_PRIO_LOW;
+  }
+
+  const bm_pubsub_header_t *header = reinterpret_cast<const bm_pubsub_header_t *>(pbuf->payload);
+  if(header->type == BM_PUBSUB_TYPE_ACK) {
+    return BM_PUBSUB_PRIO_HIGH;
+  }
+
+  if((header->type == BM_PUBSUB_TYPE_FRAG) || (pbuf->len < sizeof(bm_pubsub_header_t) + header->topic_len)) {
+    return BM_PUBSUB_PRIO_LOW;
+  }
+
+  // Called from the lwip task, which mustn't wait on publishers
+  return topic_priority(header->topic, header->topic_len, 0);
+}
+
+/*!
+  Check a received message against its publisher's and topic's rate limits
+  (and count it). Malformed messages are rejected here too, so they never
+  take up room in the middleware queue. Called from the lwip task, so it
+  doesn't wait for the limits lock (the message is let through if it's busy).
+
+  \param[in] node_id - node id for sender
+  \param[in] *pbuf - message
+  \return true if the message can be handled, false if it should be dropped
+*/
+bool bm_pubsub_rx_allowed(uint64_t node_id, struct pbuf *pbuf) {
+  configASSERT(pbuf);
+
+  if(pbuf->len < sizeof(bm_pubsub_header_t)) {
+    return false;
+  }
+
+  const bm_pubsub_header_t *header = reinterpret_cast<const bm_pubsub_header_t *>(pbuf->payload);
+
+  // Acks are tiny and keep reliable publishers from retransmitting
+  if((header->type == BM_PUBSUB_TYPE_ACK) || !_ctx.limits_lock) {
+    return true;
+  }
+
+  // Fragments have no topic, only the publisher's limit applies to them
+  const char *topic = NULL;
+  uint16_t topic_len = 0;
+  uint32_t topic_hash = 0;
+  if(header->type != BM_PUBSUB_TYPE_FRAG) {
+    if(pbuf->len < sizeof(bm_pubsub_header_t) + header->topic_len) {
+      return false;
+    }
+    topic = header->topic;
+    topic_len = header->topic_len;
+    topic_hash = pubsubRoutesHash(topic, topic_len);
+  }
+
+  // A publisher (possibly preempted) holds the lock. Don't stall the lwip
+  // task on it, let this one through unlimited instead.
+  if(xSemaphoreTake(_ctx.limits_lock, 0) != pdTRUE) {
+    perfCounterInc(&_ctx.limits_busy);
+    return true;
+  }
+  bool rval = pubsubLimitsRx(&_ctx.limits, node_id, topic_hash, topic, topic_len, pbuf->tot_len, pdTICKS_TO_MS(xTaskGetTickCount()));
+  xSemaphoreGive(_ctx.limits_lock);
+
+  if(!rval) {
+    perfCounterInc(&_ctx.rx_limited);
+  }
+
+  return rval;
+}
+
+/*!
+  Print per-topic message counters, priorities and rate limits
+
+  \return None
+*/
+void bm_pubsub_print_limits(void) {
+  static const char *prio_names[PUBSUB_PRIO_COUNT] = {"low", "normal", "high"};
+
+  if(!_ctx.limits_lock) {
+    return;
+  }
+
+  printf("topic prio rate_bps tx_msgs tx_bytes tx_dropped rx_msgs rx_bytes rx_dropped\n");
+  for(uint32_t idx = 0; idx < PUBSUB_LIMITS_MAX_TOPICS; idx++) {
+    // Copy it so we don't hold the lock while printing
+    configASSERT(xSemaphoreTake(_ctx.limits_lock, portMAX_DELAY) == pdTRUE);
+    pubsubLimitsTopic_t topic = _ctx.limits.topics[idx];
+    xSemaphoreGive(_ctx.limits_lock);
+
+    if(!topic.valid) {
+      continue;
+    }
+
+    printf("%s %s %" PRIu32 " %" PRIu32 " %" PRIu32 " %" PRIu32 " %" PRIu32 " %" PRIu32 " %" PRIu32 "\n",
+           topic.name, prio_names[topic.prio], topic.tx.rateBps,
+           topic.counters.txMsgs, topic.counters.txBytes, topic.counters.txDropped,
+           topic.counters.rxMsgs, topic.counters.rxBytes, topic.counters.rxDropped);
+  }
+
+  configASSERT(xSemaphoreTake(_ctx.limits_lock, portMAX_DELAY) == pdTRUE);
+  pubsubLimitsCounters_t other = _ctx.limits.other;
+  uint32_t publisher_rate_bps = _ctx.limits.publisherRateBps;
+  uint32_t publisher_dropped = 0;
+  for(uint32_t idx = 0; idx < PUBSUB_LIMITS_MAX_PUBLISHERS; idx++) {
+    if(_ctx.limits.publishers[idx].valid) {
+      publisher_dropped += _ctx.limits.publishers[idx].dropped;
+    }
+  }
+  xSemaphoreGive(_ctx.limits_lock);
+
+  printf("(other) - - %" PRIu32 " %" PRIu32 " %" PRIu32 " %" PRIu32 " %" PRIu32 " %" PRIu32 "\n",
+         other.txMsgs, other.txBytes, other.txDropped, other.rxMsgs, other.rxBytes, other.rxDropped);
+  printf("publisher rate_bps: %" PRIu32 " dropped: %" PRIu32 "\n", publisher_rate_bps, publisher_dropped);
+  printf("tx_limited: %" PRIu32 " tx_shed: %" PRIu32 " rx_limited: %" PRIu32 " limits_busy: %" PRIu32 "\n",
+         _ctx.tx_limited.value, _ctx.tx_shed.value, _ctx.rx_limited.value, _ctx.limits_busy.value);
+}
+
+/*!
+  Send a publication to the network. Goes directly to the subscribers when we
+  know them all and they're all online neighbors, multicast otherwise.
+
+  \param[in] *pbuf - message to send
+  \param[in] *topic - message topic
+  \param[in] topic_len - topic length
+  \param[in] prio - topic priority class
+  \return 0 if OK nonzero otherwise (see udp_send for error codes)
+*/
+static int32_t pubsub_net_tx(struct pbuf *pbuf, const char *topic, uint16_t topic_len, bm_pubsub_priority_e prio) {
+  ip_addr_t dsts[BM_PUB_MAX_UNICAST_DESTS];
+  int32_t num_dsts = -1;
+
+  // Lower priorities leave room in the L2 queue for higher ones (and for
+  // whatever we receive)
+  uint32_t queue_len;
+  uint32_t queue_space = bm_l2_get_queue_space(&queue_len);
+  if(!pubsubLimitsAdmit(static_cast<pubsubPrio_e>(prio), queue_space, queue_len)) {
+    perfCounterInc(&_ctx.tx_shed);
+    return -1;
+  }
+
+  if(_ctx.routes_lock && _ctx.directed) {
+    uint64_t node_ids[BM_PUB_MAX_UNICAST_DESTS];
+    uint32_t topic_hash = pubsubRoutesHash(topic, topic_len);
+    configASSERT(xSemaphoreTake(_ctx.routes_lock, portMAX_DELAY) == pdTRUE);
+    num_dsts = pubsubRoutesLookup(&_ctx.routes, topic_hash, pdTICKS_TO_MS(xTaskGetTickCount()), node_ids, BM_PUB_MAX_UNICAST_DESTS);
+    xSemaphoreGive(_ctx.routes_lock);
+
+    for(int32_t idx = 0; idx < num_dsts; idx++) {
+      const bm_neighbor_t *neighbor = bcmp_find_neighbor(node_ids[idx]);
+      if(!neighbor || !neighbor->online) {
+        num_dsts = -1;
+        break;
+      }
+      dsts[idx] = neighbor->addr;
+    }
+  }
+
+  // Nobody we know of subscribes, but someone who doesn't announce might
+  if(num_dsts <= 0) {
+    perfCounterInc(&_ctx.tx_multicast);
+    return middleware_net_tx(pbuf);
+  }
+
+  int32_t rval = 0;
+
+  // Every destination but the last one gets a copy
+  for(int32_t idx = 0; idx < num_dsts - 1; idx++) {
+    struct pbuf *copy = pbuf_alloc(PBUF_TRANSPORT, pbuf->tot_len, PBUF_RAM);
+    if(!copy) {
+      rval = -1;
+      continue;
+    }
+    pbuf_copy(copy, pbuf);
+    if(middleware_net_tx_to(copy, &dsts[idx])) {
+      rval = -1;
+    }
+    pbuf_free(copy);
+  }
+
+  if(middleware_net_tx_to(pbuf, &dsts[num_dsts - 1])) {
+    rval = -1;
+  }
+  perfCounterAdd(&_ctx.tx_unicast, (uint32_t)num_dsts);
+
+  return rval;
+}
+
+/*!
+  Send a message to the network, split into fragments if it doesn't fit in
+  one frame
+
+  \param[in] *pbuf - message to send (header, topic and data)
+  \param[in] *topic - message topic
+  \param[in] topic_len - topic length
+  \return 0 if OK nonzero otherwise
+*/
+static int32_t pubsub_send(struct pbuf *pbuf, const char *topic, uint16_t topic_len) {
+  bm_pubsub_priority_e prio = topic_priority(topic, topic_len, portMAX_DELAY);
+  if(pbuf->tot_len <= MIDDLEWARE_MAX_PAYLOAD_LEN) {
+    return pubsub_net_tx(pbuf, topic, topic_len, prio);
+  }
+
+  pubsubFragHeader_t frag_header;
+  taskENTER_CRITICAL();
+  frag_header.msgId = _ctx.frag_msg_id++;
+  taskEXIT_CRITICAL();
+  frag_header.count = pubsubFragCount(pbuf->tot_len);
+  frag_header.totalLen = pbuf->tot_len;
+  frag_header.topicHash = pubsubRoutesHash(topic, topic_len);
+
+  int32_t rval = 0;
+  for(uint8_t idx = 0; idx < frag_header.count; idx++) {
+    uint16_t frag_len = pubsubFragLen(pbuf->tot_len, idx);
+    struct pbuf *frag = pbuf_alloc(PBUF_TRANSPORT, BM_PUBSUB_FRAG_HDR_LEN + frag_len, PBUF_RAM);
+    if(!frag) {
+      rval = -1;
+      break;
+    }
+
+    bm_pubsub_header_t *header = reinterpret_cast<bm_pubsub_header_t *>(frag->payload);
+    header->type = BM_PUBSUB_TYPE_FRAG;
+    header->flags = 0;
+    header->topic_len = 0;
+    frag_header.index = idx;
+    memcpy((void *)header->topic, &frag_header, sizeof(frag_header));
+    pbuf_copy_partial(pbuf, static_cast<uint8_t *>(frag->payload) + BM_PUBSUB_FRAG_HDR_LEN, frag_len, (uint32_t)idx * PUBSUB_FRAG_DATA_LEN);
+
+    // Losing one fragment loses the whole message, no point in sending the rest
+    rval = pubsub_net_tx(frag, topic, topic_len, prio);
+    pbuf_free(frag);
+    if(rval) {
+      break;
+    }
+
+    // The middleware task can't sleep (retransmissions, or publishing from
+    // a subscription callback), so its fragments go out back to back
+    if((((idx + 1) % FRAG_TX_BURST) == 0) && ((idx + 1) < frag_header.count) &&
+       !bm_middleware_in_task()) {
+      vTaskDelay(pdMS_TO_TICKS(FRAG_TX_BURST_DELAY_MS));
+    }
+  }
+
+  if(rval == 0) {
+    perfCounterInc(&_ctx.frag_tx);
+  }
+
+  return rval;
+}
+
+/*!
+  Allocate a buffer for a message being reassembled
+
+  \param[in] len - message length
+  \param[out] **data - where the message goes
+  \return buffer, NULL if they're all in use
+*/
+static void *frag_alloc_cb(uint16_t len, uint8_t **data) {
+  // pubsubFragRxAdd doesn't take messages bigger than a buffer
+  configASSERT(len <= PUBSUB_FRAG_RX_MAX_LEN);
+  uint8_t *buf = static_cast<uint8_t *>(memPoolAlloc(&pubsub_frag_bufs));
+  if(buf) {
+    *data = buf;
+  }
+  return buf;
+}
+
+static void frag_free_cb(void *msg) {
+  memPoolFree(&pubsub_frag_bufs, msg);
+}
+
+/*!
+  Drop messages that haven't been completely received in time. Called by the
+  middleware task.
+
+  \return ms until this needs to be called again, UINT32_MAX if nothing is
+          being reassembled
+*/
+uint32_t bm_pubsub_frag_poll(void) {
+  if(!_ctx.qos_lock) {
+    return UINT32_MAX;
+  }
+
+  uint32_t expired;
+  uint32_t next_ms = pubsubFragRxPoll(&_ctx.frag_rx, pdTICKS_TO_MS(xTaskGetTickCount()), &expired);
+  perfCounterAdd(&_ctx.frag_rx_timeouts, expired);
+
+  return next_ms;
+}
+
+/*!
+  Publish data to specific string topic and have subscribers acknowledge it
+
+  \param[in] *topic topic string to publish to
+  \param[in] *data pointer to data to publish
+  \param[in] length of data to publish
+  \return True if data has been queued to be published. It will be retransmitted
+          until a subscriber acks it (or we give up, see bm_pub_get_qos_stats).
+          False if too many reliable publications are already waiting for acks.
+*/
+bool bm_pub_reliable(const char *topic, const void *data, uint16_t len) {
+  bool retv = false;
+
+  uint16_t topic_len = strnlen(topic, BM_TOPIC_MAX_LEN);
+
+  if(topic_len && (topic_len < BM_TOPIC_MAX_LEN)) {
+    retv = bm_pub_reliable_wl(topic, topic_len, data, len);
+  }
+
+  return retv;
+}
+
+/*!
+  Publish data to specific string topic and have subscribers acknowledge it
+  (while providing topic len). Subscribers need to handle reliable messages
+  (older firmware would see the sequence number as part of the data).
+
+  Reliable publications are never stored for later: the stored data would be
+  forwarded without a sequence number or acks. If store and forward is enabled
+  for the topic and there is no route, this fails instead (bm_pub_wl stores it).
+
+  \param[in] *topic topic string to publish to
+  \param[in] topic_len length of topic string
+  \param[in] *data pointer to data to publish
+  \param[in] length of data to publish
+  \return True if data has been queued to be published, false otherwise
+*/
+bool bm_pub_reliable_wl(const char *topic, uint16_t topic_len, const void *data, uint16_t len) {
+  configASSERT(_ctx.qos_lock);
+
+  bool retv = true;
+
+  // Over the topic's rate limit (retransmissions don't count)
+  if(!limits_tx(topic, topic_len, sizeof(bm_pubsub_header_t) + topic_len + sizeof(uint16_t) + len)) {
+    return false;
+  }
+
+  do {
+
+    // No route right now. Unlike bm_pub_wl, don't store it for later.
+    if(bm_store_forward_no_route(topic, topic_len)) {
+      retv = false;
+      break;
+    }
+
+    if(len > BM_PUB_MAX_DATA_LEN(topic_len)) {
+      retv = false;
+      break;
+    }
+
+    // Kept (unsent) until it's acked. Every transmission is a copy, since
+    // lwip owns a pbuf's headers once it's been sent.
+    uint16_t message_size = sizeof(bm_pubsub_header_t) + topic_len + sizeof(uint16_t) + len;
+    struct pbuf *msg = pbuf_alloc(PBUF_TRANSPORT, message_size, PBUF_RAM);
+    if(!msg) {
+      retv = false;
+      break;
+    }
+
+    bm_pubsub_header_t *header = reinterpret_cast<bm_pubsub_header_t *>(msg->payload);
+    header->type = BM_PUBSUB_TYPE_PUB;
+    header->flags = BM_PUBSUB_FLAG_RELIABLE;
+    header->topic_len = topic_len;
+    memcpy((void *)header->topic, topic, topic_len);
+    uint8_t *seq_ptr = (uint8_t *)&header->topic[topic_len];
+    memcpy(seq_ptr + sizeof(uint16_t), data, len);
+
+    configASSERT(xSemaphoreTake(_ctx.qos_lock, portMAX_DELAY) == pdTRUE);
+    uint16_t seq;
+    if(pubsubQosTxAdd(&_ctx.qos_tx, msg, pdTICKS_TO_MS(xTaskGetTickCount()), &seq)) {
+      memcpy(seq_ptr, &seq, sizeof(seq));
+      perfCounterInc(&_ctx.qos_counters.sent);
+    } else {
+      perfCounterInc(&_ctx.qos_counters.window_full);
+      retv = false;
+    }
+    xSemaphoreGive(_ctx.qos_lock);
+
+    if(!retv) {
+      pbuf_free(msg);
+      break;
+    }
+
+    if (get_sub(topic, topic_len)) {
+      bm_middleware_local_pub(msg);
+    }
+
+    // If this one doesn't make it out, the retransmission will
+    qos_send_copy(msg);
+
+    // Let the middleware task know there's a new retransmission deadline
+    bm_middleware_wake();
+  } while (0);
+
+  if (!retv) {
+    printf("Unable to publish to topic\n");
+  } else {
+    if(bcmp_resource_discovery::bcmp_resource_discovery_add_resource(topic, topic_len, bcmp_resource_discovery::PUB)){
+      printf("Added topic %.*s to BCMP resource table.\n",topic_len,topic);
+    }
+  }
+
+  return retv;
+}
+
+/*!
+  Send a copy of a reliable message
+
+  \param[in] *msg - message to send
+  \return true if it was handed to the network, false otherwise
+*/
+static bool qos_send_copy(struct pbuf *msg) {
+  bool rval = false;
+  struct pbuf *pbuf = pbuf_alloc(PBUF_TRANSPORT, msg->tot_len, PBUF_RAM);
+  if(pbuf) {
+    pbuf_copy(pbuf, msg);
+    const bm_pubsub_header_t *header = reinterpret_cast<const bm_pubsub_header_t *>(msg->payload);
+    rval = (pubsub_send(pbuf, header->topic, header->topic_len) == 0);
+    pbuf_free(pbuf);
+  }
+  return rval;
+}
+
+// Messages due for retransmission, collected under qos_lock and sent after
+// it's released
+typedef struct {
+  struct pbuf *msgs[PUBSUB_QOS_TX_WINDOW];
+  uint32_t count;
+} qos_resend_t;
+
+static void qos_retransmit_cb(void *msg, uint16_t seq, void *arg) {
+  (void)seq;
+  qos_resend_t *resend = static_cast<qos_resend_t *>(arg);
+  configASSERT(resend->count < PUBSUB_QOS_TX_WINDOW);
+
+  // Keep it around in case it's acked (and freed) before we send it
+  struct pbuf *pbuf = static_cast<struct pbuf *>(msg);
+  pbuf_ref(pbuf);
+  resend->msgs[resend->count++] = pbuf;
+  perfCounterInc(&_ctx.qos_counters.retries);
+}
+
+static void qos_give_up_cb(void *msg, uint16_t seq, void *arg) {
+  (void)arg;
+  struct pbuf *pbuf = static_cast<struct pbuf *>(msg);
+  const bm_pubsub_header_t *header = reinterpret_cast<const bm_pubsub_header_t *>(pbuf->payload);
+  printf("No ack for %.*s seq %u, giving up\n", header->topic_len, header->topic, seq);
+  perfCounterInc(&_ctx.qos_counters.give_ups);
+  pbuf_free(pbuf);
+}
+
+/*!
+  Retransmit (or give up on) reliable publications that haven't been acked in
+  time. Called by the middleware task.
+
+  \return ms until this needs to be called again, UINT32_MAX if nothing is
+          waiting for an ack
+*/
+uint32_t bm_pub_qos_poll(void) {
+  if(!_ctx.qos_lock) {
+    return UINT32_MAX;
+  }
+
+  qos_resend_t resend = {};
+  configASSERT(xSemaphoreTake(_ctx.qos_lock, portMAX_DELAY) == pdTRUE);
+  uint32_t next_ms = pubsubQosTxPoll(&_ctx.qos_tx, pdTICKS_TO_MS(xTaskGetTickCount()), qos_retransmit_cb, qos_give_up_cb, &resend);
+  xSemaphoreGive(_ctx.qos_lock);
+
+  // Sending can take a while, don't hold up publishers and acks
+  for(uint32_t idx = 0; idx < resend.count; idx++) {
+    qos_send_copy(resend.msgs[idx]);
+    pbuf_free(resend.msgs[idx]);
+  }
+
+  return next_ms;
+}
+
+/*!
+  Get reliable publishing counters
+
+  \param[out] *stats - counters
+  \return true if reliable publishing is initialized, false otherwise
+*/
+bool bm_pub_get_qos_stats(bm_pub_qos_stats_t *stats) {
+  configASSERT(stats);
+
+  if(!_ctx.qos_lock) {
+    return false;
+  }
+
+  stats->sent = _ctx.qos_counters.sent.value;
+  stats->acked = _ctx.qos_counters.acked.value;
+  stats->retries = _ctx.qos_counters.retries.value;
+  stats->give_ups = _ctx.qos_counters.give_ups.value;
+  stats->window_full = _ctx.qos_counters.window_full.value;
+  stats->acks_sent = _ctx.qos_counters.acks_sent.value;
+  stats->rx_duplicates = _ctx.qos_counters.rx_duplicates.value;
+
+  configASSERT(xSemaphoreTake(_ctx.qos_lock, portMAX_DELAY) == pdTRUE);
+  stats->in_flight = pubsubQosTxInFlight(&_ctx.qos_tx);
+  xSemaphoreGive(_ctx.qos_lock);
+
+  return true;
+}
+
+void bm_pub_print_qos_stats(void) {
+  bm_pub_qos_stats_t stats;
+  if(bm_pub_get_qos_stats(&stats)) {
+    printf("sent: %" PRIu32 " acked: %" PRIu32 " retries: %" PRIu32 " give_ups: %" PRIu32 " window_full: %" PRIu32 " in_flight: %" PRIu32 "\n",
+           stats.sent, stats.acked, stats.retries, stats.give_ups, stats.window_full, stats.in_flight);
+    printf("acks_sent: %" PRIu32 " rx_duplicates: %" PRIu32 "\n", stats.acks_sent, stats.rx_duplicates);
+  }
+}
+
+/*!
+  Ack a reliable publication
+
+  \param[in] publisher_node_id - node that published it
+  \param[in] seq - its sequence number
+  \return None
+*/
+static void qos_send_ack(uint64_t publisher_node_id, uint16_t seq) {
+  struct pbuf *pbuf = pbuf_alloc(PBUF_TRANSPORT, sizeof(bm_pubsub_header_t) + sizeof(bm_pubsub_ack_t), PBUF_RAM);
+  if(pbuf) {
+    bm_pubsub_header_t *header = reinterpret_cast<bm_pubsub_header_t *>(pbuf->payload);
+    header->type = BM_PUBSUB_TYPE_ACK;
+    header->flags = 0;
+    header->topic_len = 0;
+    bm_pubsub_ack_t ack = {publisher_node_id, seq};
+    memcpy((void *)header->topic, &ack, sizeof(ack));
+
+    // Straight back to the publisher if it's a neighbor
+    int32_t rval;
+    const bm_neighbor_t *neighbor = _ctx.directed ? bcmp_find_neighbor(publisher_node_id) : NULL;
+    if(neighbor && neighbor->online) {
+      ip_addr_t dst = neighbor->addr;
+      rval = middleware_net_tx_to(pbuf, &dst);
+    } else {
+      rval = middleware_net_tx(pbuf);
+    }
+    if(rval == 0) {
+      perfCounterInc(&_ctx.qos_counters.acks_sent);
+    }
+    pbuf_free(pbuf);
+  }
+}
+
+/*!
+  Handle an ack for one of our reliable publications
+
+  \param[in] *pbuf - pbuf with ack message
+  \return None
+*/
+static void qos_handle_ack(struct pbuf *pbuf) {
+  bm_pubsub_ack_t ack;
+  if(_ctx.qos_lock && (pbuf->len >= sizeof(bm_pubsub_header_t) + sizeof(ack))) {
+    memcpy(&ack, static_cast<uint8_t *>(pbuf->payload) + sizeof(bm_pubsub_header_t), sizeof(ack));
+    if(ack.publisher_node_id == getNodeId()) {
+      configASSERT(xSemaphoreTake(_ctx.qos_lock, portMAX_DELAY) == pdTRUE);
+      struct pbuf *msg = static_cast<struct pbuf *>(pubsubQosTxAck(&_ctx.qos_tx, ack.seq));
+      xSemaphoreGive(_ctx.qos_lock);
+
+      // Other subscribers may ack too, only the first one counts
+      if(msg) {
+        perfCounterInc(&_ctx.qos_counters.acked);
+        pbuf_free(msg);
+      }
+    }
+  }
+}
+
+/*!
+  Handle a message fragment, and the whole message once it's complete. The
+  message is reassembled in one contiguous buffer, so subscribers get it the
+  same way as unfragmented ones. Fragments of topics we aren't subscribed to
+  are dropped right away.
+
+  \param[in] node_id - node id for sender
+  \param[in] *pbuf - pbuf with fragment
+  \return None
+*/
+static void frag_handle(uint64_t node_id, struct pbuf *pbuf) {
+  if(pbuf->len < BM_PUBSUB_FRAG_HDR_LEN) {
+    return;
+  }
+
+  pubsubFragHeader_t frag_header;
+  memcpy(&frag_header, static_cast<uint8_t *>(pbuf->payload) + sizeof(bm_pubsub_header_t), sizeof(frag_header));
+
+  // A hash collision only costs a reassembly, handle_pub still checks the topic
+  if(!has_sub_hash(frag_header.topicHash)) {
+    return;
+  }
+
+  void *msg = NULL;
+  pubsubFragRxResult_e result = pubsubFragRxAdd(&_ctx.frag_rx, node_id, &frag_header,
+                                                static_cast<uint8_t *>(pbuf->payload) + BM_PUBSUB_FRAG_HDR_LEN,
+                                                pbuf->len - BM_PUBSUB_FRAG_HDR_LEN,
+                                                pdTICKS_TO_MS(xTaskGetTickCount()), &msg);
+  switch(result) {
+    case PUBSUB_FRAG_RX_COMPLETE: {
+      const bm_pubsub_header_t *header = static_cast<const bm_pubsub_header_t *>(msg);
+
+      // Only publications are fragmented (not acks or fragments)
+      if((frag_header.totalLen >= sizeof(bm_pubsub_header_t) + header->topic_len) && (header->type == BM_PUBSUB_TYPE_PUB)) {
+        perfCounterInc(&_ctx.frag_rx_complete);
+        handle_pub(node_id, header, frag_header.totalLen, pbuf);
+      } else {
+        perfCounterInc(&_ctx.frag_rx_dropped);
+      }
+      frag_free_cb(msg);
+      break;
+    }
+    case PUBSUB_FRAG_RX_INVALID:
+    case PUBSUB_FRAG_RX_NO_ROOM: {
+      perfCounterInc(&_ctx.frag_rx_dropped);
+      break;
+    }
+    default: {
+      break;
+    }
+  }
+}
+
 /*!
   Handle incoming data that we are subscribed to.
   \param[in] node_id - node id for sender
@@ -329,21 +1378,67 @@ bool bm_pub_wl(const char *topic, uint16_t topic_len, const void *data, uint16_t
 */
 void bm_handle_msg(uint64_t node_id, struct pbuf *pbuf) {
   bm_pubsub_header_t *header = reinterpret_cast<bm_pubsub_header_t *>(pbuf->payload);
-  uint16_t data_len = pbuf->len - sizeof(bm_pubsub_header_t) - header->topic_len;
 
-  // TODO check header type and flags and do something about it
+  if(header->type == BM_PUBSUB_TYPE_ACK) {
+    qos_handle_ack(pbuf);
+    return;
+  }
+
+  if(header->type == BM_PUBSUB_TYPE_FRAG) {
+    frag_handle(node_id, pbuf);
+    return;
+  }
+
+  handle_pub(node_id, header, pbuf->len, pbuf);
+}
+
+/*!
+  Hand a publication to the topic's subscribers (and ack it if reliable)
+
+  \param[in] node_id - node id for sender
+  \param[in] *header - message (header, topic and data)
+  \param[in] len - message length
+  \param[in] *pbuf - pbuf the message (or its last fragment) came in, for tracing
+  \return None
+*/
+static void handle_pub(uint64_t node_id, const bm_pubsub_header_t *header, uint16_t len, struct pbuf *pbuf) {
+  uint16_t data_len = len - sizeof(bm_pubsub_header_t) - header->topic_len;
+  const uint8_t *data = (const uint8_t *)&header->topic[header->topic_len];
 
   bm_sub_node_t* ptr = get_sub(header->topic, header->topic_len);
 
+  if(header->flags & BM_PUBSUB_FLAG_RELIABLE) {
+    if((len < sizeof(bm_pubsub_header_t) + header->topic_len + sizeof(uint16_t)) || !_ctx.qos_lock) {
+      return;
+    }
+
+    uint16_t seq;
+    memcpy(&seq, data, sizeof(seq));
+    data += sizeof(seq);
+    data_len -= sizeof(seq);
+
+    // Our own publication looped back to a local subscriber, nothing to ack
+    if(ptr && (node_id != getNodeId())) {
+      // Ack retransmissions too, our first ack might be the one that got lost
+      qos_send_ack(node_id, seq);
+      if(!pubsubQosRxAccept(&_ctx.qos_rx, node_id, seq, pdTICKS_TO_MS(xTaskGetTickCount()))) {
+        perfCounterInc(&_ctx.qos_counters.rx_duplicates);
+        return;
+      }
+    }
+  }
+
   if (ptr && ptr->sub.callbacks) {
     bm_cb_node_t *cb_node = ptr->sub.callbacks;
 
     while(cb_node) {
+      tracePacket(kTraceEventPktSubCbStart, pbuf);
       cb_node->callback_fn( node_id,
                             header->topic,
                             header->topic_len,
-                            (const uint8_t *)&header->topic[header->topic_len],
+                            data,
                             data_len);
+      tracePacket(kTraceEventPktSubCbEnd, pbuf);
       cb_node = cb_node->next;
     }
   }
@@ -420,11 +1515,11 @@ static bm_sub_node_t* delete_sub(const char* topic, uint16_t topic_len) {
         cb_node = cb_node->next;
 
         // Free callback node
-        vPortFree(to_del);
+        memPoolFree(&pubsub_cb_nodes, to_del);
       }
 
       vPortFree(node->sub.topic);
-      vPortFree(node);
+      memPoolFree(&pubsub_sub_nodes, node);
       break;
     }
     prev = node;
@@ -452,6 +1547,23 @@ static bm_sub_node_t* get_sub(const char* topic, uint16_t topic_len) {
   return node;
 }
 
+/*!
+  Check whether we're subscribed to a topic, by hash
+  \param[in] topic_hash - pubsubRoutesHash of the topic
+  \return true if a subscription's topic has that hash
+*/
+static bool has_sub_hash(uint32_t topic_hash) {
+  bm_sub_node_t* node = _ctx.subscription_list.next;
+
+  while(node != NULL) {
+    if(node->sub.topic_hash == topic_hash) {
+      return true;
+    }
+    node = node->next;
+  }
+  return false;
+}
+
 /*!
   Get the last subscription in the linked list of subscription topics
   \param[in] *parameters - unused
@@ -5,6 +5,7 @@
 #include "lwip/netif.h"
 #include "lwip/pbuf.h"
 #include "lwip/udp.h"
+#include "pubsub_frag.h"
 
 #ifdef __cplusplus
 extern "C" {
@@ -12,12 +13,57 @@ extern "C" {
 
 #define BM_TOPIC_MAX_LEN (255)
 
+// Largest payload that can be published on a topic. Anything that doesn't fit
+// in one frame is fragmented, and the whole message has to fit in a
+// subscriber's reassembly buffer (PUBSUB_FRAG_RX_MAX_LEN, see pubsub_frag.h).
+// (Room is left for the 3 byte pub/sub header and the sequence number of a
+// reliable publication.)
+#define BM_PUB_MAX_DATA_LEN(topic_len) (PUBSUB_FRAG_RX_MAX_LEN - 5 - (topic_len))
+
+typedef struct {
+  uint32_t sent;
+  uint32_t acked;
+  uint32_t retries;
+  uint32_t give_ups;
+  uint32_t window_full;
+  uint32_t in_flight;
+  uint32_t acks_sent;
+  uint32_t rx_duplicates;
+} bm_pub_qos_stats_t;
+
+// Topic priority classes. When the middleware queues start filling up, low
+// priority messages are dropped first so high priority ones still get through.
+typedef enum {
+  // Bulk data (streams)
+  BM_PUBSUB_PRIO_LOW = 0,
+  // Default for every topic
+  BM_PUBSUB_PRIO_NORMAL,
+  // Control and alarm messages
+  BM_PUBSUB_PRIO_HIGH,
+} bm_pubsub_priority_e;
+
 typedef void (*bm_cb_t)(uint64_t node_id, const char* topic, uint16_t topic_len, const uint8_t* data, uint16_t data_len);
 
 void bm_init(struct netif* netif, struct udp_pcb* pcb, uint16_t port);
+void bm_pubsub_init(void);
 bool bm_pub(const char *topic, const void *data, uint16_t len);
 bool bm_pub_wl(const char *topic, uint16_t topic_len, const void *data, uint16_t len);
+bool bm_pub_reliable(const char *topic, const void *data, uint16_t len);
+bool bm_pub_reliable_wl(const char *topic, uint16_t topic_len, const void *data, uint16_t len);
+uint32_t bm_pub_qos_poll(void);
+bool bm_pub_get_qos_stats(bm_pub_qos_stats_t *stats);
+void bm_pub_print_qos_stats(void);
+void bm_pub_set_directed(bool enable);
+uint32_t bm_pubsub_frag_poll(void);
+bool bm_pubsub_set_topic_limit(const char *topic, bm_pubsub_priority_e prio, uint32_t rate_bps, uint32_t burst_bytes);
+bool bm_pubsub_set_topic_priority(const char *topic, bm_pubsub_priority_e prio);
+void bm_pubsub_set_publisher_limit(uint32_t rate_bps, uint32_t burst_bytes);
+bm_pubsub_priority_e bm_pubsub_msg_priority(struct pbuf *pbuf);
+bool bm_pubsub_rx_allowed(uint64_t node_id, struct pbuf *pbuf);
+void bm_pubsub_print_limits(void);
+bool bm_pub_prio(const char *topic, const void *data, uint16_t len, bm_pubsub_priority_e prio);
 bool bm_sub(const char *topic, const bm_cb_t callback);
+bool bm_sub_prio(const char *topic, const bm_cb_t callback, bm_pubsub_priority_e prio);
 bool bm_sub_wl(const char *topic, uint16_t topic_len, const bm_cb_t callback);
 bool bm_unsub(const char *topic, const bm_cb_t callback);
 bool bm_unsub_wl(const char *topic, uint16_t topic_len, const bm_cb_t callback);
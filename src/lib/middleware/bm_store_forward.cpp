@@ -0,0 +1,445 @@
+#include <string.h>
+#include <stdio.h>
+#include "FreeRTOS.h"
+#include "queue.h"
+#include "semphr.h"
+#include "task.h"
+#include "task_priorities.h"
+#include "bm_pubsub.h"
+#include "bm_store_forward.h"
+#include "bcmp_neighbors.h"
+#include "nvmRingLog.h"
+
+#define SF_DRAIN_PERIOD_MS (1000)
+#define SF_LOCK_TIMEOUT_MS (100)
+// Records waiting to be appended by the store and forward task
+#define SF_STORE_QUEUE_LEN (16)
+
+typedef struct {
+  char *topic;
+  uint16_t topic_len;
+} bm_sf_topic_t;
+
+// Record is topic_len + topic + data
+typedef struct {
+  uint8_t *record;
+  uint16_t len;
+} bm_sf_record_t;
+
+// Only the store and forward task touches the log (flash writes and erases
+// are slow), so the lock is never held across a flash operation. The lock
+// protects the topics and stats.
+typedef struct {
+  NvmRingLog *log;
+  SemaphoreHandle_t lock;
+  TaskHandle_t task;
+  QueueHandle_t store_queue;
+  NvmRingLogStats_t log_stats;
+  bm_sf_route_check_t route_check;
+  uint32_t drain_records_per_s;
+  uint32_t flush_period_ms;
+  bm_sf_topic_t topics[BM_SF_MAX_TOPICS];
+  bm_sf_stats_t stats;
+} bm_sf_context_t;
+
+static bm_sf_context_t _ctx;
+
+static void bm_store_forward_task(void *parameters);
+
+/*!
+  Default route check. Published data can go somewhere as long as we have at
+  least one neighbor that is still sending heartbeats.
+
+  \return true if there is an online neighbor, false otherwise
+*/
+static bool default_route_check(void) {
+  bool rval = false;
+  uint8_t num_neighbors = 0;
+  bm_neighbor_t *neighbor = bcmp_get_neighbors(num_neighbors);
+  while(neighbor) {
+    if(neighbor->online) {
+      rval = true;
+      break;
+    }
+    neighbor = neighbor->next;
+  }
+  return rval;
+}
+
+static bm_sf_topic_t *find_topic(const char *topic, uint16_t topic_len) {
+  bm_sf_topic_t *rval = NULL;
+  for(uint8_t idx = 0; idx < BM_SF_MAX_TOPICS; idx++) {
+    if(_ctx.topics[idx].topic && (_ctx.topics[idx].topic_len == topic_len) &&
+       (memcmp(_ctx.topics[idx].topic, topic, topic_len) == 0)) {
+      rval = &_ctx.topics[idx];
+      break;
+    }
+  }
+  return rval;
+}
+
+static bm_sf_topic_t *find_free_topic(void) {
+  bm_sf_topic_t *rval = NULL;
+  for(uint8_t idx = 0; idx < BM_SF_MAX_TOPICS; idx++) {
+    if(!_ctx.topics[idx].topic) {
+      rval = &_ctx.topics[idx];
+      break;
+    }
+  }
+  return rval;
+}
+
+/*!
+  Initialize store and forward. Published data on enabled topics will be stored
+  in the partition whenever there is no route and forwarded once there is.
+
+  \param[in] &partition - flash partition to use for the ring log
+  \param[in] drain_records_per_s - max number of stored records to re-publish per second
+  \param[in] flush_period_ms - how often staged records are written to flash. Lower
+                               values lose less data on reset, but cost more flash wear
+  \return None
+*/
+void bm_store_forward_init(NvmPartition &partition, uint32_t drain_records_per_s, uint32_t flush_period_ms) {
+  configASSERT(_ctx.log == NULL);
+  configASSERT(drain_records_per_s);
+
+  _ctx.lock = xSemaphoreCreateMutex();
+  configASSERT(_ctx.lock);
+
+  _ctx.store_queue = xQueueCreate(SF_STORE_QUEUE_LEN, sizeof(bm_sf_record_t));
+  configASSERT(_ctx.store_queue);
+
+  _ctx.log = new NvmRingLog(partition);
+  configASSERT(_ctx.log);
+  if(!_ctx.log->init()) {
+    printf("Unable to initialize store and forward log\n");
+  }
+  _ctx.log_stats = _ctx.log->getStats();
+
+  _ctx.route_check = default_route_check;
+  _ctx.drain_records_per_s = drain_records_per_s;
+  _ctx.flush_period_ms = flush_period_ms;
+
+  BaseType_t rval = xTaskCreate(
+              bm_store_forward_task,
+              "sfDrain",
+              // TODO - verify stack size
+              configMINIMAL_STACK_SIZE * 4,
+              NULL,
+              BM_STORE_FORWARD_TASK_PRIORITY,
+              &_ctx.task);
+
+  configASSERT(rval == pdTRUE);
+}
+
+/*!
+  Enable store and forward on a topic
+
+  \param[in] *topic - topic string
+  \param[in] topic_len - length of topic string
+  \return true if the topic is enabled, false if there is no room left
+*/
+bool bm_store_forward_enable(const char *topic, uint16_t topic_len) {
+  bool rval = false;
+  configASSERT(_ctx.lock);
+
+  if(topic && topic_len && (topic_len < BM_TOPIC_MAX_LEN) &&
+     (xSemaphoreTake(_ctx.lock, pdMS_TO_TICKS(SF_LOCK_TIMEOUT_MS)) == pdTRUE)) {
+    if(find_topic(topic, topic_len)) {
+      rval = true;
+    } else {
+      bm_sf_topic_t *slot = find_free_topic();
+      if(slot) {
+        slot->topic = static_cast<char *>(pvPortMalloc(topic_len));
+        configASSERT(slot->topic);
+        memcpy(slot->topic, topic, topic_len);
+        slot->topic_len = topic_len;
+        rval = true;
+      }
+    }
+    xSemaphoreGive(_ctx.lock);
+  }
+
+  return rval;
+}
+
+/*!
+  Disable store and forward on a topic. Already stored data will still be forwarded.
+
+  \param[in] *topic - topic string
+  \param[in] topic_len - length of topic string
+  \return true if the topic was disabled, false if it wasn't enabled
+*/
+bool bm_store_forward_disable(const char *topic, uint16_t topic_len) {
+  bool rval = false;
+  configASSERT(_ctx.lock);
+
+  if(topic && topic_len &&
+     (xSemaphoreTake(_ctx.lock, pdMS_TO_TICKS(SF_LOCK_TIMEOUT_MS)) == pdTRUE)) {
+    bm_sf_topic_t *slot = find_topic(topic, topic_len);
+    if(slot) {
+      vPortFree(slot->topic);
+      slot->topic = NULL;
+      slot->topic_len = 0;
+      rval = true;
+    }
+    xSemaphoreGive(_ctx.lock);
+  }
+
+  return rval;
+}
+
+/*!
+  Replace the default route check (any online neighbor). For example, a bridge
+  can use its power controller state instead.
+
+  \param[in] route_check - route check function
+  \return None
+*/
+void bm_store_forward_set_route_check(bm_sf_route_check_t route_check) {
+  configASSERT(route_check);
+  _ctx.route_check = route_check;
+}
+
+/*!
+  Store published data for later if the topic has store and forward enabled and
+  there is currently no route. Called from bm_pub_wl. The record is handed to
+  the store and forward task, which appends it to the log, so publishers never
+  wait on flash.
+
+  \param[in] *topic - topic string
+  \param[in] topic_len - length of topic string
+  \param[in] *data - data being published
+  \param[in] len - length of data
+  \return true if the data was queued for storage (and should not be published now), false otherwise
+*/
+bool bm_store_forward_store(const char *topic, uint16_t topic_len, const void *data, uint16_t len) {
+  bool rval = false;
+
+  do {
+    // Not initialized or this is the drain task re-publishing stored data
+    if(!_ctx.log || (xTaskGetCurrentTaskHandle() == _ctx.task)) {
+      break;
+    }
+
+    if(xSemaphoreTake(_ctx.lock, pdMS_TO_TICKS(SF_LOCK_TIMEOUT_MS)) != pdTRUE) {
+      break;
+    }
+    bool store = find_topic(topic, topic_len) && !_ctx.route_check();
+    xSemaphoreGive(_ctx.lock);
+
+    if(!store) {
+      break;
+    }
+
+    bm_sf_record_t item = {NULL, 0};
+    uint32_t record_len = sizeof(uint8_t) + topic_len + len;
+    if(record_len <= _ctx.log->maxRecordLen()) {
+      item.record = static_cast<uint8_t *>(pvPortMalloc(record_len));
+    }
+
+    if(item.record) {
+      item.len = static_cast<uint16_t>(record_len);
+      item.record[0] = static_cast<uint8_t>(topic_len);
+      memcpy(&item.record[sizeof(uint8_t)], topic, topic_len);
+      memcpy(&item.record[sizeof(uint8_t) + topic_len], data, len);
+
+      if(xQueueSend(_ctx.store_queue, &item, 0) == pdTRUE) {
+        rval = true;
+        break;
+      }
+      vPortFree(item.record);
+    }
+
+    // Too big, out of memory or too many waiting. Publish it live instead.
+    xSemaphoreTake(_ctx.lock, portMAX_DELAY);
+    _ctx.stats.store_failed++;
+    xSemaphoreGive(_ctx.lock);
+  } while(0);
+
+  return rval;
+}
+
+/*!
+  Check whether data published on a topic would be stored instead of sent
+  (store and forward is enabled for it and there is currently no route).
+  Used by publishers that can't go through the log, like reliable publishing.
+
+  \param[in] *topic - topic string
+  \param[in] topic_len - length of topic string
+  \return true if there is no route for this topic's data, false otherwise
+*/
+bool bm_store_forward_no_route(const char *topic, uint16_t topic_len) {
+  bool rval = false;
+
+  do {
+    if(!_ctx.log) {
+      break;
+    }
+
+    if(xSemaphoreTake(_ctx.lock, pdMS_TO_TICKS(SF_LOCK_TIMEOUT_MS)) != pdTRUE) {
+      break;
+    }
+
+    rval = find_topic(topic, topic_len) && !_ctx.route_check();
+
+    xSemaphoreGive(_ctx.lock);
+  } while(0);
+
+  return rval;
+}
+
+/*!
+  Get store and forward stats
+
+  \param[out] &stats - stats
+  \return true if successful, false otherwise
+*/
+bool bm_store_forward_get_stats(bm_sf_stats_t &stats) {
+  bool rval = false;
+  if(_ctx.log && (xSemaphoreTake(_ctx.lock, pdMS_TO_TICKS(SF_LOCK_TIMEOUT_MS)) == pdTRUE)) {
+    stats = _ctx.stats;
+    xSemaphoreGive(_ctx.lock);
+    rval = true;
+  }
+  return rval;
+}
+
+/*!
+  Print store and forward stats
+  \return None
+*/
+void bm_store_forward_print_stats(void) {
+  if(_ctx.log && (xSemaphoreTake(_ctx.lock, pdMS_TO_TICKS(SF_LOCK_TIMEOUT_MS)) == pdTRUE)) {
+    const NvmRingLogStats_t &log_stats = _ctx.log_stats;
+    printf("Stored: %" PRIu32 " (%" PRIu32 " failed)\n", _ctx.stats.stored, _ctx.stats.store_failed);
+    printf("Forwarded: %" PRIu32 " (%" PRIu32 " failed)\n", _ctx.stats.forwarded, _ctx.stats.forward_failed);
+    printf("Dropped sectors: %" PRIu32 "\n", log_stats.droppedSectors);
+    printf("Corrupt records: %" PRIu32 "\n", log_stats.corrupt);
+    printf("Flash writes: %" PRIu32 " erases: %" PRIu32 "\n", log_stats.flashWrites, log_stats.flashErases);
+    xSemaphoreGive(_ctx.lock);
+  }
+}
+
+/*!
+  Copy the log's stats for other tasks to read. Called by the store and
+  forward task after using the log.
+
+  \return None
+*/
+static void update_log_stats(void) {
+  xSemaphoreTake(_ctx.lock, portMAX_DELAY);
+  _ctx.log_stats = _ctx.log->getStats();
+  xSemaphoreGive(_ctx.lock);
+}
+
+/*!
+  Append a record queued by bm_store_forward_store to the log
+
+  \param[in] &item - record (freed here)
+  \return None
+*/
+static void bm_store_forward_append(bm_sf_record_t &item) {
+  bool stored = _ctx.log->append(item.record, item.len);
+  vPortFree(item.record);
+
+  xSemaphoreTake(_ctx.lock, portMAX_DELAY);
+  if(stored) {
+    _ctx.stats.stored++;
+  } else {
+    _ctx.stats.store_failed++;
+  }
+  _ctx.log_stats = _ctx.log->getStats();
+  xSemaphoreGive(_ctx.lock);
+}
+
+/*!
+  Re-publish up to drain_records_per_s stored records. Stops early if there
+  is no route or publishing fails, leaving the remaining records in the log.
+
+  \param[in] *record - buffer of at least maxRecordLen() bytes
+  \return None
+*/
+static void bm_store_forward_drain(uint8_t *record) {
+  for(uint32_t count = 0; count < _ctx.drain_records_per_s; count++) {
+    if(xSemaphoreTake(_ctx.lock, pdMS_TO_TICKS(SF_LOCK_TIMEOUT_MS)) != pdTRUE) {
+      break;
+    }
+    bool route = _ctx.route_check();
+    xSemaphoreGive(_ctx.lock);
+
+    uint16_t record_len = 0;
+    if(!route || !_ctx.log->peek(record, _ctx.log->maxRecordLen(), record_len)) {
+      break;
+    }
+
+    uint8_t topic_len = record[0];
+    if((sizeof(uint8_t) + topic_len) > record_len) {
+      // Not something we stored, just get rid of it
+      _ctx.log->pop();
+      continue;
+    }
+
+    const char *topic = reinterpret_cast<const char *>(&record[sizeof(uint8_t)]);
+    bool published = bm_pub_wl(topic, topic_len, &record[sizeof(uint8_t) + topic_len],
+                               record_len - sizeof(uint8_t) - topic_len);
+    if(published) {
+      _ctx.log->pop();
+    }
+
+    xSemaphoreTake(_ctx.lock, portMAX_DELAY);
+    if(published) {
+      _ctx.stats.forwarded++;
+    } else {
+      _ctx.stats.forward_failed++;
+    }
+    xSemaphoreGive(_ctx.lock);
+
+    if(!published) {
+      break;
+    }
+  }
+
+  update_log_stats();
+}
+
+/*!
+  Store and forward task. Appends records queued by publishers to the log,
+  periodically drains it (rate limited) and flushes staged records to flash.
+
+  \param[in] *parameters - unused
+  \return None
+*/
+static void bm_store_forward_task(void *parameters) {
+  (void)parameters;
+
+  uint8_t *record = static_cast<uint8_t *>(pvPortMalloc(_ctx.log->maxRecordLen()));
+  configASSERT(record);
+
+  TickType_t last_drain = xTaskGetTickCount();
+  TickType_t last_flush = last_drain;
+  for(;;) {
+    TickType_t elapsed = xTaskGetTickCount() - last_drain;
+    TickType_t wait = (elapsed < pdMS_TO_TICKS(SF_DRAIN_PERIOD_MS)) ? (pdMS_TO_TICKS(SF_DRAIN_PERIOD_MS) - elapsed) : 0;
+
+    bm_sf_record_t item;
+    if(xQueueReceive(_ctx.store_queue, &item, wait) == pdTRUE) {
+      bm_store_forward_append(item);
+    }
+
+    if((xTaskGetTickCount() - last_drain) < pdMS_TO_TICKS(SF_DRAIN_PERIOD_MS)) {
+      continue;
+    }
+    last_drain = xTaskGetTickCount();
+
+    bm_store_forward_drain(record);
+
+    if((xTaskGetTickCount() - last_flush) >= pdMS_TO_TICKS(_ctx.flush_period_ms)) {
+      last_flush = xTaskGetTickCount();
+      if(_ctx.log->needsFlush() && !_ctx.log->flush()) {
+        printf("Unable to flush store and forward log\n");
+      }
+      update_log_stats();
+    }
+  }
+}
@@ -0,0 +1,29 @@
+#pragma once
+
+#include <stdbool.h>
+#include <stdint.h>
+#include "nvmPartition.h"
+
+#define BM_SF_MAX_TOPICS (8)
+#define BM_SF_DEFAULT_DRAIN_RECORDS_PER_S (10)
+#define BM_SF_DEFAULT_FLUSH_PERIOD_MS (60 * 1000)
+
+// Returns true if published data can currently reach the rest of the network
+typedef bool (*bm_sf_route_check_t)(void);
+
+typedef struct {
+  uint32_t stored;
+  uint32_t store_failed;
+  uint32_t forwarded;
+  uint32_t forward_failed;
+} bm_sf_stats_t;
+
+void bm_store_forward_init(NvmPartition &partition, uint32_t drain_records_per_s=BM_SF_DEFAULT_DRAIN_RECORDS_PER_S,
+                           uint32_t flush_period_ms=BM_SF_DEFAULT_FLUSH_PERIOD_MS);
+bool bm_store_forward_enable(const char *topic, uint16_t topic_len);
+bool bm_store_forward_disable(const char *topic, uint16_t topic_len);
+void bm_store_forward_set_route_check(bm_sf_route_check_t route_check);
+bool bm_store_forward_store(const char *topic, uint16_t topic_len, const void *data, uint16_t len);
+bool bm_store_forward_no_route(const char *topic, uint16_t topic_len);
+bool bm_store_forward_get_stats(bm_sf_stats_t &stats);
+void bm_store_forward_print_stats(void);
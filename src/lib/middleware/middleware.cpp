@@ -8,19 +8,24 @@
 #include "lwip/pbuf.h"
 #include "lwip/udp.h"
 #include "middleware.h"
+#include "perf_counters.h"
+#include "pubsub_limits.h"
 #include "safe_udp.h"
 #include "semphr.h"
 #include "task_priorities.h"
+#include "trace.h"
 
 #define NET_QUEUE_LEN 64
 
-#define MAX_PAYLOAD_LEN (1500 - sizeof(struct ip6_hdr) - sizeof(struct udp_hdr))
-
 typedef struct {
     struct netif* netif;
     struct udp_pcb* pcb;
     uint16_t port;
     xQueueHandle netQueue;
+    TaskHandle_t task;
+    perfQueue_t netQueuePerf;
+    // Dropped to leave room for higher priority messages (see net_queue_admit)
+    perfCounter_t netQueueShed;
 } middlewareContext_t;
 
 typedef struct {
@@ -31,6 +36,7 @@ typedef struct {
 static middlewareContext_t _ctx;
 static void middleware_net_task( void *parameters );
 static void middleware_net_rx_cb(void *arg, struct udp_pcb *upcb, struct pbuf *buf, const ip_addr_t *addr, u16_t port);
+static bool net_queue_admit(struct pbuf *pbuf);
 
 /*!
   Process received CLI commands from iridium. Split them up, if multiple,
@@ -48,8 +54,12 @@ void bm_middleware_init(struct netif* netif, uint16_t port) {
   _ctx.netif = netif;
   _ctx.port = port;
 
+  bm_pubsub_init();
+
   _ctx.netQueue = xQueueCreate(NET_QUEUE_LEN, sizeof(netQueueItem_t));
   configASSERT(_ctx.netQueue);
+  perfQueueRegister(&_ctx.netQueuePerf, "mw_net_q", _ctx.netQueue);
+  perfCounterRegister(&_ctx.netQueueShed, "mw_net_q", "shed", PERF_COUNTER_TYPE_COUNT);
 
   rval = xTaskCreate(
               middleware_net_task,
@@ -58,28 +68,65 @@ void bm_middleware_init(struct netif* netif, uint16_t port) {
               configMINIMAL_STACK_SIZE * 4,
               NULL,
               MIDDLEWARE_NET_TASK_PRIORITY,
-              NULL);
+              &_ctx.task);
 
   configASSERT(rval == pdTRUE);
 }
 
+/*!
+  Check if we're running on the middleware task (which must never block for
+  long, since it receives and acks everything)
+  \return true if called from the middleware task, false otherwise
+*/
+bool bm_middleware_in_task(void) {
+  return (_ctx.task != NULL) && (xTaskGetCurrentTaskHandle() == _ctx.task);
+}
+
 /*!
   Middleware network transmit function
   \param[in] *pbuf - data to send over UDP
   \return 0 if OK nonzero otherwise (see udp_send for error codes)
 */
 int32_t middleware_net_tx(struct pbuf *pbuf) {
+  // TODO - Do we always send global multicast or link local?
+  return middleware_net_tx_to(pbuf, &multicast_global_addr);
+}
+
+/*!
+  Middleware network transmit function (to a specific address)
+  \param[in] *pbuf - data to send over UDP
+  \param[in] *dst - destination address (unicast only reaches direct neighbors)
+  \return 0 if OK nonzero otherwise (see udp_send for error codes)
+*/
+int32_t middleware_net_tx_to(struct pbuf *pbuf, const ip_addr_t *dst) {
   int32_t rval = -1;
 
   // Don't try to transmit if the payload is too big
-  if(pbuf->len <= MAX_PAYLOAD_LEN){
-    // TODO - Do we always send global multicast or link local?
-    rval = safe_udp_sendto_if(_ctx.pcb, pbuf, &multicast_global_addr, _ctx.port, _ctx.netif);
+  if(pbuf->len <= MIDDLEWARE_MAX_PAYLOAD_LEN){
+    tracePacket(kTraceEventPktMwTx, pbuf);
+    rval = safe_udp_sendto_if(_ctx.pcb, pbuf, dst, _ctx.port, _ctx.netif);
   }
 
   return rval;
 }
 
+/*!
+  Check whether the net queue has room for a message. Lower priority messages
+  leave room for higher priority ones, so a fast stream can't starve control
+  topics.
+  \param[in] *pbuf - message
+  \return true if the message can be queued
+*/
+static bool net_queue_admit(struct pbuf *pbuf) {
+  bm_pubsub_priority_e prio = bm_pubsub_msg_priority(pbuf);
+  if(!pubsubLimitsAdmit(static_cast<pubsubPrio_e>(prio), uxQueueSpacesAvailable(_ctx.netQueue), NET_QUEUE_LEN)) {
+    perfCounterInc(&_ctx.netQueueShed);
+    return false;
+  }
+
+  return true;
+}
+
 /*!
   Middleware UDP rx callback
   \param[in] *arg - unused
@@ -107,12 +154,21 @@ static void middleware_net_rx_cb(void *arg, struct udp_pcb *upcb, struct pbuf *b
 
       queueItem.pbuf = buf;
 
+      // No room for its priority, or publisher/topic over its rate limit (or
+      // malformed). buf will be freed below
+      if(!net_queue_admit(buf) || !bm_pubsub_rx_allowed(ip_to_nodeid(addr), buf)) {
+        break;
+      }
+
       //
+      tracePacket(kTraceEventPktMwEnqueue, buf);
       if(xQueueSend(_ctx.netQueue, &queueItem, 0) != pdTRUE) {
+        perfQueueDropped(&_ctx.netQueuePerf);
         printf("Error sending to Queue\n");
         // buf will be freed below
         break;
       }
+      perfQueueSent(&_ctx.netQueuePerf);
 
       // Clear buf so we don't free it below
       buf = NULL;
@@ -142,19 +198,42 @@ int32_t bm_middleware_local_pub(struct pbuf *pbuf) {
 
   memcpy(&queueItem.addr, netif_ip6_addr(_ctx.netif, 1), sizeof(queueItem.addr));
 
+  // Our own publications were already rate limited, but still need room for
+  // their priority
+  if(!net_queue_admit(pbuf)) {
+    return -1;
+  }
+
   // add one to reference count since we'll be using it in two places
   pbuf_ref(pbuf);
+  tracePacket(kTraceEventPktMwEnqueue, pbuf);
   if(xQueueSend(_ctx.netQueue, &queueItem, 0) != pdTRUE) {
+      perfQueueDropped(&_ctx.netQueuePerf);
       printf("Error sending to Queue\n");
 
       // JK, don't retain it since we didn't send it out
       pbuf_free(pbuf);
       rval = -1;
+  } else {
+      perfQueueSent(&_ctx.netQueuePerf);
   }
 
   return rval;
 }
 
+/*!
+  Wake up the middleware task so it picks up a new reliable publishing
+  deadline (see bm_pub_qos_poll)
+  \return None
+*/
+void bm_middleware_wake(void) {
+  // Empty item, nothing to process
+  netQueueItem_t queueItem = {};
+
+  // If the queue is full, the task is busy and will poll soon anyway
+  xQueueSend(_ctx.netQueue, &queueItem, 0);
+}
+
 /*!
   Middleware network processing task. Will receive middleware packets in queue from
   middleware_net_rx_cb and process them.
@@ -172,9 +251,24 @@ static void middleware_net_task( void *parameters ) {
   for(;;) {
     netQueueItem_t item;
 
-    BaseType_t rval = xQueueReceive(_ctx.netQueue, &item, portMAX_DELAY);
-    configASSERT(rval == pdTRUE);
-    configASSERT(item.pbuf);
+    // Retransmit reliable publications and drop stale partial messages while
+    // waiting for messages
+    uint32_t poll_ms = bm_pub_qos_poll();
+    uint32_t frag_ms = bm_pubsub_frag_poll();
+    if(frag_ms < poll_ms) {
+      poll_ms = frag_ms;
+    }
+    TickType_t wait = (poll_ms == UINT32_MAX) ? portMAX_DELAY : pdMS_TO_TICKS(poll_ms);
+
+    if(xQueueReceive(_ctx.netQueue, &item, wait) != pdTRUE) {
+      continue;
+    }
+
+    // Woken up by bm_middleware_wake
+    if(!item.pbuf) {
+      continue;
+    }
+    tracePacket(kTraceEventPktMwDequeue, item.pbuf);
 
     //
     // Do stuff with item here
@@ -2,6 +2,7 @@
 
 #include <stdbool.h>
 #include <stdint.h>
+#include "lwip/ip_addr.h"
 #include "lwip/netif.h"
 #include "lwip/pbuf.h"
 
@@ -9,9 +10,16 @@
 extern "C" {
 #endif
 
+// Largest middleware message that fits in a frame (1500 byte MTU minus IPv6
+// and UDP headers)
+#define MIDDLEWARE_MAX_PAYLOAD_LEN (1500 - 40 - 8)
+
 int32_t bm_middleware_local_pub(struct pbuf *pbuf);
 void bm_middleware_init(struct netif* netif, uint16_t port);
 int32_t middleware_net_tx(struct pbuf *pbuf);
+int32_t middleware_net_tx_to(struct pbuf *pbuf, const ip_addr_t *dst);
+void bm_middleware_wake(void);
+bool bm_middleware_in_task(void);
 
 #ifdef __cplusplus
 }
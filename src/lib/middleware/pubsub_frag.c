@@ -0,0 +1,205 @@
+#include <string.h>
+#include "FreeRTOS.h"
+#include "pubsub_frag.h"
+
+/*!
+  Check whether a deadline has passed (handles ms counter wrap)
+
+  \param[in] nowMs - current time
+  \param[in] deadlineMs - deadline
+  \return true if deadline is now or in the past
+*/
+static inline bool deadlinePassed(uint32_t nowMs, uint32_t deadlineMs) {
+  return (int32_t)(nowMs - deadlineMs) >= 0;
+}
+
+/*!
+  Number of fragments a message is split into
+
+  \param[in] totalLen - message length
+  \return number of fragments
+*/
+uint8_t pubsubFragCount(uint16_t totalLen) {
+  return (uint8_t)((totalLen + PUBSUB_FRAG_DATA_LEN - 1) / PUBSUB_FRAG_DATA_LEN);
+}
+
+/*!
+  Length of one of a message's fragments
+
+  \param[in] totalLen - message length
+  \param[in] index - fragment index
+  \return fragment data length, 0 if there's no such fragment
+*/
+uint16_t pubsubFragLen(uint16_t totalLen, uint8_t index) {
+  uint32_t offset = (uint32_t)index * PUBSUB_FRAG_DATA_LEN;
+  if(offset >= totalLen) {
+    return 0;
+  }
+
+  uint32_t remaining = totalLen - offset;
+  return (uint16_t)((remaining > PUBSUB_FRAG_DATA_LEN) ? PUBSUB_FRAG_DATA_LEN : remaining);
+}
+
+/*!
+  Initialize the receiver side
+
+  \param[in] *rx - reassembly state
+  \param[in] timeoutMs - drop a message if no fragment arrives for this long
+  \param[in] alloc - allocates message buffers
+  \param[in] free - frees message buffers (from alloc) that didn't complete
+  \return none
+*/
+void pubsubFragRxInit(pubsubFragRx_t *rx, uint32_t timeoutMs, pubsubFragAllocCb_t alloc, pubsubFragFreeCb_t free) {
+  configASSERT(rx);
+  configASSERT(timeoutMs);
+  configASSERT(alloc);
+  configASSERT(free);
+
+  memset(rx, 0, sizeof(*rx));
+  rx->timeoutMs = timeoutMs;
+  rx->alloc = alloc;
+  rx->free = free;
+}
+
+/*!
+  Free up a reassembly slot
+
+  \param[in] *rx - reassembly state
+  \param[in] *slot - slot holding the message
+  \param[in] freeMsg - true to drop the message, false if the caller took it
+  \return none
+*/
+static void releaseSlot(pubsubFragRx_t *rx, pubsubFragRxSlot_t *slot, bool freeMsg) {
+  if(freeMsg) {
+    rx->free(slot->msg);
+  }
+  slot->msg = NULL;
+}
+
+/*!
+  Add a received fragment
+
+  \param[in] *rx - reassembly state
+  \param[in] nodeId - sender node id
+  \param[in] *header - fragment header
+  \param[in] *data - fragment data
+  \param[in] len - fragment data length
+  \param[in] nowMs - current time
+  \param[out] *msg - reassembled message (when complete). The caller owns it now.
+  \return PUBSUB_FRAG_RX_COMPLETE when this was the last missing fragment,
+          PUBSUB_FRAG_RX_PENDING if more are needed, PUBSUB_FRAG_RX_DUPLICATE
+          if we already had it, PUBSUB_FRAG_RX_INVALID if the header doesn't
+          make sense, PUBSUB_FRAG_RX_NO_ROOM if the message had to be dropped
+*/
+pubsubFragRxResult_e pubsubFragRxAdd(pubsubFragRx_t *rx, uint64_t nodeId, const pubsubFragHeader_t *header, const uint8_t *data, uint16_t len, uint32_t nowMs, void **msg) {
+  configASSERT(rx);
+  configASSERT(header);
+  configASSERT(data || !len);
+  configASSERT(msg);
+
+  if(!header->totalLen || (header->count != pubsubFragCount(header->totalLen)) ||
+     (header->index >= header->count) || (len != pubsubFragLen(header->totalLen, header->index))) {
+    return PUBSUB_FRAG_RX_INVALID;
+  }
+
+  pubsubFragRxSlot_t *slot = NULL;
+  pubsubFragRxSlot_t *freeSlot = NULL;
+  for(uint32_t idx = 0; idx < PUBSUB_FRAG_RX_SLOTS; idx++) {
+    pubsubFragRxSlot_t *cur = &rx->slots[idx];
+    if(cur->msg && deadlinePassed(nowMs, cur->deadlineMs)) {
+      releaseSlot(rx, cur, true);
+    }
+
+    if(!cur->msg) {
+      if(!freeSlot) {
+        freeSlot = cur;
+      }
+    } else if((cur->nodeId == nodeId) && (cur->msgId == header->msgId)) {
+      slot = cur;
+    }
+  }
+
+  if(slot && (slot->totalLen != header->totalLen)) {
+    return PUBSUB_FRAG_RX_INVALID;
+  }
+
+  if(!slot) {
+    if(!freeSlot || (header->totalLen > PUBSUB_FRAG_RX_MAX_LEN)) {
+      return PUBSUB_FRAG_RX_NO_ROOM;
+    }
+
+    uint8_t *msgData = NULL;
+    void *newMsg = rx->alloc(header->totalLen, &msgData);
+    if(!newMsg) {
+      return PUBSUB_FRAG_RX_NO_ROOM;
+    }
+    configASSERT(msgData);
+
+    slot = freeSlot;
+    slot->msg = newMsg;
+    slot->data = msgData;
+    slot->nodeId = nodeId;
+    slot->msgId = header->msgId;
+    slot->totalLen = header->totalLen;
+    slot->count = header->count;
+    slot->received = 0;
+    slot->fragments = 0;
+  }
+
+  uint64_t bit = 1ULL << header->index;
+  if(slot->fragments & bit) {
+    return PUBSUB_FRAG_RX_DUPLICATE;
+  }
+
+  memcpy(&slot->data[(uint32_t)header->index * PUBSUB_FRAG_DATA_LEN], data, len);
+  slot->fragments |= bit;
+  slot->received++;
+  slot->deadlineMs = nowMs + rx->timeoutMs;
+
+  if(slot->received < slot->count) {
+    return PUBSUB_FRAG_RX_PENDING;
+  }
+
+  *msg = slot->msg;
+  releaseSlot(rx, slot, false);
+  return PUBSUB_FRAG_RX_COMPLETE;
+}
+
+/*!
+  Drop messages that stopped making progress
+
+  \param[in] *rx - reassembly state
+  \param[in] nowMs - current time
+  \param[out] *expired - number of messages dropped (optional)
+  \return ms until the next message times out, PUBSUB_FRAG_NO_TIMEOUT if
+          nothing is being reassembled
+*/
+uint32_t pubsubFragRxPoll(pubsubFragRx_t *rx, uint32_t nowMs, uint32_t *expired) {
+  configASSERT(rx);
+
+  uint32_t numExpired = 0;
+  uint32_t nextMs = PUBSUB_FRAG_NO_TIMEOUT;
+  for(uint32_t idx = 0; idx < PUBSUB_FRAG_RX_SLOTS; idx++) {
+    pubsubFragRxSlot_t *slot = &rx->slots[idx];
+    if(!slot->msg) {
+      continue;
+    }
+
+    if(deadlinePassed(nowMs, slot->deadlineMs)) {
+      releaseSlot(rx, slot, true);
+      numExpired++;
+      continue;
+    }
+
+    uint32_t remainingMs = slot->deadlineMs - nowMs;
+    if(remainingMs < nextMs) {
+      nextMs = remainingMs;
+    }
+  }
+
+  if(expired) {
+    *expired = numExpired;
+  }
+
+  return nextMs;
+}
@@ -0,0 +1,102 @@
+#pragma once
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+//
+// Fragmentation/reassembly for pub/sub messages that don't fit in one frame
+//
+// Every fragment but the last one carries exactly PUBSUB_FRAG_DATA_LEN bytes,
+// so a fragment's position in the message follows from its index. The
+// message length is in every fragment, so the receiver can set aside room
+// for the whole message as soon as any fragment shows up and copy each one
+// straight to its place.
+//
+// Receivers reassemble a few messages at a time, each up to
+// PUBSUB_FRAG_RX_MAX_LEN bytes (the caller's buffers are sized for it, so the
+// total is fixed). A message that stops making progress for timeoutMs is
+// dropped. Every fragment also carries the message's topic hash, so a
+// receiver can skip messages nobody subscribed to before taking a slot.
+//
+// No locking or timers in here; the caller serializes access and provides the
+// time.
+//
+
+// Fits in a frame with the IPv6/UDP/pub-sub/fragment headers
+#define PUBSUB_FRAG_DATA_LEN      (1400)
+#define PUBSUB_FRAG_MAX_FRAGMENTS ((UINT16_MAX + PUBSUB_FRAG_DATA_LEN - 1) / PUBSUB_FRAG_DATA_LEN)
+// Reassembly buffers are statically allocated (slots * max length), so the
+// defaults are small. Apps that receive large messages can raise them in their
+// APP_DEFINES. Publishers don't send messages bigger than their own
+// PUBSUB_FRAG_RX_MAX_LEN, and receivers drop them.
+#ifndef PUBSUB_FRAG_RX_SLOTS
+#define PUBSUB_FRAG_RX_SLOTS      (2)
+#endif
+#ifndef PUBSUB_FRAG_RX_MAX_LEN
+#define PUBSUB_FRAG_RX_MAX_LEN    (4 * 1024)
+#endif
+
+#if (PUBSUB_FRAG_RX_MAX_LEN < PUBSUB_FRAG_DATA_LEN) || (PUBSUB_FRAG_RX_MAX_LEN > UINT16_MAX)
+#error "PUBSUB_FRAG_RX_MAX_LEN must be between PUBSUB_FRAG_DATA_LEN and UINT16_MAX"
+#endif
+#define PUBSUB_FRAG_NO_TIMEOUT    (UINT32_MAX)
+
+typedef struct {
+  // Different for every fragmented message from a node
+  uint16_t msgId;
+  uint8_t index;
+  uint8_t count;
+  // Length of the whole (reassembled) message
+  uint16_t totalLen;
+  // pubsubRoutesHash of the message's topic
+  uint32_t topicHash;
+} __attribute__((packed)) pubsubFragHeader_t;
+
+typedef enum {
+  PUBSUB_FRAG_RX_PENDING,
+  PUBSUB_FRAG_RX_COMPLETE,
+  PUBSUB_FRAG_RX_DUPLICATE,
+  PUBSUB_FRAG_RX_INVALID,
+  PUBSUB_FRAG_RX_NO_ROOM,
+} pubsubFragRxResult_e;
+
+// Allocate a message buffer. Returns the caller's handle (NULL if out of
+// memory) and where the message data goes.
+typedef void *(*pubsubFragAllocCb_t)(uint16_t len, uint8_t **data);
+typedef void (*pubsubFragFreeCb_t)(void *msg);
+
+typedef struct {
+  // Caller's message buffer (NULL when the slot is free)
+  void *msg;
+  uint8_t *data;
+  uint64_t nodeId;
+  uint16_t msgId;
+  uint16_t totalLen;
+  uint8_t count;
+  uint8_t received;
+  // Bit n set when fragment n has been received
+  uint64_t fragments;
+  uint32_t deadlineMs;
+} pubsubFragRxSlot_t;
+
+typedef struct {
+  pubsubFragRxSlot_t slots[PUBSUB_FRAG_RX_SLOTS];
+  uint32_t timeoutMs;
+  pubsubFragAllocCb_t alloc;
+  pubsubFragFreeCb_t free;
+} pubsubFragRx_t;
+
+uint8_t pubsubFragCount(uint16_t totalLen);
+uint16_t pubsubFragLen(uint16_t totalLen, uint8_t index);
+
+void pubsubFragRxInit(pubsubFragRx_t *rx, uint32_t timeoutMs, pubsubFragAllocCb_t alloc, pubsubFragFreeCb_t free);
+pubsubFragRxResult_e pubsubFragRxAdd(pubsubFragRx_t *rx, uint64_t nodeId, const pubsubFragHeader_t *header, const uint8_t *data, uint16_t len, uint32_t nowMs, void **msg);
+uint32_t pubsubFragRxPoll(pubsubFragRx_t *rx, uint32_t nowMs, uint32_t *expired);
+
+#ifdef __cplusplus
+}
+#endif
@@ -0,0 +1,358 @@
+#include <string.h>
+#include "FreeRTOS.h"
+#include "pubsub_limits.h"
+
+/*!
+  Initialize a token bucket (starts full)
+
+  \param[in] *bucket - bucket
+  \param[in] rateBps - bytes per second, 0 for no limit
+  \param[in] burstBytes - most bytes that can go at once, 0 for one second's worth
+  \param[in] nowMs - current time
+  \return none
+*/
+void pubsubBucketInit(pubsubBucket_t *bucket, uint32_t rateBps, uint32_t burstBytes, uint32_t nowMs) {
+  configASSERT(bucket);
+
+  bucket->rateBps = rateBps;
+  bucket->burstBytes = burstBytes ? burstBytes : rateBps;
+  bucket->milliTokens = (uint64_t)bucket->burstBytes * 1000;
+  bucket->lastMs = nowMs;
+}
+
+/*!
+  Take tokens for a message. Messages larger than the burst size only need
+  a full bucket, otherwise they could never go.
+
+  \param[in] *bucket - bucket
+  \param[in] bytes - message size
+  \param[in] nowMs - current time
+  \return true if the message is within the limit
+*/
+bool pubsubBucketTake(pubsubBucket_t *bucket, uint32_t bytes, uint32_t nowMs) {
+  configASSERT(bucket);
+
+  if(!bucket->rateBps) {
+    return true;
+  }
+
+  uint64_t maxMilliTokens = (uint64_t)bucket->burstBytes * 1000;
+  bucket->milliTokens += (uint64_t)(uint32_t)(nowMs - bucket->lastMs) * bucket->rateBps;
+  if(bucket->milliTokens > maxMilliTokens) {
+    bucket->milliTokens = maxMilliTokens;
+  }
+  bucket->lastMs = nowMs;
+
+  uint64_t needed = (uint64_t)((bytes < bucket->burstBytes) ? bytes : bucket->burstBytes) * 1000;
+  if(bucket->milliTokens < needed) {
+    return false;
+  }
+
+  bucket->milliTokens -= needed;
+  return true;
+}
+
+/*!
+  Find a topic's entry
+
+  \param[in] *limits - limits
+  \param[in] topicHash - topic hash (see pubsubRoutesHash)
+  \return entry, NULL if the topic isn't in the table
+*/
+static pubsubLimitsTopic_t *findTopic(const pubsubLimits_t *limits, uint32_t topicHash) {
+  for(uint32_t idx = 0; idx < PUBSUB_LIMITS_MAX_TOPICS; idx++) {
+    const pubsubLimitsTopic_t *topic = &limits->topics[idx];
+    if(topic->valid && (topic->topicHash == topicHash)) {
+      return (pubsubLimitsTopic_t *)topic;
+    }
+  }
+
+  return NULL;
+}
+
+/*!
+  Find a topic's entry, adding it if there's room. Topics that are only
+  counted make room for new ones (least recently used first). Their counters
+  move to 'other'.
+
+  \param[in] *limits - limits
+  \param[in] topicHash - topic hash (see pubsubRoutesHash)
+  \param[in] *name - topic name
+  \param[in] nameLen - topic name length
+  \param[in] nowMs - current time
+  \return entry, NULL if every entry is configured
+*/
+static pubsubLimitsTopic_t *getTopic(pubsubLimits_t *limits, uint32_t topicHash, const char *name, uint16_t nameLen, uint32_t nowMs) {
+  pubsubLimitsTopic_t *topic = findTopic(limits, topicHash);
+  if(topic) {
+    topic->lastMs = nowMs;
+    return topic;
+  }
+
+  for(uint32_t idx = 0; idx < PUBSUB_LIMITS_MAX_TOPICS; idx++) {
+    pubsubLimitsTopic_t *entry = &limits->topics[idx];
+    if(!entry->valid) {
+      topic = entry;
+      break;
+    }
+
+    if(!entry->configured && (!topic || ((int32_t)(entry->lastMs - topic->lastMs) < 0))) {
+      topic = entry;
+    }
+  }
+
+  if(!topic) {
+    return NULL;
+  }
+
+  if(topic->valid) {
+    limits->other.txMsgs += topic->counters.txMsgs;
+    limits->other.txBytes += topic->counters.txBytes;
+    limits->other.txDropped += topic->counters.txDropped;
+    limits->other.rxMsgs += topic->counters.rxMsgs;
+    limits->other.rxBytes += topic->counters.rxBytes;
+    limits->other.rxDropped += topic->counters.rxDropped;
+  }
+
+  memset(topic, 0, sizeof(*topic));
+  topic->valid = true;
+  topic->topicHash = topicHash;
+  topic->prio = PUBSUB_PRIO_NORMAL;
+  topic->lastMs = nowMs;
+
+  uint16_t copyLen = (nameLen < (PUBSUB_LIMITS_NAME_LEN - 1)) ? nameLen : (PUBSUB_LIMITS_NAME_LEN - 1);
+  if(copyLen) {
+    memcpy(topic->name, name, copyLen);
+  }
+
+  return topic;
+}
+
+/*!
+  Initialize limits (no limits, every topic normal priority)
+
+  \param[in] *limits - limits
+  \return none
+*/
+void pubsubLimitsInit(pubsubLimits_t *limits) {
+  configASSERT(limits);
+
+  memset(limits, 0, sizeof(*limits));
+}
+
+/*!
+  Set a topic's priority and rate limit. The limit applies separately to
+  messages we publish and messages we receive.
+
+  \param[in] *limits - limits
+  \param[in] topicHash - topic hash (see pubsubRoutesHash)
+  \param[in] *name - topic name
+  \param[in] nameLen - topic name length
+  \param[in] prio - priority class
+  \param[in] rateBps - bytes per second, 0 for no limit
+  \param[in] burstBytes - most bytes that can go at once, 0 for one second's worth
+  \param[in] nowMs - current time
+  \return true if successful, false if too many topics are configured
+*/
+bool pubsubLimitsSetTopic(pubsubLimits_t *limits, uint32_t topicHash, const char *name, uint16_t nameLen, pubsubPrio_e prio, uint32_t rateBps, uint32_t burstBytes, uint32_t nowMs) {
+  configASSERT(limits);
+  configASSERT(name || !nameLen);
+  configASSERT(prio < PUBSUB_PRIO_COUNT);
+
+  pubsubLimitsTopic_t *topic = getTopic(limits, topicHash, name, nameLen, nowMs);
+  if(!topic) {
+    return false;
+  }
+
+  topic->configured = true;
+  topic->prio = prio;
+  pubsubBucketInit(&topic->tx, rateBps, burstBytes, nowMs);
+  pubsubBucketInit(&topic->rx, rateBps, burstBytes, nowMs);
+
+  return true;
+}
+
+/*!
+  Set a topic's priority, keeping its rate limit (if any)
+
+  \param[in] *limits - limits
+  \param[in] topicHash - topic hash (see pubsubRoutesHash)
+  \param[in] *name - topic name
+  \param[in] nameLen - topic name length
+  \param[in] prio - priority class
+  \param[in] nowMs - current time
+  \return true if successful, false if too many topics are configured
+*/
+bool pubsubLimitsSetPriority(pubsubLimits_t *limits, uint32_t topicHash, const char *name, uint16_t nameLen, pubsubPrio_e prio, uint32_t nowMs) {
+  configASSERT(limits);
+  configASSERT(name || !nameLen);
+  configASSERT(prio < PUBSUB_PRIO_COUNT);
+
+  pubsubLimitsTopic_t *topic = getTopic(limits, topicHash, name, nameLen, nowMs);
+  if(!topic) {
+    return false;
+  }
+
+  // Topics that were only counted have no limits yet (buckets are zeroed)
+  topic->configured = true;
+  topic->prio = prio;
+
+  return true;
+}
+
+/*!
+  Set the rate limit for each node we receive from. Existing buckets restart
+  with the new limit.
+
+  \param[in] *limits - limits
+  \param[in] rateBps - bytes per second, 0 for no limit
+  \param[in] burstBytes - most bytes that can go at once, 0 for one second's worth
+  \param[in] nowMs - current time
+  \return none
+*/
+void pubsubLimitsSetPublisher(pubsubLimits_t *limits, uint32_t rateBps, uint32_t burstBytes, uint32_t nowMs) {
+  configASSERT(limits);
+
+  limits->publisherRateBps = rateBps;
+  limits->publisherBurstBytes = burstBytes;
+
+  for(uint32_t idx = 0; idx < PUBSUB_LIMITS_MAX_PUBLISHERS; idx++) {
+    pubsubLimitsPublisher_t *publisher = &limits->publishers[idx];
+    if(publisher->valid) {
+      pubsubBucketInit(&publisher->bucket, rateBps, burstBytes, nowMs);
+    }
+  }
+}
+
+/*!
+  Get a topic's priority class
+
+  \param[in] *limits - limits
+  \param[in] topicHash - topic hash (see pubsubRoutesHash)
+  \return priority class (normal unless set)
+*/
+pubsubPrio_e pubsubLimitsPriority(const pubsubLimits_t *limits, uint32_t topicHash) {
+  configASSERT(limits);
+
+  const pubsubLimitsTopic_t *topic = findTopic(limits, topicHash);
+  return topic ? topic->prio : PUBSUB_PRIO_NORMAL;
+}
+
+/*!
+  Check (and count) a message we're about to publish
+
+  \param[in] *limits - limits
+  \param[in] topicHash - topic hash (see pubsubRoutesHash)
+  \param[in] *name - topic name
+  \param[in] nameLen - topic name length
+  \param[in] bytes - message size
+  \param[in] nowMs - current time
+  \return true if the message can go, false if the topic is over its limit
+*/
+bool pubsubLimitsTx(pubsubLimits_t *limits, uint32_t topicHash, const char *name, uint16_t nameLen, uint32_t bytes, uint32_t nowMs) {
+  configASSERT(limits);
+  configASSERT(name || !nameLen);
+
+  pubsubLimitsTopic_t *topic = getTopic(limits, topicHash, name, nameLen, nowMs);
+  pubsubLimitsCounters_t *counters = topic ? &topic->counters : &limits->other;
+
+  if(topic && !pubsubBucketTake(&topic->tx, bytes, nowMs)) {
+    counters->txDropped++;
+    return false;
+  }
+
+  counters->txMsgs++;
+  counters->txBytes += bytes;
+  return true;
+}
+
+/*!
+  Find a publisher's bucket, adding it (in place of the least recently seen
+  one if needed)
+
+  \param[in] *limits - limits
+  \param[in] nodeId - publisher node
+  \param[in] nowMs - current time
+  \return publisher entry
+*/
+static pubsubLimitsPublisher_t *getPublisher(pubsubLimits_t *limits, uint64_t nodeId, uint32_t nowMs) {
+  pubsubLimitsPublisher_t *publisher = NULL;
+  for(uint32_t idx = 0; idx < PUBSUB_LIMITS_MAX_PUBLISHERS; idx++) {
+    pubsubLimitsPublisher_t *entry = &limits->publishers[idx];
+    if(entry->valid && (entry->nodeId == nodeId)) {
+      entry->lastMs = nowMs;
+      return entry;
+    }
+
+    if(!publisher || (publisher->valid && (!entry->valid || ((int32_t)(entry->lastMs - publisher->lastMs) < 0)))) {
+      publisher = entry;
+    }
+  }
+
+  memset(publisher, 0, sizeof(*publisher));
+  publisher->valid = true;
+  publisher->nodeId = nodeId;
+  publisher->lastMs = nowMs;
+  pubsubBucketInit(&publisher->bucket, limits->publisherRateBps, limits->publisherBurstBytes, nowMs);
+
+  return publisher;
+}
+
+/*!
+  Check (and count) a message we received
+
+  \param[in] *limits - limits
+  \param[in] nodeId - publisher node
+  \param[in] topicHash - topic hash (see pubsubRoutesHash)
+  \param[in] *name - topic name, NULL if the message has none (fragments)
+  \param[in] nameLen - topic name length
+  \param[in] bytes - message size
+  \param[in] nowMs - current time
+  \return true if the message can be handled, false if the publisher or
+          topic is over its limit
+*/
+bool pubsubLimitsRx(pubsubLimits_t *limits, uint64_t nodeId, uint32_t topicHash, const char *name, uint16_t nameLen, uint32_t bytes, uint32_t nowMs) {
+  configASSERT(limits);
+  configASSERT(name || !nameLen);
+
+  pubsubLimitsTopic_t *topic = name ? getTopic(limits, topicHash, name, nameLen, nowMs) : NULL;
+  pubsubLimitsCounters_t *counters = topic ? &topic->counters : &limits->other;
+
+  if(limits->publisherRateBps) {
+    pubsubLimitsPublisher_t *publisher = getPublisher(limits, nodeId, nowMs);
+    if(!pubsubBucketTake(&publisher->bucket, bytes, nowMs)) {
+      publisher->dropped++;
+      counters->rxDropped++;
+      return false;
+    }
+  }
+
+  if(topic && !pubsubBucketTake(&topic->rx, bytes, nowMs)) {
+    counters->rxDropped++;
+    return false;
+  }
+
+  counters->rxMsgs++;
+  counters->rxBytes += bytes;
+  return true;
+}
+
+/*!
+  Check whether a queue has room for a message of a given priority. Lower
+  priorities leave room for higher ones.
+
+  \param[in] prio - message priority class
+  \param[in] spaces - free spaces in the queue
+  \param[in] queueLen - queue length
+  \return true if the message can be queued
+*/
+bool pubsubLimitsAdmit(pubsubPrio_e prio, uint32_t spaces, uint32_t queueLen) {
+  switch(prio) {
+    case PUBSUB_PRIO_LOW:
+      return spaces > (queueLen / 2);
+    case PUBSUB_PRIO_NORMAL:
+      return spaces > (queueLen / 8);
+    default:
+      return spaces > 0;
+  }
+}
@@ -0,0 +1,102 @@
+#pragma once
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+//
+// Per-topic/per-publisher rate limits and priority classes for pub/sub
+//
+// Rate limits are token buckets (bytes per second, with a burst size). Every
+// topic has a priority class, which decides how full a queue can get before
+// its messages are turned away, so bulk data can't crowd out control
+// messages.
+//
+// Topics are tracked by hash (like pubsubRoutes). Configured topics keep their
+// entry; other topics get one for their counters while there's room, and are
+// the first to go when there isn't. Counters for topics that don't fit are
+// added up in 'other' (as are fragments, which carry no topic name). Publishers
+// (nodes we receive from) share one rate limit, each with its own bucket.
+//
+// No locking in here; the caller serializes access and provides the time.
+//
+
+#define PUBSUB_LIMITS_MAX_TOPICS      (16)
+#define PUBSUB_LIMITS_MAX_PUBLISHERS  (8)
+// Longer names are truncated (they're only used for printing)
+#define PUBSUB_LIMITS_NAME_LEN        (32)
+
+typedef enum {
+  // Bulk data (streams). Only admitted while a queue is mostly empty.
+  PUBSUB_PRIO_LOW = 0,
+  PUBSUB_PRIO_NORMAL,
+  // Control messages. Admitted as long as there's any room.
+  PUBSUB_PRIO_HIGH,
+  PUBSUB_PRIO_COUNT,
+} pubsubPrio_e;
+
+typedef struct {
+  // 0 for no limit
+  uint32_t rateBps;
+  uint32_t burstBytes;
+  // 1000 per byte, so slow rates still add up between messages
+  uint64_t milliTokens;
+  uint32_t lastMs;
+} pubsubBucket_t;
+
+typedef struct {
+  uint32_t txMsgs;
+  uint32_t txBytes;
+  uint32_t txDropped;
+  uint32_t rxMsgs;
+  uint32_t rxBytes;
+  uint32_t rxDropped;
+} pubsubLimitsCounters_t;
+
+typedef struct {
+  bool valid;
+  // Set up by the application (not just counted)
+  bool configured;
+  uint32_t topicHash;
+  char name[PUBSUB_LIMITS_NAME_LEN];
+  pubsubPrio_e prio;
+  pubsubBucket_t tx;
+  pubsubBucket_t rx;
+  uint32_t lastMs;
+  pubsubLimitsCounters_t counters;
+} pubsubLimitsTopic_t;
+
+typedef struct {
+  bool valid;
+  uint64_t nodeId;
+  pubsubBucket_t bucket;
+  uint32_t lastMs;
+  uint32_t dropped;
+} pubsubLimitsPublisher_t;
+
+typedef struct {
+  pubsubLimitsTopic_t topics[PUBSUB_LIMITS_MAX_TOPICS];
+  pubsubLimitsPublisher_t publishers[PUBSUB_LIMITS_MAX_PUBLISHERS];
+  uint32_t publisherRateBps;
+  uint32_t publisherBurstBytes;
+  pubsubLimitsCounters_t other;
+} pubsubLimits_t;
+
+void pubsubBucketInit(pubsubBucket_t *bucket, uint32_t rateBps, uint32_t burstBytes, uint32_t nowMs);
+bool pubsubBucketTake(pubsubBucket_t *bucket, uint32_t bytes, uint32_t nowMs);
+
+void pubsubLimitsInit(pubsubLimits_t *limits);
+bool pubsubLimitsSetTopic(pubsubLimits_t *limits, uint32_t topicHash, const char *name, uint16_t nameLen, pubsubPrio_e prio, uint32_t rateBps, uint32_t burstBytes, uint32_t nowMs);
+bool pubsubLimitsSetPriority(pubsubLimits_t *limits, uint32_t topicHash, const char *name, uint16_t nameLen, pubsubPrio_e prio, uint32_t nowMs);
+void pubsubLimitsSetPublisher(pubsubLimits_t *limits, uint32_t rateBps, uint32_t burstBytes, uint32_t nowMs);
+pubsubPrio_e pubsubLimitsPriority(const pubsubLimits_t *limits, uint32_t topicHash);
+bool pubsubLimitsTx(pubsubLimits_t *limits, uint32_t topicHash, const char *name, uint16_t nameLen, uint32_t bytes, uint32_t nowMs);
+bool pubsubLimitsRx(pubsubLimits_t *limits, uint64_t nodeId, uint32_t topicHash, const char *name, uint16_t nameLen, uint32_t bytes, uint32_t nowMs);
+bool pubsubLimitsAdmit(pubsubPrio_e prio, uint32_t spaces, uint32_t queueLen);
+
+#ifdef __cplusplus
+}
+#endif
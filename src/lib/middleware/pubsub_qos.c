@@ -0,0 +1,251 @@
+#include <string.h>
+#include "FreeRTOS.h"
+#include "pubsub_qos.h"
+
+/*!
+  Check whether a deadline has passed (handles ms counter wrap)
+
+  \param[in] nowMs - current time
+  \param[in] deadlineMs - deadline
+  \return true if deadline is now or in the past
+*/
+static inline bool deadlinePassed(uint32_t nowMs, uint32_t deadlineMs) {
+  return (int32_t)(nowMs - deadlineMs) >= 0;
+}
+
+/*!
+  Initialize the publisher side
+
+  \param[in] *tx - publisher state
+  \param[in] firstSeq - first sequence number to use. Should differ across
+                        reboots so subscribers don't take new messages for
+                        ones they've already seen.
+  \param[in] initialTimeoutMs - time to wait for an ack before the first retransmission
+  \param[in] maxTimeoutMs - limit for the (doubling) time between retransmissions
+  \param[in] maxRetries - retransmissions before giving up
+  \return none
+*/
+void pubsubQosTxInit(pubsubQosTx_t *tx, uint16_t firstSeq, uint32_t initialTimeoutMs, uint32_t maxTimeoutMs, uint8_t maxRetries) {
+  configASSERT(tx);
+  configASSERT(initialTimeoutMs);
+  configASSERT(maxTimeoutMs >= initialTimeoutMs);
+
+  memset(tx, 0, sizeof(*tx));
+  tx->nextSeq = firstSeq;
+  tx->initialTimeoutMs = initialTimeoutMs;
+  tx->maxTimeoutMs = maxTimeoutMs;
+  tx->maxRetries = maxRetries;
+}
+
+/*!
+  Add a message to the retransmission window. The caller sends it.
+
+  A message can't be more than PUBSUB_QOS_RX_HISTORY sequence numbers ahead
+  of the oldest one still waiting for an ack, so subscribers can always tell
+  a retransmission from a restarted publisher.
+
+  \param[in] *tx - publisher state
+  \param[in] *msg - caller's message (handed back by ack/poll callbacks)
+  \param[in] nowMs - current time
+  \param[out] *seq - sequence number assigned to the message
+  \return true if added, false if the window is full
+*/
+bool pubsubQosTxAdd(pubsubQosTx_t *tx, void *msg, uint32_t nowMs, uint16_t *seq) {
+  configASSERT(tx);
+  configASSERT(msg);
+  configASSERT(seq);
+
+  pubsubQosTxSlot_t *freeSlot = NULL;
+  bool spanOk = true;
+  for(uint32_t idx = 0; idx < PUBSUB_QOS_TX_WINDOW; idx++) {
+    pubsubQosTxSlot_t *slot = &tx->slots[idx];
+    if(!slot->msg) {
+      if(!freeSlot) {
+        freeSlot = slot;
+      }
+    } else if((uint16_t)(tx->nextSeq - slot->seq) >= PUBSUB_QOS_RX_HISTORY) {
+      spanOk = false;
+    }
+  }
+
+  if(!freeSlot || !spanOk) {
+    return false;
+  }
+
+  freeSlot->msg = msg;
+  freeSlot->seq = tx->nextSeq++;
+  freeSlot->retries = 0;
+  freeSlot->timeoutMs = tx->initialTimeoutMs;
+  freeSlot->deadlineMs = nowMs + tx->initialTimeoutMs;
+
+  *seq = freeSlot->seq;
+  return true;
+}
+
+/*!
+  Handle an ack
+
+  \param[in] *tx - publisher state
+  \param[in] seq - acked sequence number
+  \return caller's message (now out of the window), NULL if it wasn't in
+          flight (duplicate or late ack)
+*/
+void *pubsubQosTxAck(pubsubQosTx_t *tx, uint16_t seq) {
+  configASSERT(tx);
+
+  void *msg = NULL;
+  for(uint32_t idx = 0; idx < PUBSUB_QOS_TX_WINDOW; idx++) {
+    pubsubQosTxSlot_t *slot = &tx->slots[idx];
+    if(slot->msg && (slot->seq == seq)) {
+      msg = slot->msg;
+      slot->msg = NULL;
+      break;
+    }
+  }
+
+  return msg;
+}
+
+/*!
+  Retransmit or give up on messages whose ack timed out
+
+  \param[in] *tx - publisher state
+  \param[in] nowMs - current time
+  \param[in] retransmit - called for each message to send again
+  \param[in] giveUp - called for each message dropped from the window
+  \param[in] *arg - passed to the callbacks
+  \return ms until the next deadline, PUBSUB_QOS_NO_TIMEOUT if nothing is in flight
+*/
+uint32_t pubsubQosTxPoll(pubsubQosTx_t *tx, uint32_t nowMs, pubsubQosTxCb_t retransmit, pubsubQosTxCb_t giveUp, void *arg) {
+  configASSERT(tx);
+  configASSERT(retransmit);
+  configASSERT(giveUp);
+
+  uint32_t nextMs = PUBSUB_QOS_NO_TIMEOUT;
+  for(uint32_t idx = 0; idx < PUBSUB_QOS_TX_WINDOW; idx++) {
+    pubsubQosTxSlot_t *slot = &tx->slots[idx];
+    if(!slot->msg) {
+      continue;
+    }
+
+    if(deadlinePassed(nowMs, slot->deadlineMs)) {
+      if(slot->retries >= tx->maxRetries) {
+        void *msg = slot->msg;
+        slot->msg = NULL;
+        giveUp(msg, slot->seq, arg);
+        continue;
+      }
+
+      slot->retries++;
+      slot->timeoutMs = (slot->timeoutMs > tx->maxTimeoutMs / 2) ? tx->maxTimeoutMs : slot->timeoutMs * 2;
+      slot->deadlineMs = nowMs + slot->timeoutMs;
+      retransmit(slot->msg, slot->seq, arg);
+    }
+
+    uint32_t remainingMs = slot->deadlineMs - nowMs;
+    if(remainingMs < nextMs) {
+      nextMs = remainingMs;
+    }
+  }
+
+  return nextMs;
+}
+
+/*!
+  Number of messages waiting for an ack
+
+  \param[in] *tx - publisher state
+  \return messages in flight
+*/
+uint8_t pubsubQosTxInFlight(const pubsubQosTx_t *tx) {
+  configASSERT(tx);
+
+  uint8_t inFlight = 0;
+  for(uint32_t idx = 0; idx < PUBSUB_QOS_TX_WINDOW; idx++) {
+    if(tx->slots[idx].msg) {
+      inFlight++;
+    }
+  }
+
+  return inFlight;
+}
+
+/*!
+  Initialize the subscriber side
+
+  \param[in] *rx - subscriber state
+  \return none
+*/
+void pubsubQosRxInit(pubsubQosRx_t *rx) {
+  configASSERT(rx);
+  memset(rx, 0, sizeof(*rx));
+}
+
+/*!
+  Find a publisher, or make room for it (replacing the one heard from least
+  recently)
+
+  \param[in] *rx - subscriber state
+  \param[in] nodeId - publisher node id
+  \param[in] nowMs - current time
+  \param[out] *isNew - true if the publisher wasn't being tracked
+  \return publisher entry
+*/
+static pubsubQosRxPeer_t *findPeer(pubsubQosRx_t *rx, uint64_t nodeId, uint32_t nowMs, bool *isNew) {
+  pubsubQosRxPeer_t *oldest = NULL;
+  for(uint32_t idx = 0; idx < PUBSUB_QOS_RX_PUBLISHERS; idx++) {
+    pubsubQosRxPeer_t *peer = &rx->peers[idx];
+    if(peer->valid && (peer->nodeId == nodeId)) {
+      *isNew = false;
+      return peer;
+    }
+
+    if(!oldest || (oldest->valid && (!peer->valid || ((nowMs - peer->lastSeenMs) > (nowMs - oldest->lastSeenMs))))) {
+      oldest = peer;
+    }
+  }
+
+  *isNew = true;
+  return oldest;
+}
+
+/*!
+  Check a received reliable message against what we've already delivered
+
+  \param[in] *rx - subscriber state
+  \param[in] nodeId - publisher node id
+  \param[in] seq - message sequence number
+  \param[in] nowMs - current time
+  \return true if the message is new and should be delivered, false if it's a
+          duplicate (it should still be acked)
+*/
+bool pubsubQosRxAccept(pubsubQosRx_t *rx, uint64_t nodeId, uint16_t seq, uint32_t nowMs) {
+  configASSERT(rx);
+
+  bool isNew;
+  pubsubQosRxPeer_t *peer = findPeer(rx, nodeId, nowMs, &isNew);
+  peer->lastSeenMs = nowMs;
+
+  int16_t diff = (int16_t)(seq - peer->lastSeq);
+  bool accept = true;
+  if(isNew || (diff <= -PUBSUB_QOS_RX_HISTORY)) {
+    // First message from this publisher, or it's further back than any
+    // retransmission can be (the publisher restarted)
+    peer->nodeId = nodeId;
+    peer->valid = true;
+    peer->lastSeq = seq;
+    peer->history = 1;
+  } else if(diff > 0) {
+    peer->history = (diff >= PUBSUB_QOS_RX_HISTORY) ? 1 : ((peer->history << diff) | 1);
+    peer->lastSeq = seq;
+  } else {
+    uint32_t bit = 1UL << (uint32_t)(-diff);
+    if(peer->history & bit) {
+      accept = false;
+    } else {
+      peer->history |= bit;
+    }
+  }
+
+  return accept;
+}
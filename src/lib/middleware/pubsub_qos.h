@@ -0,0 +1,76 @@
+#pragma once
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+//
+// Bookkeeping for acknowledged (QoS 1) publishing
+//
+// Publisher side: every reliable message gets the next sequence number from
+// the node's counter and sits in a small retransmission window until a
+// subscriber acks it. Unacked messages are sent again with exponential
+// backoff, and dropped (give up) after maxRetries retransmissions.
+//
+// Subscriber side: remembers the last PUBSUB_QOS_RX_HISTORY sequence numbers
+// from the most recently heard publishers so retransmissions of messages we
+// already delivered are acked again but not delivered twice.
+//
+// No locking or timers in here; the caller serializes access and provides the
+// time.
+//
+
+#define PUBSUB_QOS_TX_WINDOW      (8)
+#define PUBSUB_QOS_RX_PUBLISHERS  (8)
+#define PUBSUB_QOS_RX_HISTORY     (32)
+#define PUBSUB_QOS_NO_TIMEOUT     (UINT32_MAX)
+
+typedef struct {
+  // Caller's message (NULL when the slot is free)
+  void *msg;
+  uint16_t seq;
+  uint8_t retries;
+  uint32_t timeoutMs;
+  uint32_t deadlineMs;
+} pubsubQosTxSlot_t;
+
+typedef struct {
+  pubsubQosTxSlot_t slots[PUBSUB_QOS_TX_WINDOW];
+  uint16_t nextSeq;
+  uint32_t initialTimeoutMs;
+  uint32_t maxTimeoutMs;
+  uint8_t maxRetries;
+} pubsubQosTx_t;
+
+typedef struct {
+  uint64_t nodeId;
+  // Newest sequence number seen
+  uint16_t lastSeq;
+  // Bit n set when (lastSeq - n) has been seen
+  uint32_t history;
+  uint32_t lastSeenMs;
+  bool valid;
+} pubsubQosRxPeer_t;
+
+typedef struct {
+  pubsubQosRxPeer_t peers[PUBSUB_QOS_RX_PUBLISHERS];
+} pubsubQosRx_t;
+
+// Called with the caller's message and its sequence number
+typedef void (*pubsubQosTxCb_t)(void *msg, uint16_t seq, void *arg);
+
+void pubsubQosTxInit(pubsubQosTx_t *tx, uint16_t firstSeq, uint32_t initialTimeoutMs, uint32_t maxTimeoutMs, uint8_t maxRetries);
+bool pubsubQosTxAdd(pubsubQosTx_t *tx, void *msg, uint32_t nowMs, uint16_t *seq);
+void *pubsubQosTxAck(pubsubQosTx_t *tx, uint16_t seq);
+uint32_t pubsubQosTxPoll(pubsubQosTx_t *tx, uint32_t nowMs, pubsubQosTxCb_t retransmit, pubsubQosTxCb_t giveUp, void *arg);
+uint8_t pubsubQosTxInFlight(const pubsubQosTx_t *tx);
+
+void pubsubQosRxInit(pubsubQosRx_t *rx);
+bool pubsubQosRxAccept(pubsubQosRx_t *rx, uint64_t nodeId, uint16_t seq, uint32_t nowMs);
+
+#ifdef __cplusplus
+}
+#endif
@@ -0,0 +1,143 @@
+#include <string.h>
+#include "FreeRTOS.h"
+#include "fnv.h"
+#include "pubsub_routes.h"
+
+/*!
+  Check whether an entry's time is up (handles ms counter wrap)
+
+  \param[in] nowMs - current time
+  \param[in] expiresMs - expiration time
+  \return true if expired
+*/
+static inline bool expired(uint32_t nowMs, uint32_t expiresMs) {
+  return (int32_t)(nowMs - expiresMs) >= 0;
+}
+
+/*!
+  Hash a topic string (32 bit FNV-1a)
+
+  \param[in] *topic - topic string
+  \param[in] topicLen - topic length
+  \return topic hash
+*/
+uint32_t pubsubRoutesHash(const char *topic, uint16_t topicLen) {
+  configASSERT(topic || !topicLen);
+
+  return fnv_32a_buf((void *)topic, topicLen, FNV1_32A_INIT);
+}
+
+/*!
+  Initialize route table
+
+  \param[in] *routes - route table
+  \param[in] ttlMs - how long a subscription is remembered without being announced again
+  \return none
+*/
+void pubsubRoutesInit(pubsubRoutes_t *routes, uint32_t ttlMs) {
+  configASSERT(routes);
+  configASSERT(ttlMs);
+
+  memset(routes, 0, sizeof(*routes));
+  routes->ttlMs = ttlMs;
+}
+
+/*!
+  Forget a node's subscriptions (before adding the ones it just announced)
+
+  \param[in] *routes - route table
+  \param[in] nodeId - subscriber node
+  \return none
+*/
+void pubsubRoutesClearNode(pubsubRoutes_t *routes, uint64_t nodeId) {
+  configASSERT(routes);
+
+  for(uint32_t idx = 0; idx < PUBSUB_ROUTES_MAX_ENTRIES; idx++) {
+    if(routes->entries[idx].valid && (routes->entries[idx].nodeId == nodeId)) {
+      routes->entries[idx].valid = false;
+    }
+  }
+}
+
+/*!
+  Add (or refresh) a subscription
+
+  \param[in] *routes - route table
+  \param[in] nodeId - subscriber node
+  \param[in] topicHash - topic hash (see pubsubRoutesHash)
+  \param[in] nowMs - current time
+  \return true if added, false if the table is full (subscriber sets are
+          unknown until the subscription would have expired)
+*/
+bool pubsubRoutesAdd(pubsubRoutes_t *routes, uint64_t nodeId, uint32_t topicHash, uint32_t nowMs) {
+  configASSERT(routes);
+
+  if(routes->overflow && expired(nowMs, routes->overflowUntilMs)) {
+    routes->overflow = false;
+  }
+
+  pubsubRoute_t *freeEntry = NULL;
+  for(uint32_t idx = 0; idx < PUBSUB_ROUTES_MAX_ENTRIES; idx++) {
+    pubsubRoute_t *entry = &routes->entries[idx];
+    if(entry->valid && expired(nowMs, entry->expiresMs)) {
+      entry->valid = false;
+    }
+
+    if(entry->valid) {
+      if((entry->nodeId == nodeId) && (entry->topicHash == topicHash)) {
+        entry->expiresMs = nowMs + routes->ttlMs;
+        return true;
+      }
+    } else if(!freeEntry) {
+      freeEntry = entry;
+    }
+  }
+
+  if(!freeEntry) {
+    routes->overflow = true;
+    routes->overflowUntilMs = nowMs + routes->ttlMs;
+    return false;
+  }
+
+  freeEntry->nodeId = nodeId;
+  freeEntry->topicHash = topicHash;
+  freeEntry->expiresMs = nowMs + routes->ttlMs;
+  freeEntry->valid = true;
+
+  return true;
+}
+
+/*!
+  Find the nodes that subscribe to a topic
+
+  \param[in] *routes - route table
+  \param[in] topicHash - topic hash (see pubsubRoutesHash)
+  \param[in] nowMs - current time
+  \param[out] *nodeIds - subscriber nodes
+  \param[in] maxNodes - size of nodeIds
+  \return number of known subscribers, -1 if there are more than maxNodes or
+          the table overflowed recently (so the set might be incomplete)
+*/
+int32_t pubsubRoutesLookup(const pubsubRoutes_t *routes, uint32_t topicHash, uint32_t nowMs, uint64_t *nodeIds, uint8_t maxNodes) {
+  configASSERT(routes);
+  configASSERT(nodeIds || !maxNodes);
+
+  if(routes->overflow && !expired(nowMs, routes->overflowUntilMs)) {
+    return -1;
+  }
+
+  int32_t numNodes = 0;
+  for(uint32_t idx = 0; idx < PUBSUB_ROUTES_MAX_ENTRIES; idx++) {
+    const pubsubRoute_t *entry = &routes->entries[idx];
+    if(!entry->valid || (entry->topicHash != topicHash) || expired(nowMs, entry->expiresMs)) {
+      continue;
+    }
+
+    if(numNodes == maxNodes) {
+      return -1;
+    }
+    nodeIds[numNodes++] = entry->nodeId;
+  }
+
+  return numNodes;
+}
@@ -0,0 +1,47 @@
+#pragma once
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+//
+// Which nodes subscribe to which topics, learned from their resource table
+// announcements
+//
+// Topics are stored as 32 bit hashes to keep the table small. A collision can
+// only add a destination that doesn't need the data, never lose one. Entries
+// expire if the node stops announcing them. If the table runs out of room,
+// lookups report the subscriber set as unknown until the missing entries
+// would have expired, so callers fall back to multicast.
+//
+// No locking in here; the caller serializes access and provides the time.
+//
+
+#define PUBSUB_ROUTES_MAX_ENTRIES (32)
+
+typedef struct {
+  uint64_t nodeId;
+  uint32_t topicHash;
+  uint32_t expiresMs;
+  bool valid;
+} pubsubRoute_t;
+
+typedef struct {
+  pubsubRoute_t entries[PUBSUB_ROUTES_MAX_ENTRIES];
+  uint32_t ttlMs;
+  bool overflow;
+  uint32_t overflowUntilMs;
+} pubsubRoutes_t;
+
+uint32_t pubsubRoutesHash(const char *topic, uint16_t topicLen);
+void pubsubRoutesInit(pubsubRoutes_t *routes, uint32_t ttlMs);
+void pubsubRoutesClearNode(pubsubRoutes_t *routes, uint64_t nodeId);
+bool pubsubRoutesAdd(pubsubRoutes_t *routes, uint64_t nodeId, uint32_t topicHash, uint32_t nowMs);
+int32_t pubsubRoutesLookup(const pubsubRoutes_t *routes, uint32_t topicHash, uint32_t nowMs, uint64_t *nodeIds, uint8_t maxNodes);
+
+#ifdef __cplusplus
+}
+#endif
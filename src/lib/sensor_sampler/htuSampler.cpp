@@ -54,7 +54,8 @@ static sensor_t htuSensor = {
   .intervalMs = 1000,
   .initFn = htuInit,
   .sampleFn = htuSample,
-  .checkFn = NULL
+  .checkFn = NULL,
+  .stepFn = NULL
 };
 
 void htuSamplerInit(HTU21D *sensor) {
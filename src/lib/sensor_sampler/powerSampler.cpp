@@ -8,6 +8,7 @@
 #include "ina232.h"
 #include "sensors.h"
 #include "sensorSampler.h"
+#include "util.h"
 #include <stdbool.h>
 #include <stdint.h>
 
@@ -17,42 +18,88 @@ static INA232** _inaSensors;
 
 #define INA_STR_LEN 80
 
+/// Milliseconds between conversion ready flag checks
+#define POWER_POLL_PERIOD_MS (50)
+
+/// Devices still waiting for a conversion (one bit per device)
+static uint32_t _powerPending;
+static TickType_t _powerStartTicks;
+
 /*
-  sensorSampler function to take power sample(s)
+  Read and publish a power sample from a device that has a conversion ready
 
   \return true if successful false otherwise
 */
-static bool powerSample() {
+static bool powerPublish(INA232 *sensor) {
   float voltage, current;
   bool success = false;
-  bool rval = true;
   uint8_t retriesRemaining = SENSORS_NUM_RETRIES;
   const char powerTopic[] = "power";
+
+  do {
+    success = sensor->readPower();
+  } while(!success && (--retriesRemaining > 0));
+
+  if(success) {
+    sensor->getPower(voltage, current);
+
+    struct {
+      uint16_t address;
+      float voltage;
+      float current;
+    } __attribute__((packed)) _powerData;
+
+    _powerData.address = sensor->getAddr();
+    _powerData.voltage = voltage;
+    _powerData.current = current;
+
+    bm_pub(powerTopic, &_powerData, sizeof(_powerData));
+  }
+
+  return success;
+}
+
+/*
+  sensorSampler asynchronous function to take power sample(s). Polls the
+  conversion ready flag on all devices and publishes each one as soon as
+  its conversion is done, instead of waiting on them one at a time.
+
+  \return delay until next step in ms, or SENSOR_STEP_DONE
+*/
+static uint32_t powerStep() {
+  uint32_t timeoutMs = 0;
+
+  if(!_powerPending) {
+    // New sample
+    _powerPending = (1UL << NUM_INA232_DEV) - 1;
+    _powerStartTicks = xTaskGetTickCount();
+  }
+
   for (uint8_t dev_num = 0; dev_num < NUM_INA232_DEV; dev_num++){
-    do {
-      success = _inaSensors[dev_num]->measurePower();
-      if (success) {
-        _inaSensors[dev_num]->getPower(voltage, current);
-      }
-    } while( !success && (--retriesRemaining > 0));
-
-    if(success) {
-
-      struct {
-        uint16_t address;
-        float voltage;
-        float current;
-      } __attribute__((packed)) _powerData;
-
-      _powerData.address = _inaSensors[dev_num]->getAddr();
-      _powerData.voltage = voltage;
-      _powerData.current = current;
-
-      bm_pub(powerTopic, &_powerData, sizeof(_powerData));
+    if(!(_powerPending & (1UL << dev_num))) {
+      continue;
+    }
+
+    bool ready = false;
+    if(_inaSensors[dev_num]->conversionReady(ready) && ready) {
+      powerPublish(_inaSensors[dev_num]);
+      _powerPending &= ~(1UL << dev_num);
+    } else {
+      timeoutMs = MAX(timeoutMs, _inaSensors[dev_num]->getTotalConversionTimeMs());
     }
-    rval &= success;
   }
-  return rval;
+
+  if(!_powerPending) {
+    return SENSOR_STEP_DONE;
+  }
+
+  if(!timeRemainingTicks(_powerStartTicks, pdMS_TO_TICKS(timeoutMs))) {
+    printf("Timed out waiting for ready flag!\n");
+    _powerPending = 0;
+    return SENSOR_STEP_DONE;
+  }
+
+  return POWER_POLL_PERIOD_MS;
 }
 
 /*
@@ -80,8 +127,9 @@ static bool powerInit() {
 static sensor_t powerSensors = {
   .intervalMs = 1000,
   .initFn = powerInit,
-  .sampleFn = powerSample,
-  .checkFn = NULL
+  .sampleFn = NULL,
+  .checkFn = NULL,
+  .stepFn = powerStep
 };
 
 void powerSamplerInit(INA::INA232 **sensors) {
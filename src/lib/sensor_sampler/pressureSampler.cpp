@@ -13,26 +13,71 @@
 
 static MS5803* _pressureSensor;
 
+typedef enum {
+  BARO_START,
+  BARO_TEMPERATURE,
+  BARO_PRESSURE,
+} baroState_t;
+
+static baroState_t _baroState = BARO_START;
+static uint8_t _baroRetriesRemaining;
+static uint32_t _rawTemperature;
+
 /*
-  sensorSampler function to take barometer sample
+  sensorSampler asynchronous function to take barometer sample. Starts the
+  temperature conversion, then the pressure conversion, then computes and
+  publishes the result, without blocking during the conversions.
 
-  \return true if successful false otherwise
+  \return delay until next step in ms, or SENSOR_STEP_DONE
 */
-static bool baroSample() {
-  float temperature, pressure;
-  bool success = false;
-  uint8_t retriesRemaining = SENSORS_NUM_RETRIES;
+static uint32_t baroStep() {
   const char baroTopic[] = "pressure";
 
+  if(_baroState == BARO_START) {
+    _baroRetriesRemaining = SENSORS_NUM_RETRIES;
+  }
+
   do {
-    success = _pressureSensor->readPTRaw(pressure, temperature);
-  } while(!success && (--retriesRemaining > 0));
+    float temperature, pressure;
+    uint32_t rawPressure = 0;
+    baroState_t nextState = BARO_START;
+    bool success = false;
 
-  if(success) {
-    bm_pub(baroTopic, &pressure, sizeof(float));
-  }
+    switch(_baroState) {
+      case BARO_START: {
+        success = _pressureSensor->startConversion(CMD_CONV_D2_4096);
+        nextState = BARO_TEMPERATURE;
+        break;
+      }
+      case BARO_TEMPERATURE: {
+        success = _pressureSensor->readConversion(&_rawTemperature) &&
+                  _pressureSensor->startConversion(CMD_CONV_D1_4096);
+        nextState = BARO_PRESSURE;
+        break;
+      }
+      case BARO_PRESSURE: {
+        success = _pressureSensor->readConversion(&rawPressure) &&
+                  _pressureSensor->compensate(rawPressure, _rawTemperature, pressure, temperature);
+        if(success) {
+          bm_pub(baroTopic, &pressure, sizeof(float));
+        }
+        nextState = BARO_START;
+        break;
+      }
+      default:
+        configASSERT(0);
+    }
+
+    if(success) {
+      _baroState = nextState;
+      return (_baroState == BARO_START) ? SENSOR_STEP_DONE : MS5803_CONVERSION_TIME_MS;
+    }
+
+    // Start over
+    _baroState = BARO_START;
+  } while(--_baroRetriesRemaining > 0);
 
-  return success;
+  return SENSOR_STEP_DONE;
 }
 
 /*
@@ -56,8 +101,9 @@ static bool baroCheck() {
 static sensor_t pressureSensor = {
   .intervalMs = 1000,
   .initFn = baroInit,
-  .sampleFn = baroSample,
-  .checkFn = baroCheck
+  .sampleFn = NULL,
+  .checkFn = baroCheck,
+  .stepFn = baroStep
 };
 
 
@@ -1,48 +1,186 @@
+//
+// Sensor sampler
+//
+// All sensors are sampled from a single task. Sample times are kept in a
+// hashed timing wheel and every sensor is sampled on multiples of its
+// period, so sensors with the same (or harmonic) periods are sampled at
+// the same instant and the task only wakes up once for all of them. With
+// tickless idle, fewer distinct wakeups means longer sleeps (and I2C bus
+// activity gets batched together).
+//
+// Sensors can also allow a small jitter budget, which lets them be sampled
+// a bit early to share a wakeup with another sensor.
+//
+#include <inttypes.h>
 #include <stdint.h>
 #include <string.h>
 #include "FreeRTOS.h"
 #include "debug.h"
+#include "semphr.h"
 #include "sensorSampler.h"
 #include "task.h"
 #include "task_priorities.h"
-#include "timers.h"
-
-// Flags not used for sensors
-#define SENSOR_CHECK_SAMPLE_FLAG (1 << 30)
-#define RESERVED_FLAG (1 << 31)
-
-// We're using a 32-bit variable for sample flags (with two reserved)
-#define MAX_SENSORS 30
+#include "timing_wheel.h"
+#include "uptime.h"
 
 // Used to keep strncmp bounded, just in case
 #define MAX_NAME_LEN 255
 
-typedef struct{
+/// Ticks per timing wheel slot (64 slots covers ~1s)
+#define SENSOR_WHEEL_RESOLUTION pdMS_TO_TICKS(16)
+
+typedef struct sensorListItem {
   /// Pointer to actual sensor struct
   sensor_t *sensor;
 
   /// Sensor name/identifier
   const char *name;
 
-  /// Sampling timer
-  TimerHandle_t timer;
+  /// Next sensor in list
+  struct sensorListItem *next;
+
+  /// Sampling schedule
+  timingWheelEntry_t entry;
+  TickType_t periodTicks;
+
+  /// Sensor was initialized and is sampled periodically
+  bool initialized;
+
+  /// Sampling is currently enabled
+  bool enabled;
+
+  /// Next sensor to sample during this wakeup
+  struct sensorListItem *sampleNext;
+
+  /// Asynchronous sample in progress (stepFn sensors only)
+  bool stepPending;
 
-  /// Flag (single bit) used for task notification
-  uint32_t flag;
+  /// When the next step is due
+  TickType_t stepTime;
+
+  /// Time the current/last sample was started
+  uint64_t sampleTimeUs;
+
+  /// Number of samples skipped because the previous one was still in progress
+  uint32_t overruns;
+
+  /// Number of sample times missed because the task was late
+  uint32_t missed;
 } sensorListItem_t;
 
-// TODO - use linked list instead of pre-allocating
-static sensorListItem_t *sensorList[MAX_SENSORS];
-static uint8_t numSensors = 0;
+static sensorListItem_t *sensorList;
+static sensorListItem_t *sensorListTail;
 
 static TaskHandle_t sensorSampleTaskHandle;
 
 static sensorConfig_t *_config;
 
-static TimerHandle_t sensorCheckTimer;
+// Protects the timing wheel and the sensor list
+static SemaphoreHandle_t sensorLock;
+static timingWheel_t sensorWheel;
+
+// Sensor checks are scheduled on the same wheel
+static timingWheelEntry_t checkEntry;
+static TickType_t checkPeriodTicks;
+static bool checksEnabled;
+
+// Sensor currently being sampled (for sensorSamplerGetSampleTimeUs)
+static sensorListItem_t *currentItem;
 
 static void sensorSampleTask( void *parameters );
 
+/*!
+  Create the lock and timing wheel (sensors can be added before the
+  sampler is initialized)
+*/
+static void sensorLockInit() {
+  if(sensorLock == NULL) {
+    sensorLock = xSemaphoreCreateMutex();
+    configASSERT(sensorLock != NULL);
+    timingWheelInit(&sensorWheel, SENSOR_WHEEL_RESOLUTION, xTaskGetTickCount());
+  }
+}
+
+static void sensorLockTake() {
+  configASSERT(xSemaphoreTake(sensorLock, portMAX_DELAY) == pdTRUE);
+}
+
+static void sensorLockGive() {
+  xSemaphoreGive(sensorLock);
+}
+
+/*!
+  Wake up the sampler task so it recomputes its next wakeup
+*/
+static void sensorWakeTask() {
+  if(sensorSampleTaskHandle != NULL) {
+    xTaskNotify(sensorSampleTaskHandle, 0, eNoAction);
+  }
+}
+
+/*!
+  Schedule the next sample of a periodic entry. Keeps the entry aligned to
+  multiples of its period, skipping sample times that were missed.
+
+  NOTE: sensorLock must be held
+
+  \param[in] *entry - wheel entry
+  \param[in] periodTicks - sample period
+  \param[in] now - current tick count
+  \return true if any sample times were missed
+*/
+static bool sensorScheduleNext(timingWheelEntry_t *entry, TickType_t periodTicks, TickType_t now) {
+  bool missed = false;
+  uint32_t due = entry->due + periodTicks;
+
+  if((int32_t)(due - now) <= 0) {
+    due = timingWheelAlign(now, periodTicks);
+    missed = true;
+  }
+
+  timingWheelInsert(&sensorWheel, entry, due);
+
+  return missed;
+}
+
+/*!
+  Start or stop periodic sampling of a sensor
+
+  \param[in] *sensorItem - sensor to start/stop
+  \param[in] enable - true to start, false to stop
+  \return none
+*/
+static void sensorSetEnabled(sensorListItem_t *sensorItem, bool enable) {
+  sensorLockTake();
+  if(enable) {
+    sensorItem->entry.jitter = pdMS_TO_TICKS(sensorItem->sensor->jitterMs);
+    timingWheelInsert(&sensorWheel, &sensorItem->entry,
+                      timingWheelAlign(xTaskGetTickCount(), sensorItem->periodTicks));
+  } else {
+    timingWheelRemove(&sensorWheel, &sensorItem->entry);
+  }
+  sensorItem->enabled = enable;
+  sensorLockGive();
+
+  sensorWakeTask();
+}
+
+/*!
+  Find sensor by name
+
+  \param[in] name - string identifier
+  \return sensor list item, NULL if not found
+*/
+static sensorListItem_t *sensorFind(const char *name) {
+  for(sensorListItem_t *sensorItem = sensorList; sensorItem != NULL; sensorItem = sensorItem->next) {
+    if(strncmp(sensorItem->name, name, MAX_NAME_LEN) == 0) {
+      return sensorItem;
+    }
+  }
+
+  return NULL;
+}
+
 /*!
   Run the checkFn() on all sensors who have one. If the check fails,
   disable the sensor until the next check (and log the error).
@@ -55,21 +193,24 @@ void checkSensors() {
   // printf("Running sensor checks.\n");
 
   // Check all sensors to see if they are due for a sample update
-  for(uint32_t sensorIdx = 0; sensorIdx < numSensors; sensorIdx++) {
-    sensorListItem_t *sensorItem = sensorList[sensorIdx];
+  for(sensorListItem_t *sensorItem = sensorList; sensorItem != NULL; sensorItem = sensorItem->next) {
+    // Don't interrupt an asynchronous sample, it will be checked next time
+    if(sensorItem->stepPending) {
+      continue;
+    }
 
     // Only check if it was previously enabled (and if there's a check function!)
-    if((sensorItem->timer != NULL) && (sensorItem->sensor->checkFn != NULL)) {
+    if(sensorItem->initialized && (sensorItem->sensor->checkFn != NULL)) {
       if(sensorItem->sensor->checkFn()) {
-        // If the timer had been previously disabled, try to reinitialize
+        // If sampling had been previously disabled, try to reinitialize
         // and start again
-        if (!xTimerIsTimerActive(sensorItem->timer) && sensorItem->sensor->initFn()) {
-          xTimerStart(sensorItem->timer, 10);
+        if (!sensorItem->enabled && sensorItem->sensor->initFn()) {
+          sensorSetEnabled(sensorItem, true);
           // logPrint(SYSLog, LOG_LEVEL_INFO, "%s Re-enabled\n", sensorItem->name);
           printf("%s Re-enabled\n", sensorItem->name);
         }
-      } else if(xTimerIsTimerActive(sensorItem->timer)) {
-        xTimerStop(sensorItem->timer, 10);
+      } else if(sensorItem->enabled) {
+        sensorSetEnabled(sensorItem, false);
         // logPrint(SYSLog, LOG_LEVEL_ERROR, "%s Check Failed - Disabling\n", sensorItem->name);
         printf("%s Check Failed - Disabling\n", sensorItem->name);
       }
@@ -88,6 +229,8 @@ void sensorSamplerInit(sensorConfig_t *config) {
 
   _config = config;
 
+  sensorLockInit();
+
 	BaseType_t rval = xTaskCreate(
     sensorSampleTask,
     "sensorSample",
@@ -99,10 +242,6 @@ void sensorSamplerInit(sensorConfig_t *config) {
   configASSERT(rval == pdTRUE);
 }
 
-static void sensorTimerCallback(TimerHandle_t timer) {
-  xTaskNotify(sensorSampleTaskHandle, (uint32_t)pvTimerGetTimerID(timer), eSetBits);
-}
-
 /*!
   Add a new sensor for periodic sampling
 
@@ -112,39 +251,41 @@ static void sensorTimerCallback(TimerHandle_t timer) {
 */
 bool sensorSamplerAdd(sensor_t *sensor, const char *name) {
   configASSERT(sensor != NULL);
-  configASSERT(numSensors < MAX_SENSORS);
   configASSERT(name != NULL);
 
   // Make sure the required functions are present
   configASSERT(sensor->initFn != NULL);
-  configASSERT(sensor->sampleFn != NULL);
+  configASSERT((sensor->sampleFn != NULL) || (sensor->stepFn != NULL));
   // checkFn is optional
 
-  sensorList[numSensors] = static_cast<sensorListItem_t *>(pvPortMalloc(sizeof(sensorListItem_t)));
-  configASSERT(sensorList[numSensors] != NULL);
+  sensorLockInit();
+
+  sensorListItem_t *sensorItem = static_cast<sensorListItem_t *>(pvPortMalloc(sizeof(sensorListItem_t)));
+  configASSERT(sensorItem != NULL);
 
-  memset(sensorList[numSensors], 0, sizeof(sensorListItem_t));
+  memset(sensorItem, 0, sizeof(sensorListItem_t));
 
-  sensorListItem_t *sensorItem = sensorList[numSensors];
   sensorItem->sensor = sensor;
   sensorItem->name = name;
-  sensorItem->flag = (1 << numSensors);
-  numSensors++;
+  sensorItem->entry.context = sensorItem;
+  sensorItem->periodTicks = pdMS_TO_TICKS(sensor->intervalMs);
+
+  sensorLockTake();
+  if(sensorListTail == NULL) {
+    sensorList = sensorItem;
+  } else {
+    sensorListTail->next = sensorItem;
+  }
+  sensorListTail = sensorItem;
+  sensorLockGive();
 
   // Initialize sensor if needed
-  if (sensorItem->sensor->intervalMs > 0){
+  if (sensorItem->periodTicks > 0){
     if(sensorItem->sensor->initFn()) {
-      sensorItem->timer = xTimerCreate(
-        name,
-        pdMS_TO_TICKS(sensorItem->sensor->intervalMs),
-        pdTRUE, // Enable auto-reload
-        reinterpret_cast<void *>(sensorItem->flag),
-        sensorTimerCallback
-      );
-      configASSERT(sensorItem->timer != NULL);
-
-      // Start sample timer
-      configASSERT(xTimerStart(sensorItem->timer, 10));
+      sensorItem->initialized = true;
+
+      // Start sampling
+      sensorSetEnabled(sensorItem, true);
     } else {
       // logPrint(SYSLog, LOG_LEVEL_INFO, "Error initializing %s\n", name);
       printf("Error initializing %s\n", name);
@@ -166,14 +307,12 @@ bool sensorSamplerAdd(sensor_t *sensor, const char *name) {
 bool sensorSamplerDisable(const char *name) {
   bool rval = false;
 
-  for(uint32_t sensorIdx = 0; sensorIdx < numSensors; sensorIdx++) {
-    if(strncmp(sensorList[sensorIdx]->name, name, MAX_NAME_LEN) == 0) {
-      if(sensorList[sensorIdx]->timer && xTimerIsTimerActive(sensorList[sensorIdx]->timer)) {
-        configASSERT(xTimerStop(sensorList[sensorIdx]->timer, 10));
-      }
-      rval = true;
-      break;
+  sensorListItem_t *sensorItem = sensorFind(name);
+  if(sensorItem != NULL) {
+    if(sensorItem->enabled) {
+      sensorSetEnabled(sensorItem, false);
     }
+    rval = true;
   }
 
   return rval;
@@ -188,15 +327,10 @@ bool sensorSamplerDisable(const char *name) {
 bool sensorSamplerEnable(const char *name) {
   bool rval = false;
 
-  for(uint32_t sensorIdx = 0; sensorIdx < numSensors; sensorIdx++) {
-    if(strncmp(sensorList[sensorIdx]->name, name, MAX_NAME_LEN) == 0) {
-      if(sensorList[sensorIdx]->timer != NULL &&
-          !xTimerIsTimerActive(sensorList[sensorIdx]->timer)) {
-        configASSERT(xTimerStart(sensorList[sensorIdx]->timer, 10));
-        rval = true;
-      }
-      break;
-    }
+  sensorListItem_t *sensorItem = sensorFind(name);
+  if((sensorItem != NULL) && sensorItem->initialized && !sensorItem->enabled) {
+    sensorSetEnabled(sensorItem, true);
+    rval = true;
   }
 
   return rval;
@@ -210,8 +344,12 @@ bool sensorSamplerEnable(const char *name) {
 */
 bool sensorSamplerDisableChecks() {
   bool rval = false;
-  if((sensorCheckTimer != NULL) && xTimerIsTimerActive(sensorCheckTimer)) {
-    configASSERT(xTimerStop(sensorCheckTimer, 10));
+
+  if(checksEnabled) {
+    sensorLockTake();
+    timingWheelRemove(&sensorWheel, &checkEntry);
+    checksEnabled = false;
+    sensorLockGive();
     rval = true;
   }
 
@@ -226,8 +364,12 @@ bool sensorSamplerDisableChecks() {
 bool sensorSamplerEnableChecks() {
   bool rval = false;
 
-  if((sensorCheckTimer != NULL) && !xTimerIsTimerActive(sensorCheckTimer)) {
-    configASSERT(xTimerStart(sensorCheckTimer, 10));
+  if((checkPeriodTicks > 0) && !checksEnabled) {
+    sensorLockTake();
+    timingWheelInsert(&sensorWheel, &checkEntry, timingWheelAlign(xTaskGetTickCount(), checkPeriodTicks));
+    checksEnabled = true;
+    sensorLockGive();
+    sensorWakeTask();
     rval = true;
   }
 
@@ -237,13 +379,9 @@ bool sensorSamplerEnableChecks() {
 uint32_t sensorSamplerGetSamplingPeriodMs(const char * name) {
   TickType_t period_ticks = 0;
 
-  for(uint32_t sensorIdx = 0; sensorIdx < numSensors; sensorIdx++) {
-    if(strncmp(sensorList[sensorIdx]->name, name, MAX_NAME_LEN) == 0) {
-      if(sensorList[sensorIdx]->timer != NULL) {
-        period_ticks = xTimerGetPeriod(sensorList[sensorIdx]->timer);
-      }
-      break;
-    }
+  sensorListItem_t *sensorItem = sensorFind(name);
+  if((sensorItem != NULL) && sensorItem->initialized) {
+    period_ticks = sensorItem->periodTicks;
   }
 
   return (uint32_t)period_ticks * 1000 / configTICK_RATE_HZ;
@@ -252,23 +390,118 @@ uint32_t sensorSamplerGetSamplingPeriodMs(const char * name) {
 bool sensorSamplerChangeSamplingPeriodMs(const char * name, uint32_t new_period_ms) {
   bool rval = false;
 
-  for(uint32_t sensorIdx = 0; sensorIdx < numSensors; sensorIdx++) {
-    if(strncmp(sensorList[sensorIdx]->name, name, MAX_NAME_LEN) == 0) {
-      // If timer is disabled, don't adjust period as that will start timer. Return false to indicate failure
-      if(sensorList[sensorIdx]->timer != NULL && xTimerIsTimerActive(sensorList[sensorIdx]->timer)) {
-        configASSERT(xTimerChangePeriod(sensorList[sensorIdx]->timer, pdMS_TO_TICKS(new_period_ms), 10));
-        rval = true;
+  sensorListItem_t *sensorItem = sensorFind(name);
+  // If sensor is disabled, don't adjust period as that will start it. Return false to indicate failure
+  if((sensorItem != NULL) && sensorItem->enabled && (pdMS_TO_TICKS(new_period_ms) > 0)) {
+    sensorLockTake();
+    sensorItem->periodTicks = pdMS_TO_TICKS(new_period_ms);
+    sensorLockGive();
+
+    // Re-align to the new period
+    sensorSetEnabled(sensorItem, true);
+    rval = true;
+  }
+
+  return rval;
+}
+
+/*!
+  Get the time the current sample was started. Only valid when called
+  from a sensor's sampleFn/stepFn. Asynchronous samples get the time of
+  their first step, so all values from one sample share a timestamp.
+
+  \return sample time (uptime in microseconds)
+*/
+uint64_t sensorSamplerGetSampleTimeUs() {
+  configASSERT(currentItem != NULL);
+  return currentItem->sampleTimeUs;
+}
+
+/*!
+  Run the next step of an asynchronous sample and schedule the following
+  one (if needed)
+
+  \param[in] *sensorItem - sensor to step
+  \return none
+*/
+static void sensorStep(sensorListItem_t *sensorItem) {
+  currentItem = sensorItem;
+  uint32_t delayMs = sensorItem->sensor->stepFn();
+  currentItem = NULL;
+
+  if(delayMs == SENSOR_STEP_DONE) {
+    sensorItem->stepPending = false;
+  } else {
+    TickType_t delayTicks = pdMS_TO_TICKS(delayMs);
+    sensorItem->stepPending = true;
+    sensorItem->stepTime = xTaskGetTickCount() + ((delayTicks > 0) ? delayTicks : 1);
+  }
+}
+
+/*!
+  Start a sample. Blocking sensors are sampled right away, asynchronous
+  ones run their first step.
+
+  \param[in] *sensorItem - sensor to sample
+  \return none
+*/
+static void sensorStartSample(sensorListItem_t *sensorItem) {
+  if(sensorItem->stepPending) {
+    // Previous sample still in progress, skip this one
+    sensorItem->overruns++;
+    printf("%s sample still in progress, skipping (%" PRIu32 ")\n", sensorItem->name, sensorItem->overruns);
+    return;
+  }
+
+  sensorItem->sampleTimeUs = uptimeGetMicroSeconds();
+  if(sensorItem->sensor->stepFn == NULL) {
+    currentItem = sensorItem;
+    sensorItem->sensor->sampleFn();
+    currentItem = NULL;
+  } else {
+    sensorStep(sensorItem);
+  }
+}
+
+/*!
+  Run all asynchronous steps that are due
+
+  \return ticks until the next step is due (portMAX_DELAY if none are pending)
+*/
+static TickType_t sensorRunSteps() {
+  TickType_t waitTicks = portMAX_DELAY;
+
+  for(sensorListItem_t *sensorItem = sensorList; sensorItem != NULL; sensorItem = sensorItem->next) {
+    if(!sensorItem->stepPending) {
+      continue;
+    }
+
+    int32_t ticksUntilStep = (int32_t)(sensorItem->stepTime - xTaskGetTickCount());
+    if(ticksUntilStep <= 0) {
+      sensorStep(sensorItem);
+      if(!sensorItem->stepPending) {
+        continue;
       }
-      break;
+      ticksUntilStep = (int32_t)(sensorItem->stepTime - xTaskGetTickCount());
+    }
+
+    if(ticksUntilStep < 0) {
+      ticksUntilStep = 0;
+    }
+
+    if((TickType_t)ticksUntilStep < waitTicks) {
+      waitTicks = (TickType_t)ticksUntilStep;
     }
   }
 
-  return rval;
+  return waitTicks;
 }
 
 /*!
-  Sensor sampling task. Waits for individual sensor timers to expire, then
-  calls the sensor sampling function for the relevant sensor.
+  Sensor sampling task. Sleeps until the next sample time on the timing
+  wheel, then samples every sensor that is due (or within its jitter
+  budget). Asynchronous sensors are stepped whenever their next step is
+  due, so their conversions overlap.
 
   Also periodically runs sensor checks (if enabled)
 
@@ -278,39 +511,65 @@ static void sensorSampleTask( void *parameters ) {
   (void) parameters;
 
   if(_config->sensorCheckIntervalS) {
-    sensorCheckTimer = xTimerCreate(
-      "sensorCheck",
-      pdMS_TO_TICKS((uint32_t)_config->sensorCheckIntervalS * 1000),
-      pdTRUE, // Enable auto-reload
-      reinterpret_cast<void *>(SENSOR_CHECK_SAMPLE_FLAG),
-      sensorTimerCallback
-    );
-    configASSERT(sensorCheckTimer != NULL);
-    xTimerStart(sensorCheckTimer, 10);
+    checkPeriodTicks = pdMS_TO_TICKS((uint32_t)_config->sensorCheckIntervalS * 1000);
+    sensorSamplerEnableChecks();
   } else {
     // logPrint(SYSLog, LOG_LEVEL_INFO, "Sensor Checks Disabled\n");
     printf("Sensor Checks Disabled\n");
   }
 
+  TickType_t waitTicks = 0;
   for (;;) {
-    uint32_t taskNotifyValue = 0;
-    BaseType_t res = xTaskNotifyWait(pdFALSE, UINT32_MAX, &taskNotifyValue, portMAX_DELAY);
-    if(res != pdTRUE) {
-      // Error
-      // logPrint(SYSLog, LOG_LEVEL_ERROR, "Error waiting for sensor task notification\n");
-      printf("Error waiting for sensor task notification\n");
-      continue;
+    // Times out at the next sample/step time. Notifications mean the
+    // schedule changed.
+    xTaskNotifyWait(pdFALSE, UINT32_MAX, NULL, waitTicks);
+
+    sensorListItem_t *sampleList = NULL;
+    bool runChecks = false;
+
+    sensorLockTake();
+    TickType_t now = xTaskGetTickCount();
+    timingWheelEntry_t *expired = timingWheelExpire(&sensorWheel, now);
+    while(expired != NULL) {
+      timingWheelEntry_t *entry = expired;
+      expired = entry->next;
+
+      if(entry == &checkEntry) {
+        runChecks = true;
+        sensorScheduleNext(entry, checkPeriodTicks, now);
+      } else {
+        sensorListItem_t *sensorItem = static_cast<sensorListItem_t *>(entry->context);
+        if(sensorScheduleNext(entry, sensorItem->periodTicks, now)) {
+          sensorItem->missed++;
+        }
+        sensorItem->sampleNext = sampleList;
+        sampleList = sensorItem;
+      }
     }
+    sensorLockGive();
 
-    // Check all sensors to see if they are due for a sample update
-    for(uint32_t sensorIdx = 0; sensorIdx < numSensors; sensorIdx++) {
-      if(sensorList[sensorIdx]->flag & taskNotifyValue) {
-        sensorList[sensorIdx]->sensor->sampleFn();
-      }
+    // Sample everything that's due
+    for(sensorListItem_t *sensorItem = sampleList; sensorItem != NULL; sensorItem = sensorItem->sampleNext) {
+      sensorStartSample(sensorItem);
     }
 
-    if (taskNotifyValue & SENSOR_CHECK_SAMPLE_FLAG) {
+    if (runChecks) {
       checkSensors();
     }
+
+    waitTicks = sensorRunSteps();
+
+    uint32_t nextSample = 0;
+    sensorLockTake();
+    if(timingWheelNext(&sensorWheel, &nextSample)) {
+      int32_t ticksUntilSample = (int32_t)(nextSample - xTaskGetTickCount());
+      if(ticksUntilSample < 0) {
+        ticksUntilSample = 0;
+      }
+      if((TickType_t)ticksUntilSample < waitTicks) {
+        waitTicks = (TickType_t)ticksUntilSample;
+      }
+    }
+    sensorLockGive();
   }
 }
@@ -11,10 +11,27 @@ typedef bool (*sensorSampleFn)();
 typedef bool (*sensorInitFn)();
 typedef bool (*sensorCheckFn)();
 
+/// Returned by a sensorStepFn once the sample is complete (or failed)
+#define SENSOR_STEP_DONE (0)
+
+/*!
+  Asynchronous sampling step. Called once when a sample is due and then
+  again after each requested delay, so conversions on different sensors
+  can overlap instead of blocking the sampler task.
+
+  \return delay (in ms) until the next step, or SENSOR_STEP_DONE
+*/
+typedef uint32_t (*sensorStepFn)();
+
 typedef struct {
-  /// Sample interval in milliseconds
+  /// Sample interval in milliseconds. Samples are taken on multiples of
+  /// the interval, so sensors with the same interval are sampled together
   uint16_t intervalMs;
 
+  /// (optional) How early (in milliseconds) a sample can be taken so it can
+  /// share a wakeup with other sensors
+  uint16_t jitterMs;
+
   /// Initialization function
   sensorInitFn initFn;
 
@@ -23,6 +40,10 @@ typedef struct {
 
   /// (optional) Sensor check function
   sensorCheckFn checkFn;
+
+  /// (optional) Asynchronous sampling function. Used instead of sampleFn
+  /// when present (should push data to sensorhub!)
+  sensorStepFn stepFn;
 } sensor_t;
 
 typedef struct {
@@ -41,6 +62,7 @@ bool sensorSamplerDisableChecks();
 bool sensorSamplerEnableChecks();
 uint32_t sensorSamplerGetSamplingPeriodMs(const char * name);
 bool sensorSamplerChangeSamplingPeriodMs(const char * name, uint32_t new_period_ms);
+uint64_t sensorSamplerGetSampleTimeUs();
 
 #ifdef __cplusplus
 }
@@ -0,0 +1,96 @@
+#ifndef FREERTOS_CONFIG_H
+#define FREERTOS_CONFIG_H
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*-----------------------------------------------------------
+ * FreeRTOS configuration for the POSIX host simulation.
+ *
+ * Mirrors the firmware app configuration where it matters (priorities,
+ * notification entries, timers) so shared code behaves the same. Every
+ * FreeRTOS task is a pthread, scheduled one at a time by the POSIX port.
+ *
+ * See http://www.freertos.org/a00110.html
+ *----------------------------------------------------------*/
+
+#include <limits.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#define configUSE_PREEMPTION                     1
+#define configSUPPORT_STATIC_ALLOCATION          0
+#define configSUPPORT_DYNAMIC_ALLOCATION         1
+#define configUSE_IDLE_HOOK                      0
+#define configUSE_TICK_HOOK                      0
+#define configTICK_RATE_HZ                       ((TickType_t)1000)
+#define configMAX_PRIORITIES                     ( 32 )
+// Task stacks become pthread stacks in the POSIX port, so they can't be
+// smaller than PTHREAD_STACK_MIN
+#define configMINIMAL_STACK_SIZE                 ((uint32_t)(PTHREAD_STACK_MIN / sizeof(void *)))
+#define configSTACK_DEPTH_TYPE                   uint32_t
+#define configTOTAL_HEAP_SIZE                    ((size_t)1024*1024)
+#define configMAX_TASK_NAME_LEN                  ( 16 )
+#define configUSE_TRACE_FACILITY                 1
+#define configUSE_16_BIT_TICKS                   0
+#define configUSE_MUTEXES                        1
+#define configQUEUE_REGISTRY_SIZE                8
+#define configUSE_RECURSIVE_MUTEXES              1
+#define configUSE_COUNTING_SEMAPHORES            1
+#define configUSE_PORT_OPTIMISED_TASK_SELECTION  0
+#define configUSE_TICKLESS_IDLE                  0
+#define configUSE_QUEUE_SETS                     1
+#define configMESSAGE_BUFFER_LENGTH_TYPE         size_t
+#define configTASK_NOTIFICATION_ARRAY_ENTRIES    3
+#define configGENERATE_RUN_TIME_STATS            0
+
+/* Co-routine definitions. */
+#define configUSE_CO_ROUTINES                    0
+#define configMAX_CO_ROUTINE_PRIORITIES          ( 2 )
+
+/* Software timer definitions. */
+#define configUSE_TIMERS                         1
+#define configTIMER_TASK_PRIORITY                ( 2 )
+#define configTIMER_QUEUE_LENGTH                 32
+#define configTIMER_TASK_STACK_DEPTH             configMINIMAL_STACK_SIZE
+
+#define INCLUDE_vTaskPrioritySet             1
+#define INCLUDE_uxTaskPriorityGet            1
+#define INCLUDE_vTaskDelete                  1
+#define INCLUDE_vTaskCleanUpResources        0
+#define INCLUDE_vTaskSuspend                 1
+#define INCLUDE_vTaskDelayUntil              1
+#define INCLUDE_vTaskDelay                   1
+#define INCLUDE_xTaskGetSchedulerState       1
+#define INCLUDE_xTimerPendFunctionCall       1
+#define INCLUDE_xQueueGetMutexHolder         1
+#define INCLUDE_uxTaskGetStackHighWaterMark  1
+#define INCLUDE_eTaskGetState                1
+#define INCLUDE_xTaskGetCurrentTaskHandle    1
+
+/* CLI output buffer size*/
+#define configCOMMAND_INT_MAX_OUTPUT_SIZE 1024
+
+#define configCHECK_FOR_STACK_OVERFLOW 0
+#define configUSE_MALLOC_FAILED_HOOK 0
+
+// Crash loudly so CI catches it
+#define configASSERT(x) \
+  do { \
+    if(!(x)) { \
+      fprintf(stderr, "ASSERT %s:%d %s\n", __FILE__, __LINE__, #x); \
+      abort(); \
+    } \
+  } while(0)
+
+#define pdTICKS_TO_MS( xTicks )    ( ( uint32_t ) ( ( ( uint64_t ) ( xTicks ) * ( uint32_t ) 1000U ) / ( uint32_t ) configTICK_RATE_HZ ) )
+
+#define pdMS_TO_TICKS( xTimeInMs )    ( ( uint32_t ) ( ( ( uint64_t ) ( xTimeInMs ) * ( uint32_t ) configTICK_RATE_HZ ) / ( uint32_t ) 1000U ) )
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* FREERTOS_CONFIG_H */
@@ -0,0 +1,4 @@
+#include "bm_config.h"
+
+// Simulated nodes have a single two-port network device, like the ADIN2111
+bm_netdev_config_t bm_netdev_config[] = {{BM_NETDEV_TYPE_SIM}, {BM_NETDEV_TYPE_NONE}};
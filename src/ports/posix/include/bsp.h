@@ -0,0 +1,4 @@
+#pragma once
+
+// No board support package in the simulation. Only here so driver headers
+// that include it (eth_adin2111.h via adi_hal.h) build on the host.
@@ -0,0 +1,4 @@
+#pragma once
+
+// Nothing to see here. Stands in for the STM32 HAL so shared code that
+// includes it (but doesn't touch hardware) builds on the host.
@@ -0,0 +1,4 @@
+#pragma once
+
+// Stands in for the STM32 LL RTC driver on the host. See sim_hal.c for the
+// simulated RTC.
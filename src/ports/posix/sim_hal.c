@@ -0,0 +1,390 @@
+#include <inttypes.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "FreeRTOS.h"
+#include "task.h"
+
+#include "bootutil/bootutil_public.h"
+#include "device_info.h"
+#include "eth_adin2111.h"
+#include "flash_map_backend/flash_map_backend.h"
+#include "lptimTick.h"
+#include "reset_reason.h"
+#include "sim_hal.h"
+#include "stm32_flash.h"
+#include "stm32_rtc.h"
+#include "sysflash/sysflash.h"
+#include "util.h"
+
+// Size of the simulated secondary image slot used for DFU
+#define SIM_IMAGE_SLOT_SIZE_BYTES (1024 * 1024)
+
+static uint64_t _nodeId;
+static uint32_t _uid[3];
+static char _uidStr[25];
+static FILE *_slotFile;
+static uint64_t _bootUs;
+
+static uint64_t monotonicUs(void);
+
+static const versionInfo_t _versionInfo = {
+  .magic = VERSION_MAGIC,
+  .gitSHA = 0,
+  .maj = 0,
+  .min = 0,
+  .rev = 0,
+  .hwVersion = 0,
+  .flags = (1 << VER_ENG_FLAG_OFFSET),
+  .versionStrLen = sizeof("sim") - 1,
+  .versionStr = "sim",
+};
+
+static const uint8_t _buildId[] = {0x51, 0x4d, 0x00, 0x00};
+
+/*!
+  Initialize the simulated hardware
+
+  \param[in] nodeId - node id for this simulated device
+  \param[in] flashPath - file used to back the secondary image slot (for DFU)
+  \return none
+*/
+void simHalInit(uint64_t nodeId, const char *flashPath) {
+  _bootUs = monotonicUs();
+  _nodeId = nodeId;
+  _uid[0] = (uint32_t)(nodeId & 0xFFFFFFFF);
+  _uid[1] = (uint32_t)(nodeId >> 32);
+  _uid[2] = 0x51A1;
+  snprintf(_uidStr, sizeof(_uidStr), "%08"PRIx32"%08"PRIx32"%08"PRIx32"", _uid[2], _uid[1], _uid[0]);
+
+  if(flashPath) {
+    _slotFile = fopen(flashPath, "w+b");
+    if(!_slotFile) {
+      printf("Unable to open %s\n", flashPath);
+    }
+  }
+}
+
+//
+// device_info.h
+//
+const versionInfo_t *getVersionInfo() {
+  return &_versionInfo;
+}
+
+const versionInfo_t *findVersionInfo(uint32_t addr, uint32_t len) {
+  (void)addr;
+  (void)len;
+  return NULL;
+}
+
+bool fwIsEng(const versionInfo_t *info) {
+  return (info->flags >> VER_ENG_FLAG_OFFSET) & 0x1;
+}
+
+bool fwIsDirty(const versionInfo_t *info) {
+  return (info->flags >> VER_DIRTY_FLAG_OFFSET) & 0x1;
+}
+
+const uint32_t* getUID() {
+  return _uid;
+}
+
+const char * getUIDStr() {
+  return _uidStr;
+}
+
+const char * getFWVersionStr() {
+  return _versionInfo.versionStr;
+}
+
+uint32_t getGitSHA() {
+  return _versionInfo.gitSHA;
+}
+
+void getFWVersion(uint8_t *major, uint8_t *minor, uint8_t *revision) {
+  if(major != NULL) {
+    *major = _versionInfo.maj;
+  }
+
+  if(minor != NULL) {
+    *minor = _versionInfo.min;
+  }
+
+  if(revision != NULL) {
+    *revision = _versionInfo.rev;
+  }
+}
+
+size_t getBuildId(const uint8_t **buildId) {
+  if(buildId != NULL) {
+    *buildId = _buildId;
+  }
+
+  return sizeof(_buildId);
+}
+
+// Same scheme as device_info.c
+void getMacAddr(uint8_t *buff, size_t len) {
+  configASSERT(len >= 6);
+
+  uint64_t node_id = getNodeId();
+  buff[0] = 0x00;
+  buff[1] = 0x00;
+  buff[2] = (node_id >> 24) & 0xFF;
+  buff[3] = (node_id >> 16) & 0xFF;
+  buff[4] = (node_id >> 8) & 0xFF;
+  buff[5] = (node_id >> 0) & 0xFF;
+}
+
+uint64_t getNodeId() {
+  return _nodeId;
+}
+
+//
+// stm32_rtc.h
+// The RTC is simulated as an offset from the host's monotonic clock
+//
+static bool _rtcSet;
+static int64_t _rtcOffsetUs;
+
+static uint64_t monotonicUs(void) {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ((uint64_t)ts.tv_sec * 1000000) + ((uint64_t)ts.tv_nsec / 1000);
+}
+
+void simHalSyncRtcToHost(void) {
+  struct timespec ts;
+  clock_gettime(CLOCK_REALTIME, &ts);
+  uint64_t utcUs = ((uint64_t)ts.tv_sec * 1000000) + ((uint64_t)ts.tv_nsec / 1000);
+  _rtcOffsetUs = (int64_t)utcUs - (int64_t)monotonicUs();
+  _rtcSet = true;
+}
+
+BaseType_t rtcInit() {
+  return pdPASS;
+}
+
+BaseType_t rtcSet(const RTCTimeAndDate_t *timeAndDate) {
+  configASSERT(timeAndDate);
+  uint64_t utcUs = rtcGetMicroSeconds((RTCTimeAndDate_t *)timeAndDate);
+  _rtcOffsetUs = (int64_t)utcUs - (int64_t)monotonicUs();
+  _rtcSet = true;
+  return pdPASS;
+}
+
+BaseType_t rtcGet(RTCTimeAndDate_t *timeAndDate) {
+  configASSERT(timeAndDate);
+  BaseType_t rval = pdFAIL;
+  if(_rtcSet) {
+    utcDateTime_t dateTime;
+    dateTimeFromUtc((uint64_t)((int64_t)monotonicUs() + _rtcOffsetUs), &dateTime);
+    timeAndDate->year = dateTime.year;
+    timeAndDate->month = dateTime.month;
+    timeAndDate->day = dateTime.day;
+    timeAndDate->hour = dateTime.hour;
+    timeAndDate->minute = dateTime.min;
+    timeAndDate->second = dateTime.sec;
+    timeAndDate->ms = dateTime.usec / 1000;
+    rval = pdPASS;
+  }
+  return rval;
+}
+
+uint64_t rtcGetMicroSeconds(RTCTimeAndDate_t *timeAndDate) {
+  uint64_t microseconds = utcFromDateTime(timeAndDate->year,
+                                          timeAndDate->month,
+                                          timeAndDate->day,
+                                          timeAndDate->hour,
+                                          timeAndDate->minute,
+                                          timeAndDate->second);
+  return (microseconds * 1000000) + ((uint64_t)timeAndDate->ms * 1000);
+}
+
+bool isRTCSet() {
+  return _rtcSet;
+}
+
+bool isRTCValid(RTCTimeAndDate_t *receivedTimeAndDate, uint32_t driftThesholdS, uint32_t *deltaS) {
+  RTCTimeAndDate_t rtcTimeAndDate = {0};
+  if(rtcGet(&rtcTimeAndDate) != pdPASS) {
+    return false;
+  }
+
+  uint64_t rtcTimeMicroSeconds = rtcGetMicroSeconds(&rtcTimeAndDate);
+  uint64_t receivedTimeMicroSeconds = rtcGetMicroSeconds(receivedTimeAndDate);
+  uint64_t delta = (receivedTimeMicroSeconds > rtcTimeMicroSeconds) ?
+                    (receivedTimeMicroSeconds - rtcTimeMicroSeconds) :
+                    (rtcTimeMicroSeconds - receivedTimeMicroSeconds);
+  if (deltaS != NULL) {
+    *deltaS = (uint32_t)delta;
+  }
+  return delta <= ((uint64_t)driftThesholdS * 1000000);
+}
+
+// No calibration registers in the simulation
+uint32_t getCALM() { return 0; }
+uint32_t getCALP() { return 0; }
+uint32_t getRECALP() { return 0; }
+uint32_t setCALM(uint32_t calm) { return calm; }
+uint32_t setCALP(uint32_t calp) { return calp; }
+
+//
+// lptimTick.h
+// The LPTIM clock is the host's monotonic clock, from when the sim started
+//
+uint64_t lptimGetMicroSeconds(void) {
+  return monotonicUs() - _bootUs;
+}
+
+//
+// heap_3 uses the system malloc, so there are no heap stats to report
+//
+void vPortGetHeapStats(HeapStats_t *pxHeapStats) {
+  memset(pxHeapStats, 0, sizeof(*pxHeapStats));
+}
+
+//
+// reset_reason.h
+//
+void resetSystemFromISR(ResetReason_t reason) {
+  resetSystem(reason);
+}
+
+void resetSystem(ResetReason_t reason) {
+  printf("Reset requested (%d), exiting\n", reason);
+  fflush(stdout);
+  // The launcher decides whether to restart the node
+  exit(reason);
+}
+
+ResetReason_t checkResetReason() {
+  return RESET_REASON_NONE;
+}
+
+const char * getResetReasonString() {
+  return "RESET_REASON_NONE";
+}
+
+//
+// Internal flash/mcuboot. Only the secondary slot exists, backed by a file.
+//
+static const struct flash_area _secondarySlot = {
+  .fa_id = SECONDARY_ID,
+  .fa_device_id = FLASH_DEVICE_INTERNAL_FLASH,
+  .pad16 = 0,
+  .fa_off = 0,
+  .fa_size = SIM_IMAGE_SLOT_SIZE_BYTES,
+};
+
+int flash_area_open(uint8_t id, const struct flash_area **area_outp) {
+  int rval = -1;
+  if((id == SECONDARY_ID) && _slotFile && area_outp) {
+    *area_outp = &_secondarySlot;
+    rval = 0;
+  }
+  return rval;
+}
+
+void flash_area_close(const struct flash_area *fa) {
+  (void)fa;
+  if(_slotFile) {
+    fflush(_slotFile);
+  }
+}
+
+int flash_area_read(const struct flash_area *fa, uint32_t off, void *dst, uint32_t len) {
+  int rval = -1;
+  if(fa && _slotFile && ((off + len) <= fa->fa_size) &&
+     (fseek(_slotFile, off, SEEK_SET) == 0) && (fread(dst, 1, len, _slotFile) == len)) {
+    rval = 0;
+  }
+  return rval;
+}
+
+int flash_area_write(const struct flash_area *fa, uint32_t off, const void *src, uint32_t len) {
+  int rval = -1;
+  if(fa && _slotFile && ((off + len) <= fa->fa_size) &&
+     (fseek(_slotFile, off, SEEK_SET) == 0) && (fwrite(src, 1, len, _slotFile) == len)) {
+    rval = 0;
+  }
+  return rval;
+}
+
+int flash_area_erase(const struct flash_area *fa, uint32_t off, uint32_t len) {
+  int rval = -1;
+  if(fa && _slotFile && ((off + len) <= fa->fa_size) && (fseek(_slotFile, off, SEEK_SET) == 0)) {
+    uint8_t erased[256];
+    memset(erased, 0xFF, sizeof(erased));
+    rval = 0;
+    while(len) {
+      uint32_t chunk = (len > sizeof(erased)) ? sizeof(erased) : len;
+      if(fwrite(erased, 1, chunk, _slotFile) != chunk) {
+        rval = -1;
+        break;
+      }
+      len -= chunk;
+    }
+  }
+  return rval;
+}
+
+int boot_set_pending(int permanent) {
+  printf("Image pending (permanent: %d)\n", permanent);
+  return 0;
+}
+
+int boot_set_confirmed(void) {
+  return 0;
+}
+
+bool flashErase(uint32_t addr, size_t len) {
+  (void)addr;
+  (void)len;
+  return false;
+}
+
+bool flashWrite(uint32_t addr, const uint8_t * data, uint32_t len) {
+  (void)addr;
+  (void)data;
+  (void)len;
+  return false;
+}
+
+//
+// ADIN2111. Simulated nodes use sim_netdev instead, but bm_l2 still
+// references the driver.
+//
+adi_eth_Result_e adin2111_hw_init(adin2111_DeviceHandle_t hDevice, adin_rx_callback_t rx_callback, adin_link_change_callback_t link_change_callback) {
+  (void)hDevice;
+  (void)rx_callback;
+  (void)link_change_callback;
+  return ADI_ETH_DEVICE_UNINITIALIZED;
+}
+
+err_t adin2111_tx(adin2111_DeviceHandle_t hDevice, uint8_t* buf, uint16_t buf_len, uint8_t port_mask, uint8_t port_offset) {
+  (void)hDevice;
+  (void)buf;
+  (void)buf_len;
+  (void)port_mask;
+  (void)port_offset;
+  return ERR_IF;
+}
+
+bool adin2111_get_port_stats(adin2111_DeviceHandle_t dev, adin2111_Port_e port, adin2111_port_stats_callback_t cb, void* args) {
+  (void)dev;
+  (void)port;
+  (void)cb;
+  (void)args;
+  return false;
+}
+
+//
+// printf.h output (see debug.h)
+//
+void _putchar(char character) {
+  putchar(character);
+}
@@ -0,0 +1,22 @@
+#pragma once
+
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+//
+// Host replacements for the hardware specific pieces (device info, RTC,
+// reset, internal flash/mcuboot) that the Bristlemouth stack depends on.
+//
+
+void simHalInit(uint64_t nodeId, const char *flashPath);
+
+// Set the simulated RTC from the host's wall clock. All nodes on the same
+// host then share a clock, which lets them measure one-way latency.
+void simHalSyncRtcToHost(void);
+
+#ifdef __cplusplus
+}
+#endif
@@ -0,0 +1,345 @@
+//
+// Bristlemouth node running on a host as a regular process.
+//
+// Each process is one node. Ports are unix datagram sockets connected to
+// ports of other nodes (see sim_netdev.h), which lets us bring up
+// multi-node topologies on a single machine without any hardware. See
+// tools/scripts/sim/bm_sim.py to launch and check whole networks.
+//
+#include <getopt.h>
+#include <inttypes.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "FreeRTOS.h"
+#include "task.h"
+
+#include "bcmp_neighbors.h"
+#include "bm_l2.h"
+#include "bm_pubsub.h"
+#include "bristlemouth.h"
+#include "configuration.h"
+#include "external_flash_partitions.h"
+#include "nvmPartition.h"
+#include "ram_partitions.h"
+#include "sim_hal.h"
+#include "sim_netdev.h"
+#include "sim_storage.h"
+#include "stress.h"
+#include "task_priorities.h"
+
+#define SIM_FLASH_SIZE_BYTES      (4 * 1024 * 1024)
+#define SIM_MAX_TRACKED_NODES     (64)
+
+// Every node publishes here and subscribes to it, so we can check that
+// messages make it across the whole network
+static const char simTopic[] = "sim";
+
+typedef struct {
+  uint64_t nodeId;
+  uint32_t durationS;
+  uint32_t pubPeriodMs;
+  char flashPrefix[128];
+  bool benchPub;
+  stress_bench_pub_cfg_t benchPubCfg;
+  uint16_t benchSubTopics;
+} simArgs_t;
+
+static simArgs_t _args = {
+  .nodeId = 0,
+  .durationS = 10,
+  .pubPeriodMs = 1000,
+  .flashPrefix = "",
+  .benchPub = false,
+  .benchPubCfg = {},
+  .benchSubTopics = 0,
+};
+
+static uint64_t _rxNodes[SIM_MAX_TRACKED_NODES];
+static uint32_t _numRxNodes;
+static uint32_t _numRxMessages;
+
+static void defaultTask(void *parameters);
+
+static void usage(const char *name) {
+  printf("Usage: %s --node-id ID [options]\n", name);
+  printf("  --node-id ID        64-bit node id (required)\n");
+  printf("  --port N=LOCAL,PEER[,BPS,LATENCY_US,LOSS_PPM]\n");
+  printf("                      Connect port N (0 or 1). LOCAL and PEER are unix socket paths\n");
+  printf("  --duration S        Run for S seconds, then print results and exit (default 10)\n");
+  printf("  --pub-period MS     Publish to '%s' every MS milliseconds, 0 to disable (default 1000)\n", simTopic);
+  printf("  --flash PREFIX      File prefix for simulated flash (default: in /tmp)\n");
+  printf("  --bench-pub LEN,RATE_HZ,TOPICS,DURATION_S\n");
+  printf("                      Run the pub/sub benchmark publisher (see 'stress bench')\n");
+  printf("  --bench-sub TOPICS  Run the pub/sub benchmark subscriber\n");
+}
+
+/*!
+  Parse --bench-pub argument
+
+  \param[in] arg - LEN,RATE_HZ,TOPICS,DURATION_S
+  \return true if successful, false otherwise
+*/
+static bool parseBenchPub(char *arg) {
+  uint32_t fields[4];
+  uint8_t fieldIdx = 0;
+
+  char *saveptr = NULL;
+  char *field = strtok_r(arg, ",", &saveptr);
+  while(field && (fieldIdx < 4)) {
+    fields[fieldIdx++] = strtoul(field, NULL, 0);
+    field = strtok_r(NULL, ",", &saveptr);
+  }
+
+  if(fieldIdx != 4) {
+    return false;
+  }
+
+  _args.benchPubCfg.payload_len = fields[0];
+  _args.benchPubCfg.rate_hz = fields[1];
+  _args.benchPubCfg.num_topics = fields[2];
+  _args.benchPubCfg.duration_s = fields[3];
+  _args.benchPub = true;
+  return true;
+}
+
+/*!
+  Parse --port argument and configure simulated port
+
+  \param[in] arg - N=LOCAL,PEER[,BPS,LATENCY_US,LOSS_PPM]
+  \return true if successful, false otherwise
+*/
+static bool parsePort(char *arg) {
+  bool rval = false;
+
+  do {
+    char *equals = strchr(arg, '=');
+    if(!equals) {
+      break;
+    }
+    *equals = 0;
+    uint32_t port = strtoul(arg, NULL, 0);
+
+    sim_link_config_t config;
+    memset(&config, 0, sizeof(config));
+
+    char *saveptr = NULL;
+    char *field = strtok_r(equals + 1, ",", &saveptr);
+    uint8_t fieldIdx = 0;
+    while(field) {
+      switch(fieldIdx) {
+        case 0: strncpy(config.local_path, field, sizeof(config.local_path) - 1); break;
+        case 1: strncpy(config.peer_path, field, sizeof(config.peer_path) - 1); break;
+        case 2: config.bandwidth_bps = strtoul(field, NULL, 0); break;
+        case 3: config.latency_us = strtoul(field, NULL, 0); break;
+        case 4: config.loss_ppm = strtoul(field, NULL, 0); break;
+        default: break;
+      }
+      fieldIdx++;
+      field = strtok_r(NULL, ",", &saveptr);
+    }
+
+    if(fieldIdx < 2) {
+      break;
+    }
+
+    rval = sim_netdev_configure_port(port, &config);
+  } while(0);
+
+  return rval;
+}
+
+int main(int argc, char **argv) {
+  static const struct option longOptions[] = {
+    {"node-id",    required_argument, NULL, 'n'},
+    {"port",       required_argument, NULL, 'p'},
+    {"duration",   required_argument, NULL, 'd'},
+    {"pub-period", required_argument, NULL, 'P'},
+    {"flash",      required_argument, NULL, 'f'},
+    {"bench-pub",  required_argument, NULL, 'b'},
+    {"bench-sub",  required_argument, NULL, 's'},
+    {"help",       no_argument,       NULL, 'h'},
+    {NULL, 0, NULL, 0},
+  };
+
+  int opt;
+  while((opt = getopt_long(argc, argv, "n:p:d:P:f:b:s:h", longOptions, NULL)) != -1) {
+    switch(opt) {
+      case 'n':
+        _args.nodeId = strtoull(optarg, NULL, 0);
+        break;
+      case 'p':
+        if(!parsePort(optarg)) {
+          printf("Invalid port config\n");
+          usage(argv[0]);
+          return EXIT_FAILURE;
+        }
+        break;
+      case 'd':
+        _args.durationS = strtoul(optarg, NULL, 0);
+        break;
+      case 'P':
+        _args.pubPeriodMs = strtoul(optarg, NULL, 0);
+        break;
+      case 'f':
+        strncpy(_args.flashPrefix, optarg, sizeof(_args.flashPrefix) - 1);
+        break;
+      case 'b':
+        if(!parseBenchPub(optarg)) {
+          printf("Invalid benchmark config\n");
+          usage(argv[0]);
+          return EXIT_FAILURE;
+        }
+        break;
+      case 's':
+        _args.benchSubTopics = strtoul(optarg, NULL, 0);
+        break;
+      case 'h':
+      default:
+        usage(argv[0]);
+        return (opt == 'h') ? EXIT_SUCCESS : EXIT_FAILURE;
+    }
+  }
+
+  if(!_args.nodeId) {
+    usage(argv[0]);
+    return EXIT_FAILURE;
+  }
+
+  if(!strlen(_args.flashPrefix)) {
+    snprintf(_args.flashPrefix, sizeof(_args.flashPrefix), "/tmp/bm_sim_%016" PRIx64, _args.nodeId);
+  }
+
+  // Line buffered output so logs from many nodes interleave sensibly
+  setvbuf(stdout, NULL, _IOLBF, 0);
+
+  char slotPath[160];
+  snprintf(slotPath, sizeof(slotPath), "%s_slot.bin", _args.flashPrefix);
+  simHalInit(_args.nodeId, slotPath);
+
+  if(_args.benchPub || _args.benchSubTopics) {
+    // Benchmark latency needs a common clock across nodes
+    simHalSyncRtcToHost();
+  }
+
+  BaseType_t rval = xTaskCreate(defaultTask,
+                                "Default",
+                                configMINIMAL_STACK_SIZE * 4,
+                                NULL,
+                                // Start with very high priority during boot then downgrade
+                                // once done initializing everything
+                                DEFAULT_BOOT_TASK_PRIORITY,
+                                NULL);
+  configASSERT(rval == pdTRUE);
+
+  // Start FreeRTOS scheduler
+  vTaskStartScheduler();
+
+  /* We should never get here as control is now taken by the scheduler */
+  return EXIT_FAILURE;
+}
+
+static void simSubCallback(uint64_t node_id, const char* topic, uint16_t topic_len, const uint8_t* data, uint16_t data_len) {
+  (void)topic;
+  (void)topic_len;
+  (void)data;
+  (void)data_len;
+
+  _numRxMessages++;
+  for(uint32_t idx = 0; idx < _numRxNodes; idx++) {
+    if(_rxNodes[idx] == node_id) {
+      return;
+    }
+  }
+
+  if(_numRxNodes < SIM_MAX_TRACKED_NODES) {
+    _rxNodes[_numRxNodes++] = node_id;
+  }
+}
+
+/*!
+  Print machine readable results for the launcher, then exit
+
+  \return none
+*/
+static void simReport(void) {
+  uint8_t numNeighbors = 0;
+  bcmp_get_neighbors(numNeighbors);
+
+  printf("SIM_RESULT node=%016" PRIx64 " neighbors=%u pub_rx_nodes=%" PRIu32 " pub_rx_msgs=%" PRIu32 "\n",
+         _args.nodeId, numNeighbors, _numRxNodes, _numRxMessages);
+
+  void *handle = NULL;
+  bm_netdev_type_t type = BM_NETDEV_TYPE_NONE;
+  uint32_t startPort = 0;
+  if(bm_l2_get_device_handle(0, &handle, &type, &startPort) && (type == BM_NETDEV_TYPE_SIM)) {
+    for(uint8_t port = 0; port < SIM_NETDEV_PORT_NUM; port++) {
+      sim_port_stats_t stats;
+      if(sim_netdev_get_port_stats(static_cast<sim_netdev_t *>(handle), port, &stats)) {
+        printf("SIM_PORT node=%016" PRIx64 " port=%u tx_frames=%" PRIu32 " tx_bytes=%" PRIu32
+               " tx_lost=%" PRIu32 " tx_dropped=%" PRIu32 " rx_frames=%" PRIu32
+               " rx_bytes=%" PRIu32 " rx_dropped=%" PRIu32 "\n",
+               _args.nodeId, startPort + port, stats.tx_frames, stats.tx_bytes,
+               stats.tx_lost, stats.tx_dropped, stats.rx_frames,
+               stats.rx_bytes, stats.rx_dropped);
+      }
+    }
+  }
+  fflush(stdout);
+}
+
+static void defaultTask(void *parameters) {
+  (void)parameters;
+
+  char flashPath[160];
+  snprintf(flashPath, sizeof(flashPath), "%s_flash.bin", _args.flashPrefix);
+  static SimStorageDriver simFlash(flashPath, SIM_FLASH_SIZE_BYTES);
+
+  static NvmPartition user_partition(simFlash, user_configuration);
+  static NvmPartition hardware_partition(simFlash, hardware_configuration);
+  static NvmPartition system_partition(simFlash, system_configuration);
+  static cfg::Configuration configuration_user(user_partition, ram_user_configuration, RAM_USER_CONFIG_SIZE_BYTES);
+  static cfg::Configuration configuration_hardware(hardware_partition, ram_hardware_configuration, RAM_HARDWARE_CONFIG_SIZE_BYTES);
+  static cfg::Configuration configuration_system(system_partition, ram_system_configuration, RAM_SYSTEM_CONFIG_SIZE_BYTES);
+  static NvmPartition dfu_partition(simFlash, dfu_configuration);
+  (void)configuration_hardware;
+
+  printf("Sim node %016" PRIx64 " starting\n", _args.nodeId);
+  bcl_init(&dfu_partition, &configuration_user, &configuration_system);
+
+  bm_sub(simTopic, simSubCallback);
+
+  if(_args.benchSubTopics) {
+    configASSERT(stress_bench_sub_start(_args.benchSubTopics));
+  }
+
+  // Drop priority now that we're done booting
+  vTaskPrioritySet(NULL, DEFAULT_TASK_PRIORITY);
+
+  const TickType_t endTicks = xTaskGetTickCount() + pdMS_TO_TICKS(_args.durationS * 1000);
+  TickType_t lastPub = xTaskGetTickCount();
+  uint32_t pubCount = 0;
+
+  if(_args.benchPub) {
+    // Let the network come up before we start measuring
+    vTaskDelay(pdMS_TO_TICKS(2000));
+    configASSERT(stress_bench_pub_start(&_args.benchPubCfg));
+  }
+
+  while((int32_t)(endTicks - xTaskGetTickCount()) > 0) {
+    if(_args.pubPeriodMs && ((xTaskGetTickCount() - lastPub) >= pdMS_TO_TICKS(_args.pubPeriodMs))) {
+      lastPub = xTaskGetTickCount();
+      char msg[32];
+      int len = snprintf(msg, sizeof(msg), "%" PRIu32, pubCount++);
+      bm_pub(simTopic, msg, len);
+    }
+    vTaskDelay(pdMS_TO_TICKS(10));
+  }
+
+  simReport();
+  if(_args.benchSubTopics) {
+    stress_bench_report();
+  }
+  exit(EXIT_SUCCESS);
+}
@@ -0,0 +1,366 @@
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+
+#include "FreeRTOS.h"
+#include "task.h"
+#include "task_priorities.h"
+#include "sim_netdev.h"
+
+// How often we let the other end know the link is up
+#define SIM_PROBE_PERIOD_MS     (100)
+// Link is considered down if we haven't heard a probe in this long
+#define SIM_LINK_TIMEOUT_MS     (500)
+
+// Frames received but not yet "delivered" because of link latency
+#define SIM_RX_QUEUE_LEN        (64)
+
+// Drop frames if the link is this far behind (simulates TX queue overflow)
+#define SIM_MAX_TX_BACKLOG_US   (100 * 1000)
+
+#define SIM_SOCKET_BUFFER_BYTES (1024 * 1024)
+
+typedef enum {
+  SIM_FRAME_DATA,
+  SIM_FRAME_PROBE,
+} sim_frame_type_e;
+
+typedef struct {
+  uint8_t type;
+  uint8_t rsvd;
+  uint16_t len;
+  // Absolute CLOCK_MONOTONIC time at which the frame reaches the other end
+  uint64_t deliver_at_us;
+} __attribute__((packed)) sim_frame_header_t;
+
+typedef struct {
+  uint64_t deliver_at_us;
+  uint16_t len;
+  uint8_t data[SIM_NETDEV_MAX_FRAME_SIZE];
+} sim_rx_frame_t;
+
+typedef struct {
+  sim_link_config_t config;
+  bool configured;
+  int fd;
+  struct sockaddr_un peer_addr;
+  bool link_up;
+  uint64_t last_probe_rx_us;
+  uint64_t last_probe_tx_us;
+  uint64_t link_free_at_us;
+  sim_rx_frame_t *rx_queue;
+  uint16_t rx_head;
+  uint16_t rx_count;
+  unsigned int rand_state;
+  sim_port_stats_t stats;
+} sim_port_t;
+
+struct sim_netdev_s {
+  sim_port_t ports[SIM_NETDEV_PORT_NUM];
+  sim_netdev_rx_callback_t rx_callback;
+  sim_netdev_link_change_callback_t link_change_callback;
+  TaskHandle_t task;
+};
+
+static sim_netdev_t _dev;
+
+static void sim_netdev_task(void *parameters);
+
+static uint64_t now_us(void) {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ((uint64_t)ts.tv_sec * 1000000) + ((uint64_t)ts.tv_nsec / 1000);
+}
+
+static bool sim_send(sim_port_t *port, sim_frame_type_e type, const uint8_t *buf, uint16_t len, uint64_t deliver_at_us) {
+  uint8_t frame[sizeof(sim_frame_header_t) + SIM_NETDEV_MAX_FRAME_SIZE];
+  sim_frame_header_t *header = (sim_frame_header_t *)frame;
+
+  header->type = type;
+  header->rsvd = 0;
+  header->len = len;
+  header->deliver_at_us = deliver_at_us;
+  if(len) {
+    memcpy(&frame[sizeof(sim_frame_header_t)], buf, len);
+  }
+
+  ssize_t rval = sendto(port->fd, frame, sizeof(sim_frame_header_t) + len, MSG_DONTWAIT,
+                        (struct sockaddr *)&port->peer_addr, sizeof(port->peer_addr));
+  return rval == (ssize_t)(sizeof(sim_frame_header_t) + len);
+}
+
+/*!
+  Configure a simulated port. Must be called before sim_netdev_init.
+  Ports that aren't configured are left disconnected.
+
+  \param[in] port - port index (0 to SIM_NETDEV_PORT_NUM - 1)
+  \param[in] *config - link configuration
+  \return true if successful, false otherwise
+*/
+bool sim_netdev_configure_port(uint8_t port, const sim_link_config_t *config) {
+  bool rval = false;
+  if((port < SIM_NETDEV_PORT_NUM) && config && !_dev.task) {
+    memcpy(&_dev.ports[port].config, config, sizeof(sim_link_config_t));
+    _dev.ports[port].configured = true;
+    rval = true;
+  }
+  return rval;
+}
+
+/*!
+  Open sockets for all configured ports and start the simulated device task
+
+  \param[in] rx_callback - called with every frame received
+  \param[in] link_change_callback - called whenever a port goes up or down
+  \return device handle, NULL on failure
+*/
+sim_netdev_t *sim_netdev_init(sim_netdev_rx_callback_t rx_callback, sim_netdev_link_change_callback_t link_change_callback) {
+  configASSERT(rx_callback);
+  configASSERT(link_change_callback);
+
+  sim_netdev_t *rval = NULL;
+
+  do {
+    _dev.rx_callback = rx_callback;
+    _dev.link_change_callback = link_change_callback;
+
+    bool failed = false;
+    for(uint8_t idx = 0; idx < SIM_NETDEV_PORT_NUM; idx++) {
+      sim_port_t *port = &_dev.ports[idx];
+      port->fd = -1;
+      if(!port->configured) {
+        continue;
+      }
+
+      port->fd = socket(AF_UNIX, SOCK_DGRAM, 0);
+      if(port->fd < 0) {
+        printf("sim port%u: unable to create socket (%d)\n", idx, errno);
+        failed = true;
+        break;
+      }
+
+      int bufsize = SIM_SOCKET_BUFFER_BYTES;
+      setsockopt(port->fd, SOL_SOCKET, SO_SNDBUF, &bufsize, sizeof(bufsize));
+      setsockopt(port->fd, SOL_SOCKET, SO_RCVBUF, &bufsize, sizeof(bufsize));
+
+      struct sockaddr_un local_addr;
+      memset(&local_addr, 0, sizeof(local_addr));
+      local_addr.sun_family = AF_UNIX;
+      strncpy(local_addr.sun_path, port->config.local_path, sizeof(local_addr.sun_path) - 1);
+
+      // Remove stale socket from a previous run
+      unlink(local_addr.sun_path);
+      if(bind(port->fd, (struct sockaddr *)&local_addr, sizeof(local_addr)) != 0) {
+        printf("sim port%u: unable to bind %s (%d)\n", idx, local_addr.sun_path, errno);
+        failed = true;
+        break;
+      }
+
+      memset(&port->peer_addr, 0, sizeof(port->peer_addr));
+      port->peer_addr.sun_family = AF_UNIX;
+      strncpy(port->peer_addr.sun_path, port->config.peer_path, sizeof(port->peer_addr.sun_path) - 1);
+
+      port->rx_queue = (sim_rx_frame_t *)pvPortMalloc(sizeof(sim_rx_frame_t) * SIM_RX_QUEUE_LEN);
+      configASSERT(port->rx_queue);
+
+      port->rand_state = (unsigned int)getpid() ^ (idx << 16);
+    }
+
+    if(failed) {
+      break;
+    }
+
+    BaseType_t task_rval = xTaskCreate(sim_netdev_task,
+                                       "simNet",
+                                       configMINIMAL_STACK_SIZE * 4,
+                                       NULL,
+                                       SIM_NETDEV_TASK_PRIORITY,
+                                       &_dev.task);
+    configASSERT(task_rval == pdPASS);
+
+    rval = &_dev;
+  } while(0);
+
+  return rval;
+}
+
+/*!
+  Send frame out over simulated port(s). Applies link loss, bandwidth and latency.
+
+  \param[in] *dev - device handle
+  \param[in] *buf - frame to send
+  \param[in] buf_len - frame length
+  \param[in] port_mask - (device specific) ports to send frame out of
+  \param[in] port_offset - unused
+  \return ERR_OK if successful, something else otherwise
+*/
+err_t sim_netdev_tx(sim_netdev_t *dev, uint8_t* buf, uint16_t buf_len, uint8_t port_mask, uint8_t port_offset) {
+  (void)port_offset;
+  configASSERT(dev);
+  configASSERT(buf);
+
+  err_t rval = ERR_OK;
+
+  do {
+    if(buf_len > SIM_NETDEV_MAX_FRAME_SIZE) {
+      rval = ERR_VAL;
+      break;
+    }
+
+    for(uint8_t idx = 0; idx < SIM_NETDEV_PORT_NUM; idx++) {
+      sim_port_t *port = &dev->ports[idx];
+      if(!(port_mask & (1 << idx)) || (port->fd < 0) || !port->link_up) {
+        continue;
+      }
+
+      if(port->config.loss_ppm &&
+         ((uint32_t)(rand_r(&port->rand_state) % 1000000) < port->config.loss_ppm)) {
+        port->stats.tx_lost++;
+        continue;
+      }
+
+      // Frames go out back to back, so each one has to wait for the previous
+      // one to finish before it can start
+      uint64_t now = now_us();
+      uint64_t start = (port->link_free_at_us > now) ? port->link_free_at_us : now;
+      if((start - now) > SIM_MAX_TX_BACKLOG_US) {
+        port->stats.tx_dropped++;
+        continue;
+      }
+
+      uint64_t tx_time_us = 0;
+      if(port->config.bandwidth_bps) {
+        tx_time_us = ((uint64_t)buf_len * 8 * 1000000) / port->config.bandwidth_bps;
+      }
+      port->link_free_at_us = start + tx_time_us;
+
+      if(sim_send(port, SIM_FRAME_DATA, buf, buf_len, port->link_free_at_us + port->config.latency_us)) {
+        port->stats.tx_frames++;
+        port->stats.tx_bytes += buf_len;
+      } else {
+        port->stats.tx_dropped++;
+      }
+    }
+  } while(0);
+
+  return rval;
+}
+
+/*!
+  Get port statistics
+
+  \param[in] *dev - device handle
+  \param[in] port - port index
+  \param[out] *stats - port statistics
+  \return true if successful, false otherwise
+*/
+bool sim_netdev_get_port_stats(sim_netdev_t *dev, uint8_t port, sim_port_stats_t *stats) {
+  bool rval = false;
+  if(dev && stats && (port < SIM_NETDEV_PORT_NUM)) {
+    memcpy(stats, &dev->ports[port].stats, sizeof(sim_port_stats_t));
+    rval = true;
+  }
+  return rval;
+}
+
+/*!
+  Read everything waiting on the port socket into the rx queue
+
+  \param[in] idx - port index
+  \param[in] now - current time in us
+  \return None
+*/
+static void sim_port_receive(uint8_t idx, uint64_t now) {
+  sim_port_t *port = &_dev.ports[idx];
+  uint8_t frame[sizeof(sim_frame_header_t) + SIM_NETDEV_MAX_FRAME_SIZE];
+
+  while(1) {
+    // Tasks in the POSIX port must not block in system calls
+    ssize_t len = recv(port->fd, frame, sizeof(frame), MSG_DONTWAIT);
+    if(len <= 0) {
+      break;
+    }
+
+    const sim_frame_header_t *header = (const sim_frame_header_t *)frame;
+    if(((size_t)len < sizeof(sim_frame_header_t)) ||
+       (header->len != (size_t)len - sizeof(sim_frame_header_t))) {
+      port->stats.rx_dropped++;
+      continue;
+    }
+
+    if(header->type == SIM_FRAME_PROBE) {
+      port->last_probe_rx_us = now;
+      if(!port->link_up) {
+        port->link_up = true;
+        _dev.link_change_callback(&_dev, idx, true);
+      }
+      continue;
+    }
+
+    if(port->rx_count == SIM_RX_QUEUE_LEN) {
+      port->stats.rx_dropped++;
+      continue;
+    }
+
+    sim_rx_frame_t *rx_frame = &port->rx_queue[(port->rx_head + port->rx_count) % SIM_RX_QUEUE_LEN];
+    rx_frame->deliver_at_us = header->deliver_at_us;
+    rx_frame->len = header->len;
+    memcpy(rx_frame->data, &frame[sizeof(sim_frame_header_t)], header->len);
+    port->rx_count++;
+  }
+}
+
+/*!
+  Simulated device task. Polls port sockets, delivers frames once their link
+  latency has elapsed and keeps track of link state.
+
+  \param[in] *parameters - unused
+  \return None
+*/
+static void sim_netdev_task(void *parameters) {
+  (void)parameters;
+
+  for(;;) {
+    uint64_t now = now_us();
+
+    for(uint8_t idx = 0; idx < SIM_NETDEV_PORT_NUM; idx++) {
+      sim_port_t *port = &_dev.ports[idx];
+      if(port->fd < 0) {
+        continue;
+      }
+
+      sim_port_receive(idx, now);
+
+      // Deliver frames that have made it across the link
+      while(port->rx_count && (port->rx_queue[port->rx_head].deliver_at_us <= now)) {
+        sim_rx_frame_t *rx_frame = &port->rx_queue[port->rx_head];
+        if(_dev.rx_callback(&_dev, rx_frame->data, rx_frame->len, (1 << idx)) == ERR_OK) {
+          port->stats.rx_frames++;
+          port->stats.rx_bytes += rx_frame->len;
+        } else {
+          port->stats.rx_dropped++;
+        }
+        port->rx_head = (port->rx_head + 1) % SIM_RX_QUEUE_LEN;
+        port->rx_count--;
+      }
+
+      if((now - port->last_probe_tx_us) >= (SIM_PROBE_PERIOD_MS * 1000)) {
+        port->last_probe_tx_us = now;
+        // Fails if the other end isn't running yet, which is fine
+        sim_send(port, SIM_FRAME_PROBE, NULL, 0, now);
+      }
+
+      if(port->link_up && ((now - port->last_probe_rx_us) > (SIM_LINK_TIMEOUT_MS * 1000))) {
+        port->link_up = false;
+        _dev.link_change_callback(&_dev, idx, false);
+      }
+    }
+
+    vTaskDelay(1);
+  }
+}
@@ -0,0 +1,59 @@
+#pragma once
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "lwip/err.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+//
+// Simulated Bristlemouth network device for the POSIX host build.
+//
+// Stands in for the ADIN2111. Each port is a unix datagram socket connected
+// to a port on another simulated node (another process). Links have a
+// configurable bandwidth, latency and loss rate. Link up/down is detected
+// with periodic probe frames, the same way a PHY would report link state.
+//
+
+#define SIM_NETDEV_PORT_NUM         2
+#define SIM_NETDEV_PORT_MASK        0x03
+#define SIM_NETDEV_MAX_FRAME_SIZE   1536
+#define SIM_NETDEV_PATH_LEN         108
+
+typedef struct {
+  // Socket path for this end of the link
+  char local_path[SIM_NETDEV_PATH_LEN];
+  // Socket path for the other end of the link
+  char peer_path[SIM_NETDEV_PATH_LEN];
+  // 0 means unlimited
+  uint32_t bandwidth_bps;
+  uint32_t latency_us;
+  // Probability of dropping a frame, in parts per million
+  uint32_t loss_ppm;
+} sim_link_config_t;
+
+typedef struct {
+  uint32_t tx_frames;
+  uint32_t tx_bytes;
+  uint32_t tx_lost;
+  uint32_t tx_dropped;
+  uint32_t rx_frames;
+  uint32_t rx_bytes;
+  uint32_t rx_dropped;
+} sim_port_stats_t;
+
+typedef int8_t (*sim_netdev_rx_callback_t)(void* device_handle, uint8_t* payload, uint16_t payload_len, uint8_t port_mask);
+typedef void (*sim_netdev_link_change_callback_t)(void* device_handle, uint8_t port, bool state);
+
+typedef struct sim_netdev_s sim_netdev_t;
+
+bool sim_netdev_configure_port(uint8_t port, const sim_link_config_t *config);
+sim_netdev_t *sim_netdev_init(sim_netdev_rx_callback_t rx_callback, sim_netdev_link_change_callback_t link_change_callback);
+err_t sim_netdev_tx(sim_netdev_t *dev, uint8_t* buf, uint16_t buf_len, uint8_t port_mask, uint8_t port_offset);
+bool sim_netdev_get_port_stats(sim_netdev_t *dev, uint8_t port, sim_port_stats_t *stats);
+
+#ifdef __cplusplus
+}
+#endif
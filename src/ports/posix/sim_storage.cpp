@@ -0,0 +1,347 @@
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "FreeRTOS.h"
+#include "crc.h"
+#include "sim_storage.h"
+
+// W25 opcode + 24 bit address
+#define SIM_FLASH_CMD_LEN (4)
+
+// Typical W25Q datasheet numbers with a 16MHz SPI clock
+static const SimFlashTiming_t defaultTiming = {
+  400,    // pageProgramUs
+  45000,  // sectorEraseUs
+  500,    // spiNsPerByte
+};
+
+/*!
+  Create simulated flash device
+
+  \param[in] *path - file to back the device with, NULL to keep it in RAM
+  \param[in] size - device size in bytes (multiple of the sector size)
+  \param[in] alignment - erase alignment reported to users
+*/
+SimStorageDriver::SimStorageDriver(const char *path, uint32_t size, uint32_t alignment) :
+    _size(size), _alignment(alignment), _numSectors(size / SECTOR_SIZE), _mem(NULL), _fd(-1),
+    _timing(defaultTiming), _realTime(false), _busyNs(0) {
+    configASSERT((size > 0) && ((size % SECTOR_SIZE) == 0));
+    configASSERT((alignment > 0) && ((alignment % SECTOR_SIZE) == 0));
+
+    _eraseCounts = static_cast<uint32_t *>(calloc(_numSectors, sizeof(uint32_t)));
+    configASSERT(_eraseCounts != NULL);
+    memset(&_stats, 0, sizeof(_stats));
+
+    if(path) {
+        _fd = open(path, O_RDWR | O_CREAT, 0644);
+        configASSERT(_fd >= 0);
+
+        struct stat st;
+        int rval = fstat(_fd, &st);
+        configASSERT(rval == 0);
+        off_t oldSize = st.st_size;
+        if(oldSize < (off_t)_size) {
+            rval = ftruncate(_fd, _size);
+            configASSERT(rval == 0);
+        }
+
+        void *mem = mmap(NULL, _size, PROT_READ | PROT_WRITE, MAP_SHARED, _fd, 0);
+        configASSERT(mem != MAP_FAILED);
+        _mem = static_cast<uint8_t *>(mem);
+
+        // New (or grown) device, the new part starts erased
+        if(oldSize < (off_t)_size) {
+            memset(&_mem[oldSize], 0xFF, _size - oldSize);
+        }
+    } else {
+        _mem = static_cast<uint8_t *>(malloc(_size));
+        configASSERT(_mem != NULL);
+        memset(_mem, 0xFF, _size);
+    }
+}
+
+SimStorageDriver::~SimStorageDriver() {
+    if(_fd >= 0) {
+        msync(_mem, _size, MS_SYNC);
+        munmap(_mem, _size);
+        close(_fd);
+    } else {
+        free(_mem);
+    }
+    free(_eraseCounts);
+}
+
+/*!
+  Account for time the device is busy (and wait it out in real time mode)
+
+  \param[in] ns - busy time in nanoseconds
+  \return none
+*/
+void SimStorageDriver::busy(uint64_t ns) {
+    _busyNs += ns;
+    _stats.busyUs = _busyNs / 1000;
+    if(_realTime && ns) {
+        struct timespec ts;
+        ts.tv_sec = (time_t)(ns / 1000000000ULL);
+        ts.tv_nsec = (long)(ns % 1000000000ULL);
+        nanosleep(&ts, NULL);
+    }
+}
+
+/*!
+  Account for clocking bytes over SPI
+
+  \param[in] len - number of data bytes (the command header is added)
+  \return none
+*/
+void SimStorageDriver::spi(size_t len) {
+    busy((uint64_t)(SIM_FLASH_CMD_LEN + len) * _timing.spiNsPerByte);
+}
+
+/*!
+  Program (part of) a single page. Like the real device, bits can only go
+  from 1 to 0 and the program can't cross a page boundary.
+
+  \param[in] addr - address to program
+  \param[in] *data - data to program
+  \param[in] len - number of bytes
+  \return true if the page now holds data, false otherwise
+*/
+bool SimStorageDriver::programPage(uint32_t addr, const uint8_t *data, size_t len) {
+    if(!data || !len || ((addr % PAGE_SIZE) + len > PAGE_SIZE) || (addr + len > _size)) {
+        printf("Invalid page program addr: %" PRIu32 " len: %zu\n", addr, len);
+        return false;
+    }
+
+    bool rval = true;
+    for(size_t idx = 0; idx < len; idx++) {
+        if(data[idx] & ~_mem[addr + idx]) {
+            rval = false;
+        }
+        _mem[addr + idx] &= data[idx];
+    }
+
+    if(!rval) {
+        _stats.programViolations++;
+    }
+    _stats.pagesProgrammed++;
+    _stats.bytesProgrammed += len;
+    spi(len);
+    busy((uint64_t)_timing.pageProgramUs * 1000);
+
+    return rval;
+}
+
+/*!
+  Erase a single sector
+
+  \param[in] addr - sector aligned address
+  \return true if successful, false otherwise
+*/
+bool SimStorageDriver::eraseSector(uint32_t addr) {
+    if((addr % SECTOR_SIZE) || (addr >= _size)) {
+        printf("Invalid sector erase addr: %" PRIu32 "\n", addr);
+        return false;
+    }
+
+    memset(&_mem[addr], 0xFF, SECTOR_SIZE);
+    _eraseCounts[addr / SECTOR_SIZE]++;
+    _stats.sectorsErased++;
+    spi(0);
+    busy((uint64_t)_timing.sectorEraseUs * 1000);
+
+    return true;
+}
+
+bool SimStorageDriver::read(uint32_t addr, uint8_t *buffer, size_t len, uint32_t timeoutMs) {
+    (void)timeoutMs;
+    if(!buffer || (addr + len > _size)) {
+        return false;
+    }
+    memcpy(buffer, &_mem[addr], len);
+    _stats.bytesRead += len;
+    spi(len);
+    return true;
+}
+
+/*!
+  Write to flash the way the W25 driver does: every sector touched is read,
+  modified, erased and then reprogrammed page by page (skipping pages that
+  are still erased).
+
+  \param[in] addr - address to write to
+  \param[in] *buffer - data to write
+  \param[in] len - number of bytes
+  \param[in] timeoutMs - unused
+  \return true if successful, false otherwise
+*/
+bool SimStorageDriver::write(uint32_t addr, uint8_t *buffer, size_t len, uint32_t timeoutMs) {
+    if(!buffer || (addr + len > _size)) {
+        return false;
+    }
+
+    bool rval = true;
+    _stats.bytesWritten += len;
+
+    while(len && rval) {
+        uint32_t sectorAddr = addr - (addr % SECTOR_SIZE);
+        uint32_t sectorOffset = addr - sectorAddr;
+        size_t chunk = SECTOR_SIZE - sectorOffset;
+        if(chunk > len) {
+            chunk = len;
+        }
+
+        rval = read(sectorAddr, _sectorBuff, SECTOR_SIZE, timeoutMs);
+        if(!rval) {
+            break;
+        }
+        memcpy(&_sectorBuff[sectorOffset], buffer, chunk);
+
+        rval = eraseSector(sectorAddr);
+        for(uint32_t page = 0; rval && (page < SECTOR_SIZE); page += PAGE_SIZE) {
+            // Erased pages don't need programming
+            bool erased = true;
+            for(uint32_t byte = 0; byte < PAGE_SIZE; byte++) {
+                if(_sectorBuff[page + byte] != 0xFF) {
+                    erased = false;
+                    break;
+                }
+            }
+            if(!erased) {
+                rval = programPage(sectorAddr + page, &_sectorBuff[page], PAGE_SIZE);
+            }
+        }
+
+        addr += chunk;
+        buffer += chunk;
+        len -= chunk;
+    }
+
+    return rval;
+}
+
+bool SimStorageDriver::erase(uint32_t addr, size_t len, uint32_t timeoutMs) {
+    (void)timeoutMs;
+    if((addr % _alignment) || (addr + len > _size)) {
+        return false;
+    }
+
+    // Round up to a full sector, like the real thing
+    bool rval = true;
+    for(uint32_t offset = 0; rval && (offset < len); offset += SECTOR_SIZE) {
+        rval = eraseSector(addr + offset);
+    }
+    return rval;
+}
+
+bool SimStorageDriver::crc16(uint32_t addr, size_t len, uint16_t &crc, uint32_t timeoutMs) {
+    (void)timeoutMs;
+    if(addr + len > _size) {
+        return false;
+    }
+    crc = crc16_ccitt(0, &_mem[addr], len);
+    _stats.bytesRead += len;
+    spi(len);
+    return true;
+}
+
+uint32_t SimStorageDriver::getAlignmentBytes(void) {
+    return _alignment;
+}
+
+uint32_t SimStorageDriver::getStorageSizeBytes(void) {
+    return _size;
+}
+
+/*!
+  Set the program/erase/SPI timing model
+
+  \param[in] &timing - new timing
+  \return none
+*/
+void SimStorageDriver::setTiming(const SimFlashTiming_t &timing) {
+    _timing = timing;
+}
+
+/*!
+  Actually sleep for the modeled latencies, so callers see (roughly) the
+  same delays they would on hardware
+
+  \param[in] realTime - true to sleep, false to only keep count
+  \return none
+*/
+void SimStorageDriver::setRealTime(bool realTime) {
+    _realTime = realTime;
+}
+
+const SimFlashStats_t &SimStorageDriver::getStats(void) const {
+    return _stats;
+}
+
+/*!
+  Clear the operation stats and per sector erase counts
+
+  \return none
+*/
+void SimStorageDriver::resetStats(void) {
+    memset(&_stats, 0, sizeof(_stats));
+    memset(_eraseCounts, 0, _numSectors * sizeof(uint32_t));
+    _busyNs = 0;
+}
+
+/*!
+  Get erase count for the sector holding an address
+
+  \param[in] addr - any address in the sector
+  \return number of times the sector was erased
+*/
+uint32_t SimStorageDriver::getEraseCount(uint32_t addr) const {
+    configASSERT(addr < _size);
+    return _eraseCounts[addr / SECTOR_SIZE];
+}
+
+uint32_t SimStorageDriver::getMaxEraseCount(void) const {
+    uint32_t max = 0;
+    for(uint32_t sector = 0; sector < _numSectors; sector++) {
+        if(_eraseCounts[sector] > max) {
+            max = _eraseCounts[sector];
+        }
+    }
+    return max;
+}
+
+/*!
+  Get mean erase count over the sectors that have been erased at least once
+
+  \return mean erase count, 0 if nothing has been erased
+*/
+float SimStorageDriver::getMeanEraseCount(void) const {
+    uint64_t total = 0;
+    uint32_t used = 0;
+    for(uint32_t sector = 0; sector < _numSectors; sector++) {
+        if(_eraseCounts[sector]) {
+            total += _eraseCounts[sector];
+            used++;
+        }
+    }
+    return used ? (float)total / (float)used : 0.0f;
+}
+
+/*!
+  Get write amplification (bytes programmed into the device for every byte
+  the user wrote)
+
+  \return write amplification, 0 if nothing has been written
+*/
+float SimStorageDriver::getWriteAmplification(void) const {
+    if(_stats.bytesWritten == 0) {
+        return 0.0f;
+    }
+    return (float)_stats.bytesProgrammed / (float)_stats.bytesWritten;
+}
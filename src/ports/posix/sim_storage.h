@@ -0,0 +1,91 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "abstract_storage_driver.h"
+
+//
+// Simulated W25 NOR flash.
+//
+// The device underneath behaves like NOR: erased bytes read back as 0xFF,
+// programming can only clear bits, programs can't cross a page and erases
+// work on whole sectors. On top of it, read/write/erase/crc16 behave the way
+// the W25 driver does on hardware (write() is a read-modify-erase-program of
+// every sector it touches), so code running against it sees the same
+// constraints and costs it does on a real node.
+//
+// Program and erase latencies are modeled (and optionally slept for), and
+// every sector keeps an erase count, so write amplification and wear can be
+// measured on a host. Storage is either a memory-mapped file (which persists
+// between runs) or plain RAM.
+//
+typedef struct {
+  /// Time to program one page (after the data has been clocked in)
+  uint32_t pageProgramUs;
+  /// Time to erase one sector
+  uint32_t sectorEraseUs;
+  /// SPI cost of every command/address/data byte
+  uint32_t spiNsPerByte;
+} SimFlashTiming_t;
+
+typedef struct {
+  /// Bytes passed to write() by the user
+  uint64_t bytesWritten;
+  /// Bytes actually programmed into the device (whole pages)
+  uint64_t bytesProgrammed;
+  /// Bytes read out of the device (including read-modify-write reads)
+  uint64_t bytesRead;
+  uint32_t pagesProgrammed;
+  uint32_t sectorsErased;
+  /// Attempts to program a 0 bit back to 1
+  uint32_t programViolations;
+  /// Modeled time the device spent busy
+  uint64_t busyUs;
+} SimFlashStats_t;
+
+class SimStorageDriver: public AbstractStorageDriver {
+    public:
+        static constexpr uint32_t PAGE_SIZE = 256;
+        static constexpr uint32_t SECTOR_SIZE = 4096;
+
+        SimStorageDriver(const char *path, uint32_t size, uint32_t alignment=SECTOR_SIZE);
+        ~SimStorageDriver();
+
+        bool read(uint32_t addr, uint8_t *buffer, size_t len, uint32_t timeoutMs) override;
+        bool write(uint32_t addr, uint8_t *buffer, size_t len, uint32_t timeoutMs) override;
+        bool erase(uint32_t addr, size_t len, uint32_t timeoutMs) override;
+        bool crc16(uint32_t addr, size_t len, uint16_t &crc, uint32_t timeoutMs) override;
+        uint32_t getAlignmentBytes(void) override;
+        uint32_t getStorageSizeBytes(void) override;
+
+        // Raw device operations
+        bool programPage(uint32_t addr, const uint8_t *data, size_t len);
+        bool eraseSector(uint32_t addr);
+
+        void setTiming(const SimFlashTiming_t &timing);
+        void setRealTime(bool realTime);
+
+        const SimFlashStats_t &getStats(void) const;
+        void resetStats(void);
+        uint32_t getEraseCount(uint32_t addr) const;
+        uint32_t getMaxEraseCount(void) const;
+        float getMeanEraseCount(void) const;
+        float getWriteAmplification(void) const;
+
+    private:
+        void busy(uint64_t ns);
+        void spi(size_t len);
+
+        uint32_t _size;
+        uint32_t _alignment;
+        uint32_t _numSectors;
+        uint8_t *_mem;
+        int _fd;
+        uint32_t *_eraseCounts;
+        uint8_t _sectorBuff[SECTOR_SIZE];
+        SimFlashTiming_t _timing;
+        bool _realTime;
+        SimFlashStats_t _stats;
+        uint64_t _busyNs;
+};
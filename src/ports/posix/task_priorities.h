@@ -0,0 +1,26 @@
+//
+// Define all task priorities here for ease of access/comparison
+// Trying to keep them sorted by priority here
+//
+// Same ordering as the firmware apps so the simulation schedules tasks the
+// same way the hardware does.
+//
+
+#define DEFAULT_BOOT_TASK_PRIORITY  16
+
+#define SIM_NETDEV_TASK_PRIORITY        15
+#define BM_DFU_EVENT_TASK_PRIORITY      11
+#define BM_L2_TX_TASK_PRIORITY          7
+
+#define BCMP_TOPO_TASK_PRIORITY 6
+
+#define BCMP_TASK_PRIORITY	5
+#define STRESS_TASK_PRIORITY 5
+#define TIMER_HANDLER_TASK_PRIORITY (5)
+
+#define MIDDLEWARE_NET_TASK_PRIORITY 4
+
+#define BM_STORE_FORWARD_TASK_PRIORITY 3
+
+#define CLI_TASK_PRIORITY 1
+#define DEFAULT_TASK_PRIORITY 1
@@ -1 +1,46 @@
-#pragma once
\ No newline at end of file
+#pragma once
+
+#include <stdint.h>
+#include "stm32u5xx.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef enum {
+  HAL_OK = 0x00,
+  HAL_ERROR = 0x01,
+  HAL_BUSY = 0x02,
+  HAL_TIMEOUT = 0x03
+} HAL_StatusTypeDef;
+
+uint32_t HAL_GetTick(void);
+
+// I2C (only what host tests need, the values don't match the real HAL)
+#define HAL_I2C_ERROR_NONE (0x00000000U)
+#define HAL_I2C_ERROR_BERR (0x00000001U)
+#define HAL_I2C_ERROR_ARLO (0x00000002U)
+#define HAL_I2C_ERROR_AF (0x00000004U)
+#define HAL_I2C_ERROR_OVR (0x00000008U)
+#define HAL_I2C_ERROR_DMA (0x00000010U)
+#define HAL_I2C_ERROR_TIMEOUT (0x00000020U)
+
+#define I2C_FIRST_FRAME (0x01U)
+#define I2C_FIRST_AND_NEXT_FRAME (0x02U)
+#define I2C_NEXT_FRAME (0x03U)
+#define I2C_FIRST_AND_LAST_FRAME (0x04U)
+#define I2C_LAST_FRAME (0x05U)
+
+HAL_StatusTypeDef HAL_I2C_Master_Seq_Transmit_IT(I2C_HandleTypeDef *hi2c, uint16_t DevAddress, uint8_t *pData,
+                                                 uint16_t Size, uint32_t XferOptions);
+HAL_StatusTypeDef HAL_I2C_Master_Seq_Receive_IT(I2C_HandleTypeDef *hi2c, uint16_t DevAddress, uint8_t *pData,
+                                                uint16_t Size, uint32_t XferOptions);
+uint32_t HAL_I2C_GetError(I2C_HandleTypeDef *hi2c);
+
+void HAL_I2C_MasterTxCpltCallback(I2C_HandleTypeDef *hi2c);
+void HAL_I2C_MasterRxCpltCallback(I2C_HandleTypeDef *hi2c);
+void HAL_I2C_ErrorCallback(I2C_HandleTypeDef *hi2c);
+
+#ifdef __cplusplus
+}
+#endif
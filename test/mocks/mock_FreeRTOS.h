@@ -22,5 +22,6 @@ DECLARE_FAKE_VALUE_FUNC(BaseType_t, xTimerGenericCommand, TimerHandle_t , const
 DECLARE_FAKE_VALUE_FUNC(EventGroupHandle_t, xEventGroupCreate);
 DECLARE_FAKE_VALUE_FUNC(BaseType_t, xTaskGenericNotify, TaskHandle_t,UBaseType_t, uint32_t, eNotifyAction , uint32_t * );
 DECLARE_FAKE_VALUE_FUNC(BaseType_t, xTaskGenericNotifyWait, UBaseType_t ,uint32_t ,uint32_t , uint32_t * , TickType_t  );
+DECLARE_FAKE_VOID_FUNC(vPortGetHeapStats, HeapStats_t *);
 
 #endif  // _AUTOFAKE_FREERTOS_H
@@ -0,0 +1,74 @@
+#pragma once
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "abstract_storage_driver.h"
+
+// RAM backed storage driver that behaves like NOR flash.
+// Erased bytes read back as 0xFF and writes can only clear bits.
+class RamStorageDriver: public AbstractStorageDriver {
+    public:
+        RamStorageDriver(uint32_t size, uint32_t alignment=4096) :
+            _size(size), _alignment(alignment), writes(0), erases(0), failWrites(false) {
+            _mem = static_cast<uint8_t *>(malloc(_size));
+            memset(_mem, 0xFF, _size);
+        }
+        ~RamStorageDriver() {
+            free(_mem);
+        }
+        bool read(uint32_t addr, uint8_t *buffer, size_t len, uint32_t timeoutMs) override {
+            (void)timeoutMs;
+            if(addr + len > _size) {
+                return false;
+            }
+            memcpy(buffer, &_mem[addr], len);
+            return true;
+        }
+        bool write(uint32_t addr, uint8_t *buffer, size_t len, uint32_t timeoutMs) override {
+            (void)timeoutMs;
+            if(failWrites || (addr + len > _size)) {
+                return false;
+            }
+            for(size_t idx = 0; idx < len; idx++) {
+                _mem[addr + idx] &= buffer[idx];
+            }
+            writes++;
+            return true;
+        }
+        bool erase(uint32_t addr, size_t len, uint32_t timeoutMs) override {
+            (void)timeoutMs;
+            if((addr % _alignment) || (addr + len > _size)) {
+                return false;
+            }
+            // Round up to a full sector, like the real thing
+            size_t eraseLen = ((len + _alignment - 1) / _alignment) * _alignment;
+            memset(&_mem[addr], 0xFF, eraseLen);
+            erases++;
+            return true;
+        }
+        bool crc16(uint32_t addr, size_t len, uint16_t &crc, uint32_t timeoutMs) override {
+            (void)addr;
+            (void)len;
+            (void)crc;
+            (void)timeoutMs;
+            return false;
+        }
+        uint32_t getAlignmentBytes(void) override {
+            return _alignment;
+        }
+        uint32_t getStorageSizeBytes(void) override {
+            return _size;
+        }
+        uint8_t *mem(void) {
+            return _mem;
+        }
+    private:
+        uint32_t _size;
+        uint32_t _alignment;
+        uint8_t *_mem;
+    public:
+        uint32_t writes;
+        uint32_t erases;
+        bool failWrites;
+};
@@ -0,0 +1,206 @@
+#include "gtest/gtest.h"
+
+#include "bcmp_txn_table.h"
+
+using namespace testing;
+
+#define REPLY_TYPE (0x0B)
+#define OTHER_TYPE (0x0C)
+#define NODE_A     (0x1111222233334444ULL)
+#define NODE_B     (0x5555666677778888ULL)
+#define TIMEOUT_MS (1000)
+
+static void dummyCb(const bcmp_txn_result_t *result) {
+  (void)result;
+}
+
+// The fixture for testing class Foo.
+class BcmpTxnTableTest : public ::testing::Test {
+ protected:
+  // You can remove any or all of the following functions if its body
+  // is empty.
+
+  BcmpTxnTableTest() {
+     // You can do set-up work for each test here.
+  }
+
+  ~BcmpTxnTableTest() override {
+     // You can do clean-up work that doesn't throw exceptions here.
+  }
+
+  // If the constructor and destructor are not enough for setting up
+  // and cleaning up each test, you can define the following methods:
+
+  void SetUp() override {
+     // Code here will be called immediately after the constructor (right
+     // before each test).
+    bcmp_txn_table_init(&table);
+  }
+
+  void TearDown() override {
+     // Code here will be called immediately after each test (right
+     // before the destructor).
+  }
+
+  // Objects declared here can be used by all tests in the test suite for Foo.
+  bcmp_txn_table_t table;
+  bcmp_txn_result_t result;
+
+  uint32_t add(uint64_t target, uint32_t now, void *arg=NULL, bool has_key=false, uint32_t key=0) {
+    bcmp_txn_params_t params = {
+      .reply_type = REPLY_TYPE,
+      .target_node_id = target,
+      .has_key = has_key,
+      .key = key,
+      .timeout_ms = TIMEOUT_MS,
+      .cb = dummyCb,
+      .arg = arg,
+    };
+    return bcmp_txn_table_add(&table, &params, now);
+  }
+};
+
+int32_t dummyArg;
+
+TEST_F(BcmpTxnTableTest, SingleReply) {
+  uint32_t id = add(NODE_A, 100, &dummyArg);
+  EXPECT_NE(id, 0);
+  EXPECT_EQ(bcmp_txn_table_next_timeout(&table, 100), TIMEOUT_MS);
+
+  // Wrong type/node don't match
+  EXPECT_FALSE(bcmp_txn_table_match(&table, OTHER_TYPE, NODE_A, 0, 150, &result));
+  EXPECT_FALSE(bcmp_txn_table_match(&table, REPLY_TYPE, NODE_B, 0, 150, &result));
+
+  EXPECT_TRUE(bcmp_txn_table_match(&table, REPLY_TYPE, NODE_A, 0, 150, &result));
+  EXPECT_EQ(result.status, BCMP_TXN_REPLY);
+  EXPECT_EQ(result.id, id);
+  EXPECT_EQ(result.node_id, NODE_A);
+  EXPECT_EQ(result.elapsed_ms, 50);
+  EXPECT_EQ(result.num_replies, 1);
+  EXPECT_TRUE(result.done);
+  EXPECT_EQ(result.cb, dummyCb);
+  EXPECT_EQ(result.arg, &dummyArg);
+
+  // Completed, so a second reply doesn't match and nothing times out
+  EXPECT_FALSE(bcmp_txn_table_match(&table, REPLY_TYPE, NODE_A, 0, 160, &result));
+  EXPECT_EQ(bcmp_txn_table_next_timeout(&table, 160), BCMP_TXN_NO_TIMEOUT);
+  EXPECT_FALSE(bcmp_txn_table_expire(&table, 100 + TIMEOUT_MS, &result));
+}
+
+TEST_F(BcmpTxnTableTest, AllNodes) {
+  uint32_t id = add(0, 0);
+
+  EXPECT_TRUE(bcmp_txn_table_match(&table, REPLY_TYPE, NODE_A, 0, 10, &result));
+  EXPECT_EQ(result.node_id, NODE_A);
+  EXPECT_EQ(result.num_replies, 1);
+  EXPECT_FALSE(result.done);
+
+  EXPECT_TRUE(bcmp_txn_table_match(&table, REPLY_TYPE, NODE_B, 0, 20, &result));
+  EXPECT_EQ(result.node_id, NODE_B);
+  EXPECT_EQ(result.num_replies, 2);
+  EXPECT_FALSE(result.done);
+
+  // Done when the time runs out
+  EXPECT_FALSE(bcmp_txn_table_expire(&table, TIMEOUT_MS - 1, &result));
+  EXPECT_TRUE(bcmp_txn_table_expire(&table, TIMEOUT_MS, &result));
+  EXPECT_EQ(result.status, BCMP_TXN_TIMEOUT);
+  EXPECT_EQ(result.id, id);
+  EXPECT_EQ(result.num_replies, 2);
+  EXPECT_TRUE(result.done);
+
+  EXPECT_FALSE(bcmp_txn_table_match(&table, REPLY_TYPE, NODE_A, 0, TIMEOUT_MS, &result));
+}
+
+TEST_F(BcmpTxnTableTest, Key) {
+  uint32_t id1 = add(NODE_A, 0, NULL, true, 1);
+  uint32_t id2 = add(NODE_A, 0, NULL, true, 2);
+
+  EXPECT_FALSE(bcmp_txn_table_match(&table, REPLY_TYPE, NODE_A, 3, 10, &result));
+
+  EXPECT_TRUE(bcmp_txn_table_match(&table, REPLY_TYPE, NODE_A, 2, 10, &result));
+  EXPECT_EQ(result.id, id2);
+  EXPECT_TRUE(bcmp_txn_table_match(&table, REPLY_TYPE, NODE_A, 1, 10, &result));
+  EXPECT_EQ(result.id, id1);
+}
+
+TEST_F(BcmpTxnTableTest, OldestFirst) {
+  uint32_t id1 = add(NODE_A, 0);
+  uint32_t id2 = add(NODE_A, 10);
+  uint32_t id3 = add(0, 20);
+
+  EXPECT_TRUE(bcmp_txn_table_match(&table, REPLY_TYPE, NODE_A, 0, 30, &result));
+  EXPECT_EQ(result.id, id1);
+
+  // Free up the first slot so the next one added goes before the others
+  uint32_t id4 = add(NODE_A, 30);
+  EXPECT_TRUE(bcmp_txn_table_match(&table, REPLY_TYPE, NODE_A, 0, 40, &result));
+  EXPECT_EQ(result.id, id2);
+  EXPECT_TRUE(bcmp_txn_table_match(&table, REPLY_TYPE, NODE_A, 0, 40, &result));
+  EXPECT_EQ(result.id, id3);
+  EXPECT_FALSE(result.done);
+  EXPECT_TRUE(bcmp_txn_table_match(&table, REPLY_TYPE, NODE_A, 0, 40, &result));
+  EXPECT_EQ(result.id, id3);
+
+  EXPECT_TRUE(bcmp_txn_table_remove(&table, id3, 50, &result));
+  EXPECT_TRUE(bcmp_txn_table_match(&table, REPLY_TYPE, NODE_A, 0, 50, &result));
+  EXPECT_EQ(result.id, id4);
+}
+
+TEST_F(BcmpTxnTableTest, Timeouts) {
+  add(NODE_A, 0);
+  uint32_t id2 = add(NODE_B, 500);
+
+  EXPECT_EQ(bcmp_txn_table_next_timeout(&table, 100), TIMEOUT_MS - 100);
+
+  // Late replies don't count
+  EXPECT_FALSE(bcmp_txn_table_match(&table, REPLY_TYPE, NODE_A, 0, TIMEOUT_MS, &result));
+  EXPECT_EQ(bcmp_txn_table_next_timeout(&table, TIMEOUT_MS + 1), 0);
+
+  EXPECT_TRUE(bcmp_txn_table_expire(&table, TIMEOUT_MS + 1, &result));
+  EXPECT_EQ(result.status, BCMP_TXN_TIMEOUT);
+  EXPECT_EQ(result.elapsed_ms, TIMEOUT_MS + 1);
+  EXPECT_EQ(result.num_replies, 0);
+  EXPECT_FALSE(bcmp_txn_table_expire(&table, TIMEOUT_MS + 1, &result));
+
+  EXPECT_EQ(bcmp_txn_table_next_timeout(&table, TIMEOUT_MS + 1), 499);
+  EXPECT_TRUE(bcmp_txn_table_expire(&table, 500 + TIMEOUT_MS, &result));
+  EXPECT_EQ(result.id, id2);
+  EXPECT_EQ(bcmp_txn_table_next_timeout(&table, 500 + TIMEOUT_MS), BCMP_TXN_NO_TIMEOUT);
+}
+
+TEST_F(BcmpTxnTableTest, TimeWrap) {
+  uint32_t now = UINT32_MAX - 100;
+  add(NODE_A, now);
+
+  EXPECT_EQ(bcmp_txn_table_next_timeout(&table, now + 200), TIMEOUT_MS - 200);
+  EXPECT_TRUE(bcmp_txn_table_match(&table, REPLY_TYPE, NODE_A, 0, now + 200, &result));
+  EXPECT_EQ(result.elapsed_ms, 200);
+}
+
+TEST_F(BcmpTxnTableTest, Cancel) {
+  uint32_t id = add(NODE_A, 0, &dummyArg);
+
+  EXPECT_FALSE(bcmp_txn_table_remove(&table, 0, 10, &result));
+  EXPECT_FALSE(bcmp_txn_table_remove(&table, id + 1, 10, &result));
+
+  EXPECT_TRUE(bcmp_txn_table_remove(&table, id, 10, &result));
+  EXPECT_EQ(result.status, BCMP_TXN_CANCELLED);
+  EXPECT_EQ(result.arg, &dummyArg);
+  EXPECT_TRUE(result.done);
+
+  EXPECT_FALSE(bcmp_txn_table_remove(&table, id, 10, &result));
+  EXPECT_FALSE(bcmp_txn_table_match(&table, REPLY_TYPE, NODE_A, 0, 20, &result));
+}
+
+TEST_F(BcmpTxnTableTest, Full) {
+  for(uint32_t idx = 0; idx < BCMP_TXN_MAX_OUTSTANDING; idx++) {
+    EXPECT_NE(add(NODE_A, 0), 0);
+  }
+  EXPECT_EQ(add(NODE_A, 0), 0);
+
+  // Room again once one completes
+  EXPECT_TRUE(bcmp_txn_table_match(&table, REPLY_TYPE, NODE_A, 0, 10, &result));
+  uint32_t id = add(NODE_A, 10);
+  EXPECT_NE(id, 0);
+  EXPECT_NE(id, result.id);
+}
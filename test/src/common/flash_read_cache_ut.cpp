@@ -0,0 +1,129 @@
+#include "gtest/gtest.h"
+
+#include <string.h>
+
+#include "flash_read_cache.h"
+
+#define NUM_LINES (2)
+
+// The fixture for testing the flash read cache.
+class FlashReadCacheTest : public ::testing::Test {
+ protected:
+  // You can remove any or all of the following functions if its body
+  // is empty.
+
+  FlashReadCacheTest() {
+     // You can do set-up work for each test here.
+  }
+
+  ~FlashReadCacheTest() override {
+     // You can do clean-up work that doesn't throw exceptions here.
+  }
+
+  // If the constructor and destructor are not enough for setting up
+  // and cleaning up each test, you can define the following methods:
+
+  void SetUp() override {
+     // Code here will be called immediately after the constructor (right
+     // before each test).
+     flashReadCacheInit(&_cache, _lines, NUM_LINES);
+  }
+
+  void TearDown() override {
+     // Code here will be called immediately after each test (right
+     // before the destructor).
+  }
+
+  // Fill a line like the driver would, with each byte set to its address
+  void fill(uint32_t addr) {
+    flashReadCacheLine_t *line = flashReadCacheAlloc(&_cache, addr);
+    ASSERT_NE(line, nullptr);
+    EXPECT_FALSE(line->valid);
+    EXPECT_EQ(line->addr, addr & ~FLASH_READ_CACHE_LINE_MASK);
+    for(uint32_t idx = 0; idx < FLASH_READ_CACHE_LINE_SIZE; idx++) {
+      line->data[idx] = (uint8_t)(line->addr + idx);
+    }
+    line->valid = true;
+  }
+
+  bool read(uint32_t addr, size_t len) {
+    uint8_t buff[FLASH_READ_CACHE_LINE_SIZE];
+    memset(buff, 0, sizeof(buff));
+    if(!flashReadCacheRead(&_cache, addr, buff, len)) {
+      return false;
+    }
+    for(size_t idx = 0; idx < len; idx++) {
+      EXPECT_EQ(buff[idx], (uint8_t)(addr + idx));
+    }
+    return true;
+  }
+
+  flashReadCacheLine_t _lines[NUM_LINES];
+  flashReadCache_t _cache;
+};
+
+TEST_F(FlashReadCacheTest, Cacheable) {
+  EXPECT_TRUE(flashReadCacheable(0, 1));
+  EXPECT_TRUE(flashReadCacheable(0, FLASH_READ_CACHE_LINE_SIZE));
+  EXPECT_TRUE(flashReadCacheable(0x1010, 0xF0));
+  EXPECT_FALSE(flashReadCacheable(0x1010, 0xF1));
+  EXPECT_FALSE(flashReadCacheable(0, FLASH_READ_CACHE_LINE_SIZE + 1));
+  EXPECT_FALSE(flashReadCacheable(0, 0));
+}
+
+TEST_F(FlashReadCacheTest, HitMiss) {
+  EXPECT_FALSE(read(0x1000, 16));
+  EXPECT_EQ(_cache.misses.value, 1);
+
+  fill(0x1000);
+  EXPECT_TRUE(read(0x1000, 16));
+  EXPECT_TRUE(read(0x10F0, 16));
+  EXPECT_EQ(_cache.hits.value, 2);
+
+  // Next line isn't cached
+  EXPECT_FALSE(read(0x1100, 4));
+
+  // Crosses into the next line
+  EXPECT_FALSE(read(0x10F0, 32));
+}
+
+TEST_F(FlashReadCacheTest, LeastRecentlyUsed) {
+  fill(0x1000);
+  fill(0x2000);
+
+  // Use the first line, so the second one is replaced next
+  EXPECT_TRUE(read(0x1000, 4));
+  fill(0x3000);
+
+  EXPECT_TRUE(read(0x1000, 4));
+  EXPECT_FALSE(read(0x2000, 4));
+  EXPECT_TRUE(read(0x3000, 4));
+}
+
+TEST_F(FlashReadCacheTest, Invalidate) {
+  fill(0x1000);
+  fill(0x1100);
+
+  // Touches the last byte of the first line only
+  flashReadCacheInvalidate(&_cache, 0x10FF, 1);
+  EXPECT_FALSE(read(0x1000, 4));
+  EXPECT_TRUE(read(0x1100, 4));
+
+  // Ends right before the second line
+  flashReadCacheInvalidate(&_cache, 0x0000, 0x1100);
+  EXPECT_TRUE(read(0x1100, 4));
+
+  // Sector erase
+  flashReadCacheInvalidate(&_cache, 0x1000, 0x1000);
+  EXPECT_FALSE(read(0x1100, 4));
+}
+
+TEST_F(FlashReadCacheTest, FailedFill) {
+  fill(0x1000);
+
+  // Driver read failed, so the line is never marked valid
+  flashReadCacheLine_t *line = flashReadCacheAlloc(&_cache, 0x2000);
+  (void)line;
+  EXPECT_FALSE(read(0x2000, 4));
+  EXPECT_TRUE(read(0x1000, 4));
+}
@@ -0,0 +1,140 @@
+#include "gtest/gtest.h"
+
+#include <string>
+
+#include "frame_queue.h"
+
+#define FRAME_SIZE (16)
+#define NUM_FRAMES (3)
+
+// The fixture for testing the frame queue.
+class FrameQueueTest : public ::testing::Test {
+ protected:
+  // You can remove any or all of the following functions if its body
+  // is empty.
+
+  FrameQueueTest() {
+     // You can do set-up work for each test here.
+  }
+
+  ~FrameQueueTest() override {
+     // You can do clean-up work that doesn't throw exceptions here.
+  }
+
+  // If the constructor and destructor are not enough for setting up
+  // and cleaning up each test, you can define the following methods:
+
+  void SetUp() override {
+     // Code here will be called immediately after the constructor (right
+     // before each test).
+     frameQueueInit(&_queue, &_buffers[0][0], _lengths, FRAME_SIZE, NUM_FRAMES);
+  }
+
+  void TearDown() override {
+     // Code here will be called immediately after each test (right
+     // before the destructor).
+  }
+
+  uint32_t put(const std::string &data) {
+    return frameQueuePut(&_queue, reinterpret_cast<const uint8_t *>(data.data()), data.size());
+  }
+
+  std::string pop() {
+    size_t len = 0;
+    uint8_t *frame = frameQueuePeek(&_queue, &len);
+    if(frame == NULL) {
+      return "<empty>";
+    }
+    std::string rval(reinterpret_cast<char *>(frame), len);
+    frameQueuePop(&_queue);
+    return rval;
+  }
+
+  // Objects declared here can be used by all tests in the test suite for Foo.
+  frameQueue_t _queue;
+  uint8_t _buffers[NUM_FRAMES][FRAME_SIZE];
+  size_t _lengths[NUM_FRAMES];
+};
+
+TEST_F(FrameQueueTest, Basic)
+{
+  EXPECT_EQ(pop(), "<empty>");
+
+  // Frames split across several puts and several frames in one put
+  EXPECT_EQ(put("abc"), 0);
+  EXPECT_EQ(put(std::string("de\0fgh\0ij", 9)), 2);
+  EXPECT_EQ(frameQueueCount(&_queue), 2);
+
+  EXPECT_EQ(pop(), "abcde");
+  EXPECT_EQ(pop(), "fgh");
+  EXPECT_EQ(pop(), "<empty>");
+
+  EXPECT_EQ(put(std::string("k\0", 2)), 1);
+  EXPECT_EQ(pop(), "ijk");
+
+  // Empty frames are ignored
+  EXPECT_EQ(put(std::string("\0\0\0", 3)), 0);
+  EXPECT_EQ(pop(), "<empty>");
+
+  EXPECT_EQ(_queue.frames.value, 3);
+}
+
+TEST_F(FrameQueueTest, Overrun)
+{
+  // Fill all slots
+  for(uint32_t frame = 0; frame < NUM_FRAMES; frame++) {
+    EXPECT_EQ(put(std::string("frame") + std::to_string(frame) + std::string("\0", 1)), 1);
+  }
+  EXPECT_EQ(frameQueueCount(&_queue), NUM_FRAMES);
+  EXPECT_EQ(_queue.highWater.value, NUM_FRAMES);
+
+  // No room, frame gets dropped (and counted)
+  EXPECT_EQ(put(std::string("dropped\0", 8)), 0);
+  EXPECT_EQ(_queue.overruns.value, 1);
+
+  // Frame started while full is dropped even if a slot frees up mid frame
+  EXPECT_EQ(put("drop"), 0);
+  EXPECT_EQ(pop(), "frame0");
+  EXPECT_EQ(put(std::string("ped\0new\0", 8)), 1);
+  EXPECT_EQ(_queue.overruns.value, 2);
+
+  // Frames in the queue were not touched
+  EXPECT_EQ(pop(), "frame1");
+  EXPECT_EQ(pop(), "frame2");
+  EXPECT_EQ(pop(), "new");
+  EXPECT_EQ(pop(), "<empty>");
+}
+
+TEST_F(FrameQueueTest, Oversize)
+{
+  // Largest frame fits
+  std::string largest(FRAME_SIZE, 'x');
+  EXPECT_EQ(put(largest + std::string("\0", 1)), 1);
+  EXPECT_EQ(pop(), largest);
+
+  // One more byte doesn't (in one or several puts)
+  EXPECT_EQ(put(largest + std::string("y\0", 2)), 0);
+  EXPECT_EQ(put(largest), 0);
+  EXPECT_EQ(put(std::string("y\0", 2)), 0);
+  EXPECT_EQ(_queue.oversize.value, 2);
+  EXPECT_EQ(pop(), "<empty>");
+
+  // Next frame is fine
+  EXPECT_EQ(put(std::string("ok\0", 3)), 1);
+  EXPECT_EQ(pop(), "ok");
+}
+
+TEST_F(FrameQueueTest, Wraparound)
+{
+  // Go around the slots many times
+  for(uint32_t frame = 0; frame < 100; frame++) {
+    std::string data = std::to_string(frame);
+    EXPECT_EQ(put(data + std::string("\0", 1)), 1);
+    if(frame & 1) {
+      EXPECT_EQ(pop(), std::to_string(frame - 1));
+      EXPECT_EQ(pop(), data);
+    }
+  }
+  EXPECT_EQ(_queue.overruns.value, 0);
+  EXPECT_EQ(_queue.highWater.value, 2);
+}
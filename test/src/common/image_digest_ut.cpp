@@ -0,0 +1,165 @@
+#include "gtest/gtest.h"
+
+#include <string.h>
+#include <vector>
+
+#include "crc.h"
+#include "image_digest.h"
+
+using namespace testing;
+
+// The fixture for testing class Foo.
+class ImageDigestTest : public ::testing::Test {
+ protected:
+  // You can remove any or all of the following functions if its body
+  // is empty.
+
+  ImageDigestTest() {
+     // You can do set-up work for each test here.
+  }
+
+  ~ImageDigestTest() override {
+     // You can do clean-up work that doesn't throw exceptions here.
+  }
+
+  // If the constructor and destructor are not enough for setting up
+  // and cleaning up each test, you can define the following methods:
+
+  void SetUp() override {
+     // Code here will be called immediately after the constructor (right
+     // before each test).
+  }
+
+  void TearDown() override {
+     // Code here will be called immediately after each test (right
+     // before the destructor).
+  }
+
+  // Objects declared here can be used by all tests in the test suite for Foo.
+
+  static void put16(std::vector<uint8_t> &image, uint16_t value) {
+    image.push_back(value & 0xFF);
+    image.push_back(value >> 8);
+  }
+
+  static void put32(std::vector<uint8_t> &image, uint32_t value) {
+    put16(image, value & 0xFFFF);
+    put16(image, value >> 16);
+  }
+
+  // Build an mcuboot style image: header, body, protected TLVs (hashed),
+  // then the TLV area with a key hash TLV and the SHA-256 TLV
+  static std::vector<uint8_t> buildImage(uint32_t imgSize, uint16_t protectTlvSize) {
+    std::vector<uint8_t> image;
+    put32(image, 0x96f3b83d); // ih_magic
+    put32(image, 0); // ih_load_addr
+    put16(image, 32); // ih_hdr_size
+    put16(image, protectTlvSize); // ih_protect_tlv_size
+    put32(image, imgSize); // ih_img_size
+    put32(image, 0); // ih_flags
+    put32(image, 0x00000201); // ih_ver
+    put32(image, 0);
+    put32(image, 0); // _pad1
+    EXPECT_EQ(image.size(), 32);
+
+    for(uint32_t idx = 0; idx < imgSize; idx++) {
+      image.push_back((uint8_t)(idx * 13));
+    }
+    for(uint32_t idx = 0; idx < protectTlvSize; idx++) {
+      image.push_back(0xA5);
+    }
+
+    uint8_t sha[SHA256_DIGEST_LEN];
+    sha256Ctx_t ctx;
+    sha256Init(&ctx);
+    sha256Update(&ctx, image.data(), image.size());
+    sha256Final(&ctx, sha);
+
+    put16(image, 0x6907);
+    put16(image, 4 + 4 + 8 + 4 + SHA256_DIGEST_LEN);
+    put16(image, 0x01); // key hash (contents don't matter here)
+    put16(image, 8);
+    for(uint32_t idx = 0; idx < 8; idx++) {
+      image.push_back(idx);
+    }
+    put16(image, 0x10);
+    put16(image, SHA256_DIGEST_LEN);
+    image.insert(image.end(), sha, sha + SHA256_DIGEST_LEN);
+
+    return image;
+  }
+
+  static imageDigestResult_t digestImage(imageDigest_t &digest, const std::vector<uint8_t> &image, size_t piece) {
+    imageDigestInit(&digest);
+    for(size_t offset = 0; offset < image.size(); offset += piece) {
+      size_t len = (image.size() - offset < piece) ? (image.size() - offset) : piece;
+      imageDigestUpdate(&digest, &image[offset], len);
+    }
+    return imageDigestFinish(&digest);
+  }
+};
+
+TEST_F(ImageDigestTest, McubootImage)
+{
+  std::vector<uint8_t> image = buildImage(5000, 0);
+  uint16_t crc = crc16_ccitt(0, image.data(), image.size());
+
+  // Same result however the image is split up
+  const size_t pieces[] = {1, 7, 31, 32, 33, 1024, 2048, 10000};
+  for(size_t piece : pieces) {
+    imageDigest_t digest;
+    EXPECT_EQ(digestImage(digest, image, piece), IMAGE_DIGEST_MATCH) << "piece " << piece;
+    EXPECT_EQ(digest.crc16, crc);
+    EXPECT_EQ(digest.len, image.size());
+    EXPECT_EQ(memcmp(digest.sha256, &image[image.size() - SHA256_DIGEST_LEN], SHA256_DIGEST_LEN), 0);
+  }
+
+  // Protected TLVs are part of the hash
+  image = buildImage(3000, 24);
+  imageDigest_t digest;
+  EXPECT_EQ(digestImage(digest, image, 1024), IMAGE_DIGEST_MATCH);
+}
+
+TEST_F(ImageDigestTest, Mismatch)
+{
+  std::vector<uint8_t> image = buildImage(5000, 0);
+  image[1000] ^= 0x01;
+
+  imageDigest_t digest;
+  EXPECT_EQ(digestImage(digest, image, 1024), IMAGE_DIGEST_MISMATCH);
+  EXPECT_EQ(digest.crc16, crc16_ccitt(0, image.data(), image.size()));
+
+  // Corrupt TLV
+  image = buildImage(5000, 0);
+  image[image.size() - 1] ^= 0x80;
+  EXPECT_EQ(digestImage(digest, image, 1024), IMAGE_DIGEST_MISMATCH);
+}
+
+TEST_F(ImageDigestTest, NoTlv)
+{
+  // Not an mcuboot image, the whole thing is hashed
+  std::vector<uint8_t> image;
+  for(uint32_t idx = 0; idx < 3000; idx++) {
+    image.push_back((uint8_t)idx);
+  }
+  imageDigest_t digest;
+  EXPECT_EQ(digestImage(digest, image, 100), IMAGE_DIGEST_NO_TLV);
+  EXPECT_FALSE(digest.mcuboot);
+
+  uint8_t sha[SHA256_DIGEST_LEN];
+  sha256Ctx_t ctx;
+  sha256Init(&ctx);
+  sha256Update(&ctx, image.data(), image.size());
+  sha256Final(&ctx, sha);
+  EXPECT_EQ(memcmp(digest.sha256, sha, sizeof(sha)), 0);
+
+  // mcuboot image cut off before the TLVs
+  image = buildImage(5000, 0);
+  image.resize(32 + 5000);
+  EXPECT_EQ(digestImage(digest, image, 1024), IMAGE_DIGEST_NO_TLV);
+  EXPECT_TRUE(digest.mcuboot);
+
+  // Too short to even have a header
+  image.resize(10);
+  EXPECT_EQ(digestImage(digest, image, 1024), IMAGE_DIGEST_NO_TLV);
+}
@@ -0,0 +1,107 @@
+#include "gtest/gtest.h"
+
+#include "latency_histogram.h"
+
+// The fixture for testing latency histograms.
+class LatencyHistogramTest : public ::testing::Test {
+ protected:
+  // You can remove any or all of the following functions if its body
+  // is empty.
+
+  LatencyHistogramTest() {
+     // You can do set-up work for each test here.
+  }
+
+  ~LatencyHistogramTest() override {
+     // You can do clean-up work that doesn't throw exceptions here.
+  }
+
+  // If the constructor and destructor are not enough for setting up
+  // and cleaning up each test, you can define the following methods:
+
+  void SetUp() override {
+     // Code here will be called immediately after the constructor (right
+     // before each test).
+     latencyHistogramReset(&_hist);
+  }
+
+  void TearDown() override {
+     // Code here will be called immediately after each test (right
+     // before the destructor).
+  }
+
+  // Objects declared here can be used by all tests in the test suite.
+  latencyHistogram_t _hist;
+};
+
+TEST_F(LatencyHistogramTest, Empty)
+{
+  EXPECT_EQ(_hist.count, 0u);
+  EXPECT_EQ(latencyHistogramPercentile(&_hist, 50), 0u);
+  EXPECT_EQ(latencyHistogramPercentile(&_hist, 100), 0u);
+  EXPECT_EQ(latencyHistogramMean(&_hist), 0u);
+}
+
+TEST_F(LatencyHistogramTest, SmallValuesExact)
+{
+  // Values below the sub-bucket count get their own bucket
+  for(uint32_t value = 0; value < LATENCY_HISTOGRAM_SUB_BUCKETS; value++) {
+    latencyHistogramAdd(&_hist, value);
+  }
+  EXPECT_EQ(_hist.count, static_cast<uint32_t>(LATENCY_HISTOGRAM_SUB_BUCKETS));
+  EXPECT_EQ(_hist.min, 0u);
+  EXPECT_EQ(_hist.max, LATENCY_HISTOGRAM_SUB_BUCKETS - 1u);
+  EXPECT_EQ(latencyHistogramPercentile(&_hist, 0), 0u);
+  EXPECT_EQ(latencyHistogramPercentile(&_hist, 50), 3u);
+  EXPECT_EQ(latencyHistogramPercentile(&_hist, 100), LATENCY_HISTOGRAM_SUB_BUCKETS - 1u);
+}
+
+TEST_F(LatencyHistogramTest, Uniform)
+{
+  for(uint32_t value = 1; value <= 10000; value++) {
+    latencyHistogramAdd(&_hist, value);
+  }
+
+  EXPECT_EQ(latencyHistogramMean(&_hist), 5000u);
+  EXPECT_EQ(latencyHistogramPercentile(&_hist, 100), 10000u);
+
+  // Within the 12.5% bucket resolution, and never below the real value
+  uint32_t p50 = latencyHistogramPercentile(&_hist, 50);
+  EXPECT_GE(p50, 5000u);
+  EXPECT_LE(p50, 5000u * 9 / 8);
+
+  uint32_t p99 = latencyHistogramPercentile(&_hist, 99);
+  EXPECT_GE(p99, 9900u);
+  EXPECT_LE(p99, 10000u);
+}
+
+TEST_F(LatencyHistogramTest, Outlier)
+{
+  for(uint32_t i = 0; i < 999; i++) {
+    latencyHistogramAdd(&_hist, 100);
+  }
+  latencyHistogramAdd(&_hist, 1000000);
+
+  EXPECT_LE(latencyHistogramPercentile(&_hist, 50), 100u * 9 / 8);
+  EXPECT_LE(latencyHistogramPercentile(&_hist, 99), 100u * 9 / 8);
+  EXPECT_EQ(latencyHistogramPercentile(&_hist, 100), 1000000u);
+  EXPECT_EQ(_hist.max, 1000000u);
+}
+
+TEST_F(LatencyHistogramTest, FullRange)
+{
+  latencyHistogramAdd(&_hist, UINT32_MAX);
+  latencyHistogramAdd(&_hist, 0x80000000);
+  EXPECT_EQ(_hist.buckets[LATENCY_HISTOGRAM_NUM_BUCKETS - 1], 1u);
+  EXPECT_EQ(latencyHistogramPercentile(&_hist, 100), UINT32_MAX);
+  EXPECT_EQ(latencyHistogramPercentile(&_hist, 50), 0x8FFFFFFFu);
+}
+
+TEST_F(LatencyHistogramTest, Reset)
+{
+  latencyHistogramAdd(&_hist, 1234);
+  latencyHistogramReset(&_hist);
+  EXPECT_EQ(_hist.count, 0u);
+  EXPECT_EQ(_hist.max, 0u);
+  EXPECT_EQ(latencyHistogramPercentile(&_hist, 50), 0u);
+}
@@ -0,0 +1,82 @@
+#include "gtest/gtest.h"
+
+#include "lptimTick.h"
+
+using namespace testing;
+
+// The fixture for testing class Foo.
+class LptimTickTest : public ::testing::Test {
+ protected:
+  // You can remove any or all of the following functions if its body
+  // is empty.
+
+  LptimTickTest() {
+     // You can do set-up work for each test here.
+  }
+
+  ~LptimTickTest() override {
+     // You can do clean-up work that doesn't throw exceptions here.
+  }
+
+  // If the constructor and destructor are not enough for setting up
+  // and cleaning up each test, you can define the following methods:
+
+  void SetUp() override {
+     // Code here will be called immediately after the constructor (right
+     // before each test).
+  }
+
+  void TearDown() override {
+     // Code here will be called immediately after each test (right
+     // before the destructor).
+  }
+
+  // Objects declared here can be used by all tests in the test suite for Foo.
+};
+
+TEST_F(LptimTickTest, ExtendCount)
+{
+  // Same count, no time passed
+  EXPECT_EQ(lptimExtendCount(0, 0), 0);
+  EXPECT_EQ(lptimExtendCount(0x12345, 0x2345), 0x12345);
+
+  // Forward within the same epoch
+  EXPECT_EQ(lptimExtendCount(0x10000, 100), 0x10064);
+
+  // Counter wrapped since the last sample
+  EXPECT_EQ(lptimExtendCount(0xFFF0, 0x0010), 0x10010);
+  EXPECT_EQ(lptimExtendCount(0x3FFFF, 0x0000), 0x40000);
+
+  // Almost a full wrap between samples (longest tickless sleep)
+  EXPECT_EQ(lptimExtendCount(0x20001, 0x0000), 0x30000);
+}
+
+TEST_F(LptimTickTest, ExtendCountNeverGoesBackwards)
+{
+  // Walk the counter through many wraps in uneven steps, the way tick
+  // interrupts and reads between them would see it
+  uint64_t extended = 0;
+  uint64_t actual = 0;
+  for(uint32_t idx = 0; idx < 100000; idx++) {
+    actual += (idx * 7919) % 65535;
+    uint64_t next = lptimExtendCount(extended, (uint16_t)actual);
+    ASSERT_GE(next, extended);
+    ASSERT_EQ(next, actual);
+    extended = next;
+  }
+}
+
+TEST_F(LptimTickTest, CountsToMicroSeconds)
+{
+  EXPECT_EQ(lptimCountsToMicroSeconds(0, 32768), 0);
+  EXPECT_EQ(lptimCountsToMicroSeconds(1, 32768), 30);
+  EXPECT_EQ(lptimCountsToMicroSeconds(32768, 32768), 1000000);
+  EXPECT_EQ(lptimCountsToMicroSeconds(32768 + 16384, 32768), 1500000);
+
+  // Divided clock
+  EXPECT_EQ(lptimCountsToMicroSeconds(4096, 4096), 1000000);
+
+  // 100 years worth of counts doesn't overflow
+  const uint64_t seconds = 100ULL * 365 * 24 * 3600;
+  EXPECT_EQ(lptimCountsToMicroSeconds(seconds * 32768 + 1, 32768), seconds * 1000000 + 30);
+}
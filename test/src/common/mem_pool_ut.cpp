@@ -0,0 +1,383 @@
+#include "gtest/gtest.h"
+
+#include <chrono>
+#include <set>
+#include <stdio.h>
+#include <thread>
+#include <vector>
+
+#include "FreeRTOS.h"
+#include "mem_pool.h"
+
+// Use the real heap_4 (test/stubs/heap_4_host.c) instead of malloc/free
+#undef pvPortMalloc
+#undef vPortFree
+extern "C" void *pvPortMalloc(size_t xWantedSize);
+extern "C" void vPortFree(void *pv);
+
+using namespace testing;
+
+MEM_POOL_DEFINE(test_small, 12, 8, false);
+MEM_POOL_DEFINE(test_fallback, 24, 2, true);
+MEM_POOL_DEFINE(test_threads, 32, 64, false);
+MEM_POOL_DEFINE(test_bench, 64, 16, false);
+
+// The fixture for testing class Foo.
+class MemPoolTest : public ::testing::Test {
+ protected:
+  // You can remove any or all of the following functions if its body
+  // is empty.
+
+  MemPoolTest() {
+     // You can do set-up work for each test here.
+  }
+
+  ~MemPoolTest() override {
+     // You can do clean-up work that doesn't throw exceptions here.
+  }
+
+  // If the constructor and destructor are not enough for setting up
+  // and cleaning up each test, you can define the following methods:
+
+  void SetUp() override {
+     // Code here will be called immediately after the constructor (right
+     // before each test).
+  }
+
+  void TearDown() override {
+     // Code here will be called immediately after each test (right
+     // before the destructor).
+  }
+
+  // Objects declared here can be used by all tests in the test suite for Foo.
+
+  // Small deterministic PRNG so the soak is repeatable
+  static uint32_t nextRand(uint32_t &state) {
+    state ^= state << 13;
+    state ^= state >> 17;
+    state ^= state << 5;
+    return state;
+  }
+
+  typedef struct {
+    void *ptr;
+    memPool_t *pool;
+    uint32_t freeAt;
+  } liveAlloc_t;
+};
+
+TEST_F(MemPoolTest, AllocFree)
+{
+  memPoolStats_t stats;
+  memPoolGetStats(&test_small, &stats);
+  EXPECT_EQ(stats.blockSize, 16);
+  EXPECT_EQ(stats.numBlocks, 8);
+
+  std::set<void *> blocks;
+  for(uint32_t idx = 0; idx < 8; idx++) {
+    void *ptr = memPoolAlloc(&test_small);
+    ASSERT_NE(ptr, nullptr);
+    EXPECT_EQ((uintptr_t)ptr % MEM_POOL_ALIGNMENT, 0);
+    EXPECT_TRUE(memPoolOwns(&test_small, ptr));
+    memset(ptr, 0xA5, 12);
+    blocks.insert(ptr);
+  }
+  // Every block is different
+  EXPECT_EQ(blocks.size(), 8);
+
+  // Out of blocks
+  EXPECT_EQ(memPoolAlloc(&test_small), nullptr);
+  memPoolGetStats(&test_small, &stats);
+  EXPECT_EQ(stats.inUse, 8);
+  EXPECT_EQ(stats.highWater, 8);
+  EXPECT_EQ(stats.exhausted, 1);
+  EXPECT_EQ(stats.heapAllocs, 0);
+
+  // Freed blocks get reused
+  void *first = *blocks.begin();
+  memPoolFree(&test_small, first);
+  EXPECT_EQ(memPoolAlloc(&test_small), first);
+
+  for(void *ptr : blocks) {
+    memPoolFree(&test_small, ptr);
+  }
+  memPoolFree(&test_small, NULL);
+  memPoolGetStats(&test_small, &stats);
+  EXPECT_EQ(stats.inUse, 0);
+  EXPECT_EQ(stats.highWater, 8);
+
+  int x;
+  EXPECT_FALSE(memPoolOwns(&test_small, &x));
+
+  // Shows up in the registry once used
+  bool found = false;
+  for(memPool_t *pool = memPoolsFirst(); pool; pool = pool->next) {
+    if(pool == &test_small) {
+      found = true;
+    }
+  }
+  EXPECT_TRUE(found);
+}
+
+TEST_F(MemPoolTest, HeapFallback)
+{
+  void *a = memPoolAlloc(&test_fallback);
+  void *b = memPoolAlloc(&test_fallback);
+  void *c = memPoolAlloc(&test_fallback);
+  ASSERT_NE(c, nullptr);
+  EXPECT_TRUE(memPoolOwns(&test_fallback, a));
+  EXPECT_TRUE(memPoolOwns(&test_fallback, b));
+  EXPECT_FALSE(memPoolOwns(&test_fallback, c));
+
+  // Too big for a block
+  void *big = memPoolAllocSize(&test_fallback, 100);
+  ASSERT_NE(big, nullptr);
+  EXPECT_FALSE(memPoolOwns(&test_fallback, big));
+  memset(big, 0, 100);
+
+  memPoolStats_t stats;
+  memPoolGetStats(&test_fallback, &stats);
+  EXPECT_EQ(stats.inUse, 2);
+  EXPECT_EQ(stats.exhausted, 1);
+  EXPECT_EQ(stats.heapAllocs, 2);
+
+  memPoolFree(&test_fallback, a);
+  memPoolFree(&test_fallback, b);
+  memPoolFree(&test_fallback, c);
+  memPoolFree(&test_fallback, big);
+  memPoolGetStats(&test_fallback, &stats);
+  EXPECT_EQ(stats.inUse, 0);
+
+  // Small sized allocations come from the pool
+  void *small = memPoolAllocSize(&test_fallback, 10);
+  EXPECT_TRUE(memPoolOwns(&test_fallback, small));
+  memPoolFree(&test_fallback, small);
+}
+
+// Hammer one pool from several threads. Each thread stamps its blocks and
+// checks nobody else was handed the same block.
+TEST_F(MemPoolTest, Concurrent)
+{
+  const uint32_t numThreads = 4;
+  const uint32_t iterations = 100000;
+  std::vector<std::thread> threads;
+  std::vector<uint32_t> errors(numThreads, 0);
+
+  for(uint32_t id = 0; id < numThreads; id++) {
+    threads.emplace_back([id, &errors, iterations]() {
+      uint32_t *held[8] = {};
+      for(uint32_t idx = 0; idx < iterations; idx++) {
+        uint32_t slot = idx % 8;
+        if(held[slot]) {
+          if(*held[slot] != ((id << 24) | slot)) {
+            errors[id]++;
+          }
+          memPoolFree(&test_threads, held[slot]);
+          held[slot] = NULL;
+        } else {
+          held[slot] = static_cast<uint32_t *>(memPoolAlloc(&test_threads));
+          if(held[slot]) {
+            *held[slot] = (id << 24) | slot;
+          }
+        }
+      }
+      for(uint32_t slot = 0; slot < 8; slot++) {
+        memPoolFree(&test_threads, held[slot]);
+      }
+    });
+  }
+  for(std::thread &thread : threads) {
+    thread.join();
+  }
+
+  for(uint32_t id = 0; id < numThreads; id++) {
+    EXPECT_EQ(errors[id], 0);
+  }
+
+  memPoolStats_t stats;
+  memPoolGetStats(&test_threads, &stats);
+  EXPECT_EQ(stats.inUse, 0);
+  EXPECT_LE(stats.highWater, numThreads * 8);
+
+  // All blocks are still reachable
+  std::set<void *> blocks;
+  for(uint32_t idx = 0; idx < 64; idx++) {
+    void *ptr = memPoolAlloc(&test_threads);
+    ASSERT_NE(ptr, nullptr);
+    blocks.insert(ptr);
+  }
+  EXPECT_EQ(blocks.size(), 64);
+  EXPECT_EQ(memPoolAlloc(&test_threads), nullptr);
+  for(void *ptr : blocks) {
+    memPoolFree(&test_threads, ptr);
+  }
+}
+
+// Not a pass/fail test, prints alloc+free cost on the host
+TEST_F(MemPoolTest, Benchmark)
+{
+  const uint32_t iterations = 1000000;
+  void *ptrs[4];
+
+  auto start = std::chrono::steady_clock::now();
+  for(uint32_t idx = 0; idx < iterations; idx++) {
+    ptrs[idx % 4] = memPoolAlloc(&test_bench);
+    if((idx % 4) == 3) {
+      for(void *ptr : ptrs) {
+        memPoolFree(&test_bench, ptr);
+      }
+    }
+  }
+  auto poolNs = std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - start).count();
+
+  start = std::chrono::steady_clock::now();
+  for(uint32_t idx = 0; idx < iterations; idx++) {
+    ptrs[idx % 4] = pvPortMalloc(64);
+    if((idx % 4) == 3) {
+      for(void *ptr : ptrs) {
+        vPortFree(ptr);
+      }
+    }
+  }
+  auto heapNs = std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - start).count();
+
+  // Leave a run of free holes too small for the request at the front of the
+  // heap, like after a while of small objects coming and going
+  std::vector<void *> holes;
+  std::vector<void *> background;
+  for(uint32_t idx = 0; idx < 64; idx++) {
+    holes.push_back(pvPortMalloc(24));
+    background.push_back(pvPortMalloc(32));
+  }
+  for(void *ptr : holes) {
+    vPortFree(ptr);
+  }
+
+  start = std::chrono::steady_clock::now();
+  for(uint32_t idx = 0; idx < iterations; idx++) {
+    ptrs[idx % 4] = pvPortMalloc(64);
+    if((idx % 4) == 3) {
+      for(void *ptr : ptrs) {
+        vPortFree(ptr);
+      }
+    }
+  }
+  auto fragNs = std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - start).count();
+
+  for(void *ptr : background) {
+    vPortFree(ptr);
+  }
+
+  printf("pool alloc+free:   %.1f ns\n", (double)poolNs / iterations);
+  printf("heap_4 alloc+free: %.1f ns (empty heap)\n", (double)heapNs / iterations);
+  printf("heap_4 alloc+free: %.1f ns (64 small free blocks)\n", (double)fragNs / iterations);
+}
+
+// Simulated long running node: long lived variable sized buffers (config,
+// frames, topics) mixed with lots of short lived small objects (list nodes,
+// driver events, DFU messages). Run once with everything on heap_4 and once
+// with the small objects in pools, and compare how the heap ends up.
+TEST_F(MemPoolTest, FragmentationSoak)
+{
+  MEM_POOL_DEFINE(soak_nodes, 16, 64, false);
+  MEM_POOL_DEFINE(soak_events, 48, 64, false);
+  MEM_POOL_DEFINE(soak_msgs, 1100, 3, false);
+
+  const uint32_t steps = 200000;
+  memPoolHeapReport_t before;
+  memPoolHeapReport(&before);
+
+  memPoolHeapReport_t reports[2];
+  for(uint32_t usePools = 0; usePools < 2; usePools++) {
+    uint32_t seed = 0x1234567;
+    std::vector<liveAlloc_t> live;
+
+    for(uint32_t step = 0; step < steps; step++) {
+      // Free everything that has expired
+      for(size_t idx = 0; idx < live.size();) {
+        if(live[idx].freeAt <= step) {
+          if(live[idx].pool) {
+            memPoolFree(live[idx].pool, live[idx].ptr);
+          } else {
+            vPortFree(live[idx].ptr);
+          }
+          live[idx] = live.back();
+          live.pop_back();
+        } else {
+          idx++;
+        }
+      }
+
+      uint32_t r = nextRand(seed);
+      liveAlloc_t alloc = {NULL, NULL, 0};
+      uint32_t kind = r % 100;
+      if(kind < 2) {
+        // Long lived, variable size (config buffers, topic strings, frames)
+        alloc.freeAt = step + 1000 + (nextRand(seed) % 5000);
+        alloc.ptr = pvPortMalloc(32 + (nextRand(seed) % 1500));
+      } else {
+        memPool_t *pool;
+        size_t size;
+        uint32_t lifetime;
+        if(kind < 50) {
+          pool = &soak_nodes;
+          size = 16;
+          lifetime = 1 + nextRand(seed) % 200;
+        } else if(kind < 98) {
+          pool = &soak_events;
+          size = 48;
+          lifetime = 1 + nextRand(seed) % 20;
+        } else {
+          pool = &soak_msgs;
+          size = 1100;
+          lifetime = 1 + nextRand(seed) % 3;
+        }
+        alloc.freeAt = step + lifetime;
+        if(usePools) {
+          alloc.pool = pool;
+          alloc.ptr = memPoolAlloc(pool);
+        } else {
+          alloc.ptr = pvPortMalloc(size);
+        }
+      }
+
+      if(alloc.ptr) {
+        live.push_back(alloc);
+      }
+    }
+
+    // Snapshot with only the long lived buffers still around
+    for(size_t idx = 0; idx < live.size();) {
+      if(live[idx].pool) {
+        memPoolFree(live[idx].pool, live[idx].ptr);
+        live[idx] = live.back();
+        live.pop_back();
+      } else {
+        idx++;
+      }
+    }
+    memPoolHeapReport(&reports[usePools]);
+
+    for(liveAlloc_t &alloc : live) {
+      vPortFree(alloc.ptr);
+    }
+  }
+
+  memPoolHeapReport_t after;
+  memPoolHeapReport(&after);
+
+  const char *names[] = {"heap only", "with pools"};
+  for(uint32_t idx = 0; idx < 2; idx++) {
+    printf("%-10s: free %u largest %u free_blocks %u frag %u.%02u%%\n", names[idx],
+           reports[idx].freeBytes, reports[idx].largestFreeBlock, reports[idx].numFreeBlocks,
+           reports[idx].fragmentationPctX100 / 100, reports[idx].fragmentationPctX100 % 100);
+  }
+
+  // Small objects no longer leave holes between the long lived buffers
+  EXPECT_LT(reports[1].numFreeBlocks, reports[0].numFreeBlocks);
+  EXPECT_LT(reports[1].fragmentationPctX100, reports[0].fragmentationPctX100);
+
+  // Everything went back to the heap in both runs
+  EXPECT_EQ(after.freeBytes, before.freeBytes);
+  EXPECT_EQ(after.numFreeBlocks, before.numFreeBlocks);
+}
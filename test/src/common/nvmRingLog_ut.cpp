@@ -0,0 +1,371 @@
+#include "gtest/gtest.h"
+
+#include "nvmRingLog.h"
+#include "ram_storage_driver.h"
+
+using namespace testing;
+
+static constexpr uint32_t SECTOR_SIZE = 4096;
+static constexpr uint32_t NUM_SECTORS = 4;
+
+// The fixture for testing class NvmRingLog.
+class NvmRingLogTest : public ::testing::Test {
+ protected:
+  // You can remove any or all of the following functions if its body
+  // is empty.
+
+  NvmRingLogTest() : _storage(SECTOR_SIZE * (NUM_SECTORS + 2)), _partition(_storage, _config) {
+     // You can do set-up work for each test here.
+  }
+
+  ~NvmRingLogTest() override {
+     // You can do clean-up work that doesn't throw exceptions here.
+  }
+
+  // If the constructor and destructor are not enough for setting up
+  // and cleaning up each test, you can define the following methods:
+
+  void SetUp() override {
+     // Code here will be called immediately after the constructor (right
+     // before each test).
+  }
+
+  void TearDown() override {
+     // Code here will be called immediately after each test (right
+     // before the destructor).
+  }
+
+  // Objects declared here can be used by all tests in the test suite for NvmRingLog.
+  const ext_flash_partition_t _config = {
+    .fa_off = SECTOR_SIZE,
+    .fa_size = SECTOR_SIZE * NUM_SECTORS,
+  };
+  RamStorageDriver _storage;
+  NvmPartition _partition;
+
+  // Records are a 32-bit counter followed by filler so a few fit per sector
+  static bool appendRecord(NvmRingLog &log, uint32_t value, uint16_t len=100) {
+    uint8_t buff[256];
+    memset(buff, static_cast<uint8_t>(value), sizeof(buff));
+    memcpy(buff, &value, sizeof(value));
+    return log.append(buff, len);
+  }
+
+  // expectedLen of 0 skips the length check
+  static bool readRecord(NvmRingLog &log, uint32_t &value, uint16_t expectedLen=100) {
+    uint8_t buff[SECTOR_SIZE];
+    uint16_t len = 0;
+    if(!log.peek(buff, sizeof(buff), len) || (expectedLen && (len != expectedLen))) {
+      return false;
+    }
+    memcpy(&value, buff, sizeof(value));
+    return log.pop();
+  }
+};
+
+TEST_F(NvmRingLogTest, FreshLog)
+{
+  NvmRingLog log(_partition);
+  EXPECT_TRUE(log.init());
+  EXPECT_TRUE(log.isEmpty());
+  EXPECT_EQ(log.numSectors(), NUM_SECTORS);
+  EXPECT_EQ(log.maxRecordLen(), SECTOR_SIZE - sizeof(NvmRingLogSectorHeader_t) - sizeof(NvmRingLogRecordHeader_t));
+
+  uint8_t buff[16];
+  uint16_t len;
+  EXPECT_FALSE(log.peek(buff, sizeof(buff), len));
+  EXPECT_FALSE(log.pop());
+
+  // Nothing to write yet
+  EXPECT_TRUE(log.flush());
+  EXPECT_EQ(_storage.writes, 0u);
+}
+
+TEST_F(NvmRingLogTest, AppendPeekPop)
+{
+  NvmRingLog log(_partition);
+  EXPECT_TRUE(log.init());
+
+  for(uint32_t i = 0; i < 5; i++) {
+    EXPECT_TRUE(appendRecord(log, i));
+  }
+  EXPECT_FALSE(log.isEmpty());
+  EXPECT_TRUE(log.needsFlush());
+
+  // Peek doesn't consume
+  uint8_t buff[256];
+  uint16_t len = 0;
+  uint32_t value = 0xFFFFFFFF;
+  EXPECT_TRUE(log.peek(buff, sizeof(buff), len));
+  EXPECT_TRUE(log.peek(buff, sizeof(buff), len));
+  memcpy(&value, buff, sizeof(value));
+  EXPECT_EQ(value, 0u);
+  EXPECT_EQ(len, 100);
+
+  // Buffer too small
+  EXPECT_FALSE(log.peek(buff, 10, len));
+
+  for(uint32_t i = 0; i < 5; i++) {
+    EXPECT_TRUE(readRecord(log, value));
+    EXPECT_EQ(value, i);
+  }
+  EXPECT_TRUE(log.isEmpty());
+  EXPECT_EQ(log.getStats().appended, 5u);
+  EXPECT_EQ(log.getStats().popped, 5u);
+}
+
+TEST_F(NvmRingLogTest, InvalidAppend)
+{
+  NvmRingLog log(_partition);
+  uint8_t buff[SECTOR_SIZE];
+  memset(buff, 0, sizeof(buff));
+
+  // Not initialized
+  EXPECT_FALSE(log.append(buff, 10));
+
+  EXPECT_TRUE(log.init());
+  EXPECT_FALSE(log.append(NULL, 10));
+  EXPECT_FALSE(log.append(buff, 0));
+  EXPECT_FALSE(log.append(buff, log.maxRecordLen() + 1));
+  EXPECT_TRUE(log.append(buff, log.maxRecordLen()));
+  EXPECT_TRUE(log.isEmpty() == false);
+}
+
+TEST_F(NvmRingLogTest, PersistsAfterFlush)
+{
+  {
+    NvmRingLog log(_partition);
+    EXPECT_TRUE(log.init());
+    for(uint32_t i = 0; i < 100; i++) {
+      EXPECT_TRUE(appendRecord(log, i));
+    }
+    EXPECT_TRUE(log.flush());
+    EXPECT_FALSE(log.needsFlush());
+
+    // Not flushed, so this one is lost
+    EXPECT_TRUE(appendRecord(log, 100));
+  }
+
+  NvmRingLog log(_partition);
+  EXPECT_TRUE(log.init());
+  uint32_t value;
+  for(uint32_t i = 0; i < 100; i++) {
+    EXPECT_TRUE(readRecord(log, value));
+    EXPECT_EQ(value, i);
+  }
+  EXPECT_TRUE(log.isEmpty());
+
+  // Appending after a restart continues where we left off
+  EXPECT_TRUE(appendRecord(log, 1234));
+  EXPECT_TRUE(readRecord(log, value));
+  EXPECT_EQ(value, 1234u);
+}
+
+TEST_F(NvmRingLogTest, FlushIsBatched)
+{
+  NvmRingLog log(_partition);
+  EXPECT_TRUE(log.init());
+
+  // A sector worth of records should only be written once
+  for(uint32_t i = 0; i < 30; i++) {
+    EXPECT_TRUE(appendRecord(log, i));
+  }
+  EXPECT_EQ(_storage.writes, 0u);
+  EXPECT_TRUE(log.flush());
+  EXPECT_EQ(_storage.writes, 1u);
+  EXPECT_EQ(log.getStats().flashWrites, 1u);
+}
+
+TEST_F(NvmRingLogTest, DrainedRecordsNotReplayed)
+{
+  {
+    NvmRingLog log(_partition);
+    EXPECT_TRUE(log.init());
+    for(uint32_t i = 0; i < 100; i++) {
+      EXPECT_TRUE(appendRecord(log, i));
+    }
+    EXPECT_TRUE(log.flush());
+
+    // Drain the first sector and then some
+    uint32_t value;
+    for(uint32_t i = 0; i < 50; i++) {
+      EXPECT_TRUE(readRecord(log, value));
+      EXPECT_EQ(value, i);
+    }
+  }
+
+  // Whatever wasn't in a drained sector is replayed, but nothing older than that
+  NvmRingLog log(_partition);
+  EXPECT_TRUE(log.init());
+  uint32_t value;
+  EXPECT_TRUE(readRecord(log, value));
+  EXPECT_GT(value, 0u);
+  EXPECT_LE(value, 49u);
+  uint32_t expected = value + 1;
+  while(readRecord(log, value)) {
+    EXPECT_EQ(value, expected);
+    expected++;
+  }
+  EXPECT_EQ(expected, 100u);
+}
+
+TEST_F(NvmRingLogTest, DropsOldestWhenFull)
+{
+  NvmRingLog log(_partition);
+  EXPECT_TRUE(log.init());
+
+  const uint32_t numRecords = 1000;
+  for(uint32_t i = 0; i < numRecords; i++) {
+    EXPECT_TRUE(appendRecord(log, i));
+  }
+  EXPECT_GT(log.getStats().droppedSectors, 0u);
+
+  // Oldest records are gone, but the rest are in order and end with the newest
+  uint32_t value;
+  EXPECT_TRUE(readRecord(log, value));
+  EXPECT_GT(value, 0u);
+  uint32_t expected = value + 1;
+  while(readRecord(log, value)) {
+    EXPECT_EQ(value, expected);
+    expected++;
+  }
+  EXPECT_EQ(expected, numRecords);
+}
+
+TEST_F(NvmRingLogTest, WrapAround)
+{
+  NvmRingLog log(_partition);
+  EXPECT_TRUE(log.init());
+
+  // Go around the ring several times while keeping up with the writer
+  uint32_t next = 0;
+  uint32_t value;
+  for(uint32_t i = 0; i < 2000; i++) {
+    EXPECT_TRUE(appendRecord(log, i, 50 + (i % 150)));
+    if(i % 3 == 2) {
+      EXPECT_TRUE(log.flush());
+      while(readRecord(log, value, 50 + (next % 150))) {
+        EXPECT_EQ(value, next);
+        next++;
+      }
+    }
+  }
+  EXPECT_EQ(log.getStats().droppedSectors, 0u);
+  EXPECT_EQ(log.getStats().corrupt, 0u);
+
+  // Restart in the middle of the ring
+  EXPECT_TRUE(appendRecord(log, 2000, 50 + (2000 % 150)));
+  EXPECT_TRUE(log.flush());
+
+  // Records already read from the last sector are replayed (at-least-once)
+  NvmRingLog log2(_partition);
+  EXPECT_TRUE(log2.init());
+  EXPECT_TRUE(readRecord(log2, value, 0));
+  EXPECT_LE(value, 2000u);
+  uint32_t expected = value + 1;
+  while(readRecord(log2, value, 50 + (expected % 150))) {
+    EXPECT_EQ(value, expected);
+    expected++;
+  }
+  EXPECT_EQ(expected, 2001u);
+}
+
+TEST_F(NvmRingLogTest, CorruptRecordSkipped)
+{
+  {
+    NvmRingLog log(_partition);
+    EXPECT_TRUE(log.init());
+    for(uint32_t i = 0; i < 60; i++) {
+      EXPECT_TRUE(appendRecord(log, i));
+    }
+    EXPECT_TRUE(log.flush());
+  }
+
+  // Flip a bit in the first record's data (first sector in the partition)
+  uint8_t *mem = _storage.mem();
+  mem[_config.fa_off + sizeof(NvmRingLogSectorHeader_t) + sizeof(NvmRingLogRecordHeader_t) + 10] ^= 0x01;
+
+  NvmRingLog log(_partition);
+  EXPECT_TRUE(log.init());
+  uint32_t value;
+  EXPECT_TRUE(readRecord(log, value));
+  EXPECT_EQ(value, 1u);
+  EXPECT_EQ(log.getStats().corrupt, 1u);
+}
+
+TEST_F(NvmRingLogTest, CorruptTailWhenFull)
+{
+  const uint32_t numRecords = 1000;
+  {
+    NvmRingLog log(_partition);
+    EXPECT_TRUE(log.init());
+    for(uint32_t i = 0; i < numRecords; i++) {
+      EXPECT_TRUE(appendRecord(log, i));
+    }
+    EXPECT_TRUE(log.flush());
+  }
+
+  // Scribble on the unused end of the newest sector
+  uint8_t *mem = _storage.mem();
+  uint32_t newestSector = 0;
+  uint32_t newestSeq = 0;
+  for(uint32_t sector = 0; sector < NUM_SECTORS; sector++) {
+    NvmRingLogSectorHeader_t header;
+    memcpy(&header, &mem[_config.fa_off + sector * SECTOR_SIZE], sizeof(header));
+    if(header.seq > newestSeq) {
+      newestSector = sector;
+      newestSeq = header.seq;
+    }
+  }
+  uint8_t *tail = &mem[_config.fa_off + (newestSector + 1) * SECTOR_SIZE - 1];
+  ASSERT_EQ(*tail, 0xFF);
+  *tail = 0;
+
+  // The log is full, so the new write sector replaces the oldest one and
+  // reading starts after it
+  NvmRingLog log(_partition);
+  EXPECT_TRUE(log.init());
+  EXPECT_EQ(log.getStats().corrupt, 1u);
+  EXPECT_EQ(log.getStats().droppedSectors, 1u);
+
+  uint32_t value;
+  EXPECT_TRUE(readRecord(log, value));
+  EXPECT_GT(value, 0u);
+  uint32_t expected = value + 1;
+  while(readRecord(log, value)) {
+    EXPECT_EQ(value, expected);
+    expected++;
+  }
+  EXPECT_EQ(expected, numRecords);
+}
+
+TEST_F(NvmRingLogTest, Clear)
+{
+  NvmRingLog log(_partition);
+  EXPECT_TRUE(log.init());
+  for(uint32_t i = 0; i < 100; i++) {
+    EXPECT_TRUE(appendRecord(log, i));
+  }
+  EXPECT_TRUE(log.flush());
+  EXPECT_TRUE(log.clear());
+  EXPECT_TRUE(log.isEmpty());
+
+  NvmRingLog log2(_partition);
+  EXPECT_TRUE(log2.init());
+  EXPECT_TRUE(log2.isEmpty());
+}
+
+TEST_F(NvmRingLogTest, FlushFailure)
+{
+  NvmRingLog log(_partition);
+  EXPECT_TRUE(log.init());
+  EXPECT_TRUE(appendRecord(log, 0));
+
+  _storage.failWrites = true;
+  EXPECT_FALSE(log.flush());
+  EXPECT_TRUE(log.needsFlush());
+
+  _storage.failWrites = false;
+  EXPECT_TRUE(log.flush());
+  EXPECT_FALSE(log.needsFlush());
+}
@@ -0,0 +1,177 @@
+#include "gtest/gtest.h"
+
+#include <string.h>
+
+#include "FreeRTOS.h"
+#include "task.h"
+#include "perf_counters.h"
+
+// Minimal FreeRTOS implementations for perf_counters.c
+static UBaseType_t _queueWaiting;
+static UBaseType_t _queueSpaces;
+static HeapStats_t _heapStats;
+
+extern "C" {
+UBaseType_t uxQueueMessagesWaiting(const QueueHandle_t xQueue) {
+  (void)xQueue;
+  return _queueWaiting;
+}
+
+UBaseType_t uxQueueMessagesWaitingFromISR(const QueueHandle_t xQueue) {
+  (void)xQueue;
+  return _queueWaiting;
+}
+
+UBaseType_t uxQueueSpacesAvailable(const QueueHandle_t xQueue) {
+  (void)xQueue;
+  return _queueSpaces;
+}
+
+void vPortGetHeapStats(HeapStats_t *pxHeapStats) {
+  *pxHeapStats = _heapStats;
+}
+
+UBaseType_t uxTaskGetNumberOfTasks(void) {
+  return 2;
+}
+
+UBaseType_t uxTaskGetSystemState(TaskStatus_t * const pxTaskStatusArray,
+                                 const UBaseType_t uxArraySize,
+                                 configRUN_TIME_COUNTER_TYPE * const pulTotalRunTime) {
+  static const char *names[] = {"IDLE", "busy"};
+  static const configRUN_TIME_COUNTER_TYPE runTimes[] = {750, 250};
+  UBaseType_t numTasks = 0;
+  for(; (numTasks < uxArraySize) && (numTasks < 2); numTasks++) {
+    memset(&pxTaskStatusArray[numTasks], 0, sizeof(TaskStatus_t));
+    pxTaskStatusArray[numTasks].pcTaskName = names[numTasks];
+    pxTaskStatusArray[numTasks].ulRunTimeCounter = runTimes[numTasks];
+    pxTaskStatusArray[numTasks].usStackHighWaterMark = 100 + numTasks;
+  }
+  *pulTotalRunTime = 1000;
+  return numTasks;
+}
+}
+
+// The registry is global and counters can't be unregistered, so every
+// test uses its own counters/queue names.
+static int _dummyQueue;
+#define DUMMY_QUEUE reinterpret_cast<QueueHandle_t>(&_dummyQueue)
+
+// The fixture for testing performance counters.
+class PerfCountersTest : public ::testing::Test {
+ protected:
+  PerfCountersTest() {
+  }
+
+  ~PerfCountersTest() override {
+  }
+
+  void SetUp() override {
+    _queueWaiting = 0;
+    _queueSpaces = 0;
+    memset(&_heapStats, 0, sizeof(_heapStats));
+  }
+
+  void TearDown() override {
+  }
+};
+
+TEST_F(PerfCountersTest, RegisterAndFind) {
+  static perfCounter_t counter;
+  perfCounterRegister(&counter, "test", "find", PERF_COUNTER_TYPE_COUNT);
+
+  EXPECT_EQ(perfCounterFind("test", "find"), &counter);
+  EXPECT_EQ(perfCounterFind("test", "missing"), nullptr);
+  EXPECT_EQ(perfCounterFind("missing", "find"), nullptr);
+
+  perfCounterInc(&counter);
+  perfCounterAdd(&counter, 4);
+  EXPECT_EQ(perfCounterGet("test", "find"), 5u);
+  EXPECT_EQ(perfCounterGet("test", "missing"), 0u);
+
+  // Registry iteration must include the counter
+  bool found = false;
+  for(perfCounter_t *iter = perfCountersFirst(); iter; iter = iter->next) {
+    found |= (iter == &counter);
+  }
+  EXPECT_TRUE(found);
+
+  // NULL counters are ignored
+  perfCounterInc(NULL);
+  perfCounterMax(NULL, 1);
+  perfCounterSet(NULL, 1);
+}
+
+TEST_F(PerfCountersTest, MaxAndReset) {
+  static perfCounter_t count, max, gauge;
+  perfCounterRegister(&count, "test", "reset_count", PERF_COUNTER_TYPE_COUNT);
+  perfCounterRegister(&max, "test", "reset_max", PERF_COUNTER_TYPE_MAX);
+  perfCounterRegister(&gauge, "test", "reset_gauge", PERF_COUNTER_TYPE_GAUGE);
+
+  perfCounterMax(&max, 10);
+  perfCounterMax(&max, 3);
+  EXPECT_EQ(max.value, 10u);
+  perfCounterMax(&max, 11);
+  EXPECT_EQ(max.value, 11u);
+
+  perfCounterAdd(&count, 7);
+  perfCounterSet(&gauge, 42);
+
+  // Only counts and maximums are cleared
+  perfCountersReset();
+  EXPECT_EQ(count.value, 0u);
+  EXPECT_EQ(max.value, 0u);
+  EXPECT_EQ(gauge.value, 42u);
+}
+
+TEST_F(PerfCountersTest, Queue) {
+  static perfQueue_t perfQueue;
+  _queueSpaces = 8;
+  perfQueueRegister(&perfQueue, "test_q", DUMMY_QUEUE);
+  EXPECT_EQ(perfCounterGet("test_q", "capacity"), 8u);
+
+  _queueWaiting = 3;
+  perfQueueSent(&perfQueue);
+  _queueWaiting = 1;
+  perfQueueSentFromISR(&perfQueue);
+  EXPECT_EQ(perfCounterGet("test_q", "sent"), 2u);
+  EXPECT_EQ(perfCounterGet("test_q", "hwm"), 3u);
+  EXPECT_EQ(perfCounterGet("test_q", "dropped"), 0u);
+
+  // Drops mean the queue was full
+  perfQueueDropped(&perfQueue);
+  EXPECT_EQ(perfCounterGet("test_q", "dropped"), 1u);
+  EXPECT_EQ(perfCounterGet("test_q", "hwm"), 8u);
+  EXPECT_EQ(perfCounterGet("test_q", "capacity"), 8u);
+}
+
+TEST_F(PerfCountersTest, Heap) {
+  _heapStats.xAvailableHeapSpaceInBytes = 1000;
+  _heapStats.xMinimumEverFreeBytesRemaining = 500;
+  _heapStats.xSizeOfLargestFreeBlockInBytes = 200;
+
+  perfCountersSample();
+  EXPECT_EQ(perfCounterGet("heap", "free"), 1000u);
+  EXPECT_EQ(perfCounterGet("heap", "min_free"), 500u);
+  EXPECT_EQ(perfCounterGet("heap", "largest_free"), 200u);
+
+  // Built-in counters are only registered once
+  perfCountersInit();
+  uint32_t heapCounters = 0;
+  for(perfCounter_t *iter = perfCountersFirst(); iter; iter = iter->next) {
+    heapCounters += (strcmp(iter->group, "heap") == 0);
+  }
+  EXPECT_EQ(heapCounters, 3u);
+}
+
+TEST_F(PerfCountersTest, Tasks) {
+  perfTaskStats_t stats[4];
+  EXPECT_EQ(perfTasksSample(stats, 4), 2u);
+  EXPECT_STREQ(stats[0].name, "IDLE");
+  EXPECT_EQ(stats[0].cpuPctX100, 7500u);
+  EXPECT_EQ(stats[1].cpuPctX100, 2500u);
+  EXPECT_EQ(stats[1].stackHighWaterMark, 101u);
+
+  // Don't overrun the caller's array
+  EXPECT_EQ(perfTasksSample(stats, 1), 1u);
+}
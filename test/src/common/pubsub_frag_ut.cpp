@@ -0,0 +1,284 @@
+#include "gtest/gtest.h"
+
+#include <stdlib.h>
+#include <string.h>
+#include <algorithm>
+#include <random>
+#include <vector>
+
+#include "pubsub_frag.h"
+
+using namespace testing;
+
+#define TIMEOUT_MS (1000)
+#define TOPIC_HASH (0x12345678)
+
+// Reassembly buffer handed to the module (stands in for a pbuf)
+typedef struct {
+  uint16_t len;
+  uint8_t data[0];
+} testMsg_t;
+
+// The fixture for testing class Foo.
+class PubSubFragTest : public ::testing::Test {
+ protected:
+  // You can remove any or all of the following functions if its body
+  // is empty.
+
+  PubSubFragTest() {
+     // You can do set-up work for each test here.
+  }
+
+  ~PubSubFragTest() override {
+     // You can do clean-up work that doesn't throw exceptions here.
+  }
+
+  // If the constructor and destructor are not enough for setting up
+  // and cleaning up each test, you can define the following methods:
+
+  void SetUp() override {
+     // Code here will be called immediately after the constructor (right
+     // before each test).
+    allocated = 0;
+    failAlloc = false;
+    pubsubFragRxInit(&rx, TIMEOUT_MS, allocCb, freeCb);
+  }
+
+  void TearDown() override {
+     // Code here will be called immediately after each test (right
+     // before the destructor).
+    EXPECT_EQ(allocated, 0);
+  }
+
+  // Objects declared here can be used by all tests in the test suite for Foo.
+  pubsubFragRx_t rx;
+  static int32_t allocated;
+  static bool failAlloc;
+
+  static void *allocCb(uint16_t len, uint8_t **data) {
+    if(failAlloc) {
+      return NULL;
+    }
+    testMsg_t *msg = static_cast<testMsg_t *>(malloc(sizeof(testMsg_t) + len));
+    msg->len = len;
+    *data = msg->data;
+    allocated++;
+    return msg;
+  }
+
+  static void freeCb(void *msg) {
+    allocated--;
+    free(msg);
+  }
+
+  static std::vector<uint8_t> makeMsg(uint16_t len, uint8_t seed) {
+    std::vector<uint8_t> msg(len);
+    for(uint32_t idx = 0; idx < len; idx++) {
+      msg[idx] = (uint8_t)(idx * 7 + seed);
+    }
+    return msg;
+  }
+
+  static pubsubFragHeader_t header(uint16_t msgId, uint8_t index, uint16_t totalLen) {
+    pubsubFragHeader_t hdr = {msgId, index, pubsubFragCount(totalLen), totalLen, TOPIC_HASH};
+    return hdr;
+  }
+
+  pubsubFragRxResult_e add(uint64_t nodeId, uint16_t msgId, uint8_t index, const std::vector<uint8_t> &msg, uint32_t now, void **out) {
+    pubsubFragHeader_t hdr = header(msgId, index, msg.size());
+    return pubsubFragRxAdd(&rx, nodeId, &hdr, &msg[index * PUBSUB_FRAG_DATA_LEN], pubsubFragLen(msg.size(), index), now, out);
+  }
+
+  void expectMsg(void *out, const std::vector<uint8_t> &msg) {
+    ASSERT_NE(out, nullptr);
+    testMsg_t *tmsg = static_cast<testMsg_t *>(out);
+    ASSERT_EQ(tmsg->len, msg.size());
+    EXPECT_EQ(memcmp(tmsg->data, msg.data(), msg.size()), 0);
+    freeCb(out);
+  }
+};
+
+int32_t PubSubFragTest::allocated;
+bool PubSubFragTest::failAlloc;
+
+TEST_F(PubSubFragTest, Lengths) {
+  EXPECT_EQ(pubsubFragCount(1), 1);
+  EXPECT_EQ(pubsubFragCount(PUBSUB_FRAG_DATA_LEN), 1);
+  EXPECT_EQ(pubsubFragCount(PUBSUB_FRAG_DATA_LEN + 1), 2);
+  EXPECT_EQ(pubsubFragCount(UINT16_MAX), PUBSUB_FRAG_MAX_FRAGMENTS);
+
+  // Fragments are tracked in a 64 bit mask
+  EXPECT_LE(PUBSUB_FRAG_MAX_FRAGMENTS, 64);
+
+  EXPECT_EQ(pubsubFragLen(3000, 0), PUBSUB_FRAG_DATA_LEN);
+  EXPECT_EQ(pubsubFragLen(3000, 1), PUBSUB_FRAG_DATA_LEN);
+  EXPECT_EQ(pubsubFragLen(3000, 2), 3000 - 2 * PUBSUB_FRAG_DATA_LEN);
+  EXPECT_EQ(pubsubFragLen(3000, 3), 0);
+}
+
+TEST_F(PubSubFragTest, InOrder) {
+  std::vector<uint8_t> msg = makeMsg(3500, 1);
+  void *out = NULL;
+
+  uint8_t count = pubsubFragCount(msg.size());
+  for(uint8_t idx = 0; idx < count - 1; idx++) {
+    EXPECT_EQ(add(1, 10, idx, msg, 0, &out), PUBSUB_FRAG_RX_PENDING);
+  }
+  EXPECT_EQ(add(1, 10, count - 1, msg, 0, &out), PUBSUB_FRAG_RX_COMPLETE);
+  expectMsg(out, msg);
+
+  EXPECT_EQ(allocated, 0);
+}
+
+TEST_F(PubSubFragTest, OutOfOrderWithDuplicates) {
+  std::vector<uint8_t> msg = makeMsg(4000, 2);
+  void *out = NULL;
+
+  EXPECT_EQ(add(1, 10, 2, msg, 0, &out), PUBSUB_FRAG_RX_PENDING);
+  EXPECT_EQ(add(1, 10, 2, msg, 0, &out), PUBSUB_FRAG_RX_DUPLICATE);
+  EXPECT_EQ(add(1, 10, 0, msg, 0, &out), PUBSUB_FRAG_RX_PENDING);
+  EXPECT_EQ(add(1, 10, 1, msg, 0, &out), PUBSUB_FRAG_RX_COMPLETE);
+  expectMsg(out, msg);
+}
+
+TEST_F(PubSubFragTest, Invalid) {
+  uint8_t data[PUBSUB_FRAG_DATA_LEN] = {};
+  void *out = NULL;
+
+  // Wrong count
+  pubsubFragHeader_t hdr = {1, 0, 4, 3000, TOPIC_HASH};
+  EXPECT_EQ(pubsubFragRxAdd(&rx, 1, &hdr, data, PUBSUB_FRAG_DATA_LEN, 0, &out), PUBSUB_FRAG_RX_INVALID);
+
+  // Index out of range
+  hdr = header(1, 3, 3000);
+  EXPECT_EQ(pubsubFragRxAdd(&rx, 1, &hdr, data, 200, 0, &out), PUBSUB_FRAG_RX_INVALID);
+
+  // Wrong length
+  hdr = header(1, 0, 3000);
+  EXPECT_EQ(pubsubFragRxAdd(&rx, 1, &hdr, data, 100, 0, &out), PUBSUB_FRAG_RX_INVALID);
+
+  // Empty message
+  hdr = header(1, 0, 0);
+  EXPECT_EQ(pubsubFragRxAdd(&rx, 1, &hdr, data, 0, 0, &out), PUBSUB_FRAG_RX_INVALID);
+
+  // Total length changes mid message
+  hdr = header(1, 0, 3000);
+  EXPECT_EQ(pubsubFragRxAdd(&rx, 1, &hdr, data, PUBSUB_FRAG_DATA_LEN, 0, &out), PUBSUB_FRAG_RX_PENDING);
+  hdr = header(1, 1, 4000);
+  EXPECT_EQ(pubsubFragRxAdd(&rx, 1, &hdr, data, PUBSUB_FRAG_DATA_LEN, 0, &out), PUBSUB_FRAG_RX_INVALID);
+
+  uint32_t expired;
+  pubsubFragRxPoll(&rx, TIMEOUT_MS, &expired);
+  EXPECT_EQ(expired, 1);
+}
+
+TEST_F(PubSubFragTest, Interleaved) {
+  // Same message id from two nodes, plus a second message from one of them
+  std::vector<uint8_t> msgA = makeMsg(3000, 3);
+  std::vector<uint8_t> msgB = makeMsg(2000, 4);
+  void *out = NULL;
+
+  EXPECT_EQ(add(1, 10, 0, msgA, 0, &out), PUBSUB_FRAG_RX_PENDING);
+  EXPECT_EQ(add(2, 10, 0, msgB, 0, &out), PUBSUB_FRAG_RX_PENDING);
+  EXPECT_EQ(add(1, 10, 1, msgA, 0, &out), PUBSUB_FRAG_RX_PENDING);
+  EXPECT_EQ(add(2, 10, 1, msgB, 0, &out), PUBSUB_FRAG_RX_COMPLETE);
+  expectMsg(out, msgB);
+
+  // Both slots were busy until msgB finished
+  std::vector<uint8_t> msgC = makeMsg(2000, 5);
+  EXPECT_EQ(add(1, 11, 1, msgC, 0, &out), PUBSUB_FRAG_RX_PENDING);
+  EXPECT_EQ(add(1, 10, 2, msgA, 0, &out), PUBSUB_FRAG_RX_COMPLETE);
+  expectMsg(out, msgA);
+  EXPECT_EQ(add(1, 11, 0, msgC, 0, &out), PUBSUB_FRAG_RX_COMPLETE);
+  expectMsg(out, msgC);
+}
+
+TEST_F(PubSubFragTest, NoRoom) {
+  std::vector<uint8_t> big = makeMsg(PUBSUB_FRAG_RX_MAX_LEN + 1, 6);
+  std::vector<uint8_t> small = makeMsg(3000, 7);
+  void *out = NULL;
+
+  // All slots busy
+  for(uint32_t idx = 0; idx < PUBSUB_FRAG_RX_SLOTS; idx++) {
+    EXPECT_EQ(add(idx, 1, 0, small, 0, &out), PUBSUB_FRAG_RX_PENDING);
+  }
+  EXPECT_EQ(add(100, 1, 0, small, 0, &out), PUBSUB_FRAG_RX_NO_ROOM);
+  pubsubFragRxPoll(&rx, TIMEOUT_MS, NULL);
+  EXPECT_EQ(allocated, 0);
+
+  // Too big to reassemble (never allocated)
+  EXPECT_EQ(add(1, 1, 0, big, 0, &out), PUBSUB_FRAG_RX_NO_ROOM);
+  EXPECT_EQ(allocated, 0);
+  EXPECT_EQ(add(2, 2, 0, small, 0, &out), PUBSUB_FRAG_RX_PENDING);
+  pubsubFragRxPoll(&rx, TIMEOUT_MS, NULL);
+  EXPECT_EQ(allocated, 0);
+
+  // Out of memory
+  failAlloc = true;
+  EXPECT_EQ(add(1, 1, 0, small, 0, &out), PUBSUB_FRAG_RX_NO_ROOM);
+  EXPECT_EQ(allocated, 0);
+}
+
+TEST_F(PubSubFragTest, Timeout) {
+  std::vector<uint8_t> msg = makeMsg(3000, 8);
+  void *out = NULL;
+  uint32_t expired;
+
+  // Start right before the ms counter wraps
+  uint32_t now = UINT32_MAX - 500;
+  EXPECT_EQ(pubsubFragRxPoll(&rx, now, &expired), PUBSUB_FRAG_NO_TIMEOUT);
+
+  // Each fragment restarts the timer
+  EXPECT_EQ(add(1, 1, 0, msg, now, &out), PUBSUB_FRAG_RX_PENDING);
+  now += TIMEOUT_MS - 1;
+  EXPECT_EQ(pubsubFragRxPoll(&rx, now, &expired), 1);
+  EXPECT_EQ(expired, 0);
+  EXPECT_EQ(add(1, 1, 1, msg, now, &out), PUBSUB_FRAG_RX_PENDING);
+  now += TIMEOUT_MS - 1;
+  EXPECT_EQ(pubsubFragRxPoll(&rx, now, &expired), 1);
+
+  now++;
+  EXPECT_EQ(pubsubFragRxPoll(&rx, now, &expired), PUBSUB_FRAG_NO_TIMEOUT);
+  EXPECT_EQ(expired, 1);
+
+  // A late fragment starts over (and never completes)
+  EXPECT_EQ(add(1, 1, 2, msg, now, &out), PUBSUB_FRAG_RX_PENDING);
+
+  // Stale messages are also dropped when new fragments show up
+  now += TIMEOUT_MS;
+  EXPECT_EQ(add(2, 1, 0, msg, now, &out), PUBSUB_FRAG_RX_PENDING);
+  EXPECT_EQ(allocated, 1);
+  pubsubFragRxPoll(&rx, now + TIMEOUT_MS, NULL);
+}
+
+TEST_F(PubSubFragTest, ShuffledMaxLen) {
+  std::mt19937 rng(48);
+  std::vector<uint8_t> msg = makeMsg(PUBSUB_FRAG_RX_MAX_LEN, 9);
+  void *out = NULL;
+
+  uint8_t count = pubsubFragCount(msg.size());
+  std::vector<uint8_t> order;
+  for(uint8_t idx = 0; idx < count; idx++) {
+    order.push_back(idx);
+    // Some get duplicated on the way
+    if((rng() % 10) == 0) {
+      order.push_back(idx);
+    }
+  }
+  std::shuffle(order.begin(), order.end(), rng);
+
+  uint32_t complete = 0;
+  for(uint8_t idx : order) {
+    pubsubFragRxResult_e result = add(1, 7, idx, msg, 0, &out);
+    if(result == PUBSUB_FRAG_RX_COMPLETE) {
+      complete++;
+      expectMsg(out, msg);
+    } else {
+      EXPECT_TRUE((result == PUBSUB_FRAG_RX_PENDING) || (result == PUBSUB_FRAG_RX_DUPLICATE));
+    }
+  }
+  EXPECT_EQ(complete, 1);
+
+  // Duplicates that show up after completion start a new message that times out
+  pubsubFragRxPoll(&rx, TIMEOUT_MS, NULL);
+}
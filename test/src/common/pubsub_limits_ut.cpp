@@ -0,0 +1,265 @@
+#include "gtest/gtest.h"
+
+#include <stdio.h>
+#include <string.h>
+
+#include "pubsub_limits.h"
+
+using namespace testing;
+
+#define NODE_A (0x1111222233334444ULL)
+#define NODE_B (0x5555666677778888ULL)
+
+// The fixture for testing class Foo.
+class PubSubLimitsTest : public ::testing::Test {
+ protected:
+  // You can remove any or all of the following functions if its body
+  // is empty.
+
+  PubSubLimitsTest() {
+     // You can do set-up work for each test here.
+  }
+
+  ~PubSubLimitsTest() override {
+     // You can do clean-up work that doesn't throw exceptions here.
+  }
+
+  // If the constructor and destructor are not enough for setting up
+  // and cleaning up each test, you can define the following methods:
+
+  void SetUp() override {
+     // Code here will be called immediately after the constructor (right
+     // before each test).
+    pubsubLimitsInit(&limits);
+  }
+
+  void TearDown() override {
+     // Code here will be called immediately after each test (right
+     // before the destructor).
+  }
+
+  // Objects declared here can be used by all tests in the test suite for Foo.
+  pubsubLimits_t limits;
+
+  bool setTopic(uint32_t hash, const char *name, pubsubPrio_e prio, uint32_t rateBps, uint32_t burstBytes, uint32_t now) {
+    return pubsubLimitsSetTopic(&limits, hash, name, strlen(name), prio, rateBps, burstBytes, now);
+  }
+
+  bool tx(uint32_t hash, const char *name, uint32_t bytes, uint32_t now) {
+    return pubsubLimitsTx(&limits, hash, name, strlen(name), bytes, now);
+  }
+
+  bool rx(uint64_t node, uint32_t hash, const char *name, uint32_t bytes, uint32_t now) {
+    return pubsubLimitsRx(&limits, node, hash, name, name ? strlen(name) : 0, bytes, now);
+  }
+
+  const pubsubLimitsTopic_t *topic(uint32_t hash) {
+    for(uint32_t idx = 0; idx < PUBSUB_LIMITS_MAX_TOPICS; idx++) {
+      if(limits.topics[idx].valid && (limits.topics[idx].topicHash == hash)) {
+        return &limits.topics[idx];
+      }
+    }
+    return NULL;
+  }
+};
+
+TEST_F(PubSubLimitsTest, Bucket) {
+  pubsubBucket_t bucket;
+
+  // Unlimited
+  pubsubBucketInit(&bucket, 0, 0, 0);
+  EXPECT_TRUE(pubsubBucketTake(&bucket, UINT32_MAX, 0));
+
+  // Starts full
+  pubsubBucketInit(&bucket, 1000, 100, 0);
+  EXPECT_TRUE(pubsubBucketTake(&bucket, 60, 0));
+  EXPECT_FALSE(pubsubBucketTake(&bucket, 60, 0));
+  EXPECT_TRUE(pubsubBucketTake(&bucket, 40, 0));
+  EXPECT_FALSE(pubsubBucketTake(&bucket, 1, 0));
+
+  // 1 byte per ms
+  EXPECT_FALSE(pubsubBucketTake(&bucket, 10, 9));
+  EXPECT_TRUE(pubsubBucketTake(&bucket, 10, 10));
+
+  // Never more than the burst size
+  EXPECT_TRUE(pubsubBucketTake(&bucket, 100, 10000));
+  EXPECT_FALSE(pubsubBucketTake(&bucket, 1, 10000));
+
+  // Larger than the burst only needs a full bucket
+  EXPECT_FALSE(pubsubBucketTake(&bucket, 500, 10050));
+  EXPECT_TRUE(pubsubBucketTake(&bucket, 500, 10100));
+}
+
+TEST_F(PubSubLimitsTest, SlowRate) {
+  pubsubBucket_t bucket;
+
+  // Burst defaults to one second's worth, partial bytes add up
+  pubsubBucketInit(&bucket, 10, 0, 0);
+  EXPECT_EQ(bucket.burstBytes, 10);
+  EXPECT_TRUE(pubsubBucketTake(&bucket, 10, 0));
+  for(uint32_t now = 10; now < 100; now += 10) {
+    EXPECT_FALSE(pubsubBucketTake(&bucket, 1, now));
+  }
+  EXPECT_TRUE(pubsubBucketTake(&bucket, 1, 100));
+}
+
+TEST_F(PubSubLimitsTest, TimeWrap) {
+  pubsubBucket_t bucket;
+  uint32_t now = UINT32_MAX - 5;
+
+  pubsubBucketInit(&bucket, 1000, 10, now);
+  EXPECT_TRUE(pubsubBucketTake(&bucket, 10, now));
+  EXPECT_TRUE(pubsubBucketTake(&bucket, 10, now + 10));
+}
+
+TEST_F(PubSubLimitsTest, TopicTx) {
+  EXPECT_TRUE(setTopic(1, "hydrophone/stream", PUBSUB_PRIO_LOW, 1000, 100, 0));
+  EXPECT_EQ(pubsubLimitsPriority(&limits, 1), PUBSUB_PRIO_LOW);
+  EXPECT_EQ(pubsubLimitsPriority(&limits, 2), PUBSUB_PRIO_NORMAL);
+
+  EXPECT_TRUE(tx(1, "hydrophone/stream", 100, 0));
+  EXPECT_FALSE(tx(1, "hydrophone/stream", 100, 50));
+  EXPECT_TRUE(tx(1, "hydrophone/stream", 100, 100));
+
+  // Other topics aren't limited
+  for(uint32_t idx = 0; idx < 10; idx++) {
+    EXPECT_TRUE(tx(2, "temp", 100, 100));
+  }
+
+  const pubsubLimitsTopic_t *entry = topic(1);
+  ASSERT_NE(entry, nullptr);
+  EXPECT_STREQ(entry->name, "hydrophone/stream");
+  EXPECT_EQ(entry->counters.txMsgs, 2);
+  EXPECT_EQ(entry->counters.txBytes, 200);
+  EXPECT_EQ(entry->counters.txDropped, 1);
+
+  entry = topic(2);
+  ASSERT_NE(entry, nullptr);
+  EXPECT_FALSE(entry->configured);
+  EXPECT_EQ(entry->counters.txMsgs, 10);
+  EXPECT_EQ(entry->counters.txDropped, 0);
+}
+
+TEST_F(PubSubLimitsTest, TopicRx) {
+  EXPECT_TRUE(setTopic(1, "stream", PUBSUB_PRIO_LOW, 1000, 100, 0));
+
+  // TX and RX have their own buckets
+  EXPECT_TRUE(tx(1, "stream", 100, 0));
+  EXPECT_TRUE(rx(NODE_A, 1, "stream", 100, 0));
+  EXPECT_FALSE(rx(NODE_B, 1, "stream", 100, 0));
+
+  const pubsubLimitsTopic_t *entry = topic(1);
+  ASSERT_NE(entry, nullptr);
+  EXPECT_EQ(entry->counters.rxMsgs, 1);
+  EXPECT_EQ(entry->counters.rxBytes, 100);
+  EXPECT_EQ(entry->counters.rxDropped, 1);
+}
+
+TEST_F(PubSubLimitsTest, SetPriority) {
+  EXPECT_TRUE(setTopic(1, "stream", PUBSUB_PRIO_LOW, 1000, 100, 0));
+
+  // Keeps the limit
+  EXPECT_TRUE(pubsubLimitsSetPriority(&limits, 1, "stream", 6, PUBSUB_PRIO_HIGH, 0));
+  EXPECT_EQ(pubsubLimitsPriority(&limits, 1), PUBSUB_PRIO_HIGH);
+  EXPECT_TRUE(tx(1, "stream", 100, 0));
+  EXPECT_FALSE(tx(1, "stream", 100, 0));
+
+  // Topics without one stay unlimited
+  EXPECT_TRUE(pubsubLimitsSetPriority(&limits, 2, "alarm", 5, PUBSUB_PRIO_HIGH, 0));
+  EXPECT_EQ(pubsubLimitsPriority(&limits, 2), PUBSUB_PRIO_HIGH);
+  EXPECT_TRUE(tx(2, "alarm", 1000, 0));
+  EXPECT_TRUE(tx(2, "alarm", 1000, 0));
+}
+
+TEST_F(PubSubLimitsTest, Publisher) {
+  pubsubLimitsSetPublisher(&limits, 1000, 100, 0);
+
+  // Each publisher has its own bucket
+  EXPECT_TRUE(rx(NODE_A, 1, "a", 100, 0));
+  EXPECT_FALSE(rx(NODE_A, 2, "b", 100, 0));
+  EXPECT_TRUE(rx(NODE_B, 1, "a", 100, 0));
+
+  // Fragments (no topic) count too
+  EXPECT_FALSE(rx(NODE_B, 0, NULL, 10, 0));
+  EXPECT_EQ(limits.other.rxDropped, 1);
+  EXPECT_TRUE(rx(NODE_B, 0, NULL, 10, 10));
+  EXPECT_EQ(limits.other.rxMsgs, 1);
+
+  EXPECT_EQ(topic(2)->counters.rxDropped, 1);
+  for(uint32_t idx = 0; idx < PUBSUB_LIMITS_MAX_PUBLISHERS; idx++) {
+    if(limits.publishers[idx].valid && (limits.publishers[idx].nodeId == NODE_A)) {
+      EXPECT_EQ(limits.publishers[idx].dropped, 1);
+    }
+  }
+
+  // Turning it off lets everything through
+  pubsubLimitsSetPublisher(&limits, 0, 0, 20);
+  EXPECT_TRUE(rx(NODE_A, 1, "a", 1000, 20));
+  EXPECT_TRUE(rx(NODE_A, 1, "a", 1000, 20));
+}
+
+TEST_F(PubSubLimitsTest, PublisherEviction) {
+  pubsubLimitsSetPublisher(&limits, 1000, 100, 0);
+
+  // Use up the first publisher's bucket
+  EXPECT_TRUE(rx(1, 1, "a", 100, 0));
+  for(uint64_t node = 2; node <= PUBSUB_LIMITS_MAX_PUBLISHERS; node++) {
+    EXPECT_TRUE(rx(node, 1, "a", 1, node));
+  }
+  EXPECT_FALSE(rx(1, 1, "a", 100, 50));
+
+  // A new node replaces the least recently seen one (node 2)
+  EXPECT_TRUE(rx(100, 1, "a", 100, 50));
+  EXPECT_FALSE(rx(1, 1, "a", 100, 51));
+}
+
+TEST_F(PubSubLimitsTest, TopicTable) {
+  char name[8];
+
+  // Configured topics stay, counted ones make room (oldest first)
+  EXPECT_TRUE(setTopic(1000, "configured", PUBSUB_PRIO_HIGH, 0, 0, 0));
+  for(uint32_t idx = 1; idx < PUBSUB_LIMITS_MAX_TOPICS; idx++) {
+    snprintf(name, sizeof(name), "t%u", idx);
+    EXPECT_TRUE(tx(idx, name, 10, idx));
+  }
+  EXPECT_TRUE(tx(100, "new", 10, 100));
+
+  EXPECT_NE(topic(1000), nullptr);
+  EXPECT_EQ(topic(1), nullptr);
+  EXPECT_NE(topic(100), nullptr);
+  EXPECT_EQ(limits.other.txMsgs, 1);
+  EXPECT_EQ(limits.other.txBytes, 10);
+
+  // With every entry configured, new topics are counted in other
+  for(uint32_t idx = 2; idx < PUBSUB_LIMITS_MAX_TOPICS + 1; idx++) {
+    snprintf(name, sizeof(name), "c%u", idx);
+    EXPECT_TRUE(setTopic(2000 + idx, name, PUBSUB_PRIO_NORMAL, 0, 0, 200));
+  }
+  EXPECT_FALSE(setTopic(3000, "nope", PUBSUB_PRIO_HIGH, 0, 0, 200));
+  EXPECT_EQ(pubsubLimitsPriority(&limits, 3000), PUBSUB_PRIO_NORMAL);
+
+  uint32_t otherMsgs = limits.other.txMsgs;
+  EXPECT_TRUE(tx(3000, "nope", 10, 200));
+  EXPECT_EQ(limits.other.txMsgs, otherMsgs + 1);
+}
+
+TEST_F(PubSubLimitsTest, LongName) {
+  const char *longName = "this/topic/name/is/longer/than/the/table/allows";
+  EXPECT_TRUE(setTopic(1, longName, PUBSUB_PRIO_LOW, 0, 0, 0));
+  EXPECT_EQ(strlen(topic(1)->name), PUBSUB_LIMITS_NAME_LEN - 1);
+  EXPECT_EQ(strncmp(topic(1)->name, longName, PUBSUB_LIMITS_NAME_LEN - 1), 0);
+}
+
+TEST_F(PubSubLimitsTest, Admit) {
+  // Low priority only gets the first half of the queue
+  EXPECT_TRUE(pubsubLimitsAdmit(PUBSUB_PRIO_LOW, 33, 64));
+  EXPECT_FALSE(pubsubLimitsAdmit(PUBSUB_PRIO_LOW, 32, 64));
+
+  // Normal leaves an eighth for high
+  EXPECT_TRUE(pubsubLimitsAdmit(PUBSUB_PRIO_NORMAL, 9, 64));
+  EXPECT_FALSE(pubsubLimitsAdmit(PUBSUB_PRIO_NORMAL, 8, 64));
+
+  // High gets all of it
+  EXPECT_TRUE(pubsubLimitsAdmit(PUBSUB_PRIO_HIGH, 1, 64));
+  EXPECT_FALSE(pubsubLimitsAdmit(PUBSUB_PRIO_HIGH, 0, 64));
+}
@@ -0,0 +1,300 @@
+#include "gtest/gtest.h"
+
+#include <map>
+#include <vector>
+
+#include "pubsub_qos.h"
+
+using namespace testing;
+
+// The fixture for testing class Foo.
+class PubSubQosTest : public ::testing::Test {
+ protected:
+  // You can remove any or all of the following functions if its body
+  // is empty.
+
+  PubSubQosTest() {
+     // You can do set-up work for each test here.
+  }
+
+  ~PubSubQosTest() override {
+     // You can do clean-up work that doesn't throw exceptions here.
+  }
+
+  // If the constructor and destructor are not enough for setting up
+  // and cleaning up each test, you can define the following methods:
+
+  void SetUp() override {
+     // Code here will be called immediately after the constructor (right
+     // before each test).
+    retransmits.clear();
+    giveUps.clear();
+  }
+
+  void TearDown() override {
+     // Code here will be called immediately after each test (right
+     // before the destructor).
+  }
+
+  // Objects declared here can be used by all tests in the test suite for Foo.
+  static std::vector<uint16_t> retransmits;
+  static std::vector<uint16_t> giveUps;
+
+  static void retransmitCb(void *msg, uint16_t seq, void *arg) {
+    (void)msg;
+    (void)arg;
+    retransmits.push_back(seq);
+  }
+
+  static void giveUpCb(void *msg, uint16_t seq, void *arg) {
+    (void)msg;
+    (void)arg;
+    giveUps.push_back(seq);
+  }
+};
+
+std::vector<uint16_t> PubSubQosTest::retransmits;
+std::vector<uint16_t> PubSubQosTest::giveUps;
+
+TEST_F(PubSubQosTest, Window)
+{
+  pubsubQosTx_t tx;
+  int msgs[PUBSUB_QOS_TX_WINDOW + 1];
+  uint16_t seq;
+
+  // Sequence numbers wrap
+  pubsubQosTxInit(&tx, 0xFFFE, 100, 1000, 3);
+  for(uint32_t idx = 0; idx < PUBSUB_QOS_TX_WINDOW; idx++) {
+    EXPECT_TRUE(pubsubQosTxAdd(&tx, &msgs[idx], 0, &seq));
+    EXPECT_EQ(seq, (uint16_t)(0xFFFE + idx));
+  }
+  EXPECT_EQ(pubsubQosTxInFlight(&tx), PUBSUB_QOS_TX_WINDOW);
+
+  // Full
+  EXPECT_FALSE(pubsubQosTxAdd(&tx, &msgs[PUBSUB_QOS_TX_WINDOW], 0, &seq));
+
+  // Acks hand back the message, once
+  EXPECT_EQ(pubsubQosTxAck(&tx, 0xFFFF), &msgs[1]);
+  EXPECT_EQ(pubsubQosTxAck(&tx, 0xFFFF), nullptr);
+  EXPECT_EQ(pubsubQosTxAck(&tx, 1234), nullptr);
+  EXPECT_EQ(pubsubQosTxInFlight(&tx), PUBSUB_QOS_TX_WINDOW - 1);
+
+  EXPECT_TRUE(pubsubQosTxAdd(&tx, &msgs[PUBSUB_QOS_TX_WINDOW], 0, &seq));
+  EXPECT_EQ(seq, 6);
+}
+
+TEST_F(PubSubQosTest, SequenceSpan)
+{
+  pubsubQosTx_t tx;
+  int msg;
+  uint16_t seq;
+  pubsubQosTxInit(&tx, 100, 100, 1000, 3);
+
+  // One message stuck waiting for an ack
+  EXPECT_TRUE(pubsubQosTxAdd(&tx, &msg, 0, &seq));
+  EXPECT_EQ(seq, 100);
+
+  // Others get through, until they'd be too far ahead of it
+  for(uint32_t idx = 1; idx < PUBSUB_QOS_RX_HISTORY; idx++) {
+    EXPECT_TRUE(pubsubQosTxAdd(&tx, &msg, 0, &seq));
+    EXPECT_EQ(pubsubQosTxAck(&tx, seq), &msg);
+  }
+  EXPECT_FALSE(pubsubQosTxAdd(&tx, &msg, 0, &seq));
+
+  EXPECT_EQ(pubsubQosTxAck(&tx, 100), &msg);
+  EXPECT_TRUE(pubsubQosTxAdd(&tx, &msg, 0, &seq));
+  EXPECT_EQ(seq, 100 + PUBSUB_QOS_RX_HISTORY);
+}
+
+TEST_F(PubSubQosTest, Backoff)
+{
+  pubsubQosTx_t tx;
+  int msg;
+  uint16_t seq;
+  pubsubQosTxInit(&tx, 0, 100, 300, 3);
+
+  // Timer wrap in the middle of it all
+  const uint32_t start = UINT32_MAX - 250;
+  EXPECT_EQ(pubsubQosTxPoll(&tx, start, retransmitCb, giveUpCb, NULL), PUBSUB_QOS_NO_TIMEOUT);
+
+  EXPECT_TRUE(pubsubQosTxAdd(&tx, &msg, start, &seq));
+  EXPECT_EQ(pubsubQosTxPoll(&tx, start, retransmitCb, giveUpCb, NULL), 100);
+  EXPECT_EQ(pubsubQosTxPoll(&tx, start + 99, retransmitCb, giveUpCb, NULL), 1);
+  EXPECT_TRUE(retransmits.empty());
+
+  // 100, 200, then capped at 300
+  EXPECT_EQ(pubsubQosTxPoll(&tx, start + 100, retransmitCb, giveUpCb, NULL), 200);
+  EXPECT_EQ(retransmits.size(), 1);
+  EXPECT_EQ(pubsubQosTxPoll(&tx, start + 300, retransmitCb, giveUpCb, NULL), 300);
+  EXPECT_EQ(retransmits.size(), 2);
+  // Late poll, next timeout counts from now
+  EXPECT_EQ(pubsubQosTxPoll(&tx, start + 650, retransmitCb, giveUpCb, NULL), 300);
+  EXPECT_EQ(retransmits.size(), 3);
+  EXPECT_TRUE(giveUps.empty());
+
+  // Out of retries
+  EXPECT_EQ(pubsubQosTxPoll(&tx, start + 949, retransmitCb, giveUpCb, NULL), 1);
+  EXPECT_EQ(pubsubQosTxPoll(&tx, start + 950, retransmitCb, giveUpCb, NULL), PUBSUB_QOS_NO_TIMEOUT);
+  EXPECT_EQ(retransmits.size(), 3);
+  ASSERT_EQ(giveUps.size(), 1);
+  EXPECT_EQ(giveUps[0], seq);
+  EXPECT_EQ(pubsubQosTxInFlight(&tx), 0);
+
+  // Acked messages are never retransmitted
+  EXPECT_TRUE(pubsubQosTxAdd(&tx, &msg, 0, &seq));
+  EXPECT_EQ(pubsubQosTxAck(&tx, seq), &msg);
+  EXPECT_EQ(pubsubQosTxPoll(&tx, 10000, retransmitCb, giveUpCb, NULL), PUBSUB_QOS_NO_TIMEOUT);
+  EXPECT_EQ(retransmits.size(), 3);
+}
+
+TEST_F(PubSubQosTest, Duplicates)
+{
+  pubsubQosRx_t rx;
+  pubsubQosRxInit(&rx);
+
+  EXPECT_TRUE(pubsubQosRxAccept(&rx, 1, 0xFFFD, 0));
+  EXPECT_FALSE(pubsubQosRxAccept(&rx, 1, 0xFFFD, 0));
+
+  // Out of order and across the wrap
+  EXPECT_TRUE(pubsubQosRxAccept(&rx, 1, 2, 0));
+  EXPECT_TRUE(pubsubQosRxAccept(&rx, 1, 0xFFFF, 0));
+  EXPECT_TRUE(pubsubQosRxAccept(&rx, 1, 0, 0));
+  EXPECT_FALSE(pubsubQosRxAccept(&rx, 1, 0xFFFF, 0));
+  EXPECT_FALSE(pubsubQosRxAccept(&rx, 1, 2, 0));
+  EXPECT_FALSE(pubsubQosRxAccept(&rx, 1, 0, 0));
+  EXPECT_TRUE(pubsubQosRxAccept(&rx, 1, 1, 0));
+
+  // Same sequence numbers from another publisher are fine
+  EXPECT_TRUE(pubsubQosRxAccept(&rx, 2, 2, 0));
+  EXPECT_FALSE(pubsubQosRxAccept(&rx, 2, 2, 0));
+
+  // Oldest remembered message
+  EXPECT_TRUE(pubsubQosRxAccept(&rx, 3, 100, 0));
+  EXPECT_TRUE(pubsubQosRxAccept(&rx, 3, 100 + PUBSUB_QOS_RX_HISTORY - 1, 0));
+  EXPECT_FALSE(pubsubQosRxAccept(&rx, 3, 100, 0));
+
+  // Too far back to be a retransmission, publisher restarted
+  EXPECT_TRUE(pubsubQosRxAccept(&rx, 3, 10, 0));
+  EXPECT_TRUE(pubsubQosRxAccept(&rx, 3, 11, 0));
+  EXPECT_FALSE(pubsubQosRxAccept(&rx, 3, 10, 0));
+
+  // Big jump forward forgets the history
+  EXPECT_TRUE(pubsubQosRxAccept(&rx, 3, 1000, 0));
+  EXPECT_FALSE(pubsubQosRxAccept(&rx, 3, 1000, 0));
+}
+
+TEST_F(PubSubQosTest, PublisherEviction)
+{
+  pubsubQosRx_t rx;
+  pubsubQosRxInit(&rx);
+
+  for(uint64_t node = 1; node <= PUBSUB_QOS_RX_PUBLISHERS; node++) {
+    EXPECT_TRUE(pubsubQosRxAccept(&rx, node, 5, (uint32_t)node));
+  }
+
+  // Node 1 is heard from again, so node 2 is the one that gets replaced
+  EXPECT_FALSE(pubsubQosRxAccept(&rx, 1, 5, 100));
+  EXPECT_TRUE(pubsubQosRxAccept(&rx, 100, 5, 101));
+
+  EXPECT_FALSE(pubsubQosRxAccept(&rx, 1, 5, 102));
+  EXPECT_FALSE(pubsubQosRxAccept(&rx, 3, 5, 103));
+  EXPECT_FALSE(pubsubQosRxAccept(&rx, 100, 5, 104));
+
+  // Forgotten, so its retransmission gets delivered again
+  EXPECT_TRUE(pubsubQosRxAccept(&rx, 2, 5, 105));
+}
+
+// Publisher and subscriber over a link that loses messages and acks. Every
+// message is either delivered exactly once and acked, or given up on.
+TEST_F(PubSubQosTest, LossyLink)
+{
+  pubsubQosTx_t tx;
+  pubsubQosRx_t rx;
+  pubsubQosTxInit(&tx, 0x1234, 50, 800, 5);
+  pubsubQosRxInit(&rx);
+
+  struct link_t {
+    uint32_t rng;
+    pubsubQosRx_t *rx;
+    pubsubQosTx_t *tx;
+    std::map<uint32_t, uint32_t> deliveries;
+    std::vector<uint16_t> acks;
+    uint32_t nowMs;
+
+    bool lose() {
+      rng ^= rng << 13;
+      rng ^= rng >> 17;
+      rng ^= rng << 5;
+      return (rng % 100) < 30;
+    }
+
+    // Subscriber receives, acks (maybe lost)
+    void transmit(uint32_t id, uint16_t seq) {
+      if(lose()) {
+        return;
+      }
+      if(pubsubQosRxAccept(rx, 0xABCD, seq, nowMs)) {
+        deliveries[id]++;
+      }
+      if(!lose()) {
+        acks.push_back(seq);
+      }
+    }
+  };
+
+  static link_t link;
+  link.rng = 0xC0FFEE;
+  link.rx = &rx;
+  link.tx = &tx;
+  link.deliveries.clear();
+  link.acks.clear();
+
+  std::vector<uint32_t> ids(1000);
+  std::map<uint32_t, bool> acked;
+  std::map<uint32_t, bool> gaveUp;
+  uint32_t nextId = 0;
+
+  auto resend = [](void *msg, uint16_t seq, void *arg) {
+    (void)arg;
+    link.transmit(*static_cast<uint32_t *>(msg), seq);
+  };
+  auto drop = [](void *msg, uint16_t seq, void *arg) {
+    (void)seq;
+    (*static_cast<std::map<uint32_t, bool> *>(arg))[*static_cast<uint32_t *>(msg)] = true;
+  };
+
+  for(link.nowMs = 0; link.nowMs < 200000; link.nowMs += 10) {
+    // Publish a message every 20ms while there's room
+    if((nextId < ids.size()) && ((link.nowMs % 20) == 0)) {
+      ids[nextId] = nextId;
+      uint16_t seq;
+      if(pubsubQosTxAdd(&tx, &ids[nextId], link.nowMs, &seq)) {
+        link.transmit(nextId, seq);
+        nextId++;
+      }
+    }
+
+    for(uint16_t seq : link.acks) {
+      void *msg = pubsubQosTxAck(&tx, seq);
+      if(msg) {
+        acked[*static_cast<uint32_t *>(msg)] = true;
+      }
+    }
+    link.acks.clear();
+
+    pubsubQosTxPoll(&tx, link.nowMs, resend, drop, &gaveUp);
+  }
+
+  EXPECT_EQ(nextId, ids.size());
+  EXPECT_EQ(pubsubQosTxInFlight(&tx), 0);
+  EXPECT_EQ(acked.size() + gaveUp.size(), ids.size());
+  // A message is lost 6 times in a row or so rarely
+  EXPECT_LT(gaveUp.size(), 50);
+
+  for(uint32_t id = 0; id < ids.size(); id++) {
+    EXPECT_LE(link.deliveries[id], 1) << "id " << id;
+    if(acked[id]) {
+      EXPECT_EQ(link.deliveries[id], 1) << "id " << id;
+    }
+  }
+}
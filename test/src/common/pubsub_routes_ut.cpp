@@ -0,0 +1,150 @@
+#include "gtest/gtest.h"
+
+#include <string.h>
+
+#include "pubsub_routes.h"
+
+using namespace testing;
+
+#define TTL_MS (180000)
+
+// The fixture for testing class Foo.
+class PubSubRoutesTest : public ::testing::Test {
+ protected:
+  // You can remove any or all of the following functions if its body
+  // is empty.
+
+  PubSubRoutesTest() {
+     // You can do set-up work for each test here.
+  }
+
+  ~PubSubRoutesTest() override {
+     // You can do clean-up work that doesn't throw exceptions here.
+  }
+
+  // If the constructor and destructor are not enough for setting up
+  // and cleaning up each test, you can define the following methods:
+
+  void SetUp() override {
+     // Code here will be called immediately after the constructor (right
+     // before each test).
+    pubsubRoutesInit(&routes, TTL_MS);
+  }
+
+  void TearDown() override {
+     // Code here will be called immediately after each test (right
+     // before the destructor).
+  }
+
+  // Objects declared here can be used by all tests in the test suite for Foo.
+  pubsubRoutes_t routes;
+
+  static uint32_t hash(const char *topic) {
+    return pubsubRoutesHash(topic, strlen(topic));
+  }
+};
+
+TEST_F(PubSubRoutesTest, Hash) {
+  // FNV-1a reference values
+  EXPECT_EQ(pubsubRoutesHash("", 0), 0x811c9dc5);
+  EXPECT_EQ(hash("a"), 0xe40c292c);
+  EXPECT_EQ(hash("foobar"), 0xbf9cf968);
+
+  // Only topic_len bytes count
+  EXPECT_EQ(pubsubRoutesHash("foobar", 3), hash("foo"));
+}
+
+TEST_F(PubSubRoutesTest, AddLookup) {
+  uint64_t nodes[4];
+
+  EXPECT_EQ(pubsubRoutesLookup(&routes, hash("temp"), 0, nodes, 4), 0);
+
+  EXPECT_TRUE(pubsubRoutesAdd(&routes, 0x1111, hash("temp"), 0));
+  EXPECT_TRUE(pubsubRoutesAdd(&routes, 0x2222, hash("temp"), 0));
+  EXPECT_TRUE(pubsubRoutesAdd(&routes, 0x2222, hash("pressure"), 0));
+
+  // Refreshing doesn't add a second entry
+  EXPECT_TRUE(pubsubRoutesAdd(&routes, 0x1111, hash("temp"), 10));
+
+  ASSERT_EQ(pubsubRoutesLookup(&routes, hash("temp"), 20, nodes, 4), 2);
+  EXPECT_EQ(nodes[0], 0x1111);
+  EXPECT_EQ(nodes[1], 0x2222);
+
+  ASSERT_EQ(pubsubRoutesLookup(&routes, hash("pressure"), 20, nodes, 4), 1);
+  EXPECT_EQ(nodes[0], 0x2222);
+
+  EXPECT_EQ(pubsubRoutesLookup(&routes, hash("humidity"), 20, nodes, 4), 0);
+}
+
+TEST_F(PubSubRoutesTest, MaxNodes) {
+  uint64_t nodes[2];
+
+  EXPECT_TRUE(pubsubRoutesAdd(&routes, 1, hash("temp"), 0));
+  EXPECT_TRUE(pubsubRoutesAdd(&routes, 2, hash("temp"), 0));
+  EXPECT_EQ(pubsubRoutesLookup(&routes, hash("temp"), 0, nodes, 2), 2);
+
+  // One more than the caller can take means "too many", not a partial list
+  EXPECT_TRUE(pubsubRoutesAdd(&routes, 3, hash("temp"), 0));
+  EXPECT_EQ(pubsubRoutesLookup(&routes, hash("temp"), 0, nodes, 2), -1);
+}
+
+TEST_F(PubSubRoutesTest, ClearNode) {
+  uint64_t nodes[4];
+
+  EXPECT_TRUE(pubsubRoutesAdd(&routes, 1, hash("temp"), 0));
+  EXPECT_TRUE(pubsubRoutesAdd(&routes, 1, hash("pressure"), 0));
+  EXPECT_TRUE(pubsubRoutesAdd(&routes, 2, hash("temp"), 0));
+
+  // Node 1 announces it only subscribes to pressure now
+  pubsubRoutesClearNode(&routes, 1);
+  EXPECT_TRUE(pubsubRoutesAdd(&routes, 1, hash("pressure"), 100));
+
+  ASSERT_EQ(pubsubRoutesLookup(&routes, hash("temp"), 100, nodes, 4), 1);
+  EXPECT_EQ(nodes[0], 2);
+  ASSERT_EQ(pubsubRoutesLookup(&routes, hash("pressure"), 100, nodes, 4), 1);
+  EXPECT_EQ(nodes[0], 1);
+}
+
+TEST_F(PubSubRoutesTest, Expiry) {
+  uint64_t nodes[4];
+
+  // Start right before the ms counter wraps
+  uint32_t now = UINT32_MAX - 1000;
+  EXPECT_TRUE(pubsubRoutesAdd(&routes, 1, hash("temp"), now));
+  EXPECT_TRUE(pubsubRoutesAdd(&routes, 2, hash("temp"), now));
+
+  // Node 2 keeps announcing, node 1 went away
+  now += TTL_MS / 2;
+  EXPECT_TRUE(pubsubRoutesAdd(&routes, 2, hash("temp"), now));
+  EXPECT_EQ(pubsubRoutesLookup(&routes, hash("temp"), now, nodes, 4), 2);
+
+  now += TTL_MS / 2;
+  ASSERT_EQ(pubsubRoutesLookup(&routes, hash("temp"), now, nodes, 4), 1);
+  EXPECT_EQ(nodes[0], 2);
+
+  now += TTL_MS / 2;
+  EXPECT_EQ(pubsubRoutesLookup(&routes, hash("temp"), now, nodes, 4), 0);
+}
+
+TEST_F(PubSubRoutesTest, Overflow) {
+  uint64_t nodes[4];
+  uint32_t now = 0;
+
+  for(uint32_t idx = 0; idx < PUBSUB_ROUTES_MAX_ENTRIES; idx++) {
+    EXPECT_TRUE(pubsubRoutesAdd(&routes, idx, hash("temp"), now));
+  }
+  EXPECT_TRUE(pubsubRoutesAdd(&routes, 0, hash("temp"), now));
+
+  // No room for this one, so nobody's subscriber set can be trusted
+  EXPECT_FALSE(pubsubRoutesAdd(&routes, 100, hash("pressure"), now));
+  EXPECT_EQ(pubsubRoutesLookup(&routes, hash("pressure"), now, nodes, 4), -1);
+  EXPECT_EQ(pubsubRoutesLookup(&routes, hash("humidity"), now, nodes, 4), -1);
+
+  // Once the missed subscription would have expired, the table is trusted
+  // again (the old entries are gone too, making room)
+  now += TTL_MS;
+  EXPECT_EQ(pubsubRoutesLookup(&routes, hash("humidity"), now, nodes, 4), 0);
+  EXPECT_TRUE(pubsubRoutesAdd(&routes, 100, hash("pressure"), now));
+  ASSERT_EQ(pubsubRoutesLookup(&routes, hash("pressure"), now, nodes, 4), 1);
+  EXPECT_EQ(nodes[0], 100);
+}
@@ -0,0 +1,142 @@
+#include "gtest/gtest.h"
+
+#include <string>
+#include <vector>
+#include <string.h>
+
+#include "serial_line_buffer.h"
+
+#define LINE_BUFF_LEN (16)
+
+static std::vector<std::string> lines;
+static std::vector<const uint8_t *> linePtrs;
+static void *lastHandle;
+
+static void lineCallback(void *serialHandle, uint8_t *line, size_t len) {
+  lastHandle = serialHandle;
+  // Line must be zero terminated right after the newline
+  EXPECT_EQ(line[len], '\n');
+  EXPECT_EQ(line[len + 1], 0);
+  lines.push_back(std::string(reinterpret_cast<char *>(line), len));
+  linePtrs.push_back(line);
+}
+
+// The fixture for testing the serial line buffer.
+class SerialLineBufferTest : public ::testing::Test {
+ protected:
+  // You can remove any or all of the following functions if its body
+  // is empty.
+
+  SerialLineBufferTest() {
+     // You can do set-up work for each test here.
+  }
+
+  ~SerialLineBufferTest() override {
+     // You can do clean-up work that doesn't throw exceptions here.
+  }
+
+  // If the constructor and destructor are not enough for setting up
+  // and cleaning up each test, you can define the following methods:
+
+  void SetUp() override {
+     // Code here will be called immediately after the constructor (right
+     // before each test).
+     lines.clear();
+     linePtrs.clear();
+     lastHandle = NULL;
+     _lineBuffer = {_buff, 0, sizeof(_buff), lineCallback, false};
+  }
+
+  void TearDown() override {
+     // Code here will be called immediately after each test (right
+     // before the destructor).
+  }
+
+  // Process data from a buffer with one extra byte (like the rx task does)
+  void process(const std::string &data) {
+    memcpy(_rxBuff, data.data(), data.size());
+    _rxBuff[data.size()] = 0xAA;
+    serialLineBufferProcess(&_handle, &_lineBuffer, _rxBuff, data.size());
+    // Extra byte is restored
+    EXPECT_EQ(_rxBuff[data.size()], 0xAA);
+  }
+
+  int _handle;
+  uint8_t _buff[LINE_BUFF_LEN];
+  uint8_t _rxBuff[128];
+  SerialLineBuffer_t _lineBuffer;
+};
+
+TEST_F(SerialLineBufferTest, WholeLines) {
+  process("hello\nworld\n");
+  ASSERT_EQ(lines.size(), 2);
+  EXPECT_EQ(lines[0], "hello");
+  EXPECT_EQ(lines[1], "world");
+  EXPECT_EQ(lastHandle, &_handle);
+
+  // Not copied
+  EXPECT_EQ(linePtrs[0], &_rxBuff[0]);
+  EXPECT_EQ(linePtrs[1], &_rxBuff[6]);
+  EXPECT_EQ(_lineBuffer.idx, 0);
+}
+
+TEST_F(SerialLineBufferTest, LongerThanLineBuffer) {
+  // Whole lines don't go through the line buffer, so they can be any length
+  std::string longLine(64, 'x');
+  process(longLine + "\n");
+  ASSERT_EQ(lines.size(), 1);
+  EXPECT_EQ(lines[0], longLine);
+}
+
+TEST_F(SerialLineBufferTest, SplitLines) {
+  process("hel");
+  EXPECT_EQ(lines.size(), 0);
+  process("lo\nwor");
+  ASSERT_EQ(lines.size(), 1);
+  EXPECT_EQ(lines[0], "hello");
+  EXPECT_EQ(linePtrs[0], _buff);
+
+  process("ld");
+  process("\n");
+  ASSERT_EQ(lines.size(), 2);
+  EXPECT_EQ(lines[1], "world");
+}
+
+TEST_F(SerialLineBufferTest, ByteAtATime) {
+  std::string data = "abc\n\nde\n";
+  for(char c : data) {
+    process(std::string(1, c));
+  }
+  ASSERT_EQ(lines.size(), 3);
+  EXPECT_EQ(lines[0], "abc");
+  EXPECT_EQ(lines[1], "");
+  EXPECT_EQ(lines[2], "de");
+}
+
+TEST_F(SerialLineBufferTest, Overflow) {
+  // Partial line too long for the line buffer is dropped
+  process("0123456789");
+  process("0123456789");
+  process("01234\nok\n");
+  ASSERT_EQ(lines.size(), 1);
+  EXPECT_EQ(lines[0], "ok");
+
+  // Fills the line buffer exactly (line, newline and terminator)
+  process("0123456789abcd");
+  process("\n");
+  ASSERT_EQ(lines.size(), 2);
+  EXPECT_EQ(lines[1], "0123456789abcd");
+
+  // Newline arrives with the bytes that don't fit
+  process("0123456789abcd");
+  process("e\nnext\n");
+  ASSERT_EQ(lines.size(), 3);
+  EXPECT_EQ(lines[2], "next");
+}
+
+TEST_F(SerialLineBufferTest, NoCallback) {
+  _lineBuffer.lineCallback = NULL;
+  process("abc\nde");
+  process("f\n");
+  EXPECT_EQ(_lineBuffer.idx, 0);
+}
@@ -0,0 +1,151 @@
+#include "gtest/gtest.h"
+
+#include <chrono>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "crc.h"
+#include "sha256.h"
+
+using namespace testing;
+
+// The fixture for testing class Foo.
+class Sha256Test : public ::testing::Test {
+ protected:
+  // You can remove any or all of the following functions if its body
+  // is empty.
+
+  Sha256Test() {
+     // You can do set-up work for each test here.
+  }
+
+  ~Sha256Test() override {
+     // You can do clean-up work that doesn't throw exceptions here.
+  }
+
+  // If the constructor and destructor are not enough for setting up
+  // and cleaning up each test, you can define the following methods:
+
+  void SetUp() override {
+     // Code here will be called immediately after the constructor (right
+     // before each test).
+  }
+
+  void TearDown() override {
+     // Code here will be called immediately after each test (right
+     // before the destructor).
+  }
+
+  // Objects declared here can be used by all tests in the test suite for Foo.
+
+  static void toHex(const uint8_t *digest, char *hex) {
+    for(uint32_t idx = 0; idx < SHA256_DIGEST_LEN; idx++) {
+      sprintf(&hex[idx * 2], "%02x", digest[idx]);
+    }
+  }
+
+  static void hashHex(const char *msg, char *hex) {
+    sha256Ctx_t ctx;
+    uint8_t digest[SHA256_DIGEST_LEN];
+    sha256Init(&ctx);
+    sha256Update(&ctx, reinterpret_cast<const uint8_t *>(msg), strlen(msg));
+    sha256Final(&ctx, digest);
+    toHex(digest, hex);
+  }
+};
+
+TEST_F(Sha256Test, KnownVectors)
+{
+  char hex[SHA256_DIGEST_LEN * 2 + 1];
+
+  hashHex("", hex);
+  EXPECT_STREQ(hex, "e3b0c44298fc1c149afbf4c8996fb92427ae41e4649b934ca495991b7852b855");
+
+  hashHex("abc", hex);
+  EXPECT_STREQ(hex, "ba7816bf8f01cfea414140de5dae2223b00361a396177a9cb410ff61f20015ad");
+
+  // Padding spills into a second block
+  hashHex("abcdbcdecdefdefgefghfghighijhijkijkljklmklmnlmnomnopnopq", hex);
+  EXPECT_STREQ(hex, "248d6a61d20638b8e5c026930c3e6039a33ce45964ff2167f6ecedd419db06c1");
+
+  // Exactly one block of data (padding is a whole block)
+  hashHex("0123456789abcdef0123456789abcdef0123456789abcdef0123456789abcdef", hex);
+  EXPECT_STREQ(hex, "a8ae6e6ee929abea3afcfc5258c8ccd6f85273e0d4626d26c7279f3250f77c8e");
+}
+
+TEST_F(Sha256Test, MillionA)
+{
+  sha256Ctx_t ctx;
+  uint8_t digest[SHA256_DIGEST_LEN];
+  char hex[SHA256_DIGEST_LEN * 2 + 1];
+  uint8_t buff[1000];
+  memset(buff, 'a', sizeof(buff));
+
+  sha256Init(&ctx);
+  for(uint32_t idx = 0; idx < 1000; idx++) {
+    sha256Update(&ctx, buff, sizeof(buff));
+  }
+  sha256Final(&ctx, digest);
+  toHex(digest, hex);
+  EXPECT_STREQ(hex, "cdc76e5c9914fb9281a1c7e284d73e67f1809a48a497200e046d39ccc7112cd0");
+}
+
+TEST_F(Sha256Test, Streaming)
+{
+  uint8_t data[1000];
+  for(uint32_t idx = 0; idx < sizeof(data); idx++) {
+    data[idx] = (uint8_t)(idx * 7);
+  }
+
+  sha256Ctx_t ctx;
+  uint8_t expected[SHA256_DIGEST_LEN];
+  sha256Init(&ctx);
+  sha256Update(&ctx, data, sizeof(data));
+  sha256Final(&ctx, expected);
+
+  // Any split gives the same digest
+  const size_t pieces[] = {1, 3, 63, 64, 65, 127, 500};
+  for(size_t piece : pieces) {
+    uint8_t digest[SHA256_DIGEST_LEN];
+    sha256Init(&ctx);
+    for(size_t offset = 0; offset < sizeof(data); offset += piece) {
+      size_t len = (sizeof(data) - offset < piece) ? (sizeof(data) - offset) : piece;
+      sha256Update(&ctx, &data[offset], len);
+    }
+    sha256Final(&ctx, digest);
+    EXPECT_EQ(memcmp(digest, expected, sizeof(expected)), 0) << "piece " << piece;
+  }
+}
+
+// Not a pass/fail test, prints hashing cost per KB on the host to compare
+// against the CRC16 we already compute
+TEST_F(Sha256Test, Throughput)
+{
+  const size_t len = 1024 * 1024;
+  uint8_t *data = static_cast<uint8_t *>(malloc(len));
+  ASSERT_NE(data, nullptr);
+  for(size_t idx = 0; idx < len; idx++) {
+    data[idx] = (uint8_t)rand();
+  }
+
+  sha256Ctx_t ctx;
+  uint8_t digest[SHA256_DIGEST_LEN];
+  auto start = std::chrono::steady_clock::now();
+  sha256Init(&ctx);
+  for(size_t offset = 0; offset < len; offset += 2048) {
+    sha256Update(&ctx, &data[offset], 2048);
+  }
+  sha256Final(&ctx, digest);
+  auto shaNs = std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - start).count();
+
+  start = std::chrono::steady_clock::now();
+  volatile uint16_t crc = crc16_ccitt(0, data, len);
+  auto crcNs = std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - start).count();
+  (void)crc;
+
+  printf("sha256: %.2f us/KB\n", (double)shaNs / 1000.0 / 1024.0);
+  printf("crc16:  %.2f us/KB\n", (double)crcNs / 1000.0 / 1024.0);
+
+  free(data);
+}
@@ -0,0 +1,210 @@
+#include "gtest/gtest.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+
+#include "sim_storage.h"
+
+using namespace testing;
+
+#define TEST_FLASH_SIZE (64 * 1024)
+
+// The fixture for testing class Foo.
+class SimStorageTest : public ::testing::Test {
+ protected:
+  // You can remove any or all of the following functions if its body
+  // is empty.
+
+  SimStorageTest() {
+     // You can do set-up work for each test here.
+  }
+
+  ~SimStorageTest() override {
+     // You can do clean-up work that doesn't throw exceptions here.
+  }
+
+  // If the constructor and destructor are not enough for setting up
+  // and cleaning up each test, you can define the following methods:
+
+  void SetUp() override {
+     // Code here will be called immediately after the constructor (right
+     // before each test).
+  }
+
+  void TearDown() override {
+     // Code here will be called immediately after each test (right
+     // before the destructor).
+  }
+
+  // Objects declared here can be used by all tests in the test suite for Foo.
+};
+
+TEST_F(SimStorageTest, NorSemantics)
+{
+  SimStorageDriver flash(NULL, TEST_FLASH_SIZE);
+  uint8_t buff[16];
+
+  EXPECT_EQ(flash.getStorageSizeBytes(), TEST_FLASH_SIZE);
+  EXPECT_EQ(flash.getAlignmentBytes(), SimStorageDriver::SECTOR_SIZE);
+
+  // Starts erased
+  EXPECT_TRUE(flash.read(0, buff, sizeof(buff), 0));
+  for(uint32_t idx = 0; idx < sizeof(buff); idx++) {
+    EXPECT_EQ(buff[idx], 0xFF);
+  }
+
+  // Programming clears bits
+  uint8_t data[4] = {0xF0, 0x0F, 0x00, 0xAA};
+  EXPECT_TRUE(flash.programPage(0, data, sizeof(data)));
+  EXPECT_TRUE(flash.read(0, buff, sizeof(data), 0));
+  EXPECT_EQ(memcmp(buff, data, sizeof(data)), 0);
+
+  // Clearing more bits is fine
+  uint8_t clear[4] = {0x00, 0x00, 0x00, 0x00};
+  EXPECT_TRUE(flash.programPage(0, clear, sizeof(clear)));
+  EXPECT_EQ(flash.getStats().programViolations, 0);
+
+  // Setting bits back to 1 is not
+  EXPECT_FALSE(flash.programPage(0, data, sizeof(data)));
+  EXPECT_EQ(flash.getStats().programViolations, 1);
+  EXPECT_TRUE(flash.read(0, buff, sizeof(clear), 0));
+  EXPECT_EQ(memcmp(buff, clear, sizeof(clear)), 0);
+
+  // Programs can't cross a page
+  EXPECT_FALSE(flash.programPage(SimStorageDriver::PAGE_SIZE - 2, data, sizeof(data)));
+
+  // Erase sets everything back to 1, a sector at a time
+  EXPECT_FALSE(flash.eraseSector(16));
+  EXPECT_TRUE(flash.eraseSector(0));
+  EXPECT_TRUE(flash.read(0, buff, sizeof(buff), 0));
+  for(uint32_t idx = 0; idx < sizeof(buff); idx++) {
+    EXPECT_EQ(buff[idx], 0xFF);
+  }
+  EXPECT_EQ(flash.getEraseCount(0), 1);
+  EXPECT_EQ(flash.getEraseCount(SimStorageDriver::SECTOR_SIZE), 0);
+
+  // Out of range
+  EXPECT_FALSE(flash.read(TEST_FLASH_SIZE - 4, buff, sizeof(buff), 0));
+  EXPECT_FALSE(flash.eraseSector(TEST_FLASH_SIZE));
+  EXPECT_FALSE(flash.erase(16, SimStorageDriver::SECTOR_SIZE, 0));
+}
+
+TEST_F(SimStorageTest, W25WriteSemantics)
+{
+  SimStorageDriver flash(NULL, TEST_FLASH_SIZE);
+  uint8_t buff[32];
+
+  // Writes can overwrite (the driver erases for you)
+  uint8_t first[8] = {1, 2, 3, 4, 5, 6, 7, 8};
+  uint8_t second[8] = {0xFF, 0xFE, 0xFD, 0xFC, 0xFB, 0xFA, 0xF9, 0xF8};
+  EXPECT_TRUE(flash.write(100, first, sizeof(first), 0));
+  EXPECT_TRUE(flash.write(100, second, sizeof(second), 0));
+  EXPECT_TRUE(flash.read(100, buff, sizeof(second), 0));
+  EXPECT_EQ(memcmp(buff, second, sizeof(second)), 0);
+  EXPECT_EQ(flash.getEraseCount(0), 2);
+
+  // Rest of the sector is preserved
+  EXPECT_TRUE(flash.write(200, first, sizeof(first), 0));
+  EXPECT_TRUE(flash.read(100, buff, sizeof(second), 0));
+  EXPECT_EQ(memcmp(buff, second, sizeof(second)), 0);
+  EXPECT_TRUE(flash.read(200, buff, sizeof(first), 0));
+  EXPECT_EQ(memcmp(buff, first, sizeof(first)), 0);
+
+  // One page programmed per write, the rest of the sector stays erased
+  const SimFlashStats_t &stats = flash.getStats();
+  EXPECT_EQ(stats.bytesWritten, 3 * sizeof(first));
+  EXPECT_EQ(stats.pagesProgrammed, 3);
+  EXPECT_EQ(stats.bytesProgrammed, 3 * SimStorageDriver::PAGE_SIZE);
+  EXPECT_EQ(stats.sectorsErased, 3);
+  EXPECT_FLOAT_EQ(flash.getWriteAmplification(), (float)SimStorageDriver::PAGE_SIZE / sizeof(first));
+
+  // Writes that straddle sectors erase both
+  flash.resetStats();
+  EXPECT_EQ(flash.getEraseCount(0), 0);
+  for(uint32_t idx = 0; idx < sizeof(buff); idx++) {
+    buff[idx] = idx;
+  }
+  uint32_t addr = 2 * SimStorageDriver::SECTOR_SIZE - sizeof(buff) / 2;
+  EXPECT_TRUE(flash.write(addr, buff, sizeof(buff), 0));
+  EXPECT_EQ(flash.getStats().sectorsErased, 2);
+  EXPECT_EQ(flash.getEraseCount(SimStorageDriver::SECTOR_SIZE), 1);
+  EXPECT_EQ(flash.getEraseCount(2 * SimStorageDriver::SECTOR_SIZE), 1);
+  EXPECT_EQ(flash.getMaxEraseCount(), 1);
+  EXPECT_FLOAT_EQ(flash.getMeanEraseCount(), 1.0f);
+
+  uint16_t crc = 0;
+  EXPECT_TRUE(flash.crc16(addr, sizeof(buff), crc, 0));
+  EXPECT_NE(crc, 0);
+
+  // Erase rounds up to whole sectors
+  EXPECT_TRUE(flash.erase(SimStorageDriver::SECTOR_SIZE, SimStorageDriver::SECTOR_SIZE + 1, 0));
+  EXPECT_EQ(flash.getEraseCount(SimStorageDriver::SECTOR_SIZE), 2);
+  EXPECT_EQ(flash.getEraseCount(2 * SimStorageDriver::SECTOR_SIZE), 2);
+  EXPECT_TRUE(flash.read(addr, buff, sizeof(buff), 0));
+  for(uint32_t idx = 0; idx < sizeof(buff); idx++) {
+    EXPECT_EQ(buff[idx], 0xFF);
+  }
+}
+
+TEST_F(SimStorageTest, Timing)
+{
+  SimStorageDriver flash(NULL, TEST_FLASH_SIZE);
+  SimFlashTiming_t timing = {
+    .pageProgramUs = 1000,
+    .sectorEraseUs = 50000,
+    .spiNsPerByte = 1000,
+  };
+  flash.setTiming(timing);
+
+  uint8_t data[SimStorageDriver::PAGE_SIZE];
+  memset(data, 0, sizeof(data));
+
+  // (4 + 256) bytes over SPI + program
+  EXPECT_TRUE(flash.programPage(0, data, sizeof(data)));
+  EXPECT_EQ(flash.getStats().busyUs, 260 + 1000);
+
+  // 4 bytes over SPI + erase
+  EXPECT_TRUE(flash.eraseSector(0));
+  EXPECT_EQ(flash.getStats().busyUs, 260 + 1000 + 4 + 50000);
+
+  // Read (4 + 4096) + erase (4 + 50000) + one page (260 + 1000)
+  flash.resetStats();
+  EXPECT_EQ(flash.getStats().busyUs, 0);
+  EXPECT_TRUE(flash.write(0, data, 16, 0));
+  EXPECT_EQ(flash.getStats().busyUs, 4100 + 50004 + 1260);
+}
+
+TEST_F(SimStorageTest, FileBacked)
+{
+  char path[] = "/tmp/sim_storage_utXXXXXX";
+  int fd = mkstemp(path);
+  ASSERT_GE(fd, 0);
+  close(fd);
+
+  uint8_t data[8] = {1, 2, 3, 4, 5, 6, 7, 8};
+  uint8_t buff[8];
+  {
+    SimStorageDriver flash(path, TEST_FLASH_SIZE);
+
+    // New file starts erased
+    EXPECT_TRUE(flash.read(TEST_FLASH_SIZE - sizeof(buff), buff, sizeof(buff), 0));
+    for(uint32_t idx = 0; idx < sizeof(buff); idx++) {
+      EXPECT_EQ(buff[idx], 0xFF);
+    }
+    EXPECT_TRUE(flash.write(5000, data, sizeof(data), 0));
+  }
+
+  // Contents survive a "power cycle"
+  {
+    SimStorageDriver flash(path, TEST_FLASH_SIZE);
+    EXPECT_TRUE(flash.read(5000, buff, sizeof(buff), 0));
+    EXPECT_EQ(memcmp(buff, data, sizeof(data)), 0);
+    EXPECT_TRUE(flash.read(0, buff, sizeof(buff), 0));
+    for(uint32_t idx = 0; idx < sizeof(buff); idx++) {
+      EXPECT_EQ(buff[idx], 0xFF);
+    }
+  }
+
+  unlink(path);
+}
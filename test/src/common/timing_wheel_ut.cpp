@@ -0,0 +1,201 @@
+#include "gtest/gtest.h"
+
+#include <algorithm>
+#include <random>
+#include <vector>
+
+#include "timing_wheel.h"
+
+#define RESOLUTION (10)
+
+static std::vector<timingWheelEntry_t *> toVector(timingWheelEntry_t *list) {
+  std::vector<timingWheelEntry_t *> entries;
+  for(; list != NULL; list = list->next) {
+    entries.push_back(list);
+  }
+  return entries;
+}
+
+// The fixture for testing the timing wheel.
+class TimingWheelTest : public ::testing::Test {
+ protected:
+  // You can remove any or all of the following functions if its body
+  // is empty.
+
+  TimingWheelTest() {
+     // You can do set-up work for each test here.
+  }
+
+  ~TimingWheelTest() override {
+     // You can do clean-up work that doesn't throw exceptions here.
+  }
+
+  // If the constructor and destructor are not enough for setting up
+  // and cleaning up each test, you can define the following methods:
+
+  void SetUp() override {
+     // Code here will be called immediately after the constructor (right
+     // before each test).
+     timingWheelInit(&_wheel, RESOLUTION, 0);
+     memset(_entries, 0, sizeof(_entries));
+  }
+
+  void TearDown() override {
+     // Code here will be called immediately after each test (right
+     // before the destructor).
+  }
+
+  // Objects declared here can be used by all tests in the test suite.
+  timingWheel_t _wheel;
+  timingWheelEntry_t _entries[8];
+};
+
+TEST_F(TimingWheelTest, Empty)
+{
+  uint32_t due;
+  EXPECT_FALSE(timingWheelNext(&_wheel, &due));
+  EXPECT_EQ(timingWheelExpire(&_wheel, 1000), nullptr);
+}
+
+TEST_F(TimingWheelTest, ExpiresInOrder)
+{
+  uint32_t due = 0;
+  timingWheelInsert(&_wheel, &_entries[0], 500);
+  timingWheelInsert(&_wheel, &_entries[1], 125);
+  // Same slot, different revolution
+  timingWheelInsert(&_wheel, &_entries[2], 125 + RESOLUTION * TIMING_WHEEL_SLOTS);
+
+  EXPECT_TRUE(timingWheelNext(&_wheel, &due));
+  EXPECT_EQ(due, 125u);
+
+  EXPECT_EQ(timingWheelExpire(&_wheel, 124), nullptr);
+  EXPECT_EQ(toVector(timingWheelExpire(&_wheel, 125)), std::vector<timingWheelEntry_t *>{&_entries[1]});
+  EXPECT_FALSE(_entries[1].scheduled);
+
+  EXPECT_TRUE(timingWheelNext(&_wheel, &due));
+  EXPECT_EQ(due, 500u);
+  EXPECT_EQ(toVector(timingWheelExpire(&_wheel, 600)), std::vector<timingWheelEntry_t *>{&_entries[0]});
+
+  // Only entry left is more than a revolution away
+  EXPECT_TRUE(timingWheelNext(&_wheel, &due));
+  EXPECT_EQ(due, 125u + RESOLUTION * TIMING_WHEEL_SLOTS);
+  EXPECT_EQ(timingWheelExpire(&_wheel, 700), nullptr);
+  EXPECT_EQ(toVector(timingWheelExpire(&_wheel, due)), std::vector<timingWheelEntry_t *>{&_entries[2]});
+  EXPECT_FALSE(timingWheelNext(&_wheel, &due));
+}
+
+TEST_F(TimingWheelTest, Remove)
+{
+  uint32_t due = 0;
+  timingWheelInsert(&_wheel, &_entries[0], 100);
+  timingWheelInsert(&_wheel, &_entries[1], 200);
+
+  timingWheelRemove(&_wheel, &_entries[0]);
+  EXPECT_FALSE(_entries[0].scheduled);
+  EXPECT_TRUE(timingWheelNext(&_wheel, &due));
+  EXPECT_EQ(due, 200u);
+
+  // Removing twice is fine
+  timingWheelRemove(&_wheel, &_entries[0]);
+
+  // Re-inserting moves the entry
+  timingWheelInsert(&_wheel, &_entries[1], 50);
+  EXPECT_TRUE(timingWheelNext(&_wheel, &due));
+  EXPECT_EQ(due, 50u);
+  EXPECT_EQ(toVector(timingWheelExpire(&_wheel, 1000)), std::vector<timingWheelEntry_t *>{&_entries[1]});
+}
+
+TEST_F(TimingWheelTest, Jitter)
+{
+  // Entry 1 can go up to 30 ticks early, entry 2 can't
+  _entries[1].jitter = 30;
+  timingWheelInsert(&_wheel, &_entries[0], 1000);
+  timingWheelInsert(&_wheel, &_entries[1], 1025);
+  timingWheelInsert(&_wheel, &_entries[2], 1025);
+
+  auto expired = toVector(timingWheelExpire(&_wheel, 1000));
+  std::sort(expired.begin(), expired.end());
+  EXPECT_EQ(expired, (std::vector<timingWheelEntry_t *>{&_entries[0], &_entries[1]}));
+
+  EXPECT_EQ(toVector(timingWheelExpire(&_wheel, 1025)), std::vector<timingWheelEntry_t *>{&_entries[2]});
+}
+
+TEST_F(TimingWheelTest, LateExpire)
+{
+  // Overdue entries (and entries many revolutions old) are still found
+  timingWheelInsert(&_wheel, &_entries[0], 100);
+  timingWheelInsert(&_wheel, &_entries[1], 5000);
+
+  auto expired = toVector(timingWheelExpire(&_wheel, 100000));
+  EXPECT_EQ(expired.size(), 2u);
+
+  // Inserting in the past expires right away
+  timingWheelInsert(&_wheel, &_entries[2], 99990);
+  uint32_t due = 0;
+  EXPECT_TRUE(timingWheelNext(&_wheel, &due));
+  EXPECT_EQ(due, 99990u);
+  EXPECT_EQ(toVector(timingWheelExpire(&_wheel, 100001)), std::vector<timingWheelEntry_t *>{&_entries[2]});
+}
+
+TEST_F(TimingWheelTest, Wraparound)
+{
+  uint32_t now = UINT32_MAX - 100;
+  uint32_t due = 0;
+  timingWheelInit(&_wheel, RESOLUTION, now);
+
+  timingWheelInsert(&_wheel, &_entries[0], now + 50);
+  timingWheelInsert(&_wheel, &_entries[1], now + 150);
+
+  EXPECT_TRUE(timingWheelNext(&_wheel, &due));
+  EXPECT_EQ(due, now + 50);
+
+  EXPECT_EQ(toVector(timingWheelExpire(&_wheel, now + 100)), std::vector<timingWheelEntry_t *>{&_entries[0]});
+  EXPECT_TRUE(timingWheelNext(&_wheel, &due));
+  EXPECT_EQ(due, now + 150);
+  EXPECT_EQ(timingWheelExpire(&_wheel, now + 149), nullptr);
+  EXPECT_EQ(toVector(timingWheelExpire(&_wheel, now + 150)), std::vector<timingWheelEntry_t *>{&_entries[1]});
+}
+
+TEST_F(TimingWheelTest, Align)
+{
+  EXPECT_EQ(timingWheelAlign(0, 1000), 1000u);
+  EXPECT_EQ(timingWheelAlign(999, 1000), 1000u);
+  EXPECT_EQ(timingWheelAlign(1000, 1000), 2000u);
+  EXPECT_EQ(timingWheelAlign(1234, 500), 1500u);
+  EXPECT_EQ(timingWheelAlign(1234, 0), 1234u);
+}
+
+TEST_F(TimingWheelTest, PeriodicMatchesReference)
+{
+  // Simulate periodic entries and compare against brute force
+  const uint32_t periods[] = {100, 250, 1000, 1000, 3000, 7, 640, 10000};
+  std::mt19937 rng(1);
+  std::vector<uint32_t> expectedDue(8);
+  uint32_t now = 0;
+
+  for(uint32_t idx = 0; idx < 8; idx++) {
+    expectedDue[idx] = timingWheelAlign(now, periods[idx]);
+    timingWheelInsert(&_wheel, &_entries[idx], expectedDue[idx]);
+  }
+
+  for(uint32_t iteration = 0; iteration < 2000; iteration++) {
+    uint32_t next = 0;
+    ASSERT_TRUE(timingWheelNext(&_wheel, &next));
+    EXPECT_EQ(next, *std::min_element(expectedDue.begin(), expectedDue.end()));
+
+    // Sometimes wake up late
+    now = next + ((rng() % 4 == 0) ? rng() % 50 : 0);
+
+    for(timingWheelEntry_t *entry : toVector(timingWheelExpire(&_wheel, now))) {
+      uint32_t idx = entry - _entries;
+      EXPECT_LE(expectedDue[idx], now);
+      expectedDue[idx] = timingWheelAlign(now, periods[idx]);
+      timingWheelInsert(&_wheel, entry, expectedDue[idx]);
+    }
+
+    // Nothing left behind
+    for(uint32_t idx = 0; idx < 8; idx++) {
+      EXPECT_GT(expectedDue[idx], now);
+    }
+  }
+}
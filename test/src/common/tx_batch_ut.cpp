@@ -0,0 +1,168 @@
+#include "gtest/gtest.h"
+
+#include <string>
+#include <vector>
+#include <string.h>
+
+#include "tx_batch.h"
+
+#define BATCH_LEN (16)
+#define BATCH_THRESHOLD (12)
+
+static std::vector<std::string> sent;
+static bool flushOk = true;
+
+static bool flushFn(uint8_t *buff, size_t len, void *ctx) {
+  (void)ctx;
+  sent.push_back(std::string(reinterpret_cast<char *>(buff), len));
+  free(buff);
+  return flushOk;
+}
+
+// The fixture for testing the transmit batcher.
+class TxBatchTest : public ::testing::Test {
+ protected:
+  // You can remove any or all of the following functions if its body
+  // is empty.
+
+  TxBatchTest() {
+     // You can do set-up work for each test here.
+  }
+
+  ~TxBatchTest() override {
+     // You can do clean-up work that doesn't throw exceptions here.
+  }
+
+  // If the constructor and destructor are not enough for setting up
+  // and cleaning up each test, you can define the following methods:
+
+  void SetUp() override {
+     // Code here will be called immediately after the constructor (right
+     // before each test).
+     sent.clear();
+     flushOk = true;
+     txBatchInit(&_batch, BATCH_LEN, BATCH_THRESHOLD, flushFn, NULL);
+  }
+
+  void TearDown() override {
+     // Code here will be called immediately after each test (right
+     // before the destructor).
+     free(_batch.buff);
+  }
+
+  bool add(const std::string &frame) {
+    uint8_t *buff = txBatchReserve(&_batch, frame.size());
+    if(buff == NULL) {
+      return false;
+    }
+    memcpy(buff, frame.data(), frame.size());
+    txBatchCommit(&_batch, frame.size());
+    return true;
+  }
+
+  txBatch_t _batch;
+};
+
+TEST_F(TxBatchTest, CollectUntilFlush) {
+  EXPECT_TRUE(add("abc"));
+  EXPECT_TRUE(add("de"));
+  EXPECT_EQ(sent.size(), 0);
+  EXPECT_EQ(txBatchPendingFrames(&_batch), 2);
+
+  EXPECT_TRUE(txBatchFlush(&_batch));
+  ASSERT_EQ(sent.size(), 1);
+  EXPECT_EQ(sent[0], "abcde");
+  EXPECT_EQ(txBatchPendingFrames(&_batch), 0);
+  EXPECT_EQ(_batch.batches.value, 1);
+  EXPECT_EQ(_batch.frames.value, 2);
+  EXPECT_EQ(_batch.bytes.value, 5);
+  EXPECT_EQ(_batch.framesPerBatchMax.value, 2);
+
+  // Nothing left to send
+  EXPECT_TRUE(txBatchFlush(&_batch));
+  EXPECT_EQ(sent.size(), 1);
+}
+
+TEST_F(TxBatchTest, Threshold) {
+  EXPECT_TRUE(add("abcdef"));
+  EXPECT_EQ(sent.size(), 0);
+
+  // Reaches the threshold, so it goes out right away
+  EXPECT_TRUE(add("ghijkl"));
+  ASSERT_EQ(sent.size(), 1);
+  EXPECT_EQ(sent[0], "abcdefghijkl");
+  EXPECT_EQ(txBatchPendingFrames(&_batch), 0);
+}
+
+TEST_F(TxBatchTest, FlushWhenFull) {
+  EXPECT_TRUE(add("abcdefghij"));
+
+  // Doesn't fit after the first one, which is sent first
+  EXPECT_TRUE(add("klmnopq"));
+  ASSERT_EQ(sent.size(), 1);
+  EXPECT_EQ(sent[0], "abcdefghij");
+
+  EXPECT_TRUE(txBatchFlush(&_batch));
+  ASSERT_EQ(sent.size(), 2);
+  EXPECT_EQ(sent[1], "klmnopq");
+}
+
+TEST_F(TxBatchTest, TooLarge) {
+  EXPECT_TRUE(add("abc"));
+  EXPECT_FALSE(add(std::string(BATCH_LEN + 1, 'x')));
+  EXPECT_EQ(_batch.drops.value, 1);
+
+  // Frames already in the batch are kept
+  EXPECT_EQ(txBatchPendingFrames(&_batch), 1);
+  EXPECT_TRUE(txBatchFlush(&_batch));
+  ASSERT_EQ(sent.size(), 1);
+  EXPECT_EQ(sent[0], "abc");
+}
+
+TEST_F(TxBatchTest, ReserveMoreThanUsed) {
+  // Reserve the worst case, but only use part of it
+  uint8_t *buff = txBatchReserve(&_batch, 8);
+  ASSERT_NE(buff, nullptr);
+  memcpy(buff, "ab", 2);
+  txBatchCommit(&_batch, 2);
+
+  buff = txBatchReserve(&_batch, 8);
+  ASSERT_NE(buff, nullptr);
+  memcpy(buff, "cd", 2);
+  txBatchCommit(&_batch, 2);
+
+  EXPECT_EQ(sent.size(), 0);
+  EXPECT_TRUE(txBatchFlush(&_batch));
+  ASSERT_EQ(sent.size(), 1);
+  EXPECT_EQ(sent[0], "abcd");
+}
+
+TEST_F(TxBatchTest, FlushFail) {
+  flushOk = false;
+  EXPECT_TRUE(add("abc"));
+  EXPECT_TRUE(add("de"));
+  EXPECT_FALSE(txBatchFlush(&_batch));
+  EXPECT_EQ(_batch.drops.value, 2);
+  EXPECT_EQ(txBatchPendingFrames(&_batch), 0);
+}
+
+TEST_F(TxBatchTest, Rates) {
+  EXPECT_TRUE(add("abc"));
+  EXPECT_TRUE(add("de"));
+  EXPECT_TRUE(txBatchFlush(&_batch));
+
+  txBatchUpdateRates(&_batch, 500);
+  EXPECT_EQ(_batch.frameRate.value, 4);
+  EXPECT_EQ(_batch.byteRate.value, 10);
+
+  // Only counts what happened since the last update
+  EXPECT_TRUE(add("f"));
+  EXPECT_TRUE(txBatchFlush(&_batch));
+  txBatchUpdateRates(&_batch, 1000);
+  EXPECT_EQ(_batch.frameRate.value, 1);
+  EXPECT_EQ(_batch.byteRate.value, 1);
+
+  txBatchUpdateRates(&_batch, 1000);
+  EXPECT_EQ(_batch.frameRate.value, 0);
+  EXPECT_EQ(_batch.byteRate.value, 0);
+}
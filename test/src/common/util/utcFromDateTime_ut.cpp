@@ -32,6 +32,29 @@ class UTCFromDateTime : public ::testing::Test {
   }
 
   // Objects declared here can be used by all tests in the test suite for Foo.
+
+  static bool isLeapYear(uint32_t year) {
+    return ((year % 4) == 0) && (((year % 100) != 0) || ((year % 400) == 0));
+  }
+
+  // The year/month loop conversion utcFromDateTime used before days from civil
+  static uint32_t loopUtcFromDateTime(uint16_t year, uint8_t month, uint8_t day, uint8_t hour, uint8_t minute, uint8_t second) {
+    static const uint8_t monthDays[] = {31, 28, 31, 30, 31, 30, 31, 31, 30, 31, 30, 31};
+    uint32_t seconds = (year - 1970) * (86400UL * 365);
+    for(uint32_t i = 1970; i < year; i++) {
+      if(isLeapYear(i)) {
+        seconds += 86400UL;
+      }
+    }
+    for(uint32_t i = 1; i < month; i++) {
+      seconds += 86400UL * ((i == 2 && isLeapYear(year)) ? 29 : monthDays[i - 1]);
+    }
+    seconds += (day - 1) * 86400UL;
+    seconds += hour * 3600UL;
+    seconds += minute * 60UL;
+    seconds += second;
+    return seconds;
+  }
 };
 
 // Check the "beggining of time"
@@ -216,4 +239,50 @@ TEST_F(UTCFromDateTime, Check2038)
   EXPECT_EQ(datetime.min, 0);
   EXPECT_EQ(datetime.sec, 0);
   EXPECT_EQ(datetime.usec, 0);
-}
\ No newline at end of file
+}
+
+// Every day from 1970 until the 32 bit timestamp runs out
+TEST_F(UTCFromDateTime, EveryDayMatchesLoop)
+{
+  static const uint8_t monthDays[] = {31, 28, 31, 30, 31, 30, 31, 31, 30, 31, 30, 31};
+  int32_t days = 0;
+  for(uint16_t year = 1970; year < 2106; year++) {
+    for(uint8_t month = 1; month <= 12; month++) {
+      uint8_t daysInMonth = (month == 2 && isLeapYear(year)) ? 29 : monthDays[month - 1];
+      for(uint8_t day = 1; day <= daysInMonth; day++) {
+        ASSERT_EQ(daysFromCivil(year, month, day), days);
+        ASSERT_EQ(utcFromDateTime(year, month, day, 12, 34, 56), loopUtcFromDateTime(year, month, day, 12, 34, 56));
+
+        int32_t civilYear;
+        uint32_t civilMonth;
+        uint32_t civilDay;
+        civilFromDays(days, &civilYear, &civilMonth, &civilDay);
+        ASSERT_EQ(civilYear, year);
+        ASSERT_EQ(civilMonth, month);
+        ASSERT_EQ(civilDay, day);
+
+        utcDateTime_t datetime;
+        dateTimeFromUtc(static_cast<uint64_t>(utcFromDateTime(year, month, day, 23, 59, 59)) * MICROSECONDS_PER_SECOND, &datetime);
+        ASSERT_EQ(datetime.year, year);
+        ASSERT_EQ(datetime.month, month);
+        ASSERT_EQ(datetime.day, day);
+        days++;
+      }
+    }
+  }
+}
+
+TEST_F(UTCFromDateTime, DaysBeforeEpoch)
+{
+  EXPECT_EQ(daysFromCivil(1969, 12, 31), -1);
+  EXPECT_EQ(daysFromCivil(1900, 1, 1), -25567);
+  EXPECT_EQ(daysFromCivil(2000, 3, 1), 11017);
+
+  int32_t year;
+  uint32_t month;
+  uint32_t day;
+  civilFromDays(-25567, &year, &month, &day);
+  EXPECT_EQ(year, 1900);
+  EXPECT_EQ(month, 1);
+  EXPECT_EQ(day, 1);
+}
@@ -0,0 +1,425 @@
+#include <vector>
+#include "gtest/gtest.h"
+
+#include "i2c_engine.h"
+#include "lpm.h"
+#include "stm32u5xx_hal.h"
+#include "fff.h"
+
+DEFINE_FFF_GLOBALS;
+
+FAKE_VOID_FUNC(lpmPeripheralActive, uint32_t);
+FAKE_VOID_FUNC(lpmPeripheralActiveFromISR, uint32_t);
+FAKE_VOID_FUNC(lpmPeripheralInactive, uint32_t);
+FAKE_VOID_FUNC(lpmPeripheralInactiveFromISR, uint32_t);
+FAKE_VOID_FUNC(busInit);
+
+//
+// HAL mock. Records transfers and simulates bus time. Transfers complete
+// when the test calls completeTransfer() (which is where the HAL would call
+// back from the interrupt handler).
+//
+#define MOCK_BUS_HZ 100000
+// 9 bits per byte (8 + ack) plus the address byte
+#define MOCK_TRANSFER_US(len) ((((len) + 1) * 9 * 1000000UL) / MOCK_BUS_HZ)
+
+typedef struct {
+  bool read;
+  uint8_t address;
+  uint16_t len;
+  uint32_t option;
+  uint8_t data;
+} mockTransfer_t;
+
+static int _fakeHandle;
+static I2C_HandleTypeDef *_handle = &_fakeHandle;
+static std::vector<mockTransfer_t> _transfers;
+static bool _pending;
+static uint32_t _errorCode;
+static uint32_t _timeUs;
+
+uint32_t HAL_GetTick(void) {
+  return _timeUs;
+}
+
+HAL_StatusTypeDef HAL_I2C_Master_Seq_Transmit_IT(I2C_HandleTypeDef *hi2c, uint16_t DevAddress, uint8_t *pData,
+                                                 uint16_t Size, uint32_t XferOptions) {
+  EXPECT_EQ(hi2c, _handle);
+  if(_pending) {
+    return HAL_BUSY;
+  }
+  _pending = true;
+  _errorCode = 0;
+  _transfers.push_back({false, (uint8_t)(DevAddress >> 1), Size, XferOptions, pData[0]});
+  return HAL_OK;
+}
+
+HAL_StatusTypeDef HAL_I2C_Master_Seq_Receive_IT(I2C_HandleTypeDef *hi2c, uint16_t DevAddress, uint8_t *pData,
+                                                uint16_t Size, uint32_t XferOptions) {
+  EXPECT_EQ(hi2c, _handle);
+  if(_pending) {
+    return HAL_BUSY;
+  }
+  _pending = true;
+  _errorCode = 0;
+  for(uint16_t idx = 0; idx < Size; idx++) {
+    pData[idx] = (uint8_t)(0xA0 + idx);
+  }
+  _transfers.push_back({true, (uint8_t)(DevAddress >> 1), Size, XferOptions, 0});
+  return HAL_OK;
+}
+
+uint32_t HAL_I2C_GetError(I2C_HandleTypeDef *hi2c) {
+  (void)hi2c;
+  return _errorCode;
+}
+
+// Finish the current transfer (like the HAL interrupt handler would)
+static void completeTransfer(uint32_t errorCode=0) {
+  ASSERT_TRUE(_pending);
+  _pending = false;
+  _timeUs += MOCK_TRANSFER_US(_transfers.back().len);
+  _errorCode = errorCode;
+  if(errorCode) {
+    HAL_I2C_ErrorCallback(_handle);
+  } else if(_transfers.back().read) {
+    HAL_I2C_MasterRxCpltCallback(_handle);
+  } else {
+    HAL_I2C_MasterTxCpltCallback(_handle);
+  }
+}
+
+// Complete transfers until the bus is idle
+static void runBus() {
+  while(_pending) {
+    completeTransfer();
+  }
+}
+
+static std::vector<i2cTransaction_t *> _completed;
+
+static void transactionDone(i2cTransaction_t *transaction) {
+  _completed.push_back(transaction);
+}
+
+// The fixture for testing class Foo.
+class I2CEngineTest : public ::testing::Test {
+ protected:
+  // You can remove any or all of the following functions if its body
+  // is empty.
+
+  I2CEngineTest() {
+     // You can do set-up work for each test here.
+  }
+
+  ~I2CEngineTest() override {
+     // You can do clean-up work that doesn't throw exceptions here.
+  }
+
+  // If the constructor and destructor are not enough for setting up
+  // and cleaning up each test, you can define the following methods:
+
+  void SetUp() override {
+     // Code here will be called immediately after the constructor (right
+     // before each test).
+    RESET_FAKE(lpmPeripheralActive);
+    RESET_FAKE(lpmPeripheralActiveFromISR);
+    RESET_FAKE(lpmPeripheralInactive);
+    RESET_FAKE(lpmPeripheralInactiveFromISR);
+    RESET_FAKE(busInit);
+    _transfers.clear();
+    _completed.clear();
+    _pending = false;
+    _errorCode = 0;
+    _timeUs = 0;
+    i2cEngineInit(&engine, _handle, busInit, LPM_I2C1);
+  }
+
+  void TearDown() override {
+     // Code here will be called immediately after each test (right
+     // before the destructor).
+  }
+
+  void setupTransaction(i2cTransaction_t *transaction, const i2cOp_t *ops, uint8_t numOps) {
+    memset(transaction, 0, sizeof(i2cTransaction_t));
+    transaction->ops = ops;
+    transaction->numOps = numOps;
+    transaction->callback = transactionDone;
+  }
+
+  // Objects declared here can be used by all tests in the test suite for Foo.
+  i2cEngine_t engine;
+};
+
+TEST_F(I2CEngineTest, Ordering)
+{
+  uint8_t reg = 0x10;
+  uint8_t rxA[2];
+  uint8_t rxB[3];
+  i2cOp_t opsA[] = {{I2C_OP_WRITE, 0x40, 1, &reg}};
+  i2cOp_t opsB[] = {{I2C_OP_WRITE, 0x41, 1, &reg}, {I2C_OP_READ, 0x41, sizeof(rxA), rxA}};
+  i2cOp_t opsC[] = {{I2C_OP_READ, 0x42, sizeof(rxB), rxB}};
+
+  i2cTransaction_t a, b, c;
+  setupTransaction(&a, opsA, 1);
+  setupTransaction(&b, opsB, 2);
+  setupTransaction(&c, opsC, 1);
+
+  EXPECT_TRUE(i2cEngineSubmit(&engine, &a));
+  EXPECT_TRUE(i2cEngineSubmit(&engine, &b));
+  EXPECT_TRUE(i2cEngineSubmit(&engine, &c));
+
+  // First one starts right away, the rest wait in the queue
+  EXPECT_EQ(_transfers.size(), 1);
+  EXPECT_TRUE(engine.busy);
+  EXPECT_FALSE(a.done);
+  EXPECT_EQ(lpmPeripheralActive_fake.call_count, 1);
+
+  runBus();
+
+  EXPECT_FALSE(engine.busy);
+  ASSERT_EQ(_completed.size(), 3);
+  EXPECT_EQ(_completed[0], &a);
+  EXPECT_EQ(_completed[1], &b);
+  EXPECT_EQ(_completed[2], &c);
+  EXPECT_TRUE(a.done && b.done && c.done);
+  EXPECT_EQ(a.result, I2C_OK);
+  EXPECT_EQ(b.result, I2C_OK);
+  EXPECT_EQ(c.result, I2C_OK);
+  EXPECT_EQ(rxA[1], 0xA1);
+  EXPECT_EQ(rxB[2], 0xA2);
+
+  ASSERT_EQ(_transfers.size(), 4);
+  EXPECT_EQ(_transfers[0].address, 0x40);
+  EXPECT_EQ(_transfers[0].option, I2C_FIRST_AND_LAST_FRAME);
+
+  // Write then read is a single transaction with a repeated start
+  EXPECT_EQ(_transfers[1].address, 0x41);
+  EXPECT_FALSE(_transfers[1].read);
+  EXPECT_EQ(_transfers[1].option, I2C_FIRST_FRAME);
+  EXPECT_EQ(_transfers[2].address, 0x41);
+  EXPECT_TRUE(_transfers[2].read);
+  EXPECT_EQ(_transfers[2].option, I2C_LAST_FRAME);
+
+  EXPECT_EQ(_transfers[3].address, 0x42);
+  EXPECT_EQ(_transfers[3].option, I2C_FIRST_AND_LAST_FRAME);
+
+  // Bus stayed active the whole time
+  EXPECT_EQ(lpmPeripheralActive_fake.call_count, 1);
+  EXPECT_EQ(lpmPeripheralActiveFromISR_fake.call_count, 0);
+  EXPECT_EQ(lpmPeripheralInactiveFromISR_fake.call_count, 1);
+
+  i2cEngineStats_t stats;
+  i2cEngineGetStats(&engine, &stats);
+  EXPECT_EQ(stats.transactions, 3);
+  EXPECT_EQ(stats.errors, 0);
+  EXPECT_EQ(stats.bytes, 1 + 1 + 2 + 3);
+  EXPECT_EQ(stats.queueMax, 3);
+}
+
+TEST_F(I2CEngineTest, FrameOptions)
+{
+  uint8_t buff[4] = {1, 2, 3, 4};
+  // Scatter write (two buffers, one frame), then a different device
+  i2cOp_t ops[] = {
+    {I2C_OP_WRITE, 0x40, 1, &buff[0]},
+    {I2C_OP_WRITE, 0x40, 1, &buff[1]},
+    {I2C_OP_WRITE, 0x40, 1, &buff[2]},
+    {I2C_OP_READ, 0x50, 1, &buff[3]},
+  };
+
+  i2cTransaction_t transaction;
+  setupTransaction(&transaction, ops, 4);
+  EXPECT_TRUE(i2cEngineSubmit(&engine, &transaction));
+  runBus();
+
+  ASSERT_EQ(_transfers.size(), 4);
+  EXPECT_EQ(_transfers[0].option, I2C_FIRST_FRAME);
+  EXPECT_EQ(_transfers[1].option, I2C_NEXT_FRAME);
+  EXPECT_EQ(_transfers[2].option, I2C_LAST_FRAME);
+  EXPECT_EQ(_transfers[3].option, I2C_FIRST_AND_LAST_FRAME);
+  EXPECT_EQ(transaction.result, I2C_OK);
+}
+
+TEST_F(I2CEngineTest, MuxFolding)
+{
+  i2cMux_t mux = {0x70, 0};
+  uint8_t reg = 0x00;
+  uint8_t rx[2];
+  i2cOp_t ops[] = {{I2C_OP_WRITE, 0x40, 1, &reg}, {I2C_OP_READ, 0x40, sizeof(rx), rx}};
+
+  i2cTransaction_t a, b, c;
+  setupTransaction(&a, ops, 2);
+  a.mux = &mux;
+  a.muxChannel = 0x01;
+  setupTransaction(&b, ops, 2);
+  b.mux = &mux;
+  b.muxChannel = 0x01;
+  setupTransaction(&c, ops, 2);
+  c.mux = &mux;
+  c.muxChannel = 0x04;
+
+  i2cEngineSubmit(&engine, &a);
+  i2cEngineSubmit(&engine, &b);
+  i2cEngineSubmit(&engine, &c);
+  runBus();
+
+  // Channel is only selected when it changes
+  ASSERT_EQ(_transfers.size(), 8);
+  EXPECT_EQ(_transfers[0].address, 0x70);
+  EXPECT_EQ(_transfers[0].data, 0x01);
+  EXPECT_EQ(_transfers[0].option, I2C_FIRST_AND_LAST_FRAME);
+  EXPECT_EQ(_transfers[1].address, 0x40);
+  EXPECT_EQ(_transfers[2].address, 0x40);
+  EXPECT_EQ(_transfers[3].address, 0x40);
+  EXPECT_EQ(_transfers[4].address, 0x40);
+  EXPECT_EQ(_transfers[5].address, 0x70);
+  EXPECT_EQ(_transfers[5].data, 0x04);
+  EXPECT_EQ(_transfers[6].address, 0x40);
+  EXPECT_EQ(_transfers[7].address, 0x40);
+  EXPECT_EQ(mux.channel, 0x04);
+  EXPECT_EQ(c.result, I2C_OK);
+}
+
+TEST_F(I2CEngineTest, Errors)
+{
+  i2cMux_t mux = {0x70, 0x01};
+  uint8_t reg = 0x00;
+  uint8_t rx[2];
+  i2cOp_t ops[] = {{I2C_OP_WRITE, 0x40, 1, &reg}, {I2C_OP_READ, 0x40, sizeof(rx), rx}};
+
+  i2cTransaction_t a, b;
+  setupTransaction(&a, ops, 2);
+  a.mux = &mux;
+  a.muxChannel = 0x01;
+  setupTransaction(&b, ops, 2);
+  b.mux = &mux;
+  b.muxChannel = 0x01;
+
+  i2cEngineSubmit(&engine, &a);
+  i2cEngineSubmit(&engine, &b);
+
+  // Channel already selected, so first transfer is the register write
+  ASSERT_EQ(_transfers.size(), 1);
+  EXPECT_EQ(_transfers[0].address, 0x40);
+
+  // NACK ends the transaction and the next one starts
+  completeTransfer(HAL_I2C_ERROR_AF);
+  ASSERT_EQ(_completed.size(), 1);
+  EXPECT_EQ(a.result, I2C_NACK);
+
+  // Mux is selected again after an error
+  ASSERT_EQ(_transfers.size(), 2);
+  EXPECT_EQ(_transfers[1].address, 0x70);
+
+  runBus();
+  EXPECT_EQ(b.result, I2C_OK);
+
+  i2cEngineStats_t stats;
+  i2cEngineGetStats(&engine, &stats);
+  EXPECT_EQ(stats.transactions, 2);
+  EXPECT_EQ(stats.errors, 1);
+}
+
+TEST_F(I2CEngineTest, Cancel)
+{
+  uint8_t reg = 0x00;
+  i2cOp_t ops[] = {{I2C_OP_WRITE, 0x40, 1, &reg}};
+
+  i2cTransaction_t a, b, c;
+  setupTransaction(&a, ops, 1);
+  setupTransaction(&b, ops, 1);
+  setupTransaction(&c, ops, 1);
+
+  i2cEngineSubmit(&engine, &a);
+  i2cEngineSubmit(&engine, &b);
+  i2cEngineSubmit(&engine, &c);
+
+  // Cancel queued transaction
+  EXPECT_TRUE(i2cEngineCancel(&engine, &b));
+  EXPECT_TRUE(b.done);
+  EXPECT_EQ(b.result, I2C_TIMEOUT);
+  EXPECT_EQ(busInit_fake.call_count, 0);
+
+  // Cancel active transaction, bus gets re-initialized and c starts
+  _pending = false;
+  EXPECT_TRUE(i2cEngineCancel(&engine, &a));
+  EXPECT_EQ(busInit_fake.call_count, 1);
+  EXPECT_EQ(_transfers.size(), 2);
+
+  runBus();
+  ASSERT_EQ(_completed.size(), 1);
+  EXPECT_EQ(_completed[0], &c);
+
+  // Can't cancel completed transactions
+  EXPECT_FALSE(i2cEngineCancel(&engine, &c));
+  EXPECT_EQ(engine.queueLen, 0);
+}
+
+TEST_F(I2CEngineTest, Hold)
+{
+  uint8_t reg = 0x00;
+  i2cOp_t ops[] = {{I2C_OP_WRITE, 0x40, 1, &reg}};
+
+  i2cTransaction_t a;
+  setupTransaction(&a, ops, 1);
+
+  EXPECT_TRUE(i2cEngineHold(&engine, 10));
+  EXPECT_TRUE(i2cEngineSubmit(&engine, &a));
+  EXPECT_EQ(_transfers.size(), 0);
+
+  i2cEngineRelease(&engine);
+  EXPECT_EQ(_transfers.size(), 1);
+
+  // Can't hold while a transaction is in progress
+  EXPECT_FALSE(i2cEngineHold(&engine, 10));
+  EXPECT_FALSE(engine.held);
+
+  runBus();
+  EXPECT_EQ(a.result, I2C_OK);
+
+  // Submitting without ops fails
+  a.numOps = 0;
+  EXPECT_FALSE(i2cEngineSubmit(&engine, &a));
+}
+
+TEST_F(I2CEngineTest, BusUtilization)
+{
+  // Typical sensor poll: register write + 2 byte read from 4 devices, every 10ms
+  uint8_t reg = 0x00;
+  uint8_t rx[4][2];
+  i2cOp_t ops[4][2];
+  i2cTransaction_t transactions[4];
+
+  const uint32_t periodUs = 10000;
+  const uint32_t numPeriods = 100;
+  for(uint32_t period = 0; period < numPeriods; period++) {
+    uint32_t periodStart = period * periodUs;
+    _timeUs = periodStart;
+
+    for(uint8_t dev = 0; dev < 4; dev++) {
+      ops[dev][0] = {I2C_OP_WRITE, (uint8_t)(0x40 + dev), 1, &reg};
+      ops[dev][1] = {I2C_OP_READ, (uint8_t)(0x40 + dev), sizeof(rx[dev]), rx[dev]};
+      setupTransaction(&transactions[dev], ops[dev], 2);
+      i2cEngineSubmit(&engine, &transactions[dev]);
+    }
+    runBus();
+  }
+
+  i2cEngineStats_t stats;
+  i2cEngineGetStats(&engine, &stats);
+  EXPECT_EQ(stats.transactions, numPeriods * 4);
+  EXPECT_EQ(stats.bytes, numPeriods * 4 * 3);
+
+  // Busy time is the sum of the simulated transfers
+  uint64_t expectedUs = numPeriods * 4 * (MOCK_TRANSFER_US(1) + MOCK_TRANSFER_US(2));
+  EXPECT_EQ(stats.busyTime, expectedUs);
+
+  // Bus only woke up once per period
+  EXPECT_EQ(lpmPeripheralActive_fake.call_count, numPeriods);
+  EXPECT_EQ(lpmPeripheralInactiveFromISR_fake.call_count, numPeriods);
+
+  double utilization = (double)stats.busyTime / (numPeriods * periodUs);
+  EXPECT_NEAR(utilization, 0.18, 0.0001);
+  printf("I2C bus utilization: %0.2f%%\n", utilization * 100.0);
+}
@@ -59,3 +59,60 @@ TEST_F(Ina232Test, BasicConfigTest)
   EXPECT_EQ(i2cTxRx_fake.call_count, 15);
   EXPECT_EQ(ina.getTotalConversionTimeMs(), 793);
 }
+
+// Simple register map for the fake I2C device
+static uint16_t fakeRegs[256];
+static uint8_t fakeRegAddr;
+
+static I2CResponse_t fakeRegTxRx(I2CInterface_t *interface, uint8_t address, uint8_t *txBuff, size_t txLen, uint8_t *rxBuff, size_t rxLen, uint32_t timeoutMs) {
+  (void)interface;
+  (void)address;
+  (void)timeoutMs;
+
+  if(txLen) {
+    fakeRegAddr = txBuff[0];
+  }
+
+  if(rxLen == sizeof(uint16_t)) {
+    rxBuff[0] = fakeRegs[fakeRegAddr] >> 8;
+    rxBuff[1] = fakeRegs[fakeRegAddr] & 0xFF;
+  }
+
+  return I2C_OK;
+}
+
+TEST_F(Ina232Test, AsyncRead)
+{
+  I2CInterface_t i2c;
+  INA232 ina(&i2c);
+  float voltage, current;
+  bool ready = true;
+
+  memset(fakeRegs, 0, sizeof(fakeRegs));
+  i2cTxRx_fake.custom_fake = fakeRegTxRx;
+  ina.setShuntValue(0.01);
+
+  // No conversion yet
+  EXPECT_TRUE(ina.conversionReady(ready));
+  EXPECT_FALSE(ready);
+
+  // Conversion ready flag
+  fakeRegs[REG_MASK_EN] = (1 << 3);
+  EXPECT_TRUE(ina.conversionReady(ready));
+  EXPECT_TRUE(ready);
+
+  // 1mV across 10mOhm shunt and 5V bus
+  fakeRegs[REG_SHUNT_V] = 400;
+  fakeRegs[REG_BUS_V] = 3125;
+  EXPECT_TRUE(ina.readPower());
+  ina.getPower(voltage, current);
+  EXPECT_NEAR(voltage, 5.0, 0.001);
+  EXPECT_NEAR(current, 0.1, 0.001);
+
+  // I2C errors
+  i2cTxRx_fake.custom_fake = NULL;
+  i2cTxRx_fake.return_val = I2C_ERR;
+  EXPECT_FALSE(ina.conversionReady(ready));
+  EXPECT_FALSE(ready);
+  EXPECT_FALSE(ina.readPower());
+}
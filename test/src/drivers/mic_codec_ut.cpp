@@ -0,0 +1,271 @@
+#include "gtest/gtest.h"
+
+#include <chrono>
+#include <cmath>
+#include <random>
+#include <vector>
+
+#include "mic_codec.h"
+
+#define SAMPLE_RATE (50000)
+
+// 24-bit samples in 32-bit words, the way the SAI delivers them
+static std::vector<uint32_t> audio(uint32_t numSamples, double noise, uint32_t seed = 1) {
+  std::vector<uint32_t> samples(numSamples);
+  std::mt19937 rng(seed);
+  std::normal_distribution<double> gaussian(0, 1);
+
+  for(uint32_t idx = 0; idx < numSamples; idx++) {
+    double time = static_cast<double>(idx) / SAMPLE_RATE;
+    double value = 2e5 * sin(2.0 * M_PI * 180 * time) + 5e4 * sin(2.0 * M_PI * 1250 * time) +
+                   1e4 * sin(2.0 * M_PI * 4100 * time) + noise * gaussian(rng);
+    int32_t sample = static_cast<int32_t>(lround(value));
+    sample = std::max(std::min(sample, (1 << 23) - 1), -(1 << 23));
+    samples[idx] = static_cast<uint32_t>(sample) & 0xFFFFFF;
+  }
+
+  return samples;
+}
+
+static int32_t truncated(uint32_t sample, uint8_t sampleBits) {
+  return static_cast<int32_t>(sample << 8) >> (32 - sampleBits);
+}
+
+// The fixture for testing the hydrophone audio codec.
+class MicCodecTest : public ::testing::Test {
+ protected:
+  // You can remove any or all of the following functions if its body
+  // is empty.
+
+  MicCodecTest() {
+     // You can do set-up work for each test here.
+  }
+
+  ~MicCodecTest() override {
+     // You can do clean-up work that doesn't throw exceptions here.
+  }
+
+  // If the constructor and destructor are not enough for setting up
+  // and cleaning up each test, you can define the following methods:
+
+  void SetUp() override {
+     // Code here will be called immediately after the constructor (right
+     // before each test).
+  }
+
+  void TearDown() override {
+     // Code here will be called immediately after each test (right
+     // before the destructor).
+  }
+
+  // Encode everything in MIC_CODEC_MAX_SAMPLES packets, check that it decodes
+  // losslessly and return the total number of bytes
+  size_t roundTrip(micCodec_e type, uint8_t sampleBits, const std::vector<uint32_t> &samples) {
+    micCodec_t codec;
+    micCodecInit(&codec, type, sampleBits, SAMPLE_RATE);
+
+    size_t totalLen = 0;
+    for(uint32_t offset = 0; offset < samples.size(); offset += MIC_CODEC_MAX_SAMPLES) {
+      uint32_t count = std::min<uint32_t>(MIC_CODEC_MAX_SAMPLES, samples.size() - offset);
+      size_t len = micCodecEncode(&codec, &samples[offset], count, packet, sizeof(packet));
+      EXPECT_GT(len, sizeof(micCodecHeader_t));
+
+      int32_t decoded[MIC_CODEC_MAX_SAMPLES];
+      EXPECT_EQ(micCodecDecode(packet, len, decoded, MIC_CODEC_MAX_SAMPLES), static_cast<int32_t>(count));
+      for(uint32_t idx = 0; idx < count; idx++) {
+        EXPECT_EQ(decoded[idx], truncated(samples[offset + idx], sampleBits)) << "sample " << offset + idx;
+        if(decoded[idx] != truncated(samples[offset + idx], sampleBits)) {
+          return 0;
+        }
+      }
+      totalLen += len;
+    }
+
+    return totalLen;
+  }
+
+  // Objects declared here can be used by all tests in the test suite.
+  uint8_t packet[MIC_CODEC_MAX_PACKET_LEN];
+};
+
+TEST_F(MicCodecTest, Lossless16Bit)
+{
+  std::vector<uint32_t> samples = audio(SAMPLE_RATE, 1000);
+  size_t len = roundTrip(MIC_CODEC_RICE, 16, samples);
+  ASSERT_GT(len, 0u);
+
+  // Compared to the current int16 stream
+  double ratio = static_cast<double>(samples.size() * sizeof(int16_t)) / len;
+  printf("16-bit rice: %zu bytes, %.2fx\n", len, ratio);
+  EXPECT_GT(ratio, 2.0);
+}
+
+TEST_F(MicCodecTest, Lossless24Bit)
+{
+  std::vector<uint32_t> samples = audio(SAMPLE_RATE / 4, 1000);
+  size_t len = roundTrip(MIC_CODEC_RICE, 24, samples);
+  ASSERT_GT(len, 0u);
+
+  double ratio = static_cast<double>(samples.size() * 3) / len;
+  printf("24-bit rice: %zu bytes, %.2fx\n", len, ratio);
+  EXPECT_GT(ratio, 1.5);
+}
+
+TEST_F(MicCodecTest, RawRoundTrip)
+{
+  std::vector<uint32_t> samples = audio(2000, 1000);
+  size_t len = roundTrip(MIC_CODEC_RAW, 16, samples);
+  EXPECT_EQ(len, samples.size() * sizeof(int16_t) + 4 * sizeof(micCodecHeader_t));
+
+  EXPECT_GT(roundTrip(MIC_CODEC_RAW, 12, samples), 0u);
+}
+
+TEST_F(MicCodecTest, NoiseFallsBackToRaw)
+{
+  // Full scale white noise doesn't compress
+  std::mt19937 rng(3);
+  std::vector<uint32_t> samples(MIC_CODEC_MAX_SAMPLES);
+  for(auto &sample : samples) {
+    sample = rng() & 0xFFFFFF;
+  }
+
+  micCodec_t codec;
+  micCodecInit(&codec, MIC_CODEC_RICE, 24, SAMPLE_RATE);
+  size_t len = micCodecEncode(&codec, samples.data(), samples.size(), packet, sizeof(packet));
+  EXPECT_EQ(len, sizeof(micCodecHeader_t) + samples.size() * 3);
+
+  micCodecHeader_t header;
+  memcpy(&header, packet, sizeof(header));
+  EXPECT_EQ(header.codec, MIC_CODEC_RAW);
+
+  EXPECT_GT(roundTrip(MIC_CODEC_RICE, 24, samples), 0u);
+}
+
+TEST_F(MicCodecTest, Outliers)
+{
+  // Quiet signal with a few full scale clicks (escaped residuals)
+  std::vector<uint32_t> samples = audio(MIC_CODEC_MAX_SAMPLES * 2, 10);
+  samples[100] = 0x7FFFFF;
+  samples[101] = 0x800000;
+  samples[700] = 0x800000;
+  EXPECT_GT(roundTrip(MIC_CODEC_RICE, 24, samples), 0u);
+  EXPECT_GT(roundTrip(MIC_CODEC_RICE, 16, samples), 0u);
+}
+
+TEST_F(MicCodecTest, PacketsAreIndependent)
+{
+  std::vector<uint32_t> samples = audio(MIC_CODEC_MAX_SAMPLES * 4, 1000);
+
+  for(micCodec_e type : {MIC_CODEC_RICE, MIC_CODEC_ADPCM}) {
+    micCodec_t codec;
+    micCodecInit(&codec, type, 16, SAMPLE_RATE);
+
+    // Only keep the last packet
+    size_t len = 0;
+    for(uint32_t offset = 0; offset < samples.size(); offset += MIC_CODEC_MAX_SAMPLES) {
+      len = micCodecEncode(&codec, &samples[offset], MIC_CODEC_MAX_SAMPLES, packet, sizeof(packet));
+    }
+
+    micCodecHeader_t header;
+    memcpy(&header, packet, sizeof(header));
+    EXPECT_EQ(header.magic, MIC_CODEC_MAGIC);
+    EXPECT_EQ(header.sequence, 3u);
+    EXPECT_EQ(header.sampleOffset, 3u * MIC_CODEC_MAX_SAMPLES);
+    EXPECT_EQ(header.sampleRate, SAMPLE_RATE);
+
+    int32_t decoded[MIC_CODEC_MAX_SAMPLES];
+    ASSERT_EQ(micCodecDecode(packet, len, decoded, MIC_CODEC_MAX_SAMPLES), MIC_CODEC_MAX_SAMPLES);
+
+    // ADPCM won't be exact, but it has to track the signal
+    double error = 0;
+    for(uint32_t idx = 0; idx < MIC_CODEC_MAX_SAMPLES; idx++) {
+      error = std::max(error, std::fabs(decoded[idx] - truncated(samples[header.sampleOffset + idx], 16)));
+    }
+    EXPECT_LE(error, (type == MIC_CODEC_RICE) ? 0 : 200);
+  }
+}
+
+TEST_F(MicCodecTest, Adpcm)
+{
+  std::vector<uint32_t> samples = audio(SAMPLE_RATE / 2, 1000);
+
+  micCodec_t codec;
+  micCodecInit(&codec, MIC_CODEC_ADPCM, 24, SAMPLE_RATE);
+  EXPECT_EQ(codec.sampleBits, 16);
+
+  size_t totalLen = 0;
+  double signal = 0;
+  double noise = 0;
+  for(uint32_t offset = 0; offset + MIC_CODEC_MAX_SAMPLES <= samples.size(); offset += MIC_CODEC_MAX_SAMPLES) {
+    size_t len = micCodecEncode(&codec, &samples[offset], MIC_CODEC_MAX_SAMPLES, packet, sizeof(packet));
+    totalLen += len;
+
+    int32_t decoded[MIC_CODEC_MAX_SAMPLES];
+    ASSERT_EQ(micCodecDecode(packet, len, decoded, MIC_CODEC_MAX_SAMPLES), MIC_CODEC_MAX_SAMPLES);
+    for(uint32_t idx = 0; idx < MIC_CODEC_MAX_SAMPLES; idx++) {
+      double expected = truncated(samples[offset + idx], 16);
+      signal += expected * expected;
+      noise += (decoded[idx] - expected) * (decoded[idx] - expected);
+    }
+  }
+
+  double snr = 10 * log10(signal / noise);
+  double ratio = static_cast<double>((samples.size() / MIC_CODEC_MAX_SAMPLES) * MIC_CODEC_MAX_SAMPLES * sizeof(int16_t)) / totalLen;
+  printf("adpcm: %.2fx, snr %.1fdB\n", ratio, snr);
+  EXPECT_GT(ratio, 3.5);
+  EXPECT_GT(snr, 30);
+}
+
+TEST_F(MicCodecTest, InvalidPackets)
+{
+  std::vector<uint32_t> samples = audio(MIC_CODEC_MAX_SAMPLES, 1000);
+  micCodec_t codec;
+  micCodecInit(&codec, MIC_CODEC_RICE, 16, SAMPLE_RATE);
+  size_t len = micCodecEncode(&codec, samples.data(), samples.size(), packet, sizeof(packet));
+  int32_t decoded[MIC_CODEC_MAX_SAMPLES];
+
+  // Truncated
+  EXPECT_EQ(micCodecDecode(packet, len - 1, decoded, MIC_CODEC_MAX_SAMPLES), -1);
+  EXPECT_EQ(micCodecDecode(packet, sizeof(micCodecHeader_t) - 1, decoded, MIC_CODEC_MAX_SAMPLES), -1);
+
+  // Not enough room
+  EXPECT_EQ(micCodecDecode(packet, len, decoded, MIC_CODEC_MAX_SAMPLES - 1), -1);
+
+  // Garbage payload must not read past the packet
+  std::mt19937 rng(5);
+  for(size_t idx = sizeof(micCodecHeader_t); idx < len; idx++) {
+    packet[idx] = rng();
+  }
+  packet[sizeof(micCodecHeader_t)] = 2;
+  micCodecDecode(packet, len, decoded, MIC_CODEC_MAX_SAMPLES);
+
+  // Bad magic
+  packet[0] ^= 0xFF;
+  EXPECT_EQ(micCodecDecode(packet, len, decoded, MIC_CODEC_MAX_SAMPLES), -1);
+
+  // Doesn't fit
+  EXPECT_EQ(micCodecEncode(&codec, samples.data(), samples.size(), packet, sizeof(micCodecHeader_t) + 10), 0u);
+}
+
+TEST_F(MicCodecTest, Benchmark)
+{
+  const uint32_t numPackets = 200;
+  std::vector<uint32_t> samples = audio(MIC_CODEC_MAX_SAMPLES, 1000);
+
+  for(micCodec_e type : {MIC_CODEC_RICE, MIC_CODEC_ADPCM}) {
+    micCodec_t codec;
+    micCodecInit(&codec, type, 16, SAMPLE_RATE);
+
+    auto start = std::chrono::steady_clock::now();
+    for(uint32_t idx = 0; idx < numPackets; idx++) {
+      micCodecEncode(&codec, samples.data(), samples.size(), packet, sizeof(packet));
+    }
+    auto packetNs = std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - start).count() / numPackets;
+
+    printf("mic_codec %s: %lld ns/packet (%u samples)\n", (type == MIC_CODEC_RICE) ? "rice" : "adpcm",
+           static_cast<long long>(packetNs), MIC_CODEC_MAX_SAMPLES);
+
+    // Encoding has to be (much) faster than sampling
+    EXPECT_LT(packetNs, 1000000000LL * MIC_CODEC_MAX_SAMPLES / SAMPLE_RATE);
+  }
+}
@@ -0,0 +1,301 @@
+#include "gtest/gtest.h"
+
+#include <chrono>
+#include <cmath>
+#include <random>
+#include <vector>
+
+#include "mic_dsp.h"
+
+#define SAMPLE_RATE (50000)
+
+// Level (dB) of a mean square value, same reference as mic_dsp
+static double levelDb(double meanSquare) {
+  return 10.0 * log10(meanSquare) - 10.0 * log10(pow(2.0, 48));
+}
+
+// 24-bit samples in 32-bit words, the way the SAI delivers them
+static std::vector<uint32_t> tone(const std::vector<std::pair<double, double>> &tones, uint32_t numSamples, double noise = 0, uint32_t seed = 1) {
+  std::vector<uint32_t> samples(numSamples);
+  std::mt19937 rng(seed);
+  std::normal_distribution<double> gaussian(0, 1);
+
+  for(uint32_t idx = 0; idx < numSamples; idx++) {
+    double value = noise * gaussian(rng);
+    for(auto &t : tones) {
+      value += t.second * sin(2.0 * M_PI * t.first * idx / SAMPLE_RATE);
+    }
+    int32_t sample = static_cast<int32_t>(lround(value));
+    sample = std::max(std::min(sample, (1 << 23) - 1), -(1 << 23));
+    samples[idx] = static_cast<uint32_t>(sample) & 0xFFFFFF;
+  }
+
+  return samples;
+}
+
+// The fixture for testing hydrophone feature extraction.
+class MicDspTest : public ::testing::Test {
+ protected:
+  // You can remove any or all of the following functions if its body
+  // is empty.
+
+  MicDspTest() {
+     // You can do set-up work for each test here.
+  }
+
+  ~MicDspTest() override {
+     // You can do clean-up work that doesn't throw exceptions here.
+  }
+
+  // If the constructor and destructor are not enough for setting up
+  // and cleaning up each test, you can define the following methods:
+
+  void SetUp() override {
+     // Code here will be called immediately after the constructor (right
+     // before each test).
+     micDspConfig_t config = {
+       .sampleRate = SAMPLE_RATE,
+       .blocksPerFrame = 4,
+       .peakThresholdDb = 10,
+       .dbOffset = 0,
+     };
+     micDspInit(&config);
+  }
+
+  void TearDown() override {
+     // Code here will be called immediately after each test (right
+     // before the destructor).
+  }
+
+  // Objects declared here can be used by all tests in the test suite.
+};
+
+TEST_F(MicDspTest, FftMatchesReference)
+{
+  std::vector<uint32_t> samples = tone({{1234.5, 3e6}, {7000, 1e5}}, MIC_DSP_FFT_LEN, 1e4);
+
+  // Reference DFT of the same windowed q31 block
+  std::vector<int32_t> block(MIC_DSP_FFT_LEN);
+  int32_t shift = micDspLoadBlock(samples.data(), block.data());
+  std::vector<double> input(block.begin(), block.end());
+
+  micDspRealFft(block.data());
+
+  double maxError = 0;
+  double maxMagnitude = 0;
+  for(uint32_t k = 0; k <= MIC_DSP_FFT_LEN / 2; k++) {
+    double re = 0;
+    double im = 0;
+    for(uint32_t n = 0; n < MIC_DSP_FFT_LEN; n++) {
+      re += input[n] * cos(2.0 * M_PI * k * n / MIC_DSP_FFT_LEN);
+      im -= input[n] * sin(2.0 * M_PI * k * n / MIC_DSP_FFT_LEN);
+    }
+    re /= MIC_DSP_FFT_LEN;
+    im /= MIC_DSP_FFT_LEN;
+
+    double fftRe;
+    double fftIm;
+    if(k == 0) {
+      fftRe = block[0];
+      fftIm = 0;
+    } else if(k == MIC_DSP_FFT_LEN / 2) {
+      fftRe = block[1];
+      fftIm = 0;
+    } else {
+      fftRe = block[2 * k];
+      fftIm = block[2 * k + 1];
+    }
+
+    maxError = std::max(maxError, std::hypot(fftRe - re, fftIm - im));
+    maxMagnitude = std::max(maxMagnitude, std::hypot(re, im));
+  }
+
+  // Loud tone at ~-9dBFS, so it gets normalized
+  EXPECT_EQ(shift, 1);
+  // Scaled fixed point FFT error is a few LSBs per stage
+  EXPECT_LT(maxError, 64);
+  EXPECT_GT(maxMagnitude, 1e8);
+}
+
+TEST_F(MicDspTest, ToneLevelAndFrequency)
+{
+  const double amplitude = 1 << 20;
+  std::vector<uint32_t> samples = tone({{1000, amplitude}}, MIC_DSP_FFT_LEN * 4);
+
+  EXPECT_TRUE(micDspProcess(samples.data(), samples.size()));
+
+  micDspFeatures_t features;
+  ASSERT_TRUE(micDspGetFeatures(&features));
+
+  double expected = levelDb(amplitude * amplitude / 2);
+
+  EXPECT_EQ(features.sampleRate, SAMPLE_RATE);
+  EXPECT_EQ(features.numBlocks, 4);
+  EXPECT_NEAR(features.broadbandLevel / 100.0, expected, 0.1);
+
+  ASSERT_GE(features.numPeaks, 1);
+  EXPECT_NEAR(features.peaks[0].freqHz, 1000, 5);
+  EXPECT_NEAR(features.peaks[0].level / 100.0, expected, 0.5);
+
+  // 1kHz band has the tone, the ones next to it don't
+  uint8_t band = -MIC_DSP_FIRST_BAND;
+  EXPECT_NEAR(micDspCenterHz(band), 1000, 1);
+  EXPECT_NEAR(features.bandLevel[band] / 100.0, expected, 0.5);
+  EXPECT_LT(features.bandLevel[band - 1] / 100.0, expected - 15);
+  EXPECT_LT(features.bandLevel[band + 1] / 100.0, expected - 15);
+}
+
+TEST_F(MicDspTest, QuietToneKeepsResolution)
+{
+  // Only a few bits of signal, block normalization keeps it above the noise
+  const double amplitude = 64;
+  std::vector<uint32_t> samples = tone({{5000, amplitude}}, MIC_DSP_FFT_LEN * 4);
+
+  micDspProcess(samples.data(), samples.size());
+
+  micDspFeatures_t features;
+  ASSERT_TRUE(micDspGetFeatures(&features));
+
+  ASSERT_GE(features.numPeaks, 1);
+  EXPECT_NEAR(features.peaks[0].freqHz, 5000, 10);
+  EXPECT_NEAR(features.peaks[0].level / 100.0, levelDb(amplitude * amplitude / 2), 0.5);
+}
+
+TEST_F(MicDspTest, NoiseMatchesTimeDomain)
+{
+  const uint32_t numBlocks = 16;
+  micDspSetBlocksPerFrame(numBlocks);
+  std::vector<uint32_t> samples = tone({}, MIC_DSP_FFT_LEN * numBlocks, 1e5, 42);
+
+  double meanSquare = 0;
+  for(uint32_t sample : samples) {
+    double value = static_cast<int32_t>(sample << 8) >> 8;
+    meanSquare += value * value;
+  }
+  meanSquare /= samples.size();
+
+  EXPECT_TRUE(micDspProcess(samples.data(), samples.size()));
+
+  micDspFeatures_t features;
+  ASSERT_TRUE(micDspGetFeatures(&features));
+
+  // Window loses a bit at block edges, but white noise averages out
+  EXPECT_NEAR(features.broadbandLevel / 100.0, levelDb(meanSquare), 0.3);
+
+  // White noise, so band power is proportional to bandwidth. Bands are
+  // rounded to whole bins, so only check the ones that are 10+ bins wide
+  EXPECT_EQ(features.numBands, MIC_DSP_NUM_BANDS);
+  for(uint8_t band = 10; band < MIC_DSP_NUM_BANDS; band++) {
+    double bandwidth = micDspCenterHz(band) * (pow(10.0, 0.05) - pow(10.0, -0.05));
+    EXPECT_NEAR(features.bandLevel[band] / 100.0, levelDb(meanSquare * bandwidth / (SAMPLE_RATE / 2)), 1.5);
+  }
+
+  // No tones in noise
+  EXPECT_EQ(features.numPeaks, 0);
+}
+
+TEST_F(MicDspTest, PeaksSortedByLevel)
+{
+  std::vector<uint32_t> samples = tone({{2000, 1e4}, {8000, 1e5}, {15000, 3e4}}, MIC_DSP_FFT_LEN * 4, 100);
+
+  micDspProcess(samples.data(), samples.size());
+
+  micDspFeatures_t features;
+  ASSERT_TRUE(micDspGetFeatures(&features));
+
+  ASSERT_EQ(features.numPeaks, 3);
+  EXPECT_NEAR(features.peaks[0].freqHz, 8000, 10);
+  EXPECT_NEAR(features.peaks[1].freqHz, 15000, 10);
+  EXPECT_NEAR(features.peaks[2].freqHz, 2000, 10);
+  EXPECT_GT(features.peaks[0].level, features.peaks[1].level);
+  EXPECT_GT(features.peaks[1].level, features.peaks[2].level);
+}
+
+TEST_F(MicDspTest, FrameCadence)
+{
+  std::vector<uint32_t> samples = tone({{1000, 1e5}}, MIC_DSP_FFT_LEN * 8);
+  micDspFeatures_t features;
+
+  EXPECT_FALSE(micDspGetFeatures(&features));
+
+  // Odd sized chunks still make whole blocks
+  uint32_t offset = 0;
+  uint32_t frames = 0;
+  while(offset < samples.size()) {
+    uint32_t count = std::min<uint32_t>(300, samples.size() - offset);
+    if(micDspProcess(&samples[offset], count)) {
+      ASSERT_TRUE(micDspGetFeatures(&features));
+      EXPECT_EQ(features.numBlocks, 4);
+      frames++;
+    }
+    offset += count;
+  }
+  EXPECT_EQ(frames, 2);
+
+  micDspSetBlocksPerFrame(0);
+  EXPECT_EQ(micDspGetBlocksPerFrame(), 1u);
+  EXPECT_TRUE(micDspProcess(samples.data(), MIC_DSP_FFT_LEN));
+}
+
+TEST_F(MicDspTest, LowSampleRateBands)
+{
+  micDspConfig_t config = {
+    .sampleRate = 16000,
+    .blocksPerFrame = 1,
+    .peakThresholdDb = 10,
+    .dbOffset = 120,
+  };
+  micDspInit(&config);
+
+  std::vector<uint32_t> samples = tone({{1000, 1e5}}, MIC_DSP_FFT_LEN);
+  micDspProcess(samples.data(), samples.size());
+
+  micDspFeatures_t features;
+  ASSERT_TRUE(micDspGetFeatures(&features));
+
+  // Bands above nyquist have no data
+  EXPECT_LT(features.numBands, MIC_DSP_NUM_BANDS);
+  EXPECT_LE(micDspCenterHz(features.numBands - 1), 8000);
+  for(uint8_t band = features.numBands; band < MIC_DSP_NUM_BANDS; band++) {
+    EXPECT_EQ(features.bandLevel[band], MIC_DSP_NO_LEVEL);
+  }
+
+  // Offset applies to all levels
+  EXPECT_NEAR(features.broadbandLevel / 100.0, 120 + levelDb(1e10 / 2), 0.1);
+}
+
+TEST_F(MicDspTest, Benchmark)
+{
+  const uint32_t numBlocks = 500;
+  std::vector<uint32_t> samples = tone({{1000, 1e5}, {9000, 1e4}}, MIC_DSP_FFT_LEN, 1e3);
+  std::vector<int32_t> block(MIC_DSP_FFT_LEN);
+  std::vector<float> psd(MIC_DSP_NUM_BINS);
+
+  auto start = std::chrono::steady_clock::now();
+  for(uint32_t idx = 0; idx < numBlocks; idx++) {
+    int32_t shift = micDspLoadBlock(samples.data(), block.data());
+    micDspRealFft(block.data());
+    micDspAccumulatePower(block.data(), shift, psd.data());
+  }
+  auto blockNs = std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - start).count() / numBlocks;
+
+  micDspPeak_t peaks[MIC_DSP_MAX_PEAKS];
+  start = std::chrono::steady_clock::now();
+  for(uint32_t idx = 0; idx < numBlocks; idx++) {
+    for(uint8_t band = 0; band < MIC_DSP_NUM_BANDS; band++) {
+      micDspBandPower(psd.data(), band);
+    }
+    micDspFindPeaks(psd.data(), 10, peaks, MIC_DSP_MAX_PEAKS);
+  }
+  auto frameNs = std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - start).count() / numBlocks;
+
+  // Host numbers are only useful relative to each other. On target, see
+  // the hydrophone.dsp_cycles performance counter.
+  printf("mic_dsp: %lld ns/block (%u samples), %lld ns/frame features\n",
+         static_cast<long long>(blockNs), MIC_DSP_FFT_LEN, static_cast<long long>(frameNs));
+  RecordProperty("ns_per_block", static_cast<int>(blockNs));
+  RecordProperty("ns_per_frame", static_cast<int>(frameNs));
+
+  // One block must take (much) less time than it takes to record it
+  EXPECT_LT(blockNs, 1000000000LL * MIC_DSP_FFT_LEN / SAMPLE_RATE);
+}
@@ -0,0 +1,206 @@
+#include "gtest/gtest.h"
+
+#include <chrono>
+#include <cmath>
+#include <random>
+#include <vector>
+
+#include "mic_kernels.h"
+
+#define AOP_DB (120)
+
+// 24-bit samples in 32-bit words, the way the SAI delivers them
+static std::vector<uint32_t> noise(uint32_t numSamples, double amplitude, uint32_t seed = 1) {
+  std::vector<uint32_t> samples(numSamples);
+  std::mt19937 rng(seed);
+  std::normal_distribution<double> gaussian(0, 1);
+
+  for(uint32_t idx = 0; idx < numSamples; idx++) {
+    int32_t sample = static_cast<int32_t>(lround(amplitude * gaussian(rng)));
+    sample = std::max(std::min(sample, (1 << 23) - 1), -(1 << 23));
+    samples[idx] = static_cast<uint32_t>(sample) & 0xFFFFFF;
+  }
+
+  return samples;
+}
+
+// Previous (scalar, float) micGetDB implementation
+static float referenceDb(const uint32_t *samples, uint32_t numSamples) {
+  float accumulator = 0;
+
+  for (uint32_t index=0; index < numSamples; index++) {
+    float sample = ((int32_t)samples[index] << 8) >> 8;
+    accumulator += sample * sample;
+  }
+
+  accumulator = sqrtf(accumulator/numSamples);
+  return AOP_DB + 20.0 * log10f(accumulator/(1<<24));
+}
+
+// Previous int16 stream conversion loop
+static void referenceInt16(const uint32_t *samples, uint32_t numSamples, int16_t *out) {
+  for(uint32_t idx = 0; idx < numSamples; idx++) {
+    out[idx] = (int16_t)(samples[idx] >> 8);
+  }
+}
+
+// The fixture for testing hydrophone sample kernels.
+class MicKernelsTest : public ::testing::Test {
+ protected:
+  // You can remove any or all of the following functions if its body
+  // is empty.
+
+  MicKernelsTest() {
+     // You can do set-up work for each test here.
+  }
+
+  ~MicKernelsTest() override {
+     // You can do clean-up work that doesn't throw exceptions here.
+  }
+
+  // If the constructor and destructor are not enough for setting up
+  // and cleaning up each test, you can define the following methods:
+
+  void SetUp() override {
+     // Code here will be called immediately after the constructor (right
+     // before each test).
+     micKernelStatsInit(&stats);
+  }
+
+  void TearDown() override {
+     // Code here will be called immediately after each test (right
+     // before the destructor).
+  }
+
+  // Objects declared here can be used by all tests in the test suite for Foo.
+  micKernelStats_t stats;
+};
+
+TEST_F(MicKernelsTest, MatchesReference)
+{
+  // Odd length to exercise the tail of the paired loop
+  std::vector<uint32_t> samples = noise(1023, 100000);
+  std::vector<int16_t> out(samples.size());
+  std::vector<int16_t> expected(samples.size());
+
+  micKernelProcess(samples.data(), samples.size(), out.data(), &stats);
+  referenceInt16(samples.data(), samples.size(), expected.data());
+  EXPECT_EQ(out, expected);
+
+  uint64_t sumSquares = 0;
+  int32_t min = INT32_MAX;
+  int32_t max = INT32_MIN;
+  for(uint32_t sample : samples) {
+    int32_t value = static_cast<int32_t>(sample << 8) >> 8;
+    sumSquares += static_cast<uint64_t>(static_cast<int64_t>(value) * value);
+    min = std::min(min, value);
+    max = std::max(max, value);
+  }
+  EXPECT_EQ(stats.sumSquares, sumSquares);
+  EXPECT_EQ(stats.min, min);
+  EXPECT_EQ(stats.max, max);
+  EXPECT_EQ(stats.numSamples, samples.size());
+  EXPECT_EQ(micKernelPeak(&stats), static_cast<uint32_t>(std::max(-min, max)));
+
+  // Float accumulation in the old implementation isn't exact
+  EXPECT_NEAR(micKernelDb(&stats, AOP_DB), referenceDb(samples.data(), samples.size()), 0.01);
+}
+
+TEST_F(MicKernelsTest, SignExtendedInput)
+{
+  // Upper byte might be sign extended or zero, results must be the same
+  std::vector<uint32_t> samples = noise(256, 1000000, 2);
+  std::vector<uint32_t> extended(samples.size());
+  for(uint32_t idx = 0; idx < samples.size(); idx++) {
+    extended[idx] = static_cast<uint32_t>(static_cast<int32_t>(samples[idx] << 8) >> 8);
+  }
+
+  std::vector<int16_t> out(samples.size());
+  std::vector<int16_t> outExtended(samples.size());
+  micKernelStats_t statsExtended;
+  micKernelStatsInit(&statsExtended);
+
+  micKernelProcess(samples.data(), samples.size(), out.data(), &stats);
+  micKernelProcess(extended.data(), extended.size(), outExtended.data(), &statsExtended);
+
+  EXPECT_EQ(out, outExtended);
+  EXPECT_EQ(stats.sumSquares, statsExtended.sumSquares);
+  EXPECT_EQ(stats.min, statsExtended.min);
+  EXPECT_EQ(stats.max, statsExtended.max);
+}
+
+TEST_F(MicKernelsTest, Accumulates)
+{
+  std::vector<uint32_t> samples = noise(1000, 5000, 3);
+  micKernelStats_t whole;
+  micKernelStatsInit(&whole);
+
+  micKernelProcess(samples.data(), samples.size(), NULL, &whole);
+
+  // Odd split so the second call starts unaligned
+  micKernelProcess(samples.data(), 333, NULL, &stats);
+  micKernelProcess(&samples[333], samples.size() - 333, NULL, &stats);
+
+  EXPECT_EQ(stats.sumSquares, whole.sumSquares);
+  EXPECT_EQ(stats.min, whole.min);
+  EXPECT_EQ(stats.max, whole.max);
+  EXPECT_EQ(stats.numSamples, whole.numSamples);
+  EXPECT_FLOAT_EQ(micKernelRms(&stats), micKernelRms(&whole));
+}
+
+TEST_F(MicKernelsTest, FullScale)
+{
+  std::vector<uint32_t> samples = {0x800000, 0x7FFFFF, 0, 0xFFFFFF};
+  std::vector<int16_t> out(samples.size());
+
+  micKernelProcess(samples.data(), samples.size(), out.data(), &stats);
+
+  EXPECT_EQ(out[0], INT16_MIN);
+  EXPECT_EQ(out[1], INT16_MAX);
+  EXPECT_EQ(out[2], 0);
+  EXPECT_EQ(out[3], -1);
+  EXPECT_EQ(stats.min, -(1 << 23));
+  EXPECT_EQ(stats.max, (1 << 23) - 1);
+  EXPECT_EQ(micKernelPeak(&stats), static_cast<uint32_t>(MIC_KERNEL_FULL_SCALE));
+}
+
+TEST_F(MicKernelsTest, Empty)
+{
+  micKernelProcess(NULL, 0, NULL, &stats);
+
+  EXPECT_EQ(stats.numSamples, 0u);
+  EXPECT_EQ(micKernelPeak(&stats), 0u);
+  EXPECT_EQ(micKernelRms(&stats), 0);
+}
+
+TEST_F(MicKernelsTest, Benchmark)
+{
+  // One SAI DMA half buffer
+  const uint32_t numSamples = 1024;
+  const uint32_t iterations = 2000;
+  std::vector<uint32_t> samples = noise(numSamples, 100000, 4);
+  std::vector<int16_t> out(numSamples);
+  volatile float sink = 0;
+
+  auto start = std::chrono::steady_clock::now();
+  for(uint32_t idx = 0; idx < iterations; idx++) {
+    sink = sink + referenceDb(samples.data(), numSamples);
+    referenceInt16(samples.data(), numSamples, out.data());
+  }
+  auto referenceNs = std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - start).count() / iterations;
+
+  start = std::chrono::steady_clock::now();
+  for(uint32_t idx = 0; idx < iterations; idx++) {
+    micKernelStatsInit(&stats);
+    micKernelProcess(samples.data(), numSamples, out.data(), &stats);
+    sink = sink + micKernelDb(&stats, AOP_DB);
+  }
+  auto fusedNs = std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - start).count() / iterations;
+
+  printf("mic_kernels: reference %lld ns/buffer, fused %lld ns/buffer (%u samples)\n",
+         static_cast<long long>(referenceNs), static_cast<long long>(fusedNs), numSamples);
+
+  // Don't compare timings (too noisy on shared hosts), just make sure
+  // it's nowhere near the 20ms it takes to fill a buffer at 50kHz
+  EXPECT_LT(fusedNs, 1000000LL);
+}
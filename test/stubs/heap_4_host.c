@@ -0,0 +1,27 @@
+// The real FreeRTOS heap_4 allocator, for host tests that measure heap
+// behaviour (fragmentation). header_overrides maps pvPortMalloc/vPortFree to
+// malloc/free, so undo that here. Tests call these through their own
+// declarations after undefining the same macros.
+#include <stdint.h>
+
+// The default (uint32_t) truncates host pointers
+#define portPOINTER_SIZE_TYPE uintptr_t
+
+#include "FreeRTOS.h"
+#include "task.h"
+
+#undef pvPortMalloc
+#undef vPortFree
+
+void *pvPortMalloc(size_t xWantedSize);
+void vPortFree(void *pv);
+
+// Single threaded on the host, nothing to suspend
+void vTaskSuspendAll(void) {
+}
+
+BaseType_t xTaskResumeAll(void) {
+  return pdFALSE;
+}
+
+#include "portable/MemMang/heap_4.c"
@@ -14,3 +14,4 @@ DEFINE_FAKE_VALUE_FUNC(BaseType_t, xTimerGenericCommand, TimerHandle_t , const B
 DEFINE_FAKE_VALUE_FUNC(EventGroupHandle_t, xEventGroupCreate);
 DEFINE_FAKE_VALUE_FUNC(BaseType_t, xTaskGenericNotify, TaskHandle_t,UBaseType_t, uint32_t, eNotifyAction , uint32_t * );
 DEFINE_FAKE_VALUE_FUNC(BaseType_t, xTaskGenericNotifyWait, UBaseType_t ,uint32_t ,uint32_t , uint32_t * , TickType_t  );
+DEFINE_FAKE_VOID_FUNC(vPortGetHeapStats, HeapStats_t *);
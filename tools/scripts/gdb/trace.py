@@ -14,7 +14,7 @@ eventStruct = namedtuple("event", "timestamp eventType arg")
 class Trace(gdb.Command):
     """Prints the captured trace
     Usage: in gdb `source /path/to/trace.py`
-    `trace` or `trace verbose`
+    `trace`, `trace --verbose` or `trace --dump events.txt` (see pkt_trace.py)
     """
 
     def _loadTaskInfo(self, tcbAddr):
@@ -205,6 +205,18 @@ class Trace(gdb.Command):
             "{:>10} {} {:>3} {:02X} {}".format(handle, direction, isr, byte, byte_str)
         )
 
+    def _processPacket(self, event, verbose=False):
+        # Packet path events are meant for tools/scripts/misc/pkt_trace.py,
+        # so only print them when verbose
+        if verbose:
+            self._print(
+                "{:010d}: {} [id {:08X}]".format(
+                    event["timestamp"],
+                    event["eventType"].replace("kTraceEventPkt", ""),
+                    event["arg"],
+                )
+            )
+
     def _processEvent(self, event, verbose=False):
         evt = {
             "eventType": str(event["eventType"]),
@@ -240,6 +252,11 @@ class Trace(gdb.Command):
         self.eventDecoders["kTraceEventSDWriteErr"] = self._processSDWriteErr
         self.eventDecoders["kTraceEventSerialByte"] = self._processSerialByte
 
+    def _registerPacketDecoders(self):
+        for eventType in self.traceEventTypes.values():
+            if eventType.startswith("kTraceEventPkt"):
+                self.eventDecoders[eventType] = self._processPacket
+
     def _getEventFromBuff(self, buff, idx):
         eventDict = eventStruct._asdict(
             eventStruct._make(
@@ -313,6 +330,17 @@ class Trace(gdb.Command):
         # traceEventsBuff = gdb.inferiors()[0].read_memory(int(traceEvents.address),64).tobytes()
         print("Done reading buffer")
 
+        if self.dump:
+            # Raw events for offline decoding (see tools/scripts/misc/pkt_trace.py)
+            self.dump.write("# clock_hz {}\n".format(int(traceClockHz)))
+            for idx in indices:
+                event = self._getEventFromBuff(traceEventsBuff, idx)
+                self.dump.write(
+                    "{} {} {:#x}\n".format(
+                        event["timestamp"], event["eventType"], event["arg"]
+                    )
+                )
+
         for idx in indices:
             # This is the old "slow" way of processing events, lots of GDB transactions
             # but is agnostic to struct formatting
@@ -347,15 +375,22 @@ class Trace(gdb.Command):
 
         # Swap key/values since make_enum_dict returns "enumStr":val
         self.traceEventTypes = dict((v, k) for k, v in eventTypes.items())
+        self._registerPacketDecoders()
 
         # Use argparse so we can call `trace --verbose` or
         # `trace --filename somefile.txt` within GDB
         parser = argparse.ArgumentParser()
         parser.add_argument("--verbose", action="store_true")
         parser.add_argument("--filename", help="save trace to file")
+        parser.add_argument("--dump", help="save raw events to file (for pkt_trace.py)")
         args = parser.parse_args(shlex.split(args))
 
         self.file = None
+        self.dump = None
+
+        if args.dump:
+            self.dump = open(args.dump, "w")
+            print(f"Writing raw events to {args.dump}")
 
         if args.filename:
             self.file = open(args.filename, "w")
@@ -367,6 +402,10 @@ class Trace(gdb.Command):
             self.file.close()
             print(f"{args.filename} closed")
 
+        if self.dump:
+            self.dump.close()
+            print(f"{args.dump} closed")
+
 
 # Do the thing!
 Trace()
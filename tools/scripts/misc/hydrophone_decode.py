@@ -0,0 +1,278 @@
+"""
+Hydrophone audio stream decoder
+
+Decodes compressed hydrophone audio packets (see src/lib/drivers/mic_codec.h)
+into a WAV file. Packets come from the listener's second USB serial port
+(hydrophone_demo streams every hydrophone/stream packet it receives there)
+or from a file previously captured from it.
+
+Lost packets are replaced with silence so the WAV file keeps its timing.
+
+Example:
+    python3 tools/scripts/misc/hydrophone_decode.py /dev/tty.usbmodem1234 audio.wav
+    python3 tools/scripts/misc/hydrophone_decode.py capture.bin audio.wav --file
+"""
+import argparse
+import os
+import struct
+import sys
+import wave
+
+MAGIC = 0xAD10C0DE
+MAGIC_BYTES = struct.pack("<L", MAGIC)
+
+# magic sampleRate sequence sampleOffset numSamples payloadLen codec sampleBits reserved
+HEADER_STRUCT = "<LLLLHHBBH"
+HEADER_LEN = struct.calcsize(HEADER_STRUCT)
+
+CODEC_RAW = 0
+CODEC_RICE = 1
+CODEC_ADPCM = 2
+
+MAX_SAMPLES = 512
+MAX_ORDER = 4
+PARTITION_LEN = 64
+RICE_PARAM_BITS = 5
+RICE_ESCAPE = 24
+RICE_ESCAPE_BITS = 30
+
+ADPCM_INDEX_TABLE = [-1, -1, -1, -1, 2, 4, 6, 8] * 2
+# fmt: off
+ADPCM_STEP_TABLE = [
+    7, 8, 9, 10, 11, 12, 13, 14, 16, 17, 19, 21, 23, 25, 28, 31, 34, 37, 41, 45,
+    50, 55, 60, 66, 73, 80, 88, 97, 107, 118, 130, 143, 157, 173, 190, 209, 230,
+    253, 279, 307, 337, 371, 408, 449, 494, 544, 598, 658, 724, 796, 876, 963,
+    1060, 1166, 1282, 1411, 1552, 1707, 1878, 2066, 2272, 2499, 2749, 3024, 3327,
+    3660, 4026, 4428, 4871, 5358, 5894, 6484, 7132, 7845, 8630, 9493, 10442,
+    11487, 12635, 13899, 15289, 16818, 18500, 20350, 22385, 24623, 27086, 29794,
+    32767,
+]
+# fmt: on
+
+
+class BitReader:
+    def __init__(self, data):
+        self.value = int.from_bytes(data, "big")
+        self.remaining = len(data) * 8
+
+    def read(self, num_bits):
+        if num_bits > self.remaining:
+            raise ValueError("Truncated payload")
+        self.remaining -= num_bits
+        return (self.value >> self.remaining) & ((1 << num_bits) - 1)
+
+
+def sign_extend(value, num_bits):
+    return value - (1 << num_bits) if value & (1 << (num_bits - 1)) else value
+
+
+def decode_rice(reader, num_samples, sample_bits):
+    order = reader.read(8)
+    if order > MAX_ORDER:
+        raise ValueError("Invalid predictor order %u" % order)
+
+    samples = [sign_extend(reader.read(sample_bits), sample_bits) for _ in range(min(order, num_samples))]
+
+    for start in range(0, num_samples, PARTITION_LEN):
+        first = max(start, order)
+        end = min(start + PARTITION_LEN, num_samples)
+        if first >= end:
+            continue
+
+        param = reader.read(RICE_PARAM_BITS)
+        for idx in range(first, end):
+            quotient = 0
+            while quotient < RICE_ESCAPE and not reader.read(1):
+                quotient += 1
+            if quotient == RICE_ESCAPE:
+                value = reader.read(RICE_ESCAPE_BITS)
+            else:
+                value = (quotient << param) | reader.read(param)
+
+            residual = (value >> 1) ^ -(value & 1)
+            if order == 0:
+                sample = residual
+            elif order == 1:
+                sample = residual + samples[idx - 1]
+            elif order == 2:
+                sample = residual + 2 * samples[idx - 1] - samples[idx - 2]
+            elif order == 3:
+                sample = residual + 3 * samples[idx - 1] - 3 * samples[idx - 2] + samples[idx - 3]
+            else:
+                sample = (
+                    residual + 4 * samples[idx - 1] - 6 * samples[idx - 2] + 4 * samples[idx - 3] - samples[idx - 4]
+                )
+            samples.append(sample)
+
+    return samples
+
+
+def decode_adpcm(payload, num_samples):
+    predictor, step_index = struct.unpack_from("<hB", payload)
+    data = payload[4:]
+    if step_index > 88 or len(data) < (num_samples + 1) // 2:
+        raise ValueError("Invalid ADPCM payload")
+
+    samples = []
+    for idx in range(num_samples):
+        nibble = data[idx // 2] >> 4 if idx & 1 else data[idx // 2] & 0xF
+        step = ADPCM_STEP_TABLE[step_index]
+        delta = step >> 3
+        if nibble & 4:
+            delta += step
+        if nibble & 2:
+            delta += step >> 1
+        if nibble & 1:
+            delta += step >> 2
+        predictor = predictor - delta if nibble & 8 else predictor + delta
+        predictor = max(min(predictor, 32767), -32768)
+        step_index = max(min(step_index + ADPCM_INDEX_TABLE[nibble], 88), 0)
+        samples.append(predictor)
+
+    return samples
+
+
+def decode_packet(header, payload):
+    """Return list of samples (sign extended, header sample_bits wide)"""
+    _, _, _, _, num_samples, _, codec, sample_bits, _ = header
+    if codec == CODEC_RAW:
+        reader = BitReader(payload)
+        return [sign_extend(reader.read(sample_bits), sample_bits) for _ in range(num_samples)]
+    elif codec == CODEC_RICE:
+        return decode_rice(BitReader(payload), num_samples, sample_bits)
+    elif codec == CODEC_ADPCM:
+        return decode_adpcm(payload, num_samples)
+    else:
+        raise ValueError("Unknown codec %u" % codec)
+
+
+def read_packets(stream):
+    """Yield (header, payload) for every packet in the stream, resyncing on magic"""
+    buff = b""
+    while True:
+        if hasattr(stream, "in_waiting"):
+            # Serial port, don't wait for a full buffer
+            chunk = stream.read(max(1, stream.in_waiting))
+        else:
+            chunk = stream.read(4096)
+        if not chunk:
+            return
+        buff += chunk
+
+        while True:
+            start = buff.find(MAGIC_BYTES)
+            if start < 0:
+                buff = buff[-3:]
+                break
+            if len(buff) - start < HEADER_LEN:
+                buff = buff[start:]
+                break
+
+            header = struct.unpack_from(HEADER_STRUCT, buff, start)
+            payload_len = header[5]
+            if header[4] > MAX_SAMPLES or not 0 < header[7] <= 24:
+                # False magic match
+                buff = buff[start + 1 :]
+                continue
+            if len(buff) - start < HEADER_LEN + payload_len:
+                buff = buff[start:]
+                break
+
+            yield header, buff[start + HEADER_LEN : start + HEADER_LEN + payload_len]
+            buff = buff[start + HEADER_LEN + payload_len :]
+
+
+class WavWriter:
+    def __init__(self, filename):
+        self.filename = filename
+        self.wav = None
+        self.sample_bits = None
+        self.next_offset = None
+        self.packets = 0
+        self.lost = 0
+        self.bytes_in = 0
+        self.samples_out = 0
+
+    def write(self, header, samples):
+        _, sample_rate, _, sample_offset, _, payload_len, _, sample_bits, _ = header
+
+        if self.wav is None:
+            # WAV files only do whole bytes
+            self.sample_bits = 24 if sample_bits > 16 else 16
+            self.wav = wave.open(self.filename, "wb")
+            self.wav.setnchannels(1)
+            self.wav.setsampwidth(self.sample_bits // 8)
+            self.wav.setframerate(sample_rate)
+            self.next_offset = sample_offset
+
+        gap = (sample_offset - self.next_offset) & 0xFFFFFFFF
+        if 0 < gap < sample_rate * 10:
+            # Lost packets (assume garbage if it's more than a few seconds)
+            self.lost += gap
+            self._write_frames([0] * gap)
+
+        # Sample width can change if the codec is changed mid stream
+        shift = self.sample_bits - sample_bits
+        if shift >= 0:
+            self._write_frames([sample << shift for sample in samples])
+        else:
+            self._write_frames([sample >> -shift for sample in samples])
+        self.next_offset = (sample_offset + len(samples)) & 0xFFFFFFFF
+        self.packets += 1
+        self.bytes_in += HEADER_LEN + payload_len
+
+    def _write_frames(self, samples):
+        width = self.sample_bits // 8
+        self.wav.writeframes(b"".join(sample.to_bytes(width, "little", signed=True) for sample in samples))
+        self.samples_out += len(samples)
+
+    def close(self):
+        if self.wav:
+            self.wav.close()
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__, formatter_class=argparse.RawDescriptionHelpFormatter)
+    parser.add_argument("source", help="Serial port (or capture file with --file)")
+    parser.add_argument("wav", help="Output WAV file")
+    parser.add_argument("--file", action="store_true", help="Read packets from a file instead of a serial port")
+    args = parser.parse_args()
+
+    if args.file:
+        stream = open(args.source, "rb")
+    else:
+        import serial
+
+        stream = serial.Serial(args.source)
+
+    writer = WavWriter(args.wav)
+    try:
+        for header, payload in read_packets(stream):
+            try:
+                samples = decode_packet(header, payload)
+            except ValueError as err:
+                print("Dropping packet %u: %s" % (header[2], err))
+                continue
+            writer.write(header, samples)
+    except KeyboardInterrupt:
+        pass
+    finally:
+        writer.close()
+        stream.close()
+
+    if writer.packets:
+        raw_bytes = writer.samples_out * 2
+        print(
+            "%u packets, %u samples (%u lost), %u bytes on the wire (%.2fx vs int16)"
+            % (writer.packets, writer.samples_out, writer.lost, writer.bytes_in, raw_bytes / max(writer.bytes_in, 1))
+        )
+        print("Wrote %s" % os.path.abspath(args.wav))
+    else:
+        print("No packets found")
+        return 1
+
+    return 0
+
+
+if __name__ == "__main__":
+    sys.exit(main())
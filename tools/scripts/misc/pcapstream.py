@@ -7,7 +7,9 @@ path with the --wireshark_path argument.
 
 Use --wireshark to open a wireshark window and stream the packets
 
-Use --filename to save to a .pcap file for later analysis
+Use --filename to save to a .pcapng file for later analysis
+
+Capture filters and snaplen are set on the device with the `pcap` command.
 """
 from collections import namedtuple
 import argparse
@@ -20,28 +22,68 @@ import sys
 import tempfile
 import time
 
-# Pcap header definition
-PCAP_HDR = namedtuple(
-    "PCAP_HDR",
-    "magic_number version_major version_minor thiszone sigfigs snaplen network",
-)
-PCAP_STRUCT = "<LHHlLLL"
-
-# Pcap record header
-RECORD_HDR = namedtuple("RECORD_HDR", "ts_sec ts_usec incl_len orig_len")
-RECORD_STRUCT = "<LLLL"
-
-# Default packet header as suggested in
-# https://wiki.wireshark.org/Development/LibpcapFileFormat
-header = PCAP_HDR(
-    magic_number=0xA1B2C3D4,
-    version_major=2,
-    version_minor=4,
-    thiszone=0,
-    sigfigs=0,
-    snaplen=65535,
-    network=1,
-)
+# Device streams pcapng (https://www.ietf.org/archive/id/draft-tuexen-opsawg-pcapng-05.html)
+# Every block starts with its type and total length
+BLOCK_HDR = namedtuple("BLOCK_HDR", "type length")
+BLOCK_STRUCT = "<LL"
+
+SHB_TYPE = 0x0A0D0D0A
+IDB_TYPE = 0x00000001
+ISB_TYPE = 0x00000005
+EPB_TYPE = 0x00000006
+
+# Enhanced packet block (after block header)
+EPB = namedtuple("EPB", "interface ts_high ts_low captured_len original_len")
+EPB_STRUCT = "<LLLLL"
+
+EPB_FLAGS_OPT = 2
+EPB_DIRECTIONS = {1: "rx", 2: "tx"}
+
+# Interface statistics block options
+ISB_OPTIONS = {4: "received", 5: "usb_dropped", 6: "accepted", 7: "dropped"}
+
+
+def parse_options(options):
+    """Return dict of option code -> value bytes"""
+    values = {}
+    offset = 0
+    while offset + 4 <= len(options):
+        code, length = struct.unpack_from("<HH", options, offset)
+        if code == 0:
+            break
+        values[code] = options[offset + 4 : offset + 4 + length]
+        offset += 4 + ((length + 3) & ~3)
+    return values
+
+
+def block_summary(block_type, body):
+    """Human readable summary of a pcapng block"""
+    if block_type == SHB_TYPE:
+        return "Section header (capture started)"
+    elif block_type == IDB_TYPE:
+        link_type, _, snaplen = struct.unpack_from("<HHL", body)
+        return "Interface link_type: %u snaplen: %u" % (link_type, snaplen)
+    elif block_type == EPB_TYPE:
+        epb = EPB._make(struct.unpack_from(EPB_STRUCT, body))
+        options = parse_options(body[20 + ((epb.captured_len + 3) & ~3) :])
+        flags = struct.unpack("<L", options[EPB_FLAGS_OPT])[0] if EPB_FLAGS_OPT in options else 0
+        timestamp_us = (epb.ts_high << 32) | epb.ts_low
+        return "%12.6f %s %u/%u bytes" % (
+            timestamp_us / 1e6,
+            EPB_DIRECTIONS.get(flags & 3, "??"),
+            epb.captured_len,
+            epb.original_len,
+        )
+    elif block_type == ISB_TYPE:
+        options = parse_options(body[12:])
+        stats = [
+            "%s: %u" % (name, struct.unpack("<Q", options[code])[0])
+            for code, name in ISB_OPTIONS.items()
+            if code in options
+        ]
+        return "Stats " + " ".join(stats)
+    else:
+        return "Unknown block 0x%08X" % block_type
 
 
 #
@@ -60,19 +102,17 @@ def write(data, pcap, pcap_pipe):
 # Capture pcap data from USB serial interface
 #
 def capture_packets(pcap, pcap_pipe):
-    header = ser.read(24)
-    print(PCAP_HDR._make(struct.unpack(PCAP_STRUCT, header)))
-    # TODO - check header
-
-    write(header, pcap, pcap_pipe)
-
     while True:
-        header = ser.read(16)
-        record = RECORD_HDR._make(struct.unpack(RECORD_STRUCT, header))
-        print(record)
-        data = ser.read(record.incl_len)
-        write(header, pcap, pcap_pipe)
-        write(data, pcap, pcap_pipe)
+        header = ser.read(8)
+        block = BLOCK_HDR._make(struct.unpack(BLOCK_STRUCT, header))
+        if block.length < 12 or block.length & 3:
+            # TODO - resync on section header
+            print("Invalid block", block)
+            continue
+
+        body = ser.read(block.length - 8)
+        print(block_summary(block.type, body))
+        write(header + body, pcap, pcap_pipe)
 
 
 def handler(signum, frame):
@@ -95,7 +135,7 @@ parser.add_argument(
     default="/Applications/Wireshark.app/Contents/MacOS/Wireshark",
     help="Stream capture to wireshark",
 )
-parser.add_argument("--filename", help="Save stream to pcap file")
+parser.add_argument("--filename", help="Save stream to pcapng file")
 args, unknownargs = parser.parse_known_args()
 
 pipe_path = None
@@ -0,0 +1,251 @@
+"""
+Packet path trace decoder
+
+Decodes packet trace events (firmware built with TRACE_ENABLE, TRACE_PACKETS
+and TRACE_USE_COREDEBUG, see src/lib/common/trace.h) dumped from gdb with
+`trace --dump events.txt` (tools/scripts/gdb/trace.py).
+
+Events are grouped into flows (one per packet) using the packet id each
+trace point records. The id is the buffer pointer at each layer, so the
+decoder links the ADIN rx buffer to the L2 pbuf (and the L2 pbuf to the
+ADIN tx buffer) using the event that immediately precedes it in the same
+thread.
+
+Prints per-hop latency histograms (which queue hop dominates end to end
+latency) and optionally writes a Chrome trace / Perfetto timeline that
+can be opened in chrome://tracing or https://ui.perfetto.dev
+
+Example:
+    python3 tools/scripts/misc/pkt_trace.py events.txt --chrome trace.json
+"""
+import argparse
+import json
+import sys
+from collections import OrderedDict
+
+EVENT_PREFIX = "kTraceEventPkt"
+
+# Events that always begin a new flow
+START_EVENTS = ("AdinRxDone", "MwTx")
+
+# event -> event it follows in the same thread, where the packet id changes
+LINKS = {
+    "L2Rx": "AdinRxDequeue",
+    "AdinTxEnqueue": "L2TxDequeue",
+}
+
+# Events on the transmit side. A forwarded packet has the same id on both sides.
+TX_EVENTS = ("MwTx", "L2Tx", "L2TxDequeue", "AdinTxEnqueue", "AdinTxSubmit", "AdinTxDone")
+
+# Histogram bucket upper bounds in microseconds
+BUCKETS_US = [1, 2, 5, 10, 20, 50, 100, 200, 500, 1000, 2000, 5000, 10000, 20000, 50000]
+
+
+class Flow:
+    def __init__(self, idx):
+        self.idx = idx
+        self.events = []
+
+    def add(self, time_us, name, pkt_id):
+        self.events.append((time_us, name, pkt_id))
+
+    @property
+    def last_us(self):
+        return self.events[-1][0]
+
+
+def parse_events(lines, clock_hz):
+    """Parse dump lines into (time_us, name, packet_id), unwrapping 32-bit timestamps"""
+    events = []
+    last_raw = None
+    offset = 0
+    for line in lines:
+        line = line.strip()
+        if not line:
+            continue
+        if line.startswith("#"):
+            fields = line[1:].split()
+            if len(fields) == 2 and fields[0] == "clock_hz" and not clock_hz:
+                clock_hz = int(fields[1])
+            continue
+
+        timestamp, event_type, arg = line.split()
+        if not event_type.startswith(EVENT_PREFIX):
+            continue
+
+        raw = int(timestamp, 0)
+        if last_raw is not None and raw < last_raw:
+            offset += 1 << 32
+        last_raw = raw
+        events.append((raw + offset, event_type[len(EVENT_PREFIX) :], int(arg, 0)))
+
+    if not clock_hz:
+        raise ValueError("Unknown trace clock, use --clock-hz")
+
+    return [(ticks * 1e6 / clock_hz, name, pkt_id) for ticks, name, pkt_id in events]
+
+
+def build_flows(events, timeout_us):
+    """Group events into per-packet flows"""
+    flows = []
+    # (packet id, branch) -> flow
+    active = {}
+    last_by_name = {}
+
+    def new_flow():
+        flow = Flow(len(flows))
+        flows.append(flow)
+        return flow
+
+    for time_us, name, pkt_id in events:
+        branch = "tx" if name in TX_EVENTS else "rx"
+        flow = None
+
+        if name in LINKS:
+            flow = last_by_name.get(LINKS[name])
+
+        if flow is None and name not in START_EVENTS:
+            flow = active.get((pkt_id, branch))
+            # Buffers get reused, so don't attach to stale flows
+            if flow is not None and time_us - flow.last_us > timeout_us:
+                flow = None
+
+            # Multicast frames are forwarded by L2 while also going up the
+            # stack, so forwarding gets its own flow starting at L2 dequeue
+            rx_flow = active.get((pkt_id, "rx"))
+            if flow is None and name == "L2Tx" and rx_flow and time_us - rx_flow.last_us <= timeout_us:
+                for event in rx_flow.events:
+                    if event[1] == "L2RxDequeue":
+                        flow = new_flow()
+                        flow.add(*event)
+
+        if flow is None:
+            flow = new_flow()
+
+        flow.add(time_us, name, pkt_id)
+        active[(pkt_id, branch)] = flow
+        last_by_name[name] = flow
+
+        # A link only applies to the events right after it (adin tx is
+        # enqueued once per port)
+        for link_from in LINKS.values():
+            if link_from not in (name, LINKS.get(name)):
+                last_by_name.pop(link_from, None)
+
+    return flows
+
+
+def percentile(sorted_values, pct):
+    idx = min(len(sorted_values) - 1, int(round(pct / 100.0 * (len(sorted_values) - 1))))
+    return sorted_values[idx]
+
+
+def hop_latencies(flows):
+    """Return OrderedDict of "from->to" -> list of latencies (us)"""
+    hops = OrderedDict()
+    for flow in flows:
+        for (t0, name0, _), (t1, name1, _) in zip(flow.events, flow.events[1:]):
+            hops.setdefault("%s->%s" % (name0, name1), []).append(t1 - t0)
+        if len(flow.events) > 1:
+            key = "total %s->%s" % (flow.events[0][1], flow.events[-1][1])
+            hops.setdefault(key, []).append(flow.events[-1][0] - flow.events[0][0])
+    return hops
+
+
+def print_histograms(hops, show_buckets):
+    print(
+        "%-40s %7s %9s %9s %9s %9s %9s %7s"
+        % ("hop", "count", "min_us", "p50_us", "p90_us", "p99_us", "max_us", "share")
+    )
+    total = sum(sum(values) for key, values in hops.items() if not key.startswith("total")) or 1
+    for key, values in hops.items():
+        values = sorted(values)
+        share = "" if key.startswith("total") else "%6.1f%%" % (100.0 * sum(values) / total)
+        print(
+            "%-40s %7u %9.1f %9.1f %9.1f %9.1f %9.1f %7s"
+            % (
+                key,
+                len(values),
+                values[0],
+                percentile(values, 50),
+                percentile(values, 90),
+                percentile(values, 99),
+                values[-1],
+                share,
+            )
+        )
+        if show_buckets:
+            counts = [0] * (len(BUCKETS_US) + 1)
+            for value in values:
+                bucket = 0
+                while bucket < len(BUCKETS_US) and value > BUCKETS_US[bucket]:
+                    bucket += 1
+                counts[bucket] += 1
+            for bucket, count in enumerate(counts):
+                if not count:
+                    continue
+                label = "<=%u" % BUCKETS_US[bucket] if bucket < len(BUCKETS_US) else ">%u" % BUCKETS_US[-1]
+                print("    %8s us %7u %s" % (label, count, "#" * max(1, 50 * count // len(values))))
+
+
+def chrome_trace(flows):
+    """Chrome trace event format. One track per hop, one slice per packet per hop."""
+    events = []
+    tids = OrderedDict()
+    for flow in flows:
+        for (t0, name0, pkt_id), (t1, name1, _) in zip(flow.events, flow.events[1:]):
+            hop = "%s->%s" % (name0, name1)
+            tid = tids.setdefault(hop, len(tids) + 1)
+            events.append(
+                {
+                    "name": hop,
+                    "cat": "packet",
+                    "ph": "X",
+                    "ts": t0,
+                    "dur": t1 - t0,
+                    "pid": 1,
+                    "tid": tid,
+                    "args": {"flow": flow.idx, "id": "%08x" % pkt_id},
+                }
+            )
+
+    for hop, tid in tids.items():
+        events.append({"name": "thread_name", "ph": "M", "pid": 1, "tid": tid, "args": {"name": hop}})
+    events.append({"name": "process_name", "ph": "M", "pid": 1, "args": {"name": "bristlemouth packets"}})
+
+    return {"traceEvents": events, "displayTimeUnit": "ns"}
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__, formatter_class=argparse.RawDescriptionHelpFormatter)
+    parser.add_argument("events", help="Raw events file (gdb `trace --dump`)")
+    parser.add_argument("--clock-hz", type=int, help="Trace clock (defaults to value in the dump)")
+    parser.add_argument("--timeout-us", type=float, default=100000, help="Max gap between events of one packet")
+    parser.add_argument("--buckets", action="store_true", help="Print histogram buckets for every hop")
+    parser.add_argument("--chrome", help="Write Chrome trace / Perfetto json timeline to this file")
+    args = parser.parse_args()
+
+    with open(args.events) as events_file:
+        try:
+            events = parse_events(events_file, args.clock_hz)
+        except ValueError as err:
+            parser.error(str(err))
+
+    if not events:
+        print("No packet events found. Was the firmware built with TRACE_PACKETS?")
+        return 1
+
+    flows = build_flows(events, args.timeout_us)
+    print("%u packet events, %u packets" % (len(events), len(flows)))
+    print_histograms(hop_latencies(flows), args.buckets)
+
+    if args.chrome:
+        with open(args.chrome, "w") as chrome_file:
+            json.dump(chrome_trace(flows), chrome_file)
+        print("Wrote %s" % args.chrome)
+
+    return 0
+
+
+if __name__ == "__main__":
+    sys.exit(main())
@@ -0,0 +1,229 @@
+"""
+Bristlemouth network simulation launcher
+
+Starts N simulated nodes (bm_sim, built with -DBUILD_POSIX_SIM=ON), wires
+their ports together into the requested topology, lets them run and then
+checks that every node found its neighbors and heard from every other node.
+
+Nodes only have two ports, like the ADIN2111, so networks are either a
+line (daisy chain) or a ring.
+
+With --bench-pub, the first --bench-publishers nodes run the pub/sub
+benchmark publisher (stress.c) and every other node subscribes, so fan-out
+is nodes - publishers. BENCH records from every node are collected in the
+results.
+
+Example:
+    python3 tools/scripts/sim/bm_sim.py --bin build_sim/src/ports/posix/bm_sim \\
+        --nodes 10 --topology line --latency-us 500 --duration 20
+
+    python3 tools/scripts/sim/bm_sim.py --bin build_sim/src/ports/posix/bm_sim \\
+        --nodes 5 --bench-pub 256,200,4,10 --duration 20 --json
+"""
+import argparse
+import json
+import os
+import re
+import shutil
+import subprocess
+import sys
+import tempfile
+
+MIN_NODES = 2
+MAX_NODES = 50
+
+RESULT_RE = re.compile(
+    r"SIM_RESULT node=(?P<node>[0-9a-f]+) neighbors=(?P<neighbors>\d+) "
+    r"pub_rx_nodes=(?P<pub_rx_nodes>\d+) pub_rx_msgs=(?P<pub_rx_msgs>\d+)"
+)
+PORT_RE = re.compile(r"SIM_PORT node=(?P<node>[0-9a-f]+) port=(?P<port>\d+) (?P<stats>.*)")
+BENCH_RE = re.compile(r"^BENCH (?P<record>\{.*\})$", re.MULTILINE)
+
+
+def node_id(idx):
+    # Keep ids recognizable in logs
+    return 0x51A1000000000000 + idx + 1
+
+
+def build_links(num_nodes, topology):
+    """Return list of ((node_a, port_a), (node_b, port_b)) links"""
+    links = []
+    for idx in range(num_nodes - 1):
+        links.append(((idx, 1), (idx + 1, 0)))
+    if topology == "ring" and num_nodes > 2:
+        links.append(((num_nodes - 1, 1), (0, 0)))
+    return links
+
+
+def expected_neighbors(num_nodes, topology, idx):
+    if topology == "ring" and num_nodes > 2:
+        return 2
+    return 1 if idx in (0, num_nodes - 1) else 2
+
+
+def bench_topics(args):
+    return int(args.bench_pub.split(",")[2])
+
+
+def node_args(args, idx, links, sock_dir):
+    cmd = [
+        args.bin,
+        "--node-id",
+        hex(node_id(idx)),
+        "--duration",
+        str(args.duration),
+        "--pub-period",
+        str(args.pub_period),
+        "--flash",
+        os.path.join(sock_dir, "node%02u" % idx),
+    ]
+    if args.bench_pub:
+        if idx < args.bench_publishers:
+            cmd += ["--bench-pub", args.bench_pub]
+        else:
+            cmd += ["--bench-sub", str(bench_topics(args))]
+    for (a, b) in links:
+        for (local, peer) in ((a, b), (b, a)):
+            if local[0] != idx:
+                continue
+            local_path = os.path.join(sock_dir, "n%02up%u.sock" % local)
+            peer_path = os.path.join(sock_dir, "n%02up%u.sock" % peer)
+            cmd += [
+                "--port",
+                "%u=%s,%s,%u,%u,%u"
+                % (local[1], local_path, peer_path, args.bandwidth, args.latency_us, args.loss_ppm),
+            ]
+    return cmd
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__, formatter_class=argparse.RawDescriptionHelpFormatter)
+    parser.add_argument("--bin", required=True, help="Path to bm_sim binary")
+    parser.add_argument("--nodes", type=int, default=3, help="Number of nodes (%u-%u)" % (MIN_NODES, MAX_NODES))
+    parser.add_argument("--topology", choices=["line", "ring"], default="line")
+    parser.add_argument("--bandwidth", type=int, default=10000000, help="Link bandwidth in bits/s (0 for unlimited)")
+    parser.add_argument("--latency-us", type=int, default=0, help="Link latency in microseconds")
+    parser.add_argument("--loss-ppm", type=int, default=0, help="Frame loss in parts per million")
+    parser.add_argument("--duration", type=int, default=15, help="Seconds to run each node for")
+    parser.add_argument("--pub-period", type=int, default=1000, help="Milliseconds between publishes on each node")
+    parser.add_argument("--logs", help="Directory to store per-node logs in")
+    parser.add_argument("--json", action="store_true", help="Print results as json")
+    parser.add_argument("--bench-pub", help="Run pub/sub benchmark: LEN,RATE_HZ,TOPICS,DURATION_S")
+    parser.add_argument("--bench-publishers", type=int, default=1, help="Number of benchmark publishers")
+    args = parser.parse_args()
+
+    if not MIN_NODES <= args.nodes <= MAX_NODES:
+        parser.error("--nodes must be between %u and %u" % (MIN_NODES, MAX_NODES))
+    if args.bench_pub:
+        fields = args.bench_pub.split(",")
+        if len(fields) != 4 or not all(field.isdigit() for field in fields):
+            parser.error("--bench-pub must be LEN,RATE_HZ,TOPICS,DURATION_S")
+        if not 1 <= args.bench_publishers < args.nodes:
+            parser.error("--bench-publishers must be between 1 and %u" % (args.nodes - 1))
+        # Publishers wait 2s for the network to come up
+        if int(fields[3]) + 3 > args.duration:
+            parser.error("--duration must be at least benchmark duration + 3s")
+
+    # Unix socket paths are limited to 108 bytes, so keep the directory short
+    sock_dir = tempfile.mkdtemp(prefix="bmsim")
+    links = build_links(args.nodes, args.topology)
+
+    if args.logs:
+        os.makedirs(args.logs, exist_ok=True)
+
+    procs = []
+    try:
+        for idx in range(args.nodes):
+            procs.append(
+                subprocess.Popen(
+                    node_args(args, idx, links, sock_dir),
+                    stdout=subprocess.PIPE,
+                    stderr=subprocess.STDOUT,
+                    universal_newlines=True,
+                )
+            )
+
+        outputs = [proc.communicate(timeout=args.duration + 30)[0] for proc in procs]
+    finally:
+        for proc in procs:
+            if proc.poll() is None:
+                proc.kill()
+        shutil.rmtree(sock_dir, ignore_errors=True)
+
+    results = []
+    failed = False
+    for idx, (proc, output) in enumerate(zip(procs, outputs)):
+        if args.logs:
+            with open(os.path.join(args.logs, "node%02u.log" % idx), "w") as log:
+                log.write(output)
+
+        result = {"node": "%016x" % node_id(idx), "exit_code": proc.returncode, "ports": {}}
+        match = RESULT_RE.search(output)
+        if match:
+            result.update({k: int(v) for k, v in match.groupdict().items() if k != "node"})
+        for port_match in PORT_RE.finditer(output):
+            stats = dict(item.split("=") for item in port_match.group("stats").split())
+            result["ports"][port_match.group("port")] = {k: int(v) for k, v in stats.items()}
+        if args.bench_pub:
+            result["bench"] = []
+            for bench_match in BENCH_RE.finditer(output):
+                try:
+                    result["bench"].append(json.loads(bench_match.group("record")))
+                except ValueError:
+                    pass
+
+        errors = []
+        if proc.returncode != 0:
+            errors.append("exit code %d" % proc.returncode)
+        if not match:
+            errors.append("no results")
+        else:
+            if result["neighbors"] != expected_neighbors(args.nodes, args.topology, idx):
+                errors.append(
+                    "expected %u neighbors, found %u"
+                    % (expected_neighbors(args.nodes, args.topology, idx), result["neighbors"])
+                )
+            # With loss, some nodes may legitimately be missed
+            if args.pub_period and not args.loss_ppm and result["pub_rx_nodes"] < args.nodes - 1:
+                errors.append("heard from %u/%u nodes" % (result["pub_rx_nodes"], args.nodes - 1))
+        if args.bench_pub and not result["bench"]:
+            errors.append("no benchmark results")
+        result["errors"] = errors
+        failed |= bool(errors)
+        results.append(result)
+
+    if args.json:
+        print(json.dumps({"nodes": args.nodes, "topology": args.topology, "results": results}, indent=2))
+    else:
+        for result in results:
+            print(
+                "%s neighbors=%s pub_rx_nodes=%s %s"
+                % (
+                    result["node"],
+                    result.get("neighbors", "?"),
+                    result.get("pub_rx_nodes", "?"),
+                    "FAIL: " + ", ".join(result["errors"]) if result["errors"] else "OK",
+                )
+            )
+            for record in result.get("bench", []):
+                if record.get("role") != "sub":
+                    continue
+                print(
+                    "  bench from %s: received %u/%u dropped=%u throughput=%ubps latency p50=%uus p99=%uus max=%uus"
+                    % (
+                        record["src"],
+                        record["received"],
+                        record["expected"],
+                        record["dropped"],
+                        record["throughput_bps"],
+                        record["latency_us"]["p50"],
+                        record["latency_us"]["p99"],
+                        record["latency_us"]["max"],
+                    )
+                )
+
+    return 1 if failed else 0
+
+
+if __name__ == "__main__":
+    sys.exit(main())
@@ -60,8 +60,27 @@ def unit_test_commands(test, verbose=False, jobs=4):
     return commands
 
 
+# Get commands to build the POSIX host simulation and run its smoke test
+def posix_sim_commands(test, verbose=False, jobs=4):
+    project_root = get_project_root()
+
+    cmake_cmd = f"cmake {project_root} -DBUILD_POSIX_SIM=ON"
+    if verbose:
+        ctest_cmd = "ctest -V -R bm_sim"
+    else:
+        ctest_cmd = "ctest --output-on-failure -R bm_sim"
+
+    commands = [cmake_cmd.split(" "), f"make -j {jobs} bm_sim".split(" "), ctest_cmd.split(" ")]
+
+    return commands
+
+
 # Map configuration types to functions to get commands to run
-test_handlers = {"build_fw": build_fw_commands, "unit_tests": unit_test_commands}
+test_handlers = {
+    "build_fw": build_fw_commands,
+    "unit_tests": unit_test_commands,
+    "posix_sim": posix_sim_commands,
+}
 
 
 def run_test(test, verbose=False):